@@ -19,6 +19,11 @@
  *  wildcard pattern. You must call PHYSFSEXT_freeEnumeration() on the results,
  *  just PHYSFS_enumerateFiles() would do with PHYSFS_freeList().
  *
+ * If your search can be case-sensitive in exactly the archives that were
+ *  mounted that way, PHYSFS_enumerateGlob() in the core library is usually
+ *  a better fit: it matches names inside the archives instead of after the
+ *  whole directory has been listed, and it can search subdirectories, too.
+ *
  * License: this code is public domain. I make no warranty that it is useful,
  *  correct, harmless, or environmentally safe.
  *
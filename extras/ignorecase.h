@@ -27,6 +27,9 @@
  * This code should be considered an aid for legacy code. New development
  *  shouldn't do things that require this aid in the first place.  :)
  *
+ * PhysicsFS itself can now do this, much faster, with PHYSFS_ignoreCase();
+ *  prefer that if you can set it before mounting.
+ *
  * Usage: Set up PhysicsFS as you normally would, then use
  *  PHYSFSEXT_locateCorrectCase() to get a "correct" pathname to pass to
  *  functions like PHYSFS_openRead(), etc.
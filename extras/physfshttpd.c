@@ -1,20 +1,24 @@
 /*
- * This is a quick and dirty HTTP server that uses PhysicsFS to retrieve
- *  files. It is not robust at all, probably buggy, and definitely poorly
- *  designed. It's just meant to show that it can be done.
+ * This is a small HTTP server that uses PhysicsFS to retrieve files. It's
+ *  meant for serving a game's assets to devkits and the like on a trusted
+ *  network, not for facing the internet.
  *
  * Basically, you compile this code, and run it:
- *   ./physfshttpd archive1.zip archive2.zip /path/to/a/real/dir etc...
+ *   ./physfshttpd [-p port] [-t threads] archive1.zip archive2.zip /a/dir etc
  *
  * The files are appended in order to the PhysicsFS search path, and when
  *  a client request comes in, it looks for the file in said search path.
  *
- * My goal was to make this work in less than 300 lines of C, so again, it's
- *  not to be used for any serious purpose. Patches to make this application
- *  suck less will be readily and gratefully accepted.
+ * A fixed pool of worker threads handles connections, each of which can make
+ *  any number of requests (HTTP/1.1 keep-alive). GET and HEAD are supported,
+ *  as are single "Range: bytes=..." requests, which map onto PHYSFS_seek(),
+ *  so clients can resume a download or fetch a slice of a file. Files that
+ *  PHYSFS_mapFile() can hand over (stored, uncompressed entries in a mapped
+ *  archive) are written to the socket straight from the mapping, without
+ *  being copied through a read buffer first.
  *
  * Command line I used to build this on Linux:
- *  gcc -Wall -Werror -g -o bin/physfshttpd extras/physfshttpd.c -lphysfs
+ *  gcc -Wall -Werror -g -o bin/physfshttpd extras/physfshttpd.c -lphysfs -lpthread
  *
  * License: this code is public domain. I make no warranty that it is useful,
  *  correct, harmless, or environmentally safe.
@@ -36,11 +40,14 @@
 #include <stdlib.h>
 #include <stdarg.h>
 #include <string.h>
+#include <strings.h>
 #include <unistd.h>
 #include <errno.h>
 #include <ctype.h>
+#include <pthread.h>
 #include <sys/types.h>
 #include <sys/socket.h>
+#include <sys/time.h>
 #include <netinet/in.h>
 #include <arpa/inet.h>
 
@@ -56,41 +63,68 @@
 
 
 #define DEFAULT_PORTNUM 8080
+#define DEFAULT_THREADS 8
+#define MAX_QUEUED_CONNECTIONS 64
+#define KEEPALIVE_SECONDS 15
+#define MAX_REQUEST_SIZE (8 * 1024)
+#define FEED_BUFFER_SIZE (64 * 1024)
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
 
 typedef struct
 {
     int sock;
-    struct sockaddr *addr;
-    socklen_t addrlen;
-} http_args;
+    char ipstr[64];
+} http_conn;
+
+/* accepted connections, waiting for a worker. */
+static http_conn queue[MAX_QUEUED_CONNECTIONS];
+static int queuehead = 0;
+static int queuecount = 0;
+static pthread_mutex_t queuelock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t queuecond = PTHREAD_COND_INITIALIZER;
+static volatile int quitting = 0;
+
+/* what a worker knows about the request it's answering. */
+typedef struct
+{
+    const char *ipstr;
+    int sock;
+    int head;  /* HEAD request: send headers only. */
+    int keepalive;  /* keep the connection after this response? */
+    const char *range;  /* value of the Range header, or NULL. */
+    char *feedbuf;  /* FEED_BUFFER_SIZE bytes, one per worker. */
+} http_request;
 
 
 #define txt404 \
-    "HTTP/1.0 404 Not Found\n" \
-    "Connection: close\n" \
-    "Content-Type: text/html; charset=utf-8\n" \
-    "\n" \
     "<html><head><title>404 Not Found</title></head>\n" \
-    "<body>Can't find '%s'.</body></html>\n\n" \
-
-#define txt200 \
-    "HTTP/1.0 200 OK\n" \
-    "Connection: close\n" \
-    "Content-Type: %s\n" \
-    "\n"
+    "<body>Can't find '%s'.</body></html>\n"
 
 static const char *lastError(void)
 {
     return PHYSFS_getErrorByCode(PHYSFS_getLastErrorCode());
 } /* lastError */
 
-static int writeAll(const char *ipstr, const int sock, void *buf, const size_t len)
+static int writeAll(const char *ipstr, const int sock, const void *_buf,
+                    size_t len)
 {
-    if (write(sock, buf, len) != len)
+    const char *buf = (const char *) _buf;
+    while (len > 0)
     {
-        printf("%s: Write error to socket.\n", ipstr);
-        return 0;
-    } /* if */
+        const ssize_t bw = send(sock, buf, len, MSG_NOSIGNAL);
+        if (bw < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            printf("%s: Write error to socket: %s.\n", ipstr, strerror(errno));
+            return 0;
+        } /* if */
+        buf += bw;
+        len -= (size_t) bw;
+    } /* while */
 
     return 1;
 } /* writeAll */
@@ -110,177 +144,651 @@ static int writeString(const char *ipstr, const int sock, const char *fmt, ...)
         return 0;
     } /* if */
 
+    if (len >= (int) sizeof (buffer))
+        len = (int) sizeof (buffer) - 1;  /* truncated. */
+
     return writeAll(ipstr, sock, buffer, len);
 } /* writeString */
 
 
-static void feed_file_http(const char *ipstr, int sock, const char *fname)
+/* Everything up to the blank line; the body, if any, is up to the caller. */
+static int writeHeader(http_request *req, const char *status,
+                       const char *mimetype, PHYSFS_sint64 len,
+                       const char *extra)
+{
+    char contentlen[64] = "";
+    if (len >= 0)
+    {
+        snprintf(contentlen, sizeof (contentlen), "Content-Length: %llu\r\n",
+                 (unsigned long long) len);
+    } /* if */
+    else
+    {
+        req->keepalive = 0;  /* the end of the body has to be the end. */
+    } /* else */
+
+    return writeString(req->ipstr, req->sock,
+                       "HTTP/1.1 %s\r\n"
+                       "Connection: %s\r\n"
+                       "Content-Type: %s\r\n"
+                       "Accept-Ranges: bytes\r\n"
+                       "%s%s"
+                       "\r\n",
+                       status, req->keepalive ? "keep-alive" : "close",
+                       mimetype, contentlen, extra ? extra : "");
+} /* writeHeader */
+
+
+static void feed_error_http(http_request *req, const char *status,
+                            const char *extra, const char *fmt,
+                            const char *arg)
+{
+    char body[1024];
+    int len = snprintf(body, sizeof (body), fmt, arg);
+    if ((len < 0) || (len >= (int) sizeof (body)))
+        len = 0;
+    if (writeHeader(req, status, "text/html; charset=utf-8", len, extra))
+    {
+        if (!req->head)
+            writeAll(req->ipstr, req->sock, body, len);
+    } /* if */
+} /* feed_error_http */
+
+
+/*
+ * Work out which bytes of a (len)-byte file a Range header asks for. Returns
+ *  1 and fills in (*start) and (*count) for a range we'll honor, 0 to send
+ *  the whole file (no header, or one we don't do, like several ranges), or
+ *  -1 if the range doesn't overlap the file at all.
+ */
+static int parse_range(const char *range, const PHYSFS_uint64 len,
+                       PHYSFS_uint64 *start, PHYSFS_uint64 *count)
+{
+    unsigned long long first, last;
+    char *endp;
+
+    if (range == NULL)
+        return 0;
+    else if (strncasecmp(range, "bytes=", 6) != 0)
+        return 0;
+    else if (strchr(range, ',') != NULL)
+        return 0;  /* multipart/byteranges isn't worth it here. */
+
+    range += 6;
+    while (*range == ' ')
+        range++;
+
+    if (*range == '-')  /* "-500" is the last 500 bytes. */
+    {
+        last = strtoull(range + 1, &endp, 10);
+        if ((endp == range + 1) || (last == 0) || (len == 0))
+            return (endp == range + 1) ? 0 : -1;
+        else if (last > len)
+            last = len;
+        *start = len - last;
+        *count = last;
+        return 1;
+    } /* if */
+
+    if (!isdigit((unsigned char) *range))
+        return 0;
+
+    first = strtoull(range, &endp, 10);
+    if (*endp != '-')
+        return 0;
+    else if (first >= len)
+        return -1;
+
+    range = endp + 1;
+    if (!isdigit((unsigned char) *range))  /* "500-" is 500 to the end. */
+        last = len - 1;
+    else
+    {
+        last = strtoull(range, &endp, 10);
+        if (last < first)
+            return 0;  /* a broken range is ignored, per the RFC. */
+        else if (last >= len)
+            last = len - 1;
+    } /* else */
+
+    *start = first;
+    *count = (last - first) + 1;
+    return 1;
+} /* parse_range */
+
+
+/* Send the right header for (req)'s range of a (len)-byte file. */
+static int feed_file_header(http_request *req, const PHYSFS_uint64 len,
+                            PHYSFS_uint64 *start, PHYSFS_uint64 *count)
+{
+    /* !!! FIXME: mimetype */
+    const char *mimetype = "text/plain; charset=utf-8";
+    char extra[128];
+    const int rc = parse_range(req->range, len, start, count);
+
+    if (rc < 0)
+    {
+        snprintf(extra, sizeof (extra), "Content-Range: bytes */%llu\r\n",
+                 (unsigned long long) len);
+        feed_error_http(req, "416 Range Not Satisfiable", extra,
+                        "<html><body>Bad range '%s'.</body></html>\n",
+                        req->range);
+        return 0;
+    } /* if */
+
+    else if (rc == 0)
+    {
+        *start = 0;
+        *count = len;
+        return writeHeader(req, "200 OK", mimetype, (PHYSFS_sint64) len, NULL);
+    } /* else if */
+
+    snprintf(extra, sizeof (extra), "Content-Range: bytes %llu-%llu/%llu\r\n",
+             (unsigned long long) *start,
+             (unsigned long long) (*start + *count - 1),
+             (unsigned long long) len);
+    return writeHeader(req, "206 Partial Content", mimetype,
+                       (PHYSFS_sint64) *count, extra);
+} /* feed_file_header */
+
+
+/* stored entries in a mapped archive go out without a copy. */
+static int feed_mapped_file_http(http_request *req, const char *fname)
+{
+    const void *ptr = NULL;
+    PHYSFS_uint64 len = 0;
+    PHYSFS_uint64 start, count;
+
+    if (!PHYSFS_mapFile(fname, &ptr, &len))
+        return 0;
+
+    if (feed_file_header(req, len, &start, &count) && !req->head)
+    {
+        if (!writeAll(req->ipstr, req->sock,
+                      ((const char *) ptr) + start, (size_t) count))
+            req->keepalive = 0;
+    } /* if */
+
+    PHYSFS_unmapFile(ptr);
+    return 1;
+} /* feed_mapped_file_http */
+
+
+static void feed_file_http(http_request *req, const char *fname)
 {
-    PHYSFS_File *in = PHYSFS_openRead(fname);
+    PHYSFS_File *in;
+    PHYSFS_sint64 len;
+    PHYSFS_uint64 start, count;
 
+    if (feed_mapped_file_http(req, fname))
+        return;
+
+    in = PHYSFS_openRead(fname);
     if (in == NULL)
     {
-        printf("%s: Can't open [%s]: %s.\n", ipstr, fname, lastError());
-        writeString(ipstr, sock, txt404, fname);
+        printf("%s: Can't open [%s]: %s.\n", req->ipstr, fname, lastError());
+        feed_error_http(req, "404 Not Found", NULL, txt404, fname);
         return;
     } /* if */
 
-    /* !!! FIXME: mimetype */
-    if (writeString(ipstr, sock, txt200, "text/plain; charset=utf-8"))
+    len = PHYSFS_fileLength(in);
+    if (len < 0)  /* no idea how big; no ranges, and close when done. */
+    {
+        start = 0;
+        count = (PHYSFS_uint64) -1;
+        if (!writeHeader(req, "200 OK", "text/plain; charset=utf-8", -1, NULL))
+            count = 0;
+    } /* if */
+
+    else if (!feed_file_header(req, (PHYSFS_uint64) len, &start, &count))
+        count = 0;
+
+    else if ((start > 0) && (!PHYSFS_seek(in, start)))
+    {
+        printf("%s: Seek error: %s.\n", req->ipstr, lastError());
+        req->keepalive = 0;  /* we promised bytes we can't send. */
+        count = 0;
+    } /* else if */
+
+    if (req->head)
+        count = 0;
+
+    while (count > 0)
     {
-        do
+        const PHYSFS_uint64 want = (count < FEED_BUFFER_SIZE) ?
+                                    count : FEED_BUFFER_SIZE;
+        const PHYSFS_sint64 br = PHYSFS_readBytes(in, req->feedbuf, want);
+        if (br < 0)
         {
-            char buffer[1024];
-            PHYSFS_sint64 br = PHYSFS_readBytes(in, buffer, sizeof (buffer));
-            if (br == -1)
-            {
-                printf("%s: Read error: %s.\n", ipstr, lastError());
-                break;
-            } /* if */
+            printf("%s: Read error: %s.\n", req->ipstr, lastError());
+            req->keepalive = 0;
+            break;
+        } /* if */
 
-            else if (!writeAll(ipstr, sock, buffer, (size_t) br))
-            {
-                break;
-            } /* else if */
-        } while (!PHYSFS_eof(in));
-    } /* if */
+        else if (br == 0)
+        {
+            if (len >= 0)
+                req->keepalive = 0;  /* short file; the length was a lie. */
+            break;
+        } /* else if */
+
+        else if (!writeAll(req->ipstr, req->sock, req->feedbuf, (size_t) br))
+        {
+            req->keepalive = 0;
+            break;
+        } /* else if */
+
+        count -= (PHYSFS_uint64) br;
+    } /* while */
 
     PHYSFS_close(in);
 } /* feed_file_http */
 
 
-static void feed_dirlist_http(const char *ipstr, int sock,
-                              const char *dname, char **list)
+typedef struct
 {
-    int i;
+    char *buf;
+    size_t len;
+    size_t alloc;
+    int failed;
+} html_buffer;
 
-    if (!writeString(ipstr, sock, txt200, "text/html; charset=utf-8"))
-        return;
+static void appendString(html_buffer *html, const char *fmt, ...)
+{
+    va_list ap;
+    int len;
 
-    else if (!writeString(ipstr, sock,
-                    "<html><head><title>Directory %s</title></head>"
-                    "<body><p><h1>Directory %s</h1></p><p><ul>\n",
-                    dname, dname))
+    if (html->failed)
         return;
 
+    va_start(ap, fmt);
+    len = vsnprintf(html->buf + html->len, html->alloc - html->len, fmt, ap);
+    va_end(ap);
+
+    if (len < 0)
+        html->failed = 1;
+    else if ((size_t) len >= html->alloc - html->len)
+    {
+        const size_t newalloc = (html->alloc * 2) + len;
+        char *ptr = (char *) realloc(html->buf, newalloc);
+        if (ptr == NULL)
+        {
+            html->failed = 1;
+            return;
+        } /* if */
+        html->buf = ptr;
+        html->alloc = newalloc;
+
+        va_start(ap, fmt);
+        vsnprintf(html->buf + html->len, html->alloc - html->len, fmt, ap);
+        va_end(ap);
+        html->len += len;
+    } /* else if */
+    else
+    {
+        html->len += len;
+    } /* else */
+} /* appendString */
+
+
+static void feed_dirlist_http(http_request *req, const char *dname,
+                              char **list)
+{
+    html_buffer html;
+    int i;
+
+    /* the listing has to be built first, to know its Content-Length. */
+    html.alloc = 1024;
+    html.len = 0;
+    html.failed = 0;
+    html.buf = (char *) malloc(html.alloc);
+    if (html.buf == NULL)
+        html.failed = 1;
+
+    appendString(&html, "<html><head><title>Directory %s</title></head>"
+                        "<body><p><h1>Directory %s</h1></p><p><ul>\n",
+                        dname, dname);
+
     if (strcmp(dname, "/") == 0)
         dname = "";
 
     for (i = 0; list[i]; i++)
     {
         const char *fname = list[i];
-        if (!writeString(ipstr, sock,
-            "<li><a href='%s/%s'>%s</a></li>\n", dname, fname, fname))
-            break;
+        appendString(&html, "<li><a href='%s/%s'>%s</a></li>\n",
+                     dname, fname, fname);
     } /* for */
 
-    writeString(ipstr, sock, "</ul></body></html>\n");
+    appendString(&html, "</ul></body></html>\n");
+
+    if (html.failed)
+    {
+        printf("%s: out of memory.\n", req->ipstr);
+        feed_error_http(req, "500 Internal Server Error", NULL,
+                        "<html><body>Out of memory%s.</body></html>\n", "");
+    } /* if */
+
+    else if (writeHeader(req, "200 OK", "text/html; charset=utf-8",
+                         (PHYSFS_sint64) html.len, NULL))
+    {
+        if (!req->head)
+        {
+            if (!writeAll(req->ipstr, req->sock, html.buf, html.len))
+                req->keepalive = 0;
+        } /* if */
+    } /* else if */
+
+    free(html.buf);
 } /* feed_dirlist_http */
 
-static void feed_dir_http(const char *ipstr, int sock, const char *dname)
+static void feed_dir_http(http_request *req, const char *dname)
 {
     char **list = PHYSFS_enumerateFiles(dname);
     if (list == NULL)
     {
         printf("%s: Can't enumerate directory [%s]: %s.\n",
-               ipstr, dname, lastError());
-        writeString(ipstr, sock, txt404, dname);
+               req->ipstr, dname, lastError());
+        feed_error_http(req, "404 Not Found", NULL, txt404, dname);
         return;
     } /* if */
 
-    feed_dirlist_http(ipstr, sock, dname, list);
+    feed_dirlist_http(req, dname, list);
     PHYSFS_freeList(list);
 } /* feed_dir_http */
 
-static void feed_http_request(const char *ipstr, int sock, const char *fname)
+static void feed_http_request(http_request *req, const char *fname)
 {
     PHYSFS_Stat statbuf;
 
-    printf("%s: requested [%s].\n", ipstr, fname);
+    printf("%s: requested [%s]%s%s.\n", req->ipstr, fname,
+           req->range ? ", range " : "", req->range ? req->range : "");
 
     if (!PHYSFS_stat(fname, &statbuf))
     {
-        printf("%s: Can't stat [%s]: %s.\n", ipstr, fname, lastError());
-        writeString(ipstr, sock, txt404, fname);
+        printf("%s: Can't stat [%s]: %s.\n", req->ipstr, fname, lastError());
+        feed_error_http(req, "404 Not Found", NULL, txt404, fname);
         return;
     } /* if */
 
     if (statbuf.filetype == PHYSFS_FILETYPE_DIRECTORY)
-        feed_dir_http(ipstr, sock, fname);
+        feed_dir_http(req, fname);
     else
-        feed_file_http(ipstr, sock, fname);
+        feed_file_http(req, fname);
 } /* feed_http_request */
 
 
-static void *do_http(void *_args)
+/* decode %XX escapes in place; drop any query string. */
+static void url_decode(char *str)
+{
+    char *dst = str;
+    while ((*str) && (*str != '?') && (*str != '#'))
+    {
+        if ((str[0] == '%') && isxdigit((unsigned char) str[1]) &&
+            isxdigit((unsigned char) str[2]))
+        {
+            const char hex[3] = { str[1], str[2], '\0' };
+            *(dst++) = (char) strtol(hex, NULL, 16);
+            str += 3;
+        } /* if */
+        else
+        {
+            *(dst++) = *(str++);
+        } /* else */
+    } /* while */
+    *dst = '\0';
+} /* url_decode */
+
+
+/* find a header's value in (headers), the lines after the request line. */
+static char *find_header(char *headers, const char *name)
+{
+    const size_t namelen = strlen(name);
+    char *line = headers;
+
+    while ((line != NULL) && (*line))
+    {
+        char *next = strchr(line, '\n');
+        if (next != NULL)
+            *(next++) = '\0';
+
+        if ((strncasecmp(line, name, namelen) == 0) && (line[namelen] == ':'))
+        {
+            char *val = line + namelen + 1;
+            char *end = val + strlen(val);
+            while ((*val == ' ') || (*val == '\t'))
+                val++;
+            while ((end > val) && ((end[-1] == '\r') || (end[-1] == ' ')))
+                *(--end) = '\0';
+            if (next != NULL)
+                next[-1] = '\n';  /* leave the rest for the next lookup. */
+            return val;
+        } /* if */
+
+        if (next != NULL)
+            next[-1] = '\n';
+        line = next;
+    } /* while */
+
+    return NULL;
+} /* find_header */
+
+
+/*
+ * Answer one request that sits, headers and all, in (buf). Returns non-zero
+ *  if the connection should stay open for another one.
+ */
+static int handle_request(http_request *req, char *buf)
 {
-    http_args *args = (http_args *) _args;
-    char ipstr[128];
-    char buffer[512];
+    char *method = buf;
+    char *target;
+    char *version;
+    char *headers;
+    char *connection;
     char *ptr;
-    strncpy(ipstr, inet_ntoa(((struct sockaddr_in *) args->addr)->sin_addr),
-            sizeof (ipstr));
-    ipstr[sizeof (ipstr) - 1] = '\0';
-
-    printf("%s: connected.\n", ipstr);
-    read(args->sock, buffer, sizeof (buffer));
-    buffer[sizeof (buffer) - 1] = '\0';
-    ptr = strchr(buffer, '\n');
-    if (!ptr)
-        printf("%s: potentially bogus request.\n", ipstr);
+    int http11;
+
+    headers = strchr(buf, '\n');
+    *(headers++) = '\0';
+    if ((ptr = strchr(buf, '\r')) != NULL)
+        *ptr = '\0';
+
+    target = strchr(method, ' ');
+    version = target ? strchr(target + 1, ' ') : NULL;
+    if (version == NULL)
+    {
+        printf("%s: potentially bogus request.\n", req->ipstr);
+        req->keepalive = 0;
+        feed_error_http(req, "400 Bad Request", NULL,
+                        "<html><body>Bad request%s.</body></html>\n", "");
+        return 0;
+    } /* if */
+
+    *(target++) = '\0';
+    *(version++) = '\0';
+    http11 = (strcmp(version, "HTTP/1.0") != 0);
+
+    connection = find_header(headers, "Connection");
+    if (connection == NULL)
+        req->keepalive = http11;
+    else if (strcasecmp(connection, "close") == 0)
+        req->keepalive = 0;
     else
+        req->keepalive = (http11 || (strcasecmp(connection, "keep-alive") == 0));
+
+    if (quitting)
+        req->keepalive = 0;
+
+    req->range = find_header(headers, "Range");
+    req->head = (strcmp(method, "HEAD") == 0);
+
+    if ((!req->head) && (strcmp(method, "GET") != 0))
     {
-        *ptr = '\0';
-        ptr = strchr(buffer, '\r');
-        if (ptr != NULL)
-            *ptr = '\0';
-
-        if ((toupper(buffer[0]) == 'G') &&
-            (toupper(buffer[1]) == 'E') &&
-            (toupper(buffer[2]) == 'T') &&
-            (toupper(buffer[3]) == ' ') &&
-            (toupper(buffer[4]) == '/'))
+        /* there might be a body we don't know how to skip; hang up. */
+        req->keepalive = 0;
+        feed_error_http(req, "501 Not Implemented", NULL,
+                        "<html><body>Can't do '%s'.</body></html>\n", method);
+    } /* if */
+
+    else if (*target != '/')
+    {
+        req->keepalive = 0;
+        feed_error_http(req, "400 Bad Request", NULL,
+                        "<html><body>Bad path '%s'.</body></html>\n", target);
+    } /* else if */
+
+    else
+    {
+        url_decode(target);
+        feed_http_request(req, target);
+    } /* else */
+
+    return req->keepalive;
+} /* handle_request */
+
+
+/* find the end of the request headers in (buf), or NULL if not there yet. */
+static char *find_request_end(char *buf, const size_t len)
+{
+    size_t i;
+    for (i = 0; i + 1 < len; i++)
+    {
+        if (buf[i] != '\n')
+            continue;
+        else if (buf[i + 1] == '\n')
+            return buf + i + 2;
+        else if ((buf[i + 1] == '\r') && (i + 2 < len) && (buf[i + 2] == '\n'))
+            return buf + i + 3;
+    } /* for */
+
+    return NULL;
+} /* find_request_end */
+
+
+static void do_http(http_conn *conn, char *feedbuf)
+{
+    char buffer[MAX_REQUEST_SIZE + 1];
+    size_t buflen = 0;
+    struct timeval tv;
+    http_request req;
+
+    printf("%s: connected.\n", conn->ipstr);
+
+    tv.tv_sec = KEEPALIVE_SECONDS;
+    tv.tv_usec = 0;
+    setsockopt(conn->sock, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof (tv));
+
+    memset(&req, '\0', sizeof (req));
+    req.ipstr = conn->ipstr;
+    req.sock = conn->sock;
+    req.feedbuf = feedbuf;
+
+    while (!quitting)
+    {
+        char *end = find_request_end(buffer, buflen);
+        if (end == NULL)
         {
-            ptr = strchr(buffer + 5, ' ');
-            if (ptr != NULL)
-                *ptr = '\0';
-            feed_http_request(ipstr, args->sock, buffer + 4);
+            ssize_t br;
+            if (buflen == MAX_REQUEST_SIZE)
+            {
+                printf("%s: request too big.\n", conn->ipstr);
+                req.keepalive = 0;
+                feed_error_http(&req, "431 Request Header Fields Too Large",
+                                NULL, "<html><body>Too big%s.</body></html>\n",
+                                "");
+                break;
+            } /* if */
+
+            br = recv(conn->sock, buffer + buflen,
+                      MAX_REQUEST_SIZE - buflen, 0);
+            if ((br < 0) && (errno == EINTR))
+                continue;
+            else if (br <= 0)
+                break;  /* hung up, timed out, or broke. */
+            buflen += (size_t) br;
+            continue;
         } /* if */
-    } /* else */
+
+        else
+        {
+            const size_t reqlen = (size_t) (end - buffer);
+            const char saved = *end;
+            *end = '\0';
+            if (!handle_request(&req, buffer))
+                break;
+            *end = saved;
+
+            /* pipelined requests might have come in behind that one. */
+            memmove(buffer, end, buflen - reqlen);
+            buflen -= reqlen;
+        } /* else */
+    } /* while */
 
     /* !!! FIXME: Time the transfer. */
-    printf("%s: closing connection.\n", ipstr);
-    close(args->sock);
-    free(args->addr);
-    free(args);
-    return NULL;
+    printf("%s: closing connection.\n", conn->ipstr);
+    close(conn->sock);
 } /* do_http */
 
 
-static void serve_http_request(int sock, struct sockaddr *addr,
-                               socklen_t addrlen)
+static void *http_worker(void *unused)
 {
-    http_args *args = (http_args *) malloc(sizeof (http_args));
-    if (args == NULL)
+    char *feedbuf = (char *) malloc(FEED_BUFFER_SIZE);
+    if (feedbuf == NULL)
     {
         printf("out of memory.\n");
-        return;
+        return NULL;
     } /* if */
-    args->addr = (struct sockaddr *) malloc(addrlen);
-    if (args->addr == NULL)
+
+    while (1)
     {
-        free(args);
-        printf("out of memory.\n");
+        http_conn conn;
+
+        pthread_mutex_lock(&queuelock);
+        while ((queuecount == 0) && (!quitting))
+            pthread_cond_wait(&queuecond, &queuelock);
+
+        if (queuecount == 0)  /* quitting, and nothing left to do. */
+        {
+            pthread_mutex_unlock(&queuelock);
+            break;
+        } /* if */
+
+        conn = queue[queuehead];
+        queuehead = (queuehead + 1) % MAX_QUEUED_CONNECTIONS;
+        queuecount--;
+        pthread_cond_broadcast(&queuecond);  /* there's room again. */
+        pthread_mutex_unlock(&queuelock);
+
+        do_http(&conn, feedbuf);
+    } /* while */
+
+    free(feedbuf);
+    return NULL;
+} /* http_worker */
+
+
+static void serve_http_request(int sock, struct sockaddr_in *addr)
+{
+    http_conn *conn;
+
+    pthread_mutex_lock(&queuelock);
+    while ((queuecount == MAX_QUEUED_CONNECTIONS) && (!quitting))
+        pthread_cond_wait(&queuecond, &queuelock);
+
+    if (quitting)
+    {
+        pthread_mutex_unlock(&queuelock);
+        close(sock);
         return;
     } /* if */
 
-    args->sock = sock;
-    args->addrlen = addrlen;
-    memcpy(args->addr, addr, addrlen);
-
-    /* !!! FIXME: optionally spin a thread... */
-    do_http((void *) args);
-} /* server_http_request */
+    conn = &queue[(queuehead + queuecount) % MAX_QUEUED_CONNECTIONS];
+    conn->sock = sock;
+    strncpy(conn->ipstr, inet_ntoa(addr->sin_addr), sizeof (conn->ipstr));
+    conn->ipstr[sizeof (conn->ipstr) - 1] = '\0';
+    queuecount++;
+    pthread_cond_broadcast(&queuecond);
+    pthread_mutex_unlock(&queuelock);
+} /* serve_http_request */
 
 
 static int create_listen_socket(short portnum)
@@ -300,11 +808,14 @@ static int create_listen_socket(short portnum)
     if (retval >= 0)
     {
         struct sockaddr_in addr;
+        int on = 1;
+        setsockopt(retval, SOL_SOCKET, SO_REUSEADDR, &on, sizeof (on));
+        memset(&addr, '\0', sizeof (addr));
         addr.sin_family = AF_INET;
         addr.sin_port = htons(portnum);
         addr.sin_addr.s_addr = INADDR_ANY;
         if ((bind(retval, (struct sockaddr *) &addr, (socklen_t) sizeof (addr)) == -1) ||
-            (listen(retval, 5) == -1))
+            (listen(retval, MAX_QUEUED_CONNECTIONS) == -1))
         {
             close(retval);
             retval = -1;
@@ -315,44 +826,63 @@ static int create_listen_socket(short portnum)
 } /* create_listen_socket */
 
 
-static int listensocket = -1;
-
-void at_exit_cleanup(void)
+#ifndef LACKING_SIGNALS
+static void signal_quit(int sig)
 {
-    /*
-     * !!! FIXME: If thread support, signal threads to terminate and
-     * !!! FIXME:  wait for them to clean up.
-     */
-
-    if (listensocket >= 0)
-        close(listensocket);
-
-    if (!PHYSFS_deinit())
-        printf("PHYSFS_deinit() failed: %s\n", lastError());
-} /* at_exit_cleanup */
+    quitting = 1;  /* accept() gets EINTR, and main() shuts things down. */
+} /* signal_quit */
+#endif
 
 
 int main(int argc, char **argv)
 {
-    int i;
+#ifndef LACKING_SIGNALS
+    sigset_t oldset;
+#endif
+    pthread_t *threads;
+    int listensocket;
+    int numthreads = DEFAULT_THREADS;
     int portnum = DEFAULT_PORTNUM;
+    int argi;
+    int i;
 
     setbuf(stdout, NULL);
     setbuf(stderr, NULL);
 
 #ifndef LACKING_SIGNALS
-    /* I'm not sure if this qualifies as a cheap trick... */
-    signal(SIGTERM, exit);
-    signal(SIGINT, exit);
-    signal(SIGFPE, exit);
-    signal(SIGSEGV, exit);
-    signal(SIGPIPE, exit);
-    signal(SIGILL, exit);
+    {
+        struct sigaction sa;
+        sigset_t set;
+        memset(&sa, '\0', sizeof (sa));
+        sa.sa_handler = signal_quit;  /* no SA_RESTART, to break accept(). */
+        sigaction(SIGTERM, &sa, NULL);
+        sigaction(SIGINT, &sa, NULL);
+        signal(SIGPIPE, SIG_IGN);  /* a client hanging up isn't fatal. */
+
+        /*
+         * Every other thread, PhysicsFS's included, inherits this mask; the
+         *  signals have to land on this one, to interrupt accept().
+         */
+        sigemptyset(&set);
+        sigaddset(&set, SIGTERM);
+        sigaddset(&set, SIGINT);
+        pthread_sigmask(SIG_BLOCK, &set, &oldset);
+    }
 #endif
 
-    if (argc == 1)
+    for (argi = 1; argi < argc; argi++)
+    {
+        if ((strcmp(argv[argi], "-p") == 0) && (argi + 1 < argc))
+            portnum = atoi(argv[++argi]);
+        else if ((strcmp(argv[argi], "-t") == 0) && (argi + 1 < argc))
+            numthreads = atoi(argv[++argi]);
+        else
+            break;
+    } /* for */
+
+    if ((argi == argc) || (numthreads <= 0))
     {
-        printf("USAGE: %s <archive1> [archive2 [... archiveN]]\n", argv[0]);
+        printf("USAGE: %s [-p port] [-t threads] <archive1> [archive2 [... archiveN]]\n", argv[0]);
         return 42;
     } /* if */
 
@@ -362,10 +892,7 @@ int main(int argc, char **argv)
         return 42;
     } /* if */
 
-    /* normally, this is bad practice, but oh well. */
-    atexit(at_exit_cleanup);
-
-    for (i = 1; i < argc; i++)
+    for (i = argi; i < argc; i++)
     {
         if (!PHYSFS_mount(argv[i], NULL, 1))
             printf(" WARNING: failed to add [%s] to search path.\n", argv[i]);
@@ -375,26 +902,67 @@ int main(int argc, char **argv)
     if (listensocket < 0)
     {
         printf("listen socket failed to create.\n");
+        PHYSFS_deinit();
+        return 42;
+    } /* if */
+
+    threads = (pthread_t *) malloc(sizeof (pthread_t) * numthreads);
+    if (threads == NULL)
+    {
+        printf("out of memory.\n");
+        close(listensocket);
+        PHYSFS_deinit();
         return 42;
     } /* if */
 
-    while (1)  /* infinite loop for now. */
+    for (i = 0; i < numthreads; i++)
     {
-        struct sockaddr addr;
-        socklen_t len;
-        int s = accept(listensocket, &addr, &len);
+        if (pthread_create(&threads[i], NULL, http_worker, NULL) != 0)
+        {
+            printf("couldn't start worker thread.\n");
+            numthreads = i;
+            quitting = 1;
+            break;
+        } /* if */
+    } /* for */
+
+#ifndef LACKING_SIGNALS
+    pthread_sigmask(SIG_SETMASK, &oldset, NULL);
+#endif
+
+    printf("serving on port %d with %d threads.\n", portnum, numthreads);
+
+    while (!quitting)
+    {
+        struct sockaddr_in addr;
+        socklen_t len = (socklen_t) sizeof (addr);
+        int s = accept(listensocket, (struct sockaddr *) &addr, &len);
         if (s < 0)
         {
+            if (errno == EINTR)
+                continue;
             printf("accept() failed: %s\n", strerror(errno));
-            close(listensocket);
-            return 42;
+            break;
         } /* if */
 
-        serve_http_request(s, &addr, len);
+        serve_http_request(s, &addr);
     } /* while */
 
+    /* finish open connections' current requests, then shut down. */
+    close(listensocket);
+    pthread_mutex_lock(&queuelock);
+    quitting = 1;
+    pthread_cond_broadcast(&queuecond);
+    pthread_mutex_unlock(&queuelock);
+
+    for (i = 0; i < numthreads; i++)
+        pthread_join(threads[i], NULL);
+    free(threads);
+
+    if (!PHYSFS_deinit())
+        printf("PHYSFS_deinit() failed: %s\n", lastError());
+
     return 0;
 } /* main */
 
 /* end of physfshttpd.c ... */
-
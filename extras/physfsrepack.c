@@ -0,0 +1,597 @@
+/*
+ * Rewrite a .zip or .grp file so its entries are in the order a program
+ *  first needed them, using logs from PHYSFS_startAccessLog().
+ *
+ * Reading a level's worth of files from an archive on a spinning disk or a
+ *  disc is mostly seeking if they're scattered around it. After this, they're
+ *  mostly in a row, and PHYSFS_preload() or PHYSFS_readFilesBatch() on the
+ *  same list of files reads them front to back.
+ *
+ * The new order is:
+ *  - small files (see -s) that were opened more than once across all the
+ *    logs, in the order they were first opened. These are the hot ones;
+ *    they end up together at the front;
+ *  - then every other file the logs opened, in the order they were first
+ *    opened;
+ *  - then everything the logs never touched, in the order it was in before.
+ *
+ * Entries are copied byte for byte, compressed data and all, so nothing is
+ *  recompressed and the output holds exactly the same files. Zip64 archives
+ *  aren't handled.
+ *
+ * This doesn't need PhysicsFS itself; just compile it on its own. Something
+ *  like cc -o physfsrepack physfsrepack.c will do.
+ *
+ * Please see the file LICENSE.txt in the source's root directory.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+
+
+#define SMALL_FILE_DEFAULT (64 * 1024)
+
+typedef struct
+{
+    char *name;  /* as PhysicsFS would see it: no leading '/'. */
+    unsigned long size;  /* uncompressed size, for telling small from big. */
+    unsigned long offset;  /* where its data (or local header) starts. */
+    unsigned long len;  /* bytes of it to copy from (offset). */
+    unsigned char *central;  /* its central directory record, or .grp table
+                                entry. */
+    unsigned long centrallen;
+    unsigned long original;  /* position in the original archive. */
+    unsigned long first;  /* first open in the logs, or 0 for never. */
+    unsigned long opens;  /* times the logs opened it. */
+    int hot;
+} Entry;
+
+static Entry *entries = NULL;
+static unsigned long numentries = 0;
+static Entry **byname = NULL;  /* (entries), sorted for lookups. */
+static Entry **bycase = NULL;  /* ...and again, ignoring ASCII case. */
+static unsigned long logopens = 0;  /* opens seen in all logs, in order. */
+static unsigned long matched = 0;  /* ...that were of this archive. */
+
+
+static void fail(const char *what, const char *why)
+{
+    fprintf(stderr, "%s: %s\n", what, why);
+    exit(1);
+} /* fail */
+
+
+static void *xmalloc(const size_t len)
+{
+    void *retval = malloc(len ? len : 1);
+    if (retval == NULL)
+        fail("malloc", "Out of memory!");
+    return retval;
+} /* xmalloc */
+
+
+static unsigned long readLE32(const unsigned char *ptr)
+{
+    return ( ((unsigned long) ptr[0]) | (((unsigned long) ptr[1]) << 8) |
+             (((unsigned long) ptr[2]) << 16) |
+             (((unsigned long) ptr[3]) << 24) );
+} /* readLE32 */
+
+
+static unsigned int readLE16(const unsigned char *ptr)
+{
+    return ((unsigned int) ptr[0]) | (((unsigned int) ptr[1]) << 8);
+} /* readLE16 */
+
+
+static void writeLE32(unsigned char *ptr, const unsigned long val)
+{
+    ptr[0] = (unsigned char) (val & 0xFF);
+    ptr[1] = (unsigned char) ((val >> 8) & 0xFF);
+    ptr[2] = (unsigned char) ((val >> 16) & 0xFF);
+    ptr[3] = (unsigned char) ((val >> 24) & 0xFF);
+} /* writeLE32 */
+
+
+static void readAt(FILE *io, const unsigned long pos, void *buf,
+                   const size_t len, const char *fname)
+{
+    if (fseek(io, (long) pos, SEEK_SET) != 0)
+        fail(fname, "seek failed");
+    else if (fread(buf, len, 1, io) != 1)
+        fail(fname, "read failed, or the archive is truncated");
+} /* readAt */
+
+
+static char *dupName(const char *str, const size_t len)
+{
+    char *retval;
+    size_t skip = 0;
+    while ((skip < len) && (str[skip] == '/'))
+        skip++;
+    retval = (char *) xmalloc(len - skip + 1);
+    memcpy(retval, str + skip, len - skip);
+    retval[len - skip] = '\0';
+    return retval;
+} /* dupName */
+
+
+/* zip: find the end of central directory record, and the data's start. */
+static void loadZip(FILE *io, const char *fname, const unsigned long filelen)
+{
+    unsigned char buf[256 + 46];
+    unsigned char *tail;
+    unsigned long taillen = (filelen < 65536 + 22) ? filelen : 65536 + 22;
+    unsigned long eocd = 0;
+    unsigned long cdpos, cdlen, datastart, pos, i;
+    int found = 0;
+
+    if (filelen < 22)
+        fail(fname, "not a .zip or .grp file");
+
+    tail = (unsigned char *) xmalloc(taillen);
+    readAt(io, filelen - taillen, tail, taillen, fname);
+    for (i = taillen - 22 + 1; i > 0; i--)
+    {
+        if (readLE32(tail + i - 1) == 0x06054b50)
+        {
+            eocd = filelen - taillen + i - 1;
+            found = 1;
+            break;
+        } /* if */
+    } /* for */
+
+    if (!found)
+        fail(fname, "no end of central directory; not a .zip file?");
+
+    memcpy(buf, tail + (eocd - (filelen - taillen)), 22);
+    free(tail);
+
+    numentries = readLE16(buf + 10);
+    cdlen = readLE32(buf + 12);
+    cdpos = readLE32(buf + 16);
+    if ((numentries == 0xFFFF) || (cdlen == 0xFFFFFFFF) ||
+        (cdpos == 0xFFFFFFFF))
+        fail(fname, "Zip64 archives aren't supported");
+    else if (cdpos + cdlen > eocd)
+        fail(fname, "corrupt central directory");
+
+    /* anything before the entries (a self-extractor, say) is dropped. */
+    datastart = eocd - cdlen - cdpos;
+
+    entries = (Entry *) xmalloc(sizeof (Entry) * numentries);
+    memset(entries, '\0', sizeof (Entry) * numentries);
+    pos = datastart + cdpos;
+    for (i = 0; i < numentries; i++)
+    {
+        Entry *entry = &entries[i];
+        unsigned long namelen, extralen, commentlen, comp, local;
+        unsigned int flags;
+
+        readAt(io, pos, buf, 46, fname);
+        if (readLE32(buf) != 0x02014b50)
+            fail(fname, "corrupt central directory");
+
+        flags = readLE16(buf + 8);
+        comp = readLE32(buf + 20);
+        entry->size = readLE32(buf + 24);
+        namelen = readLE16(buf + 28);
+        extralen = readLE16(buf + 30);
+        commentlen = readLE16(buf + 32);
+        local = readLE32(buf + 42);
+        if ((comp == 0xFFFFFFFF) || (entry->size == 0xFFFFFFFF) ||
+            (local == 0xFFFFFFFF))
+            fail(fname, "Zip64 archives aren't supported");
+
+        entry->centrallen = 46 + namelen + extralen + commentlen;
+        entry->central = (unsigned char *) xmalloc(entry->centrallen);
+        readAt(io, pos, entry->central, entry->centrallen, fname);
+        entry->name = dupName((const char *) entry->central + 46, namelen);
+        entry->original = i;
+        pos += entry->centrallen;
+
+        /* the local header's extra field can differ from the central one. */
+        entry->offset = datastart + local;
+        readAt(io, entry->offset, buf, 30, fname);
+        if (readLE32(buf) != 0x04034b50)
+            fail(fname, "corrupt local file header");
+        entry->len = 30 + readLE16(buf + 26) + readLE16(buf + 28) + comp;
+
+        if (flags & 0x0008)  /* data descriptor, with optional signature. */
+        {
+            readAt(io, entry->offset + entry->len, buf, 4, fname);
+            entry->len += (readLE32(buf) == 0x08074b50) ? 16 : 12;
+        } /* if */
+
+        if (entry->offset + entry->len > eocd)
+            fail(fname, "entry runs past the end of the archive");
+    } /* for */
+} /* loadZip */
+
+
+static void loadGrp(FILE *io, const char *fname, const unsigned long filelen)
+{
+    unsigned char buf[16];
+    unsigned long pos, i;
+
+    readAt(io, 0, buf, 16, fname);
+    numentries = readLE32(buf + 12);
+    if (16 + (16 * numentries) > filelen)
+        fail(fname, "corrupt .grp file");
+
+    entries = (Entry *) xmalloc(sizeof (Entry) * numentries);
+    memset(entries, '\0', sizeof (Entry) * numentries);
+    pos = 16 + (16 * numentries);
+    for (i = 0; i < numentries; i++)
+    {
+        Entry *entry = &entries[i];
+        char *ptr;
+
+        readAt(io, 16 + (16 * i), buf, 16, fname);
+        entry->central = (unsigned char *) xmalloc(16);
+        entry->centrallen = 16;
+        memcpy(entry->central, buf, 16);
+        entry->name = dupName((const char *) buf, 12);  /* may be padded. */
+        if ((ptr = strchr(entry->name, ' ')) != NULL)
+            *ptr = '\0';  /* PhysicsFS trims these, too. */
+        entry->size = entry->len = readLE32(buf + 12);
+        entry->offset = pos;
+        entry->original = i;
+        pos += entry->len;
+        if (pos > filelen)
+            fail(fname, "entry runs past the end of the archive");
+    } /* for */
+} /* loadGrp */
+
+
+static int nameCmp(const void *a, const void *b)
+{
+    return strcmp((*(Entry **) a)->name, (*(Entry **) b)->name);
+} /* nameCmp */
+
+
+static int caseCmpStr(const char *a, const char *b)
+{
+    int ch1, ch2;
+    do
+    {
+        ch1 = tolower((unsigned char) *(a++));
+        ch2 = tolower((unsigned char) *(b++));
+    } while ((ch1 == ch2) && (ch1 != '\0'));
+    return ch1 - ch2;
+} /* caseCmpStr */
+
+
+static int caseCmp(const void *a, const void *b)
+{
+    return caseCmpStr((*(Entry **) a)->name, (*(Entry **) b)->name);
+} /* caseCmp */
+
+
+static Entry *searchEntry(Entry **list, const char *name,
+                          int (*cmp)(const char *, const char *))
+{
+    unsigned long lo = 0;
+    unsigned long hi = numentries;
+
+    while (lo < hi)
+    {
+        const unsigned long mid = lo + ((hi - lo) / 2);
+        const int rc = cmp(name, list[mid]->name);
+        if (rc == 0)
+            return list[mid];
+        else if (rc < 0)
+            hi = mid;
+        else
+            lo = mid + 1;
+    } /* while */
+
+    return NULL;
+} /* searchEntry */
+
+
+static Entry *findEntry(const char *name)
+{
+    Entry *retval = searchEntry(byname, name, strcmp);
+
+    /* .grp names are usually uppercase; the app may have asked otherwise. */
+    if (retval == NULL)
+        retval = searchEntry(bycase, name, caseCmpStr);
+
+    return retval;
+} /* findEntry */
+
+
+static const char *baseName(const char *path)
+{
+    const char *retval = path;
+    for (; *path; path++)
+    {
+        if ((*path == '/') || (*path == '\\'))
+            retval = path + 1;
+    } /* for */
+    return retval;
+} /* baseName */
+
+
+/* note the opens the log made of (archive); see PHYSFS_startAccessLog(). */
+static void loadLog(const char *fname, const char *archive,
+                    const char *mntpoint)
+{
+    const size_t mntlen = mntpoint ? strlen(mntpoint) : 0;
+    char line[4096];
+    FILE *io = fopen(fname, "r");
+    if (io == NULL)
+        fail(fname, "couldn't open access log");
+
+    while (fgets(line, sizeof (line), io) != NULL)
+    {
+        char *name;
+        char *from;
+        char *ptr;
+        Entry *entry;
+
+        if (strncmp(line, "open\t", 5) != 0)
+            continue;  /* reads and comments don't change the order. */
+        else if ((ptr = strchr(line, '\n')) != NULL)
+            *ptr = '\0';
+
+        name = strchr(line + 5, '\t');
+        from = name ? strchr(name + 1, '\t') : NULL;
+        if (from == NULL)
+            continue;
+        *(name++) = '\0';
+        *(from++) = '\0';
+
+        logopens++;
+        if ((archive != NULL) && (strcmp(baseName(from), archive) != 0))
+            continue;  /* some other archive served this. */
+
+        while (*name == '/')
+            name++;
+        if (mntlen > 0)
+        {
+            if (strncmp(name, mntpoint, mntlen) != 0)
+                continue;
+            name += mntlen;
+        } /* if */
+
+        if ((entry = findEntry(name)) != NULL)
+        {
+            matched++;
+            if (entry->opens++ == 0)
+                entry->first = logopens;
+        } /* if */
+    } /* while */
+
+    fclose(io);
+} /* loadLog */
+
+
+static int orderCmp(const void *_a, const void *_b)
+{
+    const Entry *a = (const Entry *) _a;
+    const Entry *b = (const Entry *) _b;
+
+    if (a->hot != b->hot)
+        return a->hot ? -1 : 1;
+    else if ((a->first != 0) != (b->first != 0))
+        return a->first ? -1 : 1;
+    else if (a->first != b->first)
+        return (a->first < b->first) ? -1 : 1;
+    return (a->original < b->original) ? -1 : 1;
+} /* orderCmp */
+
+
+static void copyBytes(FILE *in, FILE *out, unsigned long pos,
+                      unsigned long len, const char *fname)
+{
+    static unsigned char buf[64 * 1024];
+    while (len > 0)
+    {
+        const size_t cpy = (len > sizeof (buf)) ? sizeof (buf) : (size_t) len;
+        readAt(in, pos, buf, cpy, fname);
+        if (fwrite(buf, cpy, 1, out) != 1)
+            fail("fwrite", "write failed");
+        pos += cpy;
+        len -= cpy;
+    } /* while */
+} /* copyBytes */
+
+
+static void writeZip(FILE *in, FILE *out, const char *fname,
+                     const unsigned long filelen)
+{
+    unsigned char eocd[22];
+    unsigned long pos = 0;
+    unsigned long cdlen = 0;
+    unsigned long commentlen;
+    unsigned long i;
+
+    for (i = 0; i < numentries; i++)
+    {
+        Entry *entry = &entries[i];
+        writeLE32(entry->central + 42, pos);  /* its new local header. */
+        copyBytes(in, out, entry->offset, entry->len, fname);
+        pos += entry->len;
+    } /* for */
+
+    for (i = 0; i < numentries; i++)
+    {
+        if (fwrite(entries[i].central, entries[i].centrallen, 1, out) != 1)
+            fail("fwrite", "write failed");
+        cdlen += entries[i].centrallen;
+    } /* for */
+
+    /* find the original end record again, for its comment. */
+    for (i = filelen - 22 + 1; i > 0; i--)
+    {
+        readAt(in, i - 1, eocd, 4, fname);
+        if (readLE32(eocd) == 0x06054b50)
+            break;
+    } /* for */
+
+    readAt(in, i - 1, eocd, 22, fname);
+    commentlen = readLE16(eocd + 20);
+    eocd[4] = eocd[5] = eocd[6] = eocd[7] = 0;  /* single disk. */
+    eocd[8] = eocd[10] = (unsigned char) (numentries & 0xFF);
+    eocd[9] = eocd[11] = (unsigned char) ((numentries >> 8) & 0xFF);
+    writeLE32(eocd + 12, cdlen);
+    writeLE32(eocd + 16, pos);
+    if (fwrite(eocd, 22, 1, out) != 1)
+        fail("fwrite", "write failed");
+    copyBytes(in, out, i - 1 + 22, commentlen, fname);
+} /* writeZip */
+
+
+static void writeGrp(FILE *in, FILE *out, const char *fname)
+{
+    unsigned char buf[16];
+    unsigned long i;
+
+    readAt(in, 0, buf, 16, fname);
+    if (fwrite(buf, 16, 1, out) != 1)
+        fail("fwrite", "write failed");
+
+    for (i = 0; i < numentries; i++)
+    {
+        if (fwrite(entries[i].central, 16, 1, out) != 1)
+            fail("fwrite", "write failed");
+    } /* for */
+
+    for (i = 0; i < numentries; i++)
+        copyBytes(in, out, entries[i].offset, entries[i].len, fname);
+} /* writeGrp */
+
+
+static void usage(const char *argv0)
+{
+    fprintf(stderr,
+        "USAGE: %s [options] <in archive> <out archive> <log> [log...]\n"
+        "\n"
+        "  -s BYTES   files this size or smaller can be hot (default %d)\n"
+        "  -m DIR     the archive was mounted at DIR\n"
+        "  -a         use every open in the logs, whichever archive it came\n"
+        "             from; normally, only opens served by an archive with\n"
+        "             the same file name as <in archive> count.\n"
+        "\n"
+        "Logs come from PHYSFS_startAccessLog() and PHYSFS_stopAccessLog().\n",
+        argv0, SMALL_FILE_DEFAULT);
+    exit(1);
+} /* usage */
+
+
+int main(int argc, char **argv)
+{
+    unsigned long small = SMALL_FILE_DEFAULT;
+    const char *mntpoint = NULL;
+    char *mnt = NULL;
+    int anyarchive = 0;
+    unsigned long filelen, i, hot = 0, touched = 0;
+    unsigned char sig[12];
+    FILE *in;
+    FILE *out;
+    int argi;
+    int iszip;
+
+    for (argi = 1; (argi < argc) && (argv[argi][0] == '-'); argi++)
+    {
+        if ((strcmp(argv[argi], "-s") == 0) && (argi + 1 < argc))
+            small = strtoul(argv[++argi], NULL, 10);
+        else if ((strcmp(argv[argi], "-m") == 0) && (argi + 1 < argc))
+            mntpoint = argv[++argi];
+        else if (strcmp(argv[argi], "-a") == 0)
+            anyarchive = 1;
+        else
+            usage(argv[0]);
+    } /* for */
+
+    if (argc - argi < 3)
+        usage(argv[0]);
+
+    if ((in = fopen(argv[argi], "rb")) == NULL)
+        fail(argv[argi], "couldn't open archive");
+
+    if ((fseek(in, 0, SEEK_END) != 0) || ((long) (filelen = ftell(in)) < 0))
+        fail(argv[argi], "couldn't get file length");
+    else if (filelen < 16)
+        fail(argv[argi], "not a .zip or .grp file");
+
+    readAt(in, 0, sig, sizeof (sig), argv[argi]);
+    iszip = (memcmp(sig, "KenSilverman", 12) != 0);
+    if (iszip)
+        loadZip(in, argv[argi], filelen);
+    else
+        loadGrp(in, argv[argi], filelen);
+
+    byname = (Entry **) xmalloc(sizeof (Entry *) * numentries);
+    bycase = (Entry **) xmalloc(sizeof (Entry *) * numentries);
+    for (i = 0; i < numentries; i++)
+        byname[i] = bycase[i] = &entries[i];
+    qsort(byname, numentries, sizeof (Entry *), nameCmp);
+    qsort(bycase, numentries, sizeof (Entry *), caseCmp);
+
+    if (mntpoint != NULL)  /* match names as "dir/", no leading slash. */
+    {
+        size_t len;
+        while (*mntpoint == '/')
+            mntpoint++;
+        len = strlen(mntpoint);
+        mnt = (char *) xmalloc(len + 2);
+        strcpy(mnt, mntpoint);
+        if ((len > 0) && (mnt[len - 1] != '/'))
+            strcat(mnt, "/");
+        mntpoint = mnt;
+    } /* if */
+
+    for (i = argi + 2; i < (unsigned long) argc; i++)
+        loadLog(argv[i], anyarchive ? NULL : baseName(argv[argi]), mntpoint);
+
+    for (i = 0; i < numentries; i++)
+    {
+        Entry *entry = &entries[i];
+        if (entry->first != 0)
+            touched++;
+        if ((entry->opens > 1) && (entry->size <= small))
+        {
+            entry->hot = 1;
+            hot++;
+        } /* if */
+    } /* for */
+
+    free(byname);  /* sorting (entries) would leave these dangling. */
+    free(bycase);
+    byname = bycase = NULL;
+    qsort(entries, numentries, sizeof (Entry), orderCmp);
+
+    if ((out = fopen(argv[argi + 1], "wb")) == NULL)
+        fail(argv[argi + 1], "couldn't create output archive");
+
+    if (iszip)
+        writeZip(in, out, argv[argi], filelen);
+    else
+        writeGrp(in, out, argv[argi]);
+
+    if (fclose(out) != 0)
+        fail(argv[argi + 1], "write failed");
+    fclose(in);
+
+    printf("%lu opens in the logs, %lu of them from this archive.\n",
+           logopens, matched);
+    printf("%lu of %lu entries touched, %lu of them hot.\n",
+           touched, numentries, hot);
+
+    for (i = 0; i < numentries; i++)
+    {
+        free(entries[i].name);
+        free(entries[i].central);
+    } /* for */
+    free(entries);
+    free(mnt);
+
+    return 0;
+} /* main */
+
+/* end of physfsrepack.c ... */
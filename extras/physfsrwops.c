@@ -43,11 +43,41 @@
 #endif
 #endif
 
+/*
+ * Decoders (SDL_image, SDL_mixer, etc) tend to make lots of tiny reads and
+ *  seeks. Read handles get a PhysicsFS buffer of this size, so most of those
+ *  never leave memory. Define it to 0 before building this to turn that off.
+ */
+#ifndef PHYSFSRWOPS_BUFFER_SIZE
+#define PHYSFSRWOPS_BUFFER_SIZE (16 * 1024)
+#endif
+
+/*
+ * What's behind rw->hidden.unknown.data1. We keep the position and (for read
+ *  handles, which can't change size) the length ourselves, so seeks and size
+ *  queries don't have to ask PhysicsFS every time.
+ */
+typedef struct
+{
+    PHYSFS_File *handle;
+    PHYSFS_sint64 pos;
+    PHYSFS_sint64 len;  /* -1 if we have to ask. */
+} physfsrwops_data;
+
+
+static PHYSFS_sint64 physfsrwops_length(physfsrwops_data *data)
+{
+    if (data->len >= 0)
+        return data->len;
+    return PHYSFS_fileLength(data->handle);
+} /* physfsrwops_length */
+
+
 #if TARGET_SDL2
 static Sint64 SDLCALL physfsrwops_size(struct SDL_RWops *rw)
 {
-    PHYSFS_File *handle = (PHYSFS_File *) rw->hidden.unknown.data1;
-    return (Sint64) PHYSFS_fileLength(handle);
+    physfsrwops_data *data = (physfsrwops_data *) rw->hidden.unknown.data1;
+    return (Sint64) physfsrwops_length(data);
 } /* physfsrwops_size */
 #endif
 
@@ -58,7 +88,8 @@ static Sint64 SDLCALL physfsrwops_seek(struct SDL_RWops *rw, Sint64 offset, int
 static int physfsrwops_seek(SDL_RWops *rw, int offset, int whence)
 #endif
 {
-    PHYSFS_File *handle = (PHYSFS_File *) rw->hidden.unknown.data1;
+    physfsrwops_data *data = (physfsrwops_data *) rw->hidden.unknown.data1;
+    PHYSFS_File *handle = data->handle;
     PHYSFS_sint64 pos = 0;
 
     if (whence == RW_SEEK_SET)
@@ -66,13 +97,7 @@ static int physfsrwops_seek(SDL_RWops *rw, int offset, int whence)
 
     else if (whence == RW_SEEK_CUR)
     {
-        const PHYSFS_sint64 current = PHYSFS_tell(handle);
-        if (current == -1)
-        {
-            SDL_SetError("Can't find position in file: %s",
-                          PHYSFS_getErrorByCode(PHYSFS_getLastErrorCode()));
-            return -1;
-        } /* if */
+        const PHYSFS_sint64 current = data->pos;
 
         if (offset == 0)  /* this is a "tell" call. We're done. */
         {
@@ -88,7 +113,7 @@ static int physfsrwops_seek(SDL_RWops *rw, int offset, int whence)
 
     else if (whence == RW_SEEK_END)
     {
-        const PHYSFS_sint64 len = PHYSFS_fileLength(handle);
+        const PHYSFS_sint64 len = physfsrwops_length(data);
         if (len == -1)
         {
             SDL_SetError("Can't find end of file: %s", PHYSFS_getErrorByCode(PHYSFS_getLastErrorCode()));
@@ -110,12 +135,15 @@ static int physfsrwops_seek(SDL_RWops *rw, int offset, int whence)
         return -1;
     } /* if */
     
-    if (!PHYSFS_seek(handle, (PHYSFS_uint64) pos))
+    /* already there? Don't bother PhysicsFS. */
+    if ((pos != data->pos) && (!PHYSFS_seek(handle, (PHYSFS_uint64) pos)))
     {
         SDL_SetError("PhysicsFS error: %s", PHYSFS_getErrorByCode(PHYSFS_getLastErrorCode()));
         return -1;
     } /* if */
 
+    data->pos = pos;
+
     #if TARGET_SDL2
     return (Sint64) pos;
     #else
@@ -131,9 +159,13 @@ static size_t SDLCALL physfsrwops_read(struct SDL_RWops *rw, void *ptr,
 static int physfsrwops_read(SDL_RWops *rw, void *ptr, int size, int maxnum)
 #endif
 {
-    PHYSFS_File *handle = (PHYSFS_File *) rw->hidden.unknown.data1;
+    physfsrwops_data *data = (physfsrwops_data *) rw->hidden.unknown.data1;
+    PHYSFS_File *handle = data->handle;
     const PHYSFS_uint64 readlen = (PHYSFS_uint64) (maxnum * size);
     const PHYSFS_sint64 rc = PHYSFS_readBytes(handle, ptr, readlen);
+    if (rc > 0)
+        data->pos += rc;
+
     if (rc != ((PHYSFS_sint64) readlen))
     {
         if (!PHYSFS_eof(handle)) /* not EOF? Must be an error. */
@@ -163,9 +195,13 @@ static size_t SDLCALL physfsrwops_write(struct SDL_RWops *rw, const void *ptr,
 static int physfsrwops_write(SDL_RWops *rw, const void *ptr, int size, int num)
 #endif
 {
-    PHYSFS_File *handle = (PHYSFS_File *) rw->hidden.unknown.data1;
+    physfsrwops_data *data = (physfsrwops_data *) rw->hidden.unknown.data1;
+    PHYSFS_File *handle = data->handle;
     const PHYSFS_uint64 writelen = (PHYSFS_uint64) (num * size);
     const PHYSFS_sint64 rc = PHYSFS_writeBytes(handle, ptr, writelen);
+    if (rc > 0)
+        data->pos += rc;
+
     if (rc != ((PHYSFS_sint64) writelen))
         SDL_SetError("PhysicsFS error: %s", PHYSFS_getErrorByCode(PHYSFS_getLastErrorCode()));
 
@@ -179,51 +215,93 @@ static int physfsrwops_write(SDL_RWops *rw, const void *ptr, int size, int num)
 
 static int physfsrwops_close(SDL_RWops *rw)
 {
-    PHYSFS_File *handle = (PHYSFS_File *) rw->hidden.unknown.data1;
-    if (!PHYSFS_close(handle))
+    physfsrwops_data *data = (physfsrwops_data *) rw->hidden.unknown.data1;
+    if (!PHYSFS_close(data->handle))
     {
         SDL_SetError("PhysicsFS error: %s", PHYSFS_getErrorByCode(PHYSFS_getLastErrorCode()));
         return -1;
     } /* if */
 
+    SDL_free(data);
     SDL_FreeRW(rw);
     return 0;
 } /* physfsrwops_close */
 
 
-static SDL_RWops *create_rwops(PHYSFS_File *handle)
+static SDL_RWops *create_rwops(PHYSFS_File *handle, const int forReading)
 {
     SDL_RWops *retval = NULL;
+    physfsrwops_data *data;
 
     if (handle == NULL)
+    {
         SDL_SetError("PhysicsFS error: %s", PHYSFS_getErrorByCode(PHYSFS_getLastErrorCode()));
+        return NULL;
+    } /* if */
+
+    data = (physfsrwops_data *) SDL_malloc(sizeof (physfsrwops_data));
+    if (data == NULL)
+    {
+        SDL_OutOfMemory();
+        return NULL;
+    } /* if */
+
+    data->handle = handle;
+    data->pos = PHYSFS_tell(handle);
+    data->len = -1;
+    if (data->pos < 0)
+        data->pos = 0;
+
+    if (forReading)  /* read handles never change size. */
+    {
+        data->len = PHYSFS_fileLength(handle);
+
+        #if PHYSFSRWOPS_BUFFER_SIZE > 0
+        if (data->len != 0)  /* a failure here just means no buffer. */
+            PHYSFS_setBuffer(handle, PHYSFSRWOPS_BUFFER_SIZE);
+        #endif
+    } /* if */
+
+    retval = SDL_AllocRW();
+    if (retval == NULL)
+        SDL_free(data);
     else
     {
-        retval = SDL_AllocRW();
-        if (retval != NULL)
-        {
-            #if TARGET_SDL2
-            retval->size  = physfsrwops_size;
-            #endif
-            retval->seek  = physfsrwops_seek;
-            retval->read  = physfsrwops_read;
-            retval->write = physfsrwops_write;
-            retval->close = physfsrwops_close;
-            retval->hidden.unknown.data1 = handle;
-        } /* if */
+        #if TARGET_SDL2
+        retval->size  = physfsrwops_size;
+        #endif
+        retval->seek  = physfsrwops_seek;
+        retval->read  = physfsrwops_read;
+        retval->write = physfsrwops_write;
+        retval->close = physfsrwops_close;
+        retval->hidden.unknown.data1 = data;
     } /* else */
 
     return retval;
 } /* create_rwops */
 
 
+/* SDL's own close for a memory RWops, plus giving the mapping back. */
+static int physfsrwops_close_mapped(SDL_RWops *rw)
+{
+    const void *ptr = (const void *) rw->hidden.mem.base;
+    SDL_FreeRW(rw);
+    if (!PHYSFS_unmapFile(ptr))
+    {
+        SDL_SetError("PhysicsFS error: %s", PHYSFS_getErrorByCode(PHYSFS_getLastErrorCode()));
+        return -1;
+    } /* if */
+    return 0;
+} /* physfsrwops_close_mapped */
+
+
 SDL_RWops *PHYSFSRWOPS_makeRWops(PHYSFS_File *handle)
 {
     SDL_RWops *retval = NULL;
     if (handle == NULL)
         SDL_SetError("NULL pointer passed to PHYSFSRWOPS_makeRWops().");
     else
-        retval = create_rwops(handle);
+        retval = create_rwops(handle, 0);  /* could be either; don't guess. */
 
     return retval;
 } /* PHYSFSRWOPS_makeRWops */
@@ -231,19 +309,44 @@ SDL_RWops *PHYSFSRWOPS_makeRWops(PHYSFS_File *handle)
 
 SDL_RWops *PHYSFSRWOPS_openRead(const char *fname)
 {
-    return create_rwops(PHYSFS_openRead(fname));
+    return create_rwops(PHYSFS_openRead(fname), 1);
 } /* PHYSFSRWOPS_openRead */
 
 
+SDL_RWops *PHYSFSRWOPS_openReadMapped(const char *fname)
+{
+    const void *ptr = NULL;
+    PHYSFS_uint64 len = 0;
+    SDL_RWops *retval;
+
+    /* SDL_RWFromConstMem() won't take zero bytes, or more than an int. */
+    if ((!PHYSFS_mapFile(fname, &ptr, &len)) || (len == 0) ||
+        (len > 0x7FFFFFFF))
+    {
+        if (ptr != NULL)
+            PHYSFS_unmapFile(ptr);
+        return PHYSFSRWOPS_openRead(fname);  /* compressed, etc. */
+    } /* if */
+
+    retval = SDL_RWFromConstMem(ptr, (int) len);
+    if (retval == NULL)
+        PHYSFS_unmapFile(ptr);
+    else
+        retval->close = physfsrwops_close_mapped;
+
+    return retval;
+} /* PHYSFSRWOPS_openReadMapped */
+
+
 SDL_RWops *PHYSFSRWOPS_openWrite(const char *fname)
 {
-    return create_rwops(PHYSFS_openWrite(fname));
+    return create_rwops(PHYSFS_openWrite(fname), 0);
 } /* PHYSFSRWOPS_openWrite */
 
 
 SDL_RWops *PHYSFSRWOPS_openAppend(const char *fname)
 {
-    return create_rwops(PHYSFS_openAppend(fname));
+    return create_rwops(PHYSFS_openAppend(fname), 0);
 } /* PHYSFSRWOPS_openAppend */
 
 
@@ -35,7 +35,9 @@ extern "C" {
  * Open a platform-independent filename for reading, and make it accessible
  *  via an SDL_RWops structure. The file will be closed in PhysicsFS when the
  *  RWops is closed. PhysicsFS should be configured to your liking before
- *  opening files through this method.
+ *  opening files through this method. The handle gets a read buffer (see
+ *  PHYSFS_setBuffer() and PHYSFSRWOPS_BUFFER_SIZE in physfsrwops.c), since
+ *  SDL's decoders like to make lots of little reads.
  *
  *   @param filename File to open in platform-independent notation.
  *  @return A valid SDL_RWops structure on success, NULL on error. Specifics
@@ -43,6 +45,20 @@ extern "C" {
  */
 PHYSFS_DECL SDL_RWops *PHYSFSRWOPS_openRead(const char *fname);
 
+/**
+ * Like PHYSFSRWOPS_openRead(), but if the file is stored uncompressed in an
+ *  archive that PhysicsFS has in memory (see PHYSFS_mapFile()), you get an
+ *  SDL_RWFromConstMem() RWops over those bytes instead, so reads are just
+ *  memcpy() and never touch PhysicsFS. Closing the RWops gives the memory
+ *  back with PHYSFS_unmapFile(). Anything that can't be mapped is opened as
+ *  PHYSFSRWOPS_openRead() would.
+ *
+ *   @param filename File to open in platform-independent notation.
+ *  @return A valid SDL_RWops structure on success, NULL on error. Specifics
+ *           of the error can be gleaned from PHYSFS_getLastError().
+ */
+PHYSFS_DECL SDL_RWops *PHYSFSRWOPS_openReadMapped(const char *fname);
+
 /**
  * Open a platform-independent filename for writing, and make it accessible
  *  via an SDL_RWops structure. The file will be closed in PhysicsFS when the
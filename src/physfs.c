@@ -47,9 +47,24 @@ typedef struct __PHYSFS_DIRHANDLE__
     char *dirName;  /* Path to archive in platform-dependent notation. */
     char *mountPoint; /* Mountpoint in virtual file tree. */
     const PHYSFS_Archiver *funcs;  /* Ptr to archiver info for this handle. */
+    int indexable;  /* non-zero if contents can go in the searchPathIndex. */
+    int needsLock;  /* non-zero if calls to funcs must hold archiverLock. */
+    int ignoreCase;  /* non-zero if mounted while PHYSFS_ignoreCase() was on. */
+    void *watch;  /* from __PHYSFS_platformWatchDir(), for PHYSFS_watch(). */
+#if PHYSFS_SUPPORTS_STATS
+    PHYSFS_ArchiveStats stats;  /* for PHYSFS_getArchiveStats(). */
+#endif
     struct __PHYSFS_DIRHANDLE__ *next;  /* linked list stuff. */
 } DirHandle;
 
+/* bump one of a DirHandle's stats, if we keep them. */
+#if PHYSFS_SUPPORTS_STATS
+#define ARCHIVE_STAT_ADD(h, field, n) \
+    ((void) __PHYSFS_ATOMIC_ADD64(&((DirHandle *) (h))->stats.field, (n)))
+#else
+#define ARCHIVE_STAT_ADD(h, field, n) ((void) (n))
+#endif
+
 
 typedef struct __PHYSFS_FILEHANDLE__
 {
@@ -60,21 +75,55 @@ typedef struct __PHYSFS_FILEHANDLE__
     size_t bufsize;  /* Bufsize, if set (0 otherwise). Don't touch! */
     size_t buffill;  /* Buffer fill size. Don't touch! */
     size_t bufpos;  /* Buffer position. Don't touch! */
+    PHYSFS_uint8 readAhead;  /* Non-zero if (buffer) is ours, not the app's. */
+    PHYSFS_uint8 streak;  /* Unbuffered reads since open or the last seek. */
+    PHYSFS_uint64 bufstart;  /* File offset of buffer[0] if (readAhead). */
+    PHYSFS_uint8 *prefetch;  /* Next read-ahead window, if reading ahead. */
+    PHYSFS_AsyncRequest *prefetchReq;  /* Non-NULL while (prefetch) fills. */
+    const void *mapped;  /* Non-NULL if lent out by PHYSFS_mapFile(). */
+    __PHYSFS_WriteBehind *writeBehind;  /* Non-NULL if writes go out later. */
+    char *atomicName;  /* PHYSFS_openWriteAtomic() target, NULL otherwise. */
+    char *atomicTemp;  /* What we write instead; points into (atomicName). */
     struct __PHYSFS_FILEHANDLE__ *next;  /* linked list stuff. */
 } FileHandle;
 
+static __PHYSFS_POOL(fileHandlePool, FileHandle);
+
+
+typedef struct SearchPathIndexEntry
+{
+    __PHYSFS_DirTreeEntry tree;  /* manages the merged directory tree. */
+    DirHandle *dirHandle;  /* first indexed archive with this path. */
+} SearchPathIndexEntry;
+
 
+typedef struct
+{
+    char *path;              /* sanitized path, or NULL if slot unused. */
+    PHYSFS_uint32 hash;      /* __PHYSFS_hashString() of path. */
+    int generation;          /* entry is stale if != missCacheGeneration. */
+} MissCacheEntry;
+
+
+#ifndef __PHYSFS_THREAD_LOCAL
 typedef struct __PHYSFS_ERRSTATETYPE__
 {
     void *tid;
     PHYSFS_ErrorCode code;
     struct __PHYSFS_ERRSTATETYPE__ *next;
 } ErrState;
+#endif
 
 
 /* General PhysicsFS state ... */
 static int initialized = 0;
+#ifdef __PHYSFS_THREAD_LOCAL
+static __PHYSFS_THREAD_LOCAL PHYSFS_ErrorCode threadErrorCode = PHYSFS_ERR_OK;
+static __PHYSFS_THREAD_LOCAL int threadErrorGeneration = 0;
+static volatile int errorGeneration = 1;  /* threadErrorCode valid if equal. */
+#else
 static ErrState *errorStates = NULL;
+#endif
 static DirHandle *searchPath = NULL;
 static DirHandle *writeDir = NULL;
 static FileHandle *openWriteList = NULL;
@@ -82,14 +131,31 @@ static FileHandle *openReadList = NULL;
 static char *baseDir = NULL;
 static char *userDir = NULL;
 static char *prefDir = NULL;
+static char *indexCacheDir = NULL;
 static int allowSymLinks = 0;
+static int indexSearchPath = 0;
+static int ignoreCase = 0;
+static int snapshotDirs = 0;
+static PHYSFS_WatchCallback watchCallback = NULL;
+static void *watchCallbackData = NULL;
+static PHYSFS_uint64 seekCheckpointInterval = 0;
+static PHYSFS_uint64 readAheadMax = 0;
+static int verifyChecksums = 0;
+static __PHYSFS_DirTree *searchPathIndex = NULL;
+static MissCacheEntry *missCache = NULL;
+static PHYSFS_uint32 missCacheSize = 0;  /* entries; zero if disabled. */
+static volatile int missCacheGeneration = 0;
 static PHYSFS_Archiver **archivers = NULL;
 static PHYSFS_ArchiveInfo **archiveInfo = NULL;
 static volatile size_t numArchivers = 0;
 
 /* mutexes ... */
 static void *errorLock = NULL;     /* protects error message list.        */
-static void *stateLock = NULL;     /* protects other PhysFS static state. */
+static void *stateLock = NULL;     /* rwlock for other PhysFS static state. */
+static void *fileListLock = NULL;  /* protects openReadList/openWriteList. */
+static void *archiverLock = NULL;  /* serializes external archivers.      */
+static void *missCacheLock = NULL; /* protects missCache's entries.       */
+static void *poolLock = NULL;      /* protects the __PHYSFS_Pool freelists. */
 
 /* allocator ... */
 static int externalAllocator = 0;
@@ -100,10 +166,11 @@ PHYSFS_Allocator allocator;
 static inline int __PHYSFS_atomicAdd(int *ptrval, const int val)
 {
     int retval;
-    __PHYSFS_platformGrabMutex(stateLock);
-    retval = *ptrval;
-    *ptrval = retval + val;
-    __PHYSFS_platformReleaseMutex(stateLock);
+    /* errorLock is never held while calling out to anything else. */
+    __PHYSFS_platformGrabMutex(errorLock);
+    retval = *ptrval + val;  /* like the intrinsics, return the new value. */
+    *ptrval = retval;
+    __PHYSFS_platformReleaseMutex(errorLock);
     return retval;
 } /* __PHYSFS_atomicAdd */
 
@@ -130,6 +197,8 @@ typedef struct __PHYSFS_NativeIoInfo
     int mode;   /* 'r', 'w', or 'a' */
 } NativeIoInfo;
 
+static __PHYSFS_POOL(nativeIoInfoPool, NativeIoInfo);
+
 static PHYSFS_sint64 nativeIo_read(PHYSFS_Io *io, void *buf, PHYSFS_uint64 len)
 {
     NativeIoInfo *info = (NativeIoInfo *) io->opaque;
@@ -161,6 +230,13 @@ static PHYSFS_sint64 nativeIo_length(PHYSFS_Io *io)
     return __PHYSFS_platformFileLength(info->handle);
 } /* nativeIo_length */
 
+static PHYSFS_sint64 nativeIo_readAt(PHYSFS_Io *io, PHYSFS_uint64 offset,
+                                     void *buf, PHYSFS_uint64 len)
+{
+    NativeIoInfo *info = (NativeIoInfo *) io->opaque;
+    return __PHYSFS_platformReadAt(info->handle, offset, buf, len);
+} /* nativeIo_readAt */
+
 static PHYSFS_Io *nativeIo_duplicate(PHYSFS_Io *io)
 {
     NativeIoInfo *info = (NativeIoInfo *) io->opaque;
@@ -178,8 +254,8 @@ static void nativeIo_destroy(PHYSFS_Io *io)
     NativeIoInfo *info = (NativeIoInfo *) io->opaque;
     __PHYSFS_platformClose(info->handle);
     allocator.Free((void *) info->path);
-    allocator.Free(info);
-    allocator.Free(io);
+    __PHYSFS_poolFree(&nativeIoInfoPool, info);
+    __PHYSFS_poolFree(&__PHYSFS_ioPool, io);
 } /* nativeIo_destroy */
 
 static const PHYSFS_Io __PHYSFS_nativeIoInterface =
@@ -192,7 +268,8 @@ static const PHYSFS_Io __PHYSFS_nativeIoInterface =
     nativeIo_length,
     nativeIo_duplicate,
     nativeIo_flush,
-    nativeIo_destroy
+    nativeIo_destroy,
+    nativeIo_readAt
 };
 
 PHYSFS_Io *__PHYSFS_createNativeIo(const char *path, const int mode)
@@ -204,10 +281,10 @@ PHYSFS_Io *__PHYSFS_createNativeIo(const char *path, const int mode)
 
     assert((mode == 'r') || (mode == 'w') || (mode == 'a'));
 
-    io = (PHYSFS_Io *) allocator.Malloc(sizeof (PHYSFS_Io));
-    GOTO_IF(!io, PHYSFS_ERR_OUT_OF_MEMORY, createNativeIo_failed);
-    info = (NativeIoInfo *) allocator.Malloc(sizeof (NativeIoInfo));
-    GOTO_IF(!info, PHYSFS_ERR_OUT_OF_MEMORY, createNativeIo_failed);
+    io = (PHYSFS_Io *) __PHYSFS_poolAlloc(&__PHYSFS_ioPool);
+    GOTO_IF_ERRPASS(!io, createNativeIo_failed);
+    info = (NativeIoInfo *) __PHYSFS_poolAlloc(&nativeIoInfoPool);
+    GOTO_IF_ERRPASS(!info, createNativeIo_failed);
     pathdup = (char *) allocator.Malloc(strlen(path) + 1);
     GOTO_IF(!pathdup, PHYSFS_ERR_OUT_OF_MEMORY, createNativeIo_failed);
 
@@ -231,12 +308,64 @@ PHYSFS_Io *__PHYSFS_createNativeIo(const char *path, const int mode)
 createNativeIo_failed:
     if (handle != NULL) __PHYSFS_platformClose(handle);
     if (pathdup != NULL) allocator.Free(pathdup);
-    if (info != NULL) allocator.Free(info);
-    if (io != NULL) allocator.Free(io);
+    __PHYSFS_poolFree(&nativeIoInfoPool, info);
+    __PHYSFS_poolFree(&__PHYSFS_ioPool, io);
     return NULL;
 } /* __PHYSFS_createNativeIo */
 
 
+/* platform handle behind (io), or NULL if it isn't a native Io for reading. */
+static void *nativeIoReadHandle(PHYSFS_Io *io)
+{
+    const NativeIoInfo *info;
+    if (io->read != nativeIo_read)
+        return NULL;
+    info = (const NativeIoInfo *) io->opaque;
+    return (info->mode == 'r') ? info->handle : NULL;
+} /* nativeIoReadHandle */
+
+
+void __PHYSFS_finishReadsAt(__PHYSFS_PlatformRead *reads,
+                            PHYSFS_uint32 count)
+{
+    PHYSFS_uint32 i;
+
+    for (i = 0; i < count; i++)
+    {
+        __PHYSFS_PlatformRead *r = &reads[i];
+        PHYSFS_uint8 *ptr = ((PHYSFS_uint8 *) r->buffer) + r->result;
+        PHYSFS_uint64 remaining = r->len - (PHYSFS_uint64) r->result;
+
+        assert(r->result >= 0);
+        assert(((PHYSFS_uint64) r->result) <= r->len);
+
+        r->error = PHYSFS_ERR_OK;
+        while (remaining > 0)
+        {
+            const PHYSFS_uint64 pos = r->pos + (PHYSFS_uint64) r->result;
+            const PHYSFS_sint64 rc = __PHYSFS_platformReadAt(r->opaque, pos,
+                                                             ptr, remaining);
+            if (rc < 0)
+            {
+                r->error = PHYSFS_getLastErrorCode();
+                if (r->error == PHYSFS_ERR_OK)
+                    r->error = PHYSFS_ERR_IO;
+                r->result = -1;
+                break;
+            } /* if */
+            else if (rc == 0)
+            {
+                break;  /* EOF. */
+            } /* else if */
+
+            ptr += rc;
+            remaining -= (PHYSFS_uint64) rc;
+            r->result += rc;
+        } /* while */
+    } /* for */
+} /* __PHYSFS_finishReadsAt */
+
+
 /* PHYSFS_Io implementation for i/o to a memory buffer... */
 
 typedef struct __PHYSFS_MemoryIoInfo
@@ -247,8 +376,11 @@ typedef struct __PHYSFS_MemoryIoInfo
     PHYSFS_Io *parent;
     int refcount;
     void (*destruct)(void *);
+    void *mapping;  /* non-NULL if (buf) is a mapped file. See below. */
 } MemoryIoInfo;
 
+static __PHYSFS_POOL(memoryIoInfoPool, MemoryIoInfo);
+
 static PHYSFS_sint64 memoryIo_read(PHYSFS_Io *io, void *buf, PHYSFS_uint64 len)
 {
     MemoryIoInfo *info = (MemoryIoInfo *) io->opaque;
@@ -292,6 +424,21 @@ static PHYSFS_sint64 memoryIo_length(PHYSFS_Io *io)
     return (PHYSFS_sint64) info->len;
 } /* memoryIo_length */
 
+static PHYSFS_sint64 memoryIo_readAt(PHYSFS_Io *io, PHYSFS_uint64 offset,
+                                     void *buf, PHYSFS_uint64 len)
+{
+    const MemoryIoInfo *info = (const MemoryIoInfo *) io->opaque;
+
+    if (offset >= info->len)
+        return 0;  /* at or past EOF; nothing to do. */
+
+    if (len > info->len - offset)
+        len = info->len - offset;
+
+    memcpy(buf, info->buf + offset, (size_t) len);
+    return len;
+} /* memoryIo_readAt */
+
 static PHYSFS_Io *memoryIo_duplicate(PHYSFS_Io *io)
 {
     MemoryIoInfo *info = (MemoryIoInfo *) io->opaque;
@@ -304,17 +451,26 @@ static PHYSFS_Io *memoryIo_duplicate(PHYSFS_Io *io)
 
     /* share the buffer between duplicates. */
     if (parent != NULL)  /* dup the parent, increment its refcount. */
-        return parent->duplicate(parent);
+    {
+        retval = parent->duplicate(parent);
+        if (retval != NULL)  /* we might be a subrange of the parent. */
+        {
+            newinfo = (MemoryIoInfo *) retval->opaque;
+            newinfo->buf = info->buf;
+            newinfo->len = info->len;
+        } /* if */
+        return retval;
+    } /* if */
 
     /* we're the parent. */
 
-    retval = (PHYSFS_Io *) allocator.Malloc(sizeof (PHYSFS_Io));
-    BAIL_IF(!retval, PHYSFS_ERR_OUT_OF_MEMORY, NULL);
-    newinfo = (MemoryIoInfo *) allocator.Malloc(sizeof (MemoryIoInfo));
+    retval = (PHYSFS_Io *) __PHYSFS_poolAlloc(&__PHYSFS_ioPool);
+    BAIL_IF_ERRPASS(!retval, NULL);
+    newinfo = (MemoryIoInfo *) __PHYSFS_poolAlloc(&memoryIoInfoPool);
     if (!newinfo)
     {
-        allocator.Free(retval);
-        BAIL(PHYSFS_ERR_OUT_OF_MEMORY, NULL);
+        __PHYSFS_poolFree(&__PHYSFS_ioPool, retval);
+        BAIL_ERRPASS(NULL);
     } /* if */
 
     __PHYSFS_ATOMIC_INCR(&info->refcount);
@@ -341,12 +497,13 @@ static void memoryIo_destroy(PHYSFS_Io *io)
 
     if (parent != NULL)
     {
-        assert(info->buf == ((MemoryIoInfo *) info->parent->opaque)->buf);
-        assert(info->len == ((MemoryIoInfo *) info->parent->opaque)->len);
+        const MemoryIoInfo *pinfo = (MemoryIoInfo *) info->parent->opaque;
+        assert(info->buf >= pinfo->buf);
+        assert(info->buf + info->len <= pinfo->buf + pinfo->len);
         assert(info->refcount == 0);
         assert(info->destruct == NULL);
-        allocator.Free(info);
-        allocator.Free(io);
+        __PHYSFS_poolFree(&memoryIoInfoPool, info);
+        __PHYSFS_poolFree(&__PHYSFS_ioPool, io);
         parent->destroy(parent);  /* decrements refcount. */
         return;
     } /* if */
@@ -358,11 +515,14 @@ static void memoryIo_destroy(PHYSFS_Io *io)
     {
         void (*destruct)(void *) = info->destruct;
         void *buf = (void *) info->buf;
+        void *mapping = info->mapping;
         io->opaque = NULL;  /* kill this here in case of race. */
-        allocator.Free(info);
-        allocator.Free(io);
+        __PHYSFS_poolFree(&memoryIoInfoPool, info);
+        __PHYSFS_poolFree(&__PHYSFS_ioPool, io);
         if (destruct != NULL)
             destruct(buf);
+        if (mapping != NULL)
+            __PHYSFS_platformUnmapFile(mapping);
     } /* if */
 } /* memoryIo_destroy */
 
@@ -377,7 +537,8 @@ static const PHYSFS_Io __PHYSFS_memoryIoInterface =
     memoryIo_length,
     memoryIo_duplicate,
     memoryIo_flush,
-    memoryIo_destroy
+    memoryIo_destroy,
+    memoryIo_readAt
 };
 
 PHYSFS_Io *__PHYSFS_createMemoryIo(const void *buf, PHYSFS_uint64 len,
@@ -386,10 +547,10 @@ PHYSFS_Io *__PHYSFS_createMemoryIo(const void *buf, PHYSFS_uint64 len,
     PHYSFS_Io *io = NULL;
     MemoryIoInfo *info = NULL;
 
-    io = (PHYSFS_Io *) allocator.Malloc(sizeof (PHYSFS_Io));
-    GOTO_IF(!io, PHYSFS_ERR_OUT_OF_MEMORY, createMemoryIo_failed);
-    info = (MemoryIoInfo *) allocator.Malloc(sizeof (MemoryIoInfo));
-    GOTO_IF(!info, PHYSFS_ERR_OUT_OF_MEMORY, createMemoryIo_failed);
+    io = (PHYSFS_Io *) __PHYSFS_poolAlloc(&__PHYSFS_ioPool);
+    GOTO_IF_ERRPASS(!io, createMemoryIo_failed);
+    info = (MemoryIoInfo *) __PHYSFS_poolAlloc(&memoryIoInfoPool);
+    GOTO_IF_ERRPASS(!info, createMemoryIo_failed);
 
     memset(info, '\0', sizeof (*info));
     info->buf = (const PHYSFS_uint8 *) buf;
@@ -404,12 +565,205 @@ PHYSFS_Io *__PHYSFS_createMemoryIo(const void *buf, PHYSFS_uint64 len,
     return io;
 
 createMemoryIo_failed:
-    if (info != NULL) allocator.Free(info);
-    if (io != NULL) allocator.Free(io);
+    __PHYSFS_poolFree(&memoryIoInfoPool, info);
+    __PHYSFS_poolFree(&__PHYSFS_ioPool, io);
     return NULL;
 } /* __PHYSFS_createMemoryIo */
 
 
+/*
+ * A mapped file is just a memory Io that unmaps instead of calling a destruct
+ *  callback, so archives opened this way get reads without syscalls, cheap
+ *  duplicates, and __PHYSFS_ioMappedRange() for free.
+ */
+PHYSFS_Io *__PHYSFS_createMappedNativeIo(const char *path)
+{
+    PHYSFS_Io *io = NULL;
+    void *mapping = NULL;
+    const void *ptr = NULL;
+    PHYSFS_uint64 len = 0;
+    void *handle = __PHYSFS_platformOpenRead(path);
+
+    BAIL_IF_ERRPASS(!handle, NULL);
+    mapping = __PHYSFS_platformMapFile(handle, &ptr, &len);
+    __PHYSFS_platformClose(handle);
+    BAIL_IF_ERRPASS(!mapping, NULL);
+
+    io = __PHYSFS_createMemoryIo(ptr, len, NULL);
+    if (!io)
+    {
+        __PHYSFS_platformUnmapFile(mapping);
+        return NULL;
+    } /* if */
+
+    ((MemoryIoInfo *) io->opaque)->mapping = mapping;
+    return io;
+} /* __PHYSFS_createMappedNativeIo */
+
+
+const void *__PHYSFS_ioMappedRange(PHYSFS_Io *io, const PHYSFS_uint64 pos,
+                                   const PHYSFS_uint64 len)
+{
+    const MemoryIoInfo *info;
+
+    if (io->read != memoryIo_read)
+        return NULL;  /* not a memory Io, can't do it. */
+
+    info = (const MemoryIoInfo *) io->opaque;
+    if ((pos > info->len) || (len > (info->len - pos)))
+        return NULL;
+
+    return info->buf + pos;
+} /* __PHYSFS_ioMappedRange */
+
+
+PHYSFS_Io *__PHYSFS_ioMappedSubrange(PHYSFS_Io *io, const PHYSFS_uint64 pos,
+                                     const PHYSFS_uint64 len)
+{
+    const PHYSFS_uint8 *ptr = __PHYSFS_ioMappedRange(io, pos, len);
+    PHYSFS_Io *retval;
+    MemoryIoInfo *info;
+
+    if (ptr == NULL)
+        return NULL;  /* caller will do it the slow way. */
+
+    /* a duplicate holds a reference, so the buffer outlives the archive. */
+    retval = io->duplicate(io);
+    BAIL_IF_ERRPASS(!retval, NULL);
+    info = (MemoryIoInfo *) retval->opaque;
+    info->buf = ptr;
+    info->len = len;
+    info->pos = 0;
+    return retval;
+} /* __PHYSFS_ioMappedSubrange */
+
+
+/*
+ * PHYSFS_Io implementation for a private read position over another
+ *  PHYSFS_Io's readAt(), so any number of these can share one parent (and
+ *  its file handle) from any number of threads. The parent must outlive
+ *  them. See __PHYSFS_ioShare().
+ */
+
+typedef struct
+{
+    PHYSFS_Io *parent;
+    PHYSFS_uint64 len;
+    PHYSFS_uint64 pos;
+} ShareIoInfo;
+
+static __PHYSFS_POOL(shareIoInfoPool, ShareIoInfo);
+
+static PHYSFS_sint64 shareIo_read(PHYSFS_Io *io, void *buf, PHYSFS_uint64 len)
+{
+    ShareIoInfo *info = (ShareIoInfo *) io->opaque;
+    PHYSFS_Io *parent = info->parent;
+    const PHYSFS_sint64 rc = parent->readAt(parent, info->pos, buf, len);
+    if (rc > 0)
+        info->pos += (PHYSFS_uint64) rc;
+    return rc;
+} /* shareIo_read */
+
+static PHYSFS_sint64 shareIo_write(PHYSFS_Io *io, const void *buffer,
+                                   PHYSFS_uint64 len)
+{
+    BAIL(PHYSFS_ERR_OPEN_FOR_READING, -1);
+} /* shareIo_write */
+
+static int shareIo_seek(PHYSFS_Io *io, PHYSFS_uint64 offset)
+{
+    ShareIoInfo *info = (ShareIoInfo *) io->opaque;
+    BAIL_IF(offset > info->len, PHYSFS_ERR_PAST_EOF, 0);
+    info->pos = offset;
+    return 1;
+} /* shareIo_seek */
+
+static PHYSFS_sint64 shareIo_tell(PHYSFS_Io *io)
+{
+    return (PHYSFS_sint64) ((ShareIoInfo *) io->opaque)->pos;
+} /* shareIo_tell */
+
+static PHYSFS_sint64 shareIo_length(PHYSFS_Io *io)
+{
+    return (PHYSFS_sint64) ((ShareIoInfo *) io->opaque)->len;
+} /* shareIo_length */
+
+static PHYSFS_Io *shareIo_duplicate(PHYSFS_Io *io)
+{
+    return __PHYSFS_ioShare(((ShareIoInfo *) io->opaque)->parent);
+} /* shareIo_duplicate */
+
+static int shareIo_flush(PHYSFS_Io *io) { return 1;  /* it's read-only. */ }
+
+static void shareIo_destroy(PHYSFS_Io *io)
+{
+    __PHYSFS_poolFree(&shareIoInfoPool, io->opaque);
+    __PHYSFS_poolFree(&__PHYSFS_ioPool, io);
+} /* shareIo_destroy */
+
+static PHYSFS_sint64 shareIo_readAt(PHYSFS_Io *io, PHYSFS_uint64 offset,
+                                    void *buf, PHYSFS_uint64 len)
+{
+    PHYSFS_Io *parent = ((ShareIoInfo *) io->opaque)->parent;
+    return parent->readAt(parent, offset, buf, len);
+} /* shareIo_readAt */
+
+static const PHYSFS_Io __PHYSFS_shareIoInterface =
+{
+    CURRENT_PHYSFS_IO_API_VERSION, NULL,
+    shareIo_read,
+    shareIo_write,
+    shareIo_seek,
+    shareIo_tell,
+    shareIo_length,
+    shareIo_duplicate,
+    shareIo_flush,
+    shareIo_destroy,
+    shareIo_readAt
+};
+
+
+int __PHYSFS_ioCanReadAt(const PHYSFS_Io *io)
+{
+    return ((io->version >= 1) && (io->readAt != NULL));
+} /* __PHYSFS_ioCanReadAt */
+
+
+PHYSFS_Io *__PHYSFS_ioShare(PHYSFS_Io *io)
+{
+    PHYSFS_Io *retval;
+    ShareIoInfo *info;
+    PHYSFS_sint64 len;
+
+    /* memory Io duplicates are already this cheap, and stay mappable. */
+    if ((!__PHYSFS_ioCanReadAt(io)) || (io->read == memoryIo_read))
+        return io->duplicate(io);
+
+    /* views of views would just add a hop; share the real parent. */
+    if (io->read == shareIo_read)
+        io = ((ShareIoInfo *) io->opaque)->parent;
+
+    len = io->length(io);
+    BAIL_IF_ERRPASS(len < 0, NULL);
+
+    retval = (PHYSFS_Io *) __PHYSFS_poolAlloc(&__PHYSFS_ioPool);
+    BAIL_IF_ERRPASS(!retval, NULL);
+    info = (ShareIoInfo *) __PHYSFS_poolAlloc(&shareIoInfoPool);
+    if (!info)
+    {
+        __PHYSFS_poolFree(&__PHYSFS_ioPool, retval);
+        BAIL_ERRPASS(NULL);
+    } /* if */
+
+    info->parent = io;
+    info->len = (PHYSFS_uint64) len;
+    info->pos = 0;
+    memcpy(retval, &__PHYSFS_shareIoInterface, sizeof (*retval));
+    retval->opaque = info;
+    return retval;
+} /* __PHYSFS_ioShare */
+
+
 /* PHYSFS_Io implementation for i/o to a PHYSFS_File... */
 
 static PHYSFS_sint64 handleIo_read(PHYSFS_Io *io, void *buf, PHYSFS_uint64 len)
@@ -445,14 +799,14 @@ static PHYSFS_Io *handleIo_duplicate(PHYSFS_Io *io)
      *  abstraction. We're allowed to: we're physfs.c!
      */
     FileHandle *origfh = (FileHandle *) io->opaque;
-    FileHandle *newfh = (FileHandle *) allocator.Malloc(sizeof (FileHandle));
+    FileHandle *newfh = (FileHandle *) __PHYSFS_poolAlloc(&fileHandlePool);
     PHYSFS_Io *retval = NULL;
 
-    GOTO_IF(!newfh, PHYSFS_ERR_OUT_OF_MEMORY, handleIo_dupe_failed);
+    GOTO_IF_ERRPASS(!newfh, handleIo_dupe_failed);
     memset(newfh, '\0', sizeof (*newfh));
 
-    retval = (PHYSFS_Io *) allocator.Malloc(sizeof (PHYSFS_Io));
-    GOTO_IF(!retval, PHYSFS_ERR_OUT_OF_MEMORY, handleIo_dupe_failed);
+    retval = (PHYSFS_Io *) __PHYSFS_poolAlloc(&__PHYSFS_ioPool);
+    GOTO_IF_ERRPASS(!retval, handleIo_dupe_failed);
 
 #if 0  /* we don't buffer the duplicate, at least not at the moment. */
     if (origfh->buffer != NULL)
@@ -470,7 +824,7 @@ static PHYSFS_Io *handleIo_duplicate(PHYSFS_Io *io)
     newfh->forReading = origfh->forReading;
     newfh->dirHandle = origfh->dirHandle;
 
-    __PHYSFS_platformGrabMutex(stateLock);
+    __PHYSFS_platformGrabMutex(fileListLock);
     if (newfh->forReading)
     {
         newfh->next = openReadList;
@@ -481,7 +835,7 @@ static PHYSFS_Io *handleIo_duplicate(PHYSFS_Io *io)
         newfh->next = openWriteList;
         openWriteList = newfh;
     } /* else */
-    __PHYSFS_platformReleaseMutex(stateLock);
+    __PHYSFS_platformReleaseMutex(fileListLock);
 
     memcpy(retval, io, sizeof (PHYSFS_Io));
     retval->opaque = newfh;
@@ -492,9 +846,10 @@ handleIo_dupe_failed:
     {
         if (newfh->io != NULL) newfh->io->destroy(newfh->io);
         if (newfh->buffer != NULL) allocator.Free(newfh->buffer);
-        allocator.Free(newfh);
+        __PHYSFS_poolFree(&fileHandlePool, newfh);
     } /* if */
 
+    __PHYSFS_poolFree(&__PHYSFS_ioPool, retval);
     return NULL;
 } /* handleIo_duplicate */
 
@@ -507,7 +862,7 @@ static void handleIo_destroy(PHYSFS_Io *io)
 {
     if (io->opaque != NULL)
         PHYSFS_close((PHYSFS_File *) io->opaque);
-    allocator.Free(io);
+    __PHYSFS_poolFree(&__PHYSFS_ioPool, io);
 } /* handleIo_destroy */
 
 static const PHYSFS_Io __PHYSFS_handleIoInterface =
@@ -520,13 +875,14 @@ static const PHYSFS_Io __PHYSFS_handleIoInterface =
     handleIo_length,
     handleIo_duplicate,
     handleIo_flush,
-    handleIo_destroy
+    handleIo_destroy,
+    NULL  /* PHYSFS_File has a position and a buffer; no readAt(). */
 };
 
 static PHYSFS_Io *__PHYSFS_createHandleIo(PHYSFS_File *f)
 {
-    PHYSFS_Io *io = (PHYSFS_Io *) allocator.Malloc(sizeof (PHYSFS_Io));
-    BAIL_IF(!io, PHYSFS_ERR_OUT_OF_MEMORY, NULL);
+    PHYSFS_Io *io = (PHYSFS_Io *) __PHYSFS_poolAlloc(&__PHYSFS_ioPool);
+    BAIL_IF_ERRPASS(!io, NULL);
     memcpy(io, &__PHYSFS_handleIoInterface, sizeof (*io));
     io->opaque = f;
     return io;
@@ -539,34 +895,48 @@ typedef struct
 {
     char **list;
     PHYSFS_uint32 size;
+    PHYSFS_uint32 capacity;  /* (list) has room for this many, plus a NULL. */
     PHYSFS_ErrorCode errcode;
 } EnumStringListCallbackData;
 
-static void enumStringListCallback(void *data, const char *str)
+/* Append a copy of (str) to the list. Grows geometrically. */
+static int appendStringList(EnumStringListCallbackData *pecd, const char *str)
 {
-    void *ptr;
+    const size_t len = strlen(str) + 1;
     char *newstr;
+
+    if (pecd->size >= pecd->capacity)
+    {
+        const PHYSFS_uint32 newcap = pecd->capacity ? pecd->capacity * 2 : 32;
+        void *ptr;
+        BAIL_IF(newcap <= pecd->capacity, PHYSFS_ERR_OUT_OF_MEMORY, 0);
+        ptr = allocator.Realloc(pecd->list, (newcap + 1) * sizeof (char *));
+        BAIL_IF(!ptr, PHYSFS_ERR_OUT_OF_MEMORY, 0);
+        pecd->list = (char **) ptr;
+        pecd->capacity = newcap;
+    } /* if */
+
+    newstr = (char *) allocator.Malloc(len);
+    BAIL_IF(!newstr, PHYSFS_ERR_OUT_OF_MEMORY, 0);
+    memcpy(newstr, str, len);
+    pecd->list[pecd->size++] = newstr;
+    return 1;
+} /* appendStringList */
+
+static void enumStringListCallback(void *data, const char *str)
+{
     EnumStringListCallbackData *pecd = (EnumStringListCallbackData *) data;
 
     if (pecd->errcode)
         return;
 
-    ptr = allocator.Realloc(pecd->list, (pecd->size + 2) * sizeof (char *));
-    newstr = (char *) allocator.Malloc(strlen(str) + 1);
-    if (ptr != NULL)
-        pecd->list = (char **) ptr;
-
-    if ((ptr == NULL) || (newstr == NULL))
+    if (!appendStringList(pecd, str))
     {
         pecd->errcode = PHYSFS_ERR_OUT_OF_MEMORY;
         pecd->list[pecd->size] = NULL;
         PHYSFS_freeList(pecd->list);
         return;
     } /* if */
-
-    strcpy(newstr, str);
-    pecd->list[pecd->size] = newstr;
-    pecd->size++;
 } /* enumStringListCallback */
 
 
@@ -662,6 +1032,43 @@ void __PHYSFS_sort(void *entries, size_t max,
 } /* __PHYSFS_sort */
 
 
+#ifdef __PHYSFS_THREAD_LOCAL
+
+/* this doesn't reset the error state. */
+static inline PHYSFS_ErrorCode currentErrorCode(void)
+{
+    if (threadErrorGeneration != errorGeneration)
+        return PHYSFS_ERR_OK;  /* never set, or set before a deinit. */
+    return threadErrorCode;
+} /* currentErrorCode */
+
+
+PHYSFS_ErrorCode PHYSFS_getLastErrorCode(void)
+{
+    const PHYSFS_ErrorCode retval = currentErrorCode();
+    threadErrorCode = PHYSFS_ERR_OK;
+    return retval;
+} /* PHYSFS_getLastErrorCode */
+
+
+void PHYSFS_setErrorCode(PHYSFS_ErrorCode errcode)
+{
+    if (errcode)
+    {
+        threadErrorCode = errcode;
+        threadErrorGeneration = errorGeneration;
+    } /* if */
+} /* PHYSFS_setErrorCode */
+
+
+static void freeErrorStates(void)
+{
+    /* other threads' codes can't be reached from here; just orphan them. */
+    errorGeneration++;
+} /* freeErrorStates */
+
+#else  /* no thread-local storage; keep a list of every thread's error. */
+
 static ErrState *findErrorForCurrentThread(void)
 {
     ErrState *i;
@@ -710,46 +1117,6 @@ PHYSFS_ErrorCode PHYSFS_getLastErrorCode(void)
 } /* PHYSFS_getLastErrorCode */
 
 
-PHYSFS_DECL const char *PHYSFS_getErrorByCode(PHYSFS_ErrorCode code)
-{
-    switch (code)
-    {
-        case PHYSFS_ERR_OK: return "no error";
-        case PHYSFS_ERR_OTHER_ERROR: return "unknown error";
-        case PHYSFS_ERR_OUT_OF_MEMORY: return "out of memory";
-        case PHYSFS_ERR_NOT_INITIALIZED: return "not initialized";
-        case PHYSFS_ERR_IS_INITIALIZED: return "already initialized";
-        case PHYSFS_ERR_ARGV0_IS_NULL: return "argv[0] is NULL";
-        case PHYSFS_ERR_UNSUPPORTED: return "unsupported";
-        case PHYSFS_ERR_PAST_EOF: return "past end of file";
-        case PHYSFS_ERR_FILES_STILL_OPEN: return "files still open";
-        case PHYSFS_ERR_INVALID_ARGUMENT: return "invalid argument";
-        case PHYSFS_ERR_NOT_MOUNTED: return "not mounted";
-        case PHYSFS_ERR_NOT_FOUND: return "not found";
-        case PHYSFS_ERR_SYMLINK_FORBIDDEN: return "symlinks are forbidden";
-        case PHYSFS_ERR_NO_WRITE_DIR: return "write directory is not set";
-        case PHYSFS_ERR_OPEN_FOR_READING: return "file open for reading";
-        case PHYSFS_ERR_OPEN_FOR_WRITING: return "file open for writing";
-        case PHYSFS_ERR_NOT_A_FILE: return "not a file";
-        case PHYSFS_ERR_READ_ONLY: return "read-only filesystem";
-        case PHYSFS_ERR_CORRUPT: return "corrupted";
-        case PHYSFS_ERR_SYMLINK_LOOP: return "infinite symbolic link loop";
-        case PHYSFS_ERR_IO: return "i/o error";
-        case PHYSFS_ERR_PERMISSION: return "permission denied";
-        case PHYSFS_ERR_NO_SPACE: return "no space available for writing";
-        case PHYSFS_ERR_BAD_FILENAME: return "filename is illegal or insecure";
-        case PHYSFS_ERR_BUSY: return "tried to modify a file the OS needs";
-        case PHYSFS_ERR_DIR_NOT_EMPTY: return "directory isn't empty";
-        case PHYSFS_ERR_OS_ERROR: return "OS reported an error";
-        case PHYSFS_ERR_DUPLICATE: return "duplicate resource";
-        case PHYSFS_ERR_BAD_PASSWORD: return "bad password";
-        case PHYSFS_ERR_APP_CALLBACK: return "app callback reported error";
-    } /* switch */
-
-    return NULL;  /* don't know this error code. */
-} /* PHYSFS_getErrorByCode */
-
-
 void PHYSFS_setErrorCode(PHYSFS_ErrorCode errcode)
 {
     ErrState *err;
@@ -781,13 +1148,6 @@ void PHYSFS_setErrorCode(PHYSFS_ErrorCode errcode)
 } /* PHYSFS_setErrorCode */
 
 
-const char *PHYSFS_getLastError(void)
-{
-    const PHYSFS_ErrorCode err = PHYSFS_getLastErrorCode();
-    return (err) ? PHYSFS_getErrorByCode(err) : NULL;
-} /* PHYSFS_getLastError */
-
-
 /* MAKE SURE that errorLock is held before calling this! */
 static void freeErrorStates(void)
 {
@@ -803,47 +1163,97 @@ static void freeErrorStates(void)
     errorStates = NULL;
 } /* freeErrorStates */
 
-
-void PHYSFS_getLinkedVersion(PHYSFS_Version *ver)
-{
-    if (ver != NULL)
-    {
-        ver->major = PHYSFS_VER_MAJOR;
-        ver->minor = PHYSFS_VER_MINOR;
-        ver->patch = PHYSFS_VER_PATCH;
-    } /* if */
-} /* PHYSFS_getLinkedVersion */
+#endif  /* __PHYSFS_THREAD_LOCAL */
 
 
-static const char *find_filename_extension(const char *fname)
+PHYSFS_DECL const char *PHYSFS_getErrorByCode(PHYSFS_ErrorCode code)
 {
-    const char *retval = NULL;
-    if (fname != NULL)
+    switch (code)
     {
-        const char *p = strchr(fname, '.');
-        retval = p;
-
-        while (p != NULL)
-        {
-            p = strchr(p + 1, '.');
-            if (p != NULL)
-                retval = p;
-        } /* while */
-
-        if (retval != NULL)
-            retval++;  /* skip '.' */
-    } /* if */
-
-    return retval;
-} /* find_filename_extension */
-
-
-static DirHandle *tryOpenDir(PHYSFS_Io *io, const PHYSFS_Archiver *funcs,
-                             const char *d, int forWriting, int *_claimed)
-{
-    DirHandle *retval = NULL;
-    void *opaque = NULL;
-
+        case PHYSFS_ERR_OK: return "no error";
+        case PHYSFS_ERR_OTHER_ERROR: return "unknown error";
+        case PHYSFS_ERR_OUT_OF_MEMORY: return "out of memory";
+        case PHYSFS_ERR_NOT_INITIALIZED: return "not initialized";
+        case PHYSFS_ERR_IS_INITIALIZED: return "already initialized";
+        case PHYSFS_ERR_ARGV0_IS_NULL: return "argv[0] is NULL";
+        case PHYSFS_ERR_UNSUPPORTED: return "unsupported";
+        case PHYSFS_ERR_PAST_EOF: return "past end of file";
+        case PHYSFS_ERR_FILES_STILL_OPEN: return "files still open";
+        case PHYSFS_ERR_INVALID_ARGUMENT: return "invalid argument";
+        case PHYSFS_ERR_NOT_MOUNTED: return "not mounted";
+        case PHYSFS_ERR_NOT_FOUND: return "not found";
+        case PHYSFS_ERR_SYMLINK_FORBIDDEN: return "symlinks are forbidden";
+        case PHYSFS_ERR_NO_WRITE_DIR: return "write directory is not set";
+        case PHYSFS_ERR_OPEN_FOR_READING: return "file open for reading";
+        case PHYSFS_ERR_OPEN_FOR_WRITING: return "file open for writing";
+        case PHYSFS_ERR_NOT_A_FILE: return "not a file";
+        case PHYSFS_ERR_READ_ONLY: return "read-only filesystem";
+        case PHYSFS_ERR_CORRUPT: return "corrupted";
+        case PHYSFS_ERR_SYMLINK_LOOP: return "infinite symbolic link loop";
+        case PHYSFS_ERR_IO: return "i/o error";
+        case PHYSFS_ERR_PERMISSION: return "permission denied";
+        case PHYSFS_ERR_NO_SPACE: return "no space available for writing";
+        case PHYSFS_ERR_BAD_FILENAME: return "filename is illegal or insecure";
+        case PHYSFS_ERR_BUSY: return "tried to modify a file the OS needs";
+        case PHYSFS_ERR_DIR_NOT_EMPTY: return "directory isn't empty";
+        case PHYSFS_ERR_OS_ERROR: return "OS reported an error";
+        case PHYSFS_ERR_DUPLICATE: return "duplicate resource";
+        case PHYSFS_ERR_BAD_PASSWORD: return "bad password";
+        case PHYSFS_ERR_APP_CALLBACK: return "app callback reported error";
+        case PHYSFS_ERR_CANCELLED: return "request was cancelled";
+    } /* switch */
+
+    return NULL;  /* don't know this error code. */
+} /* PHYSFS_getErrorByCode */
+
+
+const char *PHYSFS_getLastError(void)
+{
+    const PHYSFS_ErrorCode err = PHYSFS_getLastErrorCode();
+    return (err) ? PHYSFS_getErrorByCode(err) : NULL;
+} /* PHYSFS_getLastError */
+
+
+void PHYSFS_getLinkedVersion(PHYSFS_Version *ver)
+{
+    if (ver != NULL)
+    {
+        ver->major = PHYSFS_VER_MAJOR;
+        ver->minor = PHYSFS_VER_MINOR;
+        ver->patch = PHYSFS_VER_PATCH;
+    } /* if */
+} /* PHYSFS_getLinkedVersion */
+
+
+static const char *find_filename_extension(const char *fname)
+{
+    const char *retval = NULL;
+    if (fname != NULL)
+    {
+        const char *p = strchr(fname, '.');
+        retval = p;
+
+        while (p != NULL)
+        {
+            p = strchr(p + 1, '.');
+            if (p != NULL)
+                retval = p;
+        } /* while */
+
+        if (retval != NULL)
+            retval++;  /* skip '.' */
+    } /* if */
+
+    return retval;
+} /* find_filename_extension */
+
+
+static DirHandle *tryOpenDir(PHYSFS_Io *io, const PHYSFS_Archiver *funcs,
+                             const char *d, int forWriting, int *_claimed)
+{
+    DirHandle *retval = NULL;
+    void *opaque = NULL;
+
     if (io != NULL)
         BAIL_IF_ERRPASS(!io->seek(io, 0), NULL);
 
@@ -866,6 +1276,71 @@ static DirHandle *tryOpenDir(PHYSFS_Io *io, const PHYSFS_Archiver *funcs,
 } /* tryOpenDir */
 
 
+/*
+ * The built-in archivers protect whatever state they change after opening,
+ *  so lookups in them can run in parallel. Archivers registered by the app
+ *  were promised that PhysicsFS would do their locking for them.
+ */
+static int archiverIsThreadSafe(const PHYSFS_Archiver *funcs)
+{
+    #define CHECK_STATIC_ARCHIVER(arc) { \
+        if (funcs->openArchive == __PHYSFS_Archiver_##arc.openArchive) { \
+            return 1; \
+        } \
+    }
+
+    CHECK_STATIC_ARCHIVER(DIR);
+    #if PHYSFS_SUPPORTS_ZIP
+        CHECK_STATIC_ARCHIVER(ZIP);
+    #endif
+    #if PHYSFS_SUPPORTS_7Z
+        CHECK_STATIC_ARCHIVER(7Z);
+    #endif
+    #if PHYSFS_SUPPORTS_GRP
+        CHECK_STATIC_ARCHIVER(GRP);
+    #endif
+    #if PHYSFS_SUPPORTS_QPAK
+        CHECK_STATIC_ARCHIVER(QPAK);
+    #endif
+    #if PHYSFS_SUPPORTS_HOG
+        CHECK_STATIC_ARCHIVER(HOG);
+    #endif
+    #if PHYSFS_SUPPORTS_MVL
+        CHECK_STATIC_ARCHIVER(MVL);
+    #endif
+    #if PHYSFS_SUPPORTS_WAD
+        CHECK_STATIC_ARCHIVER(WAD);
+    #endif
+    #if PHYSFS_SUPPORTS_SLB
+        CHECK_STATIC_ARCHIVER(SLB);
+    #endif
+    #if PHYSFS_SUPPORTS_ISO9660
+        CHECK_STATIC_ARCHIVER(ISO9660);
+    #endif
+    #if PHYSFS_SUPPORTS_VDF
+        CHECK_STATIC_ARCHIVER(VDF);
+    #endif
+
+    #undef CHECK_STATIC_ARCHIVER
+
+    return 0;
+} /* archiverIsThreadSafe */
+
+
+static inline void lockArchiver(const DirHandle *h)
+{
+    if (h->needsLock)
+        __PHYSFS_platformGrabMutex(archiverLock);
+} /* lockArchiver */
+
+
+static inline void unlockArchiver(const DirHandle *h)
+{
+    if (h->needsLock)
+        __PHYSFS_platformReleaseMutex(archiverLock);
+} /* unlockArchiver */
+
+
 static DirHandle *openDirectory(PHYSFS_Io *io, const char *d, int forWriting)
 {
     DirHandle *retval = NULL;
@@ -884,7 +1359,10 @@ static DirHandle *openDirectory(PHYSFS_Io *io, const char *d, int forWriting)
         if (retval || claimed)
             return retval;
 
-        io = __PHYSFS_createNativeIo(d, forWriting ? 'w' : 'r');
+        if (!forWriting)  /* try to map it first, fall back to reading. */
+            io = __PHYSFS_createMappedNativeIo(d);
+        if (!io)
+            io = __PHYSFS_createNativeIo(d, forWriting ? 'w' : 'r');
         BAIL_IF_ERRPASS(!io, 0);
         created_io = 1;
     } /* if */
@@ -1031,6 +1509,13 @@ static DirHandle *createDirHandle(PHYSFS_Io *io, const char *newDir,
     dirHandle = openDirectory(io, newDir, forWriting);
     GOTO_IF_ERRPASS(!dirHandle, badDirHandle);
 
+    /* the native filesystem can change behind our backs; don't index it. */
+    dirHandle->indexable = (dirHandle->funcs != &__PHYSFS_Archiver_DIR);
+    if (!dirHandle->indexable)  /* ...unless we only look at a snapshot. */
+        dirHandle->indexable = __PHYSFS_DIR_isSnapshot(dirHandle->opaque);
+    dirHandle->needsLock = !archiverIsThreadSafe(dirHandle->funcs);
+    dirHandle->ignoreCase = ignoreCase;
+
     dirHandle->dirName = (char *) allocator.Malloc(strlen(newDir) + 1);
     GOTO_IF(!dirHandle->dirName, PHYSFS_ERR_OUT_OF_MEMORY, badDirHandle);
     strcpy(dirHandle->dirName, newDir);
@@ -1061,17 +1546,31 @@ badDirHandle:
 } /* createDirHandle */
 
 
-/* MAKE SURE you've got the stateLock held before calling this! */
-static int freeDirHandle(DirHandle *dh, FileHandle *openList)
+/* MAKE SURE you've got the stateLock held exclusively before calling this! */
+static int preloadCameFrom(void *dh, const char *path, const void *archive)
+{
+    return (archive == dh);
+} /* preloadCameFrom */
+
+
+static int freeDirHandle(DirHandle *dh, FileHandle **openList)
 {
     FileHandle *i;
 
     if (dh == NULL)
         return 1;
 
-    for (i = openList; i != NULL; i = i->next)
-        BAIL_IF(i->dirHandle == dh, PHYSFS_ERR_FILES_STILL_OPEN, 0);
+    __PHYSFS_platformGrabMutex(fileListLock);
+    for (i = *openList; i != NULL; i = i->next)
+    {
+        if (i->dirHandle == dh)
+            BAIL_MUTEX(PHYSFS_ERR_FILES_STILL_OPEN, fileListLock, 0);
+    } /* for */
+    __PHYSFS_platformReleaseMutex(fileListLock);
 
+    __PHYSFS_preloadForgetIf(preloadCameFrom, dh);
+    if (dh->watch != NULL)
+        __PHYSFS_platformUnwatchDir(dh->watch);
     dh->funcs->closeArchive(dh->opaque);
     allocator.Free(dh->dirName);
     allocator.Free(dh->mountPoint);
@@ -1080,129 +1579,571 @@ static int freeDirHandle(DirHandle *dh, FileHandle *openList)
 } /* freeDirHandle */
 
 
-static char *calculateBaseDir(const char *argv0)
+/*
+ * Start or stop watching (dh), depending on whether PHYSFS_watch() has a
+ *  callback now. Only the native filesystem gets watched; archives don't
+ *  change behind our backs. Returns zero if (dh) should be watched but
+ *  can't be.
+ * MAKE SURE you've got the stateLock held exclusively before calling this!
+ */
+static int updateWatch(DirHandle *dh)
 {
-    const char dirsep = __PHYSFS_platformDirSeparator;
-    char *retval = NULL;
-    char *ptr = NULL;
-
-    /* Give the platform layer first shot at this. */
-    retval = __PHYSFS_platformCalcBaseDir(argv0);
-    if (retval != NULL)
-        return retval;
-
-    /* We need argv0 to go on. */
-    BAIL_IF(argv0 == NULL, PHYSFS_ERR_ARGV0_IS_NULL, NULL);
-
-    ptr = strrchr(argv0, dirsep);
-    if (ptr != NULL)
+    if (watchCallback == NULL)
     {
-        const size_t size = ((size_t) (ptr - argv0)) + 1;
-        retval = (char *) allocator.Malloc(size + 1);
-        BAIL_IF(!retval, PHYSFS_ERR_OUT_OF_MEMORY, NULL);
-        memcpy(retval, argv0, size);
-        retval[size] = '\0';
-        return retval;
+        if (dh->watch != NULL)
+            __PHYSFS_platformUnwatchDir(dh->watch);
+        dh->watch = NULL;
     } /* if */
 
-    /* argv0 wasn't helpful. */
-    BAIL(PHYSFS_ERR_INVALID_ARGUMENT, NULL);
-} /* calculateBaseDir */
+    else if ((dh->watch == NULL) && (dh->funcs == &__PHYSFS_Archiver_DIR))
+    {
+        dh->watch = __PHYSFS_platformWatchDir(dh->dirName);
+        BAIL_IF_ERRPASS(!dh->watch, 0);
+    } /* else if */
 
+    return 1;
+} /* updateWatch */
 
-static int initializeMutexes(void)
-{
-    errorLock = __PHYSFS_platformCreateMutex();
-    if (errorLock == NULL)
-        goto initializeMutexes_failed;
 
-    stateLock = __PHYSFS_platformCreateMutex();
-    if (stateLock == NULL)
-        goto initializeMutexes_failed;
+/*
+ * The search path index is a single __PHYSFS_DirTree holding every path
+ *  provided by every indexable archive in the search path, and which of
+ *  those archives is the first in the search path to provide it. This lets
+ *  a lookup skip every other indexed archive, no matter how many are
+ *  mounted. Non-indexable DirHandles (the native filesystem) still have to
+ *  be asked in order, since they can change at any time.
+ *
+ * Changing the index needs the stateLock held exclusively; lookups only
+ *  need it held shared.
+ */
 
-    return 1;  /* success. */
+typedef struct
+{
+    DirHandle *dirHandle;
+    int override;
+    PHYSFS_ErrorCode errcode;
+} SearchPathIndexData;
 
-initializeMutexes_failed:
-    if (errorLock != NULL)
-        __PHYSFS_platformDestroyMutex(errorLock);
+static int addSearchPathIndexEntry(char *path, const int isdir,
+                                   DirHandle *dh, const int override)
+{
+    SearchPathIndexEntry *entry;
+    entry = (SearchPathIndexEntry *) __PHYSFS_DirTreeAdd(searchPathIndex,
+                                                         path, isdir);
+    BAIL_IF_ERRPASS(!entry, 0);
 
-    if (stateLock != NULL)
-        __PHYSFS_platformDestroyMutex(stateLock);
+    /* a later archive can have a dir where an earlier one had a file. */
+    if (isdir)
+        entry->tree.isdir = 1;
 
-    errorLock = stateLock = NULL;
-    return 0;  /* failed. */
-} /* initializeMutexes */
+    if ((override) || (entry->dirHandle == NULL))
+        entry->dirHandle = dh;
 
+    return 1;
+} /* addSearchPathIndexEntry */
 
-static int doRegisterArchiver(const PHYSFS_Archiver *_archiver);
 
-static int initStaticArchivers(void)
+static PHYSFS_EnumerateCallbackResult searchPathIndexCallback(void *_data,
+                                    const char *origdir, const char *fname)
 {
-    #define REGISTER_STATIC_ARCHIVER(arc) { \
-        if (!doRegisterArchiver(&__PHYSFS_Archiver_##arc)) { \
-            return 0; \
-        } \
-    }
+    SearchPathIndexData *data = (SearchPathIndexData *) _data;
+    DirHandle *dh = data->dirHandle;
+    const char *mntpnt = dh->mountPoint ? dh->mountPoint : "";
+    const size_t mntpntlen = strlen(mntpnt);
+    const size_t slen = mntpntlen + strlen(origdir) + strlen(fname) + 2;
+    char *path = (char *) __PHYSFS_smallAlloc(slen);
+    PHYSFS_EnumerateCallbackResult retval = PHYSFS_ENUM_ERROR;
+    PHYSFS_Stat statbuf;
+    char *arcpath;
 
-    #if PHYSFS_SUPPORTS_ZIP
-        REGISTER_STATIC_ARCHIVER(ZIP);
-    #endif
-    #if PHYSFS_SUPPORTS_7Z
-        SZIP_global_init();
-        REGISTER_STATIC_ARCHIVER(7Z);
-    #endif
-    #if PHYSFS_SUPPORTS_GRP
-        REGISTER_STATIC_ARCHIVER(GRP);
-    #endif
-    #if PHYSFS_SUPPORTS_QPAK
-        REGISTER_STATIC_ARCHIVER(QPAK);
-    #endif
-    #if PHYSFS_SUPPORTS_HOG
-        REGISTER_STATIC_ARCHIVER(HOG);
-    #endif
-    #if PHYSFS_SUPPORTS_MVL
-        REGISTER_STATIC_ARCHIVER(MVL);
-    #endif
-    #if PHYSFS_SUPPORTS_WAD
-        REGISTER_STATIC_ARCHIVER(WAD);
-    #endif
-    #if PHYSFS_SUPPORTS_SLB
-        REGISTER_STATIC_ARCHIVER(SLB);
-    #endif
-    #if PHYSFS_SUPPORTS_ISO9660
-        REGISTER_STATIC_ARCHIVER(ISO9660);
-    #endif
-    #if PHYSFS_SUPPORTS_VDF
-        REGISTER_STATIC_ARCHIVER(VDF)
-    #endif
+    if (path == NULL)
+    {
+        data->errcode = PHYSFS_ERR_OUT_OF_MEMORY;
+        return PHYSFS_ENUM_ERROR;
+    } /* if */
 
-    #undef REGISTER_STATIC_ARCHIVER
+    snprintf(path, slen, "%s%s%s%s", mntpnt, origdir,
+             *origdir ? "/" : "", fname);
+    arcpath = path + mntpntlen;
 
-    return 1;
-} /* initStaticArchivers */
+    if (dh->funcs->stat(dh->opaque, arcpath, &statbuf))
+    {
+        const int isdir = (statbuf.filetype == PHYSFS_FILETYPE_DIRECTORY);
+        if (addSearchPathIndexEntry(path, isdir, dh, data->override))
+        {
+            retval = PHYSFS_ENUM_OK;
+            if (isdir)
+            {
+                retval = dh->funcs->enumerate(dh->opaque, arcpath,
+                                              searchPathIndexCallback,
+                                              arcpath, data);
+            } /* if */
+        } /* if */
+    } /* if */
+
+    /* keep the real error; the archiver will report an app callback error. */
+    if ((retval == PHYSFS_ENUM_ERROR) && (data->errcode == PHYSFS_ERR_OK))
+        data->errcode = currentErrorCode();
 
+    __PHYSFS_smallFree(path);
+    return retval;
+} /* searchPathIndexCallback */
 
-static void setDefaultAllocator(void);
-static int doDeinit(void);
 
-int PHYSFS_init(const char *argv0)
+/* (override) is non-zero if (dh) is now ahead of everything already indexed. */
+static int indexDirHandle(DirHandle *dh, const int override)
 {
-    BAIL_IF(initialized, PHYSFS_ERR_IS_INITIALIZED, 0);
+    SearchPathIndexEntry *root;
+    SearchPathIndexData data;
 
-    if (!externalAllocator)
-        setDefaultAllocator();
+    if (!dh->indexable)
+        return 1;
 
-    if ((allocator.Init != NULL) && (!allocator.Init())) return 0;
+    assert(searchPathIndex != NULL);
 
-    if (!__PHYSFS_platformInit())
+    root = (SearchPathIndexEntry *) searchPathIndex->root;
+    if ((override) || (root->dirHandle == NULL))
+        root->dirHandle = dh;
+
+    /* each piece of the mountpoint exists as far as the search path cares. */
+    if (dh->mountPoint != NULL)
     {
-        if (allocator.Deinit != NULL) allocator.Deinit();
-        return 0;
+        const size_t slen = strlen(dh->mountPoint) + 1;
+        char *mntpnt = (char *) __PHYSFS_smallAlloc(slen);
+        char *ptr;
+        int rc = 1;
+
+        BAIL_IF(!mntpnt, PHYSFS_ERR_OUT_OF_MEMORY, 0);
+        strcpy(mntpnt, dh->mountPoint);
+        for (ptr = strchr(mntpnt, '/'); rc && ptr; ptr = strchr(ptr + 1, '/'))
+        {
+            *ptr = '\0';
+            rc = addSearchPathIndexEntry(mntpnt, 1, dh, override);
+            *ptr = '/';
+        } /* for */
+
+        __PHYSFS_smallFree(mntpnt);
+        BAIL_IF_ERRPASS(!rc, 0);
     } /* if */
 
-    /* everything below here can be cleaned up safely by doDeinit(). */
+    memset(&data, '\0', sizeof (data));
+    data.dirHandle = dh;
+    data.override = override;
+    data.errcode = PHYSFS_ERR_OK;
+    if (dh->funcs->enumerate(dh->opaque, "", searchPathIndexCallback,
+                             "", &data) == PHYSFS_ENUM_ERROR)
+    {
+        BAIL_IF(data.errcode != PHYSFS_ERR_OK, data.errcode, 0);
+        BAIL_ERRPASS(0);
+    } /* if */
 
-    if (!initializeMutexes()) goto initFailed;
+    return 1;
+} /* indexDirHandle */
+
+
+static void dropSearchPathIndex(void)
+{
+    if (searchPathIndex != NULL)
+    {
+        __PHYSFS_DirTreeDeinit(searchPathIndex);
+        allocator.Free(searchPathIndex);
+        searchPathIndex = NULL;
+    } /* if */
+} /* dropSearchPathIndex */
+
+
+static int buildSearchPathIndex(void)
+{
+    const size_t len = sizeof (__PHYSFS_DirTree);
+    DirHandle *i;
+
+    assert(searchPathIndex == NULL);
+    searchPathIndex = (__PHYSFS_DirTree *) allocator.Malloc(len);
+    BAIL_IF(!searchPathIndex, PHYSFS_ERR_OUT_OF_MEMORY, 0);
+
+    if (!__PHYSFS_DirTreeInit(searchPathIndex, sizeof (SearchPathIndexEntry), 0))
+    {
+        dropSearchPathIndex();
+        return 0;
+    } /* if */
+
+    /*
+     * If any archive ignores case, so must the index, or it would hide that
+     *  archive's files from lookups in the "wrong" case. A case-folded index
+     *  is still a fine hint for archives that don't ignore case, since they
+     *  get asked the usual way once the index points at one.
+     */
+    searchPathIndex->ignorecase = 0;
+    for (i = searchPath; i != NULL; i = i->next)
+    {
+        if ((i->indexable) && (i->ignoreCase))
+            searchPathIndex->ignorecase = 1;
+    } /* for */
+
+    for (i = searchPath; i != NULL; i = i->next)
+    {
+        if (!indexDirHandle(i, 0))
+        {
+            dropSearchPathIndex();
+            return 0;
+        } /* if */
+    } /* for */
+
+    return 1;
+} /* buildSearchPathIndex */
+
+
+/* Call this after (dh) has been linked into the search path. */
+static void searchPathIndexMounted(DirHandle *dh, const int prepended)
+{
+    if (!indexSearchPath)
+        return;
+    else if (searchPathIndex == NULL)  /* last attempt failed; try again. */
+        buildSearchPathIndex();
+    else if ((dh->ignoreCase) && (!searchPathIndex->ignorecase))
+    {
+        dropSearchPathIndex();  /* needs to be case-folded now. */
+        buildSearchPathIndex();
+    } /* else if */
+    else if (!indexDirHandle(dh, prepended))
+        dropSearchPathIndex();  /* just walk the search path instead. */
+} /* searchPathIndexMounted */
+
+
+/* Call this after a DirHandle has been unlinked from the search path. */
+static void searchPathIndexUnmounted(const int wasIndexable)
+{
+    if (!indexSearchPath)
+        return;
+    else if ((wasIndexable) || (searchPathIndex == NULL))
+    {
+        /* later archives might have to take over paths; start over. */
+        dropSearchPathIndex();
+        buildSearchPathIndex();
+    } /* else if */
+} /* searchPathIndexUnmounted */
+
+
+/*
+ * If the search path is indexed, look up (fname) and return non-zero, with
+ *  (*hint) set to the first indexed archive that has it (NULL if none do).
+ *  Returns zero if there's no index, and everything must be asked.
+ *  (fname) must be an output from sanitizePlatformIndependentPath().
+ */
+static int searchPathIndexLookup(const char *fname, const DirHandle **hint)
+{
+    const SearchPathIndexEntry *entry;
+
+    *hint = NULL;
+    if (searchPathIndex == NULL)
+        return 0;
+
+    entry = (const SearchPathIndexEntry *)
+                __PHYSFS_DirTreeFind(searchPathIndex, fname);
+    if (entry != NULL)
+        *hint = entry->dirHandle;
+    if (*hint == NULL)
+        PHYSFS_setErrorCode(PHYSFS_ERR_NOT_FOUND);
+
+    return 1;
+} /* searchPathIndexLookup */
+
+
+/*
+ * Returns non-zero if (i) can be skipped while walking the search path,
+ *  because the index says it's not the first indexed archive with the path.
+ *  Once we reach (hint), it and everything after it has to be asked the
+ *  usual way, in case (hint) still fails (forbidden symlinks, etc).
+ */
+static int skipViaSearchPathIndex(const DirHandle *i, int *useIndex,
+                                  const DirHandle *hint)
+{
+    if ((!*useIndex) || (!i->indexable))
+        return 0;
+    else if (i != hint)
+        return 1;
+
+    *useIndex = 0;
+    return 0;
+} /* skipViaSearchPathIndex */
+
+
+/*
+ * The miss cache remembers paths that nothing in the search path has, so
+ *  probing for optional files over and over doesn't ask every archive (and
+ *  stat() every native directory) each time. It's a direct-mapped table:
+ *  a new miss replaces whatever hashed to the same slot.
+ *
+ * Anything that could make a missing path appear bumps missCacheGeneration,
+ *  which makes every entry stale at once without touching them. A lookup
+ *  notes the generation before it walks the search path, and its miss is
+ *  only added under that generation, so a file written while the walk was
+ *  in progress can't be recorded as missing.
+ *
+ * The table itself only changes with the stateLock held exclusively; its
+ *  entries change under missCacheLock, since shared holders add to it.
+ */
+
+static void invalidateMissCache(void)
+{
+    __PHYSFS_ATOMIC_INCR(&missCacheGeneration);
+} /* invalidateMissCache */
+
+
+/*
+ * Returns non-zero, with the error set, if (fname) is known to be missing.
+ *  Otherwise, returns zero, and (*generation) is what to hand to
+ *  missCacheAdd() if the search path doesn't have it either.
+ *  (fname) must be an output from sanitizePlatformIndependentPath().
+ */
+static int missCacheFind(const char *fname, int *generation)
+{
+    const MissCacheEntry *entry;
+    PHYSFS_uint32 hash;
+    int retval;
+
+    *generation = missCacheGeneration;
+    if (missCacheSize == 0)
+        return 0;
+
+    hash = __PHYSFS_hashString(fname, strlen(fname));
+    entry = &missCache[hash & (missCacheSize - 1)];
+    __PHYSFS_platformGrabMutex(missCacheLock);
+    retval = ((entry->path != NULL) && (entry->hash == hash) &&
+              (entry->generation == *generation) &&
+              (strcmp(entry->path, fname) == 0));
+    __PHYSFS_platformReleaseMutex(missCacheLock);
+
+    BAIL_IF(retval, PHYSFS_ERR_NOT_FOUND, 1);
+    return 0;
+} /* missCacheFind */
+
+
+/* Remember that the search path doesn't have (fname). Failure is harmless. */
+static void missCacheAdd(const char *fname, const int generation)
+{
+    const size_t len = strlen(fname);
+    MissCacheEntry *entry;
+    PHYSFS_uint32 hash;
+    char *path;
+
+    if ((missCacheSize == 0) || (generation != missCacheGeneration))
+        return;
+
+    path = (char *) allocator.Malloc(len + 1);
+    if (path == NULL)
+        return;
+    memcpy(path, fname, len + 1);
+
+    hash = __PHYSFS_hashString(fname, len);
+    entry = &missCache[hash & (missCacheSize - 1)];
+    __PHYSFS_platformGrabMutex(missCacheLock);
+    if (generation == missCacheGeneration)  /* still? */
+    {
+        char *old = entry->path;
+        entry->path = path;
+        entry->hash = hash;
+        entry->generation = generation;
+        path = old;
+    } /* if */
+    __PHYSFS_platformReleaseMutex(missCacheLock);
+
+    if (path != NULL)
+        allocator.Free(path);  /* whatever lost the slot. */
+} /* missCacheAdd */
+
+
+/*
+ * Forget that (fname) was missing, without making everything else stale.
+ * MAKE SURE you hold the stateLock exclusively before calling this!
+ */
+static void missCacheForget(const char *fname)
+{
+    PHYSFS_uint32 hash;
+    MissCacheEntry *entry;
+
+    if (missCacheSize == 0)
+        return;
+
+    hash = __PHYSFS_hashString(fname, strlen(fname));
+    entry = &missCache[hash & (missCacheSize - 1)];
+    if ((entry->path != NULL) && (entry->hash == hash) &&
+        (strcmp(entry->path, fname) == 0))
+    {
+        allocator.Free(entry->path);
+        entry->path = NULL;
+    } /* if */
+} /* missCacheForget */
+
+
+/* MAKE SURE you hold the stateLock exclusively before calling this! */
+static void freeMissCache(void)
+{
+    PHYSFS_uint32 i;
+
+    for (i = 0; i < missCacheSize; i++)
+    {
+        if (missCache[i].path != NULL)
+            allocator.Free(missCache[i].path);
+    } /* for */
+
+    if (missCache != NULL)
+        allocator.Free(missCache);
+    missCache = NULL;
+    missCacheSize = 0;
+} /* freeMissCache */
+
+
+static char *calculateBaseDir(const char *argv0)
+{
+    const char dirsep = __PHYSFS_platformDirSeparator;
+    char *retval = NULL;
+    char *ptr = NULL;
+
+    /* Give the platform layer first shot at this. */
+    retval = __PHYSFS_platformCalcBaseDir(argv0);
+    if (retval != NULL)
+        return retval;
+
+    /* We need argv0 to go on. */
+    BAIL_IF(argv0 == NULL, PHYSFS_ERR_ARGV0_IS_NULL, NULL);
+
+    ptr = strrchr(argv0, dirsep);
+    if (ptr != NULL)
+    {
+        const size_t size = ((size_t) (ptr - argv0)) + 1;
+        retval = (char *) allocator.Malloc(size + 1);
+        BAIL_IF(!retval, PHYSFS_ERR_OUT_OF_MEMORY, NULL);
+        memcpy(retval, argv0, size);
+        retval[size] = '\0';
+        return retval;
+    } /* if */
+
+    /* argv0 wasn't helpful. */
+    BAIL(PHYSFS_ERR_INVALID_ARGUMENT, NULL);
+} /* calculateBaseDir */
+
+
+static int initializeMutexes(void)
+{
+    errorLock = __PHYSFS_platformCreateMutex();
+    if (errorLock == NULL)
+        goto initializeMutexes_failed;
+
+    stateLock = __PHYSFS_platformCreateRWLock();
+    if (stateLock == NULL)
+        goto initializeMutexes_failed;
+
+    fileListLock = __PHYSFS_platformCreateMutex();
+    if (fileListLock == NULL)
+        goto initializeMutexes_failed;
+
+    archiverLock = __PHYSFS_platformCreateMutex();
+    if (archiverLock == NULL)
+        goto initializeMutexes_failed;
+
+    poolLock = __PHYSFS_platformCreateMutex();
+    if (poolLock == NULL)
+        goto initializeMutexes_failed;
+
+    return 1;  /* success. */
+
+initializeMutexes_failed:
+    if (errorLock != NULL)
+        __PHYSFS_platformDestroyMutex(errorLock);
+
+    if (stateLock != NULL)
+        __PHYSFS_platformDestroyRWLock(stateLock);
+
+    if (fileListLock != NULL)
+        __PHYSFS_platformDestroyMutex(fileListLock);
+
+    if (archiverLock != NULL)
+        __PHYSFS_platformDestroyMutex(archiverLock);
+
+    if (poolLock != NULL)
+        __PHYSFS_platformDestroyMutex(poolLock);
+
+    errorLock = stateLock = fileListLock = archiverLock = poolLock = NULL;
+    return 0;  /* failed. */
+} /* initializeMutexes */
+
+
+static int doRegisterArchiver(const PHYSFS_Archiver *_archiver);
+
+static int initStaticArchivers(void)
+{
+    #define REGISTER_STATIC_ARCHIVER(arc) { \
+        if (!doRegisterArchiver(&__PHYSFS_Archiver_##arc)) { \
+            return 0; \
+        } \
+    }
+
+    #if PHYSFS_SUPPORTS_ZIP
+        REGISTER_STATIC_ARCHIVER(ZIP);
+    #endif
+    #if PHYSFS_SUPPORTS_7Z
+        SZIP_global_init();
+        REGISTER_STATIC_ARCHIVER(7Z);
+    #endif
+    #if PHYSFS_SUPPORTS_GRP
+        REGISTER_STATIC_ARCHIVER(GRP);
+    #endif
+    #if PHYSFS_SUPPORTS_QPAK
+        REGISTER_STATIC_ARCHIVER(QPAK);
+    #endif
+    #if PHYSFS_SUPPORTS_HOG
+        REGISTER_STATIC_ARCHIVER(HOG);
+    #endif
+    #if PHYSFS_SUPPORTS_MVL
+        REGISTER_STATIC_ARCHIVER(MVL);
+    #endif
+    #if PHYSFS_SUPPORTS_WAD
+        REGISTER_STATIC_ARCHIVER(WAD);
+    #endif
+    #if PHYSFS_SUPPORTS_SLB
+        REGISTER_STATIC_ARCHIVER(SLB);
+    #endif
+    #if PHYSFS_SUPPORTS_ISO9660
+        REGISTER_STATIC_ARCHIVER(ISO9660);
+    #endif
+    #if PHYSFS_SUPPORTS_VDF
+        REGISTER_STATIC_ARCHIVER(VDF)
+    #endif
+
+    #undef REGISTER_STATIC_ARCHIVER
+
+    return 1;
+} /* initStaticArchivers */
+
+
+static void setDefaultAllocator(void);
+static int doDeinit(void);
+
+int PHYSFS_init(const char *argv0)
+{
+    BAIL_IF(initialized, PHYSFS_ERR_IS_INITIALIZED, 0);
+
+    if (!externalAllocator)
+        setDefaultAllocator();
+
+    if ((allocator.Init != NULL) && (!allocator.Init())) return 0;
+
+    if (!__PHYSFS_platformInit())
+    {
+        if (allocator.Deinit != NULL) allocator.Deinit();
+        return 0;
+    } /* if */
+
+    /* everything below here can be cleaned up safely by doDeinit(). */
+
+    if (!initializeMutexes()) goto initFailed;
+    if (!__PHYSFS_asyncInit()) goto initFailed;
+    if (!__PHYSFS_writeBehindInit()) goto initFailed;
+    if (!__PHYSFS_blockCacheInit()) goto initFailed;
+    if (!__PHYSFS_preloadInit()) goto initFailed;
+    __PHYSFS_crc32Init();
+    PHYSFS_resetStats();
 
     baseDir = calculateBaseDir(argv0);
     if (!baseDir) goto initFailed;
@@ -1230,6 +2171,17 @@ initFailed:
 
 
 /* MAKE SURE you hold stateLock before calling this! */
+/* Wait out (fh)'s background read-ahead, if any. See readAheadRefill(). */
+static void stopPrefetch(FileHandle *fh)
+{
+    if (fh->prefetchReq != NULL)
+    {
+        __PHYSFS_asyncFinishIo(fh->prefetchReq, 1);
+        fh->prefetchReq = NULL;
+    } /* if */
+} /* stopPrefetch */
+
+
 static int closeFileHandleList(FileHandle **list)
 {
     FileHandle *i;
@@ -1240,6 +2192,13 @@ static int closeFileHandleList(FileHandle **list)
         PHYSFS_Io *io = i->io;
         next = i->next;
 
+        if (i->writeBehind != NULL)
+        {
+            /* a failed write sticks, so there's no point retrying it. */
+            __PHYSFS_writeBehindStop(i->writeBehind);
+            i->writeBehind = NULL;
+        } /* if */
+
         if (io->flush && !io->flush(io))
         {
             *list = i;
@@ -1247,7 +2206,19 @@ static int closeFileHandleList(FileHandle **list)
         } /* if */
 
         io->destroy(io);
-        allocator.Free(i);
+
+        if (i->atomicName != NULL)  /* never closed, so never committed. */
+        {
+            const DirHandle *h = i->dirHandle;
+            h->funcs->remove(h->opaque, i->atomicTemp);
+            allocator.Free(i->atomicName);
+        } /* if */
+
+        if (i->buffer != NULL)
+            allocator.Free(i->buffer);
+        if (i->prefetch != NULL)
+            allocator.Free(i->prefetch);
+        __PHYSFS_poolFree(&fileHandlePool, i);
     } /* for */
 
     *list = NULL;
@@ -1268,7 +2239,7 @@ static void freeSearchPath(void)
         for (i = searchPath; i != NULL; i = next)
         {
             next = i->next;
-            freeDirHandle(i, openReadList);
+            freeDirHandle(i, &openReadList);
         } /* for */
         searchPath = NULL;
     } /* if */
@@ -1332,13 +2303,31 @@ static void freeArchivers(void)
 } /* freeArchivers */
 
 
+static void freePools(void);
+
 static int doDeinit(void)
 {
+    FileHandle *i;
+
+    /* prefetches are async requests that point into file handles. */
+    __PHYSFS_platformGrabMutex(fileListLock);
+    for (i = openReadList; i != NULL; i = i->next)
+        stopPrefetch(i);
+    __PHYSFS_platformReleaseMutex(fileListLock);
+
+    __PHYSFS_asyncDeinit();  /* its threads have files open. */
+    __PHYSFS_writeBehindWaitAll();  /* closed handles are still listed. */
     closeFileHandleList(&openWriteList);
+    __PHYSFS_writeBehindDeinit();
     BAIL_IF(!PHYSFS_setWriteDir(NULL), PHYSFS_ERR_FILES_STILL_OPEN, 0);
 
+    __PHYSFS_preloadDeinit();  /* points at search path DirHandles. */
     freeSearchPath();
+    dropSearchPathIndex();
+    freeMissCache();
     freeArchivers();
+    __PHYSFS_blockCacheDeinit();  /* after the archives purged theirs. */
+    PHYSFS_stopAccessLog(NULL);  /* if there's one, it's thrown away. */
     freeErrorStates();
 
     if (baseDir != NULL)
@@ -1359,9 +2348,15 @@ static int doDeinit(void)
         prefDir = NULL;
     } /* if */
 
-    if (archiveInfo != NULL)
+    if (indexCacheDir != NULL)
     {
-        allocator.Free(archiveInfo);
+        allocator.Free(indexCacheDir);
+        indexCacheDir = NULL;
+    } /* if */
+
+    if (archiveInfo != NULL)
+    {
+        allocator.Free(archiveInfo);
         archiveInfo = NULL;
     } /* if */
 
@@ -1372,15 +2367,31 @@ static int doDeinit(void)
     } /* if */
 
     allowSymLinks = 0;
+    indexSearchPath = 0;
+    ignoreCase = 0;
+    snapshotDirs = 0;
+    watchCallback = NULL;
+    watchCallbackData = NULL;
+    seekCheckpointInterval = 0;
+    readAheadMax = 0;
+    verifyChecksums = 0;
+    PHYSFS_setTraceCallback(NULL, NULL);
     initialized = 0;
 
     if (errorLock) __PHYSFS_platformDestroyMutex(errorLock);
-    if (stateLock) __PHYSFS_platformDestroyMutex(stateLock);
+    if (stateLock) __PHYSFS_platformDestroyRWLock(stateLock);
+    if (fileListLock) __PHYSFS_platformDestroyMutex(fileListLock);
+    if (archiverLock) __PHYSFS_platformDestroyMutex(archiverLock);
+    if (missCacheLock) __PHYSFS_platformDestroyMutex(missCacheLock);
+
+    freePools();  /* everything that could free into one is gone. */
+    if (poolLock) __PHYSFS_platformDestroyMutex(poolLock);
 
     if (allocator.Deinit != NULL)
         allocator.Deinit();
 
-    errorLock = stateLock = NULL;
+    errorLock = stateLock = fileListLock = archiverLock = NULL;
+    missCacheLock = poolLock = NULL;
 
     __PHYSFS_platformDeinit();
 
@@ -1410,12 +2421,44 @@ char *__PHYSFS_strdup(const char *str)
 } /* __PHYSFS_strdup */
 
 
+#define HASH_PRIME1 __PHYSFS_UI64(0x9E3779B185EBCA87)
+#define HASH_PRIME2 __PHYSFS_UI64(0xC2B2AE3D27D4EB4F)
+#define HASH_PRIME3 __PHYSFS_UI64(0x165667B19E3779F9)
+#define HASH_PRIME4 __PHYSFS_UI64(0x85EBCA77C2B2AE63)
+#define HASH_ROTL64(x, r) (((x) << (r)) | ((x) >> (64 - (r))))
+
 PHYSFS_uint32 __PHYSFS_hashString(const char *str, size_t len)
 {
-    PHYSFS_uint32 hash = 5381;
-    while (len--)
-        hash = ((hash << 5) + hash) ^ *(str++);
-    return hash;
+    PHYSFS_uint64 hash = HASH_PRIME3 + (PHYSFS_uint64) len;
+    PHYSFS_uint64 word;
+
+    while (len >= sizeof (word))
+    {
+        memcpy(&word, str, sizeof (word));  /* compilers make this a load. */
+        word *= HASH_PRIME2;
+        word = HASH_ROTL64(word, 31);
+        word *= HASH_PRIME1;
+        hash ^= word;
+        hash = (HASH_ROTL64(hash, 27) * HASH_PRIME1) + HASH_PRIME4;
+        str += sizeof (word);
+        len -= sizeof (word);
+    } /* while */
+
+    if (len > 0)  /* whatever is left goes in one more, partial word. */
+    {
+        word = 0;
+        memcpy(&word, str, len);
+        word *= HASH_PRIME1;
+        hash ^= HASH_ROTL64(word, 23) * HASH_PRIME2;
+        hash = (HASH_ROTL64(hash, 11) * HASH_PRIME1) + HASH_PRIME3;
+    } /* if */
+
+    hash ^= hash >> 33;
+    hash *= HASH_PRIME2;
+    hash ^= hash >> 29;
+    hash *= HASH_PRIME3;
+    hash ^= hash >> 32;
+    return (PHYSFS_uint32) hash;
 } /* __PHYSFS_hashString */
 
 
@@ -1508,9 +2551,9 @@ int PHYSFS_registerArchiver(const PHYSFS_Archiver *archiver)
 {
     int retval;
     BAIL_IF(!initialized, PHYSFS_ERR_NOT_INITIALIZED, 0);
-    __PHYSFS_platformGrabMutex(stateLock);
+    __PHYSFS_platformGrabRWLockExclusive(stateLock);
     retval = doRegisterArchiver(archiver);
-    __PHYSFS_platformReleaseMutex(stateLock);
+    __PHYSFS_platformReleaseRWLock(stateLock);
     return retval;
 } /* PHYSFS_registerArchiver */
 
@@ -1522,17 +2565,17 @@ int PHYSFS_deregisterArchiver(const char *ext)
     BAIL_IF(!initialized, PHYSFS_ERR_NOT_INITIALIZED, 0);
     BAIL_IF(!ext, PHYSFS_ERR_INVALID_ARGUMENT, 0);
 
-    __PHYSFS_platformGrabMutex(stateLock);
+    __PHYSFS_platformGrabRWLockExclusive(stateLock);
     for (i = 0; i < numArchivers; i++)
     {
         if (PHYSFS_utf8stricmp(archiveInfo[i]->extension, ext) == 0)
         {
             const int retval = doDeregisterArchiver(i);
-            __PHYSFS_platformReleaseMutex(stateLock);
+            __PHYSFS_platformReleaseRWLock(stateLock);
             return retval;
         } /* if */
     } /* for */
-    __PHYSFS_platformReleaseMutex(stateLock);
+    __PHYSFS_platformReleaseRWLock(stateLock);
 
     BAIL(PHYSFS_ERR_NOT_FOUND, 0);
 } /* PHYSFS_deregisterArchiver */
@@ -1643,10 +2686,10 @@ const char *PHYSFS_getWriteDir(void)
 {
     const char *retval = NULL;
 
-    __PHYSFS_platformGrabMutex(stateLock);
+    __PHYSFS_platformGrabRWLockShared(stateLock);
     if (writeDir != NULL)
         retval = writeDir->dirName;
-    __PHYSFS_platformReleaseMutex(stateLock);
+    __PHYSFS_platformReleaseRWLock(stateLock);
 
     return retval;
 } /* PHYSFS_getWriteDir */
@@ -1656,12 +2699,15 @@ int PHYSFS_setWriteDir(const char *newDir)
 {
     int retval = 1;
 
-    __PHYSFS_platformGrabMutex(stateLock);
+    /* closed write-behind handles need (stateLock) to finish. */
+    __PHYSFS_writeBehindWaitAll();
+
+    __PHYSFS_platformGrabRWLockExclusive(stateLock);
 
     if (writeDir != NULL)
     {
-        BAIL_IF_MUTEX_ERRPASS(!freeDirHandle(writeDir, openWriteList),
-                            stateLock, 0);
+        BAIL_IF_RWLOCK_ERRPASS(!freeDirHandle(writeDir, &openWriteList),
+                           stateLock, 0);
         writeDir = NULL;
     } /* if */
 
@@ -1669,14 +2715,41 @@ int PHYSFS_setWriteDir(const char *newDir)
     {
         writeDir = createDirHandle(NULL, newDir, NULL, 1);
         retval = (writeDir != NULL);
+        if (retval)
+            updateWatch(writeDir);  /* failing just means it isn't watched. */
     } /* if */
 
-    __PHYSFS_platformReleaseMutex(stateLock);
+    __PHYSFS_platformReleaseRWLock(stateLock);
 
     return retval;
 } /* PHYSFS_setWriteDir */
 
 
+static int verifyPath(DirHandle *h, char **_fname, int allowMissing);
+
+/* does (dh), just mounted ahead of everything, have its own (path)? */
+static int preloadShadowedBy(void *_dh, const char *path, const void *archive)
+{
+    DirHandle *dh = (DirHandle *) _dh;
+    const size_t len = strlen(path) + 1;
+    char *fname = (char *) __PHYSFS_smallAlloc(len);
+    char *arcfname = fname;
+    PHYSFS_Stat statbuf;
+    int retval = 0;
+
+    if (!fname)
+        return 1;  /* can't tell, so assume the worst. */
+
+    strcpy(fname, path);
+    lockArchiver(dh);
+    if (verifyPath(dh, &arcfname, 0))
+        retval = dh->funcs->stat(dh->opaque, arcfname, &statbuf);
+    unlockArchiver(dh);
+    __PHYSFS_smallFree(fname);
+    return retval;
+} /* preloadShadowedBy */
+
+
 static int doMount(PHYSFS_Io *io, const char *fname,
                    const char *mountPoint, int appendToPath)
 {
@@ -1689,18 +2762,18 @@ static int doMount(PHYSFS_Io *io, const char *fname,
     if (mountPoint == NULL)
         mountPoint = "/";
 
-    __PHYSFS_platformGrabMutex(stateLock);
+    __PHYSFS_platformGrabRWLockExclusive(stateLock);
 
     for (i = searchPath; i != NULL; i = i->next)
     {
         /* already in search path? */
         if ((i->dirName != NULL) && (strcmp(fname, i->dirName) == 0))
-            BAIL_MUTEX_ERRPASS(stateLock, 1);
+            BAIL_RWLOCK_ERRPASS(stateLock, 1);
         prev = i;
     } /* for */
 
     dh = createDirHandle(io, fname, mountPoint, 0);
-    BAIL_IF_MUTEX_ERRPASS(!dh, stateLock, 0);
+    BAIL_IF_RWLOCK_ERRPASS(!dh, stateLock, 0);
 
     if (appendToPath)
     {
@@ -1715,7 +2788,13 @@ static int doMount(PHYSFS_Io *io, const char *fname,
         searchPath = dh;
     } /* else */
 
-    __PHYSFS_platformReleaseMutex(stateLock);
+    searchPathIndexMounted(dh, !appendToPath);
+    invalidateMissCache();
+    updateWatch(dh);  /* failing just means it isn't watched. */
+    if (!appendToPath)
+        __PHYSFS_preloadForgetIf(preloadShadowedBy, dh);
+
+    __PHYSFS_platformReleaseRWLock(stateLock);
     return 1;
 } /* doMount */
 
@@ -1725,7 +2804,8 @@ int PHYSFS_mountIo(PHYSFS_Io *io, const char *fname,
 {
     BAIL_IF(!io, PHYSFS_ERR_INVALID_ARGUMENT, 0);
     BAIL_IF(!fname, PHYSFS_ERR_INVALID_ARGUMENT, 0);
-    BAIL_IF(io->version != 0, PHYSFS_ERR_UNSUPPORTED, 0);
+    BAIL_IF(io->version > CURRENT_PHYSFS_IO_API_VERSION,
+            PHYSFS_ERR_UNSUPPORTED, 0);
     return doMount(io, fname, mountPoint, appendToPath);
 } /* PHYSFS_mountIo */
 
@@ -1805,26 +2885,30 @@ int PHYSFS_unmount(const char *oldDir)
 
     BAIL_IF(oldDir == NULL, PHYSFS_ERR_INVALID_ARGUMENT, 0);
 
-    __PHYSFS_platformGrabMutex(stateLock);
+    __PHYSFS_platformGrabRWLockExclusive(stateLock);
     for (i = searchPath; i != NULL; i = i->next)
     {
         if (strcmp(i->dirName, oldDir) == 0)
         {
+            const int indexable = i->indexable;
             next = i->next;
-            BAIL_IF_MUTEX_ERRPASS(!freeDirHandle(i, openReadList),
-                                stateLock, 0);
+            BAIL_IF_RWLOCK_ERRPASS(!freeDirHandle(i, &openReadList),
+                               stateLock, 0);
 
             if (prev == NULL)
                 searchPath = next;
             else
                 prev->next = next;
 
-            BAIL_MUTEX_ERRPASS(stateLock, 1);
+            searchPathIndexUnmounted(indexable);
+            invalidateMissCache();
+
+            BAIL_RWLOCK_ERRPASS(stateLock, 1);
         } /* if */
         prev = i;
     } /* for */
 
-    BAIL_MUTEX(PHYSFS_ERR_NOT_MOUNTED, stateLock, 0);
+    BAIL_RWLOCK(PHYSFS_ERR_NOT_MOUNTED, stateLock, 0);
 } /* PHYSFS_unmount */
 
 
@@ -1837,77 +2921,111 @@ char **PHYSFS_getSearchPath(void)
 const char *PHYSFS_getMountPoint(const char *dir)
 {
     DirHandle *i;
-    __PHYSFS_platformGrabMutex(stateLock);
+    __PHYSFS_platformGrabRWLockShared(stateLock);
     for (i = searchPath; i != NULL; i = i->next)
     {
         if (strcmp(i->dirName, dir) == 0)
         {
             const char *retval = ((i->mountPoint) ? i->mountPoint : "/");
-            __PHYSFS_platformReleaseMutex(stateLock);
+            __PHYSFS_platformReleaseRWLock(stateLock);
             return retval;
         } /* if */
     } /* for */
-    __PHYSFS_platformReleaseMutex(stateLock);
+    __PHYSFS_platformReleaseRWLock(stateLock);
 
     BAIL(PHYSFS_ERR_NOT_MOUNTED, NULL);
 } /* PHYSFS_getMountPoint */
 
 
+#if !PHYSFS_SUPPORTS_STATS
+int PHYSFS_getArchiveStats(const char *dir, PHYSFS_ArchiveStats *stats)
+{
+    BAIL_IF(!stats, PHYSFS_ERR_INVALID_ARGUMENT, 0);
+    memset(stats, '\0', sizeof (*stats));
+    BAIL(PHYSFS_ERR_UNSUPPORTED, 0);
+} /* PHYSFS_getArchiveStats */
+#else
+int PHYSFS_getArchiveStats(const char *dir, PHYSFS_ArchiveStats *stats)
+{
+    DirHandle *i;
+
+    BAIL_IF(!stats, PHYSFS_ERR_INVALID_ARGUMENT, 0);
+    memset(stats, '\0', sizeof (*stats));
+    BAIL_IF(!dir, PHYSFS_ERR_INVALID_ARGUMENT, 0);
+
+    __PHYSFS_platformGrabRWLockShared(stateLock);
+    for (i = searchPath; i != NULL; i = i->next)
+    {
+        if (strcmp(i->dirName, dir) == 0)
+        {
+            memcpy(stats, &i->stats, sizeof (*stats));
+            __PHYSFS_platformReleaseRWLock(stateLock);
+            return 1;
+        } /* if */
+    } /* for */
+    __PHYSFS_platformReleaseRWLock(stateLock);
+
+    BAIL(PHYSFS_ERR_NOT_MOUNTED, 0);
+} /* PHYSFS_getArchiveStats */
+#endif
+
+
 void PHYSFS_getSearchPathCallback(PHYSFS_StringCallback callback, void *data)
 {
     DirHandle *i;
 
-    __PHYSFS_platformGrabMutex(stateLock);
+    __PHYSFS_platformGrabRWLockShared(stateLock);
 
     for (i = searchPath; i != NULL; i = i->next)
         callback(data, i->dirName);
 
-    __PHYSFS_platformReleaseMutex(stateLock);
+    __PHYSFS_platformReleaseRWLock(stateLock);
 } /* PHYSFS_getSearchPathCallback */
 
 
-typedef struct setSaneCfgEnumData
+/*
+ * This used to mount straight from a PHYSFS_enumerate() callback, but
+ *  enumeration holds the stateLock shared, and mounting needs it exclusively,
+ *  so we collect the list first and mount afterwards.
+ */
+static void setSaneCfgAddArchives(const char *archiveExt, int archivesFirst)
 {
-    const char *archiveExt;
-    size_t archiveExtLen;
-    int archivesFirst;
-    PHYSFS_ErrorCode errcode;
-} setSaneCfgEnumData;
+    const size_t extlen = strlen(archiveExt);
+    char **rc = PHYSFS_enumerateFiles("/");
+    char **i;
 
-static PHYSFS_EnumerateCallbackResult setSaneCfgEnumCallback(void *_data,
-                                                const char *dir, const char *f)
-{
-    setSaneCfgEnumData *data = (setSaneCfgEnumData *) _data;
-    const size_t extlen = data->archiveExtLen;
-    const size_t l = strlen(f);
-    const char *ext;
+    if (rc == NULL)
+        return;  /* !!! FIXME: if we want to report errors... */
 
-    if ((l > extlen) && (f[l - extlen - 1] == '.'))
+    for (i = rc; *i != NULL; i++)
     {
-        ext = f + (l - extlen);
-        if (PHYSFS_utf8stricmp(ext, data->archiveExt) == 0)
+        const char *f = *i;
+        const size_t l = strlen(f);
+        const char *ext;
+
+        if ((l > extlen) && (f[l - extlen - 1] == '.'))
         {
-            const char dirsep = __PHYSFS_platformDirSeparator;
-            const char *d = PHYSFS_getRealDir(f);
-            const size_t allocsize = strlen(d) + l + 2;
-            char *str = (char *) __PHYSFS_smallAlloc(allocsize);
-            if (str == NULL)
-                data->errcode = PHYSFS_ERR_OUT_OF_MEMORY;
-            else
+            ext = f + (l - extlen);
+            if (PHYSFS_utf8stricmp(ext, archiveExt) == 0)
             {
-                snprintf(str, allocsize, "%s%c%s", d, dirsep, f);
-                if (!PHYSFS_mount(str, NULL, data->archivesFirst == 0))
-                    data->errcode = currentErrorCode();
-                __PHYSFS_smallFree(str);
-            } /* else */
-        } /* if */
-    } /* if */
+                const char dirsep = __PHYSFS_platformDirSeparator;
+                const char *d = PHYSFS_getRealDir(f);
+                const size_t allocsize = d ? strlen(d) + l + 2 : 0;
+                char *str = d ? (char *) __PHYSFS_smallAlloc(allocsize) : NULL;
 
-    /* !!! FIXME: if we want to abort on errors... */
-    /*return (data->errcode != PHYSFS_ERR_OK) ? PHYSFS_ENUM_ERROR : PHYSFS_ENUM_OK;*/
+                /* !!! FIXME: these can fail and we should report that... */
+                if (str != NULL)
+                {
+                    snprintf(str, allocsize, "%s%c%s", d, dirsep, f);
+                    PHYSFS_mount(str, NULL, archivesFirst == 0);
+                    __PHYSFS_smallFree(str);
+                } /* if */
+            } /* if */
+        } /* if */
+    } /* for */
 
-    return PHYSFS_ENUM_OK;  /* keep going */
-} /* setSaneCfgEnumCallback */
+    PHYSFS_freeList(rc);
+} /* setSaneCfgAddArchives */
 
 
 int PHYSFS_setSaneConfig(const char *organization, const char *appName,
@@ -1947,21 +3065,7 @@ int PHYSFS_setSaneConfig(const char *organization, const char *appName,
 
     /* Root out archives, and add them to search path... */
     if (archiveExt != NULL)
-    {
-        setSaneCfgEnumData data;
-        memset(&data, '\0', sizeof (data));
-        data.archiveExt = archiveExt;
-        data.archiveExtLen = strlen(archiveExt);
-        data.archivesFirst = archivesFirst;
-        data.errcode = PHYSFS_ERR_OK;
-        if (!PHYSFS_enumerate("/", setSaneCfgEnumCallback, &data))
-        {
-            /* !!! FIXME: use this if we're reporting errors.
-            PHYSFS_ErrorCode errcode = currentErrorCode();
-            if (errcode == PHYSFS_ERR_APP_CALLBACK)
-                errcode = data->errcode; */
-        } /* if */
-    } /* if */
+        setSaneCfgAddArchives(archiveExt, archivesFirst);
 
     return 1;
 } /* PHYSFS_setSaneConfig */
@@ -1969,7 +3073,10 @@ int PHYSFS_setSaneConfig(const char *organization, const char *appName,
 
 void PHYSFS_permitSymbolicLinks(int allow)
 {
+    if (allowSymLinks != allow)
+        __PHYSFS_preloadForget("", 1);  /* links might lead elsewhere now. */
     allowSymLinks = allow;
+    invalidateMissCache();  /* links that were forbidden might be allowed. */
 } /* PHYSFS_permitSymbolicLinks */
 
 
@@ -1979,6 +3086,430 @@ int PHYSFS_symbolicLinksPermitted(void)
 } /* PHYSFS_symbolicLinksPermitted */
 
 
+int PHYSFS_indexSearchPath(int enable)
+{
+    int retval = 1;
+
+    BAIL_IF(!initialized, PHYSFS_ERR_NOT_INITIALIZED, 0);
+
+    __PHYSFS_platformGrabRWLockExclusive(stateLock);
+    indexSearchPath = enable;
+    dropSearchPathIndex();
+    if (enable)
+        retval = buildSearchPathIndex();
+    __PHYSFS_platformReleaseRWLock(stateLock);
+
+    return retval;
+} /* PHYSFS_indexSearchPath */
+
+
+int PHYSFS_searchPathIndexed(void)
+{
+    return indexSearchPath;
+} /* PHYSFS_searchPathIndexed */
+
+
+int PHYSFS_setMissCacheSize(PHYSFS_uint32 entries)
+{
+    MissCacheEntry *table = NULL;
+    PHYSFS_uint32 size = 0;
+
+    BAIL_IF(!initialized, PHYSFS_ERR_NOT_INITIALIZED, 0);
+    BAIL_IF(entries > 0x1000000, PHYSFS_ERR_INVALID_ARGUMENT, 0);
+
+    if (entries > 0)
+    {
+        size_t len;
+        for (size = 1; size < entries; size <<= 1) { /* spin. */ }
+        len = sizeof (MissCacheEntry) * size;
+        table = (MissCacheEntry *) allocator.Malloc(len);
+        BAIL_IF(!table, PHYSFS_ERR_OUT_OF_MEMORY, 0);
+        memset(table, '\0', len);
+    } /* if */
+
+    __PHYSFS_platformGrabRWLockExclusive(stateLock);
+
+    if ((table != NULL) && (missCacheLock == NULL))
+    {
+        missCacheLock = __PHYSFS_platformCreateMutex();
+        if (missCacheLock == NULL)
+        {
+            allocator.Free(table);
+            BAIL_RWLOCK(PHYSFS_ERR_OUT_OF_MEMORY, stateLock, 0);
+        } /* if */
+    } /* if */
+
+    freeMissCache();
+    missCache = table;
+    missCacheSize = size;
+
+    __PHYSFS_platformReleaseRWLock(stateLock);
+
+    return 1;
+} /* PHYSFS_setMissCacheSize */
+
+
+PHYSFS_uint32 PHYSFS_getMissCacheSize(void)
+{
+    return missCacheSize;
+} /* PHYSFS_getMissCacheSize */
+
+
+int PHYSFS_ignoreCase(int enable)
+{
+    BAIL_IF(!initialized, PHYSFS_ERR_NOT_INITIALIZED, 0);
+
+    /* only affects later mounts, so there's nothing to rebuild here. */
+    __PHYSFS_platformGrabRWLockExclusive(stateLock);
+    ignoreCase = enable ? 1 : 0;
+    __PHYSFS_platformReleaseRWLock(stateLock);
+
+    return 1;
+} /* PHYSFS_ignoreCase */
+
+
+int PHYSFS_caseIgnored(void)
+{
+    return ignoreCase;
+} /* PHYSFS_caseIgnored */
+
+
+int PHYSFS_snapshotDirectories(int enable)
+{
+    BAIL_IF(!initialized, PHYSFS_ERR_NOT_INITIALIZED, 0);
+
+    /* only affects later mounts, so there's nothing to rebuild here. */
+    __PHYSFS_platformGrabRWLockExclusive(stateLock);
+    snapshotDirs = enable ? 1 : 0;
+    __PHYSFS_platformReleaseRWLock(stateLock);
+
+    return 1;
+} /* PHYSFS_snapshotDirectories */
+
+
+int PHYSFS_directoriesSnapshotted(void)
+{
+    return snapshotDirs;
+} /* PHYSFS_directoriesSnapshotted */
+
+
+/*
+ * (path) changed in an indexed native directory, but no directories came or
+ *  went; point the search path index at whatever is first to have it now.
+ *  (path) must be an output from sanitizePlatformIndependentPath().
+ * MAKE SURE you hold the stateLock exclusively before calling this!
+ */
+static int reindexPath(char *path)
+{
+    SearchPathIndexEntry *entry;
+    DirHandle *owner = NULL;
+    int isdir = 0;
+    DirHandle *i;
+    char *ptr;
+
+    for (i = searchPath; (owner == NULL) && (i != NULL); i = i->next)
+    {
+        const char *arcpath = path;
+        PHYSFS_Stat statbuf;
+
+        if (!i->indexable)
+            continue;
+        else if (i->mountPoint != NULL)
+        {
+            const size_t len = strlen(i->mountPoint);
+            if (strncmp(path, i->mountPoint, len) != 0)
+                continue;  /* pieces of mountpoints never change. */
+            arcpath += len;
+        } /* else if */
+
+        lockArchiver(i);
+        if (i->funcs->stat(i->opaque, arcpath, &statbuf))
+        {
+            owner = i;
+            isdir = (statbuf.filetype == PHYSFS_FILETYPE_DIRECTORY);
+        } /* if */
+        unlockArchiver(i);
+    } /* for */
+
+    if (owner == NULL)
+    {
+        entry = (SearchPathIndexEntry *)
+                    __PHYSFS_DirTreeFind(searchPathIndex, path);
+        if (entry != NULL)
+            entry->dirHandle = NULL;
+        return 1;
+    } /* if */
+
+    BAIL_IF_ERRPASS(!addSearchPathIndexEntry(path, isdir, owner, 1), 0);
+
+    /* parents that were only just added don't belong to anything yet. */
+    for (ptr = strchr(path, '/'); ptr != NULL; ptr = strchr(ptr + 1, '/'))
+    {
+        *ptr = '\0';
+        entry = (SearchPathIndexEntry *)
+                    __PHYSFS_DirTreeFind(searchPathIndex, path);
+        if ((entry != NULL) && (entry->dirHandle == NULL))
+            entry->dirHandle = owner;
+        *ptr = '/';
+    } /* for */
+
+    return 1;
+} /* reindexPath */
+
+
+typedef struct
+{
+    char *dir;  /* DirHandle's dirName. Shares an allocation with (path). */
+    char *path;  /* what changed, as PHYSFS_WatchCallback reports it. */
+} WatchChange;
+
+typedef struct
+{
+    DirHandle *dirHandle;  /* what's being polled. */
+    int inSearchPath;  /* zero if (dirHandle) is the write dir. */
+    int rebuildIndex;  /* non-zero if the search path index is stale. */
+    PHYSFS_ErrorCode errcode;  /* first thing that went wrong, if anything. */
+    WatchChange *changes;
+    size_t count;
+    size_t allocated;
+} WatchPollData;
+
+/* The platform's poll calls this, with the stateLock held exclusively. */
+static void watchPollCallback(void *_data, const char *str)
+{
+    WatchPollData *data = (WatchPollData *) _data;
+    DirHandle *dh = data->dirHandle;
+    const char *mntpnt = data->inSearchPath ? dh->mountPoint : NULL;
+    const size_t slen = (mntpnt ? strlen(mntpnt) : 0) + strlen(str) + 1;
+    const size_t dirlen = strlen(dh->dirName) + 1;
+    char *path = (char *) __PHYSFS_smallAlloc(slen);
+    char *arcpath;
+    WatchChange *change;
+    size_t len;
+    size_t i;
+
+    if (path == NULL)
+    {
+        data->errcode = PHYSFS_ERR_OUT_OF_MEMORY;
+        return;
+    } /* if */
+
+    strcpy(path, mntpnt ? mntpnt : "");
+    arcpath = path + strlen(path);
+
+    /* things PhysicsFS can't name can't be looked up anyhow; skip them. */
+    if (!sanitizePlatformIndependentPath(str, arcpath))
+    {
+        __PHYSFS_smallFree(path);
+        return;
+    } /* if */
+    else if ((*arcpath == '\0') && (arcpath != path))
+        arcpath[-1] = '\0';  /* the mountpoint itself; chop the '/'. */
+
+    if (data->inSearchPath)
+    {
+        PHYSFS_Stat statbuf;
+        int isdir = 1;
+
+        if (dh->funcs == &__PHYSFS_Archiver_DIR)
+        {
+            const int wasIndexable = dh->indexable;
+            const int rc = __PHYSFS_DIR_refreshPath(dh->opaque, arcpath);
+            dh->indexable = __PHYSFS_DIR_isSnapshot(dh->opaque);
+            if ((rc != 1) && ((wasIndexable) || (dh->indexable)))
+                data->rebuildIndex = 1;
+            else if (dh->indexable != wasIndexable)
+                data->rebuildIndex = 1;
+        } /* if */
+
+        if ((dh->indexable) && (searchPathIndex) && (!data->rebuildIndex))
+        {
+            if (!reindexPath(path))
+                data->rebuildIndex = 1;
+        } /* if */
+
+        /* a new dir, or a new way to spell a path, can fill in any miss. */
+        if ((*arcpath != '\0') && (!ignoreCase) && (!allowSymLinks))
+        {
+            isdir = ((dh->funcs->stat(dh->opaque, arcpath, &statbuf)) &&
+                     (statbuf.filetype == PHYSFS_FILETYPE_DIRECTORY));
+        } /* if */
+
+        if (isdir)
+            invalidateMissCache();
+        else
+            missCacheForget(path);
+
+        __PHYSFS_preloadForget(path, 1);
+    } /* if */
+
+    /* the platform often reports the same thing a few times in a row. */
+    for (i = data->count; (i > 0) && (i + 32 > data->count); i--)
+    {
+        change = &data->changes[i - 1];
+        if ((strcmp(change->path, path) == 0) &&
+            (strcmp(change->dir, dh->dirName) == 0))
+        {
+            __PHYSFS_smallFree(path);
+            return;
+        } /* if */
+    } /* for */
+
+    if (data->count >= data->allocated)
+    {
+        const size_t newalloc = data->allocated ? data->allocated * 2 : 16;
+        void *ptr = allocator.Realloc(data->changes,
+                                      newalloc * sizeof (WatchChange));
+        if (ptr == NULL)
+        {
+            data->errcode = PHYSFS_ERR_OUT_OF_MEMORY;
+            __PHYSFS_smallFree(path);
+            return;
+        } /* if */
+        data->changes = (WatchChange *) ptr;
+        data->allocated = newalloc;
+    } /* if */
+
+    len = strlen(path) + 1;
+    change = &data->changes[data->count];
+    change->dir = (char *) allocator.Malloc(dirlen + len);
+    if (change->dir == NULL)
+        data->errcode = PHYSFS_ERR_OUT_OF_MEMORY;
+    else
+    {
+        memcpy(change->dir, dh->dirName, dirlen);
+        change->path = change->dir + dirlen;
+        memcpy(change->path, path, len);
+        data->count++;
+    } /* else */
+
+    __PHYSFS_smallFree(path);
+} /* watchPollCallback */
+
+
+int PHYSFS_watch(PHYSFS_WatchCallback cb, void *data)
+{
+    int retval = 1;
+    DirHandle *i;
+
+    BAIL_IF(!initialized, PHYSFS_ERR_NOT_INITIALIZED, 0);
+
+    __PHYSFS_platformGrabRWLockExclusive(stateLock);
+
+    watchCallback = cb;
+    watchCallbackData = data;
+    for (i = searchPath; (retval) && (i != NULL); i = i->next)
+        retval = updateWatch(i);
+    if ((retval) && (writeDir != NULL))
+        retval = updateWatch(writeDir);
+
+    if (!retval)  /* all or nothing. */
+    {
+        const PHYSFS_ErrorCode err = currentErrorCode();
+        watchCallback = NULL;
+        watchCallbackData = NULL;
+        for (i = searchPath; i != NULL; i = i->next)
+            updateWatch(i);
+        if (writeDir != NULL)
+            updateWatch(writeDir);
+        PHYSFS_setErrorCode(err);
+    } /* if */
+
+    __PHYSFS_platformReleaseRWLock(stateLock);
+
+    return retval;
+} /* PHYSFS_watch */
+
+
+int PHYSFS_pollWatch(void)
+{
+    PHYSFS_WatchCallback cb;
+    void *cbdata;
+    WatchPollData data;
+    DirHandle *i;
+    size_t j;
+
+    BAIL_IF(!initialized, PHYSFS_ERR_NOT_INITIALIZED, -1);
+
+    memset(&data, '\0', sizeof (data));
+    data.errcode = PHYSFS_ERR_OK;
+
+    __PHYSFS_platformGrabRWLockExclusive(stateLock);
+
+    cb = watchCallback;
+    cbdata = watchCallbackData;
+
+    data.inSearchPath = 1;
+    for (i = searchPath; i != NULL; i = i->next)
+    {
+        data.dirHandle = i;
+        if ((i->watch != NULL) &&
+            (__PHYSFS_platformPollWatch(i->watch, watchPollCallback,
+                                        &data) < 0) &&
+            (data.errcode == PHYSFS_ERR_OK))
+            data.errcode = currentErrorCode();
+    } /* for */
+
+    data.inSearchPath = 0;
+    data.dirHandle = writeDir;
+    if ((writeDir != NULL) && (writeDir->watch != NULL) &&
+        (__PHYSFS_platformPollWatch(writeDir->watch, watchPollCallback,
+                                    &data) < 0) &&
+        (data.errcode == PHYSFS_ERR_OK))
+        data.errcode = currentErrorCode();
+
+    if ((data.rebuildIndex) && (indexSearchPath))
+    {
+        dropSearchPathIndex();
+        buildSearchPathIndex();  /* if this fails, lookups walk the path. */
+    } /* if */
+
+    __PHYSFS_platformReleaseRWLock(stateLock);
+
+    /* call the app without any locks held, so it can use PhysicsFS. */
+    for (j = 0; j < data.count; j++)
+    {
+        if (cb != NULL)
+            cb(cbdata, data.changes[j].dir, data.changes[j].path);
+        allocator.Free(data.changes[j].dir);
+    } /* for */
+
+    if (data.changes != NULL)
+        allocator.Free(data.changes);
+
+    BAIL_IF(data.errcode != PHYSFS_ERR_OK, data.errcode, -1);
+    return (int) data.count;
+} /* PHYSFS_pollWatch */
+
+
+int PHYSFS_setIndexCacheDir(const char *dir)
+{
+    char *ptr = NULL;
+
+    BAIL_IF(!initialized, PHYSFS_ERR_NOT_INITIALIZED, 0);
+
+    if (dir != NULL)
+    {
+        ptr = __PHYSFS_strdup(dir);
+        BAIL_IF_ERRPASS(!ptr, 0);
+    } /* if */
+
+    __PHYSFS_platformGrabRWLockExclusive(stateLock);
+    if (indexCacheDir != NULL)
+        allocator.Free(indexCacheDir);
+    indexCacheDir = ptr;
+    __PHYSFS_platformReleaseRWLock(stateLock);
+
+    return 1;
+} /* PHYSFS_setIndexCacheDir */
+
+
+const char *PHYSFS_getIndexCacheDir(void)
+{
+    return indexCacheDir;
+} /* PHYSFS_getIndexCacheDir */
+
+
 /*
  * Verify that (fname) (in platform-independent notation), in relation
  *  to (h) is secure. That means that each element of fname is checked
@@ -2084,10 +3615,11 @@ static int doMkdir(const char *_dname, char *dname)
 
     BAIL_IF_ERRPASS(!sanitizePlatformIndependentPath(_dname, dname), 0);
 
-    __PHYSFS_platformGrabMutex(stateLock);
-    BAIL_IF_MUTEX(!writeDir, PHYSFS_ERR_NO_WRITE_DIR, stateLock, 0);
+    __PHYSFS_platformGrabRWLockShared(stateLock);
+    BAIL_IF_RWLOCK(!writeDir, PHYSFS_ERR_NO_WRITE_DIR, stateLock, 0);
     h = writeDir;
-    BAIL_IF_MUTEX_ERRPASS(!verifyPath(h, &dname, 1), stateLock, 0);
+    lockArchiver(h);
+    GOTO_IF_ERRPASS(!verifyPath(h, &dname, 1), doMkdirEnd);
 
     start = dname;
     while (1)
@@ -2119,7 +3651,12 @@ static int doMkdir(const char *_dname, char *dname)
         start = end + 1;
     } /* while */
 
-    __PHYSFS_platformReleaseMutex(stateLock);
+    if (!exists)
+        invalidateMissCache();  /* something might have been made. */
+
+doMkdirEnd:
+    unlockArchiver(h);
+    __PHYSFS_platformReleaseRWLock(stateLock);
     return retval;
 } /* doMkdir */
 
@@ -2140,20 +3677,57 @@ int PHYSFS_mkdir(const char *_dname)
 } /* PHYSFS_mkdir */
 
 
-static int doDelete(const char *_fname, char *fname)
+/*
+ * (fname), in the write dir, is about to change, so drop copies of it that
+ *  PHYSFS_preload() read from wherever the write dir is in the search path.
+ *  MAKE SURE you hold the stateLock when calling this!
+ */
+static void preloadForgetWritten(const char *fname)
 {
-    int retval;
-    DirHandle *h;
-    BAIL_IF_ERRPASS(!sanitizePlatformIndependentPath(_fname, fname), 0);
-
-    __PHYSFS_platformGrabMutex(stateLock);
-
-    BAIL_IF_MUTEX(!writeDir, PHYSFS_ERR_NO_WRITE_DIR, stateLock, 0);
-    h = writeDir;
-    BAIL_IF_MUTEX_ERRPASS(!verifyPath(h, &fname, 0), stateLock, 0);
-    retval = h->funcs->remove(h->opaque, fname);
-
-    __PHYSFS_platformReleaseMutex(stateLock);
+    DirHandle *i;
+    for (i = searchPath; i != NULL; i = i->next)
+    {
+        const char *mntpnt = i->mountPoint ? i->mountPoint : "";
+        const size_t len = strlen(mntpnt) + strlen(fname) + 1;
+        char *path;
+
+        if (i->funcs != &__PHYSFS_Archiver_DIR)
+            continue;
+        else if (strcmp(i->dirName, writeDir->dirName) != 0)
+            continue;
+
+        path = (char *) __PHYSFS_smallAlloc(len);
+        if (path == NULL)
+            __PHYSFS_preloadForget("", 1);  /* can't tell; drop it all. */
+        else
+        {
+            strcpy(path, mntpnt);
+            strcat(path, fname);
+            __PHYSFS_preloadForget(path, 1);
+            __PHYSFS_smallFree(path);
+        } /* else */
+    } /* for */
+} /* preloadForgetWritten */
+
+
+static int doDelete(const char *_fname, char *fname)
+{
+    int retval;
+    DirHandle *h;
+    BAIL_IF_ERRPASS(!sanitizePlatformIndependentPath(_fname, fname), 0);
+
+    __PHYSFS_platformGrabRWLockShared(stateLock);
+
+    BAIL_IF_RWLOCK(!writeDir, PHYSFS_ERR_NO_WRITE_DIR, stateLock, 0);
+    preloadForgetWritten(fname);
+    h = writeDir;
+    lockArchiver(h);
+    retval = verifyPath(h, &fname, 0);
+    if (retval)
+        retval = h->funcs->remove(h->opaque, fname);
+    unlockArchiver(h);
+
+    __PHYSFS_platformReleaseRWLock(stateLock);
     return retval;
 } /* doDelete */
 
@@ -2186,27 +3760,38 @@ static DirHandle *getRealDirHandle(const char *_fname)
     BAIL_IF(!fname, PHYSFS_ERR_OUT_OF_MEMORY, NULL);
     if (sanitizePlatformIndependentPath(_fname, fname))
     {
+        const DirHandle *hint;
+        int useIndex;
+        int missgen;
         DirHandle *i;
-        __PHYSFS_platformGrabMutex(stateLock);
-        for (i = searchPath; i != NULL; i = i->next)
+        __PHYSFS_platformGrabRWLockShared(stateLock);
+        if (!missCacheFind(fname, &missgen))
         {
-            char *arcfname = fname;
-            if (partOfMountPoint(i, arcfname))
-            {
-                retval = i;
-                break;
-            } /* if */
-            else if (verifyPath(i, &arcfname, 0))
+            useIndex = searchPathIndexLookup(fname, &hint);
+            for (i = searchPath; (i != NULL) && (retval == NULL); i = i->next)
             {
-                PHYSFS_Stat statbuf;
-                if (i->funcs->stat(i->opaque, arcfname, &statbuf))
-                {
+                char *arcfname = fname;
+                if (skipViaSearchPathIndex(i, &useIndex, hint))
+                    continue;
+                else if (partOfMountPoint(i, arcfname))
                     retval = i;
-                    break;
-                } /* if */
-            } /* if */
-        } /* for */
-        __PHYSFS_platformReleaseMutex(stateLock);
+                else
+                {
+                    lockArchiver(i);
+                    if (verifyPath(i, &arcfname, 0))
+                    {
+                        PHYSFS_Stat statbuf;
+                        if (i->funcs->stat(i->opaque, arcfname, &statbuf))
+                            retval = i;
+                    } /* if */
+                    unlockArchiver(i);
+                } /* else */
+            } /* for */
+
+            if ((!retval) && (currentErrorCode() == PHYSFS_ERR_NOT_FOUND))
+                missCacheAdd(fname, missgen);
+        } /* if */
+        __PHYSFS_platformReleaseRWLock(stateLock);
     } /* if */
 
     __PHYSFS_smallFree(fname);
@@ -2220,93 +3805,49 @@ const char *PHYSFS_getRealDir(const char *fname)
 } /* PHYSFS_getRealDir */
 
 
-static int locateInStringList(const char *str,
-                              char **list,
-                              PHYSFS_uint32 *pos)
-{
-    PHYSFS_uint32 len = *pos;
-    PHYSFS_uint32 half_len;
-    PHYSFS_uint32 lo = 0;
-    PHYSFS_uint32 middle;
-    int cmp;
-
-    while (len > 0)
-    {
-        half_len = len >> 1;
-        middle = lo + half_len;
-        cmp = strcmp(list[middle], str);
-
-        if (cmp == 0)  /* it's in the list already. */
-            return 1;
-        else if (cmp > 0)
-            len = half_len;
-        else
-        {
-            lo = middle + 1;
-            len -= half_len + 1;
-        } /* else */
-    } /* while */
-
-    *pos = lo;
-    return 0;
-} /* locateInStringList */
-
-
 static PHYSFS_EnumerateCallbackResult enumFilesCallback(void *data,
                                         const char *origdir, const char *str)
 {
-    PHYSFS_uint32 pos;
-    void *ptr;
-    char *newstr;
     EnumStringListCallbackData *pecd = (EnumStringListCallbackData *) data;
 
-    /*
-     * See if file is in the list already, and if not, insert it in there
-     *  alphabetically...
-     */
-    pos = pecd->size;
-    if (locateInStringList(str, pecd->list, &pos))
-        return PHYSFS_ENUM_OK;  /* already in the list, but keep going. */
-
-    ptr = allocator.Realloc(pecd->list, (pecd->size + 2) * sizeof (char *));
-    newstr = (char *) allocator.Malloc(strlen(str) + 1);
-    if (ptr != NULL)
-        pecd->list = (char **) ptr;
-
-    if ((ptr == NULL) || (newstr == NULL))
+    /* just collect everything; it gets sorted and deduplicated at the end. */
+    if (!appendStringList(pecd, str))
     {
-        if (newstr)
-            allocator.Free(newstr);
-
         pecd->errcode = PHYSFS_ERR_OUT_OF_MEMORY;
         return PHYSFS_ENUM_ERROR;  /* better luck next time. */
     } /* if */
 
-    strcpy(newstr, str);
+    return PHYSFS_ENUM_OK;
+} /* enumFilesCallback */
 
-    if (pos != pecd->size)
-    {
-        memmove(&pecd->list[pos+1], &pecd->list[pos],
-                 sizeof (char *) * ((pecd->size) - pos));
-    } /* if */
 
-    pecd->list[pos] = newstr;
-    pecd->size++;
+static int cmpStringList(void *_a, size_t one, size_t two)
+{
+    char **a = (char **) _a;
+    return strcmp(a[one], a[two]);
+} /* cmpStringList */
 
-    return PHYSFS_ENUM_OK;
-} /* enumFilesCallback */
+
+static void swapStringList(void *_a, size_t one, size_t two)
+{
+    char **a = (char **) _a;
+    char *tmp = a[one];
+    a[one] = a[two];
+    a[two] = tmp;
+} /* swapStringList */
 
 
 char **PHYSFS_enumerateFiles(const char *path)
 {
     EnumStringListCallbackData ecd;
+    PHYSFS_uint32 i, j;
+
     memset(&ecd, '\0', sizeof (ecd));
     ecd.list = (char **) allocator.Malloc(sizeof (char *));
     BAIL_IF(!ecd.list, PHYSFS_ERR_OUT_OF_MEMORY, NULL);
     if (!PHYSFS_enumerate(path, enumFilesCallback, &ecd))
     {
         const PHYSFS_ErrorCode errcode = currentErrorCode();
-        PHYSFS_uint32 i;
         for (i = 0; i < ecd.size; i++)
             allocator.Free(ecd.list[i]);
         allocator.Free(ecd.list);
@@ -2314,6 +3855,21 @@ char **PHYSFS_enumerateFiles(const char *path)
         return NULL;
     } /* if */
 
+    /*
+     * Several mounts might offer the same names. Sorting everything once and
+     *  dropping neighbours that match is O(n log n), instead of finding each
+     *  name's sorted position and shuffling the rest of the list around.
+     */
+    __PHYSFS_sort(ecd.list, ecd.size, cmpStringList, swapStringList);
+    for (i = j = 0; i < ecd.size; i++)
+    {
+        if ((j > 0) && (strcmp(ecd.list[j - 1], ecd.list[i]) == 0))
+            allocator.Free(ecd.list[i]);
+        else
+            ecd.list[j++] = ecd.list[i];
+    } /* for */
+    ecd.size = j;
+
     ecd.list[ecd.size] = NULL;
     return ecd.list;
 } /* PHYSFS_enumerateFiles */
@@ -2322,9 +3878,11 @@ char **PHYSFS_enumerateFiles(const char *path)
 /*
  * Broke out to seperate function so we can use stack allocation gratuitously.
  */
+/* (statcallback) is used instead of (callback) if it isn't NULL. */
 static PHYSFS_EnumerateCallbackResult enumerateFromMountPoint(DirHandle *i,
                                     const char *arcfname,
                                     PHYSFS_EnumerateCallback callback,
+                                    PHYSFS_EnumerateStatCallback statcallback,
                                     const char *_fname, void *data)
 {
     PHYSFS_EnumerateCallbackResult retval;
@@ -2341,7 +3899,29 @@ static PHYSFS_EnumerateCallbackResult enumerateFromMountPoint(DirHandle *i,
     end = strchr(ptr, '/');
     assert(end);  /* should always find a terminating '/'. */
     *end = '\0';
-    retval = callback(data, _fname, ptr);
+    if (statcallback == NULL)
+        retval = callback(data, _fname, ptr);
+    else
+    {
+        PHYSFS_Stat statbuf;  /* same as PHYSFS_stat() says for these. */
+        statbuf.filesize = -1;
+        statbuf.modtime = -1;
+        statbuf.createtime = -1;
+        statbuf.accesstime = -1;
+        statbuf.filetype = PHYSFS_FILETYPE_DIRECTORY;
+        statbuf.readonly = 1;
+
+        /* the last piece of the mountpoint is the archive's own root. */
+        if (end[1] == '\0')
+        {
+            lockArchiver(i);
+            if (!i->funcs->stat(i->opaque, "", &statbuf))
+                statbuf.filetype = PHYSFS_FILETYPE_DIRECTORY;
+            unlockArchiver(i);
+        } /* if */
+
+        retval = statcallback(data, _fname, ptr, &statbuf);
+    } /* else */
     __PHYSFS_smallFree(mountPoint);
 
     BAIL_IF(retval == PHYSFS_ENUM_ERROR, PHYSFS_ERR_APP_CALLBACK, retval);
@@ -2400,6 +3980,55 @@ static PHYSFS_EnumerateCallbackResult enumCallbackFilterSymLinks(void *_data,
 } /* enumCallbackFilterSymLinks */
 
 
+/*
+ * Broke out to seperate function so the caller can lock around it.
+ *  (filterdata) is only used if symlinks aren't permitted.
+ */
+static PHYSFS_EnumerateCallbackResult enumerateFromArchive(DirHandle *i,
+                                    char *arcfname,
+                                    PHYSFS_EnumerateCallback cb,
+                                    const char *_fn, void *data,
+                                    SymlinkFilterData *filterdata)
+{
+    PHYSFS_EnumerateCallbackResult retval = PHYSFS_ENUM_OK;
+    PHYSFS_Stat statbuf;
+
+    if (!verifyPath(i, &arcfname, 0))
+        return PHYSFS_ENUM_OK;  /* not in this archive, skip it. */
+
+    if (!i->funcs->stat(i->opaque, arcfname, &statbuf))
+    {
+        if (currentErrorCode() == PHYSFS_ERR_NOT_FOUND)
+            return PHYSFS_ENUM_OK;  /* no such dir in this archive, skip it. */
+    } /* if */
+
+    if (statbuf.filetype != PHYSFS_FILETYPE_DIRECTORY)
+        return PHYSFS_ENUM_OK;  /* not a directory in this archive, skip it. */
+
+    else if ((!allowSymLinks) && (i->funcs->info.supportsSymlinks))
+    {
+        filterdata->dirhandle = i;
+        filterdata->arcfname = arcfname;
+        filterdata->errcode = PHYSFS_ERR_OK;
+        retval = i->funcs->enumerate(i->opaque, arcfname,
+                                     enumCallbackFilterSymLinks,
+                                     _fn, filterdata);
+        if (retval == PHYSFS_ENUM_ERROR)
+        {
+            if (currentErrorCode() == PHYSFS_ERR_APP_CALLBACK)
+                PHYSFS_setErrorCode(filterdata->errcode);
+        } /* if */
+    } /* else if */
+
+    else
+    {
+        retval = i->funcs->enumerate(i->opaque, arcfname, cb, _fn, data);
+    } /* else */
+
+    return retval;
+} /* enumerateFromArchive */
+
+
 int PHYSFS_enumerate(const char *_fn, PHYSFS_EnumerateCallback cb, void *data)
 {
     PHYSFS_EnumerateCallbackResult retval = PHYSFS_ENUM_OK;
@@ -2420,7 +4049,7 @@ int PHYSFS_enumerate(const char *_fn, PHYSFS_EnumerateCallback cb, void *data)
         DirHandle *i;
         SymlinkFilterData filterdata;
 
-        __PHYSFS_platformGrabMutex(stateLock);
+        __PHYSFS_platformGrabRWLockShared(stateLock);
 
         if (!allowSymLinks)
         {
@@ -2434,49 +4063,200 @@ int PHYSFS_enumerate(const char *_fn, PHYSFS_EnumerateCallback cb, void *data)
             char *arcfname = fname;
 
             if (partOfMountPoint(i, arcfname))
-                retval = enumerateFromMountPoint(i, arcfname, cb, _fn, data);
+                retval = enumerateFromMountPoint(i, arcfname, cb, NULL,
+                                                 _fn, data);
 
-            else if (verifyPath(i, &arcfname, 0))
+            else
             {
-                PHYSFS_Stat statbuf;
-                if (!i->funcs->stat(i->opaque, arcfname, &statbuf))
-                {
-                    if (currentErrorCode() == PHYSFS_ERR_NOT_FOUND)
-                        continue;  /* no such dir in this archive, skip it. */
-                } /* if */
+                lockArchiver(i);
+                retval = enumerateFromArchive(i, arcfname, cb, _fn, data,
+                                              &filterdata);
+                unlockArchiver(i);
+            } /* else */
+        } /* for */
+
+        __PHYSFS_platformReleaseRWLock(stateLock);
+    } /* if */
 
-                if (statbuf.filetype != PHYSFS_FILETYPE_DIRECTORY)
-                    continue;  /* not a directory in this archive, skip it. */
+    __PHYSFS_smallFree(fname);
 
-                else if ((!allowSymLinks) && (i->funcs->info.supportsSymlinks))
-                {
-                    filterdata.dirhandle = i;
-                    filterdata.arcfname = arcfname;
-                    filterdata.errcode = PHYSFS_ERR_OK;
-                    retval = i->funcs->enumerate(i->opaque, arcfname,
-                                                 enumCallbackFilterSymLinks,
-                                                 _fn, &filterdata);
-                    if (retval == PHYSFS_ENUM_ERROR)
-                    {
-                        if (currentErrorCode() == PHYSFS_ERR_APP_CALLBACK)
-                            PHYSFS_setErrorCode(filterdata.errcode);
-                    } /* if */
-                } /* else if */
-                else
-                {
-                    retval = i->funcs->enumerate(i->opaque, arcfname,
-                                                 cb, _fn, data);
-                } /* else */
-            } /* else if */
+    return (retval == PHYSFS_ENUM_ERROR) ? 0 : 1;
+} /* PHYSFS_enumerate */
+
+
+typedef struct StatEnumData
+{
+    PHYSFS_EnumerateStatCallback callback;
+    void *callbackData;
+    DirHandle *dirhandle;
+    const char *arcfname;
+    int filterSymLinks;
+    PHYSFS_ErrorCode errcode;
+} StatEnumData;
+
+/* The native dir archiver gets stats with its directory listing. */
+static PHYSFS_EnumerateCallbackResult enumStatCallbackFilter(void *_data,
+                                    const char *origdir, const char *fname,
+                                    const PHYSFS_Stat *stat)
+{
+    StatEnumData *data = (StatEnumData *) _data;
+    PHYSFS_EnumerateCallbackResult retval;
+
+    if ((data->filterSymLinks) && (stat->filetype == PHYSFS_FILETYPE_SYMLINK))
+        return PHYSFS_ENUM_OK;  /* skip it, but keep going. */
+
+    retval = data->callback(data->callbackData, origdir, fname, stat);
+    if (retval == PHYSFS_ENUM_ERROR)
+        data->errcode = PHYSFS_ERR_APP_CALLBACK;
+    return retval;
+} /* enumStatCallbackFilter */
+
+
+/* Everything else gets asked, but only the archive that had the name. */
+static PHYSFS_EnumerateCallbackResult enumStatCallbackLookup(void *_data,
+                                    const char *origdir, const char *fname)
+{
+    StatEnumData *data = (StatEnumData *) _data;
+    const DirHandle *dh = data->dirhandle;
+    const char *arcfname = data->arcfname;
+    PHYSFS_Stat statbuf;
+    const char *trimmedDir = (*arcfname == '/') ? (arcfname + 1) : arcfname;
+    const size_t slen = strlen(trimmedDir) + strlen(fname) + 2;
+    char *path = (char *) __PHYSFS_smallAlloc(slen);
+    PHYSFS_EnumerateCallbackResult retval;
+
+    if (path == NULL)
+    {
+        data->errcode = PHYSFS_ERR_OUT_OF_MEMORY;
+        return PHYSFS_ENUM_ERROR;
+    } /* if */
+
+    snprintf(path, slen, "%s%s%s", trimmedDir, *trimmedDir ? "/" : "", fname);
+
+    /* set some sane defaults, like PHYSFS_stat() does... */
+    statbuf.filesize = -1;
+    statbuf.modtime = -1;
+    statbuf.createtime = -1;
+    statbuf.accesstime = -1;
+    statbuf.filetype = PHYSFS_FILETYPE_OTHER;
+    statbuf.readonly = 1;
+
+    if (!dh->funcs->stat(dh->opaque, path, &statbuf))
+    {
+        data->errcode = currentErrorCode();
+        retval = PHYSFS_ENUM_ERROR;
+    } /* if */
+    else
+    {
+        retval = enumStatCallbackFilter(data, origdir, fname, &statbuf);
+    } /* else */
+
+    __PHYSFS_smallFree(path);
+
+    return retval;
+} /* enumStatCallbackLookup */
+
+
+/* Broke out to seperate function so the caller can lock around it. */
+static PHYSFS_EnumerateCallbackResult enumerateWithStatFromArchive(
+                                    DirHandle *i, char *arcfname,
+                                    const char *_fn, StatEnumData *data)
+{
+    PHYSFS_EnumerateCallbackResult retval = PHYSFS_ENUM_OK;
+    PHYSFS_Stat statbuf;
+
+    if (!verifyPath(i, &arcfname, 0))
+        return PHYSFS_ENUM_OK;  /* not in this archive, skip it. */
+
+    if (!i->funcs->stat(i->opaque, arcfname, &statbuf))
+    {
+        if (currentErrorCode() == PHYSFS_ERR_NOT_FOUND)
+            return PHYSFS_ENUM_OK;  /* no such dir in this archive, skip it. */
+    } /* if */
+
+    if (statbuf.filetype != PHYSFS_FILETYPE_DIRECTORY)
+        return PHYSFS_ENUM_OK;  /* not a directory in this archive, skip it. */
+
+    data->dirhandle = i;
+    data->arcfname = arcfname;
+    data->filterSymLinks = (!allowSymLinks) && (i->funcs->info.supportsSymlinks);
+    data->errcode = PHYSFS_ERR_OK;
+
+    if (i->funcs == &__PHYSFS_Archiver_DIR)
+    {
+        retval = __PHYSFS_DIR_enumerateWithStat(i->opaque, arcfname,
+                                                enumStatCallbackFilter,
+                                                _fn, data);
+    } /* if */
+    else
+    {
+        retval = i->funcs->enumerate(i->opaque, arcfname,
+                                     enumStatCallbackLookup, _fn, data);
+    } /* else */
+
+    if (retval == PHYSFS_ENUM_ERROR)
+    {
+        if (currentErrorCode() == PHYSFS_ERR_APP_CALLBACK)
+            PHYSFS_setErrorCode(data->errcode);
+    } /* if */
+
+    return retval;
+} /* enumerateWithStatFromArchive */
+
+
+int PHYSFS_enumerateWithStat(const char *_fn, PHYSFS_EnumerateStatCallback cb,
+                             void *data)
+{
+    PHYSFS_EnumerateCallbackResult retval = PHYSFS_ENUM_OK;
+    size_t len;
+    char *fname;
+
+    BAIL_IF(!_fn, PHYSFS_ERR_INVALID_ARGUMENT, 0);
+    BAIL_IF(!cb, PHYSFS_ERR_INVALID_ARGUMENT, 0);
+
+    len = strlen(_fn) + 1;
+    fname = (char *) __PHYSFS_smallAlloc(len);
+    BAIL_IF(!fname, PHYSFS_ERR_OUT_OF_MEMORY, 0);
+
+    if (!sanitizePlatformIndependentPath(_fn, fname))
+        retval = PHYSFS_ENUM_STOP;
+    else
+    {
+        DirHandle *i;
+        StatEnumData statdata;
+
+        memset(&statdata, '\0', sizeof (statdata));
+        statdata.callback = cb;
+        statdata.callbackData = data;
+
+        __PHYSFS_platformGrabRWLockShared(stateLock);
+
+        for (i = searchPath; (retval == PHYSFS_ENUM_OK) && i; i = i->next)
+        {
+            char *arcfname = fname;
+
+            if (partOfMountPoint(i, arcfname))
+            {
+                retval = enumerateFromMountPoint(i, arcfname, NULL, cb,
+                                                 _fn, data);
+            } /* if */
+
+            else
+            {
+                lockArchiver(i);
+                retval = enumerateWithStatFromArchive(i, arcfname, _fn,
+                                                      &statdata);
+                unlockArchiver(i);
+            } /* else */
         } /* for */
 
-        __PHYSFS_platformReleaseMutex(stateLock);
+        __PHYSFS_platformReleaseRWLock(stateLock);
     } /* if */
 
     __PHYSFS_smallFree(fname);
 
     return (retval == PHYSFS_ENUM_ERROR) ? 0 : 1;
-} /* PHYSFS_enumerate */
+} /* PHYSFS_enumerateWithStat */
 
 
 typedef struct
@@ -2504,215 +4284,2050 @@ void PHYSFS_enumerateFilesCallback(const char *fname,
 } /* PHYSFS_enumerateFilesCallback */
 
 
-int PHYSFS_exists(const char *fname)
-{
-    return (getRealDirHandle(fname) != NULL);
-} /* PHYSFS_exists */
+/*
+ * PHYSFS_enumerateGlob() compiles its pattern into one segment per path
+ *  element, then walks each archive carrying a set of bits that say which
+ *  segments the next name could match, a bit like a tiny regex engine. A
+ *  directory is only entered while some bit survives, so the pattern's fixed
+ *  parts prune the walk, and when the only thing that could match next is a
+ *  segment without wildcards, that name is just looked up instead.
+ */
 
+#define GLOB_MAX_SEGMENTS 64
+#define GLOB_BIT(x) (((PHYSFS_uint64) 1) << (x))
 
-PHYSFS_sint64 PHYSFS_getLastModTime(const char *fname)
+typedef enum GlobSegmentType
 {
-    PHYSFS_Stat statbuf;
-    BAIL_IF_ERRPASS(!PHYSFS_stat(fname, &statbuf), -1);
-    return statbuf.modtime;
-} /* PHYSFS_getLastModTime */
+    GLOB_LITERAL,   /* no wildcards; can be looked up directly. */
+    GLOB_WILDCARD,  /* has '*' or '?' in it. */
+    GLOB_ANYDEPTH   /* "**", which is zero or more directories. */
+} GlobSegmentType;
 
-
-int PHYSFS_isDirectory(const char *fname)
+typedef struct GlobSegment
 {
-    PHYSFS_Stat statbuf;
-    BAIL_IF_ERRPASS(!PHYSFS_stat(fname, &statbuf), 0);
-    return (statbuf.filetype == PHYSFS_FILETYPE_DIRECTORY);
-} /* PHYSFS_isDirectory */
+    GlobSegmentType type;
+    const char *piece;   /* as the app wrote it. */
+    const char *folded;  /* case-folded, for archives that ignore case. */
+} GlobSegment;
 
-
-int PHYSFS_isSymbolicLink(const char *fname)
+typedef struct GlobPattern
 {
-    PHYSFS_Stat statbuf;
-    BAIL_IF_ERRPASS(!PHYSFS_stat(fname, &statbuf), 0);
-    return (statbuf.filetype == PHYSFS_FILETYPE_SYMLINK);
-} /* PHYSFS_isSymbolicLink */
+    PHYSFS_uint32 count;
+    GlobSegment segments[GLOB_MAX_SEGMENTS];
+} GlobPattern;
 
 
-static PHYSFS_File *doOpenWrite(const char *_fname, int appending)
+/* chop the next path element off (*_str), or return NULL at the end. */
+static char *nextGlobPiece(char **_str)
 {
-    FileHandle *fh = NULL;
-    size_t len;
-    char *fname;
+    char *retval = *_str;
+    char *sep;
 
-    BAIL_IF(!_fname, PHYSFS_ERR_INVALID_ARGUMENT, 0);
-    len = strlen(_fname) + 1;
-    fname = (char *) __PHYSFS_smallAlloc(len);
-    BAIL_IF(!fname, PHYSFS_ERR_OUT_OF_MEMORY, 0);
+    if (*retval == '\0')
+        return NULL;
+
+    sep = strchr(retval, '/');
+    if (sep == NULL)
+        *_str = retval + strlen(retval);
+    else
+    {
+        *sep = '\0';
+        *_str = sep + 1;
+    } /* else */
+
+    return retval;
+} /* nextGlobPiece */
+
+
+/* the segments point into the same allocation, so just free the pattern. */
+static GlobPattern *compileGlob(const char *pattern)
+{
+    const size_t len = strlen(pattern) + 1;
+    const size_t foldlen = __PHYSFS_CASEFOLD_BUFLEN(len);
+    GlobPattern *retval;
+    char *raw;
+    char *folded;
+    char *piece;
+
+    retval = (GlobPattern *) allocator.Malloc(sizeof (GlobPattern) +
+                                              len + foldlen);
+    BAIL_IF(!retval, PHYSFS_ERR_OUT_OF_MEMORY, NULL);
+    raw = (char *) (retval + 1);
+    folded = raw + len;
+
+    /* same rules as any other path, so no "..", ':' or '\\' pieces. */
+    GOTO_IF_ERRPASS(!sanitizePlatformIndependentPath(pattern, raw), failed);
+    __PHYSFS_utf8CaseFold(raw, folded);
+
+    retval->count = 0;
+    while ((piece = nextGlobPiece(&raw)) != NULL)
+    {
+        char *foldedpiece = nextGlobPiece(&folded);
+        GlobSegmentType type = GLOB_LITERAL;
+        GlobSegment *seg;
+
+        assert(foldedpiece != NULL);  /* folding never adds or drops '/'. */
+
+        if (strcmp(piece, "**") == 0)
+            type = GLOB_ANYDEPTH;
+        else if (strpbrk(piece, "*?") != NULL)
+            type = GLOB_WILDCARD;
+
+        if ((type == GLOB_ANYDEPTH) && (retval->count > 0) &&
+            (retval->segments[retval->count - 1].type == GLOB_ANYDEPTH))
+            continue;  /* "**" twice in a row is the same as once. */
+
+        GOTO_IF(retval->count == GLOB_MAX_SEGMENTS,
+                PHYSFS_ERR_INVALID_ARGUMENT, failed);
+
+        seg = &retval->segments[retval->count++];
+        seg->type = type;
+        seg->piece = piece;
+        seg->folded = foldedpiece;
+    } /* while */
+
+    GOTO_IF(retval->count == 0, PHYSFS_ERR_INVALID_ARGUMENT, failed);
+    return retval;
+
+failed:
+    allocator.Free(retval);
+    return NULL;
+} /* compileGlob */
+
+
+/* step over one UTF-8 sequence. */
+static const char *globNextChar(const char *str)
+{
+    str++;
+    while ((((PHYSFS_uint8) *str) & 0xC0) == 0x80)
+        str++;
+    return str;
+} /* globNextChar */
+
+
+/*
+ * '*' is any run of characters and '?' is any one. This is the usual
+ *  iterative matcher: on a mismatch, the most recent '*' takes one more
+ *  character and we try again from there, so nothing recurses.
+ */
+static int globMatchPiece(const char *pat, const char *str)
+{
+    const char *starpat = NULL;
+    const char *starstr = NULL;
+
+    while (*str)
+    {
+        if (*pat == '*')
+        {
+            while (*pat == '*')
+                pat++;
+            if (*pat == '\0')
+                return 1;  /* trailing '*' takes whatever's left. */
+            starpat = pat;
+            starstr = str;
+        } /* if */
+
+        else if (*pat == '?')
+        {
+            pat++;
+            str = globNextChar(str);
+        } /* else if */
+
+        else if (*pat == *str)
+        {
+            pat++;
+            str++;
+        } /* else if */
+
+        else if (starpat != NULL)
+        {
+            starstr = globNextChar(starstr);
+            str = starstr;
+            pat = starpat;
+        } /* else if */
+
+        else
+        {
+            return 0;
+        } /* else */
+    } /* while */
+
+    while (*pat == '*')
+        pat++;
+
+    return (*pat == '\0');
+} /* globMatchPiece */
+
+
+/* a "**" can match nothing at all, so whatever follows it is live, too. */
+static PHYSFS_uint64 globClosure(const GlobPattern *pat, PHYSFS_uint64 states)
+{
+    PHYSFS_uint32 i;
+    for (i = 0; (i + 1) < pat->count; i++)
+    {
+        if ((states & GLOB_BIT(i)) && (pat->segments[i].type == GLOB_ANYDEPTH))
+            states |= GLOB_BIT(i + 1);
+    } /* for */
+    return states;
+} /* globClosure */
+
+
+/*
+ * Feed one name in a directory through (states), which came from
+ *  globClosure(). Returns the states to carry into that name, if it's a
+ *  directory, and sets (*matched) if the name matches the whole pattern.
+ */
+static PHYSFS_uint64 globStep(const GlobPattern *pat,
+                              const PHYSFS_uint64 states, const char *name,
+                              const int folded, int *matched)
+{
+    const PHYSFS_uint32 last = pat->count - 1;
+    PHYSFS_uint64 retval = 0;
+    PHYSFS_uint32 i;
+
+    *matched = 0;
+    for (i = 0; i < pat->count; i++)
+    {
+        const GlobSegment *seg = &pat->segments[i];
+        if ((states & GLOB_BIT(i)) == 0)
+            continue;
+
+        else if (seg->type == GLOB_ANYDEPTH)
+        {
+            retval |= GLOB_BIT(i);  /* might still be inside the "**". */
+            if (i == last)
+                *matched = 1;
+        } /* else if */
+
+        else if (globMatchPiece(folded ? seg->folded : seg->piece, name))
+        {
+            if (i == last)
+                *matched = 1;
+            else
+                retval |= GLOB_BIT(i + 1);
+        } /* else if */
+    } /* for */
+
+    return retval;
+} /* globStep */
+
+
+/* If (states) can only match one fixed name, return that segment. */
+static const GlobSegment *globLoneLiteral(const GlobPattern *pat,
+                                          const PHYSFS_uint64 states)
+{
+    PHYSFS_uint32 i;
+
+    if ((states == 0) || ((states & (states - 1)) != 0))
+        return NULL;  /* not exactly one bit set. */
+
+    for (i = 0; (states & GLOB_BIT(i)) == 0; i++) { /* spin */ }
+    return (pat->segments[i].type == GLOB_LITERAL) ? &pat->segments[i] : NULL;
+} /* globLoneLiteral */
+
+
+typedef struct GlobWalk
+{
+    const GlobPattern *pattern;
+    PHYSFS_EnumerateCallback callback;
+    void *callbackData;
+    DirHandle *dirhandle;
+    int ignorecase;     /* fold names from (dirhandle) before matching. */
+    char *path;         /* virtual path of the directory being walked.  */
+    size_t pathlen;
+    size_t pathalloc;
+    size_t arcstart;    /* where (dirhandle)'s own part of (path) starts. */
+    PHYSFS_ErrorCode errcode;  /* why the walk was abandoned. */
+} GlobWalk;
+
+static PHYSFS_EnumerateCallbackResult globFail(GlobWalk *w,
+                                               const PHYSFS_ErrorCode err)
+{
+    if (w->errcode == PHYSFS_ERR_OK)
+        w->errcode = err;
+    return PHYSFS_ENUM_ERROR;
+} /* globFail */
+
+
+static int globPushPath(GlobWalk *w, const char *name)
+{
+    const size_t namelen = strlen(name);
+    const size_t needed = w->pathlen + namelen + 2;
+
+    if (needed > w->pathalloc)
+    {
+        size_t newalloc = w->pathalloc ? w->pathalloc : 128;
+        void *ptr;
+        while (newalloc < needed)
+            newalloc *= 2;
+        ptr = allocator.Realloc(w->path, newalloc);
+        BAIL_IF(!ptr, PHYSFS_ERR_OUT_OF_MEMORY, 0);
+        w->path = (char *) ptr;
+        w->pathalloc = newalloc;
+    } /* if */
+
+    if ((w->pathlen > 0) && (namelen > 0))
+        w->path[w->pathlen++] = '/';
+    memcpy(w->path + w->pathlen, name, namelen + 1);
+    w->pathlen += namelen;
+    return 1;
+} /* globPushPath */
+
+
+static void globPopPath(GlobWalk *w, const size_t oldlen)
+{
+    w->pathlen = oldlen;
+    w->path[oldlen] = '\0';
+} /* globPopPath */
+
+
+/* the current path, as (dirhandle)'s archiver knows it. */
+static const char *globArchivePath(const GlobWalk *w)
+{
+    const char *retval = w->path + w->arcstart;
+    return (*retval == '/') ? (retval + 1) : retval;
+} /* globArchivePath */
+
+
+/* globStep(), but folding (name) first if this archive ignores case. */
+static int globName(const GlobWalk *w, const char *name,
+                    const PHYSFS_uint64 states, PHYSFS_uint64 *next,
+                    int *matched)
+{
+    char *folded;
+
+    if (!w->ignorecase)
+    {
+        *next = globStep(w->pattern, states, name, 0, matched);
+        return 1;
+    } /* if */
+
+    folded = (char *) __PHYSFS_smallAlloc(
+                            __PHYSFS_CASEFOLD_BUFLEN(strlen(name)));
+    BAIL_IF(!folded, PHYSFS_ERR_OUT_OF_MEMORY, 0);
+    __PHYSFS_utf8CaseFold(name, folded);
+    *next = globStep(w->pattern, states, folded, 1, matched);
+    __PHYSFS_smallFree(folded);
+    return 1;
+} /* globName */
+
+
+static PHYSFS_EnumerateCallbackResult globReport(GlobWalk *w,
+                                                 const char *name)
+{
+    const PHYSFS_EnumerateCallbackResult retval =
+                        w->callback(w->callbackData, w->path, name);
+    if (retval == PHYSFS_ENUM_ERROR)
+        return globFail(w, PHYSFS_ERR_APP_CALLBACK);
+    return retval;
+} /* globReport */
+
+
+/*
+ * Archivers that keep a __PHYSFS_DirTree (it's the first thing in their
+ *  opaque data) get walked right in the tree: names are matched where they
+ *  sit, and nothing is copied for ones that don't match.
+ */
+static PHYSFS_EnumerateCallbackResult globWalkDirTree(GlobWalk *w,
+                                    __PHYSFS_DirTree *tree,
+                                    const __PHYSFS_DirTreeEntry *dir,
+                                    const PHYSFS_uint64 states)
+{
+    PHYSFS_EnumerateCallbackResult retval = PHYSFS_ENUM_OK;
+    const GlobSegment *literal = globLoneLiteral(w->pattern, states);
+    const __PHYSFS_DirTreeEntry *entry = dir->children;
+
+    if (literal != NULL)
+    {
+        const size_t oldlen = w->pathlen;
+        if (!globPushPath(w, literal->piece))
+            return globFail(w, PHYSFS_ERR_OUT_OF_MEMORY);
+        entry = (const __PHYSFS_DirTreeEntry *)
+                    __PHYSFS_DirTreeFind(tree, globArchivePath(w));
+        globPopPath(w, oldlen);
+    } /* if */
+
+    while (entry && (retval == PHYSFS_ENUM_OK))
+    {
+        const char *ptr = strrchr(entry->name, '/');
+        const char *name = ptr ? ptr + 1 : entry->name;
+        PHYSFS_uint64 next;
+        int matched;
+
+        if (!globName(w, name, states, &next, &matched))
+            return globFail(w, PHYSFS_ERR_OUT_OF_MEMORY);
+
+        if (matched)
+            retval = globReport(w, name);
+
+        if ((retval == PHYSFS_ENUM_OK) && (next != 0) && (entry->isdir))
+        {
+            const size_t oldlen = w->pathlen;
+            if (!globPushPath(w, name))
+                return globFail(w, PHYSFS_ERR_OUT_OF_MEMORY);
+            retval = globWalkDirTree(w, tree, entry,
+                                     globClosure(w->pattern, next));
+            globPopPath(w, oldlen);
+        } /* if */
+
+        entry = (literal != NULL) ? NULL : entry->sibling;
+    } /* while */
+
+    return retval;
+} /* globWalkDirTree */
+
+
+typedef struct GlobPending
+{
+    char *name;
+    PHYSFS_uint64 states;
+} GlobPending;
+
+typedef struct GlobDirData
+{
+    GlobWalk *walk;
+    PHYSFS_uint64 states;
+    GlobPending *pending;  /* subdirs to walk once the archiver is done. */
+    size_t pendingCount;
+    size_t pendingAlloc;
+} GlobDirData;
+
+/* (stat) is NULL if nobody has asked about (name) yet. */
+static PHYSFS_EnumerateCallbackResult globConsider(GlobDirData *d,
+                                    const char *name, const PHYSFS_Stat *stat)
+{
+    GlobWalk *w = d->walk;
+    const DirHandle *dh = w->dirhandle;
+    PHYSFS_EnumerateCallbackResult retval = PHYSFS_ENUM_OK;
+    PHYSFS_Stat statbuf;
+    PHYSFS_uint64 next;
+    int matched;
+
+    if (!globName(w, name, d->states, &next, &matched))
+        return globFail(w, PHYSFS_ERR_OUT_OF_MEMORY);
+    else if ((!matched) && (next == 0))
+        return PHYSFS_ENUM_OK;  /* nothing in the pattern wants this one. */
+
+    if (stat == NULL)
+    {
+        const size_t oldlen = w->pathlen;
+        int rc;
+        if (!globPushPath(w, name))
+            return globFail(w, PHYSFS_ERR_OUT_OF_MEMORY);
+        rc = dh->funcs->stat(dh->opaque, globArchivePath(w), &statbuf);
+        globPopPath(w, oldlen);
+        if (!rc)
+        {
+            const PHYSFS_ErrorCode err = currentErrorCode();
+            if (err == PHYSFS_ERR_NOT_FOUND)
+                return PHYSFS_ENUM_OK;  /* a looked-up name that isn't here. */
+            return globFail(w, err);
+        } /* if */
+        stat = &statbuf;
+    } /* if */
+
+    if ((!allowSymLinks) && (stat->filetype == PHYSFS_FILETYPE_SYMLINK))
+        return PHYSFS_ENUM_OK;  /* same as PHYSFS_enumerate() would do. */
+
+    if (matched)
+        retval = globReport(w, name);
+
+    if ((retval == PHYSFS_ENUM_OK) && (next != 0) &&
+        (stat->filetype == PHYSFS_FILETYPE_DIRECTORY))
+    {
+        GlobPending *pending;
+        char *str;
+
+        if (d->pendingCount == d->pendingAlloc)
+        {
+            const size_t newalloc = d->pendingAlloc ? d->pendingAlloc * 2 : 8;
+            void *ptr = allocator.Realloc(d->pending,
+                                          newalloc * sizeof (GlobPending));
+            if (!ptr)
+                return globFail(w, PHYSFS_ERR_OUT_OF_MEMORY);
+            d->pending = (GlobPending *) ptr;
+            d->pendingAlloc = newalloc;
+        } /* if */
+
+        str = __PHYSFS_strdup(name);
+        if (!str)
+            return globFail(w, PHYSFS_ERR_OUT_OF_MEMORY);
+        pending = &d->pending[d->pendingCount++];
+        pending->name = str;
+        pending->states = next;
+    } /* if */
+
+    return retval;
+} /* globConsider */
+
+
+static PHYSFS_EnumerateCallbackResult globEnumCallback(void *data,
+                                    const char *origdir, const char *fname)
+{
+    return globConsider((GlobDirData *) data, fname, NULL);
+} /* globEnumCallback */
+
+
+static PHYSFS_EnumerateCallbackResult globEnumStatCallback(void *data,
+                                    const char *origdir, const char *fname,
+                                    const PHYSFS_Stat *stat)
+{
+    return globConsider((GlobDirData *) data, fname, stat);
+} /* globEnumStatCallback */
+
+
+/*
+ * Everything else goes through the archiver's enumerate(), filtered as it
+ *  comes. Subdirectories are walked after enumerate() returns, since it
+ *  might not like being called again from inside its own callback.
+ */
+static PHYSFS_EnumerateCallbackResult globWalkArchive(GlobWalk *w,
+                                                const PHYSFS_uint64 states)
+{
+    const DirHandle *dh = w->dirhandle;
+    const GlobSegment *literal = NULL;
+    PHYSFS_EnumerateCallbackResult retval;
+    GlobDirData d;
+    size_t i;
+
+    memset(&d, '\0', sizeof (d));
+    d.walk = w;
+    d.states = states;
+
+    /* a plain stat() of a name might not find it in the wrong case. */
+    if (!w->ignorecase)
+        literal = globLoneLiteral(w->pattern, states);
+
+    if (literal != NULL)
+        retval = globConsider(&d, literal->piece, NULL);
+    else if (dh->funcs == &__PHYSFS_Archiver_DIR)
+    {
+        retval = __PHYSFS_DIR_enumerateWithStat(dh->opaque,
+                                                globArchivePath(w),
+                                                globEnumStatCallback,
+                                                w->path, &d);
+    } /* else if */
+    else
+    {
+        retval = dh->funcs->enumerate(dh->opaque, globArchivePath(w),
+                                      globEnumCallback, w->path, &d);
+    } /* else */
+
+    if (retval == PHYSFS_ENUM_ERROR)
+        globFail(w, currentErrorCode());  /* no-op if we failed it. */
+
+    for (i = 0; i < d.pendingCount; i++)
+    {
+        if (retval == PHYSFS_ENUM_OK)
+        {
+            const size_t oldlen = w->pathlen;
+            if (!globPushPath(w, d.pending[i].name))
+                retval = globFail(w, PHYSFS_ERR_OUT_OF_MEMORY);
+            else
+            {
+                retval = globWalkArchive(w, globClosure(w->pattern,
+                                                        d.pending[i].states));
+                globPopPath(w, oldlen);
+            } /* else */
+        } /* if */
+        allocator.Free(d.pending[i].name);
+    } /* for */
+
+    if (d.pending)
+        allocator.Free(d.pending);
+
+    return retval;
+} /* globWalkArchive */
+
+
+/* (fname) is the sanitized directory the glob starts from. */
+static PHYSFS_EnumerateCallbackResult globWalkDirHandle(GlobWalk *w,
+                                                DirHandle *dh, char *fname)
+{
+    PHYSFS_EnumerateCallbackResult retval = PHYSFS_ENUM_OK;
+    PHYSFS_uint64 states = globClosure(w->pattern, GLOB_BIT(0));
+    char *arcfname = fname;
+
+    w->dirhandle = dh;
+    w->ignorecase = dh->ignoreCase;
+    globPopPath(w, 0);
+    if (!globPushPath(w, fname))
+        return globFail(w, PHYSFS_ERR_OUT_OF_MEMORY);
+
+    if (partOfMountPoint(dh, fname))
+    {
+        /* the rest of the mountpoint are directories we have to get past. */
+        const size_t slen = strlen(dh->mountPoint) + 1;
+        char *mountPoint = (char *) __PHYSFS_smallAlloc(slen);
+        char *ptr;
+        char *piece;
+
+        if (!mountPoint)
+            return globFail(w, PHYSFS_ERR_OUT_OF_MEMORY);
+
+        strcpy(mountPoint, dh->mountPoint);
+        ptr = mountPoint + ((*fname) ? strlen(fname) + 1 : 0);
+        while ((states != 0) && (retval == PHYSFS_ENUM_OK) &&
+               ((piece = nextGlobPiece(&ptr)) != NULL))
+        {
+            PHYSFS_uint64 next;
+            int matched;
+            if (!globName(w, piece, states, &next, &matched))
+            {
+                retval = globFail(w, PHYSFS_ERR_OUT_OF_MEMORY);
+                break;
+            } /* if */
+
+            if (matched)
+                retval = globReport(w, piece);
+            if (!globPushPath(w, piece))
+                retval = globFail(w, PHYSFS_ERR_OUT_OF_MEMORY);
+            states = (next == 0) ? 0 : globClosure(w->pattern, next);
+        } /* while */
+
+        __PHYSFS_smallFree(mountPoint);
+
+        if ((retval != PHYSFS_ENUM_OK) || (states == 0))
+            return retval;
+
+        w->arcstart = w->pathlen;
+    } /* if */
+
+    else if (!verifyPath(dh, &arcfname, 0))
+        return PHYSFS_ENUM_OK;  /* not in this archive, skip it. */
+
+    else
+        w->arcstart = (size_t) (arcfname - fname);
+
+    if ((dh->funcs->enumerate == __PHYSFS_DirTreeEnumerate) &&
+        ((allowSymLinks) || (!dh->funcs->info.supportsSymlinks)))
+    {
+        __PHYSFS_DirTree *tree = (__PHYSFS_DirTree *) dh->opaque;
+        const __PHYSFS_DirTreeEntry *entry = (const __PHYSFS_DirTreeEntry *)
+                            __PHYSFS_DirTreeFind(tree, globArchivePath(w));
+        if ((!entry) || (!entry->isdir))
+            return PHYSFS_ENUM_OK;  /* no such dir in this archive. */
+        retval = globWalkDirTree(w, tree, entry, states);
+    } /* if */
+
+    else
+    {
+        PHYSFS_Stat statbuf;
+        if (!dh->funcs->stat(dh->opaque, globArchivePath(w), &statbuf))
+            return PHYSFS_ENUM_OK;  /* no such dir in this archive. */
+        else if (statbuf.filetype != PHYSFS_FILETYPE_DIRECTORY)
+            return PHYSFS_ENUM_OK;  /* not a dir in this archive. */
+        retval = globWalkArchive(w, states);
+    } /* else */
+
+    return retval;
+} /* globWalkDirHandle */
+
+
+int PHYSFS_enumerateGlob(const char *_dir, const char *pattern,
+                         PHYSFS_EnumerateCallback cb, void *data)
+{
+    PHYSFS_EnumerateCallbackResult retval = PHYSFS_ENUM_OK;
+    GlobPattern *pat;
+    GlobWalk walk;
+    char *fname;
+
+    BAIL_IF(!_dir, PHYSFS_ERR_INVALID_ARGUMENT, 0);
+    BAIL_IF(!pattern, PHYSFS_ERR_INVALID_ARGUMENT, 0);
+    BAIL_IF(!cb, PHYSFS_ERR_INVALID_ARGUMENT, 0);
+
+    fname = (char *) __PHYSFS_smallAlloc(strlen(_dir) + 1);
+    BAIL_IF(!fname, PHYSFS_ERR_OUT_OF_MEMORY, 0);
+    if (!sanitizePlatformIndependentPath(_dir, fname))
+    {
+        __PHYSFS_smallFree(fname);
+        return 0;
+    } /* if */
+
+    pat = compileGlob(pattern);
+    if (!pat)
+    {
+        __PHYSFS_smallFree(fname);
+        return 0;
+    } /* if */
+
+    memset(&walk, '\0', sizeof (walk));
+    walk.pattern = pat;
+    walk.callback = cb;
+    walk.callbackData = data;
+    walk.errcode = PHYSFS_ERR_OK;
+
+    if (!globPushPath(&walk, ""))  /* get the buffer going. */
+        retval = globFail(&walk, PHYSFS_ERR_OUT_OF_MEMORY);
+    else
+    {
+        DirHandle *i;
+        __PHYSFS_platformGrabRWLockShared(stateLock);
+        for (i = searchPath; (retval == PHYSFS_ENUM_OK) && i; i = i->next)
+        {
+            lockArchiver(i);
+            retval = globWalkDirHandle(&walk, i, fname);
+            unlockArchiver(i);
+        } /* for */
+        __PHYSFS_platformReleaseRWLock(stateLock);
+    } /* else */
+
+    if (walk.path)
+        allocator.Free(walk.path);
+    allocator.Free(pat);
+    __PHYSFS_smallFree(fname);
+
+    BAIL_IF(retval == PHYSFS_ENUM_ERROR, walk.errcode, 0);
+    return 1;
+} /* PHYSFS_enumerateGlob */
+
+
+int PHYSFS_exists(const char *fname)
+{
+    return (getRealDirHandle(fname) != NULL);
+} /* PHYSFS_exists */
+
+
+PHYSFS_sint64 PHYSFS_getLastModTime(const char *fname)
+{
+    PHYSFS_Stat statbuf;
+    BAIL_IF_ERRPASS(!PHYSFS_stat(fname, &statbuf), -1);
+    return statbuf.modtime;
+} /* PHYSFS_getLastModTime */
+
+
+int PHYSFS_isDirectory(const char *fname)
+{
+    PHYSFS_Stat statbuf;
+    BAIL_IF_ERRPASS(!PHYSFS_stat(fname, &statbuf), 0);
+    return (statbuf.filetype == PHYSFS_FILETYPE_DIRECTORY);
+} /* PHYSFS_isDirectory */
+
+
+int PHYSFS_isSymbolicLink(const char *fname)
+{
+    PHYSFS_Stat statbuf;
+    BAIL_IF_ERRPASS(!PHYSFS_stat(fname, &statbuf), 0);
+    return (statbuf.filetype == PHYSFS_FILETYPE_SYMLINK);
+} /* PHYSFS_isSymbolicLink */
+
+
+/* report an open (or a failed one) to the trace callback, if there is one. */
+static void traceOpen(const FileHandle *fh, const char *fname,
+                      const PHYSFS_uint64 start)
+{
+    if (__PHYSFS_TRACING())
+    {
+        PHYSFS_TraceEvent event;
+        memset(&event, '\0', sizeof (event));
+        event.type = PHYSFS_TRACE_OPEN;
+        event.file = (PHYSFS_File *) fh;
+        event.filename = fname;
+        event.archive = fh ? fh->dirHandle->dirName : NULL;
+        event.result = (fh != NULL);
+        __PHYSFS_trace(&event, start);
+    } /* if */
+} /* traceOpen */
+
+
+/* PHYSFS_openWriteAtomic() writes to the target's name plus this... */
+#define ATOMIC_WRITE_SUFFIX ".physfs-new"
+
+/* ...and keeps both names in one block: (fname), then the temp name. */
+static char *makeAtomicNames(const char *fname)
+{
+    const size_t len = strlen(fname) + 1;
+    char *retval = (char *) allocator.Malloc((len * 2) +
+                                             strlen(ATOMIC_WRITE_SUFFIX));
+    BAIL_IF(!retval, PHYSFS_ERR_OUT_OF_MEMORY, NULL);
+    strcpy(retval, fname);
+    strcpy(retval + len, fname);
+    strcat(retval + len, ATOMIC_WRITE_SUFFIX);
+    return retval;
+} /* makeAtomicNames */
+
+
+static PHYSFS_File *doOpenWrite(const char *_fname, int appending,
+                                int atomic)
+{
+    FileHandle *fh = NULL;
+    char *atomicName = NULL;
+    size_t len;
+    char *fname;
+
+    BAIL_IF(!_fname, PHYSFS_ERR_INVALID_ARGUMENT, 0);
+    len = strlen(_fname) + 1;
+    fname = (char *) __PHYSFS_smallAlloc(len);
+    BAIL_IF(!fname, PHYSFS_ERR_OUT_OF_MEMORY, 0);
+
+    if (sanitizePlatformIndependentPath(_fname, fname))
+    {
+        const PHYSFS_uint64 start = __PHYSFS_TRACE_START();
+        PHYSFS_Io *io = NULL;
+        DirHandle *h = NULL;
+        const PHYSFS_Archiver *f;
+
+        __PHYSFS_platformGrabRWLockShared(stateLock);
+
+        GOTO_IF(!writeDir, PHYSFS_ERR_NO_WRITE_DIR, doOpenWriteEnd);
+
+        h = writeDir;
+        f = h->funcs;
+
+        /* renaming over the old file is the whole point, and only the
+           native filesystem can do that. */
+        GOTO_IF(atomic && (f != &__PHYSFS_Archiver_DIR),
+                PHYSFS_ERR_UNSUPPORTED, doOpenWriteEnd);
+
+        if (!atomic)  /* an atomic write doesn't touch (fname) until close. */
+            preloadForgetWritten(fname);
+
+        lockArchiver(h);
+        if (verifyPath(h, &fname, 0))
+        {
+            if (atomic)
+            {
+                atomicName = makeAtomicNames(fname);
+                if (atomicName != NULL)
+                {
+                    const char *tmp = atomicName + strlen(atomicName) + 1;
+                    io = f->openWrite(h->opaque, tmp);
+                } /* if */
+            } /* if */
+            else if (appending)
+                io = f->openAppend(h->opaque, fname);
+            else
+                io = f->openWrite(h->opaque, fname);
+        } /* if */
+        unlockArchiver(h);
+
+        GOTO_IF_ERRPASS(!io, doOpenWriteEnd);
+        invalidateMissCache();  /* (fname) exists now, if it didn't before. */
+
+        fh = (FileHandle *) __PHYSFS_poolAlloc(&fileHandlePool);
+        if (fh == NULL)
+        {
+            io->destroy(io);
+            if (atomicName != NULL)
+            {
+                lockArchiver(h);
+                f->remove(h->opaque, atomicName + strlen(atomicName) + 1);
+                unlockArchiver(h);
+            } /* if */
+            GOTO(PHYSFS_ERR_OUT_OF_MEMORY, doOpenWriteEnd);
+        } /* if */
+        else
+        {
+            const PHYSFS_uint64 wbsize = PHYSFS_getWriteBehind();
+            memset(fh, '\0', sizeof (FileHandle));
+            fh->io = io;
+            fh->dirHandle = h;
+            if (atomicName != NULL)
+            {
+                fh->atomicName = atomicName;
+                fh->atomicTemp = atomicName + strlen(atomicName) + 1;
+            } /* if */
+
+            fh->writeBehind = __PHYSFS_writeBehindCreate(io);
+            if ((fh->writeBehind == NULL) && (wbsize > 0))
+            {
+                /* no thread for it? Plain buffering is the next best. */
+                fh->buffer = (PHYSFS_uint8 *) allocator.Malloc((size_t) wbsize);
+                if (fh->buffer != NULL)
+                    fh->bufsize = (size_t) wbsize;
+            } /* if */
+
+            __PHYSFS_platformGrabMutex(fileListLock);
+            fh->next = openWriteList;
+            openWriteList = fh;
+            __PHYSFS_platformReleaseMutex(fileListLock);
+            __PHYSFS_STAT_INCR(opens);
+            ARCHIVE_STAT_ADD(h, opens, 1);
+        } /* else */
+
+        doOpenWriteEnd:
+        __PHYSFS_platformReleaseRWLock(stateLock);
+        if ((fh == NULL) && (atomicName != NULL))
+            allocator.Free(atomicName);
+        traceOpen(fh, _fname, start);
+    } /* if */
+
+    __PHYSFS_smallFree(fname);
+    return ((PHYSFS_File *) fh);
+} /* doOpenWrite */
+
+
+PHYSFS_File *PHYSFS_openWrite(const char *filename)
+{
+    return doOpenWrite(filename, 0, 0);
+} /* PHYSFS_openWrite */
+
+
+PHYSFS_File *PHYSFS_openAppend(const char *filename)
+{
+    return doOpenWrite(filename, 1, 0);
+} /* PHYSFS_openAppend */
+
+
+PHYSFS_File *PHYSFS_openWriteAtomic(const char *filename)
+{
+    return doOpenWrite(filename, 0, 1);
+} /* PHYSFS_openWriteAtomic */
+
+
+PHYSFS_File *PHYSFS_openRead(const char *_fname)
+{
+    FileHandle *fh = NULL;
+    char *fname;
+    size_t len;
+
+    BAIL_IF(!_fname, PHYSFS_ERR_INVALID_ARGUMENT, 0);
+    len = strlen(_fname) + 1;
+    fname = (char *) __PHYSFS_smallAlloc(len);
+    BAIL_IF(!fname, PHYSFS_ERR_OUT_OF_MEMORY, 0);
 
     if (sanitizePlatformIndependentPath(_fname, fname))
     {
-        PHYSFS_Io *io = NULL;
-        DirHandle *h = NULL;
-        const PHYSFS_Archiver *f;
+        const PHYSFS_uint64 start = __PHYSFS_TRACE_START();
+        DirHandle *i = NULL;
+        PHYSFS_Io *io = NULL;
+        const DirHandle *hint;
+        const void *owner;
+        int useIndex;
+        int missgen;
+
+        __PHYSFS_platformGrabRWLockShared(stateLock);
+
+        GOTO_IF(!searchPath, PHYSFS_ERR_NOT_FOUND, openReadEnd);
+
+        io = __PHYSFS_preloadGet(fname, &owner);
+        if (io != NULL)
+            i = (DirHandle *) owner;
+        else
+        {
+            GOTO_IF_ERRPASS(missCacheFind(fname, &missgen), openReadEnd);
+
+            useIndex = searchPathIndexLookup(fname, &hint);
+            for (i = searchPath; i != NULL; i = i->next)
+            {
+                char *arcfname = fname;
+                if (skipViaSearchPathIndex(i, &useIndex, hint))
+                    continue;
+
+                lockArchiver(i);
+                if (verifyPath(i, &arcfname, 0))
+                    io = i->funcs->openRead(i->opaque, arcfname);
+                unlockArchiver(i);
+
+                ARCHIVE_STAT_ADD(i, lookups, 1);
+                if (io)
+                    break;
+
+                ARCHIVE_STAT_ADD(i, misses, 1);
+                __PHYSFS_STAT_INCR(openMisses);
+            } /* for */
+        } /* else */
+
+        GOTO_IF_ERRPASS(!io, openReadEnd);
+
+        fh = (FileHandle *) __PHYSFS_poolAlloc(&fileHandlePool);
+        if (fh == NULL)
+        {
+            io->destroy(io);
+            GOTO(PHYSFS_ERR_OUT_OF_MEMORY, openReadEnd);
+        } /* if */
+
+        memset(fh, '\0', sizeof (FileHandle));
+        fh->io = io;
+        fh->forReading = 1;
+        fh->dirHandle = i;
+        __PHYSFS_platformGrabMutex(fileListLock);
+        fh->next = openReadList;
+        openReadList = fh;
+        __PHYSFS_platformReleaseMutex(fileListLock);
+        __PHYSFS_STAT_INCR(opens);
+        ARCHIVE_STAT_ADD(i, opens, 1);
+
+        openReadEnd:
+        __PHYSFS_platformReleaseRWLock(stateLock);
+        traceOpen(fh, _fname, start);
+    } /* if */
+
+    __PHYSFS_smallFree(fname);
+    return ((PHYSFS_File *) fh);
+} /* PHYSFS_openRead */
+
+
+/*
+ * MAKE SURE you hold stateLock! Move a closed PHYSFS_openWriteAtomic() file
+ *  over its target, or if (!ok) just throw it away. Either way the target
+ *  is untouched unless this succeeds.
+ */
+static int commitAtomicWrite(FileHandle *fh, int ok)
+{
+    const DirHandle *h = fh->dirHandle;
+
+    lockArchiver(h);
+    if (ok)
+        ok = __PHYSFS_DIR_rename(h->opaque, fh->atomicTemp, fh->atomicName);
+    if (!ok)
+    {
+        const PHYSFS_ErrorCode err = currentErrorCode();
+        h->funcs->remove(h->opaque, fh->atomicTemp);
+        PHYSFS_setErrorCode(err);
+    } /* if */
+    unlockArchiver(h);
+
+    if (ok)
+    {
+        preloadForgetWritten(fh->atomicName);
+        invalidateMissCache();
+    } /* if */
+
+    return ok;
+} /* commitAtomicWrite */
+
+
+/*
+ * __PHYSFS_writeBehindClose() calls this from the flusher thread once
+ *  (data)'s Io is written out and gone. Until now it stayed in the open
+ *  list, which keeps the write dir from going away under us.
+ */
+static int finishWriteBehindClose(void *data, const int ok)
+{
+    FileHandle *fh = (FileHandle *) data;
+    FileHandle **i;
+    int retval = ok;
+
+    if (fh->atomicName != NULL)
+    {
+        __PHYSFS_platformGrabRWLockShared(stateLock);
+        retval = commitAtomicWrite(fh, ok);
+        __PHYSFS_platformReleaseRWLock(stateLock);
+        allocator.Free(fh->atomicName);
+    } /* if */
+
+    __PHYSFS_platformGrabMutex(fileListLock);
+    for (i = &openWriteList; *i != NULL; i = &(*i)->next)
+    {
+        if (*i == fh)
+        {
+            *i = fh->next;
+            break;
+        } /* if */
+    } /* for */
+    __PHYSFS_platformReleaseMutex(fileListLock);
+
+    __PHYSFS_poolFree(&fileHandlePool, fh);
+    return retval;
+} /* finishWriteBehindClose */
+
+
+/*
+ * Returns 1 if (handle) was closed, 0 if it isn't in (list), -1 if it's
+ *  still open because it couldn't be flushed. A PHYSFS_openWriteAtomic()
+ *  handle without write-behind returns 2 and isn't freed: commit it with
+ *  commitAtomicWrite() once fileListLock is released.
+ */
+static int closeHandleInOpenList(FileHandle **list, FileHandle *handle)
+{
+    FileHandle *prev = NULL;
+    FileHandle *i;
+    int rc = 1;
+
+    for (i = *list; i != NULL; i = i->next)
+    {
+        if (i == handle)  /* handle is in this list? */
+        {
+            PHYSFS_Io *io = handle->io;
+            PHYSFS_uint8 *tmp = handle->buffer;
+
+            if (handle->writeBehind != NULL)
+            {
+                /* the flusher thread unlinks and frees it when it's done. */
+                __PHYSFS_writeBehindClose(handle->writeBehind,
+                                          finishWriteBehindClose, handle);
+                return 1;
+            } /* if */
+
+            rc = PHYSFS_flush((PHYSFS_File *) handle);
+            if (!rc)
+                return -1;
+
+            /* the new file has to be on disk before it replaces the old. */
+            if ((handle->atomicName != NULL) && (io->flush) && (!io->flush(io)))
+                return -1;
+
+            stopPrefetch(handle);
+            io->destroy(io);
+
+            if (tmp != NULL)  /* free any associated buffer. */
+                allocator.Free(tmp);
+
+            if (handle->prefetch != NULL)
+                allocator.Free(handle->prefetch);
+
+            if (prev == NULL)
+                *list = handle->next;
+            else
+                prev->next = handle->next;
+
+            if (handle->atomicName != NULL)
+                return 2;
+
+            __PHYSFS_poolFree(&fileHandlePool, handle);
+            return 1;
+        } /* if */
+        prev = i;
+    } /* for */
+
+    return 0;
+} /* closeHandleInOpenList */
+
+
+/* PHYSFS_close() for PHYSFS_openWriteAtomic() without write-behind. */
+static int closeAtomicWrite(FileHandle *handle)
+{
+    int rc;
+
+    /* hold this throughout, so the write dir can't change under us. */
+    __PHYSFS_platformGrabRWLockShared(stateLock);
+
+    __PHYSFS_platformGrabMutex(fileListLock);
+    rc = closeHandleInOpenList(&openWriteList, handle);
+    __PHYSFS_platformReleaseMutex(fileListLock);
+
+    if (rc == 2)  /* closed, so it's gone whether or not this works. */
+    {
+        rc = commitAtomicWrite(handle, 1);
+        allocator.Free(handle->atomicName);
+        __PHYSFS_poolFree(&fileHandlePool, handle);
+    } /* if */
+    else
+    {
+        if (rc == 0)
+            PHYSFS_setErrorCode(PHYSFS_ERR_INVALID_ARGUMENT);
+        rc = 0;
+    } /* else */
+
+    __PHYSFS_platformReleaseRWLock(stateLock);
+    return rc;
+} /* closeAtomicWrite */
+
+
+int PHYSFS_close(PHYSFS_File *_handle)
+{
+    FileHandle *handle = (FileHandle *) _handle;
+    const PHYSFS_uint64 start = __PHYSFS_TRACE_START();
+    const int tracing = __PHYSFS_TRACING();
+    PHYSFS_TraceEvent event;
+    int rc;
+
+    if (tracing)  /* get this while (handle) is still alive. */
+    {
+        memset(&event, '\0', sizeof (event));
+        event.type = PHYSFS_TRACE_CLOSE;
+        event.file = _handle;
+        event.archive = handle->dirHandle->dirName;
+    } /* if */
+
+    if ((handle->atomicName != NULL) && (handle->writeBehind == NULL))
+    {
+        BAIL_IF_ERRPASS(!closeAtomicWrite(handle), 0);
+    } /* if */
+
+    else
+    {
+        __PHYSFS_platformGrabMutex(fileListLock);
+
+        /* -1 == close failure. 0 == not found. 1 == success. */
+        rc = closeHandleInOpenList(&openReadList, handle);
+        BAIL_IF_MUTEX_ERRPASS(rc == -1, fileListLock, 0);
+        if (!rc)
+        {
+            rc = closeHandleInOpenList(&openWriteList, handle);
+            BAIL_IF_MUTEX_ERRPASS(rc == -1, fileListLock, 0);
+        } /* if */
+
+        __PHYSFS_platformReleaseMutex(fileListLock);
+        BAIL_IF(!rc, PHYSFS_ERR_INVALID_ARGUMENT, 0);
+    } /* else */
+
+    if (tracing)
+    {
+        event.result = 1;
+        __PHYSFS_trace(&event, start);
+    } /* if */
+
+    return 1;
+} /* PHYSFS_close */
+
+
+/*
+ * A borrowed file is just an open read handle nobody gets to see; that way
+ *  the buffer's refcount and the "can't unmount with open files" rule keep
+ *  the memory alive for us.
+ */
+int PHYSFS_mapFile(const char *fname, const void **ptr, PHYSFS_uint64 *len)
+{
+    FileHandle *fh;
+    const void *buf = NULL;
+    PHYSFS_sint64 filelen;
+
+    BAIL_IF(!ptr, PHYSFS_ERR_INVALID_ARGUMENT, 0);
+    BAIL_IF(!len, PHYSFS_ERR_INVALID_ARGUMENT, 0);
+    *ptr = NULL;
+    *len = 0;
+
+    fh = (FileHandle *) PHYSFS_openRead(fname);
+    BAIL_IF_ERRPASS(!fh, 0);
+
+    filelen = fh->io->length(fh->io);
+    if (filelen >= 0)
+        buf = __PHYSFS_ioMappedRange(fh->io, 0, (PHYSFS_uint64) filelen);
+
+    if (buf == NULL)
+    {
+        PHYSFS_close((PHYSFS_File *) fh);
+        BAIL(PHYSFS_ERR_UNSUPPORTED, 0);
+    } /* if */
+
+    __PHYSFS_platformGrabMutex(fileListLock);
+    fh->mapped = buf;
+    __PHYSFS_platformReleaseMutex(fileListLock);
+
+    *ptr = buf;
+    *len = (PHYSFS_uint64) filelen;
+    return 1;
+} /* PHYSFS_mapFile */
+
+
+int PHYSFS_unmapFile(const void *ptr)
+{
+    FileHandle *i;
+    int rc = 0;
+
+    BAIL_IF(!ptr, PHYSFS_ERR_INVALID_ARGUMENT, 0);
+
+    __PHYSFS_platformGrabMutex(fileListLock);
+    for (i = openReadList; i != NULL; i = i->next)
+    {
+        if (i->mapped == ptr)
+        {
+            rc = closeHandleInOpenList(&openReadList, i);
+            break;
+        } /* if */
+    } /* for */
+    __PHYSFS_platformReleaseMutex(fileListLock);
 
-        __PHYSFS_platformGrabMutex(stateLock);
+    BAIL_IF(!rc, PHYSFS_ERR_INVALID_ARGUMENT, 0);
+    return (rc == 1);
+} /* PHYSFS_unmapFile */
 
-        GOTO_IF(!writeDir, PHYSFS_ERR_NO_WRITE_DIR, doOpenWriteEnd);
 
-        h = writeDir;
-        GOTO_IF_ERRPASS(!verifyPath(h, &fname, 0), doOpenWriteEnd);
+void PHYSFS_setSeekCheckpointInterval(PHYSFS_uint64 interval)
+{
+    seekCheckpointInterval = interval;
+} /* PHYSFS_setSeekCheckpointInterval */
 
-        f = h->funcs;
-        if (appending)
-            io = f->openAppend(h->opaque, fname);
-        else
-            io = f->openWrite(h->opaque, fname);
 
-        GOTO_IF_ERRPASS(!io, doOpenWriteEnd);
+PHYSFS_uint64 PHYSFS_getSeekCheckpointInterval(void)
+{
+    return seekCheckpointInterval;
+} /* PHYSFS_getSeekCheckpointInterval */
 
-        fh = (FileHandle *) allocator.Malloc(sizeof (FileHandle));
-        if (fh == NULL)
+
+void PHYSFS_setVerifyChecksums(int enable)
+{
+    verifyChecksums = enable ? 1 : 0;
+} /* PHYSFS_setVerifyChecksums */
+
+
+int PHYSFS_getVerifyChecksums(void)
+{
+    return verifyChecksums;
+} /* PHYSFS_getVerifyChecksums */
+
+
+int PHYSFS_saveSeekCheckpoints(PHYSFS_File *handle, PHYSFS_File *out)
+{
+    FileHandle *fh = (FileHandle *) handle;
+    BAIL_IF(!fh, PHYSFS_ERR_INVALID_ARGUMENT, 0);
+    BAIL_IF(!out, PHYSFS_ERR_INVALID_ARGUMENT, 0);
+    BAIL_IF(!fh->forReading, PHYSFS_ERR_OPEN_FOR_WRITING, 0);
+    #if PHYSFS_SUPPORTS_ZIP
+    return __PHYSFS_zipSaveCheckpoints(fh->io, out);
+    #else
+    BAIL(PHYSFS_ERR_UNSUPPORTED, 0);
+    #endif
+} /* PHYSFS_saveSeekCheckpoints */
+
+
+int PHYSFS_loadSeekCheckpoints(PHYSFS_File *handle, PHYSFS_File *in)
+{
+    FileHandle *fh = (FileHandle *) handle;
+    BAIL_IF(!fh, PHYSFS_ERR_INVALID_ARGUMENT, 0);
+    BAIL_IF(!in, PHYSFS_ERR_INVALID_ARGUMENT, 0);
+    BAIL_IF(!fh->forReading, PHYSFS_ERR_OPEN_FOR_WRITING, 0);
+    #if PHYSFS_SUPPORTS_ZIP
+    return __PHYSFS_zipLoadCheckpoints(fh->io, in);
+    #else
+    BAIL(PHYSFS_ERR_UNSUPPORTED, 0);
+    #endif
+} /* PHYSFS_loadSeekCheckpoints */
+
+
+void __PHYSFS_fileArchiveOffset(PHYSFS_File *handle, const void **archive,
+                                PHYSFS_uint64 *offset)
+{
+    FileHandle *fh = (FileHandle *) handle;
+    *archive = fh->dirHandle;
+    *offset = 0;
+    #if PHYSFS_SUPPORTS_ZIP
+    __PHYSFS_zipEntryOffset(fh->io, offset);
+    #endif
+} /* __PHYSFS_fileArchiveOffset */
+
+
+int __PHYSFS_fileForReading(const PHYSFS_File *handle)
+{
+    return ((const FileHandle *) handle)->forReading;
+} /* __PHYSFS_fileForReading */
+
+
+/*
+ * Requests are handled this many at a time, so we never hold more open
+ *  handles (and their file descriptors) or compressed data than this.
+ */
+#define BATCH_CHUNK_SIZE 256
+
+typedef struct
+{
+    PHYSFS_ReadRequest *req;
+    const void *archive;  /* archive it came from last time we looked. */
+    PHYSFS_uint64 offset;  /* where it lives in that archive. */
+    PHYSFS_uint32 index;  /* position in the caller's array. */
+    FileHandle *fh;
+    int needsRead;  /* non-zero if a worker should read it. */
+    int nativeRead;  /* non-zero if it's in the platform's read batch. */
+} BatchItem;
+
+typedef struct
+{
+    BatchItem *items;
+    int count;
+    int next;  /* next item to claim, atomically. */
+} BatchQueue;
+
+
+static int batchItemCmp(void *_a, size_t one, size_t two)
+{
+    const BatchItem *a = ((const BatchItem *) _a) + one;
+    const BatchItem *b = ((const BatchItem *) _a) + two;
+
+    if (a->archive != b->archive)
+        return (a->archive < b->archive) ? -1 : 1;
+    else if (a->offset != b->offset)
+        return (a->offset < b->offset) ? -1 : 1;
+    else if (a->index != b->index)
+        return (a->index < b->index) ? -1 : 1;
+    return 0;
+} /* batchItemCmp */
+
+
+static void batchItemSwap(void *_a, size_t one, size_t two)
+{
+    BatchItem *items = (BatchItem *) _a;
+    BatchItem tmp;
+    memcpy(&tmp, &items[one], sizeof (BatchItem));
+    memcpy(&items[one], &items[two], sizeof (BatchItem));
+    memcpy(&items[two], &tmp, sizeof (BatchItem));
+} /* batchItemSwap */
+
+
+static void batchFail(BatchItem *item)
+{
+    item->req->result = -1;
+    item->req->error = PHYSFS_getLastErrorCode();
+    if (item->req->error == PHYSFS_ERR_OK)
+        item->req->error = PHYSFS_ERR_OTHER_ERROR;
+} /* batchFail */
+
+
+static void batchRead(BatchItem *item)
+{
+    PHYSFS_ReadRequest *req = item->req;
+    PHYSFS_Io *io = item->fh->io;
+    PHYSFS_uint8 *ptr = (PHYSFS_uint8 *) req->buffer;
+    PHYSFS_uint64 remaining = req->len;
+
+    req->result = 0;
+    while (remaining > 0)
+    {
+        const PHYSFS_sint64 rc = io->read(io, ptr, remaining);
+        if (rc < 0)
         {
-            io->destroy(io);
-            GOTO(PHYSFS_ERR_OUT_OF_MEMORY, doOpenWriteEnd);
+            batchFail(item);
+            return;
+        } /* if */
+        else if (rc == 0)
+        {
+            break;  /* EOF. */
+        } /* else if */
+
+        ptr += rc;
+        remaining -= (PHYSFS_uint64) rc;
+        req->result += rc;
+    } /* while */
+} /* batchRead */
+
+
+static void batchWorker(void *_queue)
+{
+    BatchQueue *queue = (BatchQueue *) _queue;
+    while (1)
+    {
+        const int i = __PHYSFS_ATOMIC_INCR(&queue->next) - 1;
+        if (i >= queue->count)
+            break;
+        else if (queue->items[i].needsRead)
+            batchRead(&queue->items[i]);
+    } /* while */
+} /* batchWorker */
+
+
+/* hand the collected loose-file reads to the platform all at once. */
+static void batchReadNative(BatchItem *items, const PHYSFS_uint32 count,
+                            __PHYSFS_PlatformRead *reads,
+                            const PHYSFS_uint32 numreads)
+{
+    PHYSFS_uint32 i;
+    PHYSFS_uint32 j = 0;
+
+    __PHYSFS_platformReadAtBatch(reads, numreads);
+
+    /* (reads) were queued in item order, so just walk them back out. */
+    for (i = 0; i < count; i++)
+    {
+        if (items[i].nativeRead)
+        {
+            PHYSFS_ReadRequest *req = items[i].req;
+            assert(j < numreads);
+            req->result = reads[j].result;
+            req->error = reads[j].error;
+            items[i].nativeRead = 0;
+            j++;
+        } /* if */
+    } /* for */
+} /* batchReadNative */
+
+
+/* the sweep: open everything in archive order, and do all the i/o now. */
+static int batchOpenAndLoad(BatchItem *items, const PHYSFS_uint32 count,
+                            __PHYSFS_PlatformRead *reads)
+{
+    PHYSFS_uint32 numreads = 0;
+    int pending = 0;
+    PHYSFS_uint32 i;
+
+    for (i = 0; i < count; i++)
+    {
+        BatchItem *item = &items[i];
+        int rc = -1;
+
+        item->fh = (FileHandle *) PHYSFS_openRead(item->req->filename);
+        if (item->fh == NULL)
+        {
+            batchFail(item);
+            continue;
+        } /* if */
+
+        #if PHYSFS_SUPPORTS_ZIP
+        rc = __PHYSFS_zipPreload(item->fh->io);
+        #endif
+
+        if (rc < 0)  /* not something we can split up; just read it now. */
+        {
+            /* loose files go to the platform together, at queue depth. */
+            void *handle = reads ? nativeIoReadHandle(item->fh->io) : NULL;
+            if (handle == NULL)
+                batchRead(item);
+            else
+            {
+                __PHYSFS_PlatformRead *r = &reads[numreads++];
+                r->opaque = handle;
+                r->pos = 0;  /* we just opened it. */
+                r->buffer = item->req->buffer;
+                r->len = item->req->len;
+                item->nativeRead = 1;
+            } /* else */
         } /* if */
+        else if (rc == 0)
+            batchFail(item);
         else
         {
-            memset(fh, '\0', sizeof (FileHandle));
-            fh->io = io;
-            fh->dirHandle = h;
-            fh->next = openWriteList;
-            openWriteList = fh;
+            item->needsRead = 1;
+            pending++;
         } /* else */
+    } /* for */
 
-        doOpenWriteEnd:
-        __PHYSFS_platformReleaseMutex(stateLock);
+    if (numreads > 0)
+        batchReadNative(items, count, reads, numreads);
+
+    return pending;
+} /* batchOpenAndLoad */
+
+
+static void batchDecompress(BatchItem *items, const PHYSFS_uint32 count,
+                            int pending, const PHYSFS_uint32 threads)
+{
+    void *workers[32];
+    BatchQueue queue;
+    int numWorkers = 0;
+    int i;
+
+    queue.items = items;
+    queue.count = (int) count;
+    queue.next = 0;
+
+    /* the calling thread is one of the (threads), so spawn one less. */
+    while ( (numWorkers < (int) (sizeof (workers) / sizeof (workers[0]))) &&
+            ((PHYSFS_uint32) (numWorkers + 1) < threads) &&
+            (numWorkers + 1 < pending) )
+    {
+        workers[numWorkers] = __PHYSFS_platformCreateThread(batchWorker,
+                                                            &queue);
+        if (workers[numWorkers] == NULL)
+            break;  /* fine, we'll just do more of it ourselves. */
+        numWorkers++;
+    } /* while */
+
+    batchWorker(&queue);
+
+    for (i = 0; i < numWorkers; i++)
+        __PHYSFS_platformJoinThread(workers[i]);
+} /* batchDecompress */
+
+
+/* if (owners) isn't NULL, it gets the DirHandle each request was read from. */
+static int readFilesBatch(PHYSFS_ReadRequest *reqs, const PHYSFS_uint32 count,
+                          const PHYSFS_uint32 threads,
+                          const DirHandle **owners)
+{
+    PHYSFS_ErrorCode firsterr = PHYSFS_ERR_OK;
+    __PHYSFS_PlatformRead *reads;
+    BatchItem *items;
+    PHYSFS_uint32 i;
+
+    if (count == 0)
+        return 1;
+
+    items = (BatchItem *) allocator.Malloc(sizeof (BatchItem) * count);
+    BAIL_IF(!items, PHYSFS_ERR_OUT_OF_MEMORY, 0);
+    memset(items, '\0', sizeof (BatchItem) * count);
+
+    /* no big deal if this fails; loose files just get read one by one. */
+    reads = (__PHYSFS_PlatformRead *) allocator.Malloc(
+                sizeof (__PHYSFS_PlatformRead) *
+                ((count < BATCH_CHUNK_SIZE) ? count : BATCH_CHUNK_SIZE));
+
+    /* find out where everything lives, so we can sweep each archive once. */
+    for (i = 0; i < count; i++)
+    {
+        BatchItem *item = &items[i];
+        PHYSFS_File *fh;
+
+        item->req = &reqs[i];
+        item->index = i;
+        item->req->result = -1;
+        item->req->error = PHYSFS_ERR_OK;
+
+        fh = PHYSFS_openRead(item->req->filename);
+        if (fh != NULL)
+        {
+            __PHYSFS_fileArchiveOffset(fh, &item->archive, &item->offset);
+            PHYSFS_close(fh);
+        } /* if */
+    } /* for */
+
+    __PHYSFS_sort(items, count, batchItemCmp, batchItemSwap);
+
+    for (i = 0; i < count; i += BATCH_CHUNK_SIZE)
+    {
+        BatchItem *chunk = &items[i];
+        const PHYSFS_uint32 total = count - i;
+        const PHYSFS_uint32 num = (total < BATCH_CHUNK_SIZE) ?
+                                    total : BATCH_CHUNK_SIZE;
+        const int pending = batchOpenAndLoad(chunk, num, reads);
+        PHYSFS_uint32 j;
+
+        if (pending > 0)
+            batchDecompress(chunk, num, pending, threads);
+
+        for (j = 0; j < num; j++)
+        {
+            FileHandle *fh = chunk[j].fh;
+            if (owners != NULL)
+                owners[chunk[j].index] = fh ? fh->dirHandle : NULL;
+            if (fh != NULL)
+                PHYSFS_close((PHYSFS_File *) fh);
+        } /* for */
+    } /* for */
+
+    /* report the first failure in the caller's order, not ours. */
+    for (i = 0; i < count; i++)
+    {
+        if (reqs[i].result < 0)
+        {
+            firsterr = reqs[i].error;
+            break;
+        } /* if */
+    } /* for */
+
+    if (reads != NULL)
+        allocator.Free(reads);
+    allocator.Free(items);
+
+    BAIL_IF(firsterr != PHYSFS_ERR_OK, firsterr, 0);
+    return 1;
+} /* readFilesBatch */
+
+
+int PHYSFS_readFilesBatch(PHYSFS_ReadRequest *reqs, PHYSFS_uint32 count,
+                          PHYSFS_uint32 threads)
+{
+    BAIL_IF(!initialized, PHYSFS_ERR_NOT_INITIALIZED, 0);
+    BAIL_IF((!reqs) && (count > 0), PHYSFS_ERR_INVALID_ARGUMENT, 0);
+    BAIL_IF(count > 0x7FFFFFFF, PHYSFS_ERR_INVALID_ARGUMENT, 0);
+    return readFilesBatch(reqs, count, threads, NULL);
+} /* PHYSFS_readFilesBatch */
+
+
+/*
+ * PHYSFS_preload() finds what to read by enumerating the whole subtree into
+ *  a DirTree. Enumeration reports the mount PHYSFS_openRead() would use
+ *  first, so the first time we see a path is the one that counts.
+ */
+#define PRELOAD_THREADS 4
+
+typedef struct
+{
+    __PHYSFS_DirTreeEntry tree;
+    PHYSFS_uint64 size;
+    int isfile;  /* zero for dirs, symlinks, and parents we never saw. */
+} PreloadEntry;
+
+typedef struct
+{
+    __PHYSFS_DirTree tree;
+    PHYSFS_ErrorCode errcode;
+} PreloadWalk;
+
+
+static int preloadAddEntry(PreloadWalk *walk, char *path,
+                           const PHYSFS_Stat *stat)
+{
+    PreloadEntry *entry;
+
+    if (__PHYSFS_DirTreeFind(&walk->tree, path) != NULL)
+        return 1;  /* a mount ahead of this one already has it. */
+
+    entry = (PreloadEntry *) __PHYSFS_DirTreeAdd(&walk->tree, path,
+                            stat->filetype == PHYSFS_FILETYPE_DIRECTORY);
+    BAIL_IF_ERRPASS(!entry, 0);
+    entry->isfile = (stat->filetype == PHYSFS_FILETYPE_REGULAR);
+    entry->size = (PHYSFS_uint64) stat->filesize;
+    return 1;
+} /* preloadAddEntry */
+
+
+static PHYSFS_EnumerateCallbackResult preloadEnumCallback(void *data,
+                                                    const char *origdir,
+                                                    const char *fname,
+                                                    const PHYSFS_Stat *stat)
+{
+    PreloadWalk *walk = (PreloadWalk *) data;
+    const size_t len = strlen(origdir) + strlen(fname) + 2;
+    char *path = (char *) __PHYSFS_smallAlloc(len);
+    int rc;
+
+    if (path == NULL)
+    {
+        walk->errcode = PHYSFS_ERR_OUT_OF_MEMORY;
+        return PHYSFS_ENUM_ERROR;
     } /* if */
 
-    __PHYSFS_smallFree(fname);
-    return ((PHYSFS_File *) fh);
-} /* doOpenWrite */
+    strcpy(path, origdir);
+    if (*path != '\0')
+        strcat(path, "/");
+    strcat(path, fname);
+
+    rc = preloadAddEntry(walk, path, stat);
+    __PHYSFS_smallFree(path);
+    if (!rc)
+    {
+        walk->errcode = currentErrorCode();
+        return PHYSFS_ENUM_ERROR;
+    } /* if */
+
+    return PHYSFS_ENUM_OK;
+} /* preloadEnumCallback */
+
+
+static int preloadWalkDir(PreloadWalk *walk, const char *dir)
+{
+    __PHYSFS_DirTreeEntry *entry;
+    __PHYSFS_DirTreeEntry *i;
+
+    if (!PHYSFS_enumerateWithStat(dir, preloadEnumCallback, walk))
+    {
+        if (walk->errcode != PHYSFS_ERR_OK)
+            PHYSFS_setErrorCode(walk->errcode);
+        return 0;
+    } /* if */
+
+    entry = (__PHYSFS_DirTreeEntry *) __PHYSFS_DirTreeFind(&walk->tree, dir);
+    BAIL_IF_ERRPASS(!entry, 0);
+    for (i = entry->children; i != NULL; i = i->sibling)
+    {
+        if ((i->isdir) && (!preloadWalkDir(walk, i->name)))
+            return 0;
+    } /* for */
+
+    return 1;
+} /* preloadWalkDir */
+
+
+/* MAKE SURE you hold the stateLock when calling this! */
+static int doPreload(const char *fname, const int pin)
+{
+    PHYSFS_ErrorCode firsterr = PHYSFS_ERR_OK;
+    PHYSFS_ReadRequest *reqs = NULL;
+    const DirHandle **owners = NULL;
+    PHYSFS_uint64 total = 0;
+    PHYSFS_uint32 count = 0;
+    PHYSFS_uint32 i;
+    PreloadWalk walk;
+    PHYSFS_Stat statbuf;
+    size_t bucket;
+    int retval = 0;
+
+    BAIL_IF_ERRPASS(!PHYSFS_stat(fname, &statbuf), 0);
+    BAIL_IF(statbuf.filetype == PHYSFS_FILETYPE_SYMLINK,
+            PHYSFS_ERR_NOT_A_FILE, 0);
+
+    memset(&walk, '\0', sizeof (walk));
+    BAIL_IF_ERRPASS(!__PHYSFS_DirTreeInit(&walk.tree, sizeof (PreloadEntry),
+                                          0), 0);
+
+    if (statbuf.filetype == PHYSFS_FILETYPE_DIRECTORY)
+        GOTO_IF_ERRPASS(!preloadWalkDir(&walk, fname), preload_end);
+    else
+    {
+        char *path = (char *) __PHYSFS_smallAlloc(strlen(fname) + 1);
+        int rc;
+        GOTO_IF(!path, PHYSFS_ERR_OUT_OF_MEMORY, preload_end);
+        strcpy(path, fname);  /* DirTreeAdd wants a (char *). */
+        rc = preloadAddEntry(&walk, path, &statbuf);
+        __PHYSFS_smallFree(path);
+        GOTO_IF_ERRPASS(!rc, preload_end);
+    } /* else */
+
+    /* every entry is a file, a dir, or the parent of one of those. */
+    reqs = (PHYSFS_ReadRequest *) allocator.Malloc(sizeof (*reqs) *
+                                                    walk.tree.entryCount);
+    GOTO_IF(!reqs, PHYSFS_ERR_OUT_OF_MEMORY, preload_end);
+
+    for (bucket = 0; bucket < walk.tree.hashBuckets; bucket++)
+    {
+        __PHYSFS_DirTreeEntry *j;
+        for (j = walk.tree.hash[bucket]; j != NULL; j = j->hashnext)
+        {
+            const PreloadEntry *entry = (const PreloadEntry *) j;
+            if ((!entry->isfile) || (__PHYSFS_preloadHas(j->name, pin)))
+                continue;
+            assert(count < walk.tree.entryCount);
+            memset(&reqs[count], '\0', sizeof (*reqs));
+            reqs[count].filename = j->name;
+            reqs[count].len = entry->size;
+            total += entry->size;
+            count++;
+        } /* for */
+    } /* for */
+
+    if (count == 0)
+    {
+        retval = 1;  /* nothing to do. */
+        goto preload_end;
+    } /* if */
+
+    GOTO_IF((!pin) && (total > PHYSFS_getPreloadBudget()),
+            PHYSFS_ERR_OUT_OF_MEMORY, preload_end);
+
+    owners = (const DirHandle **) allocator.Malloc(sizeof (*owners) * count);
+    GOTO_IF(!owners, PHYSFS_ERR_OUT_OF_MEMORY, preload_end);
+
+    for (i = 0; i < count; i++)
+    {
+        /* allocate at least a byte, so empty files aren't a failure. */
+        const PHYSFS_uint64 len = reqs[i].len;
+        GOTO_IF(!__PHYSFS_ui64FitsAddressSpace(len),
+                PHYSFS_ERR_OUT_OF_MEMORY, preload_end);
+        reqs[i].buffer = allocator.Malloc(len ? (size_t) len : 1);
+        GOTO_IF(!reqs[i].buffer, PHYSFS_ERR_OUT_OF_MEMORY, preload_end);
+    } /* for */
+
+    readFilesBatch(reqs, count, PRELOAD_THREADS, owners);
+
+    for (i = 0; i < count; i++)
+    {
+        PHYSFS_ReadRequest *req = &reqs[i];
+        void *buf = req->buffer;
+        req->buffer = NULL;  /* it's either preloaded or freed now. */
+
+        if ((req->result < 0) || ((PHYSFS_uint64) req->result != req->len) ||
+            (owners[i] == NULL))
+        {
+            allocator.Free(buf);
+            if (firsterr == PHYSFS_ERR_OK)
+                firsterr = (req->result < 0) ? req->error : PHYSFS_ERR_IO;
+        } /* if */
+        else if (!__PHYSFS_preloadPut(req->filename, owners[i], buf,
+                                      req->len, pin))
+        {
+            if (firsterr == PHYSFS_ERR_OK)
+                firsterr = currentErrorCode();
+        } /* else if */
+    } /* for */
+
+    if (firsterr != PHYSFS_ERR_OK)
+        PHYSFS_setErrorCode(firsterr);
+    else
+        retval = 1;
+
+preload_end:
+    if (reqs != NULL)
+    {
+        for (i = 0; i < count; i++)
+        {
+            if (reqs[i].buffer != NULL)
+                allocator.Free(reqs[i].buffer);
+        } /* for */
+        allocator.Free(reqs);
+    } /* if */
+
+    if (owners != NULL)
+        allocator.Free((void *) owners);
+
+    __PHYSFS_DirTreeDeinit(&walk.tree);
+    return retval;
+} /* doPreload */
 
 
-PHYSFS_File *PHYSFS_openWrite(const char *filename)
+int PHYSFS_preload(const char *_fname, PHYSFS_uint32 flags)
 {
-    return doOpenWrite(filename, 0);
-} /* PHYSFS_openWrite */
+    const int pin = ((flags & PHYSFS_PRELOAD_PIN) != 0);
+    int retval = 0;
+    size_t len;
+    char *fname;
 
+    BAIL_IF(!initialized, PHYSFS_ERR_NOT_INITIALIZED, 0);
+    BAIL_IF(!_fname, PHYSFS_ERR_INVALID_ARGUMENT, 0);
+    BAIL_IF(flags & ~PHYSFS_PRELOAD_PIN, PHYSFS_ERR_INVALID_ARGUMENT, 0);
 
-PHYSFS_File *PHYSFS_openAppend(const char *filename)
-{
-    return doOpenWrite(filename, 1);
-} /* PHYSFS_openAppend */
+    len = strlen(_fname) + 1;
+    fname = (char *) __PHYSFS_smallAlloc(len);
+    BAIL_IF(!fname, PHYSFS_ERR_OUT_OF_MEMORY, 0);
+
+    if (sanitizePlatformIndependentPath(_fname, fname))
+    {
+        /* shared is enough: nothing can mount or unmount until we're done. */
+        __PHYSFS_platformGrabRWLockShared(stateLock);
+        retval = doPreload(fname, pin);
+        __PHYSFS_platformReleaseRWLock(stateLock);
+    } /* if */
 
+    __PHYSFS_smallFree(fname);
+    return retval;
+} /* PHYSFS_preload */
 
-PHYSFS_File *PHYSFS_openRead(const char *_fname)
+
+int PHYSFS_unpreload(const char *_fname)
 {
-    FileHandle *fh = NULL;
-    char *fname;
     size_t len;
+    char *fname;
 
     BAIL_IF(!_fname, PHYSFS_ERR_INVALID_ARGUMENT, 0);
+
     len = strlen(_fname) + 1;
     fname = (char *) __PHYSFS_smallAlloc(len);
     BAIL_IF(!fname, PHYSFS_ERR_OUT_OF_MEMORY, 0);
 
-    if (sanitizePlatformIndependentPath(_fname, fname))
+    if (!sanitizePlatformIndependentPath(_fname, fname))
     {
-        DirHandle *i = NULL;
-        PHYSFS_Io *io = NULL;
-
-        __PHYSFS_platformGrabMutex(stateLock);
+        __PHYSFS_smallFree(fname);
+        return 0;
+    } /* if */
 
-        GOTO_IF(!searchPath, PHYSFS_ERR_NOT_FOUND, openReadEnd);
+    __PHYSFS_platformGrabRWLockShared(stateLock);
+    __PHYSFS_preloadForget(fname, 0);
+    __PHYSFS_platformReleaseRWLock(stateLock);
 
-        for (i = searchPath; i != NULL; i = i->next)
-        {
-            char *arcfname = fname;
-            if (verifyPath(i, &arcfname, 0))
-            {
-                io = i->funcs->openRead(i->opaque, arcfname);
-                if (io)
-                    break;
-            } /* if */
-        } /* for */
+    __PHYSFS_smallFree(fname);
+    return 1;
+} /* PHYSFS_unpreload */
 
-        GOTO_IF_ERRPASS(!io, openReadEnd);
 
-        fh = (FileHandle *) allocator.Malloc(sizeof (FileHandle));
-        if (fh == NULL)
-        {
-            io->destroy(io);
-            GOTO(PHYSFS_ERR_OUT_OF_MEMORY, openReadEnd);
-        } /* if */
+/*
+ * Automatic read-ahead: once a handle without a buffer has done
+ *  READAHEAD_STREAK small reads without seeking, it gets a buffer of its own
+ *  READAHEAD_WINDOW bytes big. Every time that's used up, the window doubles
+ *  (up to PHYSFS_setReadAhead()'s limit), and if the Io can readAt(), the
+ *  next window is read on an async worker while the app eats this one.
+ *  Seeking outside the buffer means this isn't sequential after all, so
+ *  the buffer goes away until the next streak.
+ *
+ * While (readAhead) is set, (bufstart + buffill) is always the Io's own
+ *  position, so tell() needs no call into the Io, and we never call read()
+ *  or seek() on the Io with a prefetch in flight.
+ */
+#define READAHEAD_STREAK 3
+#define READAHEAD_WINDOW 8192
 
-        memset(fh, '\0', sizeof (FileHandle));
-        fh->io = io;
-        fh->forReading = 1;
-        fh->dirHandle = i;
-        fh->next = openReadList;
-        openReadList = fh;
+static int startReadAhead(FileHandle *fh)
+{
+    PHYSFS_Io *io = fh->io;
+    size_t window = READAHEAD_WINDOW;
+    PHYSFS_sint64 pos;
 
-        openReadEnd:
-        __PHYSFS_platformReleaseMutex(stateLock);
+    if (fh->streak < READAHEAD_STREAK)
+    {
+        fh->streak++;
+        return 0;
     } /* if */
 
-    __PHYSFS_smallFree(fname);
-    return ((PHYSFS_File *) fh);
-} /* PHYSFS_openRead */
+    if (__PHYSFS_ioMappedRange(io, 0, 0) != NULL)
+        return 0;  /* already in memory; buffering just adds a copy. */
 
+    pos = io->tell(io);
+    if (pos < 0)
+        return 0;
 
-static int closeHandleInOpenList(FileHandle **list, FileHandle *handle)
+    if (readAheadMax < window)
+        window = (size_t) readAheadMax;
+
+    fh->buffer = (PHYSFS_uint8 *) allocator.Malloc(window);
+    if (!fh->buffer)
+        return 0;  /* not an error, just unbuffered. */
+
+    fh->bufsize = window;
+    fh->buffill = fh->bufpos = 0;
+    fh->bufstart = (PHYSFS_uint64) pos;
+    fh->readAhead = 1;
+    return 1;
+} /* startReadAhead */
+
+
+static void stopReadAhead(FileHandle *fh)
 {
-    FileHandle *prev = NULL;
-    FileHandle *i;
-    int rc = 1;
+    stopPrefetch(fh);
 
-    for (i = *list; i != NULL; i = i->next)
+    if (fh->prefetch != NULL)
     {
-        if (i == handle)  /* handle is in this list? */
-        {
-            PHYSFS_Io *io = handle->io;
-            PHYSFS_uint8 *tmp = handle->buffer;
-            rc = PHYSFS_flush((PHYSFS_File *) handle);
-            if (!rc)
-                return -1;
-            io->destroy(io);
+        allocator.Free(fh->prefetch);
+        fh->prefetch = NULL;
+    } /* if */
 
-            if (tmp != NULL)  /* free any associated buffer. */
-                allocator.Free(tmp);
+    allocator.Free(fh->buffer);
+    fh->buffer = NULL;
+    fh->bufsize = fh->buffill = fh->bufpos = 0;
+    fh->readAhead = 0;
+    fh->streak = 0;
+} /* stopReadAhead */
 
-            if (prev == NULL)
-                *list = handle->next;
-            else
-                prev->next = handle->next;
 
-            allocator.Free(handle);
-            return 1;
-        } /* if */
-        prev = i;
-    } /* for */
+static void startPrefetch(FileHandle *fh, const PHYSFS_uint64 pos)
+{
+    PHYSFS_Io *io = fh->io;
+    PHYSFS_sint64 len;
 
-    return 0;
-} /* closeHandleInOpenList */
+    if (!__PHYSFS_ioCanReadAt(io))
+        return;
 
+    len = io->length(io);
+    if ((len < 0) || (pos >= (PHYSFS_uint64) len))
+        return;  /* nothing left to fetch. */
 
-int PHYSFS_close(PHYSFS_File *_handle)
+    if (fh->prefetch == NULL)
+    {
+        fh->prefetch = (PHYSFS_uint8 *) allocator.Malloc(fh->bufsize);
+        if (fh->prefetch == NULL)
+            return;
+    } /* if */
+
+    fh->prefetchReq = __PHYSFS_asyncReadIo(io, pos, fh->prefetch,
+                                           fh->bufsize);
+} /* startPrefetch */
+
+
+/* Fill (fh->buffer) with the next window; returns what io->read() would. */
+static PHYSFS_sint64 readAheadRefill(FileHandle *fh)
 {
-    FileHandle *handle = (FileHandle *) _handle;
-    int rc;
+    PHYSFS_Io *io = fh->io;
+    const PHYSFS_uint64 pos = fh->bufstart + fh->buffill;
+    PHYSFS_sint64 rc = -1;
+
+    fh->bufstart = pos;
+    fh->buffill = fh->bufpos = 0;
 
-    __PHYSFS_platformGrabMutex(stateLock);
+    if (fh->prefetchReq != NULL)
+    {
+        rc = __PHYSFS_asyncFinishIo(fh->prefetchReq, 0);
+        fh->prefetchReq = NULL;
+        if (rc == 0)
+            return 0;  /* EOF. */
+        else if ((rc > 0) && (io->seek(io, pos + rc)))
+        {
+            PHYSFS_uint8 *tmp = fh->buffer;
+            fh->buffer = fh->prefetch;
+            fh->prefetch = tmp;
+        } /* else if */
+        else
+        {
+            rc = -1;  /* read it here instead, so errors get reported. */
+        } /* else */
+    } /* if */
 
-    /* -1 == close failure. 0 == not found. 1 == success. */
-    rc = closeHandleInOpenList(&openReadList, handle);
-    BAIL_IF_MUTEX_ERRPASS(rc == -1, stateLock, 0);
-    if (!rc)
+    if (rc < 0)
     {
-        rc = closeHandleInOpenList(&openWriteList, handle);
-        BAIL_IF_MUTEX_ERRPASS(rc == -1, stateLock, 0);
+        rc = io->read(io, fh->buffer, fh->bufsize);
+        if (rc <= 0)
+            return rc;
     } /* if */
 
-    __PHYSFS_platformReleaseMutex(stateLock);
-    BAIL_IF(!rc, PHYSFS_ERR_INVALID_ARGUMENT, 0);
-    return 1;
-} /* PHYSFS_close */
+    /* the whole last window got used without a seek, so widen it. */
+    if (fh->bufsize < readAheadMax)
+    {
+        size_t newsize = fh->bufsize * 2;
+        void *ptr;
+        if (newsize > readAheadMax)
+            newsize = (size_t) readAheadMax;
+        ptr = allocator.Realloc(fh->buffer, newsize);
+        if (ptr != NULL)  /* if not, just keep the old size. */
+        {
+            fh->buffer = (PHYSFS_uint8 *) ptr;
+            fh->bufsize = newsize;
+            if (fh->prefetch != NULL)
+            {
+                allocator.Free(fh->prefetch);
+                fh->prefetch = NULL;
+            } /* if */
+        } /* if */
+    } /* if */
+
+    startPrefetch(fh, pos + rc);
+    return rc;
+} /* readAheadRefill */
 
 
 static PHYSFS_sint64 doBufferedRead(FileHandle *fh, void *_buffer, size_t len)
@@ -2734,10 +6349,32 @@ static PHYSFS_sint64 doBufferedRead(FileHandle *fh, void *_buffer, size_t len)
             retval += cpy;
         } /* if */
 
+        else if ((fh->readAhead) && (len >= fh->bufsize) &&
+                 (fh->prefetchReq == NULL))
+        {
+            /* a read this big gains nothing from going through us. */
+            PHYSFS_Io *io = fh->io;
+            const PHYSFS_sint64 rc = io->read(io, buffer, len);
+            if (rc <= 0)
+            {
+                if (retval == 0)  /* report already-read data, or failure. */
+                    retval = rc;
+                break;
+            } /* if */
+
+            fh->bufstart += fh->buffill + (PHYSFS_uint64) rc;
+            fh->buffill = fh->bufpos = 0;
+            buffer += rc;
+            len -= (size_t) rc;
+            retval += rc;
+        } /* else if */
+
         else   /* buffer is empty, refill it. */
         {
             PHYSFS_Io *io = fh->io;
-            const PHYSFS_sint64 rc = io->read(io, fh->buffer, fh->bufsize);
+            const PHYSFS_sint64 rc = fh->readAhead ? readAheadRefill(fh) :
+                                     io->read(io, fh->buffer, fh->bufsize);
+            __PHYSFS_STAT_INCR(bufferRefills);
             fh->bufpos = 0;
             if (rc > 0)
                 fh->buffill = (size_t) rc;
@@ -2764,11 +6401,24 @@ PHYSFS_sint64 PHYSFS_read(PHYSFS_File *handle, void *buffer,
 } /* PHYSFS_read */
 
 
+static PHYSFS_sint64 doRead(FileHandle *fh, void *buffer, const size_t len)
+{
+    if (fh->buffer)
+        return doBufferedRead(fh, buffer, len);
+    else if ((readAheadMax > 0) && (len < READAHEAD_WINDOW) &&
+             (startReadAhead(fh)))
+        return doBufferedRead(fh, buffer, len);
+
+    return fh->io->read(fh->io, buffer, len);
+} /* doRead */
+
+
 PHYSFS_sint64 PHYSFS_readBytes(PHYSFS_File *handle, void *buffer,
                                PHYSFS_uint64 _len)
 {
     const size_t len = (size_t) _len;
     FileHandle *fh = (FileHandle *) handle;
+    PHYSFS_sint64 retval;
 
 #ifdef PHYSFS_NO_64BIT_SUPPORT
     const PHYSFS_uint64 maxlen = __PHYSFS_UI64(0x7FFFFFFF);
@@ -2782,10 +6432,32 @@ PHYSFS_sint64 PHYSFS_readBytes(PHYSFS_File *handle, void *buffer,
     BAIL_IF(_len > maxlen, PHYSFS_ERR_INVALID_ARGUMENT, -1);
     BAIL_IF(!fh->forReading, PHYSFS_ERR_OPEN_FOR_WRITING, -1);
     BAIL_IF_ERRPASS(len == 0, 0);
-    if (fh->buffer)
-        return doBufferedRead(fh, buffer, len);
 
-    return fh->io->read(fh->io, buffer, len);
+    if (!__PHYSFS_TRACING())
+        retval = doRead(fh, buffer, len);
+    else
+    {
+        const PHYSFS_uint64 start = __PHYSFS_TRACE_START();
+        const PHYSFS_sint64 pos = PHYSFS_tell(handle);
+        PHYSFS_TraceEvent event;
+        retval = doRead(fh, buffer, len);
+        memset(&event, '\0', sizeof (event));
+        event.type = PHYSFS_TRACE_READ;
+        event.file = handle;
+        event.archive = fh->dirHandle->dirName;
+        event.offset = (pos < 0) ? 0 : (PHYSFS_uint64) pos;
+        event.result = retval;
+        __PHYSFS_trace(&event, start);
+    } /* else */
+
+    __PHYSFS_STAT_INCR(reads);
+    if (retval > 0)
+    {
+        __PHYSFS_STAT_ADD(bytesRead, retval);
+        ARCHIVE_STAT_ADD(fh->dirHandle, bytesRead, retval);
+    } /* if */
+
+    return retval;
 } /* PHYSFS_readBytes */
 
 
@@ -2835,6 +6507,8 @@ PHYSFS_sint64 PHYSFS_writeBytes(PHYSFS_File *handle, const void *buffer,
     BAIL_IF(_len > maxlen, PHYSFS_ERR_INVALID_ARGUMENT, -1);
     BAIL_IF(fh->forReading, PHYSFS_ERR_OPEN_FOR_READING, -1);
     BAIL_IF_ERRPASS(len == 0, 0);
+    if (fh->writeBehind)
+        return __PHYSFS_writeBehindWrite(fh->writeBehind, buffer, len);
     if (fh->buffer)
         return doBufferedWrite(handle, buffer, len);
 
@@ -2854,7 +6528,9 @@ int PHYSFS_eof(PHYSFS_File *handle)
     {
         /* check the Io. */
         PHYSFS_Io *io = fh->io;
-        const PHYSFS_sint64 pos = io->tell(io);
+        const PHYSFS_sint64 pos = fh->readAhead ?
+                        (PHYSFS_sint64) (fh->bufstart + fh->buffill) :
+                        io->tell(io);
         const PHYSFS_sint64 len = io->length(io);
         if ((pos < 0) || (len < 0))
             return 0;  /* beats me. */
@@ -2868,17 +6544,50 @@ int PHYSFS_eof(PHYSFS_File *handle)
 PHYSFS_sint64 PHYSFS_tell(PHYSFS_File *handle)
 {
     FileHandle *fh = (FileHandle *) handle;
-    const PHYSFS_sint64 pos = fh->io->tell(fh->io);
-    const PHYSFS_sint64 retval = fh->forReading ?
-                                 (pos - fh->buffill) + fh->bufpos :
-                                 (pos + fh->buffill);
-    return retval;
+    PHYSFS_sint64 pos;
+
+    if (fh->readAhead)  /* the Io might be busy with a prefetch. */
+        return (PHYSFS_sint64) (fh->bufstart + fh->bufpos);
+    else if (fh->writeBehind)  /* ...or with writing. */
+        return __PHYSFS_writeBehindTell(fh->writeBehind);
+
+    pos = fh->io->tell(fh->io);
+    return fh->forReading ? (pos - fh->buffill) + fh->bufpos :
+                            (pos + fh->buffill);
 } /* PHYSFS_tell */
 
 
+static int doSeek(PHYSFS_File *handle, const PHYSFS_uint64 pos);
+
 int PHYSFS_seek(PHYSFS_File *handle, PHYSFS_uint64 pos)
+{
+    const PHYSFS_uint64 start = __PHYSFS_TRACE_START();
+    const int retval = doSeek(handle, pos);
+
+    if (__PHYSFS_TRACING())
+    {
+        PHYSFS_TraceEvent event;
+        memset(&event, '\0', sizeof (event));
+        event.type = PHYSFS_TRACE_SEEK;
+        event.file = handle;
+        event.archive = ((FileHandle *) handle)->dirHandle->dirName;
+        event.offset = pos;
+        event.result = retval;
+        __PHYSFS_trace(&event, start);
+    } /* if */
+
+    return retval;
+} /* PHYSFS_seek */
+
+
+static int doSeek(PHYSFS_File *handle, const PHYSFS_uint64 pos)
 {
     FileHandle *fh = (FileHandle *) handle;
+
+    /* not PHYSFS_flush(); that would sync to disk on every seek. */
+    if (fh->writeBehind)
+        return __PHYSFS_writeBehindSeek(fh->writeBehind, pos);
+
     BAIL_IF_ERRPASS(!PHYSFS_flush(handle), 0);
 
     if (fh->buffer && fh->forReading)
@@ -2896,15 +6605,35 @@ int PHYSFS_seek(PHYSFS_File *handle, PHYSFS_uint64 pos)
         } /* if */
     } /* if */
 
-    /* we have to fall back to a 'raw' seek. */
+    /* we have to fall back to a 'raw' seek. This isn't sequential, then. */
+    if (fh->readAhead)
+        stopReadAhead(fh);
+    fh->streak = 0;
     fh->buffill = fh->bufpos = 0;
     return fh->io->seek(fh->io, pos);
-} /* PHYSFS_seek */
+} /* doSeek */
+
+
+void PHYSFS_setReadAhead(PHYSFS_uint64 maxWindow)
+{
+    if (!__PHYSFS_ui64FitsAddressSpace(maxWindow))
+        maxWindow = (PHYSFS_uint64) ((size_t) -1);
+    readAheadMax = maxWindow;
+} /* PHYSFS_setReadAhead */
+
+
+PHYSFS_uint64 PHYSFS_getReadAhead(void)
+{
+    return readAheadMax;
+} /* PHYSFS_getReadAhead */
 
 
 PHYSFS_sint64 PHYSFS_fileLength(PHYSFS_File *handle)
 {
-    PHYSFS_Io *io = ((FileHandle *) handle)->io;
+    FileHandle *fh = (FileHandle *) handle;
+    PHYSFS_Io *io = fh->io;
+    if (fh->writeBehind)
+        return __PHYSFS_writeBehindLength(fh->writeBehind);
     return io->length(io);
 } /* PHYSFS_filelength */
 
@@ -2917,8 +6646,28 @@ int PHYSFS_setBuffer(PHYSFS_File *handle, PHYSFS_uint64 _bufsize)
     if (!__PHYSFS_ui64FitsAddressSpace(_bufsize))
         BAIL(PHYSFS_ERR_INVALID_ARGUMENT, 0);
 
+    /* this handle's buffering is the app's business from now on. */
+    if (fh->writeBehind)
+    {
+        const int rc = __PHYSFS_writeBehindStop(fh->writeBehind);
+        fh->writeBehind = NULL;
+        BAIL_IF_ERRPASS(!rc, 0);
+    } /* if */
+
     BAIL_IF_ERRPASS(!PHYSFS_flush(handle), 0);
 
+    /* the app wants to manage this buffer itself from now on. */
+    if (fh->readAhead)
+    {
+        stopPrefetch(fh);
+        if (fh->prefetch != NULL)
+        {
+            allocator.Free(fh->prefetch);
+            fh->prefetch = NULL;
+        } /* if */
+        fh->readAhead = 0;
+    } /* if */
+
     /*
      * For reads, we need to move the file pointer to where it would be
      *  if we weren't buffering, so that the next read will get the
@@ -2962,6 +6711,14 @@ int PHYSFS_flush(PHYSFS_File *handle)
     PHYSFS_Io *io;
     PHYSFS_sint64 rc;
 
+    if ((!fh->forReading) && (fh->writeBehind))
+    {
+        /* wait for the flusher to catch up, then sync it like we would. */
+        BAIL_IF_ERRPASS(!__PHYSFS_writeBehindBarrier(fh->writeBehind), 0);
+        io = fh->io;
+        return io->flush ? io->flush(io) : 1;
+    } /* if */
+
     if ((fh->forReading) || (fh->bufpos == fh->buffill))
         return 1;  /* open for read or buffer empty are successful no-ops. */
 
@@ -3004,27 +6761,45 @@ int PHYSFS_stat(const char *_fname, PHYSFS_Stat *stat)
         } /* if */
         else
         {
+            const DirHandle *hint;
+            int useIndex;
+            int missgen;
             DirHandle *i;
             int exists = 0;
-            __PHYSFS_platformGrabMutex(stateLock);
-            for (i = searchPath; ((i != NULL) && (!exists)); i = i->next)
+            __PHYSFS_platformGrabRWLockShared(stateLock);
+            if (!missCacheFind(fname, &missgen))
             {
-                char *arcfname = fname;
-                exists = partOfMountPoint(i, arcfname);
-                if (exists)
-                {
-                    stat->filetype = PHYSFS_FILETYPE_DIRECTORY;
-                    stat->readonly = 1;
-                    retval = 1;
-                } /* if */
-                else if (verifyPath(i, &arcfname, 0))
+                useIndex = searchPathIndexLookup(fname, &hint);
+                for (i = searchPath; ((i != NULL) && (!exists)); i = i->next)
                 {
-                    retval = i->funcs->stat(i->opaque, arcfname, stat);
-                    if ((retval) || (currentErrorCode() != PHYSFS_ERR_NOT_FOUND))
-                        exists = 1;
-                } /* else if */
-            } /* for */
-            __PHYSFS_platformReleaseMutex(stateLock);
+                    char *arcfname = fname;
+                    if (skipViaSearchPathIndex(i, &useIndex, hint))
+                        continue;
+                    exists = partOfMountPoint(i, arcfname);
+                    if (exists)
+                    {
+                        stat->filetype = PHYSFS_FILETYPE_DIRECTORY;
+                        stat->readonly = 1;
+                        retval = 1;
+                    } /* if */
+                    else
+                    {
+                        lockArchiver(i);
+                        if (verifyPath(i, &arcfname, 0))
+                        {
+                            retval = i->funcs->stat(i->opaque, arcfname, stat);
+                            if ((retval) ||
+                                (currentErrorCode() != PHYSFS_ERR_NOT_FOUND))
+                                exists = 1;
+                        } /* if */
+                        unlockArchiver(i);
+                    } /* else */
+                } /* for */
+
+                if ((!exists) && (currentErrorCode() == PHYSFS_ERR_NOT_FOUND))
+                    missCacheAdd(fname, missgen);
+            } /* if */
+            __PHYSFS_platformReleaseRWLock(stateLock);
         } /* else */
     } /* if */
 
@@ -3033,43 +6808,137 @@ int PHYSFS_stat(const char *_fname, PHYSFS_Stat *stat)
 } /* PHYSFS_stat */
 
 
-int __PHYSFS_readAll(PHYSFS_Io *io, void *buf, const size_t _len)
-{
-    const PHYSFS_uint64 len = (PHYSFS_uint64) _len;
-    return (io->read(io, buf, len) == len);
-} /* __PHYSFS_readAll */
+int __PHYSFS_readAll(PHYSFS_Io *io, void *buf, const size_t _len)
+{
+    const PHYSFS_uint64 len = (PHYSFS_uint64) _len;
+    return (io->read(io, buf, len) == len);
+} /* __PHYSFS_readAll */
+
+
+void *__PHYSFS_initSmallAlloc(void *ptr, const size_t len)
+{
+    void *useHeap = ((ptr == NULL) ? ((void *) 1) : ((void *) 0));
+    if (useHeap)  /* too large for stack allocation or alloca() failed. */
+        ptr = allocator.Malloc(len+sizeof (void *));
+
+    if (ptr != NULL)
+    {
+        void **retval = (void **) ptr;
+        /*printf("%s alloc'd (%lld) bytes at (%p).\n",
+                useHeap ? "heap" : "stack", (long long) len, ptr);*/
+        *retval = useHeap;
+        return retval + 1;
+    } /* if */
+
+    return NULL;  /* allocation failed. */
+} /* __PHYSFS_initSmallAlloc */
+
+
+void __PHYSFS_smallFree(void *ptr)
+{
+    if (ptr != NULL)
+    {
+        void **block = ((void **) ptr) - 1;
+        const int useHeap = (*block != NULL);
+        if (useHeap)
+            allocator.Free(block);
+        /*printf("%s free'd (%p).\n", useHeap ? "heap" : "stack", block);*/
+    } /* if */
+} /* __PHYSFS_smallFree */
+
+
+#ifndef PHYSFS_POOL_MAX
+#define PHYSFS_POOL_MAX 32
+#endif
+
+__PHYSFS_POOL(__PHYSFS_ioPool, PHYSFS_Io);
+
+/* pools with something cached, so deinit knows what to empty. */
+static __PHYSFS_Pool *pools = NULL;
+
+void *__PHYSFS_poolAlloc(__PHYSFS_Pool *pool)
+{
+    void *retval = NULL;
+
+    assert(pool->objsize >= sizeof (void *));
+
+    if (poolLock != NULL)
+    {
+        __PHYSFS_platformGrabMutex(poolLock);
+        retval = pool->freelist;
+        if (retval != NULL)
+        {
+            pool->freelist = *((void **) retval);
+            pool->count--;
+        } /* if */
+        __PHYSFS_platformReleaseMutex(poolLock);
+    } /* if */
+
+    if (retval == NULL)
+    {
+        retval = allocator.Malloc(pool->objsize);
+        BAIL_IF(!retval, PHYSFS_ERR_OUT_OF_MEMORY, NULL);
+    } /* if */
+
+    return retval;
+} /* __PHYSFS_poolAlloc */
 
 
-void *__PHYSFS_initSmallAlloc(void *ptr, const size_t len)
+void __PHYSFS_poolFree(__PHYSFS_Pool *pool, void *ptr)
 {
-    void *useHeap = ((ptr == NULL) ? ((void *) 1) : ((void *) 0));
-    if (useHeap)  /* too large for stack allocation or alloca() failed. */
-        ptr = allocator.Malloc(len+sizeof (void *));
+    if (ptr == NULL)
+        return;
 
-    if (ptr != NULL)
+    if (poolLock != NULL)
     {
-        void **retval = (void **) ptr;
-        /*printf("%s alloc'd (%lld) bytes at (%p).\n",
-                useHeap ? "heap" : "stack", (long long) len, ptr);*/
-        *retval = useHeap;
-        return retval + 1;
+        __PHYSFS_platformGrabMutex(poolLock);
+        if (pool->count < PHYSFS_POOL_MAX)
+        {
+            if (!pool->registered)
+            {
+                pool->registered = 1;
+                pool->next = pools;
+                pools = pool;
+            } /* if */
+
+            *((void **) ptr) = pool->freelist;
+            pool->freelist = ptr;
+            pool->count++;
+            ptr = NULL;
+        } /* if */
+        __PHYSFS_platformReleaseMutex(poolLock);
     } /* if */
 
-    return NULL;  /* allocation failed. */
-} /* __PHYSFS_initSmallAlloc */
+    if (ptr != NULL)  /* no lock yet, or the pool is full. */
+        allocator.Free(ptr);
+} /* __PHYSFS_poolFree */
 
 
-void __PHYSFS_smallFree(void *ptr)
+/* Call this when nothing else could be using a pool any more. */
+static void freePools(void)
 {
-    if (ptr != NULL)
+    __PHYSFS_Pool *pool;
+    __PHYSFS_Pool *next;
+
+    for (pool = pools; pool != NULL; pool = next)
     {
-        void **block = ((void **) ptr) - 1;
-        const int useHeap = (*block != NULL);
-        if (useHeap)
-            allocator.Free(block);
-        /*printf("%s free'd (%p).\n", useHeap ? "heap" : "stack", block);*/
-    } /* if */
-} /* __PHYSFS_smallFree */
+        void *ptr = pool->freelist;
+        while (ptr != NULL)
+        {
+            void *nextptr = *((void **) ptr);
+            allocator.Free(ptr);
+            ptr = nextptr;
+        } /* while */
+
+        next = pool->next;
+        pool->freelist = NULL;
+        pool->count = 0;
+        pool->registered = 0;
+        pool->next = NULL;
+    } /* for */
+
+    pools = NULL;
+} /* freePools */
 
 
 int PHYSFS_setAllocator(const PHYSFS_Allocator *a)
@@ -3126,7 +6995,75 @@ static void setDefaultAllocator(void)
 } /* setDefaultAllocator */
 
 
-int __PHYSFS_DirTreeInit(__PHYSFS_DirTree *dt, const size_t entrylen)
+/* things loaded from the index cache all live in one allocation. */
+static inline int inDirTreeImage(const __PHYSFS_DirTree *dt, const void *ptr)
+{
+    const char *image = (const char *) dt->image;
+    return (image && ((const char *) ptr >= image) &&
+            ((const char *) ptr < image + dt->imagelen));
+} /* inDirTreeImage */
+
+
+/*
+ * Entries (and their names, which follow them) are never freed one at a
+ *  time, so they're carved out of big blocks, which all get freed together
+ *  when the tree goes away. Blocks start small, so tiny archives stay tiny,
+ *  and double in size up to a limit.
+ */
+typedef struct DirTreeArenaBlock
+{
+    struct DirTreeArenaBlock *next;
+    size_t used;
+    size_t size;
+} DirTreeArenaBlock;
+
+#define DIRTREE_ARENA_ALIGN(x) (((x) + 7) & ~((size_t) 7))
+#define DIRTREE_ARENA_HEADER DIRTREE_ARENA_ALIGN(sizeof (DirTreeArenaBlock))
+#define DIRTREE_ARENA_MIN_BLOCK (4 * 1024)
+#define DIRTREE_ARENA_MAX_BLOCK (256 * 1024)
+
+static void *dirTreeArenaAlloc(__PHYSFS_DirTree *dt, size_t len)
+{
+    DirTreeArenaBlock *block = (DirTreeArenaBlock *) dt->arena;
+    void *retval;
+
+    len = DIRTREE_ARENA_ALIGN(len);
+    if ((block == NULL) || (block->size - block->used < len))
+    {
+        size_t size = DIRTREE_ARENA_MIN_BLOCK;
+        if (block != NULL)
+        {
+            size = block->size * 2;
+            if (size > DIRTREE_ARENA_MAX_BLOCK)
+                size = DIRTREE_ARENA_MAX_BLOCK;
+        } /* if */
+
+        if (size < len)
+            size = len;  /* just give this one a block of its own. */
+
+        block = (DirTreeArenaBlock *)
+                    allocator.Malloc(DIRTREE_ARENA_HEADER + size);
+        BAIL_IF(!block, PHYSFS_ERR_OUT_OF_MEMORY, NULL);
+        block->next = (DirTreeArenaBlock *) dt->arena;
+        block->used = 0;
+        block->size = size;
+        dt->arena = block;
+    } /* if */
+
+    retval = ((char *) block) + DIRTREE_ARENA_HEADER + block->used;
+    block->used += len;
+    return retval;
+} /* dirTreeArenaAlloc */
+
+
+/* Keep about this many entries per hash bucket, at most. */
+#define DIRTREE_MAX_LOAD_FACTOR 2
+#define DIRTREE_MIN_BUCKETS 64
+/* Don't trust an archive's idea of its own size too far; we grow anyhow. */
+#define DIRTREE_MAX_INITIAL_BUCKETS (1 << 17)
+
+int __PHYSFS_DirTreeInit(__PHYSFS_DirTree *dt, const size_t entrylen,
+                         const PHYSFS_uint64 count)
 {
     static char rootpath[2] = { '/', '\0' };
     size_t alloclen;
@@ -3140,10 +7077,12 @@ int __PHYSFS_DirTreeInit(__PHYSFS_DirTree *dt, const size_t entrylen)
     memset(dt->root, '\0', entrylen);
     dt->root->name = rootpath;
     dt->root->isdir = 1;
-    dt->hashBuckets = 64;
-    if (!dt->hashBuckets)
-        dt->hashBuckets = 1;
+    dt->hashBuckets = DIRTREE_MIN_BUCKETS;
+    while ((dt->hashBuckets < DIRTREE_MAX_INITIAL_BUCKETS) &&
+           (dt->hashBuckets < count))
+        dt->hashBuckets *= 2;
     dt->entrylen = entrylen;
+    dt->ignorecase = ignoreCase;
 
     alloclen = dt->hashBuckets * sizeof (__PHYSFS_DirTreeEntry *);
     dt->hash = (__PHYSFS_DirTreeEntry **) allocator.Malloc(alloclen);
@@ -3154,12 +7093,76 @@ int __PHYSFS_DirTreeInit(__PHYSFS_DirTree *dt, const size_t entrylen)
 } /* __PHYSFS_DirTreeInit */
 
 
-static inline PHYSFS_uint32 hashPathName(__PHYSFS_DirTree *dt, const char *name)
+static inline PHYSFS_uint32 hashPathName(__PHYSFS_DirTree *dt,
+                                         const PHYSFS_uint32 hash)
 {
-    return __PHYSFS_hashString(name, strlen(name)) % dt->hashBuckets;
+    return hash % dt->hashBuckets;
 } /* hashPathName */
 
 
+/*
+ * Hash (path) the way (dt) wants it. Returns zero on allocation failure,
+ *  which can only happen when ignoring case.
+ */
+static int hashDirTreePath(const __PHYSFS_DirTree *dt, const char *path,
+                           const size_t len, PHYSFS_uint32 *hash)
+{
+    char *folded;
+    size_t foldedlen;
+
+    if (!dt->ignorecase)
+    {
+        *hash = __PHYSFS_hashString(path, len);
+        return 1;
+    } /* if */
+
+    folded = (char *) __PHYSFS_smallAlloc(__PHYSFS_CASEFOLD_BUFLEN(len));
+    BAIL_IF(!folded, PHYSFS_ERR_OUT_OF_MEMORY, 0);
+    foldedlen = __PHYSFS_utf8CaseFold(path, folded);
+    *hash = __PHYSFS_hashString(folded, foldedlen);
+    __PHYSFS_smallFree(folded);
+    return 1;
+} /* hashDirTreePath */
+
+
+/* Double the hash table. If this fails, we just keep the old one. */
+static void growDirTreeHash(__PHYSFS_DirTree *dt)
+{
+    const size_t oldBuckets = dt->hashBuckets;
+    __PHYSFS_DirTreeEntry **oldHash = dt->hash;
+    __PHYSFS_DirTreeEntry **hash;
+    size_t i;
+
+    if (oldBuckets > (((size_t) -1) / sizeof (*hash)) / 2)
+        return;  /* can't get any bigger. */
+
+    hash = (__PHYSFS_DirTreeEntry **)
+                allocator.Malloc(oldBuckets * 2 * sizeof (*hash));
+    if (!hash)
+        return;
+
+    memset(hash, '\0', oldBuckets * 2 * sizeof (*hash));
+    dt->hash = hash;
+    dt->hashBuckets = oldBuckets * 2;
+
+    for (i = 0; i < oldBuckets; i++)
+    {
+        __PHYSFS_DirTreeEntry *entry;
+        __PHYSFS_DirTreeEntry *next;
+        for (entry = oldHash[i]; entry; entry = next)
+        {
+            const PHYSFS_uint32 hashval = hashPathName(dt, entry->hash);
+            next = entry->hashnext;
+            entry->hashnext = hash[hashval];
+            hash[hashval] = entry;
+        } /* for */
+    } /* for */
+
+    if (!inDirTreeImage(dt, oldHash))
+        allocator.Free(oldHash);
+} /* growDirTreeHash */
+
+
 /* Fill in missing parent directories. */
 static __PHYSFS_DirTreeEntry *addAncestors(__PHYSFS_DirTree *dt, char *name)
 {
@@ -3192,19 +7195,26 @@ void *__PHYSFS_DirTreeAdd(__PHYSFS_DirTree *dt, char *name, const int isdir)
     __PHYSFS_DirTreeEntry *retval = __PHYSFS_DirTreeFind(dt, name);
     if (!retval)
     {
-        const size_t alloclen = strlen(name) + 1 + dt->entrylen;
-        PHYSFS_uint32 hashval;
+        const size_t namelen = strlen(name);
+        const size_t alloclen = namelen + 1 + dt->entrylen;
+        PHYSFS_uint32 hash, hashval;
         __PHYSFS_DirTreeEntry *parent = addAncestors(dt, name);
         BAIL_IF_ERRPASS(!parent, NULL);
+        BAIL_IF_ERRPASS(!hashDirTreePath(dt, name, namelen, &hash), NULL);
         assert(dt->entrylen >= sizeof (__PHYSFS_DirTreeEntry));
-        retval = (__PHYSFS_DirTreeEntry *) allocator.Malloc(alloclen);
-        BAIL_IF(!retval, PHYSFS_ERR_OUT_OF_MEMORY, NULL);
+        retval = (__PHYSFS_DirTreeEntry *) dirTreeArenaAlloc(dt, alloclen);
+        BAIL_IF_ERRPASS(!retval, NULL);
         memset(retval, '\0', dt->entrylen);
         retval->name = ((char *) retval) + dt->entrylen;
-        strcpy(retval->name, name);
-        hashval = hashPathName(dt, name);
+        memcpy(retval->name, name, namelen + 1);
+        retval->hash = hash;
+        retval->namelen = (PHYSFS_uint32) namelen;
+        if (dt->entryCount >= dt->hashBuckets * DIRTREE_MAX_LOAD_FACTOR)
+            growDirTreeHash(dt);
+        hashval = hashPathName(dt, retval->hash);
         retval->hashnext = dt->hash[hashval];
         dt->hash[hashval] = retval;
+        dt->entryCount++;
         retval->sibling = parent->children;
         retval->isdir = isdir;
         parent->children = retval;
@@ -3214,35 +7224,52 @@ void *__PHYSFS_DirTreeAdd(__PHYSFS_DirTree *dt, char *name, const int isdir)
 } /* __PHYSFS_DirTreeAdd */
 
 
-/* Find the __PHYSFS_DirTreeEntry for a path in platform-independent notation. */
+int __PHYSFS_DirTreeOtherCase(const __PHYSFS_DirTree *dt, const void *entry,
+                              const char *name)
+{
+    const __PHYSFS_DirTreeEntry *e = (const __PHYSFS_DirTreeEntry *) entry;
+    return ((dt->ignorecase) && (strcmp(e->name, name) != 0));
+} /* __PHYSFS_DirTreeOtherCase */
+
+
+/*
+ * Find the __PHYSFS_DirTreeEntry for a path in platform-independent notation.
+ *  This doesn't modify the tree (no move-to-front on hits), so several
+ *  threads can search the same tree at once.
+ */
 void *__PHYSFS_DirTreeFind(__PHYSFS_DirTree *dt, const char *path)
 {
-    PHYSFS_uint32 hashval;
-    __PHYSFS_DirTreeEntry *prev = NULL;
+    PHYSFS_uint32 probes = 0;
+    PHYSFS_uint32 hash;
+    size_t len;
     __PHYSFS_DirTreeEntry *retval;
 
     if (*path == '\0')
         return dt->root;
 
-    hashval = hashPathName(dt, path);
-    for (retval = dt->hash[hashval]; retval; retval = retval->hashnext)
+    /* only bother comparing strings when the full hash (and length) match. */
+    len = strlen(path);
+    BAIL_IF_ERRPASS(!hashDirTreePath(dt, path, len, &hash), NULL);
+    for (retval = dt->hash[hashPathName(dt, hash)]; retval;
+         retval = retval->hashnext)
     {
-        if (strcmp(retval->name, path) == 0)
+        probes++;
+        if (retval->hash != hash)
+            continue;
+        else if (dt->ignorecase)
         {
-            if (prev != NULL)  /* move this to the front of the list */
-            {
-                prev->hashnext = retval->hashnext;
-                retval->hashnext = dt->hash[hashval];
-                dt->hash[hashval] = retval;
-            } /* if */
-
-            return retval;
-        } /* if */
-
-        prev = retval;
+            if (PHYSFS_utf8stricmp(retval->name, path) == 0)
+                break;
+        } /* else if */
+        else if ((retval->namelen == len) &&
+                 (memcmp(retval->name, path, len) == 0))
+            break;
     } /* for */
 
-    BAIL(PHYSFS_ERR_NOT_FOUND, NULL);
+    __PHYSFS_STAT_INCR(treeLookups);
+    __PHYSFS_STAT_ADD(treeProbes, probes);
+    BAIL_IF(!retval, PHYSFS_ERR_NOT_FOUND, NULL);
+    return retval;
 } /* __PHYSFS_DirTreeFind */
 
 PHYSFS_EnumerateCallbackResult __PHYSFS_DirTreeEnumerate(void *opaque,
@@ -3278,25 +7305,550 @@ void __PHYSFS_DirTreeDeinit(__PHYSFS_DirTree *dt)
     {
         assert(dt->root->sibling == NULL);
         assert(dt->hash || (dt->root->children == NULL));
-        allocator.Free(dt->root);
+        if (!inDirTreeImage(dt, dt->root))
+            allocator.Free(dt->root);
+    } /* if */
+
+    if ((dt->hash) && (!inDirTreeImage(dt, dt->hash)))
+        allocator.Free(dt->hash);
+
+    while (dt->arena)
+    {
+        DirTreeArenaBlock *next = ((DirTreeArenaBlock *) dt->arena)->next;
+        allocator.Free(dt->arena);
+        dt->arena = next;
+    } /* while */
+
+    if (dt->image)
+        allocator.Free(dt->image);
+} /* __PHYSFS_DirTreeDeinit */
+
+
+/*
+ * The index cache file is this header, then the archive's path, the tag,
+ *  the key and the extra blob, then the entries (root first), then the hash
+ *  table. Each of those sections starts 8-byte aligned. Inside the entries
+ *  and the hash table, pointers are stored as (offset into the entries + 1),
+ *  with zero for NULL; names follow their entry and aren't stored as
+ *  pointers at all. It's all native byte order and layout, since the cache
+ *  only has to make sense to the build that wrote it.
+ */
+#define DIRTREE_CACHE_MAGIC "PhysFSix"
+#define DIRTREE_CACHE_VERSION 2
+#define DIRTREE_CACHE_NATIVE 0x01020304
+#define DIRTREE_CACHE_ALIGN(x) (((x) + 7) & ~((size_t) 7))
+
+typedef struct
+{
+    char magic[8];
+    PHYSFS_uint32 version;
+    PHYSFS_uint32 native;
+    PHYSFS_uint32 ptrsize;
+    PHYSFS_uint32 entrylen;
+    PHYSFS_uint64 hashBuckets;
+    PHYSFS_uint64 count;  /* entries, not counting the root. */
+    PHYSFS_uint64 archivelen;
+    PHYSFS_sint64 archivetime;
+    PHYSFS_uint32 namelen;
+    PHYSFS_uint32 taglen;
+    PHYSFS_uint32 keylen;
+    PHYSFS_uint32 extralen;
+    PHYSFS_uint64 blocklen;  /* bytes of entries, including the root. */
+    PHYSFS_uint32 checksum;  /* of everything after this header. */
+    PHYSFS_uint32 ignorecase;  /* hashes are of case-folded names. */
+} DirTreeCacheHeader;
+
+
+/* Fill in (stat) for a native archive, and make the cache file's path. */
+static char *dirTreeCachePath(const char *name, const char *tag,
+                              PHYSFS_Stat *statbuf)
+{
+    const char dirsep = __PHYSFS_platformDirSeparator;
+    size_t dirlen;
+    size_t len;
+    char *retval;
+
+    if ((indexCacheDir == NULL) || (name == NULL))
+        return NULL;
+    else if (!__PHYSFS_platformStat(name, statbuf, 1))
+        return NULL;
+    else if (statbuf->filetype != PHYSFS_FILETYPE_REGULAR)
+        return NULL;
+
+    dirlen = strlen(indexCacheDir);
+    len = dirlen + strlen(tag) + 32;
+    retval = (char *) allocator.Malloc(len);
+    BAIL_IF(!retval, PHYSFS_ERR_OUT_OF_MEMORY, NULL);
+    snprintf(retval, len, "%s%s%08x-%s.idx", indexCacheDir,
+             ((dirlen > 0) && (indexCacheDir[dirlen-1] == dirsep)) ? "" : "/",
+             (unsigned int) __PHYSFS_hashString(name, strlen(name)), tag);
+    if (dirsep != '/')
+    {
+        char *ptr = retval + dirlen;
+        for (ptr = strchr(ptr, '/'); ptr != NULL; ptr = strchr(ptr, '/'))
+            *ptr = dirsep;
     } /* if */
 
-    if (dt->hash)
+    return retval;
+} /* dirTreeCachePath */
+
+
+static int dirTreeCacheCmpEntry(void *_a, size_t one, size_t two)
+{
+    char **a = (char **) _a;
+    return (a[one] < a[two]) ? -1 : ((a[one] > a[two]) ? 1 : 0);
+} /* dirTreeCacheCmpEntry */
+
+
+static void dirTreeCacheSwapEntry(void *_a, size_t one, size_t two)
+{
+    char **a = (char **) _a;
+    char *tmp = a[one];
+    a[one] = a[two];
+    a[two] = tmp;
+} /* dirTreeCacheSwapEntry */
+
+
+/* (entries) is sorted by address, parallel to (offsets). */
+static PHYSFS_uint64 dirTreeCacheOffset(const __PHYSFS_DirTreeEntry *entry,
+                                        char **entries,
+                                        const PHYSFS_uint64 *offsets,
+                                        const size_t count)
+{
+    size_t lo = 0;
+    size_t hi = count;
+
+    if (entry == NULL)
+        return 0;
+
+    while (lo < hi)
+    {
+        const size_t mid = lo + ((hi - lo) / 2);
+        if (entries[mid] == (const char *) entry)
+            return offsets[mid] + 1;
+        else if (entries[mid] < (const char *) entry)
+            lo = mid + 1;
+        else
+            hi = mid;
+    } /* while */
+
+    assert(0 && "entry isn't in its own tree?");
+    return 0;
+} /* dirTreeCacheOffset */
+
+
+void __PHYSFS_DirTreeStoreCache(const __PHYSFS_DirTree *dt, const char *name,
+                                const char *tag, const void *key,
+                                const size_t keylen, const void *extra,
+                                const size_t extralen)
+{
+    const size_t stride = DIRTREE_CACHE_ALIGN(dt->entrylen);
+    DirTreeCacheHeader *header;
+    PHYSFS_uint64 *offsets = NULL;
+    PHYSFS_uint64 *hash;
+    char **entries = NULL;
+    PHYSFS_Io *io = NULL;
+    PHYSFS_Stat statbuf;
+    char *image = NULL;
+    char *block;
+    char *path;
+    char *ptr;
+    size_t count = 0;
+    size_t blocklen = stride;
+    size_t metalen, imagelen, pos, i;
+
+    path = dirTreeCachePath(name, tag, &statbuf);
+    if (!path)
+        return;
+
+    for (i = 0; i < dt->hashBuckets; i++)
     {
-        size_t i;
-        for (i = 0; i < dt->hashBuckets; i++)
+        const __PHYSFS_DirTreeEntry *entry;
+        for (entry = dt->hash[i]; entry; entry = entry->hashnext)
         {
-            __PHYSFS_DirTreeEntry *entry;
-            __PHYSFS_DirTreeEntry *next;
-            for (entry = dt->hash[i]; entry; entry = next)
-            {
-                next = entry->hashnext;
-                allocator.Free(entry);
-            } /* for */
+            blocklen += stride + DIRTREE_CACHE_ALIGN(strlen(entry->name) + 1);
+            count++;
         } /* for */
-        allocator.Free(dt->hash);
+    } /* for */
+
+    entries = (char **) allocator.Malloc(sizeof (char *) * (count + 1));
+    offsets = (PHYSFS_uint64 *) allocator.Malloc(sizeof (PHYSFS_uint64) * (count + 1));
+    GOTO_IF(!entries || !offsets, PHYSFS_ERR_OUT_OF_MEMORY, storeCacheDone);
+
+    entries[0] = (char *) dt->root;
+    count = 1;
+    for (i = 0; i < dt->hashBuckets; i++)
+    {
+        __PHYSFS_DirTreeEntry *entry;
+        for (entry = dt->hash[i]; entry; entry = entry->hashnext)
+            entries[count++] = (char *) entry;
+    } /* for */
+
+    /* sorted by address for dirTreeCacheOffset(). The root goes first in
+       the file, then everything else in this order. */
+    __PHYSFS_sort(entries, count, dirTreeCacheCmpEntry, dirTreeCacheSwapEntry);
+    pos = stride;
+    for (i = 0; i < count; i++)
+    {
+        const __PHYSFS_DirTreeEntry *entry;
+        entry = (const __PHYSFS_DirTreeEntry *) entries[i];
+        if (entry == dt->root)
+            offsets[i] = 0;
+        else
+        {
+            offsets[i] = pos;
+            pos += stride + DIRTREE_CACHE_ALIGN(strlen(entry->name) + 1);
+        } /* else */
+    } /* for */
+    assert(pos == blocklen);
+
+    metalen = DIRTREE_CACHE_ALIGN(sizeof (DirTreeCacheHeader)) +
+              DIRTREE_CACHE_ALIGN(strlen(name) + strlen(tag) +
+                                  keylen + extralen);
+    imagelen = metalen + blocklen + (dt->hashBuckets * sizeof (PHYSFS_uint64));
+    image = (char *) allocator.Malloc(imagelen);
+    GOTO_IF(!image, PHYSFS_ERR_OUT_OF_MEMORY, storeCacheDone);
+    memset(image, '\0', imagelen);
+
+    header = (DirTreeCacheHeader *) image;
+    memcpy(header->magic, DIRTREE_CACHE_MAGIC, sizeof (header->magic));
+    header->version = DIRTREE_CACHE_VERSION;
+    header->native = DIRTREE_CACHE_NATIVE;
+    header->ptrsize = (PHYSFS_uint32) sizeof (void *);
+    header->entrylen = (PHYSFS_uint32) dt->entrylen;
+    header->hashBuckets = (PHYSFS_uint64) dt->hashBuckets;
+    header->count = (PHYSFS_uint64) (count - 1);
+    header->archivelen = (PHYSFS_uint64) statbuf.filesize;
+    header->archivetime = statbuf.modtime;
+    header->namelen = (PHYSFS_uint32) strlen(name);
+    header->taglen = (PHYSFS_uint32) strlen(tag);
+    header->keylen = (PHYSFS_uint32) keylen;
+    header->extralen = (PHYSFS_uint32) extralen;
+    header->blocklen = (PHYSFS_uint64) blocklen;
+    header->ignorecase = (PHYSFS_uint32) dt->ignorecase;
+
+    ptr = image + DIRTREE_CACHE_ALIGN(sizeof (DirTreeCacheHeader));
+    memcpy(ptr, name, header->namelen); ptr += header->namelen;
+    memcpy(ptr, tag, header->taglen); ptr += header->taglen;
+    memcpy(ptr, key, keylen); ptr += keylen;
+    memcpy(ptr, extra, extralen);
+
+    block = image + metalen;
+    for (i = 0; i < count; i++)
+    {
+        const __PHYSFS_DirTreeEntry *entry;
+        __PHYSFS_DirTreeEntry *out;
+        entry = (const __PHYSFS_DirTreeEntry *) entries[i];
+        out = (__PHYSFS_DirTreeEntry *) (block + offsets[i]);
+        memcpy(out, entry, dt->entrylen);
+        out->name = NULL;
+        out->hashnext = (__PHYSFS_DirTreeEntry *) (size_t)
+            dirTreeCacheOffset(entry->hashnext, entries, offsets, count);
+        out->children = (__PHYSFS_DirTreeEntry *) (size_t)
+            dirTreeCacheOffset(entry->children, entries, offsets, count);
+        out->sibling = (__PHYSFS_DirTreeEntry *) (size_t)
+            dirTreeCacheOffset(entry->sibling, entries, offsets, count);
+        if (entry != dt->root)
+            strcpy(((char *) out) + stride, entry->name);
+    } /* for */
+
+    hash = (PHYSFS_uint64 *) (block + blocklen);
+    for (i = 0; i < dt->hashBuckets; i++)
+        hash[i] = dirTreeCacheOffset(dt->hash[i], entries, offsets, count);
+
+    header->checksum = __PHYSFS_hashString(image + sizeof (*header),
+                                            imagelen - sizeof (*header));
+
+    io = __PHYSFS_createNativeIo(path, 'w');
+    if (io != NULL)
+    {
+        if (io->write(io, image, imagelen) != (PHYSFS_sint64) imagelen)
+        {
+            io->destroy(io);
+            io = NULL;
+            __PHYSFS_platformDelete(path);  /* don't leave half of it. */
+        } /* if */
+        else
+        {
+            io->flush(io);
+        } /* else */
     } /* if */
-} /* __PHYSFS_DirTreeDeinit */
+
+storeCacheDone:
+    if (io != NULL)
+        io->destroy(io);
+    allocator.Free(image);
+    allocator.Free(offsets);
+    allocator.Free(entries);
+    allocator.Free(path);
+} /* __PHYSFS_DirTreeStoreCache */
+
+
+/* What __PHYSFS_DirTreeLoadCache() knows about each 8 bytes of entries. */
+#define DIRTREE_CACHE_MARK_ENTRY 0x1  /* an entry (not the root) starts here. */
+#define DIRTREE_CACHE_MARK_TREE 0x2   /* reached from the root. */
+#define DIRTREE_CACHE_MARK_HASH 0x4   /* reached from a hash bucket. */
+
+/*
+ * Turn a stored (offset + 1) back into a pointer, if it's NULL or the start
+ *  of an entry other than the root.
+ */
+static int dirTreeCacheRelocate(__PHYSFS_DirTreeEntry **ptr, char *block,
+                                const PHYSFS_uint8 *marks,
+                                const PHYSFS_uint64 markslen)
+{
+    const PHYSFS_uint64 val = (PHYSFS_uint64) (size_t) *ptr;
+    if (val == 0)
+        return 1;
+    else if ((val - 1) % 8)
+        return 0;
+    else if (((val - 1) / 8) >= markslen)
+        return 0;
+    else if ((marks[(val - 1) / 8] & DIRTREE_CACHE_MARK_ENTRY) == 0)
+        return 0;
+    *ptr = (__PHYSFS_DirTreeEntry *) (block + (val - 1));
+    return 1;
+} /* dirTreeCacheRelocate */
+
+
+/*
+ * Mark (entry), relocated by dirTreeCacheRelocate(), as reached one more
+ *  way. Reaching it the same way twice means the cache's lists loop or
+ *  share entries, which a real tree never does.
+ */
+static int dirTreeCacheVisit(const __PHYSFS_DirTreeEntry *entry,
+                             const char *block, PHYSFS_uint8 *marks,
+                             const PHYSFS_uint8 how)
+{
+    PHYSFS_uint8 *mark = &marks[(((const char *) entry) - block) / 8];
+    if (*mark & how)
+        return 0;
+    *mark |= how;
+    return 1;
+} /* dirTreeCacheVisit */
+
+
+/*
+ * Make sure the relocated tree in (block) is really a tree: every entry is
+ *  a child of exactly one directory, reachable from the root, and in
+ *  exactly one hash bucket, the one its hash goes in. Each list is walked
+ *  once, so a cache that loops fails here instead of hanging a lookup.
+ */
+static int dirTreeCacheVerify(char *block, __PHYSFS_DirTreeEntry **hash,
+                              const PHYSFS_uint64 buckets,
+                              const PHYSFS_uint64 count, PHYSFS_uint8 *marks)
+{
+    __PHYSFS_DirTreeEntry **queue;
+    __PHYSFS_DirTreeEntry *entry;
+    PHYSFS_uint64 visited = 0;
+    PHYSFS_uint64 head = 0;
+    PHYSFS_uint64 tail = 0;
+    PHYSFS_uint64 i;
+    int retval = 0;
+
+    if ((count + 1) != (size_t) (count + 1))
+        return 0;
+    queue = (__PHYSFS_DirTreeEntry **) allocator.Malloc(
+                            (size_t) (count + 1) * sizeof (*queue));
+    BAIL_IF(!queue, PHYSFS_ERR_OUT_OF_MEMORY, 0);
+
+    /* every directory's kids, breadth-first from the root. */
+    queue[tail++] = (__PHYSFS_DirTreeEntry *) block;
+    while (head < tail)
+    {
+        const __PHYSFS_DirTreeEntry *dir = queue[head++];
+        GOTO_IF_ERRPASS((dir->children != NULL) && (!dir->isdir),
+                        verifyCacheDone);
+        for (entry = dir->children; entry; entry = entry->sibling)
+        {
+            GOTO_IF_ERRPASS(++visited > count, verifyCacheDone);
+            GOTO_IF_ERRPASS(!dirTreeCacheVisit(entry, block, marks,
+                            DIRTREE_CACHE_MARK_TREE), verifyCacheDone);
+            queue[tail++] = entry;
+        } /* for */
+    } /* while */
+    GOTO_IF_ERRPASS(visited != count, verifyCacheDone);
+
+    /* every entry once in the hash, in the right bucket. */
+    visited = 0;
+    for (i = 0; i < buckets; i++)
+    {
+        for (entry = hash[i]; entry; entry = entry->hashnext)
+        {
+            GOTO_IF_ERRPASS(++visited > count, verifyCacheDone);
+            GOTO_IF_ERRPASS((entry->hash % buckets) != i, verifyCacheDone);
+            GOTO_IF_ERRPASS(!dirTreeCacheVisit(entry, block, marks,
+                            DIRTREE_CACHE_MARK_HASH), verifyCacheDone);
+        } /* for */
+    } /* for */
+    GOTO_IF_ERRPASS(visited != count, verifyCacheDone);
+
+    retval = 1;
+
+verifyCacheDone:
+    allocator.Free(queue);
+    return retval;
+} /* dirTreeCacheVerify */
+
+
+int __PHYSFS_DirTreeLoadCache(__PHYSFS_DirTree *dt, const char *name,
+                              const char *tag, const void *key,
+                              const size_t keylen, void *extra,
+                              const size_t extralen)
+{
+    const size_t stride = DIRTREE_CACHE_ALIGN(dt->entrylen);
+    const DirTreeCacheHeader *header;
+    __PHYSFS_DirTreeEntry **hash;
+    PHYSFS_Io *io = NULL;
+    PHYSFS_Stat statbuf;
+    PHYSFS_sint64 len;
+    PHYSFS_uint64 i, pos, markslen;
+    PHYSFS_uint8 *marks = NULL;
+    size_t metalen;
+    char *image = NULL;
+    char *block;
+    char *path;
+    char *ptr;
+
+    if ((dt->image != NULL) || (dt->root->children != NULL))
+        return 0;  /* only works on a fresh, empty tree. */
+
+    path = dirTreeCachePath(name, tag, &statbuf);
+    if (!path)
+        return 0;
+
+    io = __PHYSFS_createNativeIo(path, 'r');
+    allocator.Free(path);
+    if (!io)
+        return 0;
+
+    len = io->length(io);
+    if ((len > (PHYSFS_sint64) sizeof (DirTreeCacheHeader)) &&
+        ((PHYSFS_uint64) len == (size_t) len))
+    {
+        image = (char *) allocator.Malloc((size_t) len);
+        if ((image != NULL) && (!__PHYSFS_readAll(io, image, (size_t) len)))
+        {
+            allocator.Free(image);
+            image = NULL;
+        } /* if */
+    } /* if */
+    io->destroy(io);
+
+    if (!image)
+        return 0;
+
+    header = (const DirTreeCacheHeader *) image;
+    metalen = DIRTREE_CACHE_ALIGN(sizeof (DirTreeCacheHeader)) +
+              DIRTREE_CACHE_ALIGN(strlen(name) + strlen(tag) +
+                                  keylen + extralen);
+    ptr = image + DIRTREE_CACHE_ALIGN(sizeof (DirTreeCacheHeader));
+    block = image + metalen;
+
+    if ( (memcmp(header->magic, DIRTREE_CACHE_MAGIC, 8) != 0) ||
+         (header->version != DIRTREE_CACHE_VERSION) ||
+         (header->native != DIRTREE_CACHE_NATIVE) ||
+         (header->ptrsize != sizeof (void *)) ||
+         (header->entrylen != dt->entrylen) ||
+         (header->hashBuckets == 0) ||
+         (header->ignorecase != (PHYSFS_uint32) dt->ignorecase) ||
+         (header->archivelen != (PHYSFS_uint64) statbuf.filesize) ||
+         (header->archivetime != statbuf.modtime) ||
+         (header->namelen != strlen(name)) ||
+         (header->taglen != strlen(tag)) ||
+         (header->keylen != keylen) ||
+         (header->extralen != extralen) ||
+         (header->blocklen < stride) ||
+         (header->blocklen % 8) ||
+         (header->blocklen > (PHYSFS_uint64) len) ||
+         (header->hashBuckets > ((PHYSFS_uint64) len) / 8) ||
+         (metalen + header->blocklen + (header->hashBuckets *
+            sizeof (PHYSFS_uint64)) != (PHYSFS_uint64) len) ||
+         (header->checksum != __PHYSFS_hashString(image + sizeof (*header),
+                                        (size_t) len - sizeof (*header))) ||
+         (memcmp(ptr, name, header->namelen) != 0) ||
+         (memcmp(ptr + header->namelen, tag, header->taglen) != 0) ||
+         (memcmp(ptr + header->namelen + header->taglen, key, keylen) != 0) )
+        goto loadCacheFailed;
+
+    /* the checksum only catches accidents, so trust nothing past here. */
+    markslen = header->blocklen / 8;
+    marks = (PHYSFS_uint8 *) allocator.Malloc((size_t) markslen);
+    GOTO_IF(!marks, PHYSFS_ERR_OUT_OF_MEMORY, loadCacheFailed);
+    memset(marks, '\0', (size_t) markslen);
+
+    /* find where every entry starts. Root first, then all the rest. */
+    for (i = 0, pos = 0; pos < header->blocklen; i++)
+    {
+        __PHYSFS_DirTreeEntry *entry = (__PHYSFS_DirTreeEntry *) (block + pos);
+        GOTO_IF_ERRPASS(pos + stride > header->blocklen, loadCacheFailed);
+        if (pos == 0)
+        {
+            entry->name = dt->root->name;
+            pos += stride;
+        } /* if */
+        else
+        {
+            const size_t avail = (size_t) (header->blocklen - (pos + stride));
+            entry->name = ((char *) entry) + stride;
+            GOTO_IF_ERRPASS(memchr(entry->name, '\0', avail) == NULL,
+                            loadCacheFailed);
+            GOTO_IF_ERRPASS(strlen(entry->name) != entry->namelen,
+                            loadCacheFailed);
+            marks[pos / 8] = DIRTREE_CACHE_MARK_ENTRY;
+            pos += stride + DIRTREE_CACHE_ALIGN(entry->namelen + 1);
+        } /* else */
+    } /* for */
+
+    GOTO_IF_ERRPASS(i != header->count + 1, loadCacheFailed);
+
+    /* fix up every entry's pointers, now that we know where they can go. */
+    for (pos = 0; pos < header->blocklen; )
+    {
+        __PHYSFS_DirTreeEntry *entry = (__PHYSFS_DirTreeEntry *) (block + pos);
+        if ( (!dirTreeCacheRelocate(&entry->hashnext, block,
+                                    marks, markslen)) ||
+             (!dirTreeCacheRelocate(&entry->children, block,
+                                    marks, markslen)) ||
+             (!dirTreeCacheRelocate(&entry->sibling, block,
+                                    marks, markslen)) )
+            goto loadCacheFailed;
+        pos += stride;
+        if (pos > stride)  /* not the root: skip the name, too. */
+            pos += DIRTREE_CACHE_ALIGN(entry->namelen + 1);
+    } /* for */
+
+    /* pointers can be narrower than the stored offsets; this is in-place. */
+    hash = (__PHYSFS_DirTreeEntry **) (block + header->blocklen);
+    for (i = 0; i < header->hashBuckets; i++)
+    {
+        const PHYSFS_uint64 *stored = ((const PHYSFS_uint64 *) hash) + i;
+        __PHYSFS_DirTreeEntry *val = (__PHYSFS_DirTreeEntry*) (size_t) *stored;
+        if (!dirTreeCacheRelocate(&val, block, marks, markslen))
+            goto loadCacheFailed;
+        hash[i] = val;
+    } /* for */
+
+    if (!dirTreeCacheVerify(block, hash, header->hashBuckets,
+                            header->count, marks))
+        goto loadCacheFailed;
+
+    allocator.Free(marks);
+    allocator.Free(dt->root);
+    allocator.Free(dt->hash);
+    dt->root = (__PHYSFS_DirTreeEntry *) block;
+    dt->hash = hash;
+    dt->hashBuckets = (size_t) header->hashBuckets;
+    dt->entryCount = (size_t) header->count;
+    dt->image = image;
+    dt->imagelen = (size_t) len;
+    return 1;
+
+loadCacheFailed:
+    allocator.Free(marks);
+    allocator.Free(image);
+    return 0;
+} /* __PHYSFS_DirTreeLoadCache */
 
 /* end of physfs.c ... */
 
@@ -124,7 +124,11 @@
  *
  * PhysicsFS is mostly thread safe. The errors returned by
  *  PHYSFS_getLastErrorCode() are unique by thread, and library-state-setting
- *  functions are mutex'd. For efficiency, individual file accesses are 
+ *  functions are mutex'd. Lookups (opening files, PHYSFS_stat(),
+ *  enumerating, etc) from different threads can run at the same time, even
+ *  against the same archive; only calls that change the search path or
+ *  write dir (PHYSFS_mount(), PHYSFS_unmount(), PHYSFS_setWriteDir(), etc)
+ *  make everyone else wait. For efficiency, individual file accesses are 
  *  not locked, so you can not safely read/write/seek/close/etc the same 
  *  file from two threads at the same time. Other race conditions are bugs 
  *  that should be reported/patched.
@@ -1456,7 +1460,9 @@ PHYSFS_DECL PHYSFS_sint64 PHYSFS_fileLength(PHYSFS_File *handle);
  *  on the same file. Setting the buffer size to zero will free an existing
  *  buffer.
  *
- * PhysicsFS file handles are unbuffered by default.
+ * PhysicsFS file handles are unbuffered by default, unless
+ *  PHYSFS_setReadAhead() has enabled automatic buffering of sequential
+ *  reads. Calling this on a handle takes over from that for good.
  *
  * Please check the return value of this function! Failures can include
  *  not being able to seek backwards in a read-only file when removing the
@@ -1485,11 +1491,17 @@ PHYSFS_DECL int PHYSFS_setBuffer(PHYSFS_File *handle, PHYSFS_uint64 bufsize);
  * For buffered files opened for reading or unbuffered files, this is a safe
  *  no-op, and will report success.
  *
+ * For write-behind handles (see PHYSFS_setWriteBehind()), this is the
+ *  barrier: it waits until everything written so far is out of the
+ *  background thread's hands and synced to disk, and fails if any of it
+ *  couldn't be written.
+ *
  *   \param handle handle returned from PHYSFS_open*().
  *  \return nonzero if successful, zero on error.
  *
  * \sa PHYSFS_setBuffer
  * \sa PHYSFS_close
+ * \sa PHYSFS_setWriteBehind
  */
 PHYSFS_DECL int PHYSFS_flush(PHYSFS_File *handle);
 
@@ -2734,6 +2746,11 @@ typedef PHYSFS_EnumerateCallbackResult (*PHYSFS_EnumerateCallback)(void *data,
  *  control if it wants enumeration to stop early. See the documentation for
  *  PHYSFS_EnumerateCallback for details on how your callback should behave.
  *
+ * Your callback may open or stat files, but it must not change the search
+ *  path or write dir (PHYSFS_mount(), PHYSFS_unmount(), PHYSFS_setWriteDir(),
+ *  etc); those would wait forever for the enumeration to finish. Collect what
+ *  you need and make those calls after this function returns.
+ *
  *    \param dir Directory, in platform-independent notation, to enumerate.
  *    \param c Callback function to notify about search path elements.
  *    \param d Application-defined data passed to callback. Can be NULL.
@@ -3030,8 +3047,8 @@ PHYSFS_DECL PHYSFS_sint64 PHYSFS_writeBytes(PHYSFS_File *handle,
  * ...in short, you're probably not going to write an HTTP implementation.
  *
  * Thread safety: PHYSFS_Io implementations are not guaranteed to be thread
- *  safe in themselves. Under the hood where PhysicsFS uses them, the library
- *  provides its own locks. If you plan to use them directly from separate
+ *  safe in themselves, except for the readAt() method. Under the hood where
+ *  PhysicsFS uses them, the library provides its own locks. If you plan to use them directly from separate
  *  threads, you should either use mutexes to protect them, or don't use the
  *  same PHYSFS_Io from two threads at the same time.
  *
@@ -3042,10 +3059,11 @@ typedef struct PHYSFS_Io
     /**
      * \brief Binary compatibility information.
      *
-     * This must be set to zero at this time. Future versions of this
-     *  struct will increment this field, so we know what a given
-     *  implementation supports. We'll presumably keep supporting older
-     *  versions as we offer new features, though.
+     * Set this to 0 or 1. Version 1 added the readAt() method; version 0
+     *  implementations end at destroy(), and PhysicsFS won't look past it.
+     *  Future versions of this struct will increment this field, so we know
+     *  what a given implementation supports. We'll presumably keep
+     *  supporting older versions as we offer new features, though.
      */
     PHYSFS_uint32 version;
 
@@ -3194,6 +3212,37 @@ typedef struct PHYSFS_Io
      *   \param s The i/o instance to destroy.
      */
     void (*destroy)(struct PHYSFS_Io *io);
+
+    /**
+     * \brief Read data from a given byte offset. (version 1 and later.)
+     *
+     * Read up to (len) bytes, starting (offset) bytes from the start of the
+     *  dataset, into (buf), without using or moving the current i/o position
+     *  that read() and seek() work with.
+     *
+     * If you implement this, it must be safe to call from several threads
+     *  at once on the same instance. PhysicsFS uses that to let every file
+     *  opened from an archive share the archive's one i/o instance (and its
+     *  one native file handle) instead of calling duplicate() for each, and
+     *  to let threads read from the same archive without fighting over a
+     *  seek position. PhysicsFS won't call read() or seek() on an instance
+     *  while it might be using readAt() on it from another thread, so it's
+     *  fine if a readAt() call disturbs the current i/o position.
+     *
+     * You don't have to implement this; set it to NULL if not implemented,
+     *  and PhysicsFS will use duplicate(), seek() and read() instead. This
+     *  field only exists if (version) is at least 1.
+     *
+     *   \param io The i/o instance to read from.
+     *   \param offset The byte offset to start reading from.
+     *   \param buf The buffer to store data into. It must be at least
+     *                 (len) bytes long and can't be NULL.
+     *   \param len The number of bytes to read from the interface.
+     *  \return number of bytes read, 0 if (offset) is at or past the end of
+     *          the dataset, -1 if complete failure.
+     */
+    PHYSFS_sint64 (*readAt)(struct PHYSFS_Io *io, PHYSFS_uint64 offset,
+                            void *buf, PHYSFS_uint64 len);
 } PHYSFS_Io;
 
 
@@ -3395,7 +3444,8 @@ typedef enum PHYSFS_ErrorCode
     PHYSFS_ERR_OS_ERROR,         /**< Unspecified OS-level error.           */
     PHYSFS_ERR_DUPLICATE,        /**< Duplicate entry.                      */
     PHYSFS_ERR_BAD_PASSWORD,     /**< Bad password.                         */
-    PHYSFS_ERR_APP_CALLBACK      /**< Application callback reported error.  */
+    PHYSFS_ERR_APP_CALLBACK,     /**< Application callback reported error.  */
+    PHYSFS_ERR_CANCELLED         /**< Request was cancelled before it ran.  */
 } PHYSFS_ErrorCode;
 
 
@@ -3603,7 +3653,8 @@ PHYSFS_DECL const char *PHYSFS_getPrefDir(const char *org, const char *app);
  *
  * Thread safety: PHYSFS_Archiver implementations are not guaranteed to be
  *  thread safe in themselves. PhysicsFS provides thread safety when it calls
- *  into a given archiver inside the library, but it does not promise that
+ *  into a given archiver inside the library (archivers you register are
+ *  called by one thread at a time), but it does not promise that
  *  using the same PHYSFS_File from two threads at once is thread-safe; as
  *  such, your PHYSFS_Archiver can assume that locking is handled for you
  *  so long as the PHYSFS_Io you return from PHYSFS_open* doesn't change any
@@ -3844,6 +3895,1463 @@ PHYSFS_DECL int PHYSFS_deregisterArchiver(const char *ext);
 
 /* Everything above this line is part of the PhysicsFS 2.1 API. */
 
+
+/**
+ * \fn int PHYSFS_indexSearchPath(int enable)
+ * \brief Enable or disable the merged index of the search path.
+ *
+ * By default, every lookup (PHYSFS_openRead(), PHYSFS_stat(),
+ *  PHYSFS_exists(), PHYSFS_getRealDir(), etc) walks the search path in order,
+ *  asking each archive in turn if it has the file in question. This is cheap
+ *  when you have a few things mounted, but if you mount dozens of archives,
+ *  a file that lives in the last one (or doesn't exist at all) has to be
+ *  searched for in every one of them.
+ *
+ * When the index is enabled, PhysicsFS builds a single hash table of every
+ *  path in every mounted archive, noting which archive is the first in the
+ *  search path to provide it, and lookups skip straight to that archive.
+ *  The index is updated as archives are mounted and unmounted.
+ *
+ * Directories on the native filesystem aren't indexed (unless they were
+ *  mounted with PHYSFS_snapshotDirectories() enabled), since their
+ *  contents can change behind PhysicsFS's back; they are always asked
+ *  directly, in their proper position in the search path. Archives are
+ *  assumed to not change while mounted (which PhysicsFS already assumes,
+ *  as it parses most archive formats once at mount time). If you have
+ *  registered your own PHYSFS_Archiver whose contents can change while
+ *  mounted, don't enable this.
+ *
+ * Building the index costs memory and time at mount time proportional to
+ *  the number of files mounted, so this is disabled by default. If the
+ *  index can't be built (out of memory, etc), lookups quietly fall back to
+ *  walking the search path, and an index is attempted again the next time
+ *  the search path changes.
+ *
+ * Calling this with a non-zero value while the index is already enabled
+ *  throws it away and builds it again from scratch, in case you know
+ *  something in the search path changed.
+ *
+ * The index is discarded by PHYSFS_deinit(), and this setting reverts to
+ *  disabled.
+ *
+ *   \param enable non-zero to build and use the index, zero to discard it.
+ *  \return zero on error, non-zero on success. On error, the setting is
+ *          still changed, but the search path will be walked as usual until
+ *          the index can be built. Use PHYSFS_getLastErrorCode() to obtain
+ *          the specific error.
+ *
+ * \sa PHYSFS_searchPathIndexed
+ * \sa PHYSFS_mount
+ */
+PHYSFS_DECL int PHYSFS_indexSearchPath(int enable);
+
+
+/**
+ * \fn int PHYSFS_searchPathIndexed(void)
+ * \brief Determine if the merged index of the search path is enabled.
+ *
+ * This reports the setting from the last call to PHYSFS_indexSearchPath().
+ *  If PHYSFS_indexSearchPath() hasn't been called since the library was
+ *  last initialized, the index is implicitly disabled.
+ *
+ *  \return non-zero if the search path is indexed, zero if not.
+ *
+ * \sa PHYSFS_indexSearchPath
+ */
+PHYSFS_DECL int PHYSFS_searchPathIndexed(void);
+
+
+/**
+ * \fn int PHYSFS_ignoreCase(int enable)
+ * \brief Enable or disable case-insensitive lookups in newly-mounted archives.
+ *
+ * PhysicsFS paths are normally case-sensitive, everywhere. If your data was
+ *  made on a platform where case doesn't matter, its paths might not agree
+ *  with the actual files, which only shows up once you ship to a platform
+ *  where it does. With this enabled, "textures/Grass.PNG" finds
+ *  "Textures/grass.png", just like it would on Windows.
+ *
+ * This affects archives and directories mounted after the call; things that
+ *  are already mounted keep working the way they did when they were
+ *  mounted. You probably want to set it once, before mounting anything.
+ *
+ * In archives, the directory is hashed on case-folded names (the same folding
+ *  PHYSFS_utf8stricmp() uses), so lookups cost the same as they would with
+ *  exact case. In native directories, exact-case paths are tried first, and
+ *  cost nothing extra; if that fails, PhysicsFS lists the directories along
+ *  the path, once, to work out the real case, and remembers what it saw
+ *  until those directories change. This replaces the slower approach in
+ *  extras/ignorecase.c.
+ *
+ * Only paths inside a mount ignore case: mount points must still match
+ *  exactly. Writing is always case-sensitive. Enumerations report names
+ *  with the case they actually have. If an archive has two entries that
+ *  only differ in case, the first one wins.
+ *
+ * This setting reverts to disabled in PHYSFS_deinit().
+ *
+ *   \param enable non-zero to ignore case in later mounts, zero to stop.
+ *  \return zero on error, non-zero on success. Use PHYSFS_getLastErrorCode()
+ *          to obtain the specific error.
+ *
+ * \sa PHYSFS_caseIgnored
+ * \sa PHYSFS_utf8stricmp
+ */
+PHYSFS_DECL int PHYSFS_ignoreCase(int enable);
+
+
+/**
+ * \fn int PHYSFS_caseIgnored(void)
+ * \brief Determine if newly-mounted archives will ignore case.
+ *
+ *  \return non-zero if PHYSFS_ignoreCase() is enabled, zero if not.
+ *
+ * \sa PHYSFS_ignoreCase
+ */
+PHYSFS_DECL int PHYSFS_caseIgnored(void);
+
+
+/**
+ * \typedef PHYSFS_EnumerateStatCallback
+ * \brief Function signature for enumeration callbacks that also get a stat.
+ *
+ * This is PHYSFS_EnumerateCallback, plus a PHYSFS_Stat of the item, as
+ *  PHYSFS_stat() would fill it in.
+ *
+ *    \param data User-defined data pointer, passed through from
+ *                PHYSFS_enumerateWithStat().
+ *    \param origdir The directory being enumerated, as with
+ *                   PHYSFS_EnumerateCallback.
+ *    \param fname The item being enumerated, without the full path.
+ *    \param stat Information about (fname). This is only valid until the
+ *                callback returns; copy anything you want to keep.
+ *   \return A value from PHYSFS_EnumerateCallbackResult.
+ *
+ * \sa PHYSFS_enumerateWithStat
+ */
+typedef PHYSFS_EnumerateCallbackResult (*PHYSFS_EnumerateStatCallback)(
+                                       void *data, const char *origdir,
+                                       const char *fname,
+                                       const PHYSFS_Stat *stat);
+
+/**
+ * \fn int PHYSFS_enumerateWithStat(const char *dir, PHYSFS_EnumerateStatCallback c, void *d)
+ * \brief Enumerate a directory, getting each item's PHYSFS_Stat as well.
+ *
+ * This works like PHYSFS_enumerate(), but the callback gets each item's
+ *  type, size and times too, which saves calling PHYSFS_stat() on every
+ *  name. That matters for big directories: every PHYSFS_stat() call
+ *  sanitizes the path again and searches the whole search path for it,
+ *  while this gets the information from the archive (or directory listing)
+ *  that provided the name in the first place.
+ *
+ * Like PHYSFS_enumerate(), a name provided by more than one mount is
+ *  reported once per mount, each time with the stat from that mount. The
+ *  first report is from the mount that PHYSFS_stat() would use. Parent
+ *  directories of a mount point look like read-only directories with
+ *  unknown times; the mount point itself reports the archive's root.
+ *
+ *    \param dir Directory, in platform-independent notation, to enumerate.
+ *    \param c Callback function to notify about search path elements.
+ *    \param d Application-defined data passed to callback. Can be NULL.
+ *   \return non-zero on success, zero on failure. Use
+ *           PHYSFS_getLastErrorCode() to obtain the specific error. If the
+ *           callback returns PHYSFS_ENUM_STOP to stop early, this will be
+ *           considered success.
+ *
+ * \sa PHYSFS_EnumerateStatCallback
+ * \sa PHYSFS_enumerate
+ * \sa PHYSFS_stat
+ */
+PHYSFS_DECL int PHYSFS_enumerateWithStat(const char *dir,
+                                         PHYSFS_EnumerateStatCallback c,
+                                         void *d);
+
+
+/**
+ * \fn int PHYSFS_mapFile(const char *filename, const void **ptr, PHYSFS_uint64 *len)
+ * \brief Borrow a file's contents straight from memory, without copying.
+ *
+ * If (filename) is stored uncompressed in an archive that PhysicsFS can
+ *  see directly in memory, this hands back a read-only pointer to its bytes,
+ *  so you don't have to allocate a buffer and PHYSFS_readBytes() into it.
+ *  That covers uncompressed, unencrypted entries in .zip files, every entry
+ *  in the simpler formats (.grp, .hog, .mvl, .pak, .slb, .vdf, .wad, .iso),
+ *  and those same archives when mounted with PHYSFS_mountMemory(). Archives
+ *  mounted from disk are memory-mapped when the platform allows it.
+ *
+ * Anything else (compressed entries, files in a native directory, etc)
+ *  fails with PHYSFS_ERR_UNSUPPORTED, and you should read the file the
+ *  usual way instead. The search path is looked through exactly like
+ *  PHYSFS_openRead() does.
+ *
+ * The memory is valid until you pass (ptr) to PHYSFS_unmapFile(), and you
+ *  must not write to it. Like an open file, a borrowed file keeps its
+ *  archive from being unmounted until you give it back. PHYSFS_deinit()
+ *  gives back everything that is still borrowed.
+ *
+ *    \param filename File to borrow, in platform-independent notation.
+ *    \param ptr Filled in with a pointer to the file's contents.
+ *    \param len Filled in with the file's length, in bytes.
+ *   \return non-zero on success, zero on failure. Use
+ *           PHYSFS_getLastErrorCode() to obtain the specific error.
+ *
+ * \sa PHYSFS_unmapFile
+ * \sa PHYSFS_openRead
+ */
+PHYSFS_DECL int PHYSFS_mapFile(const char *filename, const void **ptr,
+                               PHYSFS_uint64 *len);
+
+
+/**
+ * \fn int PHYSFS_unmapFile(const void *ptr)
+ * \brief Give back memory borrowed with PHYSFS_mapFile().
+ *
+ * (ptr) must be exactly what PHYSFS_mapFile() gave you. If you borrowed the
+ *  same file more than once, call this once for each time. Do not touch the
+ *  memory after this returns.
+ *
+ *    \param ptr Pointer obtained from PHYSFS_mapFile().
+ *   \return non-zero on success, zero on failure. Use
+ *           PHYSFS_getLastErrorCode() to obtain the specific error.
+ *
+ * \sa PHYSFS_mapFile
+ */
+PHYSFS_DECL int PHYSFS_unmapFile(const void *ptr);
+
+
+/**
+ * \fn void PHYSFS_setSeekCheckpointInterval(PHYSFS_uint64 interval)
+ * \brief Make seeking in compressed files cheaper by remembering where
+ *        decompression has been.
+ *
+ * Seeking backwards in a deflated .zip entry normally means decompressing
+ *  it again from the very beginning up to the new position, so every seek
+ *  costs time proportional to the file's size. If (interval) is non-zero,
+ *  the decompressor's state is saved every (interval) bytes of output as a
+ *  file is read, and later seeks in that file (from any handle) resume from
+ *  the nearest saved point at or before the target instead.
+ *
+ * Each checkpoint costs about 45 kilobytes of memory, and they are kept
+ *  until the archive is unmounted, so pick an interval that suits how big
+ *  your files are and how far you seek; a few megabytes is typical for
+ *  audio and video. Checkpoints are only recorded for data that has
+ *  actually been decompressed, so the first pass through a file still
+ *  costs what it always did.
+ *
+ * Changing this only affects checkpoints recorded from now on. This is
+ *  disabled by default, and reverts to disabled at PHYSFS_deinit().
+ *
+ *   \param interval bytes of decompressed data between checkpoints, or zero
+ *                   to stop recording them.
+ *
+ * \sa PHYSFS_getSeekCheckpointInterval
+ * \sa PHYSFS_saveSeekCheckpoints
+ * \sa PHYSFS_seek
+ */
+PHYSFS_DECL void PHYSFS_setSeekCheckpointInterval(PHYSFS_uint64 interval);
+
+
+/**
+ * \fn PHYSFS_uint64 PHYSFS_getSeekCheckpointInterval(void)
+ * \brief Determine how often seek checkpoints are recorded.
+ *
+ *  \return the value from the last call to
+ *          PHYSFS_setSeekCheckpointInterval(), or zero if checkpoints
+ *          are disabled.
+ *
+ * \sa PHYSFS_setSeekCheckpointInterval
+ */
+PHYSFS_DECL PHYSFS_uint64 PHYSFS_getSeekCheckpointInterval(void);
+
+
+/**
+ * \fn int PHYSFS_saveSeekCheckpoints(PHYSFS_File *handle, PHYSFS_File *out)
+ * \brief Write out the seek checkpoints recorded for a file.
+ *
+ * This lets you keep the checkpoints described in
+ *  PHYSFS_setSeekCheckpointInterval() alongside an archive, so the next run
+ *  can seek quickly without first decompressing the whole file once. Pass
+ *  the result to PHYSFS_loadSeekCheckpoints() later.
+ *
+ * (handle) is any read handle to the file; its position doesn't matter and
+ *  isn't changed. The checkpoints are written to (out) from its current
+ *  position. The data is portable between platforms, but not between
+ *  versions of PhysicsFS that write a different format.
+ *
+ * Only deflated .zip entries have checkpoints; other files fail with
+ *  PHYSFS_ERR_UNSUPPORTED. Saving a file with no checkpoints yet succeeds
+ *  and writes a short record that loads as nothing.
+ *
+ *    \param handle a file opened with PHYSFS_openRead().
+ *    \param out a file opened with PHYSFS_openWrite() or PHYSFS_openAppend().
+ *   \return non-zero on success, zero on failure. Use
+ *           PHYSFS_getLastErrorCode() to obtain the specific error.
+ *
+ * \sa PHYSFS_loadSeekCheckpoints
+ * \sa PHYSFS_setSeekCheckpointInterval
+ */
+PHYSFS_DECL int PHYSFS_saveSeekCheckpoints(PHYSFS_File *handle,
+                                           PHYSFS_File *out);
+
+
+/**
+ * \fn int PHYSFS_loadSeekCheckpoints(PHYSFS_File *handle, PHYSFS_File *in)
+ * \brief Read back seek checkpoints written by PHYSFS_saveSeekCheckpoints().
+ *
+ * The checkpoints are read from (in) at its current position and become
+ *  available to every handle of the same file, until its archive is
+ *  unmounted. This works even if PHYSFS_setSeekCheckpointInterval() is
+ *  disabled. Checkpoints already recorded for the file are kept, and only
+ *  loaded ones past the last of those are added.
+ *
+ * Data that was saved for a different file, a different version of the
+ *  archive, or in a different format is rejected with PHYSFS_ERR_CORRUPT,
+ *  and nothing is loaded. So is data that's damaged: every saved decoder
+ *  state is checked before it's used, so a bad file can't hurt later reads.
+ *
+ *    \param handle a file opened with PHYSFS_openRead().
+ *    \param in a file opened with PHYSFS_openRead().
+ *   \return non-zero on success, zero on failure. Use
+ *           PHYSFS_getLastErrorCode() to obtain the specific error.
+ *
+ * \sa PHYSFS_saveSeekCheckpoints
+ */
+PHYSFS_DECL int PHYSFS_loadSeekCheckpoints(PHYSFS_File *handle,
+                                           PHYSFS_File *in);
+
+
+/**
+ * \struct PHYSFS_ReadRequest
+ * \brief One file for PHYSFS_readFilesBatch() to read.
+ *
+ * Fill in (filename), (buffer) and (len); PHYSFS_readFilesBatch() fills in
+ *  the rest.
+ *
+ * \sa PHYSFS_readFilesBatch
+ */
+typedef struct PHYSFS_ReadRequest
+{
+    const char *filename;  /**< File to read, platform-independent notation. */
+    void *buffer;  /**< Where to put the file's contents. */
+    PHYSFS_uint64 len;  /**< Size of (buffer), in bytes. */
+    PHYSFS_sint64 result;  /**< Bytes read, or -1 on failure. */
+    PHYSFS_ErrorCode error;  /**< Why it failed, or PHYSFS_ERR_OK. */
+} PHYSFS_ReadRequest;
+
+
+/**
+ * \fn int PHYSFS_readFilesBatch(PHYSFS_ReadRequest *reqs, PHYSFS_uint32 count, PHYSFS_uint32 threads)
+ * \brief Read lots of whole files at once, decompressing them in parallel.
+ *
+ * This does the same thing as opening each file in (reqs) with
+ *  PHYSFS_openRead(), reading up to (len) bytes from the start of it into
+ *  (buffer), and closing it, but it's faster when many of the files are
+ *  compressed entries in the same .zip archive, like when loading a level.
+ *
+ * The files are visited in the order their data appears in each archive,
+ *  so the archive is read in one forward sweep instead of seeking around,
+ *  and the compressed data is pulled into memory. Decompressing it, which
+ *  is usually the slow part, is then spread across (threads) threads,
+ *  including the calling thread, so passing 1 (or 0) does everything on
+ *  the calling thread. Files that aren't compressed are just read during
+ *  the sweep. If the platform can't start threads, everything is done on
+ *  the calling thread and you get the same results, just slower. Loose
+ *  files in mounted directories are read all at once where the platform
+ *  allows it (io_uring on Linux, overlapped i/o on Windows), so a fast
+ *  drive gets to work on many of them at the same time.
+ *
+ * Each request gets its own (result) and (error), and one failing doesn't
+ *  stop the others. A file bigger than its buffer is not an error; you get
+ *  its first (len) bytes, so you can check (result) against the file's
+ *  length if that matters.
+ *
+ * All the compressed data for up to a few hundred files at a time is held
+ *  in memory while this runs, so don't use it on huge files; read those
+ *  normally.
+ *
+ *    \param reqs array of (count) requests.
+ *    \param count number of requests in (reqs).
+ *    \param threads number of threads to decompress with, at most.
+ *   \return non-zero if every request succeeded, zero if any failed. Use
+ *           PHYSFS_getLastErrorCode() to obtain the first failure's error,
+ *           and look at each request for the details.
+ *
+ * \sa PHYSFS_ReadRequest
+ * \sa PHYSFS_openRead
+ */
+PHYSFS_DECL int PHYSFS_readFilesBatch(PHYSFS_ReadRequest *reqs,
+                                      PHYSFS_uint32 count,
+                                      PHYSFS_uint32 threads);
+
+
+/**
+ * \typedef PHYSFS_AsyncRequest
+ * \brief A read started by PHYSFS_readAsync().
+ *
+ * This is an opaque handle; you only ever use pointers to it, and it stays
+ *  valid until you pass it to PHYSFS_waitAsync().
+ *
+ * \sa PHYSFS_readAsync
+ */
+typedef struct PHYSFS_AsyncRequest PHYSFS_AsyncRequest;
+
+
+/**
+ * \typedef PHYSFS_AsyncCallback
+ * \brief Function signature for async read completion callbacks.
+ *
+ * (data) is what you passed to PHYSFS_readAsync(). (result) is the number
+ *  of bytes read, or -1 on failure, in which case (error) says why. A
+ *  request that was cancelled before it ran reports PHYSFS_ERR_CANCELLED.
+ *
+ * This is called exactly once per request, usually from one of PhysicsFS's
+ *  internal threads, so keep it short and make it thread safe. Don't call
+ *  PHYSFS_waitAsync() on the same request from inside it.
+ *
+ * \sa PHYSFS_readAsync
+ */
+typedef void (*PHYSFS_AsyncCallback)(void *data, PHYSFS_sint64 result,
+                                     PHYSFS_ErrorCode error);
+
+
+/**
+ * \fn PHYSFS_AsyncRequest *PHYSFS_readAsync(const char *filename, PHYSFS_uint64 offset, void *buffer, PHYSFS_uint64 len, PHYSFS_AsyncCallback callback, void *data)
+ * \brief Read from a file without blocking the calling thread.
+ *
+ * This queues up the equivalent of PHYSFS_openRead(), PHYSFS_seek() to
+ *  (offset), PHYSFS_readBytes() of up to (len) bytes into (buffer), and
+ *  PHYSFS_close(), and returns right away. The work is done by a small pool
+ *  of threads that PhysicsFS starts the first time you call this.
+ *
+ * Queued reads against the same archive are serviced in the order their
+ *  data appears in that archive rather than the order you asked for them,
+ *  so sprinkling lots of small requests at once costs less seeking than
+ *  doing them one at a time. Don't count on them finishing in any
+ *  particular order.
+ *
+ * When the read is done, (callback) is called if it isn't NULL. You can
+ *  also check on it with PHYSFS_pollAsync(), and you must eventually call
+ *  PHYSFS_waitAsync() on every request you start, to get its result and
+ *  let PhysicsFS free it. Don't touch (buffer) until the request is done.
+ *
+ * If the platform can't start threads, the read happens right here before
+ *  this function returns, and everything else works the same.
+ *
+ * PHYSFS_deinit() cancels whatever hasn't started yet and waits for
+ *  whatever has, then frees every request, waited for or not.
+ *
+ *    \param filename File to read from, in platform-independent notation.
+ *    \param offset Where in the file to start reading.
+ *    \param buffer Where to put the data.
+ *    \param len Most bytes to read into (buffer).
+ *    \param callback Function to call when done, or NULL.
+ *    \param data Passed through to (callback) unexamined.
+ *   \return a handle for the request, or NULL if it couldn't be queued.
+ *            Problems with the file itself (not found, etc) are reported
+ *            when the request finishes, not here. Use
+ *            PHYSFS_getLastErrorCode() to obtain the specific error.
+ *
+ * \sa PHYSFS_pollAsync
+ * \sa PHYSFS_waitAsync
+ * \sa PHYSFS_cancelAsync
+ */
+PHYSFS_DECL PHYSFS_AsyncRequest *PHYSFS_readAsync(const char *filename,
+                                                  PHYSFS_uint64 offset,
+                                                  void *buffer,
+                                                  PHYSFS_uint64 len,
+                                                  PHYSFS_AsyncCallback callback,
+                                                  void *data);
+
+
+/**
+ * \fn int PHYSFS_pollAsync(PHYSFS_AsyncRequest *req)
+ * \brief Check if an async read is done, without blocking.
+ *
+ * Once this returns non-zero, (req)'s callback has returned and
+ *  PHYSFS_waitAsync() won't block.
+ *
+ *    \param req A request from PHYSFS_readAsync().
+ *   \return non-zero if the request is done, zero if it's still going.
+ *
+ * \sa PHYSFS_waitAsync
+ */
+PHYSFS_DECL int PHYSFS_pollAsync(PHYSFS_AsyncRequest *req);
+
+
+/**
+ * \fn PHYSFS_sint64 PHYSFS_waitAsync(PHYSFS_AsyncRequest *req)
+ * \brief Wait for an async read to finish, and free it.
+ *
+ * This blocks until (req) is done, then returns the same result its
+ *  callback got. (req) is freed, so don't use it again.
+ *
+ *    \param req A request from PHYSFS_readAsync().
+ *   \return number of bytes read, or -1 if the request failed or was
+ *            cancelled. Use PHYSFS_getLastErrorCode() to obtain the
+ *            specific error.
+ *
+ * \sa PHYSFS_pollAsync
+ */
+PHYSFS_DECL PHYSFS_sint64 PHYSFS_waitAsync(PHYSFS_AsyncRequest *req);
+
+
+/**
+ * \fn int PHYSFS_cancelAsync(PHYSFS_AsyncRequest *req)
+ * \brief Try to stop an async read before it runs.
+ *
+ * If (req) hasn't started reading yet, it won't; its callback is called
+ *  right away, from this thread, with PHYSFS_ERR_CANCELLED. If it's
+ *  already reading or done, this does nothing and it finishes as usual.
+ *  Either way, you still have to call PHYSFS_waitAsync() on it.
+ *
+ *    \param req A request from PHYSFS_readAsync().
+ *   \return non-zero if the request was cancelled, zero if it was too late.
+ *
+ * \sa PHYSFS_readAsync
+ */
+PHYSFS_DECL int PHYSFS_cancelAsync(PHYSFS_AsyncRequest *req);
+
+
+/**
+ * \fn int PHYSFS_setIndexCacheDir(const char *dir)
+ * \brief Keep archive directories on disk, so mounting is faster next time.
+ *
+ * Mounting a big archive means reading and sorting out its whole directory,
+ *  which can take a while when there are many thousands of files in it. If
+ *  you set an index cache directory, PhysicsFS saves what it learned there,
+ *  one file per archive, and the next mount of the same archive just loads
+ *  that file in one read instead.
+ *
+ * A cached index is only used if the archive is still the same size and has
+ *  the same modification time as when it was cached, and its own directory
+ *  still looks the same; otherwise, the archive is read the slow way and the
+ *  cache is rewritten. Cache files are only good for the build of PhysicsFS
+ *  that wrote them, which will notice and ignore files from other builds.
+ *
+ * This only applies to archives mounted from real files on disk, and only to
+ *  formats that support it (currently ZIP, ISO9660 and VDF). Failing to read
+ *  or write the cache is never an error; it just means a slower mount.
+ *
+ * (dir) is in platform-dependent notation, and must already exist; you might
+ *  want to use a subdirectory of PHYSFS_getPrefDir(). PhysicsFS keeps its own
+ *  copy of the string. Nothing is cached by default.
+ *
+ *    \param dir The directory to keep index files in, NULL to stop caching.
+ *   \return non-zero on success, zero on failure. Use
+ *           PHYSFS_getLastErrorCode() to obtain the specific error.
+ *
+ * \sa PHYSFS_getIndexCacheDir
+ * \sa PHYSFS_mount
+ */
+PHYSFS_DECL int PHYSFS_setIndexCacheDir(const char *dir);
+
+
+/**
+ * \fn const char *PHYSFS_getIndexCacheDir(void)
+ * \brief Get the current index cache directory.
+ *
+ *   \return The directory set with PHYSFS_setIndexCacheDir(), or NULL if
+ *           archive indexes aren't being cached.
+ *
+ * \sa PHYSFS_setIndexCacheDir
+ */
+PHYSFS_DECL const char *PHYSFS_getIndexCacheDir(void);
+
+
+/**
+ * \fn void PHYSFS_setReadAhead(PHYSFS_uint64 maxWindow)
+ * \brief Buffer sequential reads automatically.
+ *
+ * If (maxWindow) is non-zero, every file opened for reading watches how
+ *  it's used. Once a handle does a few small reads in a row without
+ *  seeking, it gets a read buffer, as if PHYSFS_setBuffer() had been called
+ *  on it, which starts small and doubles each time it's used up, up to
+ *  (maxWindow) bytes. So code that parses a file a few bytes at a time gets
+ *  buffered throughput without anyone tuning buffer sizes per call site.
+ *
+ * Where the data can be read at any offset without disturbing the handle
+ *  (files in native directories, and uncompressed entries in most archives
+ *  that aren't already in memory), the next window is also read in the
+ *  background, on the threads behind PHYSFS_readAsync(), while you work
+ *  through the current one.
+ *
+ * Seeking outside of the buffered data is taken as a sign the file isn't
+ *  being read sequentially after all, so the buffer is dropped again until
+ *  the next run of small reads. Reads as big as the current window skip
+ *  the buffer. Files that are already in memory (a mapped archive, or
+ *  PHYSFS_mountMemory()) are never buffered, as it would only add a copy.
+ *
+ * This is disabled by default, and reverts to disabled at PHYSFS_deinit().
+ *  Changing it doesn't affect handles that are already buffering.
+ *
+ *   \param maxWindow largest read-ahead buffer per handle, in bytes, or
+ *                    zero to disable automatic buffering. A few hundred
+ *                    kilobytes is plenty for most uses.
+ *
+ * \sa PHYSFS_getReadAhead
+ * \sa PHYSFS_setBuffer
+ */
+PHYSFS_DECL void PHYSFS_setReadAhead(PHYSFS_uint64 maxWindow);
+
+
+/**
+ * \fn PHYSFS_uint64 PHYSFS_getReadAhead(void)
+ * \brief Determine the limit on automatic read-ahead buffers.
+ *
+ *  \return the value from the last call to PHYSFS_setReadAhead(), or zero
+ *          if automatic buffering is disabled.
+ *
+ * \sa PHYSFS_setReadAhead
+ */
+PHYSFS_DECL PHYSFS_uint64 PHYSFS_getReadAhead(void);
+
+
+/**
+ * \struct PHYSFS_BlockCacheStats
+ * \brief What the decompressed block cache has been doing.
+ *
+ * Counts are since PHYSFS_init().
+ *
+ * \sa PHYSFS_getBlockCacheStats
+ * \sa PHYSFS_setBlockCacheBudget
+ */
+typedef struct PHYSFS_BlockCacheStats
+{
+    PHYSFS_uint64 hits;      /**< times a handle found decoded data cached. */
+    PHYSFS_uint64 misses;    /**< times a handle had to decode it itself. */
+    PHYSFS_uint64 evictions; /**< blocks dropped to stay within budget. */
+    PHYSFS_uint64 blocks;    /**< blocks cached right now. */
+    PHYSFS_uint64 bytes;     /**< bytes of decoded data cached right now. */
+} PHYSFS_BlockCacheStats;
+
+
+/**
+ * \fn void PHYSFS_setBlockCacheBudget(PHYSFS_uint64 budget)
+ * \brief Limit how much decompressed data is kept for sharing.
+ *
+ * Compressed data is decoded in blocks, and those blocks are kept in one
+ *  cache shared by every file handle and every archive, so two handles
+ *  reading the same compressed file (or, in a solid .7z archive, files
+ *  packed together) only pay to decompress it once. When the cache grows
+ *  past (budget) bytes, the least recently used blocks are dropped. Handles
+ *  that are reading from a dropped block keep it until they move on, so
+ *  this is a target, not a hard limit on memory use.
+ *
+ * Deflated .zip entries are cached in 64 kilobyte blocks. A .7z archive's
+ *  solid blocks are cached whole, which can be much bigger; a block larger
+ *  than the budget isn't cached at all.
+ *
+ * Setting a smaller budget drops blocks right away. Zero turns the cache
+ *  off. The default is 64 megabytes, and it reverts to that at
+ *  PHYSFS_deinit(). This can be called before PHYSFS_init().
+ *
+ *   \param budget bytes of decompressed data to keep, or zero to keep none.
+ *
+ * \sa PHYSFS_getBlockCacheBudget
+ * \sa PHYSFS_getBlockCacheStats
+ */
+PHYSFS_DECL void PHYSFS_setBlockCacheBudget(PHYSFS_uint64 budget);
+
+
+/**
+ * \fn PHYSFS_uint64 PHYSFS_getBlockCacheBudget(void)
+ * \brief Determine how much decompressed data may be kept for sharing.
+ *
+ *  \return the value from the last call to PHYSFS_setBlockCacheBudget(),
+ *          or the default if it hasn't been called.
+ *
+ * \sa PHYSFS_setBlockCacheBudget
+ */
+PHYSFS_DECL PHYSFS_uint64 PHYSFS_getBlockCacheBudget(void);
+
+
+/**
+ * \fn void PHYSFS_getBlockCacheStats(PHYSFS_BlockCacheStats *stats)
+ * \brief See how well the decompressed block cache is working.
+ *
+ * Fills in (stats) with hit and miss counts and current usage. If
+ *  PhysicsFS isn't initialized, everything is zero.
+ *
+ *   \param stats structure to fill in.
+ *
+ * \sa PHYSFS_setBlockCacheBudget
+ */
+PHYSFS_DECL void PHYSFS_getBlockCacheStats(PHYSFS_BlockCacheStats *stats);
+
+
+/**
+ * \struct PHYSFS_Stats
+ * \brief Where PhysicsFS has been spending its time.
+ *
+ * Counts are since PHYSFS_init() or the last PHYSFS_resetStats(). They're
+ *  updated as things happen, from whatever thread does them, so a snapshot
+ *  taken while other threads are busy might be a little out of step with
+ *  itself.
+ *
+ * \sa PHYSFS_getStats
+ * \sa PHYSFS_getArchiveStats
+ */
+typedef struct PHYSFS_Stats
+{
+    PHYSFS_uint64 opens;         /**< files opened, for reading or writing. */
+    PHYSFS_uint64 openMisses;    /**< archives asked for a file to open that
+                                       didn't have it. */
+    PHYSFS_uint64 reads;         /**< calls to PHYSFS_readBytes(). */
+    PHYSFS_uint64 bytesRead;     /**< bytes those calls returned. */
+    PHYSFS_uint64 bufferRefills; /**< times a file's buffer (yours, or
+                                       PHYSFS_setReadAhead()'s) filled up. */
+    PHYSFS_uint64 bytesInflated; /**< bytes archivers decompressed. */
+    PHYSFS_uint64 lockWaits;     /**< times a thread had to wait for
+                                       another to finish with global state. */
+    PHYSFS_uint64 lockWaitNanoseconds; /**< time spent in those waits. */
+    PHYSFS_uint64 treeLookups;   /**< name lookups in archive indexes and the
+                                       search path index. */
+    PHYSFS_uint64 treeProbes;    /**< entries those lookups compared. A lot
+                                       more of these than lookups means hash
+                                       collisions. */
+} PHYSFS_Stats;
+
+
+/**
+ * \fn int PHYSFS_getStats(PHYSFS_Stats *stats)
+ * \brief Get PhysicsFS's performance counters.
+ *
+ * These cost at most a few atomic adds per call being counted. They can be
+ *  compiled out entirely (see PHYSFS_STATS in CMakeLists.txt), in which case
+ *  this fails.
+ *
+ *   \param stats structure to fill in.
+ *  \return non-zero on success, zero if this build doesn't keep stats, or
+ *          PhysicsFS isn't initialized. Specifics of the error can be
+ *          gleaned from PHYSFS_getLastError(). (stats) is zeroed on failure.
+ *
+ * \sa PHYSFS_resetStats
+ * \sa PHYSFS_getArchiveStats
+ * \sa PHYSFS_getBlockCacheStats
+ */
+PHYSFS_DECL int PHYSFS_getStats(PHYSFS_Stats *stats);
+
+
+/**
+ * \fn void PHYSFS_resetStats(void)
+ * \brief Zero the counters PHYSFS_getStats() reports.
+ *
+ * Handy for measuring one level load, or one frame. Per-archive counters
+ *  are left alone; they go away with their archive.
+ *
+ * \sa PHYSFS_getStats
+ */
+PHYSFS_DECL void PHYSFS_resetStats(void);
+
+
+/**
+ * \struct PHYSFS_ArchiveStats
+ * \brief What one mounted archive has been asked to do.
+ *
+ * Counts are since the archive was mounted.
+ *
+ * \sa PHYSFS_getArchiveStats
+ */
+typedef struct PHYSFS_ArchiveStats
+{
+    PHYSFS_uint64 lookups;   /**< times it was asked for a file to open. */
+    PHYSFS_uint64 misses;    /**< ...and didn't have it. */
+    PHYSFS_uint64 opens;     /**< files it opened. */
+    PHYSFS_uint64 bytesRead; /**< bytes read from those files. */
+} PHYSFS_ArchiveStats;
+
+
+/**
+ * \fn int PHYSFS_getArchiveStats(const char *dir, PHYSFS_ArchiveStats *stats)
+ * \brief Get the performance counters for one mounted archive.
+ *
+ * An archive with a lot of misses is one that files are usually found in
+ *  further along the search path; mounting it later (or giving it a mount
+ *  point) saves looking.
+ *
+ *   \param dir the archive, as it was passed to PHYSFS_mount().
+ *   \param stats structure to fill in.
+ *  \return non-zero on success, zero if this build doesn't keep stats, or
+ *          (dir) isn't mounted. Specifics of the error can be gleaned from
+ *          PHYSFS_getLastError(). (stats) is zeroed on failure.
+ *
+ * \sa PHYSFS_getStats
+ */
+PHYSFS_DECL int PHYSFS_getArchiveStats(const char *dir,
+                                       PHYSFS_ArchiveStats *stats);
+
+
+/**
+ * \enum PHYSFS_TraceType
+ * \brief What a PHYSFS_TraceEvent is about.
+ *
+ * \sa PHYSFS_TraceEvent
+ */
+typedef enum PHYSFS_TraceType
+{
+    PHYSFS_TRACE_OPEN,  /**< PHYSFS_openRead(), openWrite() or openAppend(). */
+    PHYSFS_TRACE_READ,  /**< PHYSFS_readBytes(), or the older read calls. */
+    PHYSFS_TRACE_SEEK,  /**< PHYSFS_seek(). */
+    PHYSFS_TRACE_CLOSE  /**< PHYSFS_close(). */
+} PHYSFS_TraceType;
+
+
+/**
+ * \struct PHYSFS_TraceEvent
+ * \brief One traced call, as passed to a PHYSFS_TraceCallback.
+ *
+ * Nothing in here is valid after the callback returns; copy what you need.
+ *
+ * \sa PHYSFS_setTraceCallback
+ */
+typedef struct PHYSFS_TraceEvent
+{
+    PHYSFS_TraceType type;   /**< which call this was. */
+    PHYSFS_uint64 timestamp; /**< when it started, in nanoseconds since some
+                                   arbitrary point that doesn't change while
+                                   the program runs. */
+    PHYSFS_uint64 duration;  /**< how long it took, in nanoseconds. */
+    PHYSFS_File *file;       /**< the handle, or NULL if an open failed.
+                                   Don't use it in a close event; it's gone. */
+    const char *filename;    /**< for opens, the name asked for; else NULL. */
+    const char *archive;     /**< the archive serving (file), as it was passed
+                                   to PHYSFS_mount() (or the write dir), or
+                                   NULL if an open failed. */
+    PHYSFS_uint64 offset;    /**< for reads, the file position they started
+                                   at; for seeks, the position asked for;
+                                   zero otherwise. */
+    PHYSFS_sint64 result;    /**< for reads, what PHYSFS_readBytes()
+                                   returned; else non-zero on success. */
+} PHYSFS_TraceEvent;
+
+
+/**
+ * \typedef PHYSFS_TraceCallback
+ * \brief Function signature for callbacks that receive trace events.
+ *
+ *   \param data what was passed to PHYSFS_setTraceCallback().
+ *   \param event what happened. Only valid until the callback returns.
+ *
+ * \sa PHYSFS_setTraceCallback
+ */
+typedef void (*PHYSFS_TraceCallback)(void *data,
+                                     const PHYSFS_TraceEvent *event);
+
+
+/**
+ * \fn int PHYSFS_setTraceCallback(PHYSFS_TraceCallback cb, void *data)
+ * \brief Get told about every open, read, seek and close.
+ *
+ * (cb) is called once the call being traced is done, on whatever thread
+ *  made it, with the time it started and how long it took: enough to put
+ *  file i/o on a frame profiler's timeline next to everything else. It
+ *  shouldn't call back into PhysicsFS.
+ *
+ * With no callback set, tracing costs a pointer check per call. Set this
+ *  while no other thread is using PhysicsFS. It's cleared by PHYSFS_deinit().
+ *
+ *   \param cb function to call for each event, or NULL to stop tracing.
+ *   \param data passed through to (cb) untouched.
+ *  \return non-zero on success, zero if this build doesn't keep stats (see
+ *          PHYSFS_getStats()). Specifics of the error can be gleaned from
+ *          PHYSFS_getLastError().
+ *
+ * \sa PHYSFS_TraceEvent
+ */
+PHYSFS_DECL int PHYSFS_setTraceCallback(PHYSFS_TraceCallback cb, void *data);
+
+
+/**
+ * \fn int PHYSFS_setMissCacheSize(PHYSFS_uint32 entries)
+ * \brief Remember paths that don't exist, so asking again is cheap.
+ *
+ * Looking for a file that isn't there is the most expensive lookup there
+ *  is: every archive in the search path has to be asked, and every native
+ *  directory in it costs a real stat() call. Code that probes for optional
+ *  files ("does foo.dds exist? foo.png? foo.tga?") does this constantly.
+ *
+ * With this enabled, PhysicsFS keeps a table of up to (entries) paths that
+ *  PHYSFS_exists(), PHYSFS_stat(), PHYSFS_getRealDir(), etc, recently
+ *  failed to find, and fails further lookups of the same paths right away
+ *  with PHYSFS_ERR_NOT_FOUND, without touching the search path.
+ *  PHYSFS_openRead() also uses the table, but doesn't add to it. When the
+ *  table is full, new paths push out older ones.
+ *
+ * The whole table is forgotten when anything is mounted or unmounted, when
+ *  anything is written through PhysicsFS (PHYSFS_openWrite(),
+ *  PHYSFS_openAppend(), PHYSFS_mkdir()), and when PHYSFS_permitSymbolicLinks()
+ *  is called. Changes made to native directories behind PhysicsFS's back
+ *  are NOT noticed, though: if another program (or your own code, not
+ *  going through PhysicsFS) creates a file in a mounted directory, lookups
+ *  can keep reporting it missing until one of the above happens. Don't
+ *  enable this if that matters to you, or call this again, which empties
+ *  the table.
+ *
+ * This is disabled by default, and reverts to disabled at PHYSFS_deinit().
+ *
+ *   \param entries the most paths to remember, rounded up to a power of
+ *                  two, or zero to disable the cache and free it.
+ *  \return non-zero on success, zero on error (out of memory, or not
+ *          initialized). On error, the previous setting is left alone.
+ *          Use PHYSFS_getLastErrorCode() to obtain the specific error.
+ *
+ * \sa PHYSFS_getMissCacheSize
+ * \sa PHYSFS_indexSearchPath
+ */
+PHYSFS_DECL int PHYSFS_setMissCacheSize(PHYSFS_uint32 entries);
+
+
+/**
+ * \fn PHYSFS_uint32 PHYSFS_getMissCacheSize(void)
+ * \brief Determine the size of the table of missing paths.
+ *
+ *  \return the number of entries in the table, which may have been rounded
+ *          up from the last call to PHYSFS_setMissCacheSize(), or zero if
+ *          missing paths aren't being cached.
+ *
+ * \sa PHYSFS_setMissCacheSize
+ */
+PHYSFS_DECL PHYSFS_uint32 PHYSFS_getMissCacheSize(void);
+
+
+/**
+ * \fn int PHYSFS_snapshotDirectories(int enable)
+ * \brief Serve lookups in newly-mounted directories from memory.
+ *
+ * Normally, every lookup, stat and enumeration in a directory on the native
+ *  filesystem goes to the OS, so that PhysicsFS sees any changes made to it
+ *  while it's mounted. If you mount loose trees of hundreds of thousands of
+ *  files (a development build's assets, say), those system calls add up.
+ *
+ * While this is enabled, each directory mounted for reading is listed in
+ *  full when it is mounted, and the names and stats of everything in it
+ *  are kept in memory. After that, PHYSFS_exists(), PHYSFS_stat(),
+ *  PHYSFS_enumerate(), etc, never touch the disk for that directory, and
+ *  PHYSFS_openRead() only does to open the file itself. Snapshotted
+ *  directories can also be part of the search path index (see
+ *  PHYSFS_indexSearchPath()), like archives.
+ *
+ * The catch is that, just like an archive, a snapshot doesn't change:
+ *  files added, removed or changed after the mount (even through the write
+ *  directory) don't show up until the directory is unmounted and mounted
+ *  again, unless you use PHYSFS_watch(), which updates snapshots as the
+ *  changes are noticed. Symbolic links are recorded as such, but not
+ *  followed; if any point to directories, paths that the snapshot doesn't
+ *  have are looked up on disk as usual, and the directory isn't indexed.
+ *
+ * Mounting takes longer and uses memory in proportion to the size of the
+ *  tree, and fails if any of it can't be listed. This setting is only
+ *  checked when a directory is mounted; it doesn't affect the write
+ *  directory, or directories that are already mounted. It is disabled by
+ *  default, and reverts to disabled at PHYSFS_deinit().
+ *
+ *   \param enable non-zero to snapshot later mounts, zero to not.
+ *  \return zero if not initialized, non-zero otherwise.
+ *
+ * \sa PHYSFS_directoriesSnapshotted
+ * \sa PHYSFS_mount
+ */
+PHYSFS_DECL int PHYSFS_snapshotDirectories(int enable);
+
+
+/**
+ * \fn int PHYSFS_directoriesSnapshotted(void)
+ * \brief Determine if newly-mounted directories will be snapshotted.
+ *
+ *  \return non-zero if the last call to PHYSFS_snapshotDirectories()
+ *          enabled it, zero if not, or if it hasn't been called since the
+ *          library was initialized.
+ *
+ * \sa PHYSFS_snapshotDirectories
+ */
+PHYSFS_DECL int PHYSFS_directoriesSnapshotted(void);
+
+
+/**
+ * \typedef PHYSFS_WatchCallback
+ * \brief Function signature for callbacks that report filesystem changes.
+ *
+ * These are used to report changes noticed by PHYSFS_pollWatch(). See
+ *  PHYSFS_watch() for details.
+ *
+ *    \param data User-defined data pointer, passed through from the API
+ *                that eventually called the callback.
+ *    \param dir The platform-dependent name of the directory the change was
+ *               in (a dir in the search path, or the write dir), as
+ *               PHYSFS_getSearchPath() or PHYSFS_getWriteDir() report it.
+ *    \param path The path that changed, in platform-independent notation.
+ *                For a dir in the search path, this is where PhysicsFS
+ *                sees it (so it includes the mount point); for the write
+ *                dir, it's relative to the write dir. "" (or just the mount
+ *                point) means so much changed that the platform gave up
+ *                keeping track, and anything in (dir) could be different.
+ *
+ * \sa PHYSFS_watch
+ * \sa PHYSFS_pollWatch
+ */
+typedef void (*PHYSFS_WatchCallback)(void *data, const char *dir,
+                                     const char *path);
+
+
+/**
+ * \fn int PHYSFS_watch(PHYSFS_WatchCallback cb, void *data)
+ * \brief Notice changes made to mounted directories while they're mounted.
+ *
+ * Once this is called with a non-NULL (cb), PhysicsFS asks the OS to report
+ *  changes to every directory on the native filesystem that is in the search
+ *  path, or is the write dir, including any mounted later (archives are
+ *  never watched). Nothing is reported until you call PHYSFS_pollWatch(),
+ *  which calls (cb) once for each file or directory that was created,
+ *  deleted, changed or renamed since the last poll.
+ *
+ * This is meant for reloading assets while a game runs: edit a file, and
+ *  the game notices and loads it again. It also keeps PhysicsFS's own idea
+ *  of those directories current without starting over: snapshots (see
+ *  PHYSFS_snapshotDirectories()) are patched with just the paths that
+ *  changed, the search path index (see PHYSFS_indexSearchPath()) is updated
+ *  to match, and only those paths are forgotten by the table of missing
+ *  paths (see PHYSFS_setMissCacheSize()). If directories were created or
+ *  deleted, the index is rebuilt, and the table of missing paths is thrown
+ *  out.
+ *
+ * The OS may report a change more than once, or report a change that wasn't
+ *  really one (a file that was written with exactly what it had before). If
+ *  too much happens between polls, the OS might only be able to say that
+ *  something changed in a directory; see PHYSFS_WatchCallback.
+ *
+ * This is implemented for Linux (inotify), Windows (ReadDirectoryChangesW)
+ *  and Mac OS X (FSEvents). Elsewhere, it fails with PHYSFS_ERR_UNSUPPORTED.
+ *  It also fails if a directory that is already mounted can't be watched,
+ *  in which case nothing is watched. If a directory mounted later can't be
+ *  watched, the mount still works; it just isn't watched. Call this with a
+ *  NULL (cb) to stop watching everything. This reverts to not watching at
+ *  PHYSFS_deinit().
+ *
+ *   \param cb Callback function to notify about changes.
+ *   \param data Application-defined data passed to callback. Can be NULL.
+ *  \return non-zero on success, zero on error. Use
+ *          PHYSFS_getLastErrorCode() to obtain the specific error.
+ *
+ * \sa PHYSFS_WatchCallback
+ * \sa PHYSFS_pollWatch
+ */
+PHYSFS_DECL int PHYSFS_watch(PHYSFS_WatchCallback cb, void *data);
+
+
+/**
+ * \fn int PHYSFS_pollWatch(void)
+ * \brief Report changes noticed since the last poll.
+ *
+ * This calls the callback given to PHYSFS_watch() for each change the OS
+ *  reported since the last call, without waiting for more, after bringing
+ *  PhysicsFS's own view of the changed directories up to date. Call it once
+ *  a frame, or whenever is convenient; the changes wait in the OS until you
+ *  do (and the OS might drop them if you wait too long).
+ *
+ * No PhysicsFS locks are held while the callback runs, so it can open and
+ *  read the files that changed.
+ *
+ *  \return the number of changes reported, or -1 on error. On error, the
+ *          changes noticed before the error are still reported. Use
+ *          PHYSFS_getLastErrorCode() to obtain the specific error.
+ *
+ * \sa PHYSFS_watch
+ */
+PHYSFS_DECL int PHYSFS_pollWatch(void);
+
+
+/**
+ * \enum PHYSFS_PreloadFlags
+ * \brief Flags for PHYSFS_preload().
+ *
+ * \sa PHYSFS_preload
+ */
+typedef enum PHYSFS_PreloadFlags
+{
+    PHYSFS_PRELOAD_PIN = (1 << 0)  /**< keep it until PHYSFS_unpreload(), no
+                                        matter the budget. */
+} PHYSFS_PreloadFlags;
+
+
+/**
+ * \fn int PHYSFS_preload(const char *path, PHYSFS_uint32 flags)
+ * \brief Load files into memory, so opening them later is instant.
+ *
+ * This reads every file at or under (path), as the search path sees it,
+ *  into memory, decompressing them as it goes. After that, PHYSFS_openRead()
+ *  on one of them doesn't touch the archive, the disk or the decompressor at
+ *  all; the handle reads straight from the copy in memory. This is meant for
+ *  things that must never stall, like UI art, sound banks and shaders.
+ *
+ * (path) can name a file, a directory, a mount point, or "" for the whole
+ *  search path. Files are read the way PHYSFS_readFilesBatch() reads them:
+ *  in the order they're stored in each archive, so each archive is read in
+ *  one forward sweep, with the decompressing spread over a few threads.
+ *  Symbolic links aren't followed, and files that are already preloaded
+ *  aren't read again.
+ *
+ * Preloaded files are keyed by the paths they were found at. Anything that
+ *  could change what a path opens drops its preloaded copy: unmounting its
+ *  archive, mounting something ahead of it that has the same path, writing
+ *  or deleting it through the write dir, PHYSFS_watch() reporting it changed,
+ *  or changing PHYSFS_permitSymbolicLinks(). Other than that, what you get
+ *  is what was there when it was preloaded. A handle opened before a file
+ *  is dropped keeps reading the old copy.
+ *
+ * Preloaded files count against the budget set with
+ *  PHYSFS_setPreloadBudget(), and the least recently opened ones are dropped
+ *  when it's exceeded, unless they're pinned with PHYSFS_PRELOAD_PIN. Pinned
+ *  files stay until PHYSFS_unpreload() or one of the things above drops
+ *  them. Preloading a file that's already preloaded with PHYSFS_PRELOAD_PIN
+ *  pins it. Use PHYSFS_getPreloadStats() to see where the memory went.
+ *
+ *    \param path file or directory to preload, in platform-independent
+ *                notation.
+ *    \param flags zero, or PHYSFS_PRELOAD_PIN.
+ *   \return non-zero if everything was preloaded, zero on failure. Use
+ *           PHYSFS_getLastErrorCode() to obtain the specific error. If some
+ *           files failed, the rest are still preloaded. If the files won't
+ *           fit in the budget and aren't pinned, nothing is read and this
+ *           fails with PHYSFS_ERR_OUT_OF_MEMORY.
+ *
+ * \sa PHYSFS_unpreload
+ * \sa PHYSFS_setPreloadBudget
+ * \sa PHYSFS_getPreloadStats
+ */
+PHYSFS_DECL int PHYSFS_preload(const char *path, PHYSFS_uint32 flags);
+
+
+/**
+ * \fn int PHYSFS_unpreload(const char *path)
+ * \brief Drop preloaded files, pinned or not.
+ *
+ * This frees the memory for every file at or under (path) that was loaded
+ *  by PHYSFS_preload(); opening them goes back to reading the archive.
+ *  Handles that are already open keep working. Unpreloading something that
+ *  isn't preloaded is not an error.
+ *
+ *    \param path file or directory to drop, in platform-independent
+ *                notation, or "" for everything.
+ *   \return non-zero on success, zero if (path) isn't a valid path. Use
+ *           PHYSFS_getLastErrorCode() to obtain the specific error.
+ *
+ * \sa PHYSFS_preload
+ */
+PHYSFS_DECL int PHYSFS_unpreload(const char *path);
+
+
+/**
+ * \fn void PHYSFS_setPreloadBudget(PHYSFS_uint64 budget)
+ * \brief Limit how much memory preloaded files that aren't pinned can use.
+ *
+ * When unpinned preloaded files add up to more than (budget) bytes, the
+ *  least recently opened ones are dropped until they don't. Setting a
+ *  smaller budget drops files right away. The default is 256 megabytes, and
+ *  it reverts to that at PHYSFS_deinit(). This can be called before
+ *  PHYSFS_init().
+ *
+ *   \param budget bytes of unpinned preloaded files to keep.
+ *
+ * \sa PHYSFS_getPreloadBudget
+ * \sa PHYSFS_preload
+ */
+PHYSFS_DECL void PHYSFS_setPreloadBudget(PHYSFS_uint64 budget);
+
+
+/**
+ * \fn PHYSFS_uint64 PHYSFS_getPreloadBudget(void)
+ * \brief Determine how much memory unpinned preloaded files may use.
+ *
+ *  \return the value from the last call to PHYSFS_setPreloadBudget(),
+ *          or the default if it hasn't been called.
+ *
+ * \sa PHYSFS_setPreloadBudget
+ */
+PHYSFS_DECL PHYSFS_uint64 PHYSFS_getPreloadBudget(void);
+
+
+/**
+ * \struct PHYSFS_PreloadStats
+ * \brief What PHYSFS_preload() is holding, and how it's being used.
+ *
+ * Counts are since PHYSFS_init().
+ *
+ * \sa PHYSFS_getPreloadStats
+ */
+typedef struct PHYSFS_PreloadStats
+{
+    PHYSFS_uint64 hits;          /**< opens served from memory. */
+    PHYSFS_uint64 evictions;     /**< files dropped to stay within budget. */
+    PHYSFS_uint64 invalidations; /**< files dropped because what their path
+                                       opens changed. */
+    PHYSFS_uint64 files;         /**< files preloaded right now. */
+    PHYSFS_uint64 bytes;         /**< bytes of them, pinned or not. */
+    PHYSFS_uint64 pinnedBytes;   /**< bytes of pinned ones, which don't count
+                                       against the budget. */
+} PHYSFS_PreloadStats;
+
+
+/**
+ * \fn void PHYSFS_getPreloadStats(PHYSFS_PreloadStats *stats)
+ * \brief See what preloaded files are costing, and what they're saving.
+ *
+ * Fills in (stats) with current usage and counts. If PhysicsFS isn't
+ *  initialized, everything is zero.
+ *
+ *   \param stats structure to fill in.
+ *
+ * \sa PHYSFS_preload
+ * \sa PHYSFS_setPreloadBudget
+ */
+PHYSFS_DECL void PHYSFS_getPreloadStats(PHYSFS_PreloadStats *stats);
+
+
+/**
+ * \fn int PHYSFS_startAccessLog(void)
+ * \brief Start recording which files get read, and where.
+ *
+ * From now until PHYSFS_stopAccessLog(), every successful PHYSFS_openRead()
+ *  and every range of bytes read from those handles is noted in memory, in
+ *  order. That's a record of what a session (a level load, say) actually
+ *  touched. extras/physfsrepack.c can rewrite a .zip or .grp file from one or
+ *  more of these so its entries sit in the order they're first needed, which
+ *  makes loading from spinning disks and optical media mostly sequential.
+ *
+ * Reads that carry on where the last read of the same handle stopped are
+ *  merged, so streaming a file costs one line of log, not one per read. The
+ *  log is plain text: a comment line, then tab-separated lines of either
+ *  "open", a number for the handle, the name asked for and the archive (as
+ *  it was passed to PHYSFS_mount()), or "read", the handle's number, the
+ *  offset and the byte count. Names with tabs or newlines in them aren't
+ *  logged.
+ *
+ * This works through the PHYSFS_setTraceCallback() machinery, so it needs a
+ *  build that keeps stats, and your trace callback still gets everything.
+ *  Start and stop it while no other thread is using PhysicsFS.
+ *
+ *  \return non-zero on success, zero if this build doesn't keep stats, the
+ *          log is already recording, or PhysicsFS isn't initialized.
+ *          Specifics of the error can be gleaned from PHYSFS_getLastError().
+ *
+ * \sa PHYSFS_stopAccessLog
+ * \sa PHYSFS_preload
+ * \sa PHYSFS_readFilesBatch
+ */
+PHYSFS_DECL int PHYSFS_startAccessLog(void);
+
+
+/**
+ * \fn int PHYSFS_stopAccessLog(PHYSFS_File *out)
+ * \brief Stop recording, and write out what PHYSFS_startAccessLog() saw.
+ *
+ * The log goes to (out), which you'd usually get from PHYSFS_openWrite(),
+ *  and which isn't closed. Either way, the log is gone after this; starting
+ *  again starts a new one. PHYSFS_deinit() throws away a log that's still
+ *  recording.
+ *
+ *   \param out where to write the log, or NULL to just throw it away.
+ *  \return non-zero on success, zero if the log wasn't recording, memory
+ *          ran out while it was, or writing to (out) failed. Specifics of
+ *          the error can be gleaned from PHYSFS_getLastError().
+ *
+ * \sa PHYSFS_startAccessLog
+ */
+PHYSFS_DECL int PHYSFS_stopAccessLog(PHYSFS_File *out);
+
+
+/**
+ * \fn int PHYSFS_enumerateGlob(const char *dir, const char *pattern, PHYSFS_EnumerateCallback c, void *d)
+ * \brief Find everything under a directory whose path matches a pattern.
+ *
+ * This is PHYSFS_enumerate() with a filter and recursion built in. (pattern)
+ *  is a path, relative to (dir), in platform-independent notation. In each
+ *  piece of it, '*' matches any run of characters and '?' matches any one
+ *  character, while a piece that's just "**" matches any number of
+ *  directories, including none. So "*.lua" finds Lua scripts right in (dir),
+ *  "maps/level?.dat" finds level1.dat through level9.dat in its "maps"
+ *  subdirectory, and a "**" piece in front of "*.lua" finds scripts at any
+ *  depth (that pattern can't be spelled out here; it would end this
+ *  comment). There's no escaping, so names with '*' or '?' in them can only
+ *  be matched by wildcards.
+ *
+ * The pattern is parsed once, then each archive is walked with it, so only
+ *  directories that might still lead to a match get looked at, and pieces
+ *  without wildcards are looked up instead of searched for. Archives that
+ *  keep their directory in memory (.zip, .7z, and most of the others) are
+ *  matched right where their entries sit, so names that don't match cost
+ *  next to nothing.
+ *
+ * The callback gets the directory a match is in (in sanitized form, so
+ *  there's no leading '/') and the match's name, and behaves exactly as it
+ *  does for PHYSFS_enumerate(). Directories can match, too. Archives are
+ *  walked one at a time, in search path order, so just like
+ *  PHYSFS_enumerate(), a path that more than one archive has will be
+ *  reported more than once, and nothing comes in any particular order.
+ *  Names are matched case-insensitively in archives that were mounted while
+ *  PHYSFS_ignoreCase() was on, and exactly in the rest. Symlinks are never
+ *  followed into, and are skipped entirely unless PHYSFS_permitSymbolicLinks()
+ *  is on.
+ *
+ * The same rules apply to what the callback may do as for PHYSFS_enumerate().
+ *
+ *    \param dir Directory, in platform-independent notation, to search under.
+ *    \param pattern What to find, relative to (dir). At most 64 pieces.
+ *    \param c Callback function to notify about matches.
+ *    \param d Application-defined data passed to callback. Can be NULL.
+ *   \return non-zero on success, zero on failure. Use
+ *           PHYSFS_getLastErrorCode() to obtain the specific error. A bad
+ *           pattern fails with PHYSFS_ERR_INVALID_ARGUMENT or
+ *           PHYSFS_ERR_BAD_FILENAME. Stopping early with PHYSFS_ENUM_STOP is
+ *           success; PHYSFS_ENUM_ERROR fails with PHYSFS_ERR_APP_CALLBACK.
+ *
+ * \sa PHYSFS_enumerate
+ * \sa PHYSFS_EnumerateCallback
+ */
+PHYSFS_DECL int PHYSFS_enumerateGlob(const char *dir, const char *pattern,
+                                     PHYSFS_EnumerateCallback c, void *d);
+
+/**
+ * \fn int PHYSFS_setWriteBehind(PHYSFS_uint64 bufsize)
+ * \brief Let a background thread do the writing to files.
+ *
+ * With write-behind on, every file opened for writing afterwards gets two
+ *  buffers of (bufsize) bytes each. PHYSFS_writeBytes() copies into one of
+ *  them and returns, while a background thread writes the other one to
+ *  disk, so a frame only waits on the disk if it gets more than a whole
+ *  buffer ahead of it. PHYSFS_close() doesn't wait at all: the thread
+ *  writes what's left, syncs the file and closes it on its own time.
+ *
+ * PHYSFS_flush() is the barrier for a handle that's still open; see there.
+ *  PHYSFS_seek(), PHYSFS_fileLength() and PHYSFS_setBuffer() wait for the
+ *  handle's background writes first, too. The first write that fails
+ *  sticks: everything after it is dropped, and PHYSFS_writeBytes(),
+ *  PHYSFS_flush() and friends fail from then on. Failures after
+ *  PHYSFS_close() has returned are reported by PHYSFS_waitWriteBehind().
+ *
+ * If no thread can be started, handles just get a single PHYSFS_setBuffer()
+ *  buffer of (bufsize) instead. Calling PHYSFS_setBuffer() on a handle
+ *  turns write-behind off for it. Handles open already aren't affected by
+ *  changes here. This is reset to zero by PHYSFS_deinit().
+ *
+ *   \param bufsize Size of each of a handle's two buffers, in bytes. Zero,
+ *                  the default, turns write-behind off.
+ *  \return nonzero on success, zero if (bufsize) is too big for this
+ *          platform, with the setting left alone.
+ *
+ * \sa PHYSFS_getWriteBehind
+ * \sa PHYSFS_waitWriteBehind
+ * \sa PHYSFS_openWriteAtomic
+ */
+PHYSFS_DECL int PHYSFS_setWriteBehind(PHYSFS_uint64 bufsize);
+
+/**
+ * \fn PHYSFS_uint64 PHYSFS_getWriteBehind(void)
+ * \brief Get the buffer size set by PHYSFS_setWriteBehind().
+ *
+ *  \return size of each write-behind buffer in bytes, or zero if it's off.
+ *
+ * \sa PHYSFS_setWriteBehind
+ */
+PHYSFS_DECL PHYSFS_uint64 PHYSFS_getWriteBehind(void);
+
+/**
+ * \fn int PHYSFS_waitWriteBehind(void)
+ * \brief Wait for files closed with write-behind to finish.
+ *
+ * Blocks until every write-behind handle that has been passed to
+ *  PHYSFS_close() is written, synced and closed (and, for
+ *  PHYSFS_openWriteAtomic(), in place or thrown away). Call this before
+ *  telling the player their game has been saved, or before quitting.
+ *  PHYSFS_setWriteDir() and PHYSFS_deinit() wait like this on their own.
+ *
+ * That's also where failures after PHYSFS_close() end up: this reports the
+ *  first one since it was last called, and forgets it.
+ *
+ *  \return nonzero if everything closed since the last call made it to
+ *          disk, zero otherwise. Use PHYSFS_getLastErrorCode() to obtain the
+ *          specific error.
+ *
+ * \sa PHYSFS_setWriteBehind
+ */
+PHYSFS_DECL int PHYSFS_waitWriteBehind(void);
+
+/**
+ * \fn PHYSFS_File *PHYSFS_openWriteAtomic(const char *filename)
+ * \brief Open a file for writing, replacing the old one only when done.
+ *
+ * This is PHYSFS_openWrite(), except that (filename) itself isn't touched
+ *  until the handle is closed. Writes go to a new file next to it, with
+ *  ".physfs-new" on the end of its name. PHYSFS_close() syncs that to disk
+ *  and renames it over (filename), so a crash or a full disk leaves either
+ *  the complete old file or the complete new one, never half of each. If
+ *  anything goes wrong, the new file is deleted and the old one is left
+ *  alone. Closing with PHYSFS_deinit() instead throws the new file away.
+ *
+ * Without write-behind, PHYSFS_close() does all that itself, and returns
+ *  zero if it couldn't; the handle is closed either way, unless writing
+ *  out its buffer failed, in which case it's still open, just like any
+ *  other. With write-behind (see PHYSFS_setWriteBehind()) the rename
+ *  happens in the background after PHYSFS_close() returns, and
+ *  PHYSFS_waitWriteBehind() reports whether it worked.
+ *
+ * The write dir has to be a directory on the native filesystem, since
+ *  that's the only thing that can rename. How atomic the rename is, is up
+ *  to the platform; on POSIX systems and Windows it is.
+ *
+ *   \param filename File to open, in platform-independent notation.
+ *  \return A valid PhysicsFS filehandle on success, NULL on error. Use
+ *          PHYSFS_getLastErrorCode() to obtain the specific error; it's
+ *          PHYSFS_ERR_UNSUPPORTED if the write dir is an archive.
+ *
+ * \sa PHYSFS_openWrite
+ * \sa PHYSFS_close
+ * \sa PHYSFS_setWriteBehind
+ */
+PHYSFS_DECL PHYSFS_File *PHYSFS_openWriteAtomic(const char *filename);
+
+
+/**
+ * \fn void PHYSFS_setVerifyChecksums(int enable)
+ * \brief Check archived files against their stored checksums as they're
+ *        read.
+ *
+ * .zip files store a CRC-32 of every file, but PhysicsFS normally takes
+ *  the data on faith. If (enable) is non-zero, files opened from .zip
+ *  archives after this call keep a running CRC-32 of what's read from
+ *  them, and the read that reaches the end of the file fails with
+ *  PHYSFS_ERR_CORRUPT if it doesn't match. The bytes from that read are
+ *  still in your buffer, but you shouldn't trust them, or anything before
+ *  them. Where the CPU can help, this costs a few percent of read speed.
+ *
+ * Only data read in order counts: seeking back and reading again is fine,
+ *  but seeking past data that hasn't been read yet gives up on checking
+ *  that handle, since there's no way to get the sum right without it.
+ *  Files read start to finish are always checked. Uncompressed files in an
+ *  archive that's mapped into memory are checked all at once instead, and
+ *  PHYSFS_openRead() fails with PHYSFS_ERR_CORRUPT if they don't match.
+ *  Other archive types don't store checksums, and aren't affected.
+ *
+ * This is disabled by default, and reverts to disabled at PHYSFS_deinit().
+ *
+ *   \param enable non-zero to check files opened from now on, zero to stop.
+ *
+ * \sa PHYSFS_getVerifyChecksums
+ */
+PHYSFS_DECL void PHYSFS_setVerifyChecksums(int enable);
+
+
+/**
+ * \fn int PHYSFS_getVerifyChecksums(void)
+ * \brief Determine if archived files are checked against their checksums.
+ *
+ *  \return non-zero if PHYSFS_setVerifyChecksums() turned this on, zero
+ *          otherwise.
+ *
+ * \sa PHYSFS_setVerifyChecksums
+ */
+PHYSFS_DECL int PHYSFS_getVerifyChecksums(void);
+
 #ifdef __cplusplus
 }
 #endif
@@ -27,14 +27,34 @@ typedef struct
     PHYSFS_uint32 dbidx;          /* index into lzma sdk database   */
 } SZIPentry;
 
+/* Blocks bigger than this are decoded as the app reads, not all at once. */
+#define SZIP_MAX_CACHED_BLOCK (16 * 1024 * 1024)
+
 /* One SZIPinfo is kept for each open 7zip archive. */
 typedef struct
 {
     __PHYSFS_DirTree tree;    /* manages directory tree.           */
     PHYSFS_Io *io;            /* physfs i/o interface for this archive. */
     CSzArEx db;               /* lzma sdk archive database object. */
+    void *lock;               /* one thread decodes a block at a time. */
 } SZIPinfo;
 
+/* One SZIPfileinfo is kept for each file being decoded on the fly. */
+typedef struct
+{
+    SZIPLookToRead stream;    /* our own view of the archive.            */
+    CSzFolderStream folder;   /* lzma sdk incremental decoder.           */
+    SZIPinfo *info;           /* archive this came from.                 */
+    const SZIPentry *entry;   /* file we're decoding.                    */
+    UInt32 folderIndex;       /* block the file lives in.                */
+    PHYSFS_uint64 start;      /* offset of the file in the decoded block. */
+    PHYSFS_uint64 size;       /* uncompressed size of the file.          */
+    PHYSFS_uint64 pos;        /* current position in the file.           */
+    UInt32 crc;               /* running crc-32 of what we've decoded.    */
+} SZIPfileinfo;
+
+static __PHYSFS_POOL(fileinfoPool, SZIPfileinfo);
+
 
 static PHYSFS_ErrorCode szipErrorCode(const SRes rc)
 {
@@ -170,8 +190,8 @@ static int szipLoadEntry(SZIPinfo *info, const PHYSFS_uint32 idx)
         PHYSFS_utf8FromUtf16(utf16, utf8, utf8buflen);
         entry = (SZIPentry*) __PHYSFS_DirTreeAdd(&info->tree, utf8, isdir);
         retval = (entry != NULL);
-        if (retval)
-            entry->dbidx = idx;
+        if ((retval) && (!__PHYSFS_DirTreeOtherCase(&info->tree, entry, utf8)))
+            entry->dbidx = idx;  /* (if it's a case variant, the first wins.) */
     } /* if */
 
     __PHYSFS_smallFree(utf8);
@@ -183,11 +203,11 @@ static int szipLoadEntry(SZIPinfo *info, const PHYSFS_uint32 idx)
 
 static int szipLoadEntries(SZIPinfo *info)
 {
+    const PHYSFS_uint32 count = info->db.NumFiles;
     int retval = 0;
 
-    if (__PHYSFS_DirTreeInit(&info->tree, sizeof (SZIPentry)))
+    if (__PHYSFS_DirTreeInit(&info->tree, sizeof (SZIPentry), count))
     {
-        const PHYSFS_uint32 count = info->db.NumFiles;
         PHYSFS_uint32 i;
         for (i = 0; i < count; i++)
             BAIL_IF_ERRPASS(!szipLoadEntry(info, i), 0);
@@ -203,6 +223,9 @@ static void SZIP_closeArchive(void *opaque)
     SZIPinfo *info = (SZIPinfo *) opaque;
     if (info)
     {
+        __PHYSFS_blockCachePurge(info);
+        if (info->lock)
+            __PHYSFS_platformDestroyMutex(info->lock);
         if (info->io)
             info->io->destroy(info->io);
         SzArEx_Free(&info->db, &SZIP_SzAlloc);
@@ -238,6 +261,9 @@ static void *SZIP_openArchive(PHYSFS_Io *io, const char *name,
 
     info->io = io;
 
+    info->lock = __PHYSFS_platformCreateMutex();
+    GOTO_IF_ERRPASS(!info->lock, failed);
+
     szipInitStream(&stream, io);
     rc = SzArEx_Open(&info->db, &stream.lookStream.s, alloc, alloc);
     GOTO_IF(rc != SZ_OK, szipErrorCode(rc), failed);
@@ -253,65 +279,316 @@ failed:
 } /* SZIP_openArchive */
 
 
-static PHYSFS_Io *SZIP_openRead(void *opaque, const char *path)
+/* Decode a run of the block; it counts as file data once we reach it. */
+static int szipStreamDecode(SZIPfileinfo *finfo, Byte *buf, const size_t len)
 {
-    /* !!! FIXME: the current lzma sdk C API only allows you to decompress
-       !!! FIXME:  the entire file at once, which isn't ideal. Fix this in the
-       !!! FIXME:  SDK and then convert this all to a streaming interface. */
+    CSzFolderStream *folder = &finfo->folder;
+    const CSzArEx *db = &finfo->info->db;
+    const PHYSFS_uint32 idx = finfo->entry->dbidx;
+    const int infile = (folder->unpackPos >= finfo->start);
+    size_t got = len;
+    SRes rc;
 
-    SZIPinfo *info = (SZIPinfo *) opaque;
-    SZIPentry *entry = (SZIPentry *) __PHYSFS_DirTreeFind(&info->tree, path);
-    ISzAlloc *alloc = &SZIP_SzAlloc;
-    SZIPLookToRead stream;
+    rc = SzFolderStream_Read(folder, &finfo->stream.lookStream.s, buf, &got);
+    BAIL_IF(rc != SZ_OK, szipErrorCode(rc), 0);
+    BAIL_IF(got != len, PHYSFS_ERR_CORRUPT, 0);
+
+    if (infile)
+    {
+        finfo->crc = CrcUpdate(finfo->crc, buf, len);
+        finfo->pos += len;
+
+        /* we always decode every byte in order, so we can check the crc. */
+        if ((finfo->pos == finfo->size) && (SzBitWithVals_Check(&db->CRCs, idx)))
+        {
+            const UInt32 crc = CRC_GET_DIGEST(finfo->crc);
+            BAIL_IF(crc != db->CRCs.Vals[idx], PHYSFS_ERR_CORRUPT, 0);
+        } /* if */
+    } /* if */
+
+    return 1;
+} /* szipStreamDecode */
+
+
+static int szipStreamSkip(SZIPfileinfo *finfo, PHYSFS_uint64 len)
+{
+    Byte buf[4096];
+    while (len > 0)
+    {
+        const size_t chunk = (len > sizeof (buf)) ? sizeof (buf) : (size_t) len;
+        BAIL_IF_ERRPASS(!szipStreamDecode(finfo, buf, chunk), 0);
+        len -= chunk;
+    } /* while */
+    return 1;
+} /* szipStreamSkip */
+
+
+/* Decode up to the start of the file again. Solid blocks can't be entered
+   in the middle, so this costs as much as the file's offset in the block. */
+static int szipStreamRewind(SZIPfileinfo *finfo)
+{
+    SzFolderStream_Rewind(&finfo->folder);
+    finfo->pos = 0;
+    finfo->crc = CRC_INIT_VAL;
+    return szipStreamSkip(finfo, finfo->start);
+} /* szipStreamRewind */
+
+
+static PHYSFS_sint64 SZIP_read(PHYSFS_Io *io, void *buf, PHYSFS_uint64 len)
+{
+    SZIPfileinfo *finfo = (SZIPfileinfo *) io->opaque;
+    const PHYSFS_uint64 avail = finfo->size - finfo->pos;
+
+    if (len > avail)
+        len = avail;
+
+    if (len == 0)
+        return 0;
+
+    BAIL_IF(!__PHYSFS_ui64FitsAddressSpace(len),PHYSFS_ERR_INVALID_ARGUMENT,-1);
+    BAIL_IF_ERRPASS(!szipStreamDecode(finfo, (Byte *) buf, (size_t) len), -1);
+    return (PHYSFS_sint64) len;
+} /* SZIP_read */
+
+
+static PHYSFS_sint64 SZIP_write(PHYSFS_Io *io, const void *b, PHYSFS_uint64 len)
+{
+    BAIL(PHYSFS_ERR_READ_ONLY, -1);
+} /* SZIP_write */
+
+
+static int SZIP_seek(PHYSFS_Io *io, PHYSFS_uint64 offset)
+{
+    SZIPfileinfo *finfo = (SZIPfileinfo *) io->opaque;
+
+    BAIL_IF(offset > finfo->size, PHYSFS_ERR_PAST_EOF, 0);
+
+    if (offset < finfo->pos)  /* can only go forward; start over. */
+        BAIL_IF_ERRPASS(!szipStreamRewind(finfo), 0);
+
+    return szipStreamSkip(finfo, offset - finfo->pos);
+} /* SZIP_seek */
+
+
+static PHYSFS_sint64 SZIP_tell(PHYSFS_Io *io)
+{
+    return (PHYSFS_sint64) ((SZIPfileinfo *) io->opaque)->pos;
+} /* SZIP_tell */
+
+
+static PHYSFS_sint64 SZIP_length(PHYSFS_Io *io)
+{
+    return (PHYSFS_sint64) ((SZIPfileinfo *) io->opaque)->size;
+} /* SZIP_length */
+
+
+static PHYSFS_Io *szipOpenStream(SZIPinfo *info, const SZIPentry *entry,
+                                 const UInt32 folderIndex, int *fallback);
+
+static PHYSFS_Io *SZIP_duplicate(PHYSFS_Io *io)
+{
+    SZIPfileinfo *finfo = (SZIPfileinfo *) io->opaque;
+    int fallback = 0;
+    return szipOpenStream(finfo->info, finfo->entry, finfo->folderIndex,
+                          &fallback);
+} /* SZIP_duplicate */
+
+
+static int SZIP_flush(PHYSFS_Io *io) { return 1;  /* no write support. */ }
+
+static void SZIP_destroy(PHYSFS_Io *io)
+{
+    SZIPfileinfo *finfo = (SZIPfileinfo *) io->opaque;
+    SzFolderStream_Free(&finfo->folder, &SZIP_SzAlloc);
+    finfo->stream.io->destroy(finfo->stream.io);
+    __PHYSFS_poolFree(&fileinfoPool, finfo);
+    __PHYSFS_poolFree(&__PHYSFS_ioPool, io);
+} /* SZIP_destroy */
+
+
+static const PHYSFS_Io SZIP_Io =
+{
+    CURRENT_PHYSFS_IO_API_VERSION, NULL,
+    SZIP_read,
+    SZIP_write,
+    SZIP_seek,
+    SZIP_tell,
+    SZIP_length,
+    SZIP_duplicate,
+    SZIP_flush,
+    SZIP_destroy,
+    NULL  /* decompressed on the fly; no readAt(). */
+};
+
+
+/* (*fallback) is set if this block can't be decoded on the fly. */
+static PHYSFS_Io *szipOpenStream(SZIPinfo *info, const SZIPentry *entry,
+                                 const UInt32 folderIndex, int *fallback)
+{
+    const CSzArEx *db = &info->db;
+    const PHYSFS_uint32 idx = entry->dbidx;
     PHYSFS_Io *retval = NULL;
+    SZIPfileinfo *finfo = NULL;
     PHYSFS_Io *io = NULL;
-    UInt32 blockIndex = 0xFFFFFFFF;
-    Byte *outBuffer = NULL;
-    size_t outBufferSize = 0;
-    size_t offset = 0;
-    size_t outSizeProcessed = 0;
-    void *buf = NULL;
     SRes rc;
 
-    BAIL_IF_ERRPASS(!entry, NULL);
-    BAIL_IF(entry->tree.isdir, PHYSFS_ERR_NOT_A_FILE, NULL);
+    retval = (PHYSFS_Io *) __PHYSFS_poolAlloc(&__PHYSFS_ioPool);
+    GOTO_IF_ERRPASS(!retval, szipOpenStream_failed);
+    finfo = (SZIPfileinfo *) __PHYSFS_poolAlloc(&fileinfoPool);
+    GOTO_IF_ERRPASS(!finfo, szipOpenStream_failed);
+    memset(finfo, '\0', sizeof (*finfo));
+    SzFolderStream_Construct(&finfo->folder);
+
+    rc = SzFolderStream_Open(&finfo->folder, db, folderIndex, &SZIP_SzAlloc);
+    *fallback = (rc == SZ_ERROR_UNSUPPORTED);
+    GOTO_IF(rc != SZ_OK, szipErrorCode(rc), szipOpenStream_failed);
+
+    io = __PHYSFS_ioShare(info->io);
+    GOTO_IF_ERRPASS(!io, szipOpenStream_failed);
+    szipInitStream(&finfo->stream, io);
+
+    finfo->info = info;
+    finfo->entry = entry;
+    finfo->folderIndex = folderIndex;
+    finfo->start = db->UnpackPositions[idx] -
+                   db->UnpackPositions[db->FolderToFile[folderIndex]];
+    finfo->size = SzArEx_GetFileSize(db, idx);
+    GOTO_IF_ERRPASS(!szipStreamRewind(finfo), szipOpenStream_failed);
+
+    memcpy(retval, &SZIP_Io, sizeof (*retval));
+    retval->opaque = finfo;
+    return retval;
 
-    io = info->io->duplicate(info->io);
-    GOTO_IF_ERRPASS(!io, SZIP_openRead_failed);
+szipOpenStream_failed:
+    if (finfo != NULL)
+    {
+        SzFolderStream_Free(&finfo->folder, &SZIP_SzAlloc);
+        __PHYSFS_poolFree(&fileinfoPool, finfo);
+    } /* if */
 
-    szipInitStream(&stream, io);
+    if (io != NULL)
+        io->destroy(io);
 
-    rc = SzArEx_Extract(&info->db, &stream.lookStream.s, entry->dbidx,
-                        &blockIndex, &outBuffer, &outBufferSize, &offset,
-                        &outSizeProcessed, alloc, alloc);
-    GOTO_IF(rc != SZ_OK, szipErrorCode(rc), SZIP_openRead_failed);
+    __PHYSFS_poolFree(&__PHYSFS_ioPool, retval);
+    return NULL;
+} /* szipOpenStream */
+
+
+/* Decode an entire solid block into a memory Io that owns the buffer. */
+static PHYSFS_Io *szipDecodeBlock(SZIPinfo *info, const UInt32 folderIndex)
+{
+    const UInt64 len = SzAr_GetFolderUnpackSize(&info->db.db, folderIndex);
+    PHYSFS_Io *retval = NULL;
+    SZIPLookToRead stream;
+    PHYSFS_Io *io;
+    Byte *buf;
+    SRes rc;
 
+    BAIL_IF(!__PHYSFS_ui64FitsAddressSpace(len), PHYSFS_ERR_OUT_OF_MEMORY, NULL);
+    buf = (Byte *) allocator.Malloc(len ? (size_t) len : 1);
+    BAIL_IF(!buf, PHYSFS_ERR_OUT_OF_MEMORY, NULL);
+
+    io = __PHYSFS_ioShare(info->io);
+    GOTO_IF_ERRPASS(!io, szipDecodeBlock_failed);
+    szipInitStream(&stream, io);
+    rc = SzAr_DecodeFolder(&info->db.db, folderIndex, &stream.lookStream.s,
+                           info->db.dataPos, buf, (size_t) len, &SZIP_SzAlloc);
     io->destroy(io);
-    io = NULL;
+    GOTO_IF(rc != SZ_OK, szipErrorCode(rc), szipDecodeBlock_failed);
+    __PHYSFS_STAT_ADD(bytesInflated, len);
 
-    buf = allocator.Malloc(outSizeProcessed);
-    GOTO_IF(rc != SZ_OK, PHYSFS_ERR_OUT_OF_MEMORY, SZIP_openRead_failed);
-    memcpy(buf, outBuffer + offset, outSizeProcessed);
+    retval = __PHYSFS_createMemoryIo(buf, len, allocator.Free);
+    GOTO_IF_ERRPASS(!retval, szipDecodeBlock_failed);
+    return retval;
 
-    alloc->Free(alloc, outBuffer);
-    outBuffer = NULL;
+szipDecodeBlock_failed:
+    allocator.Free(buf);
+    return NULL;
+} /* szipDecodeBlock */
 
-    retval = __PHYSFS_createMemoryIo(buf, outSizeProcessed, allocator.Free);
-    GOTO_IF_ERRPASS(!retval, SZIP_openRead_failed);
+
+/*
+ * Find a block in the block cache, or decode it and (if (cache)) add it
+ *  there. Blocks aren't part of any one file, so they're cached with a NULL
+ *  entry. Returns a new reference to the block's memory Io, which the caller
+ *  has to destroy. MAKE SURE you hold (info->lock) when calling this, so a
+ *  sibling file opened at the same time waits for the block instead of
+ *  decoding it again.
+ */
+static PHYSFS_Io *szipGetBlock(SZIPinfo *info, const UInt32 folderIndex,
+                               const int cache)
+{
+    PHYSFS_Io *retval = NULL;
+
+    if (cache)
+        retval = __PHYSFS_blockCacheGet(info, NULL, folderIndex);
+
+    if (retval == NULL)
+    {
+        retval = szipDecodeBlock(info, folderIndex);
+        if ((retval != NULL) && (cache))
+            __PHYSFS_blockCachePut(info, NULL, folderIndex, retval);
+    } /* if */
 
     return retval;
+} /* szipGetBlock */
 
-SZIP_openRead_failed:
-    if (io != NULL)
-        io->destroy(io);
 
-    if (buf)
-        allocator.Free(buf);
+static PHYSFS_Io *SZIP_openRead(void *opaque, const char *path)
+{
+    SZIPinfo *info = (SZIPinfo *) opaque;
+    SZIPentry *entry = (SZIPentry *) __PHYSFS_DirTreeFind(&info->tree, path);
+    const CSzArEx *db = &info->db;
+    PHYSFS_Io *retval = NULL;
+    PHYSFS_Io *block = NULL;
+    PHYSFS_uint64 blocklen, offset, len;
+    UInt32 folderIndex;
+    int fallback = 0;
 
-    if (outBuffer)
-        alloc->Free(alloc, outBuffer);
+    BAIL_IF_ERRPASS(!entry, NULL);
+    BAIL_IF(entry->tree.isdir, PHYSFS_ERR_NOT_A_FILE, NULL);
 
-    return NULL;
+    folderIndex = db->FileToFolder[entry->dbidx];
+    if (folderIndex == (UInt32) -1)  /* empty file, nothing to decode. */
+        return __PHYSFS_createMemoryIo("", 0, NULL);
+
+    blocklen = SzAr_GetFolderUnpackSize(&db->db, folderIndex);
+    offset = db->UnpackPositions[entry->dbidx] -
+             db->UnpackPositions[db->FolderToFile[folderIndex]];
+    len = SzArEx_GetFileSize(db, entry->dbidx);
+    BAIL_IF((offset > blocklen) || (len > blocklen - offset),
+            PHYSFS_ERR_CORRUPT, NULL);
+
+    /* big blocks are decoded on the fly, if the lzma sdk can do that. */
+    if (blocklen > SZIP_MAX_CACHED_BLOCK)
+    {
+        retval = szipOpenStream(info, entry, folderIndex, &fallback);
+        if ((retval != NULL) || (!fallback))
+            return retval;
+    } /* if */
+
+    /* Otherwise decode the whole block (or reuse it if a sibling file
+       already did), and hand out a view of the file inside it. */
+    __PHYSFS_platformGrabMutex(info->lock);
+    block = szipGetBlock(info, folderIndex, !fallback);
+    __PHYSFS_platformReleaseMutex(info->lock);
+    BAIL_IF_ERRPASS(!block, NULL);
+
+    retval = __PHYSFS_ioMappedSubrange(block, offset, len);
+    block->destroy(block);  /* (retval) holds its own reference. */
+    BAIL_IF_ERRPASS(!retval, NULL);
+
+    if (SzBitWithVals_Check(&db->CRCs, entry->dbidx))
+    {
+        const void *ptr = __PHYSFS_ioMappedRange(retval, 0, len);
+        if (CrcCalc(ptr, (size_t) len) != db->CRCs.Vals[entry->dbidx])
+        {
+            retval->destroy(retval);
+            BAIL(PHYSFS_ERR_CORRUPT, NULL);
+        } /* if */
+    } /* if */
+
+    return retval;
 } /* SZIP_openRead */
 
 
@@ -11,6 +11,32 @@
 
 /* There's no PHYSFS_Io interface here. Use __PHYSFS_createNativeIo(). */
 
+typedef struct
+{
+    char *base;  /* platform-dependent path, ending with a dir separator. */
+    void *lock;  /* serializes access to (names). */
+    int ignorecase;  /* non-zero if lookups that miss should try (names). */
+    int listed;  /* number of directories listed into (names) so far. */
+    __PHYSFS_DirTree names;  /* what we know of the real case of paths. */
+    int snapshot;  /* non-zero if (snap) answers lookups. See below. */
+    int snaplinks;  /* non-zero if (snap) has symlinks to dirs. */
+    __PHYSFS_DirTree snap;  /* everything in the dir, as of mount time. */
+} DIRinfo;
+
+typedef struct
+{
+    __PHYSFS_DirTreeEntry tree;
+    int listed;  /* non-zero if this dir's kids have been added. */
+    PHYSFS_sint64 modtime;  /* the dir's modtime when they were. */
+} DIRentry;
+
+typedef struct
+{
+    __PHYSFS_DirTreeEntry tree;
+    PHYSFS_Stat stat;  /* what __PHYSFS_platformStat(path, stat, 0) said. */
+    int deleted;  /* non-zero if it went away after the snapshot was taken. */
+} DIRsnapEntry;
+
 
 
 static char *cvtToDependent(const char *prepend, const char *path,
@@ -32,19 +58,312 @@ static char *cvtToDependent(const char *prepend, const char *path,
 } /* cvtToDependent */
 
 
-#define CVT_TO_DEPENDENT(buf, pre, dir) { \
+#define CVT_TO_DEPENDENT(buf, _info, dir) { \
+    const char *pre = ((DIRinfo *) (_info))->base; \
     const size_t len = ((pre) ? strlen((char *) pre) : 0) + strlen(dir) + 1; \
     buf = cvtToDependent((char*)pre,dir,(char*)__PHYSFS_smallAlloc(len),len); \
 }
 
 
 
+/*
+ * Snapshots (see PHYSFS_snapshotDirectories()) list the whole directory
+ *  once, at mount time, and keep every path and its stat in (snap), so
+ *  lookups, stats and enumerations never touch the disk after that. Only
+ *  opening a file still does.
+ *
+ * Symlinks are recorded, but not followed; if any point at directories,
+ *  paths through them aren't in the snapshot, so anything the snapshot
+ *  doesn't have is looked up on disk the usual way instead of failing.
+ *
+ * PHYSFS_pollWatch() keeps a snapshot current with
+ *  __PHYSFS_DIR_refreshPath(). Entries can't be removed from a DirTree, so
+ *  things that go away are just marked (deleted), and come back to life if
+ *  they show up again.
+ */
+
+/* Note if (path), a symlink, points at a dir. */
+static void checkSnapshotLink(DIRinfo *info, const char *path)
+{
+    PHYSFS_Stat target;
+    char *d;
+
+    if (info->snaplinks)
+        return;  /* already know. */
+
+    CVT_TO_DEPENDENT(d, info, path);
+    if ((d) && (__PHYSFS_platformStat(d, &target, 1)) &&
+        (target.filetype == PHYSFS_FILETYPE_DIRECTORY))
+        info->snaplinks = 1;
+    __PHYSFS_smallFree(d);
+} /* checkSnapshotLink */
+
+
+typedef struct
+{
+    DIRinfo *info;
+    const char *prefix;  /* path of the dir being listed, "" for the root. */
+    PHYSFS_ErrorCode errcode;
+} DIRsnapData;
+
+static PHYSFS_EnumerateCallbackResult snapshotCallback(void *_data,
+                                     const char *origdir, const char *fname,
+                                     const PHYSFS_Stat *stat)
+{
+    DIRsnapData *data = (DIRsnapData *) _data;
+    const size_t prefixlen = strlen(data->prefix);
+    const size_t len = prefixlen + strlen(fname) + 2;
+    const int isdir = (stat->filetype == PHYSFS_FILETYPE_DIRECTORY);
+    char *path = (char *) __PHYSFS_smallAlloc(len);
+    DIRsnapEntry *entry;
+
+    if (!path)
+    {
+        data->errcode = PHYSFS_ERR_OUT_OF_MEMORY;
+        return PHYSFS_ENUM_ERROR;
+    } /* if */
+
+    snprintf(path, len, "%s%s%s", data->prefix, prefixlen ? "/" : "", fname);
+    entry = (DIRsnapEntry *) __PHYSFS_DirTreeAdd(&data->info->snap, path,
+                                                 isdir);
+    if (entry)
+    {
+        memcpy(&entry->stat, stat, sizeof (*stat));
+        entry->deleted = 0;
+        if (stat->filetype == PHYSFS_FILETYPE_SYMLINK)
+            checkSnapshotLink(data->info, path);
+    } /* if */
+
+    __PHYSFS_smallFree(path);
+
+    if (!entry)
+    {
+        data->errcode = PHYSFS_getLastErrorCode();
+        return PHYSFS_ENUM_ERROR;
+    } /* if */
+
+    return PHYSFS_ENUM_OK;
+} /* snapshotCallback */
+
+
+/* Add everything under (entry), a dir already in (info->snap). */
+static int snapshotDir(DIRinfo *info, DIRsnapEntry *entry)
+{
+    const int isroot = (entry == (DIRsnapEntry *) info->snap.root);
+    const char *name = isroot ? "" : entry->tree.name;
+    PHYSFS_EnumerateCallbackResult rc;
+    __PHYSFS_DirTreeEntry *i;
+    DIRsnapData data;
+    char *d;
+
+    CVT_TO_DEPENDENT(d, info, name);
+    BAIL_IF_ERRPASS(!d, 0);
+    data.info = info;
+    data.prefix = name;
+    data.errcode = PHYSFS_ERR_OK;
+    rc = __PHYSFS_platformEnumerateWithStat(d, snapshotCallback, "", &data);
+    __PHYSFS_smallFree(d);
+    if (rc == PHYSFS_ENUM_ERROR)
+    {
+        BAIL_IF(data.errcode != PHYSFS_ERR_OK, data.errcode, 0);
+        BAIL_ERRPASS(0);
+    } /* if */
+
+    /* do subdirs after the listing is done, so only one is open at a time. */
+    for (i = entry->tree.children; i != NULL; i = i->sibling)
+    {
+        DIRsnapEntry *kid = (DIRsnapEntry *) i;
+        if (kid->stat.filetype == PHYSFS_FILETYPE_DIRECTORY)
+            BAIL_IF_ERRPASS(!snapshotDir(info, kid), 0);
+    } /* for */
+
+    return 1;
+} /* snapshotDir */
+
+
+static int buildSnapshot(DIRinfo *info, const PHYSFS_Stat *rootstat)
+{
+    DIRsnapEntry *root;
+
+    BAIL_IF_ERRPASS(!__PHYSFS_DirTreeInit(&info->snap,
+                                          sizeof (DIRsnapEntry), 0), 0);
+    info->snap.ignorecase = info->ignorecase;  /* as it was at mount time. */
+    root = (DIRsnapEntry *) info->snap.root;
+    memcpy(&root->stat, rootstat, sizeof (*rootstat));
+    info->snapshot = 1;
+    return snapshotDir(info, root);
+} /* buildSnapshot */
+
+
+/*
+ * If (info) has a snapshot, find (name) in it. Returns NULL if there's no
+ *  snapshot, or it doesn't have (name) but the disk might. If it definitely
+ *  doesn't exist, returns NULL and sets (*missing) to non-zero.
+ */
+static DIRsnapEntry *findInSnapshot(DIRinfo *info, const char *name,
+                                    int *missing)
+{
+    DIRsnapEntry *retval;
+
+    *missing = 0;
+    if (!info->snapshot)
+        return NULL;
+
+    retval = (DIRsnapEntry *) __PHYSFS_DirTreeFind(&info->snap, name);
+    if ((retval != NULL) && (retval->deleted))
+    {
+        PHYSFS_setErrorCode(PHYSFS_ERR_NOT_FOUND);
+        retval = NULL;
+    } /* if */
+
+    if ((retval == NULL) && (!info->snaplinks))
+        *missing = 1;  /* error is already set. */
+    return retval;
+} /* findInSnapshot */
+
+
+int __PHYSFS_DIR_isSnapshot(void *opaque)
+{
+    const DIRinfo *info = (const DIRinfo *) opaque;
+    return ((info->snapshot) && (!info->snaplinks));
+} /* __PHYSFS_DIR_isSnapshot */
+
+
+static void markSnapshotDeleted(DIRsnapEntry *entry)
+{
+    __PHYSFS_DirTreeEntry *i;
+    entry->deleted = 1;
+    for (i = entry->tree.children; i != NULL; i = i->sibling)
+        markSnapshotDeleted((DIRsnapEntry *) i);
+} /* markSnapshotDeleted */
+
+
+int __PHYSFS_DIR_refreshPath(void *opaque, char *path)
+{
+    DIRinfo *info = (DIRinfo *) opaque;
+    DIRsnapEntry *entry;
+    PHYSFS_Stat st;
+    int retval = 1;
+    int exists;
+    char *ptr;
+    char *d;
+
+    if (!info->snapshot)
+        return 1;  /* everything comes from the disk anyhow. */
+
+    /* if a parent is new too, start there, so everything in it is listed. */
+    for (ptr = strchr(path, '/'); ptr != NULL; ptr = strchr(ptr + 1, '/'))
+    {
+        *ptr = '\0';
+        entry = (DIRsnapEntry *) __PHYSFS_DirTreeFind(&info->snap, path);
+        if ((entry == NULL) || (entry->deleted))
+        {
+            retval = __PHYSFS_DIR_refreshPath(opaque, path);
+            *ptr = '/';
+            return retval;
+        } /* if */
+        *ptr = '/';
+    } /* for */
+
+    CVT_TO_DEPENDENT(d, info, path);
+    GOTO_IF_ERRPASS(!d, refreshPath_failed);
+    exists = __PHYSFS_platformStat(d, &st, 0);
+    __PHYSFS_smallFree(d);
+
+    if (*path == '\0')  /* anything could have happened; start over. */
+    {
+        GOTO_IF_ERRPASS(!exists, refreshPath_failed);
+        __PHYSFS_DirTreeDeinit(&info->snap);
+        info->snapshot = info->snaplinks = 0;
+        GOTO_IF_ERRPASS(!buildSnapshot(info, &st), refreshPath_failed);
+        return -1;
+    } /* if */
+
+    entry = (DIRsnapEntry *) __PHYSFS_DirTreeFind(&info->snap, path);
+    if (!exists)
+    {
+        if ((entry != NULL) && (!entry->deleted))
+        {
+            if (entry->tree.isdir)
+                retval = -1;
+            markSnapshotDeleted(entry);
+        } /* if */
+    } /* if */
+
+    else
+    {
+        const int isdir = (st.filetype == PHYSFS_FILETYPE_DIRECTORY);
+        int isnew = 1;
+
+        if (entry == NULL)
+        {
+            entry = (DIRsnapEntry *) __PHYSFS_DirTreeAdd(&info->snap, path,
+                                                         isdir);
+            GOTO_IF_ERRPASS(!entry, refreshPath_failed);
+        } /* if */
+        else
+        {
+            const size_t len = strlen(path);
+            isnew = ((entry->deleted) || (entry->tree.isdir != isdir));
+
+            /* a case-only rename; the hash doesn't care, only opening does. */
+            if ((entry->tree.namelen == len) &&
+                (strcmp(entry->tree.name, path) != 0))
+                memcpy(entry->tree.name, path, len);
+        } /* else */
+
+        memcpy(&entry->stat, &st, sizeof (st));
+        entry->deleted = 0;
+        entry->tree.isdir = isdir;
+
+        /* a dir that was already here only changed itself; kids report in. */
+        if ((isdir) && (isnew))
+        {
+            __PHYSFS_DirTreeEntry *i;
+            for (i = entry->tree.children; i != NULL; i = i->sibling)
+                markSnapshotDeleted((DIRsnapEntry *) i);
+            GOTO_IF_ERRPASS(!snapshotDir(info, entry), refreshPath_failed);
+            retval = -1;
+        } /* if */
+        else if (st.filetype == PHYSFS_FILETYPE_SYMLINK)
+        {
+            const int hadlinks = info->snaplinks;
+            checkSnapshotLink(info, path);
+            if (info->snaplinks != hadlinks)
+                retval = -1;
+        } /* else if */
+    } /* else */
+
+    /* the parent's modtime probably changed, too. */
+    ptr = strrchr(path, '/');
+    if (ptr != NULL)
+        *ptr = '\0';
+    entry = (DIRsnapEntry *) __PHYSFS_DirTreeFind(&info->snap,
+                                                  ptr ? path : "");
+    CVT_TO_DEPENDENT(d, info, ptr ? path : "");
+    if ((entry != NULL) && (d != NULL) &&
+        (__PHYSFS_platformStat(d, &st, 0)))
+        memcpy(&entry->stat, &st, sizeof (st));
+    __PHYSFS_smallFree(d);
+    if (ptr != NULL)
+        *ptr = '/';
+
+    return retval;
+
+refreshPath_failed:
+    if (info->snapshot)
+        __PHYSFS_DirTreeDeinit(&info->snap);
+    info->snapshot = info->snaplinks = 0;
+    return 0;
+} /* __PHYSFS_DIR_refreshPath */
+
+
 static void *DIR_openArchive(PHYSFS_Io *io, const char *name,
                              int forWriting, int *claimed)
 {
     PHYSFS_Stat st;
     const char dirsep = __PHYSFS_platformDirSeparator;
-    char *retval = NULL;
+    DIRinfo *info = NULL;
     const size_t namelen = strlen(name);
     const size_t seplen = 1;
 
@@ -55,36 +374,342 @@ static void *DIR_openArchive(PHYSFS_Io *io, const char *name,
         BAIL(PHYSFS_ERR_UNSUPPORTED, NULL);
 
     *claimed = 1;
-    retval = allocator.Malloc(namelen + seplen + 1);
-    BAIL_IF(retval == NULL, PHYSFS_ERR_OUT_OF_MEMORY, NULL);
+    info = (DIRinfo *) allocator.Malloc(sizeof (DIRinfo));
+    BAIL_IF(!info, PHYSFS_ERR_OUT_OF_MEMORY, NULL);
+    memset(info, '\0', sizeof (*info));
+
+    info->base = (char *) allocator.Malloc(namelen + seplen + 1);
+    GOTO_IF(!info->base, PHYSFS_ERR_OUT_OF_MEMORY, DIR_openArchive_failed);
 
-    strcpy(retval, name);
+    strcpy(info->base, name);
 
     /* make sure there's a dir separator at the end of the string */
-    if (retval[namelen - 1] != dirsep)
+    if (info->base[namelen - 1] != dirsep)
     {
-        retval[namelen] = dirsep;
-        retval[namelen + 1] = '\0';
+        info->base[namelen] = dirsep;
+        info->base[namelen + 1] = '\0';
     } /* if */
 
-    return retval;
+    /* (names) only gets filled in if a lookup misses while ignoring case. */
+    GOTO_IF_ERRPASS(!__PHYSFS_DirTreeInit(&info->names, sizeof (DIRentry), 0),
+                    DIR_openArchive_failed);
+    info->ignorecase = info->names.ignorecase;
+    if (info->ignorecase)
+    {
+        info->lock = __PHYSFS_platformCreateMutex();
+        GOTO_IF_ERRPASS(!info->lock, DIR_openArchive_failed);
+    } /* if */
+
+    if ((!forWriting) && (PHYSFS_directoriesSnapshotted()))
+        GOTO_IF_ERRPASS(!buildSnapshot(info, &st), DIR_openArchive_failed);
+
+    return info;
+
+DIR_openArchive_failed:
+    if (info->snapshot)
+        __PHYSFS_DirTreeDeinit(&info->snap);
+    if (info->lock)
+        __PHYSFS_platformDestroyMutex(info->lock);
+    __PHYSFS_DirTreeDeinit(&info->names);
+    allocator.Free(info->base);
+    allocator.Free(info);
+    return NULL;
 } /* DIR_openArchive */
 
 
+typedef struct
+{
+    DIRinfo *info;
+    const char *prefix;  /* path of the dir being listed, "" for the root. */
+    PHYSFS_ErrorCode errcode;
+} DIRlistData;
+
+static PHYSFS_EnumerateCallbackResult listDirCallback(void *_data,
+                                     const char *origdir, const char *fname)
+{
+    DIRlistData *data = (DIRlistData *) _data;
+    const size_t prefixlen = strlen(data->prefix);
+    const size_t len = prefixlen + strlen(fname) + 2;
+    char *path = (char *) __PHYSFS_smallAlloc(len);
+    void *entry;
+
+    if (!path)
+    {
+        data->errcode = PHYSFS_ERR_OUT_OF_MEMORY;
+        return PHYSFS_ENUM_ERROR;
+    } /* if */
+
+    snprintf(path, len, "%s%s%s", data->prefix, prefixlen ? "/" : "", fname);
+    entry = __PHYSFS_DirTreeAdd(&data->info->names, path, 0);
+    __PHYSFS_smallFree(path);
+
+    if (!entry)
+    {
+        data->errcode = PHYSFS_getLastErrorCode();
+        return PHYSFS_ENUM_ERROR;
+    } /* if */
+
+    return PHYSFS_ENUM_OK;
+} /* listDirCallback */
+
+
+/*
+ * Make sure (entry)'s kids are in (info->names). Returns 1 on success, -1 if
+ *  (entry) changed since it was listed, so everything we know might be
+ *  stale and should be thrown out, or 0 on error.
+ */
+static int listDir(DIRinfo *info, DIRentry *entry)
+{
+    const int isroot = (entry == (DIRentry *) info->names.root);
+    const char *name = isroot ? "" : entry->tree.name;
+    PHYSFS_EnumerateCallbackResult rc;
+    DIRlistData data;
+    PHYSFS_Stat st;
+    char *d;
+
+    CVT_TO_DEPENDENT(d, info, name);
+    BAIL_IF_ERRPASS(!d, 0);
+    if (!__PHYSFS_platformStat(d, &st, 1))
+    {
+        __PHYSFS_smallFree(d);
+        return entry->listed ? -1 : 0;
+    } /* if */
+    else if (st.filetype != PHYSFS_FILETYPE_DIRECTORY)
+    {
+        __PHYSFS_smallFree(d);
+        if (entry->listed)
+            return -1;
+        BAIL(PHYSFS_ERR_NOT_FOUND, 0);
+    } /* else if */
+    else if (entry->listed)
+    {
+        __PHYSFS_smallFree(d);
+        return (st.modtime == entry->modtime) ? 1 : -1;
+    } /* else if */
+
+    entry->tree.isdir = 1;
+    data.info = info;
+    data.prefix = name;
+    data.errcode = PHYSFS_ERR_OK;
+    rc = __PHYSFS_platformEnumerate(d, listDirCallback, "", &data);
+    __PHYSFS_smallFree(d);
+    if (rc == PHYSFS_ENUM_ERROR)
+    {
+        BAIL_IF(data.errcode != PHYSFS_ERR_OK, data.errcode, 0);
+        BAIL_ERRPASS(0);
+    } /* if */
+
+    entry->listed = 1;
+    entry->modtime = st.modtime;
+    info->listed++;
+    return 1;
+} /* listDir */
+
+
+/*
+ * Find the real case of (name), one piece at a time, listing directories as
+ *  we go. Only used when an exact match failed, so this doesn't slow down
+ *  paths that are already right. Returns a copy of the real path, or NULL.
+ */
+static char *locateCorrectCase(DIRinfo *info, const char *name)
+{
+    const size_t len = strlen(name) + 1;
+    char *retval = NULL;
+    char *path;
+    int tries;
+
+    path = (char *) __PHYSFS_smallAlloc(len);
+    BAIL_IF(!path, PHYSFS_ERR_OUT_OF_MEMORY, NULL);
+
+    __PHYSFS_platformGrabMutex(info->lock);
+
+    /* if something changed on disk, start over fresh, but only once. */
+    for (tries = 0; (tries < 2) && (retval == NULL); tries++)
+    {
+        DIRentry *entry = (DIRentry *) info->names.root;
+        char *ptr;
+        int rc = 1;
+
+        strcpy(path, name);
+        for (ptr = path; (rc == 1) && (ptr != NULL); )
+        {
+            char *sep = strchr(ptr, '/');
+            if (sep)
+                *sep = '\0';
+
+            rc = listDir(info, entry);
+            if (rc == 1)
+            {
+                entry = (DIRentry *) __PHYSFS_DirTreeFind(&info->names, path);
+                if (!entry)
+                    rc = 0;
+            } /* if */
+
+            if (sep)
+                *sep = '/';
+            ptr = sep ? sep + 1 : NULL;
+        } /* for */
+
+        if (rc == 1)
+        {
+            retval = __PHYSFS_strdup(entry->tree.name);
+            if (!retval)
+                PHYSFS_setErrorCode(PHYSFS_ERR_OUT_OF_MEMORY);
+            break;
+        } /* if */
+        else if (rc == 0)
+            break;  /* not there, or a real error; either way, give up. */
+
+        /* stale. Throw it all out and list again. */
+        __PHYSFS_DirTreeDeinit(&info->names);
+        info->listed = 0;
+        if (!__PHYSFS_DirTreeInit(&info->names, sizeof (DIRentry), 0))
+            break;
+        info->names.ignorecase = 1;
+    } /* for */
+
+    __PHYSFS_platformReleaseMutex(info->lock);
+    __PHYSFS_smallFree(path);
+    return retval;
+} /* locateCorrectCase */
+
+
+/*
+ * Call this after something failed on (name). If it's worth trying again in
+ *  another case, returns the path to try; otherwise NULL, with the original
+ *  error still set.
+ */
+static char *retryWithCorrectCase(DIRinfo *info, const char *name)
+{
+    PHYSFS_ErrorCode err;
+    char *retval;
+
+    if (!info->ignorecase)
+        return NULL;
+
+    err = PHYSFS_getLastErrorCode();
+    if (err != PHYSFS_ERR_NOT_FOUND)
+    {
+        PHYSFS_setErrorCode(err);
+        return NULL;
+    } /* if */
+
+    retval = locateCorrectCase(info, name);
+    if ((retval != NULL) && (strcmp(retval, name) == 0))
+    {
+        allocator.Free(retval);  /* same thing that just failed. */
+        retval = NULL;
+    } /* if */
+
+    if (retval == NULL)
+        PHYSFS_setErrorCode(err);
+
+    return retval;
+} /* retryWithCorrectCase */
+
+
 static PHYSFS_EnumerateCallbackResult DIR_enumerate(void *opaque,
                          const char *dname, PHYSFS_EnumerateCallback cb,
                          const char *origdir, void *callbackdata)
 {
     char *d;
+    char *real;
     PHYSFS_EnumerateCallbackResult retval;
+    int missing;
+
+    const DIRsnapEntry *entry;
+
+    entry = findInSnapshot((DIRinfo *) opaque, dname, &missing);
+    if (entry != NULL)
+    {
+        const __PHYSFS_DirTreeEntry *i;
+        retval = PHYSFS_ENUM_OK;
+        for (i = entry->tree.children; i != NULL; i = i->sibling)
+        {
+            const char *ptr = strrchr(i->name, '/');
+            if (((const DIRsnapEntry *) i)->deleted)
+                continue;
+            retval = cb(callbackdata, origdir, ptr ? ptr + 1 : i->name);
+            BAIL_IF(retval == PHYSFS_ENUM_ERROR, PHYSFS_ERR_APP_CALLBACK,
+                    retval);
+            if (retval != PHYSFS_ENUM_OK)
+                break;
+        } /* for */
+        return retval;
+    } /* if */
+    BAIL_IF_ERRPASS(missing, PHYSFS_ENUM_ERROR);
+
     CVT_TO_DEPENDENT(d, opaque, dname);
     BAIL_IF_ERRPASS(!d, PHYSFS_ENUM_ERROR);
     retval = __PHYSFS_platformEnumerate(d, cb, origdir, callbackdata);
     __PHYSFS_smallFree(d);
+
+    if (retval == PHYSFS_ENUM_ERROR)
+    {
+        real = retryWithCorrectCase((DIRinfo *) opaque, dname);
+        if (real != NULL)
+        {
+            retval = DIR_enumerate(opaque, real, cb, origdir, callbackdata);
+            allocator.Free(real);
+        } /* if */
+    } /* if */
+
     return retval;
 } /* DIR_enumerate */
 
 
+PHYSFS_EnumerateCallbackResult __PHYSFS_DIR_enumerateWithStat(void *opaque,
+                              const char *dname,
+                              PHYSFS_EnumerateStatCallback cb,
+                              const char *origdir, void *callbackdata)
+{
+    const DIRsnapEntry *entry;
+    char *d;
+    char *real;
+    PHYSFS_EnumerateCallbackResult retval;
+    int missing;
+
+    entry = findInSnapshot((DIRinfo *) opaque, dname, &missing);
+    if (entry != NULL)
+    {
+        const __PHYSFS_DirTreeEntry *i;
+        retval = PHYSFS_ENUM_OK;
+        for (i = entry->tree.children; i != NULL; i = i->sibling)
+        {
+            const char *ptr = strrchr(i->name, '/');
+            if (((const DIRsnapEntry *) i)->deleted)
+                continue;
+            retval = cb(callbackdata, origdir, ptr ? ptr + 1 : i->name,
+                        &((const DIRsnapEntry *) i)->stat);
+            BAIL_IF(retval == PHYSFS_ENUM_ERROR, PHYSFS_ERR_APP_CALLBACK,
+                    retval);
+            if (retval != PHYSFS_ENUM_OK)
+                break;
+        } /* for */
+        return retval;
+    } /* if */
+    BAIL_IF_ERRPASS(missing, PHYSFS_ENUM_ERROR);
+
+    CVT_TO_DEPENDENT(d, opaque, dname);
+    BAIL_IF_ERRPASS(!d, PHYSFS_ENUM_ERROR);
+    retval = __PHYSFS_platformEnumerateWithStat(d, cb, origdir, callbackdata);
+    __PHYSFS_smallFree(d);
+
+    if (retval == PHYSFS_ENUM_ERROR)
+    {
+        real = retryWithCorrectCase((DIRinfo *) opaque, dname);
+        if (real != NULL)
+        {
+            retval = __PHYSFS_DIR_enumerateWithStat(opaque, real, cb, origdir,
+                                                    callbackdata);
+            allocator.Free(real);
+        } /* if */
+    } /* if */
+
+    return retval;
+} /* __PHYSFS_DIR_enumerateWithStat */
+
+
 static PHYSFS_Io *doOpen(void *opaque, const char *name, const int mode)
 {
     PHYSFS_Io *io = NULL;
@@ -110,7 +735,26 @@ static PHYSFS_Io *doOpen(void *opaque, const char *name, const int mode)
 
 static PHYSFS_Io *DIR_openRead(void *opaque, const char *filename)
 {
-    return doOpen(opaque, filename, 'r');
+    PHYSFS_Io *io;
+    int missing;
+    const DIRsnapEntry *entry = findInSnapshot((DIRinfo *) opaque, filename,
+                                               &missing);
+    BAIL_IF_ERRPASS(missing, NULL);
+    if (entry != NULL)  /* the snapshot knows the real case, too. */
+        return doOpen(opaque, entry->tree.name, 'r');
+
+    io = doOpen(opaque, filename, 'r');
+    if (io == NULL)
+    {
+        char *real = retryWithCorrectCase((DIRinfo *) opaque, filename);
+        if (real != NULL)
+        {
+            io = doOpen(opaque, real, 'r');
+            allocator.Free(real);
+        } /* if */
+    } /* if */
+
+    return io;
 } /* DIR_openRead */
 
 
@@ -152,21 +796,70 @@ static int DIR_mkdir(void *opaque, const char *name)
 } /* DIR_mkdir */
 
 
+int __PHYSFS_DIR_rename(void *opaque, const char *from, const char *to)
+{
+    int retval;
+    char *f;
+    char *t;
+
+    CVT_TO_DEPENDENT(f, opaque, from);
+    BAIL_IF_ERRPASS(!f, 0);
+    CVT_TO_DEPENDENT(t, opaque, to);
+    if (!t)
+    {
+        __PHYSFS_smallFree(f);
+        BAIL_ERRPASS(0);
+    } /* if */
+
+    retval = __PHYSFS_platformRename(f, t);
+    __PHYSFS_smallFree(t);
+    __PHYSFS_smallFree(f);
+    return retval;
+} /* __PHYSFS_DIR_rename */
+
+
 static void DIR_closeArchive(void *opaque)
 {
-    allocator.Free(opaque);
+    DIRinfo *info = (DIRinfo *) opaque;
+    __PHYSFS_DirTreeDeinit(&info->names);
+    if (info->snapshot)
+        __PHYSFS_DirTreeDeinit(&info->snap);
+    if (info->lock)
+        __PHYSFS_platformDestroyMutex(info->lock);
+    allocator.Free(info->base);
+    allocator.Free(info);
 } /* DIR_closeArchive */
 
 
 static int DIR_stat(void *opaque, const char *name, PHYSFS_Stat *stat)
 {
     int retval = 0;
+    int missing;
     char *d;
+    const DIRsnapEntry *entry = findInSnapshot((DIRinfo *) opaque, name,
+                                               &missing);
+    BAIL_IF_ERRPASS(missing, 0);
+    if (entry != NULL)
+    {
+        memcpy(stat, &entry->stat, sizeof (*stat));
+        return 1;
+    } /* if */
 
     CVT_TO_DEPENDENT(d, opaque, name);
     BAIL_IF_ERRPASS(!d, 0);
     retval = __PHYSFS_platformStat(d, stat, 0);
     __PHYSFS_smallFree(d);
+
+    if (!retval)
+    {
+        char *real = retryWithCorrectCase((DIRinfo *) opaque, name);
+        if (real != NULL)
+        {
+            retval = DIR_stat(opaque, real, stat);
+            allocator.Free(real);
+        } /* if */
+    } /* if */
+
     return retval;
 } /* DIR_stat */
 
@@ -74,7 +74,7 @@ static void *HOG_openArchive(PHYSFS_Io *io, const char *name,
 
     *claimed = 1;
 
-    unpkarc = UNPK_openArchive(io);
+    unpkarc = UNPK_openArchive(io, 0);
     BAIL_IF_ERRPASS(!unpkarc, NULL);
 
     if (!hogLoadEntries(io, unpkarc))
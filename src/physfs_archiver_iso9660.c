@@ -39,15 +39,150 @@
    fields aren't aligned anyhow, so you have to serialize them in any case
    to avoid crashes on many CPU archs in any case. */
 
-static int iso9660LoadEntries(PHYSFS_Io *io, const int joliet,
-                              const char *base, const PHYSFS_uint64 dirstart,
-                              const PHYSFS_uint64 dirend, void *unpkarc);
+static inline PHYSFS_uint16 iso9660ReadLE16(const PHYSFS_uint8 *ptr)
+{
+    return (PHYSFS_uint16) (((PHYSFS_uint16) ptr[0]) |
+                            (((PHYSFS_uint16) ptr[1]) << 8));
+} /* iso9660ReadLE16 */
+
+static inline PHYSFS_uint32 iso9660ReadLE32(const PHYSFS_uint8 *ptr)
+{
+    return ((PHYSFS_uint32) ptr[0]) |
+           (((PHYSFS_uint32) ptr[1]) << 8) |
+           (((PHYSFS_uint32) ptr[2]) << 16) |
+           (((PHYSFS_uint32) ptr[3]) << 24);
+} /* iso9660ReadLE32 */
+
+
+/*
+ * Directories are loaded a level at a time: each one's whole extent is read
+ *  (or just looked at, if the image is already in memory) in one go and
+ *  parsed from there, and the subdirectories it lists are queued for the
+ *  next level. Each level is loaded in extent order, and mastering tools
+ *  lay directories out a level at a time, so this mostly reads the image
+ *  front to back instead of seeking all over it.
+ */
+/* No real directory's records need more than this; it's a corrupt image. */
+#define ISO9660_MAX_DIR_EXTENT (16 * 1024 * 1024)
+
+typedef struct ISO9660Dir
+{
+    char *path;
+    PHYSFS_uint64 pos;
+    PHYSFS_uint64 len;
+} ISO9660Dir;
+
+typedef struct ISO9660DirList
+{
+    ISO9660Dir *dirs;
+    size_t count;
+    size_t allocated;
+} ISO9660DirList;
+
+static int iso9660QueueDir(ISO9660DirList *list, const char *path,
+                           const PHYSFS_uint64 pos, const PHYSFS_uint64 len)
+{
+    ISO9660Dir *dir;
+
+    if (list->count >= list->allocated)
+    {
+        const size_t newalloc = list->allocated ? list->allocated * 2 : 32;
+        void *ptr = allocator.Realloc(list->dirs,
+                                      newalloc * sizeof (ISO9660Dir));
+        BAIL_IF(!ptr, PHYSFS_ERR_OUT_OF_MEMORY, 0);
+        list->dirs = (ISO9660Dir *) ptr;
+        list->allocated = newalloc;
+    } /* if */
+
+    dir = &list->dirs[list->count];
+    dir->path = (char *) allocator.Malloc(strlen(path) + 1);
+    BAIL_IF(!dir->path, PHYSFS_ERR_OUT_OF_MEMORY, 0);
+    strcpy(dir->path, path);
+    dir->pos = pos;
+    dir->len = len;
+    list->count++;
+    return 1;
+} /* iso9660QueueDir */
+
+static void iso9660ClearDirs(ISO9660DirList *list)
+{
+    size_t i;
+    for (i = 0; i < list->count; i++)
+        allocator.Free(list->dirs[i].path);
+    list->count = 0;
+} /* iso9660ClearDirs */
+
+static int iso9660DirCmp(void *_a, size_t one, size_t two)
+{
+    const ISO9660Dir *a = ((const ISO9660Dir *) _a) + one;
+    const ISO9660Dir *b = ((const ISO9660Dir *) _a) + two;
+    if (a->pos != b->pos)
+        return (a->pos < b->pos) ? -1 : 1;
+    return 0;
+} /* iso9660DirCmp */
+
+static void iso9660DirSwap(void *_a, size_t one, size_t two)
+{
+    ISO9660Dir *dirs = (ISO9660Dir *) _a;
+    ISO9660Dir tmp;
+    memcpy(&tmp, &dirs[one], sizeof (ISO9660Dir));
+    memcpy(&dirs[one], &dirs[two], sizeof (ISO9660Dir));
+    memcpy(&dirs[two], &tmp, sizeof (ISO9660Dir));
+} /* iso9660DirSwap */
+
+
+/*
+ * Every directory extent parsed so far, kept sorted, so a subdirectory
+ *  record that points back at an ancestor (or at anything else we've
+ *  already seen) fails the mount instead of queueing the same extents
+ *  forever. (level) is sorted by position already; this merges it in from
+ *  the back.
+ */
+static int iso9660MarkVisited(PHYSFS_uint64 **_visited, size_t *_count,
+                              const ISO9660DirList *level)
+{
+    PHYSFS_uint64 *visited;
+    size_t i = *_count;
+    size_t j = level->count;
+    size_t k = i + j;
+    void *ptr;
+
+    for (j = 1; j < level->count; j++)
+    {
+        BAIL_IF(level->dirs[j - 1].pos == level->dirs[j].pos,
+                PHYSFS_ERR_CORRUPT, 0);
+    } /* for */
+
+    ptr = allocator.Realloc(*_visited, k * sizeof (PHYSFS_uint64));
+    BAIL_IF(!ptr, PHYSFS_ERR_OUT_OF_MEMORY, 0);
+    visited = *_visited = (PHYSFS_uint64 *) ptr;
+
+    j = level->count;
+    while (j > 0)
+    {
+        const PHYSFS_uint64 pos = level->dirs[j - 1].pos;
+        if ((i > 0) && (visited[i - 1] >= pos))
+        {
+            BAIL_IF(visited[i - 1] == pos, PHYSFS_ERR_CORRUPT, 0);
+            visited[--k] = visited[--i];
+        } /* if */
+        else
+        {
+            visited[--k] = pos;
+            j--;
+        } /* else */
+    } /* while */
 
-static int iso9660AddEntry(PHYSFS_Io *io, const int joliet, const int isdir,
+    *_count += level->count;
+    return 1;
+} /* iso9660MarkVisited */
+
+
+static int iso9660AddEntry(const int joliet, const int isdir,
                            const char *base, PHYSFS_uint8 *fname,
                            const int fnamelen, const PHYSFS_sint64 ts,
                            const PHYSFS_uint64 pos, const PHYSFS_uint64 len,
-                           void *unpkarc)
+                           ISO9660DirList *subdirs, void *unpkarc)
 {
     char *fullpath;
     char *fnamecpy;
@@ -115,9 +250,12 @@ static int iso9660AddEntry(PHYSFS_Io *io, const int joliet, const int isdir,
     } /* else */
 
     entry = UNPK_addEntry(unpkarc, fullpath, isdir, ts, ts, pos, len);
-    if ((entry) && (isdir))
+
+    /* if this lost to an earlier file that only differs in case, there's
+       nothing to put its children in. A directory merges with the winner. */
+    if ((entry) && (isdir) && (((__PHYSFS_DirTreeEntry *) entry)->isdir))
     {
-        if (!iso9660LoadEntries(io, joliet, fullpath, pos, pos + len, unpkarc))
+        if (!iso9660QueueDir(subdirs, fullpath, pos, len))
             entry = NULL;  /* so we report a failure later. */
     } /* if */
 
@@ -125,20 +263,23 @@ static int iso9660AddEntry(PHYSFS_Io *io, const int joliet, const int isdir,
     return entry != NULL;
 } /* iso9660AddEntry */
 
-static int iso9660LoadEntries(PHYSFS_Io *io, const int joliet,
-                              const char *base, const PHYSFS_uint64 dirstart,
-                              const PHYSFS_uint64 dirend, void *unpkarc)
+/* parse the directory records in (buf), which is a whole directory extent. */
+static int iso9660ParseDir(const PHYSFS_uint8 *buf, const PHYSFS_uint64 buflen,
+                           const int joliet, const ISO9660Dir *dir,
+                           ISO9660DirList *subdirs, void *unpkarc)
 {
-    PHYSFS_uint64 readpos = dirstart;
+    PHYSFS_uint64 readpos = 0;
+    PHYSFS_uint8 lasttime[6];
+    PHYSFS_sint64 lastts = 0;
+    int havelast = 0;
 
-    while (1)
+    while (readpos < buflen)
     {
-        PHYSFS_uint8 recordlen;
+        const PHYSFS_uint8 *rec = buf + readpos;
+        const PHYSFS_uint8 recordlen = rec[0];
         PHYSFS_uint8 extattrlen;
-        PHYSFS_uint32 extent;
+        PHYSFS_uint64 extent;
         PHYSFS_uint32 datalen;
-        PHYSFS_uint8 ignore[4];
-        PHYSFS_uint8 year, month, day, hour, minute, second, offset;
         PHYSFS_uint8 flags;
         PHYSFS_uint8 fnamelen;
         PHYSFS_uint8 fname[256];
@@ -147,81 +288,154 @@ static int iso9660LoadEntries(PHYSFS_Io *io, const int joliet,
         int isdir;
         int multiextent;
 
-        BAIL_IF_ERRPASS(!io->seek(io, readpos), 0);
-
-        /* recordlen = 0 -> no more entries or fill entry */
-        BAIL_IF_ERRPASS(!__PHYSFS_readAll(io, &recordlen, 1), 0);
-        if (recordlen > 0)
-            readpos += recordlen;  /* ready to seek to next record. */
-        else
+        /* recordlen = 0 -> no more entries in this sector, or fill entry */
+        if (recordlen == 0)
         {
-            PHYSFS_uint64 nextpos;
-
-            /* if we are in the last sector of the directory & it's 0 -> end */
-            if ((dirend - 2048) <= (readpos - 1))
-                break; /* finished */
+            readpos = ((readpos / 2048) + 1) * 2048;
+            continue;  /* if that was the last sector, we're done. */
+        } /* if */
 
-            /* else skip to the next sector & continue; */
-            nextpos = (((readpos - 1) / 2048) + 1) * 2048;
+        BAIL_IF(recordlen < 33, PHYSFS_ERR_CORRUPT, 0);
+        BAIL_IF(recordlen > buflen - readpos, PHYSFS_ERR_CORRUPT, 0);
+        readpos += recordlen;  /* ready for the next record. */
 
-            /* whoops, can't make forward progress! */
-            BAIL_IF(nextpos == readpos, PHYSFS_ERR_CORRUPT, 0);
+        extattrlen = rec[1];
+        extent = (PHYSFS_uint64) iso9660ReadLE32(rec + 2);  /* 6: extent be */
+        datalen = iso9660ReadLE32(rec + 10);  /* 14: datalen be */
 
-            readpos = nextpos;
-            continue;  /* start back at upper loop. */
-        } /* else */
+        /* record timestamp, 18 through 24. mktime() is slow, and whole
+           discs are often mastered in the same second, so reuse the last. */
+        if ((!havelast) || (memcmp(lasttime, rec + 18, 6) != 0))
+        {
+            t.tm_sec = rec[23];
+            t.tm_min = rec[22];
+            t.tm_hour = rec[21];
+            t.tm_mday = rec[20];
+            t.tm_mon = rec[19] - 1;
+            t.tm_year = rec[18];
+            t.tm_wday = 0;
+            t.tm_yday = 0;
+            t.tm_isdst = -1;
+            lastts = (PHYSFS_sint64) mktime(&t);
+            memcpy(lasttime, rec + 18, 6);
+            havelast = 1;
+        } /* if */
+        timestamp = lastts;
 
-        BAIL_IF_ERRPASS(!__PHYSFS_readAll(io, &extattrlen, 1), 0);
-        BAIL_IF_ERRPASS(!__PHYSFS_readAll(io, &extent, 4), 0);
-        BAIL_IF_ERRPASS(!__PHYSFS_readAll(io, ignore, 4), 0); /* extent be */
-        BAIL_IF_ERRPASS(!__PHYSFS_readAll(io, &datalen, 4), 0);
-        BAIL_IF_ERRPASS(!__PHYSFS_readAll(io, ignore, 4), 0); /* datalen be */
-
-        /* record timestamp */
-        BAIL_IF_ERRPASS(!__PHYSFS_readAll(io, &year, 1), 0);
-        BAIL_IF_ERRPASS(!__PHYSFS_readAll(io, &month, 1), 0);
-        BAIL_IF_ERRPASS(!__PHYSFS_readAll(io, &day, 1), 0);
-        BAIL_IF_ERRPASS(!__PHYSFS_readAll(io, &hour, 1), 0);
-        BAIL_IF_ERRPASS(!__PHYSFS_readAll(io, &minute, 1), 0);
-        BAIL_IF_ERRPASS(!__PHYSFS_readAll(io, &second, 1), 0);
-        BAIL_IF_ERRPASS(!__PHYSFS_readAll(io, &offset, 1), 0);
-
-        BAIL_IF_ERRPASS(!__PHYSFS_readAll(io, &flags, 1), 0);
+        flags = rec[25];
         isdir = (flags & (1 << 1)) != 0;
         multiextent = (flags & (1 << 7)) != 0;
         BAIL_IF(multiextent, PHYSFS_ERR_UNSUPPORTED, 0);  /* !!! FIXME */
 
-        BAIL_IF_ERRPASS(!__PHYSFS_readAll(io, ignore, 1), 0); /* unit size */
-        BAIL_IF_ERRPASS(!__PHYSFS_readAll(io, ignore, 1), 0); /* interleave gap */
-        BAIL_IF_ERRPASS(!__PHYSFS_readAll(io, ignore, 2), 0); /* seqnum le */
-        BAIL_IF_ERRPASS(!__PHYSFS_readAll(io, ignore, 2), 0); /* seqnum be */
-        BAIL_IF_ERRPASS(!__PHYSFS_readAll(io, &fnamelen, 1), 0);
-        BAIL_IF_ERRPASS(!__PHYSFS_readAll(io, fname, fnamelen), 0);
-
-        t.tm_sec = second;
-        t.tm_min = minute;
-        t.tm_hour = hour;
-        t.tm_mday = day;
-        t.tm_mon = month - 1;
-        t.tm_year = year;
-        t.tm_wday = 0;
-        t.tm_yday = 0;
-        t.tm_isdst = -1;
-        timestamp = (PHYSFS_sint64) mktime(&t);
+        /* 26: unit size, 27: interleave gap, 28: seqnum le, 30: seqnum be */
+        fnamelen = rec[32];
+        BAIL_IF(33 + fnamelen > recordlen, PHYSFS_ERR_CORRUPT, 0);
+        memcpy(fname, rec + 33, fnamelen);  /* Joliet swaps this in place. */
+
+        if (fnamelen == 1 && ((fname[0] == 0) || (fname[0] == 1)))
+            continue;  /* Magic that represents "." and "..", ignore */
 
         extent += extattrlen;  /* skip extended attribute record. */
 
         /* infinite loop, corrupt file? */
-        BAIL_IF((extent * 2048) == dirstart, PHYSFS_ERR_CORRUPT, 0);
+        BAIL_IF((extent * 2048) == dir->pos, PHYSFS_ERR_CORRUPT, 0);
 
-        if (!iso9660AddEntry(io, joliet, isdir, base, fname, fnamelen,
-                             timestamp, extent * 2048, datalen, unpkarc))
+        if (!iso9660AddEntry(joliet, isdir, dir->path, fname, fnamelen,
+                             timestamp, extent * 2048, datalen, subdirs,
+                             unpkarc))
         {
             return 0;
         } /* if */
     } /* while */
 
     return 1;
+} /* iso9660ParseDir */
+
+static int iso9660LoadEntries(PHYSFS_Io *io, const int joliet,
+                              const PHYSFS_uint64 rootpos,
+                              const PHYSFS_uint64 rootlen, void *unpkarc)
+{
+    ISO9660DirList level;
+    ISO9660DirList next;
+    ISO9660DirList tmp;
+    PHYSFS_uint8 *buf = NULL;
+    PHYSFS_uint64 bufalloc = 0;
+    PHYSFS_uint64 *visited = NULL;
+    size_t visitedcount = 0;
+    const PHYSFS_sint64 archlen = io->length(io);
+    int retval = 0;
+    size_t i;
+
+    BAIL_IF_ERRPASS(archlen < 0, 0);
+    memset(&level, '\0', sizeof (level));
+    memset(&next, '\0', sizeof (next));
+    GOTO_IF_ERRPASS(!iso9660QueueDir(&level, "", rootpos, rootlen),
+                    loadEntries_end);
+
+    while (level.count > 0)
+    {
+        __PHYSFS_sort(level.dirs, level.count, iso9660DirCmp, iso9660DirSwap);
+        GOTO_IF_ERRPASS(!iso9660MarkVisited(&visited, &visitedcount, &level),
+                        loadEntries_end);
+
+        for (i = 0; i < level.count; i++)
+        {
+            const ISO9660Dir *dir = &level.dirs[i];
+            const PHYSFS_uint8 *ptr;
+
+            /* check it against the image before we allocate for it. */
+            GOTO_IF((dir->len > ISO9660_MAX_DIR_EXTENT) ||
+                    (dir->pos > (PHYSFS_uint64) archlen) ||
+                    (dir->len > ((PHYSFS_uint64) archlen) - dir->pos),
+                    PHYSFS_ERR_CORRUPT, loadEntries_end);
+
+            ptr = (const PHYSFS_uint8 *)
+                    __PHYSFS_ioMappedRange(io, dir->pos, dir->len);
+            if (ptr == NULL)
+            {
+                if (dir->len > bufalloc)
+                {
+                    void *newbuf;
+                    GOTO_IF(!__PHYSFS_ui64FitsAddressSpace(dir->len),
+                            PHYSFS_ERR_OUT_OF_MEMORY, loadEntries_end);
+                    newbuf = allocator.Realloc(buf, (size_t) dir->len);
+                    GOTO_IF(!newbuf, PHYSFS_ERR_OUT_OF_MEMORY,
+                            loadEntries_end);
+                    buf = (PHYSFS_uint8 *) newbuf;
+                    bufalloc = dir->len;
+                } /* if */
+
+                GOTO_IF_ERRPASS(!io->seek(io, dir->pos), loadEntries_end);
+                GOTO_IF_ERRPASS(!__PHYSFS_readAll(io, buf, dir->len),
+                                loadEntries_end);
+                ptr = buf;
+            } /* if */
+
+            GOTO_IF_ERRPASS(!iso9660ParseDir(ptr, dir->len, joliet, dir,
+                                             &next, unpkarc),
+                            loadEntries_end);
+        } /* for */
+
+        iso9660ClearDirs(&level);
+        tmp = level;
+        level = next;
+        next = tmp;
+    } /* while */
+
+    retval = 1;
+
+loadEntries_end:
+    iso9660ClearDirs(&level);
+    iso9660ClearDirs(&next);
+    if (level.dirs != NULL)
+        allocator.Free(level.dirs);
+    if (next.dirs != NULL)
+        allocator.Free(next.dirs);
+    if (buf != NULL)
+        allocator.Free(buf);
+    if (visited != NULL)
+        allocator.Free(visited);
+    return retval;
 } /* iso9660LoadEntries */
 
 
@@ -237,23 +451,21 @@ static int parseVolumeDescriptor(PHYSFS_Io *io, PHYSFS_uint64 *_rootpos,
 
     while (!done)
     {
+        PHYSFS_uint8 desc[2048];  /* each volume descriptor is 2048 bytes */
         PHYSFS_uint8 type;
-        PHYSFS_uint8 identifier[5];
-        PHYSFS_uint8 version;
         PHYSFS_uint8 flags;
-        PHYSFS_uint8 escapeseqs[32];
-        PHYSFS_uint8 ignore[32];
+        const PHYSFS_uint8 *escapeseqs;
         PHYSFS_uint16 blocksize;
         PHYSFS_uint32 extent;
         PHYSFS_uint32 datalen;
 
         BAIL_IF_ERRPASS(!io->seek(io, pos), 0);
-        pos += 2048;  /* each volume descriptor is 2048 bytes */
+        pos += 2048;
 
-        BAIL_IF_ERRPASS(!__PHYSFS_readAll(io, &type, 1), 0);
-        BAIL_IF_ERRPASS(!__PHYSFS_readAll(io, &identifier, 5), 0);
+        BAIL_IF_ERRPASS(!__PHYSFS_readAll(io, desc, sizeof (desc)), 0);
+        type = desc[0];
 
-        if (memcmp(identifier, "CD001", 5) != 0)  /* maybe not an iso? */
+        if (memcmp(desc + 1, "CD001", 5) != 0)  /* maybe not an iso? */
         {
             BAIL_IF(!*_claimed, PHYSFS_ERR_UNSUPPORTED, 0);
             continue;  /* just skip this one */
@@ -261,39 +473,20 @@ static int parseVolumeDescriptor(PHYSFS_Io *io, PHYSFS_uint64 *_rootpos,
 
         *_claimed = 1; /* okay, this is probably an iso. */
 
-        BAIL_IF_ERRPASS(!__PHYSFS_readAll(io, &version, 1), 0);  /* version */
-        BAIL_IF(version != 1, PHYSFS_ERR_UNSUPPORTED, 0);
-
-        BAIL_IF_ERRPASS(!__PHYSFS_readAll(io, &flags, 1), 0);
-        BAIL_IF_ERRPASS(!__PHYSFS_readAll(io, ignore, 32), 0);  /* system id */
-        BAIL_IF_ERRPASS(!__PHYSFS_readAll(io, ignore, 32), 0);  /* volume id */
-        BAIL_IF_ERRPASS(!__PHYSFS_readAll(io, ignore, 8), 0);  /* reserved */
-        BAIL_IF_ERRPASS(!__PHYSFS_readAll(io, ignore, 4), 0);  /* space le */
-        BAIL_IF_ERRPASS(!__PHYSFS_readAll(io, ignore, 4), 0);  /* space be */
-        BAIL_IF_ERRPASS(!__PHYSFS_readAll(io, escapeseqs, 32), 0);
-        BAIL_IF_ERRPASS(!__PHYSFS_readAll(io, ignore, 2), 0);  /* setsize le */
-        BAIL_IF_ERRPASS(!__PHYSFS_readAll(io, ignore, 2), 0);  /* setsize be */
-        BAIL_IF_ERRPASS(!__PHYSFS_readAll(io, ignore, 2), 0);  /* seq num le */
-        BAIL_IF_ERRPASS(!__PHYSFS_readAll(io, ignore, 2), 0);  /* seq num be */
-        BAIL_IF_ERRPASS(!__PHYSFS_readAll(io, &blocksize, 2), 0);
-        BAIL_IF_ERRPASS(!__PHYSFS_readAll(io, ignore, 2), 0); /* blocklen be */
-        BAIL_IF_ERRPASS(!__PHYSFS_readAll(io, ignore, 4), 0); /* pthtablen le */
-        BAIL_IF_ERRPASS(!__PHYSFS_readAll(io, ignore, 4), 0); /* pthtablen be */
-        BAIL_IF_ERRPASS(!__PHYSFS_readAll(io, ignore, 4), 0); /* pthtabpos le */
-        BAIL_IF_ERRPASS(!__PHYSFS_readAll(io, ignore, 4), 0); /* optpthtabpos le */
-        BAIL_IF_ERRPASS(!__PHYSFS_readAll(io, ignore, 4), 0); /* pthtabpos be */
-        BAIL_IF_ERRPASS(!__PHYSFS_readAll(io, ignore, 4), 0); /* optpthtabpos be */
-
-        /* root directory record... */
-        BAIL_IF_ERRPASS(!__PHYSFS_readAll(io, ignore, 1), 0); /* len */
-        BAIL_IF_ERRPASS(!__PHYSFS_readAll(io, ignore, 1), 0); /* attr len */
-        BAIL_IF_ERRPASS(!__PHYSFS_readAll(io, &extent, 4), 0);
-        BAIL_IF_ERRPASS(!__PHYSFS_readAll(io, ignore, 4), 0); /* extent be */
-        BAIL_IF_ERRPASS(!__PHYSFS_readAll(io, &datalen, 4), 0);
-        BAIL_IF_ERRPASS(!__PHYSFS_readAll(io, ignore, 4), 0); /* datalen be */
+        BAIL_IF(desc[6] != 1, PHYSFS_ERR_UNSUPPORTED, 0);  /* version */
+
+        /* 8: system id, 40: volume id, 72: reserved, 80: space le/be */
+        flags = desc[7];
+        escapeseqs = desc + 88;
+        /* 120: setsize le/be, 124: seq num le/be */
+        blocksize = iso9660ReadLE16(desc + 128);  /* 130: blocklen be */
+        /* 132: path table lengths, 140: path table positions */
+
+        /* root directory record: 156: len, 157: attr len */
+        extent = iso9660ReadLE32(desc + 158);  /* 162: extent be */
+        datalen = iso9660ReadLE32(desc + 166);  /* 170: datalen be */
 
         /* !!! FIXME: deal with this properly. */
-        blocksize = PHYSFS_swapULE32(blocksize);
         BAIL_IF(blocksize && (blocksize != 2048), PHYSFS_ERR_UNSUPPORTED, 0);
 
         switch (type)
@@ -302,8 +495,8 @@ static int parseVolumeDescriptor(PHYSFS_Io *io, PHYSFS_uint64 *_rootpos,
             case 2:  /* Supplementary Volume Descriptor */
                 if (found < type)
                 {
-                    *_rootpos = PHYSFS_swapULE32(extent) * 2048;
-                    *_rootlen = PHYSFS_swapULE32(datalen);
+                    *_rootpos = ((PHYSFS_uint64) extent) * 2048;
+                    *_rootlen = datalen;
                     found = type;
 
                     if (found == 2)  /* possible Joliet volume */
@@ -338,6 +531,7 @@ static void *ISO9660_openArchive(PHYSFS_Io *io, const char *filename,
     PHYSFS_uint64 len = 0;
     int joliet = 0;
     void *unpkarc = NULL;
+    PHYSFS_uint64 key[3];
 
     assert(io != NULL);  /* shouldn't ever happen. */
 
@@ -346,15 +540,23 @@ static void *ISO9660_openArchive(PHYSFS_Io *io, const char *filename,
     if (!parseVolumeDescriptor(io, &rootpos, &len, &joliet, claimed))
         return NULL;
 
-    unpkarc = UNPK_openArchive(io);
+    unpkarc = UNPK_openArchive(io, 0);
     BAIL_IF_ERRPASS(!unpkarc, NULL);
 
-    if (!iso9660LoadEntries(io, joliet, "", rootpos, rootpos + len, unpkarc))
+    key[0] = rootpos;
+    key[1] = len;
+    key[2] = (PHYSFS_uint64) joliet;
+    if (UNPK_loadIndexCache(unpkarc, filename, "iso9660", key, sizeof (key)))
+        return unpkarc;
+
+    if (!iso9660LoadEntries(io, joliet, rootpos, len, unpkarc))
     {
         UNPK_abandonArchive(unpkarc);
         return NULL;
     } /* if */
 
+    UNPK_storeIndexCache(unpkarc, filename, "iso9660", key, sizeof (key));
+
     return unpkarc;
 } /* ISO9660_openArchive */
 
@@ -38,6 +38,8 @@ typedef struct
     PHYSFS_uint32 curPos;
 } UNPKfileinfo;
 
+static __PHYSFS_POOL(fileinfoPool, UNPKfileinfo);
+
 
 void UNPK_closeArchive(void *opaque)
 {
@@ -115,12 +117,28 @@ static PHYSFS_sint64 UNPK_length(PHYSFS_Io *io)
 } /* UNPK_length */
 
 
+static PHYSFS_sint64 UNPK_readAt(PHYSFS_Io *io, PHYSFS_uint64 offset,
+                                 void *buffer, PHYSFS_uint64 len)
+{
+    UNPKfileinfo *finfo = (UNPKfileinfo *) io->opaque;
+    const UNPKentry *entry = finfo->entry;
+
+    if (offset >= entry->size)
+        return 0;
+
+    if (len > entry->size - offset)
+        len = entry->size - offset;
+
+    return finfo->io->readAt(finfo->io, entry->startPos + offset, buffer, len);
+} /* UNPK_readAt */
+
+
 static PHYSFS_Io *UNPK_duplicate(PHYSFS_Io *_io)
 {
     UNPKfileinfo *origfinfo = (UNPKfileinfo *) _io->opaque;
     PHYSFS_Io *io = NULL;
-    PHYSFS_Io *retval = (PHYSFS_Io *) allocator.Malloc(sizeof (PHYSFS_Io));
-    UNPKfileinfo *finfo = (UNPKfileinfo *) allocator.Malloc(sizeof (UNPKfileinfo));
+    PHYSFS_Io *retval = (PHYSFS_Io *) __PHYSFS_poolAlloc(&__PHYSFS_ioPool);
+    UNPKfileinfo *finfo = (UNPKfileinfo *) __PHYSFS_poolAlloc(&fileinfoPool);
     GOTO_IF(!retval, PHYSFS_ERR_OUT_OF_MEMORY, UNPK_duplicate_failed);
     GOTO_IF(!finfo, PHYSFS_ERR_OUT_OF_MEMORY, UNPK_duplicate_failed);
 
@@ -134,8 +152,8 @@ static PHYSFS_Io *UNPK_duplicate(PHYSFS_Io *_io)
     return retval;
 
 UNPK_duplicate_failed:
-    if (finfo != NULL) allocator.Free(finfo);
-    if (retval != NULL) allocator.Free(retval);
+    __PHYSFS_poolFree(&fileinfoPool, finfo);
+    __PHYSFS_poolFree(&__PHYSFS_ioPool, retval);
     if (io != NULL) io->destroy(io);
     return NULL;
 } /* UNPK_duplicate */
@@ -146,8 +164,8 @@ static void UNPK_destroy(PHYSFS_Io *io)
 {
     UNPKfileinfo *finfo = (UNPKfileinfo *) io->opaque;
     finfo->io->destroy(finfo->io);
-    allocator.Free(finfo);
-    allocator.Free(io);
+    __PHYSFS_poolFree(&fileinfoPool, finfo);
+    __PHYSFS_poolFree(&__PHYSFS_ioPool, io);
 } /* UNPK_destroy */
 
 
@@ -161,7 +179,8 @@ static const PHYSFS_Io UNPK_Io =
     UNPK_length,
     UNPK_duplicate,
     UNPK_flush,
-    UNPK_destroy
+    UNPK_destroy,
+    UNPK_readAt
 };
 
 
@@ -181,13 +200,18 @@ PHYSFS_Io *UNPK_openRead(void *opaque, const char *name)
     BAIL_IF_ERRPASS(!entry, NULL);
     BAIL_IF(entry->tree.isdir, PHYSFS_ERR_NOT_A_FILE, NULL);
 
-    retval = (PHYSFS_Io *) allocator.Malloc(sizeof (PHYSFS_Io));
-    GOTO_IF(!retval, PHYSFS_ERR_OUT_OF_MEMORY, UNPK_openRead_failed);
+    /* if the archive is in memory, serve the entry straight from there. */
+    retval = __PHYSFS_ioMappedSubrange(info->io, entry->startPos, entry->size);
+    if (retval != NULL)
+        return retval;
+
+    retval = (PHYSFS_Io *) __PHYSFS_poolAlloc(&__PHYSFS_ioPool);
+    GOTO_IF_ERRPASS(!retval, UNPK_openRead_failed);
 
-    finfo = (UNPKfileinfo *) allocator.Malloc(sizeof (UNPKfileinfo));
-    GOTO_IF(!finfo, PHYSFS_ERR_OUT_OF_MEMORY, UNPK_openRead_failed);
+    finfo = (UNPKfileinfo *) __PHYSFS_poolAlloc(&fileinfoPool);
+    GOTO_IF_ERRPASS(!finfo, UNPK_openRead_failed);
 
-    finfo->io = info->io->duplicate(info->io);
+    finfo->io = __PHYSFS_ioShare(info->io);
     GOTO_IF_ERRPASS(!finfo->io, UNPK_openRead_failed);
 
     if (!finfo->io->seek(finfo->io, entry->startPos))
@@ -197,6 +221,8 @@ PHYSFS_Io *UNPK_openRead(void *opaque, const char *name)
     finfo->entry = entry;
 
     memcpy(retval, &UNPK_Io, sizeof (*retval));
+    if (!__PHYSFS_ioCanReadAt(finfo->io))
+        retval->readAt = NULL;
     retval->opaque = finfo;
     return retval;
 
@@ -205,12 +231,10 @@ UNPK_openRead_failed:
     {
         if (finfo->io != NULL)
             finfo->io->destroy(finfo->io);
-        allocator.Free(finfo);
+        __PHYSFS_poolFree(&fileinfoPool, finfo);
     } /* if */
 
-    if (retval != NULL)
-        allocator.Free(retval);
-
+    __PHYSFS_poolFree(&__PHYSFS_ioPool, retval);
     return NULL;
 } /* UNPK_openRead */
 
@@ -276,6 +300,10 @@ void *UNPK_addEntry(void *opaque, char *name, const int isdir,
     entry = (UNPKentry *) __PHYSFS_DirTreeAdd(&info->tree, name, isdir);
     BAIL_IF_ERRPASS(!entry, NULL);
 
+    /* ignoring case, and an earlier entry has this name? It wins. */
+    if (__PHYSFS_DirTreeOtherCase(&info->tree, entry, name))
+        return entry;
+
     entry->startPos = isdir ? 0 : pos;
     entry->size = isdir ? 0 : len;
     entry->ctime = ctime;
@@ -285,12 +313,12 @@ void *UNPK_addEntry(void *opaque, char *name, const int isdir,
 } /* UNPK_addEntry */
 
 
-void *UNPK_openArchive(PHYSFS_Io *io)
+void *UNPK_openArchive(PHYSFS_Io *io, const PHYSFS_uint64 count)
 {
     UNPKinfo *info = (UNPKinfo *) allocator.Malloc(sizeof (UNPKinfo));
     BAIL_IF(!info, PHYSFS_ERR_OUT_OF_MEMORY, NULL);
 
-    if (!__PHYSFS_DirTreeInit(&info->tree, sizeof (UNPKentry)))
+    if (!__PHYSFS_DirTreeInit(&info->tree, sizeof (UNPKentry), count))
     {
         allocator.Free(info);
         return NULL;
@@ -301,5 +329,22 @@ void *UNPK_openArchive(PHYSFS_Io *io)
     return info;
 } /* UNPK_openArchive */
 
+
+int UNPK_loadIndexCache(void *opaque, const char *name, const char *tag,
+                        const void *key, const size_t keylen)
+{
+    UNPKinfo *info = (UNPKinfo *) opaque;
+    return __PHYSFS_DirTreeLoadCache(&info->tree, name, tag, key, keylen,
+                                     NULL, 0);
+} /* UNPK_loadIndexCache */
+
+
+void UNPK_storeIndexCache(void *opaque, const char *name, const char *tag,
+                          const void *key, const size_t keylen)
+{
+    UNPKinfo *info = (UNPKinfo *) opaque;
+    __PHYSFS_DirTreeStoreCache(&info->tree, name, tag, key, keylen, NULL, 0);
+} /* UNPK_storeIndexCache */
+
 /* end of physfs_archiver_unpacked.c ... */
 
@@ -99,6 +99,7 @@ static void *VDF_openArchive(PHYSFS_Io *io, const char *name,
     PHYSFS_uint8 ignore[16];
     PHYSFS_uint8 sig[VDF_SIGNATURE_LENGTH];
     PHYSFS_uint32 count, timestamp, version, dataSize, rootCatOffset;
+    PHYSFS_uint32 key[3];
     void *unpkarc;
 
     assert(io != NULL); /* shouldn't ever happen. */
@@ -129,15 +130,23 @@ static void *VDF_openArchive(PHYSFS_Io *io, const char *name,
 
     BAIL_IF_ERRPASS(!io->seek(io, rootCatOffset), NULL);
 
-    unpkarc = UNPK_openArchive(io);
+    unpkarc = UNPK_openArchive(io, count);
     BAIL_IF_ERRPASS(!unpkarc, NULL);
 
+    key[0] = count;
+    key[1] = timestamp;
+    key[2] = rootCatOffset;
+    if (UNPK_loadIndexCache(unpkarc, name, "vdf", key, sizeof (key)))
+        return unpkarc;
+
     if (!vdfLoadEntries(io, count, vdfDosTimeToEpoch(timestamp), unpkarc))
     {
         UNPK_abandonArchive(unpkarc);
         return NULL;
     } /* if */
 
+    UNPK_storeIndexCache(unpkarc, name, "vdf", key, sizeof (key));
+
     return unpkarc;
 } /* VDF_openArchive */
 
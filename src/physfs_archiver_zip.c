@@ -52,6 +52,31 @@ typedef enum
 } ZipResolveType;
 
 
+/*
+ * A snapshot of inflate, taken while decompressing an entry, so a later seek
+ *  can pick up from here instead of the start of the entry. Snapshots are
+ *  only taken when all the compressed input read so far has been consumed,
+ *  so the state doesn't include anything from our read buffer.
+ */
+typedef struct
+{
+    PHYSFS_uint32 uncompressed_position;  /* tell() position here.      */
+    PHYSFS_uint32 compressed_position;    /* compressed bytes consumed. */
+    PHYSFS_uint32 crypto_keys[3];         /* for "traditional" crypto.  */
+    inflate_state *state;                 /* copy of the whole decoder. */
+} ZIPcheckpoint;
+
+/*
+ * Seek checkpoints for one entry, in order of position.
+ */
+typedef struct _ZIPcheckpoints
+{
+    struct _ZIPcheckpoints *next;  /* all of an archive's lists, to free. */
+    PHYSFS_uint32 count;
+    PHYSFS_uint32 capacity;
+    ZIPcheckpoint *points;
+} ZIPcheckpoints;
+
 /*
  * One ZIPentry is kept for each file in an open ZIP archive.
  */
@@ -70,6 +95,7 @@ typedef struct _ZIPentry
     PHYSFS_uint64 uncompressed_size;    /* uncompressed size              */
     PHYSFS_sint64 last_mod_time;        /* last file mod time             */
     PHYSFS_uint32 dos_mod_time;         /* original MS-DOS style mod time */
+    ZIPcheckpoints *checkpoints;        /* NULL or seek checkpoints.      */
 } ZIPentry;
 
 /*
@@ -81,23 +107,43 @@ typedef struct
     PHYSFS_Io *io;            /* the i/o interface for this archive.    */
     int zip64;                /* non-zero if this is a Zip64 archive.   */
     int has_crypto;           /* non-zero if any entry uses encryption. */
+    PHYSFS_Io *resolveio;     /* (io), or a view of it, for resolving.  */
+    void *lock;               /* serializes resolution, checkpoints.    */
+    ZIPcheckpoints *checkpoints;  /* every entry's seek checkpoints.    */
+    struct _ZIPfileinfo *spares;  /* closed files, to reuse.            */
+    PHYSFS_uint32 numspares;  /* number of files in (spares).           */
 } ZIPinfo;
 
 /*
  * One ZIPfileinfo is kept for each open file in a ZIP archive.
  */
-typedef struct
+typedef struct _ZIPfileinfo
 {
+    struct _ZIPfileinfo *next;            /* in (info->spares), closed. */
+    PHYSFS_Io self;                       /* what we hand out for this. */
+    ZIPinfo *info;                        /* Archive this file is in.   */
     ZIPentry *entry;                      /* Info on file.              */
     PHYSFS_Io *io;                        /* physical file handle.      */
     PHYSFS_uint32 compressed_position;    /* offset in compressed data. */
     PHYSFS_uint32 uncompressed_position;  /* tell() position.           */
     PHYSFS_uint8 *buffer;                 /* decompression buffer.      */
+    int bigbuffer;                        /* (buffer) was preloaded.    */
     PHYSFS_uint32 crypto_keys[3];         /* for "traditional" crypto.  */
     PHYSFS_uint32 initial_crypto_keys[3]; /* for "traditional" crypto.  */
     z_stream stream;                      /* zlib stream state.         */
+    __PHYSFS_ZipCodec *codec;             /* decoder if not deflate.    */
+    int cached;                           /* using the block cache?     */
+    PHYSFS_uint64 position;               /* tell() position, if cached. */
+    PHYSFS_Io *block;                     /* NULL or block we're in.    */
+    PHYSFS_uint64 block_index;            /* which block (block) is.    */
+    int verify;                           /* still checking (crc)?      */
+    PHYSFS_uint32 crc;                    /* CRC-32 of data read so far. */
+    PHYSFS_uint64 crcpos;                 /* ...which is this much.     */
 } ZIPfileinfo;
 
+/* behind the per-archive spares, for when those are full or empty. */
+static __PHYSFS_POOL(fileinfoPool, ZIPfileinfo);
+
 
 /* Magic numbers... */
 #define ZIP_LOCAL_FILE_SIG                          0x04034b50
@@ -109,6 +155,9 @@ typedef struct
 
 /* compression methods... */
 #define COMPMETH_NONE 0
+#define COMPMETH_DEFLATE 8
+#define COMPMETH_LZMA ZIP_COMPMETH_LZMA
+#define COMPMETH_ZSTD ZIP_COMPMETH_ZSTD
 /* ...and others... */
 
 
@@ -299,9 +348,221 @@ static int readui16(PHYSFS_Io *io, PHYSFS_uint16 *val)
 } /* readui16 */
 
 
-static PHYSFS_sint64 ZIP_read(PHYSFS_Io *_io, void *buf, PHYSFS_uint64 len)
+/*
+ * Append a checkpoint to (entry)'s list. (cp->state) is consumed either way.
+ *  Checkpoints that don't land past the last one already there are thrown
+ *  away, so the list stays sorted. Caller must hold the archive's lock.
+ */
+static int zip_append_checkpoint(ZIPinfo *info, ZIPentry *entry,
+                                 ZIPcheckpoint *cp)
+{
+    ZIPcheckpoints *list = entry->checkpoints;
+
+    if (list == NULL)
+    {
+        list = (ZIPcheckpoints *) allocator.Malloc(sizeof (ZIPcheckpoints));
+        GOTO_IF(!list, PHYSFS_ERR_OUT_OF_MEMORY, append_failed);
+        memset(list, '\0', sizeof (ZIPcheckpoints));
+        list->next = info->checkpoints;
+        info->checkpoints = list;
+        entry->checkpoints = list;
+    } /* if */
+
+    if ((list->count > 0) && (cp->uncompressed_position <=
+            list->points[list->count - 1].uncompressed_position))
+    {
+        allocator.Free(cp->state);
+        return 1;  /* already covered. */
+    } /* if */
+
+    if (list->count == list->capacity)
+    {
+        const PHYSFS_uint32 newcap = list->capacity ? list->capacity * 2 : 8;
+        void *ptr = allocator.Realloc(list->points,
+                                      newcap * sizeof (ZIPcheckpoint));
+        GOTO_IF(!ptr, PHYSFS_ERR_OUT_OF_MEMORY, append_failed);
+        list->points = (ZIPcheckpoint *) ptr;
+        list->capacity = newcap;
+    } /* if */
+
+    memcpy(&list->points[list->count++], cp, sizeof (ZIPcheckpoint));
+    return 1;
+
+append_failed:
+    allocator.Free(cp->state);
+    return 0;
+} /* zip_append_checkpoint */
+
+
+/*
+ * Called by ZIP_read() whenever all buffered input has been consumed, which
+ *  is the only time (finfo->stream) can be snapshotted as-is. These are just
+ *  a speedup, so failing to get memory for one isn't an error.
+ */
+static void zip_add_checkpoint(ZIPfileinfo *finfo, const PHYSFS_uint64 pos)
+{
+    const PHYSFS_uint64 interval = PHYSFS_getSeekCheckpointInterval();
+    const ZIPcheckpoints *list;
+    PHYSFS_uint64 last;
+    ZIPcheckpoint cp;
+
+    if (interval == 0)
+        return;
+
+    __PHYSFS_platformGrabMutex(finfo->info->lock);
+
+    list = finfo->entry->checkpoints;
+    last = 0;
+    if ((list != NULL) && (list->count > 0))
+        last = list->points[list->count - 1].uncompressed_position;
+
+    if (pos >= last + interval)
+    {
+        cp.state = (inflate_state *) allocator.Malloc(sizeof (inflate_state));
+        if (cp.state != NULL)
+        {
+            memcpy(cp.state, finfo->stream.state, sizeof (inflate_state));
+            cp.uncompressed_position = (PHYSFS_uint32) pos;
+            cp.compressed_position = finfo->compressed_position;
+            memcpy(cp.crypto_keys, finfo->crypto_keys, 12);
+            zip_append_checkpoint(finfo->info, finfo->entry, &cp);
+        } /* if */
+    } /* if */
+
+    __PHYSFS_platformReleaseMutex(finfo->info->lock);
+} /* zip_add_checkpoint */
+
+
+/*
+ * Move (finfo) to the last checkpoint at or before (offset), if that's any
+ *  closer than decoding forward from where we are (or from the start, if
+ *  (offset) is behind us). Returns 1 if we moved, 0 if there's nothing
+ *  better to use, -1 on i/o error.
+ */
+static int zip_seek_checkpoint(ZIPfileinfo *finfo, const PHYSFS_uint64 offset)
+{
+    const ZIPcheckpoints *list;
+    const ZIPcheckpoint *cp = NULL;
+    PHYSFS_uint32 lo = 0;
+    PHYSFS_uint32 hi;
+    PHYSFS_uint64 pos;
+    int retval = 0;
+
+    __PHYSFS_platformGrabMutex(finfo->info->lock);
+
+    list = finfo->entry->checkpoints;
+    hi = list ? list->count : 0;
+    while (lo < hi)  /* find the first point past (offset). */
+    {
+        const PHYSFS_uint32 mid = lo + ((hi - lo) / 2);
+        if (list->points[mid].uncompressed_position <= offset)
+            lo = mid + 1;
+        else
+            hi = mid;
+    } /* while */
+
+    if (lo > 0)
+    {
+        cp = &list->points[lo - 1];
+        if ((offset >= finfo->uncompressed_position) &&
+            (cp->uncompressed_position <= finfo->uncompressed_position))
+            cp = NULL;  /* closer to just keep going. */
+    } /* if */
+
+    if (cp != NULL)
+    {
+        PHYSFS_Io *io = finfo->io;
+        pos = finfo->entry->offset + cp->compressed_position;
+        if (zip_entry_is_tradional_crypto(finfo->entry))
+            pos += 12;
+
+        retval = -1;
+        if (io->seek(io, pos))
+        {
+            memcpy(finfo->stream.state, cp->state, sizeof (inflate_state));
+            finfo->stream.next_in = finfo->buffer;
+            finfo->stream.avail_in = 0;
+            finfo->stream.total_in = cp->compressed_position;
+            finfo->stream.total_out = cp->uncompressed_position;
+            finfo->compressed_position = cp->compressed_position;
+            finfo->uncompressed_position = cp->uncompressed_position;
+            memcpy(finfo->crypto_keys, cp->crypto_keys, 12);
+            retval = 1;
+        } /* if */
+    } /* if */
+
+    __PHYSFS_platformReleaseMutex(finfo->info->lock);
+
+    return retval;
+} /* zip_seek_checkpoint */
+
+
+/*
+ * zip_read_direct() for LZMA and zstd. The codec works on the same input
+ *  window as inflate (stream.next_in and avail_in), so refilling, rewinding
+ *  and preloading treat all the compression methods alike; there are just
+ *  no seek checkpoints, since we can't capture these decoders' state.
+ */
+static PHYSFS_sint64 zip_read_codec(ZIPfileinfo *finfo, PHYSFS_uint8 *buf,
+                                    const PHYSFS_sint64 maxread)
+{
+    const ZIPentry *entry = finfo->entry;
+    PHYSFS_sint64 retval = 0;
+
+    while (retval < maxread)
+    {
+        const PHYSFS_uint8 *src = finfo->stream.next_in;
+        size_t srclen = (size_t) finfo->stream.avail_in;
+        PHYSFS_sint64 rc;
+
+        if (srclen == 0)
+        {
+            PHYSFS_sint64 br;
+
+            br = entry->compressed_size - finfo->compressed_position;
+            if (br > 0)
+            {
+                if (br > ZIP_READBUFSIZE)
+                    br = ZIP_READBUFSIZE;
+
+                br = zip_read_decrypt(finfo, finfo->buffer, (PHYSFS_uint64) br);
+                if (br <= 0)
+                    break;
+
+                finfo->compressed_position += (PHYSFS_uint32) br;
+                src = finfo->buffer;
+                srclen = (size_t) br;
+            } /* if */
+        } /* if */
+
+        rc = __PHYSFS_zipCodecDecode(finfo->codec, &src, &srclen,
+                                     buf + retval,
+                                     (size_t) (maxread - retval));
+        finfo->stream.next_in = (unsigned char *) src;
+        finfo->stream.avail_in = (uInt) srclen;
+
+        if (rc < 0)
+            return (retval > 0) ? retval : -1;
+        else if (rc == 0)
+        {
+            if (srclen != 0)
+                break;  /* stream ended early. */
+            else if (finfo->compressed_position >= entry->compressed_size)
+                break;  /* out of input; truncated entry? */
+        } /* else if */
+
+        retval += rc;
+    } /* while */
+
+    __PHYSFS_STAT_ADD(bytesInflated, retval);
+    return retval;
+} /* zip_read_codec */
+
+
+/* Read from the decoder itself, at (finfo->uncompressed_position). */
+static PHYSFS_sint64 zip_read_direct(ZIPfileinfo *finfo, void *buf,
+                                     PHYSFS_uint64 len)
 {
-    ZIPfileinfo *finfo = (ZIPfileinfo *) _io->opaque;
     ZIPentry *entry = finfo->entry;
     PHYSFS_sint64 retval = 0;
     PHYSFS_sint64 maxread = (PHYSFS_sint64) len;
@@ -315,6 +576,8 @@ static PHYSFS_sint64 ZIP_read(PHYSFS_Io *_io, void *buf, PHYSFS_uint64 len)
 
     if (entry->compression_method == COMPMETH_NONE)
         retval = zip_read_decrypt(finfo, buf, maxread);
+    else if (finfo->codec != NULL)
+        retval = zip_read_codec(finfo, (PHYSFS_uint8 *) buf, maxread);
     else
     {
         finfo->stream.next_out = buf;
@@ -332,6 +595,9 @@ static PHYSFS_sint64 ZIP_read(PHYSFS_Io *_io, void *buf, PHYSFS_uint64 len)
                 br = entry->compressed_size - finfo->compressed_position;
                 if (br > 0)
                 {
+                    zip_add_checkpoint(finfo,
+                                 finfo->uncompressed_position + retval);
+
                     if (br > ZIP_READBUFSIZE)
                         br = ZIP_READBUFSIZE;
 
@@ -351,13 +617,15 @@ static PHYSFS_sint64 ZIP_read(PHYSFS_Io *_io, void *buf, PHYSFS_uint64 len)
             if (rc != Z_OK)
                 break;
         } /* while */
+
+        __PHYSFS_STAT_ADD(bytesInflated, retval);
     } /* else */
 
     if (retval > 0)
         finfo->uncompressed_position += (PHYSFS_uint32) retval;
 
     return retval;
-} /* ZIP_read */
+} /* zip_read_direct */
 
 
 static PHYSFS_sint64 ZIP_write(PHYSFS_Io *io, const void *b, PHYSFS_uint64 len)
@@ -366,15 +634,9 @@ static PHYSFS_sint64 ZIP_write(PHYSFS_Io *io, const void *b, PHYSFS_uint64 len)
 } /* ZIP_write */
 
 
-static PHYSFS_sint64 ZIP_tell(PHYSFS_Io *io)
-{
-    return ((ZIPfileinfo *) io->opaque)->uncompressed_position;
-} /* ZIP_tell */
-
-
-static int ZIP_seek(PHYSFS_Io *_io, PHYSFS_uint64 offset)
+/* Move the decoder itself; see zip_read_direct(). */
+static int zip_seek_direct(ZIPfileinfo *finfo, PHYSFS_uint64 offset)
 {
-    ZIPfileinfo *finfo = (ZIPfileinfo *) _io->opaque;
     ZIPentry *entry = finfo->entry;
     PHYSFS_Io *io = finfo->io;
     const int encrypted = zip_entry_is_tradional_crypto(entry);
@@ -392,23 +654,32 @@ static int ZIP_seek(PHYSFS_Io *_io, PHYSFS_uint64 offset)
     {
         /*
          * If seeking backwards, we need to redecode the file
-         *  from the start and throw away the compressed bits until we hit
-         *  the offset we need. If seeking forward, we still need to
-         *  decode, but we don't rewind first.
+         *  from the start (or the nearest checkpoint) and throw away the
+         *  compressed bits until we hit the offset we need. If seeking
+         *  forward, we still need to decode, but we don't rewind first.
          */
-        if (offset < finfo->uncompressed_position)
-        {
-            /* we do a copy so state is sane if inflateInit2() fails. */
-            z_stream str;
-            initializeZStream(&str);
-            if (zlib_err(inflateInit2(&str, -MAX_WBITS)) != Z_OK)
-                return 0;
+        const int rc = zip_seek_checkpoint(finfo, offset);
+        BAIL_IF_ERRPASS(rc < 0, 0);
 
+        if ((rc == 0) && (offset < finfo->uncompressed_position))
+        {
             if (!io->seek(io, entry->offset + (encrypted ? 12 : 0)))
                 return 0;
 
-            inflateEnd(&finfo->stream);
-            memcpy(&finfo->stream, &str, sizeof (z_stream));
+            /* stored, encrypted entries don't have a decoder to reset. */
+            if (finfo->codec != NULL)
+            {
+                if (!__PHYSFS_zipCodecReset(finfo->codec))
+                    return 0;
+            } /* if */
+            else if (finfo->stream.state != NULL)
+            {
+                if (zlib_err(inflateReset(&finfo->stream)) != Z_OK)
+                    return 0;
+            } /* if */
+
+            finfo->stream.next_in = finfo->buffer;
+            finfo->stream.avail_in = 0;
             finfo->uncompressed_position = finfo->compressed_position = 0;
 
             if (encrypted)
@@ -424,15 +695,333 @@ static int ZIP_seek(PHYSFS_Io *_io, PHYSFS_uint64 offset)
             if (maxread > sizeof (buf))
                 maxread = sizeof (buf);
 
-            if (ZIP_read(_io, buf, maxread) != maxread)
+            if (zip_read_direct(finfo, buf, maxread) != maxread)
                 return 0;
         } /* while */
     } /* else */
 
+    return 1;
+} /* zip_seek_direct */
+
+
+/*
+ * Compressed entries that use the block cache are decoded 64k at a time,
+ *  each block going into the cache as it's done, so other handles on the
+ *  same entry can skip decoding it. The handle itself just keeps a
+ *  reference to the block it's in. The decoder only moves when a block
+ *  isn't cached, so seeking is free until then.
+ */
+#define ZIP_CACHE_BLOCKSIZE (64 * 1024)
+
+static int zip_get_block(ZIPfileinfo *finfo, const PHYSFS_uint64 index)
+{
+    const ZIPentry *entry = finfo->entry;
+    const PHYSFS_uint64 start = index * ZIP_CACHE_BLOCKSIZE;
+    PHYSFS_uint64 len = entry->uncompressed_size - start;
+    PHYSFS_Io *block;
+
+    if (len > ZIP_CACHE_BLOCKSIZE)
+        len = ZIP_CACHE_BLOCKSIZE;
+
+    block = __PHYSFS_blockCacheGet(finfo->info, entry, index);
+    if (block == NULL)
+    {
+        PHYSFS_uint8 *buf = (PHYSFS_uint8 *) allocator.Malloc((size_t) len);
+        PHYSFS_sint64 br;
+        BAIL_IF(!buf, PHYSFS_ERR_OUT_OF_MEMORY, 0);
+
+        br = -1;
+        if (zip_seek_direct(finfo, start))
+            br = zip_read_direct(finfo, buf, len);
+
+        if (br != (PHYSFS_sint64) len)
+        {
+            allocator.Free(buf);
+            BAIL_IF(br >= 0, PHYSFS_ERR_CORRUPT, 0);  /* data ran short. */
+            return 0;
+        } /* if */
+
+        block = __PHYSFS_createMemoryIo(buf, len, allocator.Free);
+        if (!block)
+        {
+            allocator.Free(buf);
+            return 0;
+        } /* if */
+
+        __PHYSFS_blockCachePut(finfo->info, entry, index, block);
+    } /* if */
+
+    if (finfo->block != NULL)
+        finfo->block->destroy(finfo->block);
+    finfo->block = block;
+    finfo->block_index = index;
+    return 1;
+} /* zip_get_block */
+
+
+static PHYSFS_sint64 zip_read_cached(ZIPfileinfo *finfo, PHYSFS_uint8 *buf,
+                                     PHYSFS_uint64 len)
+{
+    const PHYSFS_uint64 avail = finfo->entry->uncompressed_size -
+                                finfo->position;
+    PHYSFS_sint64 retval = 0;
+
+    if (avail < len)
+        len = avail;
+
+    while (len > 0)
+    {
+        const PHYSFS_uint64 index = finfo->position / ZIP_CACHE_BLOCKSIZE;
+        const PHYSFS_uint64 offset = finfo->position % ZIP_CACHE_BLOCKSIZE;
+        PHYSFS_uint64 cpy;
+
+        if ((finfo->block == NULL) || (finfo->block_index != index))
+        {
+            if (!zip_get_block(finfo, index))
+                break;
+        } /* if */
+
+        cpy = ((PHYSFS_uint64) finfo->block->length(finfo->block)) - offset;
+        if (cpy > len)
+            cpy = len;
+
+        memcpy(buf, __PHYSFS_ioMappedRange(finfo->block, offset, cpy),
+               (size_t) cpy);
+        finfo->position += cpy;
+        retval += (PHYSFS_sint64) cpy;
+        buf += cpy;
+        len -= cpy;
+    } /* while */
+
+    return retval;
+} /* zip_read_cached */
+
+
+/*
+ * Decode all of a raw deflate stream in one call, straight into (dst). This
+ *  goes to the external inflate library if we were built with one, and
+ *  otherwise to miniz's decoder without the streaming wrapper, borrowing
+ *  (finfo)'s inflate state. Either way (finfo)'s decoder isn't good for
+ *  streaming afterwards until it's rewound.
+ */
+static int zip_inflate_whole(ZIPfileinfo *finfo, const PHYSFS_uint8 *src,
+                             const size_t srclen, PHYSFS_uint8 *dst,
+                             const size_t dstlen)
+{
+#if PHYSFS_HAVE_FAST_INFLATE
+    return __PHYSFS_inflateWhole(src, srclen, dst, dstlen);
+#else
+    inflate_state *state = (inflate_state *) finfo->stream.state;
+    const mz_uint32 flags = TINFL_FLAG_USING_NON_WRAPPING_OUTPUT_BUF;
+    size_t inlen = srclen;
+    size_t outlen = dstlen;
+    tinfl_status rc;
+
+    tinfl_init(&state->m_decomp);
+    rc = tinfl_decompress(&state->m_decomp, src, &inlen, dst, dst, &outlen,
+                          flags);
+    BAIL_IF(rc != TINFL_STATUS_DONE, PHYSFS_ERR_CORRUPT, 0);
+    BAIL_IF(outlen != dstlen, PHYSFS_ERR_CORRUPT, 0);
+    return 1;
+#endif
+} /* zip_inflate_whole */
+
+
+/*
+ * We decoded all of (finfo)'s entry into (buf) without going through the
+ *  block cache; copy it in there anyhow, so other handles (and later opens)
+ *  still get hits. Failing is harmless: they'll just decode it again.
+ */
+static void zip_cache_whole(ZIPfileinfo *finfo, const PHYSFS_uint8 *buf)
+{
+    const ZIPentry *entry = finfo->entry;
+    const PHYSFS_uint64 size = entry->uncompressed_size;
+    PHYSFS_uint64 index;
+
+    if (size > PHYSFS_getBlockCacheBudget())
+        return;  /* it'd only push itself out. */
+
+    for (index = 0; (index * ZIP_CACHE_BLOCKSIZE) < size; index++)
+    {
+        const PHYSFS_uint64 start = index * ZIP_CACHE_BLOCKSIZE;
+        const PHYSFS_uint64 avail = size - start;
+        const size_t len = (size_t) ((avail > ZIP_CACHE_BLOCKSIZE) ?
+                                      ZIP_CACHE_BLOCKSIZE : avail);
+        PHYSFS_uint8 *ptr = (PHYSFS_uint8 *) allocator.Malloc(len);
+        PHYSFS_Io *block;
+
+        if (ptr == NULL)
+            return;
+
+        memcpy(ptr, buf + start, len);
+        block = __PHYSFS_createMemoryIo(ptr, len, allocator.Free);
+        if (block == NULL)
+        {
+            allocator.Free(ptr);
+            return;
+        } /* if */
+
+        __PHYSFS_blockCachePut(finfo->info, entry, index, block);
+        block->destroy(block);
+    } /* for */
+} /* zip_cache_whole */
+
+
+/*
+ * If a read wants all of a compressed entry we haven't started decoding
+ *  (which is what most loaders do), skip the streaming machinery: read all
+ *  the compressed data at once and decode it in one call. Returns 0 without
+ *  setting an error if this isn't such a read, or there isn't memory for
+ *  the compressed data, so the caller should read as usual.
+ */
+static PHYSFS_sint64 zip_read_whole(ZIPfileinfo *finfo, void *buf,
+                                    const PHYSFS_uint64 len)
+{
+    const ZIPentry *entry = finfo->entry;
+    const PHYSFS_uint64 size = entry->uncompressed_size;
+    PHYSFS_uint64 srclen = entry->compressed_size;
+    PHYSFS_uint8 *src;
+    int rc;
+
+    if ((entry->compression_method == COMPMETH_NONE) || (size == 0))
+        return 0;
+    else if ((len < size) || (finfo->cached && (finfo->position != 0)))
+        return 0;
+    else if ((finfo->uncompressed_position != 0) ||
+             (finfo->compressed_position != 0) ||
+             (finfo->stream.avail_in != 0))
+        return 0;  /* already started, or preloaded. */
+
+    if (finfo->cached)  /* another handle decoded it already? Use that. */
+    {
+        PHYSFS_Io *block = __PHYSFS_blockCacheGet(finfo->info, entry, 0);
+        if (block != NULL)
+        {
+            block->destroy(block);
+            return 0;
+        } /* if */
+    } /* if */
+
+    if (zip_entry_is_tradional_crypto(entry))  /* minus the header. */
+        srclen = (srclen > 12) ? srclen - 12 : 0;
+
+    if (!__PHYSFS_ui64FitsAddressSpace(size))
+        return 0;
+    else if (!__PHYSFS_ui64FitsAddressSpace(srclen))
+        return 0;
+
+    src = (PHYSFS_uint8 *) allocator.Malloc(srclen ? (size_t) srclen : 1);
+    if (src == NULL)
+        return 0;
+
+    /* the decoder's past the start now, whatever happens, so seeks rewind. */
+    rc = (zip_read_decrypt(finfo, src, srclen) == (PHYSFS_sint64) srclen);
+    finfo->compressed_position = (PHYSFS_uint32) srclen;
+    finfo->uncompressed_position = (PHYSFS_uint32) size;
+    if (rc && (entry->compression_method != COMPMETH_DEFLATE))
+    {
+        rc = __PHYSFS_zipCodecDecodeWhole(entry->compression_method,
+                                          src, (size_t) srclen,
+                                          buf, (size_t) size);
+    } /* if */
+    else if (rc)
+    {
+        rc = zip_inflate_whole(finfo, src, (size_t) srclen,
+                               (PHYSFS_uint8 *) buf, (size_t) size);
+    } /* else if */
+    allocator.Free(src);
+    BAIL_IF_ERRPASS(!rc, -1);
+    __PHYSFS_STAT_ADD(bytesInflated, size);
+
+    if (finfo->cached)
+    {
+        zip_cache_whole(finfo, (const PHYSFS_uint8 *) buf);
+        finfo->position = size;
+    } /* if */
+
+    return (PHYSFS_sint64) size;
+} /* zip_read_whole */
+
+
+/*
+ * For PHYSFS_setVerifyChecksums(): (len) bytes from (pos) were just read
+ *  into (buf). Add whatever of them the running CRC hasn't seen, and check
+ *  it once it covers the whole entry. A read that starts past (crcpos)
+ *  left a gap we can't account for, so that ends checking for this file.
+ */
+static int zip_verify_crc(ZIPfileinfo *finfo, const PHYSFS_uint64 pos,
+                          const PHYSFS_uint8 *buf, const PHYSFS_uint64 len)
+{
+    const ZIPentry *entry = finfo->entry;
+    PHYSFS_uint64 skip;
+
+    if (pos > finfo->crcpos)
+    {
+        finfo->verify = 0;
+        return 1;
+    } /* if */
+
+    skip = finfo->crcpos - pos;
+    if (skip >= len)
+        return 1;  /* seen all this already. */
+
+    finfo->crc = __PHYSFS_crc32(finfo->crc, buf + skip, (size_t) (len - skip));
+    finfo->crcpos = pos + len;
+    if (finfo->crcpos < entry->uncompressed_size)
+        return 1;
+
+    finfo->verify = 0;  /* checked; only report it once. */
+    BAIL_IF(finfo->crc != entry->crc, PHYSFS_ERR_CORRUPT, 0);
+    return 1;
+} /* zip_verify_crc */
+
+
+static PHYSFS_sint64 ZIP_read(PHYSFS_Io *io, void *buf, PHYSFS_uint64 len)
+{
+    ZIPfileinfo *finfo = (ZIPfileinfo *) io->opaque;
+    const PHYSFS_uint64 pos = finfo->cached ?
+                    finfo->position : finfo->uncompressed_position;
+    PHYSFS_sint64 rc = zip_read_whole(finfo, buf, len);
+    if (rc == 0)
+    {
+        if (finfo->cached)
+            rc = zip_read_cached(finfo, (PHYSFS_uint8 *) buf, len);
+        else
+            rc = zip_read_direct(finfo, buf, len);
+    } /* if */
+
+    if ((rc > 0) && (finfo->verify))
+    {
+        if (!zip_verify_crc(finfo, pos, (const PHYSFS_uint8 *) buf,
+                            (PHYSFS_uint64) rc))
+            return -1;
+    } /* if */
+
+    return rc;
+} /* ZIP_read */
+
+
+static int ZIP_seek(PHYSFS_Io *io, PHYSFS_uint64 offset)
+{
+    ZIPfileinfo *finfo = (ZIPfileinfo *) io->opaque;
+    if (!finfo->cached)
+        return zip_seek_direct(finfo, offset);
+
+    BAIL_IF(offset > finfo->entry->uncompressed_size, PHYSFS_ERR_PAST_EOF, 0);
+    finfo->position = offset;
     return 1;
 } /* ZIP_seek */
 
 
+static PHYSFS_sint64 ZIP_tell(PHYSFS_Io *io)
+{
+    const ZIPfileinfo *finfo = (ZIPfileinfo *) io->opaque;
+    if (finfo->cached)
+        return (PHYSFS_sint64) finfo->position;
+    return finfo->uncompressed_position;
+} /* ZIP_tell */
+
+
 static PHYSFS_sint64 ZIP_length(PHYSFS_Io *io)
 {
     const ZIPfileinfo *finfo = (ZIPfileinfo *) io->opaque;
@@ -440,70 +1029,206 @@ static PHYSFS_sint64 ZIP_length(PHYSFS_Io *io)
 } /* ZIP_length */
 
 
-static PHYSFS_Io *zip_get_io(PHYSFS_Io *io, ZIPinfo *inf, ZIPentry *entry);
+/* only stored, unencrypted entries get this; see zip_can_read_at(). */
+static PHYSFS_sint64 ZIP_readAt(PHYSFS_Io *_io, PHYSFS_uint64 offset,
+                                void *buf, PHYSFS_uint64 len)
+{
+    ZIPfileinfo *finfo = (ZIPfileinfo *) _io->opaque;
+    const ZIPentry *entry = finfo->entry;
+    PHYSFS_Io *io = finfo->io;
 
-static PHYSFS_Io *ZIP_duplicate(PHYSFS_Io *io)
+    if (offset >= entry->uncompressed_size)
+        return 0;
+
+    if (len > entry->uncompressed_size - offset)
+        len = entry->uncompressed_size - offset;
+
+    return io->readAt(io, entry->offset + offset, buf, len);
+} /* ZIP_readAt */
+
+
+/* encrypted entries aren't shared; a wrong password could decode garbage. */
+static int zip_use_block_cache(const ZIPentry *entry)
 {
-    ZIPfileinfo *origfinfo = (ZIPfileinfo *) io->opaque;
-    PHYSFS_Io *retval = (PHYSFS_Io *) allocator.Malloc(sizeof (PHYSFS_Io));
-    ZIPfileinfo *finfo = (ZIPfileinfo *) allocator.Malloc(sizeof (ZIPfileinfo));
-    GOTO_IF(!retval, PHYSFS_ERR_OUT_OF_MEMORY, failed);
-    GOTO_IF(!finfo, PHYSFS_ERR_OUT_OF_MEMORY, failed);
-    memset(finfo, '\0', sizeof (*finfo));
-
-    finfo->entry = origfinfo->entry;
-    finfo->io = zip_get_io(origfinfo->io, NULL, finfo->entry);
-    GOTO_IF_ERRPASS(!finfo->io, failed);
-
-    initializeZStream(&finfo->stream);
-    if (finfo->entry->compression_method != COMPMETH_NONE)
-    {
-        finfo->buffer = (PHYSFS_uint8 *) allocator.Malloc(ZIP_READBUFSIZE);
-        GOTO_IF(!finfo->buffer, PHYSFS_ERR_OUT_OF_MEMORY, failed);
-        if (zlib_err(inflateInit2(&finfo->stream, -MAX_WBITS)) != Z_OK)
-            goto failed;
+    return ( (entry->compression_method != COMPMETH_NONE) &&
+             (!zip_entry_is_tradional_crypto(entry)) &&
+             (PHYSFS_getBlockCacheBudget() > 0) );
+} /* zip_use_block_cache */
+
+
+static int zip_can_read_at(const ZIPfileinfo *finfo)
+{
+    /* readAt() can't keep the running CRC; see zip_verify_crc(). */
+    return ( (!finfo->verify) &&
+             (finfo->entry->compression_method == COMPMETH_NONE) &&
+             (!zip_entry_is_tradional_crypto(finfo->entry)) &&
+             (__PHYSFS_ioCanReadAt(finfo->io)) );
+} /* zip_can_read_at */
+
+
+/*
+ * Closed files go on a short list in their archive, still holding their
+ *  view of the archive, read buffer and inflate state (about 60k between
+ *  them), and opening a file takes one from there, seeks the view and just
+ *  resets the decoder. So opening and closing lots of small files doesn't
+ *  allocate and free all that each time. A spare keeps its buffer and
+ *  decoder even if it's reused for a stored entry, so it still has them the
+ *  next time around.
+ */
+#define ZIP_MAX_SPARES 8
+
+static void zip_free_finfo(ZIPfileinfo *finfo)
+{
+    if (finfo->io != NULL)
+        finfo->io->destroy(finfo->io);
+    if (finfo->buffer != NULL)
+        allocator.Free(finfo->buffer);
+    if (finfo->stream.state != NULL)
+        inflateEnd(&finfo->stream);
+    if (finfo->codec != NULL)
+        __PHYSFS_zipCodecDestroy(finfo->codec);
+    __PHYSFS_poolFree(&fileinfoPool, finfo);
+} /* zip_free_finfo */
+
+
+static void zip_release_finfo(ZIPfileinfo *finfo)
+{
+    ZIPinfo *info = finfo->info;
+
+    if (finfo->block != NULL)
+    {
+        finfo->block->destroy(finfo->block);
+        finfo->block = NULL;
     } /* if */
 
-    memcpy(retval, io, sizeof (PHYSFS_Io));
-    retval->opaque = finfo;
-    return retval;
+    if (finfo->bigbuffer)  /* not the size the next user expects. */
+    {
+        allocator.Free(finfo->buffer);
+        finfo->buffer = NULL;
+    } /* if */
+
+    if (finfo->codec != NULL)  /* sized for this entry; don't keep it. */
+    {
+        __PHYSFS_zipCodecDestroy(finfo->codec);
+        finfo->codec = NULL;
+    } /* if */
+
+    __PHYSFS_platformGrabMutex(info->lock);
+    if (info->numspares < ZIP_MAX_SPARES)
+    {
+        finfo->next = info->spares;
+        info->spares = finfo;
+        info->numspares++;
+        finfo = NULL;
+    } /* if */
+    __PHYSFS_platformReleaseMutex(info->lock);
 
-failed:
     if (finfo != NULL)
+        zip_free_finfo(finfo);
+} /* zip_release_finfo */
+
+
+/* A fresh ZIPfileinfo for (entry), ready to decode if it's compressed. */
+static ZIPfileinfo *zip_alloc_finfo(ZIPinfo *info, ZIPentry *entry)
+{
+    ZIPfileinfo *finfo;
+    PHYSFS_Io *io = NULL;
+    PHYSFS_uint8 *buffer = NULL;
+    z_stream str;
+    int rc;
+
+    __PHYSFS_platformGrabMutex(info->lock);
+    finfo = info->spares;
+    if (finfo != NULL)
+    {
+        info->spares = finfo->next;
+        info->numspares--;
+    } /* if */
+    __PHYSFS_platformReleaseMutex(info->lock);
+
+    initializeZStream(&str);
+    if (finfo == NULL)
+    {
+        finfo = (ZIPfileinfo *) __PHYSFS_poolAlloc(&fileinfoPool);
+        BAIL_IF_ERRPASS(!finfo, NULL);
+    } /* if */
+    else
     {
-        if (finfo->io != NULL)
-            finfo->io->destroy(finfo->io);
+        io = finfo->io;
+        buffer = finfo->buffer;
+        str.state = finfo->stream.state;
+    } /* else */
+
+    memset(finfo, '\0', sizeof (ZIPfileinfo));
+    memcpy(&finfo->stream, &str, sizeof (z_stream));
+    finfo->io = io;
+    finfo->buffer = buffer;
+    finfo->info = info;
+    finfo->entry = entry;
 
-        if (finfo->buffer != NULL)
+    if (entry->compression_method != COMPMETH_NONE)
+    {
+        if (finfo->buffer == NULL)
         {
-            allocator.Free(finfo->buffer);
-            inflateEnd(&finfo->stream);
+            finfo->buffer = (PHYSFS_uint8 *) allocator.Malloc(ZIP_READBUFSIZE);
+            GOTO_IF(!finfo->buffer, PHYSFS_ERR_OUT_OF_MEMORY, failed);
         } /* if */
+    } /* if */
+
+    if (entry->compression_method == COMPMETH_DEFLATE)
+    {
+        if (finfo->stream.state != NULL)
+            rc = inflateReset(&finfo->stream);
+        else
+            rc = inflateInit2(&finfo->stream, -MAX_WBITS);
 
-        allocator.Free(finfo);
+        if (zlib_err(rc) != Z_OK)
+            goto failed;
     } /* if */
 
-    if (retval != NULL)
-        allocator.Free(retval);
+    else if (entry->compression_method != COMPMETH_NONE)
+    {
+        finfo->codec = __PHYSFS_zipCodecCreate(entry->compression_method,
+                                               entry->uncompressed_size);
+        GOTO_IF_ERRPASS(!finfo->codec, failed);
+    } /* else if */
 
+    return finfo;
+
+failed:
+    zip_free_finfo(finfo);
     return NULL;
-} /* ZIP_duplicate */
+} /* zip_alloc_finfo */
 
-static int ZIP_flush(PHYSFS_Io *io) { return 1;  /* no write support. */ }
 
-static void ZIP_destroy(PHYSFS_Io *io)
+static int zip_get_io(ZIPfileinfo *finfo, ZIPinfo *inf, ZIPentry *entry);
+
+static PHYSFS_Io *ZIP_duplicate(PHYSFS_Io *io)
 {
-    ZIPfileinfo *finfo = (ZIPfileinfo *) io->opaque;
-    finfo->io->destroy(finfo->io);
+    ZIPfileinfo *origfinfo = (ZIPfileinfo *) io->opaque;
+    ZIPfileinfo *finfo = zip_alloc_finfo(origfinfo->info, origfinfo->entry);
+    BAIL_IF_ERRPASS(!finfo, NULL);
 
-    if (finfo->entry->compression_method != COMPMETH_NONE)
-        inflateEnd(&finfo->stream);
+    if (!zip_get_io(finfo, NULL, finfo->entry))
+    {
+        zip_release_finfo(finfo);
+        return NULL;
+    } /* if */
 
-    if (finfo->buffer != NULL)
-        allocator.Free(finfo->buffer);
+    finfo->cached = zip_use_block_cache(finfo->entry);
+    finfo->verify = PHYSFS_getVerifyChecksums();
+    memcpy(&finfo->self, io, sizeof (PHYSFS_Io));
+    finfo->self.opaque = finfo;
+    if (finfo->verify)
+        finfo->self.readAt = NULL;
+    return &finfo->self;
+} /* ZIP_duplicate */
+
+static int ZIP_flush(PHYSFS_Io *io) { return 1;  /* no write support. */ }
 
-    allocator.Free(finfo);
-    allocator.Free(io);
+static void ZIP_destroy(PHYSFS_Io *io)
+{
+    zip_release_finfo((ZIPfileinfo *) io->opaque);  /* (io) goes with it. */
 } /* ZIP_destroy */
 
 
@@ -517,21 +1242,20 @@ static const PHYSFS_Io ZIP_Io =
     ZIP_length,
     ZIP_duplicate,
     ZIP_flush,
-    ZIP_destroy
+    ZIP_destroy,
+    ZIP_readAt
 };
 
 
 
 static PHYSFS_sint64 zip_find_end_of_central_dir(PHYSFS_Io *io, PHYSFS_sint64 *len)
 {
-    PHYSFS_uint8 buf[256];
-    PHYSFS_uint8 extra[4] = { 0, 0, 0, 0 };
-    PHYSFS_sint32 i = 0;
+    const PHYSFS_uint8 *tail;
+    PHYSFS_uint8 *buf = NULL;
     PHYSFS_sint64 filelen;
     PHYSFS_sint64 filepos;
     PHYSFS_sint32 maxread;
-    PHYSFS_sint32 totalread = 0;
-    int found = 0;
+    PHYSFS_sint32 i;
 
     filelen = io->length(io);
     BAIL_IF_ERRPASS(filelen == -1, -1);
@@ -546,61 +1270,43 @@ static PHYSFS_sint64 zip_find_end_of_central_dir(PHYSFS_Io *io, PHYSFS_sint64 *l
      *  right place. The comment length field is 16 bits, so we can stop
      *  searching for that signature after a little more than 64k at most,
      *  and call it a corrupted zipfile.
+     *
+     * That's small enough to grab in one read, rather than a little bit
+     *  at a time, and it's usually the end of the central directory, which
+     *  the caller is about to read anyhow.
      */
 
-    if (sizeof (buf) < filelen)
-    {
-        filepos = filelen - sizeof (buf);
-        maxread = sizeof (buf);
-    } /* if */
-    else
-    {
-        filepos = 0;
-        maxread = (PHYSFS_uint32) filelen;
-    } /* else */
+    maxread = (filelen < 65557) ? (PHYSFS_sint32) filelen : 65557;
+    filepos = filelen - maxread;
+    BAIL_IF(maxread < 22, PHYSFS_ERR_UNSUPPORTED, -1);
 
-    while ((totalread < filelen) && (totalread < 65557))
+    tail = (const PHYSFS_uint8 *) __PHYSFS_ioMappedRange(io, filepos, maxread);
+    if (tail == NULL)
     {
-        BAIL_IF_ERRPASS(!io->seek(io, filepos), -1);
-
-        /* make sure we catch a signature between buffers. */
-        if (totalread != 0)
+        buf = (PHYSFS_uint8 *) allocator.Malloc(maxread);
+        BAIL_IF(!buf, PHYSFS_ERR_OUT_OF_MEMORY, -1);
+        if (!io->seek(io, filepos) || !__PHYSFS_readAll(io, buf, maxread))
         {
-            if (!__PHYSFS_readAll(io, buf, maxread - 4))
-                return -1;
-            memcpy(&buf[maxread - 4], &extra, sizeof (extra));
-            totalread += maxread - 4;
+            allocator.Free(buf);
+            return -1;
         } /* if */
-        else
-        {
-            if (!__PHYSFS_readAll(io, buf, maxread))
-                return -1;
-            totalread += maxread;
-        } /* else */
-
-        memcpy(&extra, buf, sizeof (extra));
-
-        for (i = maxread - 4; i > 0; i--)
-        {
-            if ((buf[i + 0] == 0x50) &&
-                (buf[i + 1] == 0x4B) &&
-                (buf[i + 2] == 0x05) &&
-                (buf[i + 3] == 0x06) )
-            {
-                found = 1;  /* that's the signature! */
-                break;  
-            } /* if */
-        } /* for */
+        tail = buf;
+    } /* if */
 
-        if (found)
-            break;
+    /* the record is 22 bytes, so it can't start any later than this. */
+    for (i = maxread - 22; i >= 0; i--)
+    {
+        if ((tail[i + 0] == 0x50) &&
+            (tail[i + 1] == 0x4B) &&
+            (tail[i + 2] == 0x05) &&
+            (tail[i + 3] == 0x06) )
+            break;  /* that's the signature! */
+    } /* for */
 
-        filepos -= (maxread - 4);
-        if (filepos < 0)
-            filepos = 0;
-    } /* while */
+    if (buf != NULL)
+        allocator.Free(buf);
 
-    BAIL_IF(!found, PHYSFS_ERR_UNSUPPORTED, -1);
+    BAIL_IF(i < 0, PHYSFS_ERR_UNSUPPORTED, -1);
 
     if (len != NULL)
         *len = filelen;
@@ -773,7 +1479,15 @@ static int zip_resolve_symlink(PHYSFS_Io *io, ZIPinfo *info, ZIPentry *entry)
         PHYSFS_uint8 *compressed = (PHYSFS_uint8*) __PHYSFS_smallAlloc(complen);
         if (compressed != NULL)
         {
-            if (__PHYSFS_readAll(io, compressed, complen))
+            if (!__PHYSFS_readAll(io, compressed, complen))
+                rc = 0;
+            else if (entry->compression_method != COMPMETH_DEFLATE)
+            {
+                rc = __PHYSFS_zipCodecDecodeWhole(entry->compression_method,
+                                                  compressed, complen,
+                                                  path, size);
+            } /* else if */
+            else
             {
                 initializeZStream(&stream);
                 stream.next_in = compressed;
@@ -909,6 +1623,21 @@ static int zip_resolve(PHYSFS_Io *io, ZIPinfo *info, ZIPentry *entry)
 } /* zip_resolve */
 
 
+/*
+ * Resolving an entry writes to it and seeks the archive's shared i/o, so
+ *  it has to be serialized, since PhysicsFS lets several threads open files
+ *  from the same archive at once. Everything after that only reads.
+ */
+static int zip_resolve_locked(ZIPinfo *info, ZIPentry *entry)
+{
+    int retval;
+    __PHYSFS_platformGrabMutex(info->lock);
+    retval = zip_resolve(info->resolveio, info, entry);
+    __PHYSFS_platformReleaseMutex(info->lock);
+    return retval;
+} /* zip_resolve_locked */
+
+
 static int zip_entry_is_symlink(const ZIPentry *entry)
 {
     return ((entry->resolved == ZIP_UNRESOLVED_SYMLINK) ||
@@ -985,10 +1714,9 @@ static PHYSFS_sint64 zip_dos_time_to_physfs_time(PHYSFS_uint32 dostime)
 } /* zip_dos_time_to_physfs_time */
 
 
-static ZIPentry *zip_load_entry(ZIPinfo *info, const int zip64,
-                                const PHYSFS_uint64 ofs_fixup)
+static ZIPentry *zip_load_entry(ZIPinfo *info, PHYSFS_Io *io,
+                                const int zip64, const PHYSFS_uint64 ofs_fixup)
 {
-    PHYSFS_Io *io = info->io;
     ZIPentry entry;
     ZIPentry *retval = NULL;
     PHYSFS_uint16 fnamelen, extralen, commentlen;
@@ -999,6 +1727,7 @@ static ZIPentry *zip_load_entry(ZIPinfo *info, const int zip64,
     PHYSFS_uint32 ui32;
     PHYSFS_sint64 si64;
     char *name = NULL;
+    int othercase;
     int isdir = 0;
 
     /* sanity check with central directory signature... */
@@ -1047,10 +1776,21 @@ static ZIPentry *zip_load_entry(ZIPinfo *info, const int zip64,
     zip_convert_dos_path(entry.version, name);
 
     retval = (ZIPentry *) __PHYSFS_DirTreeAdd(&info->tree, name, isdir);
+    othercase = ((retval != NULL) &&
+                 (__PHYSFS_DirTreeOtherCase(&info->tree, retval, name)));
     __PHYSFS_smallFree(name);
 
     BAIL_IF(!retval, PHYSFS_ERR_OUT_OF_MEMORY, NULL);
 
+    /* ignoring case, and an earlier entry has this name? It wins. */
+    if (othercase)
+    {
+        si64 = io->tell(io);
+        BAIL_IF_ERRPASS(si64 == -1, NULL);
+        BAIL_IF_ERRPASS(!io->seek(io, si64 + extralen + commentlen), NULL);
+        return retval;
+    } /* if */
+
     /* It's okay to BAIL without freeing retval, because it's stored in the
        __PHYSFS_DirTree and will be freed later anyhow. */
     BAIL_IF(retval->last_mod_time != 0, PHYSFS_ERR_CORRUPT, NULL); /* dupe? */
@@ -1145,27 +1885,83 @@ static ZIPentry *zip_load_entry(ZIPinfo *info, const int zip64,
 } /* zip_load_entry */
 
 
+/*
+ * Get the whole central directory in memory, so parsing each record is a
+ *  handful of memcpy()s instead of a read from the archive per field: that's
+ *  a syscall apiece on a native file, and most of the time it takes to mount
+ *  a big .zip. Uses the archive's own memory if it's mapped, reads it all in
+ *  one go otherwise. Returns NULL without an error set if there isn't memory
+ *  for it; the caller should just read the records from the archive then.
+ */
+static PHYSFS_Io *zip_central_dir_io(PHYSFS_Io *io,
+                                     const PHYSFS_uint64 central_ofs,
+                                     const PHYSFS_uint64 central_len)
+{
+    const PHYSFS_sint64 filelen = io->length(io);
+    PHYSFS_Io *retval = NULL;
+    PHYSFS_uint8 *buf;
+
+    if ((filelen < 0) || (central_ofs > (PHYSFS_uint64) filelen))
+        return NULL;  /* let the usual path report that. */
+    else if (central_len == 0)
+        return NULL;
+    else if (central_len > ((PHYSFS_uint64) filelen) - central_ofs)
+        return NULL;
+
+    retval = __PHYSFS_ioMappedSubrange(io, central_ofs, central_len);
+    if (retval != NULL)
+        return retval;
+    else if (!__PHYSFS_ui64FitsAddressSpace(central_len))
+        return NULL;
+
+    buf = (PHYSFS_uint8 *) allocator.Malloc((size_t) central_len);
+    if (buf == NULL)
+        return NULL;
+
+    if (io->seek(io, central_ofs) &&
+        __PHYSFS_readAll(io, buf, (size_t) central_len))
+    {
+        retval = __PHYSFS_createMemoryIo(buf, central_len, allocator.Free);
+        if (retval != NULL)
+            return retval;
+    } /* if */
+
+    allocator.Free(buf);
+    return NULL;
+} /* zip_central_dir_io */
+
+
 /* This leaves things allocated on error; the caller will clean up the mess. */
 static int zip_load_entries(ZIPinfo *info,
                             const PHYSFS_uint64 data_ofs,
                             const PHYSFS_uint64 central_ofs,
+                            const PHYSFS_uint64 central_len,
                             const PHYSFS_uint64 entry_count)
 {
-    PHYSFS_Io *io = info->io;
+    PHYSFS_Io *io = zip_central_dir_io(info->io, central_ofs, central_len);
     const int zip64 = info->zip64;
     PHYSFS_uint64 i;
+    int retval = 1;
 
-    BAIL_IF_ERRPASS(!io->seek(io, central_ofs), 0);
+    if (io == NULL)  /* no memory for it? Read the records in place. */
+    {
+        io = info->io;
+        BAIL_IF_ERRPASS(!io->seek(io, central_ofs), 0);
+    } /* if */
 
-    for (i = 0; i < entry_count; i++)
+    for (i = 0; (retval) && (i < entry_count); i++)
     {
-        ZIPentry *entry = zip_load_entry(info, zip64, data_ofs);
-        BAIL_IF_ERRPASS(!entry, 0);
-        if (zip_entry_is_tradional_crypto(entry))
+        ZIPentry *entry = zip_load_entry(info, io, zip64, data_ofs);
+        if (!entry)
+            retval = 0;
+        else if (zip_entry_is_tradional_crypto(entry))
             info->has_crypto = 1;
     } /* for */
 
-    return 1;
+    if (io != info->io)
+        io->destroy(io);
+
+    return retval;
 } /* zip_load_entries */
 
 
@@ -1261,6 +2057,7 @@ static PHYSFS_sint64 zip64_find_end_of_central_dir(PHYSFS_Io *io,
 static int zip64_parse_end_of_central_dir(ZIPinfo *info,
                                           PHYSFS_uint64 *data_start,
                                           PHYSFS_uint64 *dir_ofs,
+                                          PHYSFS_uint64 *dir_len,
                                           PHYSFS_uint64 *entry_count,
                                           PHYSFS_sint64 pos)
 {
@@ -1336,7 +2133,7 @@ static int zip64_parse_end_of_central_dir(ZIPinfo *info,
     BAIL_IF(ui64 != *entry_count, PHYSFS_ERR_CORRUPT, 0);
 
     /* size of the central directory */
-    BAIL_IF_ERRPASS(!readui64(io, &ui64), 0);
+    BAIL_IF_ERRPASS(!readui64(io, dir_len), 0);
 
     /* offset of central directory */
     BAIL_IF_ERRPASS(!readui64(io, dir_ofs), 0);
@@ -1356,6 +2153,7 @@ static int zip64_parse_end_of_central_dir(ZIPinfo *info,
 static int zip_parse_end_of_central_dir(ZIPinfo *info,
                                         PHYSFS_uint64 *data_start,
                                         PHYSFS_uint64 *dir_ofs,
+                                        PHYSFS_uint64 *dir_len,
                                         PHYSFS_uint64 *entry_count)
 {
     PHYSFS_Io *io = info->io;
@@ -1378,7 +2176,7 @@ static int zip_parse_end_of_central_dir(ZIPinfo *info,
 
     /* Seek back to see if "Zip64 end of central directory locator" exists. */
     /* this record is 20 bytes before end-of-central-dir */
-    rc = zip64_parse_end_of_central_dir(info, data_start, dir_ofs,
+    rc = zip64_parse_end_of_central_dir(info, data_start, dir_ofs, dir_len,
                                         entry_count, pos - 20);
 
     /* Error or success? Bounce out of here. Keep going if not zip64. */
@@ -1409,6 +2207,7 @@ static int zip_parse_end_of_central_dir(ZIPinfo *info,
 
     /* size of the central directory */
     BAIL_IF_ERRPASS(!readui32(io, &ui32), 0);
+    *dir_len = (PHYSFS_uint64) ui32;
 
     /* offset of central directory */
     BAIL_IF_ERRPASS(!readui32(io, &offset32), 0);
@@ -1449,9 +2248,35 @@ static void ZIP_closeArchive(void *opaque)
     if (!info)
         return;
 
+    __PHYSFS_blockCachePurge(info);
+
+    if ((info->resolveio) && (info->resolveio != info->io))
+        info->resolveio->destroy(info->resolveio);
+
     if (info->io)
         info->io->destroy(info->io);
 
+    if (info->lock)
+        __PHYSFS_platformDestroyMutex(info->lock);
+
+    while (info->spares != NULL)
+    {
+        ZIPfileinfo *finfo = info->spares;
+        info->spares = finfo->next;
+        zip_free_finfo(finfo);
+    } /* while */
+
+    while (info->checkpoints != NULL)
+    {
+        ZIPcheckpoints *list = info->checkpoints;
+        PHYSFS_uint32 i;
+        for (i = 0; i < list->count; i++)
+            allocator.Free(list->points[i].state);
+        info->checkpoints = list->next;
+        allocator.Free(list->points);
+        allocator.Free(list);
+    } /* while */
+
     __PHYSFS_DirTreeDeinit(&info->tree);
 
     allocator.Free(info);
@@ -1465,7 +2290,10 @@ static void *ZIP_openArchive(PHYSFS_Io *io, const char *name,
     ZIPentry *root = NULL;
     PHYSFS_uint64 dstart = 0;  /* data start */
     PHYSFS_uint64 cdir_ofs;  /* central dir offset */
+    PHYSFS_uint64 cdir_len;  /* central dir size */
     PHYSFS_uint64 count;
+    PHYSFS_uint64 key[3];
+    PHYSFS_uint8 has_crypto;
 
     assert(io != NULL);  /* shouldn't ever happen. */
 
@@ -1480,51 +2308,80 @@ static void *ZIP_openArchive(PHYSFS_Io *io, const char *name,
 
     info->io = io;
 
-    if (!zip_parse_end_of_central_dir(info, &dstart, &cdir_ofs, &count))
+    info->lock = __PHYSFS_platformCreateMutex();
+    if (!info->lock)
+        goto ZIP_openarchive_failed;
+
+    if (!zip_parse_end_of_central_dir(info, &dstart, &cdir_ofs, &cdir_len,
+                                      &count))
         goto ZIP_openarchive_failed;
-    else if (!__PHYSFS_DirTreeInit(&info->tree, sizeof (ZIPentry)))
+    else if (!__PHYSFS_DirTreeInit(&info->tree, sizeof (ZIPentry), count))
         goto ZIP_openarchive_failed;
 
     root = (ZIPentry *) info->tree.root;
     root->resolved = ZIP_DIRECTORY;
 
-    if (!zip_load_entries(info, dstart, cdir_ofs, count))
-        goto ZIP_openarchive_failed;
+    key[0] = dstart;
+    key[1] = cdir_ofs;
+    key[2] = count;
+    if (__PHYSFS_DirTreeLoadCache(&info->tree, name, "zip", key, sizeof (key),
+                                  &has_crypto, sizeof (has_crypto)))
+        info->has_crypto = (int) has_crypto;
+    else
+    {
+        if (!zip_load_entries(info, dstart, cdir_ofs, cdir_len, count))
+            goto ZIP_openarchive_failed;
+
+        /* nothing is resolved yet, so no entry points anywhere but the tree. */
+        has_crypto = (PHYSFS_uint8) info->has_crypto;
+        __PHYSFS_DirTreeStoreCache(&info->tree, name, "zip", key, sizeof (key),
+                                   &has_crypto, sizeof (has_crypto));
+    } /* else */
+
+    /*
+     * Open files read (io) through readAt() if they can, which may move the
+     *  file pointer out from under a seek() and read(), so resolving gets a
+     *  view of its own in that case. It's only used under (info->lock).
+     */
+    info->resolveio = io;
+    if (__PHYSFS_ioCanReadAt(io))
+    {
+        info->resolveio = __PHYSFS_ioShare(io);
+        if (!info->resolveio)
+            goto ZIP_openarchive_failed;
+    } /* if */
 
     assert(info->tree.root->sibling == NULL);
     return info;
 
 ZIP_openarchive_failed:
+    info->resolveio = NULL;
     info->io = NULL;  /* don't let ZIP_closeArchive destroy (io). */
     ZIP_closeArchive(info);
     return NULL;
 } /* ZIP_openArchive */
 
 
-static PHYSFS_Io *zip_get_io(PHYSFS_Io *io, ZIPinfo *inf, ZIPentry *entry)
+/*
+ * Point (finfo->io) at the start of (entry), getting a view of the archive
+ *  first if (finfo) didn't come with one. (inf) can be NULL if we already
+ *  resolved.
+ */
+static int zip_get_io(ZIPfileinfo *finfo, ZIPinfo *inf, ZIPentry *entry)
 {
-    int success;
-    PHYSFS_Io *retval = io->duplicate(io);
-    BAIL_IF_ERRPASS(!retval, NULL);
+    PHYSFS_sint64 offset;
 
     assert(!entry->tree.isdir); /* should have been checked before calling. */
 
-    /* (inf) can be NULL if we already resolved. */
-    success = (inf == NULL) || zip_resolve(retval, inf, entry);
-    if (success)
+    if (finfo->io == NULL)
     {
-        PHYSFS_sint64 offset;
-        offset = ((entry->symlink) ? entry->symlink->offset : entry->offset);
-        success = retval->seek(retval, offset);
+        finfo->io = __PHYSFS_ioShare(finfo->info->io);
+        BAIL_IF_ERRPASS(!finfo->io, 0);
     } /* if */
 
-    if (!success)
-    {
-        retval->destroy(retval);
-        retval = NULL;
-    } /* if */
-
-    return retval;
+    BAIL_IF_ERRPASS((inf != NULL) && (!zip_resolve_locked(inf, entry)), 0);
+    offset = ((entry->symlink) ? entry->symlink->offset : entry->offset);
+    return finfo->io->seek(finfo->io, offset);
 } /* zip_get_io */
 
 
@@ -1556,31 +2413,43 @@ static PHYSFS_Io *ZIP_openRead(void *opaque, const char *filename)
 
     BAIL_IF_ERRPASS(!entry, NULL);
 
-    BAIL_IF_ERRPASS(!zip_resolve(info->io, info, entry), NULL);
+    BAIL_IF_ERRPASS(!zip_resolve_locked(info, entry), NULL);
 
     BAIL_IF(entry->tree.isdir, PHYSFS_ERR_NOT_A_FILE, NULL);
 
-    retval = (PHYSFS_Io *) allocator.Malloc(sizeof (PHYSFS_Io));
-    GOTO_IF(!retval, PHYSFS_ERR_OUT_OF_MEMORY, ZIP_openRead_failed);
+    /* stored, unencrypted entries in a mapped archive need no ZIP_Io. */
+    if ((password == NULL) && (!zip_entry_is_tradional_crypto(entry)))
+    {
+        const ZIPentry *real = (entry->symlink ? entry->symlink : entry);
+        if (real->compression_method == COMPMETH_NONE)
+        {
+            retval = __PHYSFS_ioMappedSubrange(info->io, real->offset,
+                                               real->uncompressed_size);
+            if ((retval != NULL) && (PHYSFS_getVerifyChecksums()))
+            {
+                /* it's all in memory anyhow, so check it all right now. */
+                const void *ptr = __PHYSFS_ioMappedRange(info->io,
+                                        real->offset, real->uncompressed_size);
+                const size_t len = (size_t) real->uncompressed_size;
+                if (__PHYSFS_crc32(0, ptr, len) != real->crc)
+                {
+                    retval->destroy(retval);
+                    BAIL(PHYSFS_ERR_CORRUPT, NULL);
+                } /* if */
+            } /* if */
 
-    finfo = (ZIPfileinfo *) allocator.Malloc(sizeof (ZIPfileinfo));
-    GOTO_IF(!finfo, PHYSFS_ERR_OUT_OF_MEMORY, ZIP_openRead_failed);
-    memset(finfo, '\0', sizeof (ZIPfileinfo));
+            if (retval != NULL)
+                return retval;
+        } /* if */
+    } /* if */
 
-    io = zip_get_io(info->io, info, entry);
-    GOTO_IF_ERRPASS(!io, ZIP_openRead_failed);
-    finfo->io = io;
-    finfo->entry = ((entry->symlink != NULL) ? entry->symlink : entry);
-    initializeZStream(&finfo->stream);
+    finfo = zip_alloc_finfo(info, entry->symlink ? entry->symlink : entry);
+    BAIL_IF_ERRPASS(!finfo, NULL);
 
-    if (finfo->entry->compression_method != COMPMETH_NONE)
-    {
-        finfo->buffer = (PHYSFS_uint8 *) allocator.Malloc(ZIP_READBUFSIZE);
-        if (!finfo->buffer)
-            GOTO(PHYSFS_ERR_OUT_OF_MEMORY, ZIP_openRead_failed);
-        else if (zlib_err(inflateInit2(&finfo->stream, -MAX_WBITS)) != Z_OK)
-            goto ZIP_openRead_failed;
-    } /* if */
+    GOTO_IF_ERRPASS(!zip_get_io(finfo, info, entry), ZIP_openRead_failed);
+    io = finfo->io;
+    finfo->cached = zip_use_block_cache(finfo->entry);
+    finfo->verify = PHYSFS_getVerifyChecksums();
 
     if (!zip_entry_is_tradional_crypto(entry))
         GOTO_IF(password != NULL, PHYSFS_ERR_BAD_PASSWORD, ZIP_openRead_failed);
@@ -1594,29 +2463,16 @@ static PHYSFS_Io *ZIP_openRead(void *opaque, const char *filename)
             goto ZIP_openRead_failed;
     } /* if */
 
+    retval = &finfo->self;
     memcpy(retval, &ZIP_Io, sizeof (PHYSFS_Io));
+    if (!zip_can_read_at(finfo))
+        retval->readAt = NULL;
     retval->opaque = finfo;
 
     return retval;
 
 ZIP_openRead_failed:
-    if (finfo != NULL)
-    {
-        if (finfo->io != NULL)
-            finfo->io->destroy(finfo->io);
-
-        if (finfo->buffer != NULL)
-        {
-            allocator.Free(finfo->buffer);
-            inflateEnd(&finfo->stream);
-        } /* if */
-
-        allocator.Free(finfo);
-    } /* if */
-
-    if (retval != NULL)
-        allocator.Free(retval);
-
+    zip_release_finfo(finfo);
     return NULL;
 } /* ZIP_openRead */
 
@@ -1653,7 +2509,7 @@ static int ZIP_stat(void *opaque, const char *filename, PHYSFS_Stat *stat)
     if (entry == NULL)
         return 0;
 
-    else if (!zip_resolve(info->io, info, entry))
+    else if (!zip_resolve_locked(info, entry))
         return 0;
 
     else if (entry->resolved == ZIP_DIRECTORY)
@@ -1704,6 +2560,567 @@ const PHYSFS_Archiver __PHYSFS_Archiver_ZIP =
     ZIP_closeArchive
 };
 
+
+/*
+ * Saved checkpoints are PHYSFS_loadSeekCheckpoints() input, which could be
+ *  anything, so they don't hold the decoder's struct as-is. Each one is the
+ *  handful of fields inflate needs to carry on (where it is in its state
+ *  machine, the bit buffer, the code lengths and the 32k window), written
+ *  out one at a time. Loading checks every field against what the decoder
+ *  could really have been doing at that state, and builds the Huffman
+ *  lookup tables from the code lengths again instead of trusting any, so a
+ *  bad file fails with PHYSFS_ERR_CORRUPT instead of steering the decoder
+ *  somewhere it can't safely go. The entry's crc and sizes catch the
+ *  archive changing underneath us.
+ */
+#define ZIP_CHECKPOINT_SIG      0x504B435A  /* "ZCKP" */
+#define ZIP_CHECKPOINT_VERSION  2
+
+static ZIPfileinfo *zip_checkpoint_finfo(PHYSFS_Io *io)
+{
+    ZIPfileinfo *finfo;
+    BAIL_IF(io->read != ZIP_read, PHYSFS_ERR_UNSUPPORTED, NULL);
+    finfo = (ZIPfileinfo *) io->opaque;
+    BAIL_IF(finfo->entry->compression_method != COMPMETH_DEFLATE,
+            PHYSFS_ERR_UNSUPPORTED, NULL);
+    return finfo;
+} /* zip_checkpoint_finfo */
+
+
+static int zip_write_inflate_state(PHYSFS_File *out, const inflate_state *s)
+{
+    const tinfl_decompressor *r = &s->m_decomp;
+    const PHYSFS_uint32 vals[] = {
+        r->m_state, r->m_num_bits, r->m_final, r->m_type, r->m_dist,
+        r->m_counter, r->m_num_extra, r->m_table_sizes[0],
+        r->m_table_sizes[1], r->m_table_sizes[2],
+        (PHYSFS_uint32) r->m_dist_from_out_buf_start,
+        s->m_dict_ofs, s->m_dict_avail, s->m_first_call,
+        (PHYSFS_uint32) s->m_last_status
+    };
+    size_t i;
+
+    for (i = 0; i < __PHYSFS_ARRAYLEN(vals); i++)
+        BAIL_IF_ERRPASS(!PHYSFS_writeULE32(out, vals[i]), 0);
+    BAIL_IF_ERRPASS(!PHYSFS_writeULE64(out, (PHYSFS_uint64) r->m_bit_buf), 0);
+
+    for (i = 0; i < TINFL_MAX_HUFF_TABLES; i++)
+    {
+        const PHYSFS_sint64 len = sizeof (r->m_tables[i].m_code_size);
+        BAIL_IF_ERRPASS(PHYSFS_writeBytes(out, r->m_tables[i].m_code_size,
+                                          len) != len, 0);
+    } /* for */
+
+    BAIL_IF_ERRPASS(PHYSFS_writeBytes(out, r->m_raw_header, 4) != 4, 0);
+    BAIL_IF_ERRPASS(PHYSFS_writeBytes(out, r->m_len_codes,
+                sizeof (r->m_len_codes)) != sizeof (r->m_len_codes), 0);
+    BAIL_IF_ERRPASS(PHYSFS_writeBytes(out, s->m_dict,
+                sizeof (s->m_dict)) != sizeof (s->m_dict), 0);
+    return 1;
+} /* zip_write_inflate_state */
+
+
+/*
+ * Build (t)'s lookup table and tree from its code lengths, the same way
+ *  tinfl_decompress() does when it starts a block, and with the same
+ *  checks, so the result is one the decoder could have made itself.
+ */
+static int zip_build_huff_table(tinfl_huff_table *t, const mz_uint size)
+{
+    mz_uint total_syms[16], next_code[17];
+    mz_uint i, used_syms = 0, total = 0, sym_index;
+    int tree_next = -1;
+
+    memset(total_syms, '\0', sizeof (total_syms));
+    memset(t->m_look_up, '\0', sizeof (t->m_look_up));
+    memset(t->m_tree, '\0', sizeof (t->m_tree));
+
+    for (i = 0; i < size; i++)
+        total_syms[t->m_code_size[i]]++;  /* caller checked these are < 16. */
+
+    next_code[0] = next_code[1] = 0;
+    for (i = 1; i <= 15; i++)
+    {
+        used_syms += total_syms[i];
+        next_code[i + 1] = (total = ((total + total_syms[i]) << 1));
+    } /* for */
+
+    BAIL_IF((total != 65536) && (used_syms > 1), PHYSFS_ERR_CORRUPT, 0);
+
+    for (sym_index = 0; sym_index < size; sym_index++)
+    {
+        const mz_uint code_size = t->m_code_size[sym_index];
+        mz_uint rev_code = 0, l, cur_code, j;
+        int tree_cur;
+
+        if (!code_size)
+            continue;
+
+        cur_code = next_code[code_size]++;
+        for (l = code_size; l > 0; l--, cur_code >>= 1)
+            rev_code = (rev_code << 1) | (cur_code & 1);
+
+        if (code_size <= TINFL_FAST_LOOKUP_BITS)
+        {
+            const mz_int16 k = (mz_int16) ((code_size << 9) | sym_index);
+            while (rev_code < TINFL_FAST_LOOKUP_SIZE)
+            {
+                t->m_look_up[rev_code] = k;
+                rev_code += (1 << code_size);
+            } /* while */
+            continue;
+        } /* if */
+
+        tree_cur = t->m_look_up[rev_code & (TINFL_FAST_LOOKUP_SIZE - 1)];
+        if (tree_cur == 0)
+        {
+            t->m_look_up[rev_code & (TINFL_FAST_LOOKUP_SIZE - 1)] =
+                                                    (mz_int16) tree_next;
+            tree_cur = tree_next;
+            tree_next -= 2;
+        } /* if */
+
+        rev_code >>= (TINFL_FAST_LOOKUP_BITS - 1);
+        for (j = code_size; j > (TINFL_FAST_LOOKUP_BITS + 1); j--)
+        {
+            tree_cur -= ((rev_code >>= 1) & 1);
+            if (!t->m_tree[-tree_cur - 1])
+            {
+                t->m_tree[-tree_cur - 1] = (mz_int16) tree_next;
+                tree_cur = tree_next;
+                tree_next -= 2;
+            } /* if */
+            else
+            {
+                tree_cur = t->m_tree[-tree_cur - 1];
+            } /* else */
+        } /* for */
+
+        tree_cur -= ((rev_code >>= 1) & 1);
+        t->m_tree[-tree_cur - 1] = (mz_int16) sym_index;
+    } /* for */
+
+    return 1;
+} /* zip_build_huff_table */
+
+
+/* every code length in (t)'s first (size) symbols fits in (maxbits)? */
+static int zip_check_code_sizes(const tinfl_huff_table *t, const mz_uint size,
+                                const mz_uint maxbits)
+{
+    mz_uint i;
+    for (i = 0; i < size; i++)
+        BAIL_IF(t->m_code_size[i] > maxbits, PHYSFS_ERR_CORRUPT, 0);
+    return 1;
+} /* zip_check_code_sizes */
+
+
+/*
+ * The tinfl_decompress() states a checkpoint can resume at, and what has to
+ *  hold for each. The numbers are its TINFL_CR_RETURN() points; the ones
+ *  left out are the zlib header and trailer (we inflate raw deflate data)
+ *  and the ones it can only leave by failing. Fields the decoder will set
+ *  before it next reads them can hold anything (the decoder doesn't
+ *  initialize them either), so those aren't checked, and the tables among
+ *  them are cleared.
+ */
+static int zip_check_inflate_state(tinfl_decompressor *r)
+{
+    const PHYSFS_uint32 counter = r->m_counter;
+    int codes = 0;    /* literal/length and distance tables in use? */
+    int lengths = 0;  /* code length table in use? */
+    int i;
+
+    switch (r->m_state)
+    {
+        case 0:   /* not started. */
+        case 3:   /* block header. */
+        case 5:   /* stored block: skipping to a byte boundary. */
+        case 34:  /* done. */
+            break;
+
+        case 6: case 7:  /* stored block: reading its length. */
+            BAIL_IF(counter >= 4, PHYSFS_ERR_CORRUPT, 0);
+            break;
+
+        case 9: case 38: case 51: case 52:  /* stored block: copying. */
+            BAIL_IF(counter > 0xFFFF, PHYSFS_ERR_CORRUPT, 0);
+            break;
+
+        case 11:  /* dynamic block: reading the table sizes. */
+            BAIL_IF(r->m_type != 2, PHYSFS_ERR_CORRUPT, 0);
+            BAIL_IF(counter >= 3, PHYSFS_ERR_CORRUPT, 0);
+            BAIL_IF((counter > 0) && ((r->m_table_sizes[0] < 257) ||
+                    (r->m_table_sizes[0] > TINFL_MAX_HUFF_SYMBOLS_0)),
+                    PHYSFS_ERR_CORRUPT, 0);
+            BAIL_IF((counter > 1) && ((r->m_table_sizes[1] < 1) ||
+                    (r->m_table_sizes[1] > TINFL_MAX_HUFF_SYMBOLS_1)),
+                    PHYSFS_ERR_CORRUPT, 0);
+            break;
+
+        case 14:  /* dynamic block: reading the code length code lengths. */
+        case 16:  /* dynamic block: reading the code lengths... */
+        case 18:  /*  ...and the extra bits of a repeat code. */
+            BAIL_IF(r->m_type != 2, PHYSFS_ERR_CORRUPT, 0);
+            BAIL_IF((r->m_table_sizes[0] < 257) ||
+                    (r->m_table_sizes[0] > TINFL_MAX_HUFF_SYMBOLS_0),
+                    PHYSFS_ERR_CORRUPT, 0);
+            BAIL_IF((r->m_table_sizes[1] < 1) ||
+                    (r->m_table_sizes[1] > TINFL_MAX_HUFF_SYMBOLS_1),
+                    PHYSFS_ERR_CORRUPT, 0);
+            BAIL_IF_ERRPASS(!zip_check_code_sizes(&r->m_tables[2],
+                                    TINFL_MAX_HUFF_SYMBOLS_2, 7), 0);
+            if (r->m_state == 14)
+            {
+                BAIL_IF((r->m_table_sizes[2] < 4) ||
+                        (r->m_table_sizes[2] > TINFL_MAX_HUFF_SYMBOLS_2),
+                        PHYSFS_ERR_CORRUPT, 0);
+                BAIL_IF(counter >= r->m_table_sizes[2], PHYSFS_ERR_CORRUPT, 0);
+                lengths = 1;
+                break;
+            } /* if */
+
+            BAIL_IF(r->m_table_sizes[2] != TINFL_MAX_HUFF_SYMBOLS_2,
+                    PHYSFS_ERR_CORRUPT, 0);
+            BAIL_IF(counter >= r->m_table_sizes[0] + r->m_table_sizes[1],
+                    PHYSFS_ERR_CORRUPT, 0);
+            for (i = 0; i < (int) counter; i++)
+                BAIL_IF(r->m_len_codes[i] > 15, PHYSFS_ERR_CORRUPT, 0);
+            if (r->m_state == 18)
+            {
+                /* a repeat code: (dist) is which, (num_extra) its bits. */
+                BAIL_IF((r->m_dist < 16) || (r->m_dist > 18),
+                        PHYSFS_ERR_CORRUPT, 0);
+                BAIL_IF(r->m_num_extra != (mz_uint) "\02\03\07"[r->m_dist - 16],
+                        PHYSFS_ERR_CORRUPT, 0);
+                BAIL_IF((r->m_dist == 16) && (counter == 0),
+                        PHYSFS_ERR_CORRUPT, 0);
+            } /* if */
+            BAIL_IF_ERRPASS(!zip_build_huff_table(&r->m_tables[2],
+                                    TINFL_MAX_HUFF_SYMBOLS_2), 0);
+            lengths = 1;
+            break;
+
+        case 23:  /* decoding a literal/length. */
+        case 24:  /* writing a literal. */
+        case 25:  /* reading a length's extra bits. */
+        case 26:  /* decoding a distance. */
+        case 27:  /* reading a distance's extra bits. */
+        case 53:  /* copying a match. */
+            BAIL_IF((r->m_table_sizes[0] < 257) ||
+                    (r->m_table_sizes[0] > TINFL_MAX_HUFF_SYMBOLS_0),
+                    PHYSFS_ERR_CORRUPT, 0);
+            BAIL_IF((r->m_table_sizes[1] < 1) ||
+                    (r->m_table_sizes[1] > TINFL_MAX_HUFF_SYMBOLS_1),
+                    PHYSFS_ERR_CORRUPT, 0);
+            BAIL_IF((r->m_state == 24) && (counter >= 256),
+                    PHYSFS_ERR_CORRUPT, 0);
+            BAIL_IF((r->m_state != 23) && (counter > 258),
+                    PHYSFS_ERR_CORRUPT, 0);
+            BAIL_IF((r->m_state == 25) &&
+                    ((r->m_num_extra < 1) || (r->m_num_extra > 5)),
+                    PHYSFS_ERR_CORRUPT, 0);
+            BAIL_IF((r->m_state == 27) &&
+                    ((r->m_num_extra < 1) || (r->m_num_extra > 13) ||
+                     (r->m_dist > TINFL_LZ_DICT_SIZE)),
+                    PHYSFS_ERR_CORRUPT, 0);
+            BAIL_IF_ERRPASS(!zip_check_code_sizes(&r->m_tables[0],
+                                    r->m_table_sizes[0], 15), 0);
+            BAIL_IF_ERRPASS(!zip_check_code_sizes(&r->m_tables[1],
+                                    r->m_table_sizes[1], 15), 0);
+            BAIL_IF_ERRPASS(!zip_build_huff_table(&r->m_tables[0],
+                                    r->m_table_sizes[0]), 0);
+            BAIL_IF_ERRPASS(!zip_build_huff_table(&r->m_tables[1],
+                                    r->m_table_sizes[1]), 0);
+            codes = 1;
+            break;
+
+        default:
+            BAIL(PHYSFS_ERR_CORRUPT, 0);
+    } /* switch */
+
+    if (!codes)
+    {
+        memset(&r->m_tables[0], '\0', sizeof (r->m_tables[0]));
+        memset(&r->m_tables[1], '\0', sizeof (r->m_tables[1]));
+    } /* if */
+
+    if (!lengths)
+    {
+        memset(&r->m_tables[2], '\0', sizeof (r->m_tables[2]));
+        memset(r->m_len_codes, '\0', sizeof (r->m_len_codes));
+    } /* if */
+
+    return 1;
+} /* zip_check_inflate_state */
+
+
+/* Read back what zip_write_inflate_state() wrote into a zeroed (s). */
+static int zip_read_inflate_state(PHYSFS_File *in, inflate_state *s)
+{
+    tinfl_decompressor *r = &s->m_decomp;
+    PHYSFS_uint32 vals[15];
+    PHYSFS_uint64 bitbuf;
+    size_t i;
+
+    for (i = 0; i < __PHYSFS_ARRAYLEN(vals); i++)
+        BAIL_IF_ERRPASS(!PHYSFS_readULE32(in, &vals[i]), 0);
+    BAIL_IF_ERRPASS(!PHYSFS_readULE64(in, &bitbuf), 0);
+
+    for (i = 0; i < TINFL_MAX_HUFF_TABLES; i++)
+    {
+        const PHYSFS_sint64 len = sizeof (r->m_tables[i].m_code_size);
+        BAIL_IF_ERRPASS(PHYSFS_readBytes(in, r->m_tables[i].m_code_size,
+                                         len) != len, 0);
+    } /* for */
+
+    BAIL_IF_ERRPASS(PHYSFS_readBytes(in, r->m_raw_header, 4) != 4, 0);
+    BAIL_IF_ERRPASS(PHYSFS_readBytes(in, r->m_len_codes,
+                sizeof (r->m_len_codes)) != sizeof (r->m_len_codes), 0);
+    BAIL_IF_ERRPASS(PHYSFS_readBytes(in, s->m_dict,
+                sizeof (s->m_dict)) != sizeof (s->m_dict), 0);
+
+    r->m_state = vals[0];
+    r->m_num_bits = vals[1];
+    r->m_final = vals[2];
+    r->m_type = vals[3];
+    r->m_dist = vals[4];
+    r->m_counter = vals[5];
+    r->m_num_extra = vals[6];
+    r->m_table_sizes[0] = vals[7];
+    r->m_table_sizes[1] = vals[8];
+    r->m_table_sizes[2] = vals[9];
+    r->m_dist_from_out_buf_start = (size_t) vals[10];  /* always masked. */
+    r->m_zhdr0 = r->m_zhdr1 = 0;  /* raw deflate: no zlib header... */
+    r->m_z_adler32 = r->m_check_adler32 = 1;  /* ...or trailer. */
+    s->m_dict_ofs = vals[11];
+    s->m_dict_avail = vals[12];
+    s->m_first_call = vals[13];
+    s->m_has_flushed = 0;
+    s->m_window_bits = -MAX_WBITS;
+    s->m_last_status = (tinfl_status) (PHYSFS_sint32) vals[14];
+
+    if (r->m_state == 0)  /* not started: the rest was never set. */
+    {
+        memset(r, '\0', sizeof (*r));
+        r->m_z_adler32 = r->m_check_adler32 = 1;
+        bitbuf = 0;
+    } /* if */
+
+    BAIL_IF(r->m_num_bits >= TINFL_BITBUF_SIZE, PHYSFS_ERR_CORRUPT, 0);
+    bitbuf &= (((PHYSFS_uint64) 1) << r->m_num_bits) - 1;
+    r->m_bit_buf = (tinfl_bit_buf_t) bitbuf;
+
+    BAIL_IF(s->m_dict_ofs >= TINFL_LZ_DICT_SIZE, PHYSFS_ERR_CORRUPT, 0);
+    BAIL_IF(s->m_dict_avail > TINFL_LZ_DICT_SIZE - s->m_dict_ofs,
+            PHYSFS_ERR_CORRUPT, 0);
+    BAIL_IF(s->m_first_call > 1, PHYSFS_ERR_CORRUPT, 0);
+    BAIL_IF((s->m_last_status != TINFL_STATUS_DONE) &&
+            (s->m_last_status != TINFL_STATUS_NEEDS_MORE_INPUT) &&
+            (s->m_last_status != TINFL_STATUS_HAS_MORE_OUTPUT),
+            PHYSFS_ERR_CORRUPT, 0);
+
+    return zip_check_inflate_state(r);
+} /* zip_read_inflate_state */
+
+
+int __PHYSFS_zipSaveCheckpoints(PHYSFS_Io *io, PHYSFS_File *out)
+{
+    ZIPfileinfo *finfo = zip_checkpoint_finfo(io);
+    const ZIPentry *entry;
+    inflate_state *state;
+    PHYSFS_uint32 count = 0;
+    PHYSFS_uint32 i;
+
+    BAIL_IF_ERRPASS(!finfo, 0);
+    entry = finfo->entry;
+
+    __PHYSFS_platformGrabMutex(finfo->info->lock);
+    if (entry->checkpoints != NULL)
+        count = entry->checkpoints->count;
+    __PHYSFS_platformReleaseMutex(finfo->info->lock);
+
+    BAIL_IF_ERRPASS(!PHYSFS_writeULE32(out, ZIP_CHECKPOINT_SIG), 0);
+    BAIL_IF_ERRPASS(!PHYSFS_writeULE32(out, ZIP_CHECKPOINT_VERSION), 0);
+    BAIL_IF_ERRPASS(!PHYSFS_writeULE32(out, entry->crc), 0);
+    BAIL_IF_ERRPASS(!PHYSFS_writeULE64(out, entry->compressed_size), 0);
+    BAIL_IF_ERRPASS(!PHYSFS_writeULE64(out, entry->uncompressed_size), 0);
+    BAIL_IF_ERRPASS(!PHYSFS_writeULE32(out, count), 0);
+
+    if (count == 0)
+        return 1;
+
+    state = (inflate_state *) allocator.Malloc(sizeof (inflate_state));
+    BAIL_IF(!state, PHYSFS_ERR_OUT_OF_MEMORY, 0);
+
+    /* the list only grows, but it can move, so copy each point out. */
+    for (i = 0; i < count; i++)
+    {
+        ZIPcheckpoint cp;
+        __PHYSFS_platformGrabMutex(finfo->info->lock);
+        memcpy(&cp, &entry->checkpoints->points[i], sizeof (cp));
+        memcpy(state, cp.state, sizeof (inflate_state));
+        __PHYSFS_platformReleaseMutex(finfo->info->lock);
+
+        if ( (!PHYSFS_writeULE32(out, cp.uncompressed_position)) ||
+             (!PHYSFS_writeULE32(out, cp.compressed_position)) ||
+             (!PHYSFS_writeULE32(out, cp.crypto_keys[0])) ||
+             (!PHYSFS_writeULE32(out, cp.crypto_keys[1])) ||
+             (!PHYSFS_writeULE32(out, cp.crypto_keys[2])) ||
+             (!zip_write_inflate_state(out, state)) )
+        {
+            allocator.Free(state);
+            return 0;
+        } /* if */
+    } /* for */
+
+    allocator.Free(state);
+    return 1;
+} /* __PHYSFS_zipSaveCheckpoints */
+
+
+int __PHYSFS_zipLoadCheckpoints(PHYSFS_Io *io, PHYSFS_File *in)
+{
+    ZIPfileinfo *finfo = zip_checkpoint_finfo(io);
+    ZIPcheckpoint *points = NULL;
+    const ZIPentry *entry;
+    PHYSFS_uint32 ui32, count, i;
+    PHYSFS_uint32 loaded = 0;
+    PHYSFS_uint64 ui64;
+    int retval = 0;
+
+    BAIL_IF_ERRPASS(!finfo, 0);
+    entry = finfo->entry;
+
+    BAIL_IF_ERRPASS(!PHYSFS_readULE32(in, &ui32), 0);
+    BAIL_IF(ui32 != ZIP_CHECKPOINT_SIG, PHYSFS_ERR_CORRUPT, 0);
+    BAIL_IF_ERRPASS(!PHYSFS_readULE32(in, &ui32), 0);
+    BAIL_IF(ui32 != ZIP_CHECKPOINT_VERSION, PHYSFS_ERR_CORRUPT, 0);
+    BAIL_IF_ERRPASS(!PHYSFS_readULE32(in, &ui32), 0);
+    BAIL_IF(ui32 != entry->crc, PHYSFS_ERR_CORRUPT, 0);
+    BAIL_IF_ERRPASS(!PHYSFS_readULE64(in, &ui64), 0);
+    BAIL_IF(ui64 != entry->compressed_size, PHYSFS_ERR_CORRUPT, 0);
+    BAIL_IF_ERRPASS(!PHYSFS_readULE64(in, &ui64), 0);
+    BAIL_IF(ui64 != entry->uncompressed_size, PHYSFS_ERR_CORRUPT, 0);
+    BAIL_IF_ERRPASS(!PHYSFS_readULE32(in, &count), 0);
+    BAIL_IF(count > entry->uncompressed_size, PHYSFS_ERR_CORRUPT, 0);
+
+    if (count == 0)
+        return 1;
+
+    /* read everything before touching the entry, so failure loads nothing. */
+    points = (ZIPcheckpoint *) allocator.Malloc(sizeof (ZIPcheckpoint) * count);
+    BAIL_IF(!points, PHYSFS_ERR_OUT_OF_MEMORY, 0);
+
+    for (loaded = 0; loaded < count; loaded++)
+    {
+        ZIPcheckpoint *cp = &points[loaded];
+        if ( (!PHYSFS_readULE32(in, &cp->uncompressed_position)) ||
+             (!PHYSFS_readULE32(in, &cp->compressed_position)) ||
+             (!PHYSFS_readULE32(in, &cp->crypto_keys[0])) ||
+             (!PHYSFS_readULE32(in, &cp->crypto_keys[1])) ||
+             (!PHYSFS_readULE32(in, &cp->crypto_keys[2])) )
+            goto load_failed;
+
+        GOTO_IF(cp->uncompressed_position > entry->uncompressed_size,
+                PHYSFS_ERR_CORRUPT, load_failed);
+        GOTO_IF(cp->compressed_position > entry->compressed_size,
+                PHYSFS_ERR_CORRUPT, load_failed);
+        GOTO_IF((loaded > 0) && (cp->uncompressed_position <=
+                 points[loaded - 1].uncompressed_position),
+                PHYSFS_ERR_CORRUPT, load_failed);
+
+        cp->state = (inflate_state *) allocator.Malloc(sizeof (inflate_state));
+        GOTO_IF(!cp->state, PHYSFS_ERR_OUT_OF_MEMORY, load_failed);
+        memset(cp->state, '\0', sizeof (inflate_state));
+        if (!zip_read_inflate_state(in, cp->state))
+        {
+            allocator.Free(cp->state);
+            goto load_failed;
+        } /* if */
+    } /* for */
+
+    retval = 1;
+    __PHYSFS_platformGrabMutex(finfo->info->lock);
+    for (i = 0; i < count; i++)
+    {
+        if (!zip_append_checkpoint(finfo->info, finfo->entry, &points[i]))
+            retval = 0;  /* keep going, so every state is consumed. */
+    } /* for */
+    __PHYSFS_platformReleaseMutex(finfo->info->lock);
+
+    allocator.Free(points);
+    return retval;
+
+load_failed:
+    for (i = 0; i < loaded; i++)
+        allocator.Free(points[i].state);
+    allocator.Free(points);
+    return 0;
+} /* __PHYSFS_zipLoadCheckpoints */
+
+
+int __PHYSFS_zipEntryOffset(PHYSFS_Io *io, PHYSFS_uint64 *offset)
+{
+    if (io->read != ZIP_read)
+        return 0;
+    *offset = ((ZIPfileinfo *) io->opaque)->entry->offset;
+    return 1;
+} /* __PHYSFS_zipEntryOffset */
+
+
+/*
+ * This just swaps our usual ZIP_READBUFSIZE buffer for one holding all the
+ *  remaining input, and hands all of it to inflate at once. ZIP_read() then
+ *  never needs to refill, and a later rewind simply reuses the big buffer.
+ */
+int __PHYSFS_zipPreload(PHYSFS_Io *io)
+{
+    ZIPfileinfo *finfo;
+    PHYSFS_uint64 remaining;
+    PHYSFS_uint8 *buf;
+
+    if (io->read != ZIP_read)
+        return -1;
+
+    finfo = (ZIPfileinfo *) io->opaque;
+    if (finfo->entry->compression_method == COMPMETH_NONE)
+        return -1;
+    else if (finfo->stream.avail_in != 0)
+        return 1;  /* already mid-buffer; just let it go as usual. */
+
+    remaining = finfo->entry->compressed_size - finfo->compressed_position;
+    if (zip_entry_is_tradional_crypto(finfo->entry))  /* minus the header. */
+        remaining = (remaining > 12) ? remaining - 12 : 0;
+    if (remaining <= ZIP_READBUFSIZE)
+        buf = finfo->buffer;
+    else
+    {
+        BAIL_IF(remaining > 0xFFFFFFFF, PHYSFS_ERR_OUT_OF_MEMORY, 0);
+        buf = (PHYSFS_uint8 *) allocator.Malloc((size_t) remaining);
+        BAIL_IF(!buf, PHYSFS_ERR_OUT_OF_MEMORY, 0);
+    } /* else */
+
+    if (zip_read_decrypt(finfo, buf, remaining) != (PHYSFS_sint64) remaining)
+    {
+        if (buf != finfo->buffer)
+            allocator.Free(buf);
+        return 0;
+    } /* if */
+
+    if (buf != finfo->buffer)
+    {
+        allocator.Free(finfo->buffer);
+        finfo->buffer = buf;
+        finfo->bigbuffer = 1;
+    } /* if */
+
+    finfo->compressed_position += (PHYSFS_uint32) remaining;
+    finfo->stream.next_in = buf;
+    finfo->stream.avail_in = (uInt) remaining;
+    return 1;
+} /* __PHYSFS_zipPreload */
+
 #endif  /* defined PHYSFS_SUPPORTS_ZIP */
 
 /* end of physfs_archiver_zip.c ... */
@@ -0,0 +1,668 @@
+/**
+ * PhysicsFS; a portable, flexible file i/o abstraction.
+ *
+ * Documentation is in physfs.h. It's verbose, honest.  :)
+ *
+ * Please see the file LICENSE.txt in the source's root directory.
+ *
+ *  This file written by Ryan C. Gordon.
+ */
+
+/*
+ * Async reads. Requests land in (incoming) without blocking the caller. A
+ *  worker takes everything in there at once, opens it all (which is the
+ *  part that can block on the archive), and moves it to (ready), sorted by
+ *  archive and offset. Workers then pick from (ready) like an elevator: the
+ *  next request in the archive they last read from, past where they left
+ *  off, so a burst of requests against one archive becomes a forward sweep.
+ *
+ * There's no condition variable in the platform layer, so sleeping workers
+ *  count themselves in (sleepers) and wait on a semaphore; whoever changes
+ *  something a sleeper might care about posts it once per sleeper. Callers
+ *  blocked in PHYSFS_waitAsync() do the same thing with (doneSem).
+ */
+
+#define __PHYSICSFS_INTERNAL__
+#include "physfs_internal.h"
+
+#ifndef PHYSFS_ASYNC_THREADS
+#define PHYSFS_ASYNC_THREADS 2
+#endif
+
+typedef enum
+{
+    ASYNC_QUEUED,   /* in (incoming), not opened yet. */
+    ASYNC_OPENING,  /* a worker is opening it right now. */
+    ASYNC_READY,    /* opened, in (ready). */
+    ASYNC_RUNNING,  /* a worker is reading it right now. */
+    ASYNC_DONE      /* finished, callback has returned. */
+} AsyncState;
+
+struct PHYSFS_AsyncRequest
+{
+    char *filename;
+    PHYSFS_uint64 offset;
+    void *buffer;
+    PHYSFS_uint64 len;
+    PHYSFS_AsyncCallback callback;
+    void *data;
+    PHYSFS_File *file;         /* open once it's ASYNC_READY. */
+    PHYSFS_Io *io;             /* readAt() this instead, for prefetches. */
+    const void *archive;       /* where (file) came from, for ordering... */
+    PHYSFS_uint64 position;    /* ...and where in there our data starts. */
+    PHYSFS_sint64 result;
+    PHYSFS_ErrorCode error;
+    AsyncState state;
+    int cancelled;             /* cancelled while ASYNC_OPENING. */
+    struct PHYSFS_AsyncRequest *next;     /* in (incoming) or (ready). */
+    struct PHYSFS_AsyncRequest *nextAll;  /* in (allRequests). */
+};
+
+static void *asyncLock = NULL;  /* protects everything below. */
+static void *workSem = NULL;
+static void *doneSem = NULL;
+static void *workers[PHYSFS_ASYNC_THREADS];
+static int numWorkers = 0;
+static int triedWorkers = 0;
+static int shuttingDown = 0;
+static int workSleepers = 0;
+static int doneSleepers = 0;
+static PHYSFS_AsyncRequest *incoming = NULL;
+static PHYSFS_AsyncRequest *incomingTail = NULL;
+static PHYSFS_AsyncRequest *ready = NULL;
+static PHYSFS_AsyncRequest *allRequests = NULL;
+
+
+/* Must hold asyncLock. */
+static void wakeSleepers(void *sem, int *sleepers, const int all)
+{
+    while (*sleepers > 0)
+    {
+        __PHYSFS_platformPostSemaphore(sem);
+        (*sleepers)--;
+        if (!all)
+            break;
+    } /* while */
+} /* wakeSleepers */
+
+
+/* Must hold asyncLock; it's released while we sleep. */
+static void sleepOn(void *sem, int *sleepers)
+{
+    (*sleepers)++;
+    __PHYSFS_platformReleaseMutex(asyncLock);
+    __PHYSFS_platformWaitSemaphore(sem);
+    __PHYSFS_platformGrabMutex(asyncLock);
+} /* sleepOn */
+
+
+/* Call without asyncLock held; the callback might take a while. */
+static void finishRequest(PHYSFS_AsyncRequest *req, const PHYSFS_sint64 rc,
+                          const PHYSFS_ErrorCode err)
+{
+    if (req->file != NULL)
+    {
+        PHYSFS_close(req->file);
+        req->file = NULL;
+    } /* if */
+
+    req->result = rc;
+    req->error = err;
+    if (req->callback != NULL)
+        req->callback(req->data, rc, err);
+
+    __PHYSFS_platformGrabMutex(asyncLock);
+    req->state = ASYNC_DONE;
+    wakeSleepers(doneSem, &doneSleepers, 1);
+    __PHYSFS_platformReleaseMutex(asyncLock);
+} /* finishRequest */
+
+
+static void failRequest(PHYSFS_AsyncRequest *req)
+{
+    PHYSFS_ErrorCode err = PHYSFS_getLastErrorCode();
+    if (err == PHYSFS_ERR_OK)
+        err = PHYSFS_ERR_OTHER_ERROR;
+    finishRequest(req, -1, err);
+} /* failRequest */
+
+
+static void runIoRequest(PHYSFS_AsyncRequest *req)
+{
+    PHYSFS_Io *io = req->io;
+    PHYSFS_uint8 *ptr = (PHYSFS_uint8 *) req->buffer;
+    PHYSFS_uint64 remaining = req->len;
+    PHYSFS_sint64 total = 0;
+
+    while (remaining > 0)
+    {
+        const PHYSFS_sint64 rc = io->readAt(io, req->offset + total,
+                                            ptr, remaining);
+        if (rc < 0)
+        {
+            failRequest(req);
+            return;
+        } /* if */
+        else if (rc == 0)
+        {
+            break;  /* EOF. */
+        } /* else if */
+
+        ptr += rc;
+        remaining -= (PHYSFS_uint64) rc;
+        total += rc;
+    } /* while */
+
+    finishRequest(req, total, PHYSFS_ERR_OK);
+} /* runIoRequest */
+
+
+static void runRequest(PHYSFS_AsyncRequest *req)
+{
+    PHYSFS_uint8 *ptr = (PHYSFS_uint8 *) req->buffer;
+    PHYSFS_uint64 remaining = req->len;
+    PHYSFS_sint64 total = 0;
+
+    if (req->io != NULL)
+    {
+        runIoRequest(req);
+        return;
+    } /* if */
+
+    if ((req->offset > 0) && (!PHYSFS_seek(req->file, req->offset)))
+    {
+        failRequest(req);
+        return;
+    } /* if */
+
+    while (remaining > 0)
+    {
+        const PHYSFS_sint64 rc = PHYSFS_readBytes(req->file, ptr, remaining);
+        if (rc < 0)
+        {
+            failRequest(req);
+            return;
+        } /* if */
+        else if (rc == 0)
+        {
+            break;  /* EOF. */
+        } /* else if */
+
+        ptr += rc;
+        remaining -= (PHYSFS_uint64) rc;
+        total += rc;
+    } /* while */
+
+    finishRequest(req, total, PHYSFS_ERR_OK);
+} /* runRequest */
+
+
+/* Must hold asyncLock. Keeps (ready) sorted by archive, then position. */
+static void insertReady(PHYSFS_AsyncRequest *req)
+{
+    PHYSFS_AsyncRequest **i;
+    for (i = &ready; *i != NULL; i = &(*i)->next)
+    {
+        const PHYSFS_AsyncRequest *r = *i;
+        if ( (r->archive > req->archive) ||
+             ((r->archive == req->archive) && (r->position > req->position)) )
+            break;
+    } /* for */
+
+    req->state = ASYNC_READY;
+    req->next = *i;
+    *i = req;
+} /* insertReady */
+
+
+/*
+ * Must hold asyncLock. Take the first ready request in (archive) at or past
+ *  (position); failing that, the first one in (archive); failing that, the
+ *  first one at all.
+ */
+static PHYSFS_AsyncRequest *takeReady(const void *archive,
+                                      const PHYSFS_uint64 position)
+{
+    PHYSFS_AsyncRequest **best = NULL;
+    PHYSFS_AsyncRequest **i;
+    PHYSFS_AsyncRequest *retval;
+
+    for (i = &ready; *i != NULL; i = &(*i)->next)
+    {
+        if ((*i)->archive == archive)
+        {
+            if (best == NULL)
+                best = i;  /* wrap around to here if nothing's ahead. */
+            if ((*i)->position >= position)
+            {
+                best = i;
+                break;
+            } /* if */
+        } /* if */
+    } /* for */
+
+    if (best == NULL)
+        best = &ready;
+
+    retval = *best;
+    *best = retval->next;
+    retval->next = NULL;
+    retval->state = ASYNC_RUNNING;
+    return retval;
+} /* takeReady */
+
+
+/*
+ * Call without asyncLock held. Returns non-zero if (req) is open and should
+ *  be read; otherwise it has already been finished, one way or another.
+ */
+static int openRequest(PHYSFS_AsyncRequest *req)
+{
+    int cancelled;
+
+    req->file = PHYSFS_openRead(req->filename);
+    if (req->file != NULL)
+    {
+        __PHYSFS_fileArchiveOffset(req->file, &req->archive, &req->position);
+        req->position += req->offset;
+    } /* if */
+
+    __PHYSFS_platformGrabMutex(asyncLock);
+    cancelled = req->cancelled;
+    __PHYSFS_platformReleaseMutex(asyncLock);
+
+    if (cancelled)
+        finishRequest(req, -1, PHYSFS_ERR_CANCELLED);
+    else if (req->file == NULL)
+        failRequest(req);
+    else
+        return 1;
+
+    return 0;
+} /* openRequest */
+
+
+/* Must hold asyncLock, which is released while opening. */
+static void openIncoming(void)
+{
+    PHYSFS_AsyncRequest *batch = incoming;
+    PHYSFS_AsyncRequest *req;
+    PHYSFS_AsyncRequest *next;
+
+    incoming = incomingTail = NULL;
+    for (req = batch; req != NULL; req = req->next)
+        req->state = ASYNC_OPENING;
+    __PHYSFS_platformReleaseMutex(asyncLock);
+
+    for (req = batch; req != NULL; req = next)
+    {
+        next = req->next;
+        req->next = NULL;
+        if (openRequest(req))
+        {
+            __PHYSFS_platformGrabMutex(asyncLock);
+            insertReady(req);
+            wakeSleepers(workSem, &workSleepers, 0);
+            __PHYSFS_platformReleaseMutex(asyncLock);
+        } /* if */
+    } /* for */
+
+    __PHYSFS_platformGrabMutex(asyncLock);
+} /* openIncoming */
+
+
+static void asyncWorker(void *unused)
+{
+    const void *archive = NULL;
+    PHYSFS_uint64 position = 0;
+
+    __PHYSFS_platformGrabMutex(asyncLock);
+    while (!shuttingDown)
+    {
+        if (ready != NULL)
+        {
+            PHYSFS_AsyncRequest *req = takeReady(archive, position);
+            archive = req->archive;
+            position = req->position + req->len;
+            __PHYSFS_platformReleaseMutex(asyncLock);
+            runRequest(req);
+            __PHYSFS_platformGrabMutex(asyncLock);
+        } /* if */
+
+        else if (incoming != NULL)
+        {
+            openIncoming();
+        } /* else if */
+
+        else
+        {
+            sleepOn(workSem, &workSleepers);
+        } /* else */
+    } /* while */
+    __PHYSFS_platformReleaseMutex(asyncLock);
+} /* asyncWorker */
+
+
+/* Must hold asyncLock. Failing to start any is fine; see PHYSFS_readAsync. */
+static void startWorkers(void)
+{
+    triedWorkers = 1;
+
+    workSem = __PHYSFS_platformCreateSemaphore();
+    doneSem = __PHYSFS_platformCreateSemaphore();
+    if ((workSem == NULL) || (doneSem == NULL))
+        return;
+
+    while (numWorkers < PHYSFS_ASYNC_THREADS)
+    {
+        workers[numWorkers] = __PHYSFS_platformCreateThread(asyncWorker, NULL);
+        if (workers[numWorkers] == NULL)
+            break;
+        numWorkers++;
+    } /* while */
+} /* startWorkers */
+
+
+int __PHYSFS_asyncInit(void)
+{
+    asyncLock = __PHYSFS_platformCreateMutex();
+    BAIL_IF(!asyncLock, PHYSFS_ERR_OUT_OF_MEMORY, 0);
+    return 1;
+} /* __PHYSFS_asyncInit */
+
+
+void __PHYSFS_asyncDeinit(void)
+{
+    PHYSFS_AsyncRequest *req;
+    int i;
+
+    if (asyncLock == NULL)
+        return;
+
+    __PHYSFS_platformGrabMutex(asyncLock);
+    shuttingDown = 1;
+    wakeSleepers(workSem, &workSleepers, 1);
+    __PHYSFS_platformReleaseMutex(asyncLock);
+
+    for (i = 0; i < numWorkers; i++)
+        __PHYSFS_platformJoinThread(workers[i]);
+
+    /* nobody's left to run these. */
+    while ((req = incoming) != NULL)
+    {
+        incoming = req->next;
+        finishRequest(req, -1, PHYSFS_ERR_CANCELLED);
+    } /* while */
+
+    while ((req = ready) != NULL)
+    {
+        ready = req->next;
+        finishRequest(req, -1, PHYSFS_ERR_CANCELLED);
+    } /* while */
+
+    while ((req = allRequests) != NULL)
+    {
+        allRequests = req->nextAll;
+        if (req->filename != NULL)
+            allocator.Free(req->filename);
+        allocator.Free(req);
+    } /* while */
+
+    if (workSem != NULL)
+        __PHYSFS_platformDestroySemaphore(workSem);
+    if (doneSem != NULL)
+        __PHYSFS_platformDestroySemaphore(doneSem);
+    __PHYSFS_platformDestroyMutex(asyncLock);
+
+    asyncLock = workSem = doneSem = NULL;
+    incomingTail = NULL;
+    numWorkers = triedWorkers = shuttingDown = 0;
+    workSleepers = doneSleepers = 0;
+} /* __PHYSFS_asyncDeinit */
+
+
+/* Must hold asyncLock. */
+static void unlinkRequest(PHYSFS_AsyncRequest *req)
+{
+    PHYSFS_AsyncRequest **i;
+    for (i = &allRequests; *i != NULL; i = &(*i)->nextAll)
+    {
+        if (*i == req)
+        {
+            *i = req->nextAll;
+            break;
+        } /* if */
+    } /* for */
+} /* unlinkRequest */
+
+
+PHYSFS_AsyncRequest *PHYSFS_readAsync(const char *filename,
+                                      PHYSFS_uint64 offset, void *buffer,
+                                      PHYSFS_uint64 len,
+                                      PHYSFS_AsyncCallback callback,
+                                      void *data)
+{
+    PHYSFS_AsyncRequest *req;
+
+    BAIL_IF(!asyncLock, PHYSFS_ERR_NOT_INITIALIZED, NULL);
+    BAIL_IF(!filename, PHYSFS_ERR_INVALID_ARGUMENT, NULL);
+    BAIL_IF((!buffer) && (len > 0), PHYSFS_ERR_INVALID_ARGUMENT, NULL);
+
+    req = (PHYSFS_AsyncRequest *) allocator.Malloc(sizeof (*req));
+    BAIL_IF(!req, PHYSFS_ERR_OUT_OF_MEMORY, NULL);
+    memset(req, '\0', sizeof (*req));
+
+    req->filename = (char *) allocator.Malloc(strlen(filename) + 1);
+    if (!req->filename)
+    {
+        allocator.Free(req);
+        BAIL(PHYSFS_ERR_OUT_OF_MEMORY, NULL);
+    } /* if */
+
+    strcpy(req->filename, filename);
+    req->offset = offset;
+    req->buffer = buffer;
+    req->len = len;
+    req->callback = callback;
+    req->data = data;
+    req->state = ASYNC_QUEUED;
+
+    __PHYSFS_platformGrabMutex(asyncLock);
+
+    if (!triedWorkers)
+        startWorkers();
+
+    req->nextAll = allRequests;
+    allRequests = req;
+
+    if (numWorkers > 0)
+    {
+        if (incomingTail == NULL)
+            incoming = req;
+        else
+            incomingTail->next = req;
+        incomingTail = req;
+        wakeSleepers(workSem, &workSleepers, 0);
+        __PHYSFS_platformReleaseMutex(asyncLock);
+    } /* if */
+
+    else  /* no threads, so just do it now. */
+    {
+        req->state = ASYNC_OPENING;
+        __PHYSFS_platformReleaseMutex(asyncLock);
+        if (openRequest(req))
+        {
+            __PHYSFS_platformGrabMutex(asyncLock);
+            req->state = ASYNC_RUNNING;
+            __PHYSFS_platformReleaseMutex(asyncLock);
+            runRequest(req);
+        } /* if */
+    } /* else */
+
+    return req;
+} /* PHYSFS_readAsync */
+
+
+int PHYSFS_pollAsync(PHYSFS_AsyncRequest *req)
+{
+    int retval;
+    BAIL_IF(!req, PHYSFS_ERR_INVALID_ARGUMENT, 0);
+    __PHYSFS_platformGrabMutex(asyncLock);
+    retval = (req->state == ASYNC_DONE);
+    __PHYSFS_platformReleaseMutex(asyncLock);
+    return retval;
+} /* PHYSFS_pollAsync */
+
+
+PHYSFS_sint64 PHYSFS_waitAsync(PHYSFS_AsyncRequest *req)
+{
+    PHYSFS_ErrorCode err;
+    PHYSFS_sint64 retval;
+
+    BAIL_IF(!req, PHYSFS_ERR_INVALID_ARGUMENT, -1);
+
+    __PHYSFS_platformGrabMutex(asyncLock);
+    while (req->state != ASYNC_DONE)
+        sleepOn(doneSem, &doneSleepers);
+    unlinkRequest(req);
+    __PHYSFS_platformReleaseMutex(asyncLock);
+
+    retval = req->result;
+    err = req->error;
+    allocator.Free(req->filename);
+    allocator.Free(req);
+
+    BAIL_IF(retval < 0, err, -1);
+    return retval;
+} /* PHYSFS_waitAsync */
+
+
+int PHYSFS_cancelAsync(PHYSFS_AsyncRequest *req)
+{
+    PHYSFS_AsyncRequest **list = NULL;
+    PHYSFS_AsyncRequest **i;
+    PHYSFS_AsyncRequest *prev = NULL;
+    int retval = 0;
+
+    BAIL_IF(!req, PHYSFS_ERR_INVALID_ARGUMENT, 0);
+
+    __PHYSFS_platformGrabMutex(asyncLock);
+
+    if (req->state == ASYNC_QUEUED)
+        list = &incoming;
+    else if (req->state == ASYNC_READY)
+        list = &ready;
+    else if (req->state == ASYNC_OPENING)
+    {
+        req->cancelled = 1;  /* the opener will finish it. */
+        retval = 1;
+    } /* else if */
+
+    if (list != NULL)
+    {
+        for (i = list; *i != NULL; prev = *i, i = &(*i)->next)
+        {
+            if (*i == req)
+            {
+                *i = req->next;
+                if (req == incomingTail)
+                    incomingTail = prev;
+                req->next = NULL;
+                req->state = ASYNC_RUNNING;  /* nobody else will touch it. */
+                retval = 1;
+                break;
+            } /* if */
+        } /* for */
+    } /* if */
+
+    __PHYSFS_platformReleaseMutex(asyncLock);
+
+    if ((retval) && (list != NULL))
+        finishRequest(req, -1, PHYSFS_ERR_CANCELLED);
+
+    return retval;
+} /* PHYSFS_cancelAsync */
+
+PHYSFS_AsyncRequest *__PHYSFS_asyncReadIo(PHYSFS_Io *io,
+                                          const PHYSFS_uint64 offset,
+                                          void *buffer,
+                                          const PHYSFS_uint64 len)
+{
+    PHYSFS_AsyncRequest *req;
+
+    assert(__PHYSFS_ioCanReadAt(io));
+
+    if (asyncLock == NULL)
+        return NULL;
+
+    req = (PHYSFS_AsyncRequest *) allocator.Malloc(sizeof (*req));
+    if (!req)
+        return NULL;  /* just a prefetch, not worth an error. */
+    memset(req, '\0', sizeof (*req));
+
+    req->io = io;
+    req->offset = offset;
+    req->buffer = buffer;
+    req->len = len;
+    req->archive = io;  /* there's nothing to open; it's ready to go. */
+    req->position = offset;
+
+    __PHYSFS_platformGrabMutex(asyncLock);
+
+    if (!triedWorkers)
+        startWorkers();
+
+    if (numWorkers == 0)  /* no threads, and sync would defeat the point. */
+    {
+        __PHYSFS_platformReleaseMutex(asyncLock);
+        allocator.Free(req);
+        return NULL;
+    } /* if */
+
+    req->nextAll = allRequests;
+    allRequests = req;
+    insertReady(req);
+    wakeSleepers(workSem, &workSleepers, 0);
+    __PHYSFS_platformReleaseMutex(asyncLock);
+
+    return req;
+} /* __PHYSFS_asyncReadIo */
+
+
+PHYSFS_sint64 __PHYSFS_asyncFinishIo(PHYSFS_AsyncRequest *req,
+                                     const int cancel)
+{
+    PHYSFS_AsyncRequest **i;
+    PHYSFS_sint64 retval = -1;
+    int dropped = 0;
+
+    __PHYSFS_platformGrabMutex(asyncLock);
+
+    if ((cancel) && (req->state == ASYNC_READY))
+    {
+        for (i = &ready; *i != NULL; i = &(*i)->next)
+        {
+            if (*i == req)
+            {
+                *i = req->next;
+                dropped = 1;
+                break;
+            } /* if */
+        } /* for */
+    } /* if */
+
+    if (!dropped)
+    {
+        while (req->state != ASYNC_DONE)
+            sleepOn(doneSem, &doneSleepers);
+        retval = req->result;
+    } /* if */
+
+    unlinkRequest(req);
+    __PHYSFS_platformReleaseMutex(asyncLock);
+
+    allocator.Free(req);
+    return retval;
+} /* __PHYSFS_asyncFinishIo */
+
+/* end of physfs_async.c ... */
@@ -0,0 +1,287 @@
+/**
+ * PhysicsFS; a portable, flexible file i/o abstraction.
+ *
+ * Documentation is in physfs.h. It's verbose, honest.  :)
+ *
+ * Please see the file LICENSE.txt in the source's root directory.
+ *
+ *  This file written by Ryan C. Gordon.
+ */
+
+/*
+ * The decompressed block cache. Archivers hand us blocks of data they had to
+ *  decode, as memory Ios, and ask for them back by (archive, entry, index)
+ *  before decoding again. Each cached block is one reference to its Io, so a
+ *  hit is just another reference: it stays good after the cache evicts it,
+ *  and nothing gets copied while (cacheLock) is held.
+ *
+ * Blocks live in a small hash table for lookups and on one list in order of
+ *  use, most recent first; when the total size goes over the budget, blocks
+ *  come off the end of that list until it doesn't.
+ */
+
+#define __PHYSICSFS_INTERNAL__
+#include "physfs_internal.h"
+
+#ifndef PHYSFS_BLOCK_CACHE_BUDGET
+#define PHYSFS_BLOCK_CACHE_BUDGET (64 * 1024 * 1024)
+#endif
+
+#define BLOCKCACHE_BUCKETS 256  /* must be a power of two. */
+
+typedef struct CachedBlock
+{
+    const void *archive;
+    const void *entry;
+    PHYSFS_uint64 index;
+    PHYSFS_Io *io;
+    PHYSFS_uint64 len;
+    struct CachedBlock *hashnext;
+    struct CachedBlock *prev;  /* more recently used. */
+    struct CachedBlock *next;  /* less recently used. */
+} CachedBlock;
+
+static void *cacheLock = NULL;
+static PHYSFS_uint64 cacheBudget = PHYSFS_BLOCK_CACHE_BUDGET;
+static CachedBlock *buckets[BLOCKCACHE_BUCKETS];
+static CachedBlock *mostRecent = NULL;
+static CachedBlock *leastRecent = NULL;
+static PHYSFS_BlockCacheStats cacheStats;
+
+
+static PHYSFS_uint32 hashBlock(const void *archive, const void *entry,
+                               const PHYSFS_uint64 index)
+{
+    /* pointers are aligned and blocks are numbered in order; mix them up. */
+    PHYSFS_uint64 h = (PHYSFS_uint64) (size_t) archive;
+    h ^= ((PHYSFS_uint64) (size_t) entry) * __PHYSFS_UI64(0x9E3779B97F4A7C15);
+    h ^= index * __PHYSFS_UI64(0xC2B2AE3D27D4EB4F);
+    h ^= h >> 29;
+    return ((PHYSFS_uint32) h) & (BLOCKCACHE_BUCKETS - 1);
+} /* hashBlock */
+
+
+/* MAKE SURE you hold (cacheLock) when calling this! */
+static void unlinkBlock(CachedBlock *block)
+{
+    if (block->prev)
+        block->prev->next = block->next;
+    else
+        mostRecent = block->next;
+
+    if (block->next)
+        block->next->prev = block->prev;
+    else
+        leastRecent = block->prev;
+
+    block->prev = block->next = NULL;
+} /* unlinkBlock */
+
+
+/* MAKE SURE you hold (cacheLock) when calling this! */
+static void linkBlock(CachedBlock *block)
+{
+    block->prev = NULL;
+    block->next = mostRecent;
+    if (mostRecent)
+        mostRecent->prev = block;
+    else
+        leastRecent = block;
+    mostRecent = block;
+} /* linkBlock */
+
+
+/* MAKE SURE you hold (cacheLock) when calling this! */
+static void dropBlock(CachedBlock *block)
+{
+    CachedBlock **p = &buckets[hashBlock(block->archive, block->entry,
+                                         block->index)];
+    while (*p != block)
+        p = &(*p)->hashnext;
+    *p = block->hashnext;
+
+    unlinkBlock(block);
+    cacheStats.bytes -= block->len;
+    cacheStats.blocks--;
+    block->io->destroy(block->io);
+    allocator.Free(block);
+} /* dropBlock */
+
+
+/* MAKE SURE you hold (cacheLock) when calling this! */
+static void trimCache(const PHYSFS_uint64 budget)
+{
+    while ((leastRecent != NULL) && (cacheStats.bytes > budget))
+    {
+        cacheStats.evictions++;
+        dropBlock(leastRecent);
+    } /* while */
+} /* trimCache */
+
+
+int __PHYSFS_blockCacheInit(void)
+{
+    cacheLock = __PHYSFS_platformCreateMutex();
+    BAIL_IF_ERRPASS(!cacheLock, 0);
+    memset(buckets, '\0', sizeof (buckets));
+    memset(&cacheStats, '\0', sizeof (cacheStats));
+    mostRecent = leastRecent = NULL;
+    return 1;
+} /* __PHYSFS_blockCacheInit */
+
+
+void __PHYSFS_blockCacheDeinit(void)
+{
+    if (cacheLock == NULL)
+        return;
+
+    __PHYSFS_platformGrabMutex(cacheLock);
+    trimCache(0);  /* archivers should have purged everything already. */
+    __PHYSFS_platformReleaseMutex(cacheLock);
+
+    __PHYSFS_platformDestroyMutex(cacheLock);
+    cacheLock = NULL;
+    cacheBudget = PHYSFS_BLOCK_CACHE_BUDGET;
+} /* __PHYSFS_blockCacheDeinit */
+
+
+PHYSFS_Io *__PHYSFS_blockCacheGet(const void *archive, const void *entry,
+                                  const PHYSFS_uint64 index)
+{
+    PHYSFS_Io *retval = NULL;
+    CachedBlock *block;
+
+    if (cacheLock == NULL)
+        return NULL;
+
+    __PHYSFS_platformGrabMutex(cacheLock);
+    block = buckets[hashBlock(archive, entry, index)];
+    while (block != NULL)
+    {
+        if ( (block->archive == archive) && (block->entry == entry) &&
+             (block->index == index) )
+            break;
+        block = block->hashnext;
+    } /* while */
+
+    if (block == NULL)
+        cacheStats.misses++;
+    else
+    {
+        retval = block->io->duplicate(block->io);
+        if (retval != NULL)  /* failure just looks like a miss. */
+        {
+            cacheStats.hits++;
+            unlinkBlock(block);
+            linkBlock(block);
+        } /* if */
+    } /* else */
+    __PHYSFS_platformReleaseMutex(cacheLock);
+
+    return retval;
+} /* __PHYSFS_blockCacheGet */
+
+
+void __PHYSFS_blockCachePut(const void *archive, const void *entry,
+                            const PHYSFS_uint64 index, PHYSFS_Io *io)
+{
+    const PHYSFS_sint64 len = io->length(io);
+    PHYSFS_uint32 hash;
+    CachedBlock *block;
+
+    if ((cacheLock == NULL) || (len < 0))
+        return;
+    else if ((PHYSFS_uint64) len > cacheBudget)
+        return;  /* would only push everything else out. */
+
+    hash = hashBlock(archive, entry, index);
+    __PHYSFS_platformGrabMutex(cacheLock);
+
+    /* two handles can miss on the same block at once; first one wins. */
+    for (block = buckets[hash]; block != NULL; block = block->hashnext)
+    {
+        if ( (block->archive == archive) && (block->entry == entry) &&
+             (block->index == index) )
+        {
+            __PHYSFS_platformReleaseMutex(cacheLock);
+            return;
+        } /* if */
+    } /* for */
+
+    block = (CachedBlock *) allocator.Malloc(sizeof (CachedBlock));
+    if (block != NULL)
+    {
+        block->io = io->duplicate(io);
+        if (block->io == NULL)
+            allocator.Free(block);
+        else
+        {
+            block->archive = archive;
+            block->entry = entry;
+            block->index = index;
+            block->len = (PHYSFS_uint64) len;
+            block->hashnext = buckets[hash];
+            buckets[hash] = block;
+            linkBlock(block);
+            cacheStats.bytes += block->len;
+            cacheStats.blocks++;
+            trimCache(cacheBudget);
+        } /* else */
+    } /* if */
+
+    __PHYSFS_platformReleaseMutex(cacheLock);
+} /* __PHYSFS_blockCachePut */
+
+
+void __PHYSFS_blockCachePurge(const void *archive)
+{
+    CachedBlock *block;
+    CachedBlock *next;
+
+    if (cacheLock == NULL)
+        return;
+
+    __PHYSFS_platformGrabMutex(cacheLock);
+    for (block = mostRecent; block != NULL; block = next)
+    {
+        next = block->next;
+        if (block->archive == archive)
+            dropBlock(block);
+    } /* for */
+    __PHYSFS_platformReleaseMutex(cacheLock);
+} /* __PHYSFS_blockCachePurge */
+
+
+void PHYSFS_setBlockCacheBudget(PHYSFS_uint64 budget)
+{
+    cacheBudget = budget;
+    if (cacheLock != NULL)
+    {
+        __PHYSFS_platformGrabMutex(cacheLock);
+        trimCache(budget);
+        __PHYSFS_platformReleaseMutex(cacheLock);
+    } /* if */
+} /* PHYSFS_setBlockCacheBudget */
+
+
+PHYSFS_uint64 PHYSFS_getBlockCacheBudget(void)
+{
+    return cacheBudget;
+} /* PHYSFS_getBlockCacheBudget */
+
+
+void PHYSFS_getBlockCacheStats(PHYSFS_BlockCacheStats *stats)
+{
+    if (stats == NULL)
+        return;
+    else if (cacheLock == NULL)
+        memset(stats, '\0', sizeof (*stats));
+    else
+    {
+        __PHYSFS_platformGrabMutex(cacheLock);
+        memcpy(stats, &cacheStats, sizeof (*stats));
+        __PHYSFS_platformReleaseMutex(cacheLock);
+    } /* else */
+} /* PHYSFS_getBlockCacheStats */
+
+/* end of physfs_blockcache.c ... */
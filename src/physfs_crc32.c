@@ -0,0 +1,286 @@
+/**
+ * PhysicsFS; a portable, flexible file i/o abstraction.
+ *
+ * Documentation is in physfs.h. It's verbose, honest.  :)
+ *
+ * Please see the file LICENSE.txt in the source's root directory.
+ *
+ *  This file written by Ryan C. Gordon.
+ */
+
+/*
+ * CRC-32, the one .zip files use, for PHYSFS_setVerifyChecksums(). It has
+ *  to be cheap enough to leave on, so in order of preference: libdeflate's
+ *  if we're linked to it, carry-less multiply folding on x86-64 CPUs that
+ *  have PCLMULQDQ, the ARMv8 CRC instructions if the compiler targets them,
+ *  zlib's if we're linked to that, and slicing-by-8 tables for the rest
+ *  (and for whatever's left over from the folding).
+ *
+ * This is its own translation unit for the same reason physfs_inflate.c
+ *  is: miniz's zlib-alike names can't share one with the real zlib.h.
+ */
+
+#if PHYSFS_HAVE_LIBDEFLATE
+/* it does all of this itself. */
+#elif defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define PHYSFS_CRC32_PCLMUL 1
+#include <cpuid.h>
+#include <immintrin.h>
+#define PCLMUL_TARGET __attribute__((target("pclmul,sse2")))
+#elif defined(_MSC_VER) && defined(_M_X64)
+#define PHYSFS_CRC32_PCLMUL 1
+#include <intrin.h>
+#define PCLMUL_TARGET
+#elif defined(__ARM_FEATURE_CRC32)
+#define PHYSFS_CRC32_ARM 1
+#include <arm_acle.h>
+#endif
+
+/* after the intrinsics headers, which want the malloc() we #define away. */
+#define __PHYSICSFS_INTERNAL__
+#include "physfs_internal.h"
+
+#if PHYSFS_HAVE_LIBDEFLATE
+#include <libdeflate.h>
+#elif PHYSFS_HAVE_ZLIB
+#include <zlib.h>
+#endif
+
+#if PHYSFS_CRC32_PCLMUL
+#define PHYSFS_CRC32_TABLES 1  /* for what doesn't fold. */
+#elif !PHYSFS_HAVE_LIBDEFLATE && !PHYSFS_CRC32_ARM && !PHYSFS_HAVE_ZLIB
+#define PHYSFS_CRC32_TABLES 1
+#endif
+
+#if PHYSFS_CRC32_TABLES
+static PHYSFS_uint32 crcTable[8][256];
+#endif
+
+#if PHYSFS_CRC32_PCLMUL
+static int havePclmul = 0;
+#endif
+
+
+void __PHYSFS_crc32Init(void)
+{
+#if PHYSFS_CRC32_TABLES
+    PHYSFS_uint32 i;
+    int j;
+
+    for (i = 0; i < 256; i++)
+    {
+        PHYSFS_uint32 crc = i;
+        for (j = 0; j < 8; j++)
+            crc = (crc & 1) ? ((crc >> 1) ^ 0xEDB88320) : (crc >> 1);
+        crcTable[0][i] = crc;
+    } /* for */
+
+    /* (crcTable[j][i]) is (i) followed by (j) zero bytes. */
+    for (i = 0; i < 256; i++)
+    {
+        for (j = 1; j < 8; j++)
+        {
+            const PHYSFS_uint32 prev = crcTable[j - 1][i];
+            crcTable[j][i] = (prev >> 8) ^ crcTable[0][prev & 0xFF];
+        } /* for */
+    } /* for */
+
+    #if PHYSFS_CRC32_PCLMUL
+    {
+        #ifdef _MSC_VER
+        int info[4];
+        __cpuid(info, 1);
+        havePclmul = ((info[2] & (1 << 1)) != 0);
+        #else
+        unsigned int a, b, c, d;
+        havePclmul = (__get_cpuid(1, &a, &b, &c, &d) && (c & bit_PCLMUL));
+        #endif
+    }
+    #endif
+#endif
+} /* __PHYSFS_crc32Init */
+
+
+#if PHYSFS_CRC32_TABLES
+/* (crc) is the raw register here, not the finished sum. */
+static PHYSFS_uint32 crc32Tables(PHYSFS_uint32 crc, const PHYSFS_uint8 *buf,
+                                 size_t len)
+{
+    /* This builds the words from bytes, so it doesn't care about byte
+       order; compilers turn it into plain loads where they can. */
+    while (len >= 8)
+    {
+        const PHYSFS_uint32 one = crc ^ ( ((PHYSFS_uint32) buf[0]) |
+                                          (((PHYSFS_uint32) buf[1]) << 8) |
+                                          (((PHYSFS_uint32) buf[2]) << 16) |
+                                          (((PHYSFS_uint32) buf[3]) << 24) );
+        crc = crcTable[7][one & 0xFF] ^
+              crcTable[6][(one >> 8) & 0xFF] ^
+              crcTable[5][(one >> 16) & 0xFF] ^
+              crcTable[4][one >> 24] ^
+              crcTable[3][buf[4]] ^
+              crcTable[2][buf[5]] ^
+              crcTable[1][buf[6]] ^
+              crcTable[0][buf[7]];
+        buf += 8;
+        len -= 8;
+    } /* while */
+
+    while (len--)
+        crc = (crc >> 8) ^ crcTable[0][(crc ^ *(buf++)) & 0xFF];
+
+    return crc;
+} /* crc32Tables */
+#endif
+
+
+#if PHYSFS_CRC32_PCLMUL
+/*
+ * Fold 64 bytes at a time with carry-less multiplies, then fold that down
+ *  to 128 bits, then 64, then Barrett-reduce to 32. This is the algorithm
+ *  from Intel's "Fast CRC Computation for Generic Polynomials Using
+ *  PCLMULQDQ Instruction" paper, with its constants for the reflected
+ *  CRC-32 polynomial. (len) must be at least 64, and a multiple of 16.
+ */
+PCLMUL_TARGET
+static PHYSFS_uint32 crc32Pclmul(PHYSFS_uint32 crc, const PHYSFS_uint8 *buf,
+                                 size_t len)
+{
+    const __m128i k1k2 = _mm_set_epi64x(0x01c6e41596, 0x0154442bd4);
+    const __m128i k3k4 = _mm_set_epi64x(0x00ccaa009e, 0x01751997d0);
+    const __m128i k5k0 = _mm_set_epi64x(0x0000000000, 0x0163cd6124);
+    const __m128i poly = _mm_set_epi64x(0x01f7011641, 0x01db710641);
+    const __m128i mask32 = _mm_setr_epi32(~0, 0, ~0, 0);
+    __m128i x1, x2, x3, x4, x5, x6, x7, x8;
+
+    x1 = _mm_loadu_si128((const __m128i *) (buf + 0x00));
+    x2 = _mm_loadu_si128((const __m128i *) (buf + 0x10));
+    x3 = _mm_loadu_si128((const __m128i *) (buf + 0x20));
+    x4 = _mm_loadu_si128((const __m128i *) (buf + 0x30));
+    x1 = _mm_xor_si128(x1, _mm_cvtsi32_si128((int) crc));
+    buf += 64;
+    len -= 64;
+
+    while (len >= 64)  /* four lanes in parallel. */
+    {
+        x5 = _mm_clmulepi64_si128(x1, k1k2, 0x00);
+        x6 = _mm_clmulepi64_si128(x2, k1k2, 0x00);
+        x7 = _mm_clmulepi64_si128(x3, k1k2, 0x00);
+        x8 = _mm_clmulepi64_si128(x4, k1k2, 0x00);
+        x1 = _mm_clmulepi64_si128(x1, k1k2, 0x11);
+        x2 = _mm_clmulepi64_si128(x2, k1k2, 0x11);
+        x3 = _mm_clmulepi64_si128(x3, k1k2, 0x11);
+        x4 = _mm_clmulepi64_si128(x4, k1k2, 0x11);
+        x1 = _mm_xor_si128(_mm_xor_si128(x1, x5),
+                           _mm_loadu_si128((const __m128i *) (buf + 0x00)));
+        x2 = _mm_xor_si128(_mm_xor_si128(x2, x6),
+                           _mm_loadu_si128((const __m128i *) (buf + 0x10)));
+        x3 = _mm_xor_si128(_mm_xor_si128(x3, x7),
+                           _mm_loadu_si128((const __m128i *) (buf + 0x20)));
+        x4 = _mm_xor_si128(_mm_xor_si128(x4, x8),
+                           _mm_loadu_si128((const __m128i *) (buf + 0x30)));
+        buf += 64;
+        len -= 64;
+    } /* while */
+
+    /* fold the four lanes into one... */
+    x5 = _mm_clmulepi64_si128(x1, k3k4, 0x00);
+    x1 = _mm_clmulepi64_si128(x1, k3k4, 0x11);
+    x1 = _mm_xor_si128(_mm_xor_si128(x1, x2), x5);
+    x5 = _mm_clmulepi64_si128(x1, k3k4, 0x00);
+    x1 = _mm_clmulepi64_si128(x1, k3k4, 0x11);
+    x1 = _mm_xor_si128(_mm_xor_si128(x1, x3), x5);
+    x5 = _mm_clmulepi64_si128(x1, k3k4, 0x00);
+    x1 = _mm_clmulepi64_si128(x1, k3k4, 0x11);
+    x1 = _mm_xor_si128(_mm_xor_si128(x1, x4), x5);
+
+    while (len >= 16)  /* ...and any whole 16 bytes left into that. */
+    {
+        x5 = _mm_clmulepi64_si128(x1, k3k4, 0x00);
+        x1 = _mm_clmulepi64_si128(x1, k3k4, 0x11);
+        x1 = _mm_xor_si128(_mm_xor_si128(x1, x5),
+                           _mm_loadu_si128((const __m128i *) buf));
+        buf += 16;
+        len -= 16;
+    } /* while */
+
+    /* 128 bits to 64... */
+    x2 = _mm_clmulepi64_si128(x1, k3k4, 0x10);
+    x1 = _mm_xor_si128(_mm_srli_si128(x1, 8), x2);
+    x2 = _mm_srli_si128(x1, 4);
+    x1 = _mm_and_si128(x1, mask32);
+    x1 = _mm_clmulepi64_si128(x1, k5k0, 0x00);
+    x1 = _mm_xor_si128(x1, x2);
+
+    /* ...and Barrett reduction to 32. */
+    x2 = _mm_and_si128(x1, mask32);
+    x2 = _mm_clmulepi64_si128(x2, poly, 0x10);
+    x2 = _mm_and_si128(x2, mask32);
+    x2 = _mm_clmulepi64_si128(x2, poly, 0x00);
+    x1 = _mm_xor_si128(x1, x2);
+
+    return (PHYSFS_uint32) _mm_cvtsi128_si32(_mm_srli_si128(x1, 4));
+} /* crc32Pclmul */
+#endif
+
+
+#if PHYSFS_CRC32_ARM
+static PHYSFS_uint32 crc32Arm(PHYSFS_uint32 crc, const PHYSFS_uint8 *buf,
+                              size_t len)
+{
+    while ((len > 0) && (((size_t) buf) & 7))
+    {
+        crc = __crc32b(crc, *(buf++));
+        len--;
+    } /* while */
+
+    while (len >= 8)
+    {
+        PHYSFS_uint64 word;
+        memcpy(&word, buf, sizeof (word));  /* aligned now, so just a load. */
+        crc = __crc32d(crc, word);
+        buf += 8;
+        len -= 8;
+    } /* while */
+
+    while (len--)
+        crc = __crc32b(crc, *(buf++));
+
+    return crc;
+} /* crc32Arm */
+#endif
+
+
+PHYSFS_uint32 __PHYSFS_crc32(PHYSFS_uint32 crc, const void *_buf, size_t len)
+{
+    const PHYSFS_uint8 *buf = (const PHYSFS_uint8 *) _buf;
+
+#if PHYSFS_HAVE_LIBDEFLATE
+    return (PHYSFS_uint32) libdeflate_crc32(crc, buf, len);
+#elif PHYSFS_CRC32_PCLMUL
+    crc = ~crc;
+    if ((havePclmul) && (len >= 64))
+    {
+        const size_t folded = len & ~((size_t) 15);
+        crc = crc32Pclmul(crc, buf, folded);
+        buf += folded;
+        len -= folded;
+    } /* if */
+    return ~crc32Tables(crc, buf, len);
+#elif PHYSFS_CRC32_ARM
+    return ~crc32Arm(~crc, buf, len);
+#elif PHYSFS_HAVE_ZLIB
+    while (len > 0)  /* zlib takes a uInt length, so feed it in chunks. */
+    {
+        const uInt chunk = (uInt) ((len > 0x40000000) ? 0x40000000 : len);
+        crc = (PHYSFS_uint32) crc32(crc, buf, chunk);
+        buf += chunk;
+        len -= chunk;
+    } /* while */
+    return crc;
+#else
+    return ~crc32Tables(~crc, buf, len);
+#endif
+} /* __PHYSFS_crc32 */
+
+/* end of physfs_crc32.c ... */
@@ -0,0 +1,90 @@
+/**
+ * PhysicsFS; a portable, flexible file i/o abstraction.
+ *
+ * Documentation is in physfs.h. It's verbose, honest.  :)
+ *
+ * Please see the file LICENSE.txt in the source's root directory.
+ *
+ *  This file written by Ryan C. Gordon.
+ */
+
+/*
+ * One-shot inflate through an external library, for reading whole deflated
+ *  .zip entries in a single call. The zip archiver uses the bundled miniz for
+ *  everything else, and miniz's zlib-alike names can't share a translation
+ *  unit with the real zlib.h, so this lives on its own.
+ */
+
+#define __PHYSICSFS_INTERNAL__
+#include "physfs_internal.h"
+
+#if PHYSFS_HAVE_FAST_INFLATE
+
+#if PHYSFS_HAVE_LIBDEFLATE
+#include <libdeflate.h>
+
+int __PHYSFS_inflateWhole(const void *src, const size_t srclen,
+                          void *dst, const size_t dstlen)
+{
+    /* libdeflate allocates with malloc(); setting that is process-wide. */
+    struct libdeflate_decompressor *d = libdeflate_alloc_decompressor();
+    enum libdeflate_result rc;
+    size_t actual = 0;
+
+    BAIL_IF(!d, PHYSFS_ERR_OUT_OF_MEMORY, 0);
+    rc = libdeflate_deflate_decompress(d, src, srclen, dst, dstlen, &actual);
+    libdeflate_free_decompressor(d);
+    BAIL_IF(rc != LIBDEFLATE_SUCCESS, PHYSFS_ERR_CORRUPT, 0);
+    BAIL_IF(actual != dstlen, PHYSFS_ERR_CORRUPT, 0);
+    return 1;
+} /* __PHYSFS_inflateWhole */
+
+#elif PHYSFS_HAVE_ZLIB
+#include <zlib.h>
+
+static voidpf zlibPhysfsAlloc(voidpf opaque, uInt items, uInt size)
+{
+    return ((PHYSFS_Allocator *) opaque)->Malloc(items * size);
+} /* zlibPhysfsAlloc */
+
+static void zlibPhysfsFree(voidpf opaque, voidpf address)
+{
+    ((PHYSFS_Allocator *) opaque)->Free(address);
+} /* zlibPhysfsFree */
+
+
+int __PHYSFS_inflateWhole(const void *src, const size_t srclen,
+                          void *dst, const size_t dstlen)
+{
+    z_stream str;
+    int rc;
+
+    /* zlib counts in uInt; anything bigger goes through the usual path. */
+    BAIL_IF((srclen != (uInt) srclen) || (dstlen != (uInt) dstlen),
+            PHYSFS_ERR_UNSUPPORTED, 0);
+
+    memset(&str, '\0', sizeof (str));
+    str.zalloc = zlibPhysfsAlloc;
+    str.zfree = zlibPhysfsFree;
+    str.opaque = &allocator;
+    BAIL_IF(inflateInit2(&str, -MAX_WBITS) != Z_OK,
+            PHYSFS_ERR_OUT_OF_MEMORY, 0);
+
+    str.next_in = (Bytef *) src;
+    str.avail_in = (uInt) srclen;
+    str.next_out = (Bytef *) dst;
+    str.avail_out = (uInt) dstlen;
+    rc = inflate(&str, Z_FINISH);
+    inflateEnd(&str);
+
+    BAIL_IF(rc == Z_MEM_ERROR, PHYSFS_ERR_OUT_OF_MEMORY, 0);
+    BAIL_IF(rc != Z_STREAM_END, PHYSFS_ERR_CORRUPT, 0);
+    BAIL_IF(str.total_out != dstlen, PHYSFS_ERR_CORRUPT, 0);
+    return 1;
+} /* __PHYSFS_inflateWhole */
+
+#endif
+
+#endif  /* PHYSFS_HAVE_FAST_INFLATE */
+
+/* end of physfs_inflate.c ... */
@@ -107,21 +107,45 @@ const void *__PHYSFS_winrtCalcBaseDir(void);
 const void *__PHYSFS_winrtCalcPrefDir(void);
 #endif
 
-/* atomic operations. */
+/* atomic operations. These all return the new value. */
 #if defined(_MSC_VER) && (_MSC_VER >= 1500)
 #include <intrin.h>
 __PHYSFS_COMPILE_TIME_ASSERT(LongEqualsInt, sizeof (int) == sizeof (long));
 #define __PHYSFS_ATOMIC_INCR(ptrval) _InterlockedIncrement((long*)(ptrval))
 #define __PHYSFS_ATOMIC_DECR(ptrval) _InterlockedDecrement((long*)(ptrval))
 #elif defined(__clang__) || (defined(__GNUC__) && (((__GNUC__ * 10000) + (__GNUC_MINOR__ * 100)) >= 40100))
-#define __PHYSFS_ATOMIC_INCR(ptrval) __sync_fetch_and_add(ptrval, 1)
-#define __PHYSFS_ATOMIC_DECR(ptrval) __sync_fetch_and_add(ptrval, -1)
+#define __PHYSFS_ATOMIC_INCR(ptrval) __sync_add_and_fetch(ptrval, 1)
+#define __PHYSFS_ATOMIC_DECR(ptrval) __sync_add_and_fetch(ptrval, -1)
 #else
 #define PHYSFS_NEED_ATOMIC_OP_FALLBACK 1
 int __PHYSFS_ATOMIC_INCR(int *ptrval);
 int __PHYSFS_ATOMIC_DECR(int *ptrval);
 #endif
 
+/*
+ * Storage that each thread gets its own copy of. Left undefined where the
+ *  compiler can't do it (or you define PHYSFS_NO_THREAD_LOCAL), and then
+ *  whatever uses it has to find the current thread's data the slow way.
+ */
+#if defined(PHYSFS_NO_THREAD_LOCAL)
+/* nothing. */
+#elif defined(_MSC_VER)
+#define __PHYSFS_THREAD_LOCAL __declspec(thread)
+#elif defined(__clang__) || (defined(__GNUC__) && (((__GNUC__ * 10000) + (__GNUC_MINOR__ * 100)) >= 30300))
+#define __PHYSFS_THREAD_LOCAL __thread
+#endif
+
+/* add to a PHYSFS_uint64 counter. Only close enough where we can't do it. */
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_ARM64))
+#define __PHYSFS_ATOMIC_ADD64(ptrval, val) \
+    _InterlockedExchangeAdd64((__int64 *) (ptrval), (__int64) (val))
+#elif defined(__clang__) || (defined(__GNUC__) && (((__GNUC__ * 10000) + (__GNUC_MINOR__ * 100)) >= 40100))
+#define __PHYSFS_ATOMIC_ADD64(ptrval, val) \
+    __sync_add_and_fetch(ptrval, (PHYSFS_uint64) (val))
+#else
+#define __PHYSFS_ATOMIC_ADD64(ptrval, val) (*(ptrval) += (val))
+#endif
+
 
 /*
  * Interface for small allocations. If you need a little scratch space for
@@ -155,6 +179,34 @@ void *__PHYSFS_initSmallAlloc(void *ptr, const size_t len);
 
 void __PHYSFS_smallFree(void *ptr);
 
+/*
+ * Freelists for the small objects that come and go with every open and
+ *  close, so once things are warmed up that doesn't touch the allocator.
+ *  Define one per type with __PHYSFS_POOL(name, type). PoolAlloc is
+ *  allocator.Malloc(sizeof (type)), setting the error state the same way,
+ *  and poolFree is allocator.Free(), with a cache of at most
+ *  PHYSFS_POOL_MAX objects in between. Pooled objects are ordinary
+ *  allocations, so mixing the two up is harmless, just slower.
+ *  PHYSFS_deinit() gives everything cached back to the allocator.
+ */
+typedef struct __PHYSFS_Pool
+{
+    size_t objsize;
+    void *freelist;  /* each object's first bytes point at the next. */
+    size_t count;
+    int registered;  /* in the list PHYSFS_deinit() empties? */
+    struct __PHYSFS_Pool *next;
+} __PHYSFS_Pool;
+
+#define __PHYSFS_POOL(name, type) \
+    __PHYSFS_Pool name = { sizeof (type), NULL, 0, 0, NULL }
+
+void *__PHYSFS_poolAlloc(__PHYSFS_Pool *pool);
+void __PHYSFS_poolFree(__PHYSFS_Pool *pool, void *ptr);
+
+/* Every PHYSFS_Io we make ourselves comes from this one. */
+extern __PHYSFS_Pool __PHYSFS_ioPool;
+
 
 /* Use the allocation hooks. */
 #define malloc(x) Do not use malloc() directly.
@@ -192,6 +244,9 @@ void __PHYSFS_smallFree(void *ptr);
 #ifndef PHYSFS_SUPPORTS_VDF
 #define PHYSFS_SUPPORTS_VDF 1
 #endif
+#ifndef PHYSFS_SUPPORTS_STATS
+#define PHYSFS_SUPPORTS_STATS 1
+#endif
 
 #if PHYSFS_SUPPORTS_7Z
 /* 7zip support needs a global init function called at startup (no deinit). */
@@ -199,7 +254,7 @@ extern void SZIP_global_init(void);
 #endif
 
 /* The latest supported PHYSFS_Io::version value. */
-#define CURRENT_PHYSFS_IO_API_VERSION 0
+#define CURRENT_PHYSFS_IO_API_VERSION 1
 
 /* The latest supported PHYSFS_Archiver::version value. */
 #define CURRENT_PHYSFS_ARCHIVER_API_VERSION 0
@@ -265,6 +320,14 @@ void __PHYSFS_sort(void *entries, size_t max,
 #define GOTO_MUTEX_ERRPASS(m, g) do { __PHYSFS_platformReleaseMutex(m); goto g; } while (0)
 #define GOTO_IF_MUTEX(c, e, m, g) do { if (c) { if (e) PHYSFS_setErrorCode(e); __PHYSFS_platformReleaseMutex(m); goto g; } } while (0)
 #define GOTO_IF_MUTEX_ERRPASS(c, m, g) do { if (c) { __PHYSFS_platformReleaseMutex(m); goto g; } } while (0)
+#define BAIL_RWLOCK(e, l, r) do { if (e) PHYSFS_setErrorCode(e); __PHYSFS_platformReleaseRWLock(l); return r; } while (0)
+#define BAIL_RWLOCK_ERRPASS(l, r) do { __PHYSFS_platformReleaseRWLock(l); return r; } while (0)
+#define BAIL_IF_RWLOCK(c, e, l, r) do { if (c) { if (e) PHYSFS_setErrorCode(e); __PHYSFS_platformReleaseRWLock(l); return r; } } while (0)
+#define BAIL_IF_RWLOCK_ERRPASS(c, l, r) do { if (c) { __PHYSFS_platformReleaseRWLock(l); return r; } } while (0)
+#define GOTO_RWLOCK(e, l, g) do { if (e) PHYSFS_setErrorCode(e); __PHYSFS_platformReleaseRWLock(l); goto g; } while (0)
+#define GOTO_RWLOCK_ERRPASS(l, g) do { __PHYSFS_platformReleaseRWLock(l); goto g; } while (0)
+#define GOTO_IF_RWLOCK(c, e, l, g) do { if (c) { if (e) PHYSFS_setErrorCode(e); __PHYSFS_platformReleaseRWLock(l); goto g; } } while (0)
+#define GOTO_IF_RWLOCK_ERRPASS(c, l, g) do { if (c) { __PHYSFS_platformReleaseRWLock(l); goto g; } } while (0)
 
 #define __PHYSFS_ARRAYLEN(x) ( (sizeof (x)) / (sizeof (x[0])) )
 
@@ -301,7 +364,18 @@ void __PHYSFS_sort(void *entries, size_t max,
 char *__PHYSFS_strdup(const char *str);
 
 /*
- * Give a hash value for a C string (uses djb's xor hashing algorithm).
+ * Case-fold a UTF-8 string the same way PHYSFS_utf8stricmp() does, so two
+ *  strings that compare equal there fold to the same bytes. (dst) must have
+ *  room for __PHYSFS_CASEFOLD_BUFLEN(strlen(src)) bytes. Returns the length
+ *  of the folded string, not counting the null terminator it writes.
+ */
+#define __PHYSFS_CASEFOLD_BUFLEN(len) (((len) * 5) + 1)
+size_t __PHYSFS_utf8CaseFold(const char *src, char *dst);
+
+/*
+ * Give a hash value for (len) bytes of a string. This eats 8 bytes at a time
+ *  with an xxHash64-style mix, so it's only stable on one build; never store
+ *  it anywhere that another build might read it back.
  */
 PHYSFS_uint32 __PHYSFS_hashString(const char *str, size_t len);
 
@@ -314,6 +388,167 @@ extern PHYSFS_Allocator __PHYSFS_AllocatorHooks;
 /* convenience macro to make this less cumbersome internally... */
 #define allocator __PHYSFS_AllocatorHooks
 
+/*
+ * Start and stop the machinery behind PHYSFS_readAsync(). Init just makes a
+ *  lock, threads start on first use; deinit finishes everything running,
+ *  cancels everything else, and frees all requests. Deinit must happen
+ *  before any file handles are closed.
+ */
+int __PHYSFS_asyncInit(void);
+void __PHYSFS_asyncDeinit(void);
+
+/*
+ * Read (len) bytes at (offset) from (io), which must be able to readAt(), on
+ *  one of the async worker threads. This is for prefetching, so it returns
+ *  NULL without setting an error if there are no threads to do it. Whatever
+ *  is returned has to go to __PHYSFS_asyncFinishIo() before (io) or
+ *  (buffer) go away, and before __PHYSFS_asyncDeinit().
+ */
+PHYSFS_AsyncRequest *__PHYSFS_asyncReadIo(PHYSFS_Io *io,
+                                          const PHYSFS_uint64 offset,
+                                          void *buffer,
+                                          const PHYSFS_uint64 len);
+
+/*
+ * Wait for a request from __PHYSFS_asyncReadIo() and free it. If (cancel) and
+ *  it hasn't started yet, it's dropped instead. Returns bytes read, or -1 if
+ *  it failed or was dropped. Doesn't set the error state either way.
+ */
+PHYSFS_sint64 __PHYSFS_asyncFinishIo(PHYSFS_AsyncRequest *req,
+                                     const int cancel);
+
+/*
+ * Write-behind for write handles; see PHYSFS_setWriteBehind(). Init just
+ *  makes a lock, the flusher thread starts on first use. Deinit waits for
+ *  closed handles, so it has to happen after all open ones are stopped.
+ */
+typedef struct __PHYSFS_WriteBehind __PHYSFS_WriteBehind;
+int __PHYSFS_writeBehindInit(void);
+void __PHYSFS_writeBehindDeinit(void);
+
+/*
+ * Put write-behind on (io), with buffers of the current
+ *  PHYSFS_getWriteBehind() size. Returns NULL without setting an error if
+ *  it's off, or there's no thread or memory for it; buffer normally then.
+ *  Write, tell, seek and length stand in for the Io's own; barrier waits
+ *  until everything written so far is in (io), and returns zero if any
+ *  write failed, which sticks.
+ */
+__PHYSFS_WriteBehind *__PHYSFS_writeBehindCreate(PHYSFS_Io *io);
+PHYSFS_sint64 __PHYSFS_writeBehindWrite(__PHYSFS_WriteBehind *wb,
+                                        const void *buffer, size_t len);
+PHYSFS_sint64 __PHYSFS_writeBehindTell(__PHYSFS_WriteBehind *wb);
+int __PHYSFS_writeBehindSeek(__PHYSFS_WriteBehind *wb, PHYSFS_uint64 pos);
+PHYSFS_sint64 __PHYSFS_writeBehindLength(__PHYSFS_WriteBehind *wb);
+int __PHYSFS_writeBehindBarrier(__PHYSFS_WriteBehind *wb);
+
+/*
+ * Stop frees (wb) after a barrier, leaving (io) to the caller; returns the
+ *  barrier's result. Close gives (wb) and its Io to the flusher instead,
+ *  which writes what's left, flushes and destroys the Io, then calls
+ *  (commit) with whether all that worked, from its own thread. A failure
+ *  there, or a zero from (commit), is kept for PHYSFS_waitWriteBehind().
+ *  WaitAll just waits until every closed handle is done.
+ */
+typedef int (*__PHYSFS_WriteBehindCommit)(void *data, const int ok);
+int __PHYSFS_writeBehindStop(__PHYSFS_WriteBehind *wb);
+void __PHYSFS_writeBehindClose(__PHYSFS_WriteBehind *wb,
+                               __PHYSFS_WriteBehindCommit commit, void *data);
+void __PHYSFS_writeBehindWaitAll(void);
+
+/*
+ * The shared cache of decompressed blocks, behind PHYSFS_setBlockCacheBudget().
+ *  Blocks are memory Ios, keyed by (archive, entry, index); the keys only
+ *  have to be unique while the archive is open, and (entry) can be NULL if
+ *  the archiver's blocks don't belong to one file. Archivers must call
+ *  __PHYSFS_blockCachePurge() when they close.
+ *
+ * Get returns a new reference to a cached block, which the caller has to
+ *  destroy, or NULL on a miss. Put adds a reference of its own to (io) if
+ *  the budget allows and the block isn't cached yet; the caller keeps (io)
+ *  either way. Neither sets an error on a miss or when the cache is full.
+ */
+int __PHYSFS_blockCacheInit(void);
+void __PHYSFS_blockCacheDeinit(void);
+PHYSFS_Io *__PHYSFS_blockCacheGet(const void *archive, const void *entry,
+                                  const PHYSFS_uint64 index);
+void __PHYSFS_blockCachePut(const void *archive, const void *entry,
+                            const PHYSFS_uint64 index, PHYSFS_Io *io);
+void __PHYSFS_blockCachePurge(const void *archive);
+
+/*
+ * Files loaded whole by PHYSFS_preload(), as memory Ios keyed by the
+ *  sanitized path the search path found them at. (archive) is the DirHandle
+ *  that served each one.
+ *
+ * Get returns a new reference to a preloaded file's Io, which the caller has
+ *  to destroy, or NULL without setting an error. Has says whether (path) is
+ *  preloaded, pinning it if (pin). Put takes ownership of (buf), which must
+ *  come from allocator.Malloc(), even if it fails. Forget drops (path) and
+ *  everything under it ("" for everything); pass non-zero (changed) if
+ *  what the path opens changed, so it counts as an invalidation. ForgetIf
+ *  drops everything that (stale) says is stale. Call all of these with the
+ *  stateLock held, shared or not.
+ */
+int __PHYSFS_preloadInit(void);
+void __PHYSFS_preloadDeinit(void);
+PHYSFS_Io *__PHYSFS_preloadGet(const char *path, const void **archive);
+int __PHYSFS_preloadHas(const char *path, const int pin);
+int __PHYSFS_preloadPut(const char *path, const void *archive, void *buf,
+                        const PHYSFS_uint64 len, const int pin);
+void __PHYSFS_preloadForget(const char *path, const int changed);
+void __PHYSFS_preloadForgetIf(int (*stale)(void *data, const char *path,
+                                           const void *archive),
+                              void *data);
+
+/*
+ * The counters behind PHYSFS_getStats(), and the PHYSFS_setTraceCallback()
+ *  hook. Count things with these macros, which compile to nothing if
+ *  PHYSFS_SUPPORTS_STATS is off. __PHYSFS_STAT_NOW() is a timestamp in
+ *  nanoseconds, for handing to __PHYSFS_STAT_LOCK_WAITED() after a grab that
+ *  had to wait. __PHYSFS_TRACE_START() is the same, but only bothers with
+ *  the clock if there's a trace callback; pass it to __PHYSFS_trace() once
+ *  the traced call is done, which fills in the timing fields of (event) and
+ *  passes it along. Only build an event if __PHYSFS_TRACING() says someone's
+ *  listening.
+ */
+#if PHYSFS_SUPPORTS_STATS
+extern PHYSFS_Stats __PHYSFS_stats;
+extern PHYSFS_TraceCallback __PHYSFS_traceCallback;
+#define __PHYSFS_STAT_ADD(field, n) \
+    ((void) __PHYSFS_ATOMIC_ADD64(&__PHYSFS_stats.field, (n)))
+#define __PHYSFS_STAT_INCR(field) __PHYSFS_STAT_ADD(field, 1)
+#define __PHYSFS_STAT_NOW() __PHYSFS_platformNanoseconds()
+#define __PHYSFS_STAT_LOCK_WAITED(start) { \
+    __PHYSFS_STAT_INCR(lockWaits); \
+    __PHYSFS_STAT_ADD(lockWaitNanoseconds, \
+                      __PHYSFS_platformNanoseconds() - (start)); \
+}
+#define __PHYSFS_TRACING() (__PHYSFS_traceCallback != NULL)
+#define __PHYSFS_TRACE_START() \
+    (__PHYSFS_TRACING() ? __PHYSFS_platformNanoseconds() : 0)
+void __PHYSFS_trace(PHYSFS_TraceEvent *event, const PHYSFS_uint64 start);
+#else
+#define __PHYSFS_STAT_ADD(field, n) ((void) (n))
+#define __PHYSFS_STAT_INCR(field) ((void) 0)
+#define __PHYSFS_STAT_NOW() 0
+#define __PHYSFS_STAT_LOCK_WAITED(start) ((void) (start))
+#define __PHYSFS_TRACING() (0)
+#define __PHYSFS_TRACE_START() 0
+#define __PHYSFS_trace(event, start) ((void) (start))
+#endif
+
+/*
+ * Report which archive an open read handle came from and roughly where its
+ *  data lives in it, so requests can be put in a sensible order. (*archive)
+ *  is only good for comparing against other results from this.
+ */
+void __PHYSFS_fileArchiveOffset(PHYSFS_File *handle, const void **archive,
+                                PHYSFS_uint64 *offset);
+
+/* Non-zero if (handle) came from PHYSFS_openRead(), zero if it writes. */
+int __PHYSFS_fileForReading(const PHYSFS_File *handle);
+
 /*
  * Create a PHYSFS_Io for a file in the physical filesystem.
  *  This path is in platform-dependent notation. (mode) must be 'r', 'w', or
@@ -329,6 +564,120 @@ PHYSFS_Io *__PHYSFS_createNativeIo(const char *path, const int mode);
 PHYSFS_Io *__PHYSFS_createMemoryIo(const void *buf, PHYSFS_uint64 len,
                                    void (*destruct)(void *));
 
+/*
+ * Create a read-only PHYSFS_Io for a file in the physical filesystem by
+ *  mapping the whole thing into memory. This path is in platform-dependent
+ *  notation. Returns NULL if the file can't be mapped; use
+ *  __PHYSFS_createNativeIo() instead in that case.
+ */
+PHYSFS_Io *__PHYSFS_createMappedNativeIo(const char *path);
+
+/*
+ * If (io) is backed by memory (a mapped file or a memory buffer), return a
+ *  pointer to the (len) bytes starting at offset (pos), without touching its
+ *  file position. Returns NULL if (io) can't do this or the range is out of
+ *  bounds; the caller should read normally then. The pointer is valid for as
+ *  long as (io) or any of its duplicates are alive.
+ */
+const void *__PHYSFS_ioMappedRange(PHYSFS_Io *io, const PHYSFS_uint64 pos,
+                                   const PHYSFS_uint64 len);
+
+/*
+ * Like __PHYSFS_ioMappedRange(), but hand back a new read-only PHYSFS_Io
+ *  covering just that range, which keeps the memory alive on its own. This
+ *  is how archivers serve uncompressed entries without any copying. Returns
+ *  NULL if (io) isn't backed by memory; read it the normal way then.
+ */
+PHYSFS_Io *__PHYSFS_ioMappedSubrange(PHYSFS_Io *io, const PHYSFS_uint64 pos,
+                                     const PHYSFS_uint64 len);
+
+/*
+ * Non-zero if (io) has a readAt() method, so several threads can read
+ *  from it at once without a seek position to fight over.
+ */
+int __PHYSFS_ioCanReadAt(const PHYSFS_Io *io);
+
+/*
+ * Get another, independent read-only PHYSFS_Io for (io)'s data. If (io) can
+ *  readAt(), this is a cheap view with its own position that shares (io)
+ *  and its file handle, and (io) has to outlive it; archivers use this for
+ *  their open files, which can't outlive the archive anyhow. Otherwise this
+ *  is just (io)->duplicate(). Either way, destroy it when done.
+ */
+PHYSFS_Io *__PHYSFS_ioShare(PHYSFS_Io *io);
+
+#if PHYSFS_SUPPORTS_ZIP
+/*
+ * Write or read the seek checkpoints of the .zip entry that (io) reads.
+ *  These fail with PHYSFS_ERR_UNSUPPORTED if (io) isn't a deflated entry.
+ *  See PHYSFS_saveSeekCheckpoints() for the details.
+ */
+int __PHYSFS_zipSaveCheckpoints(PHYSFS_Io *io, PHYSFS_File *out);
+int __PHYSFS_zipLoadCheckpoints(PHYSFS_Io *io, PHYSFS_File *in);
+
+/*
+ * For PHYSFS_readFilesBatch(). If (io) reads a .zip entry, set (*offset) to
+ *  where its data starts in the archive and return non-zero; return zero
+ *  without setting an error otherwise.
+ */
+int __PHYSFS_zipEntryOffset(PHYSFS_Io *io, PHYSFS_uint64 *offset);
+
+/*
+ * If (io) reads a compressed .zip entry, read the rest of its compressed
+ *  data into memory right now, so later reads from (io) are pure
+ *  decompression and never touch the archive. Returns 1 if that happened,
+ *  0 on error, -1 (without setting an error) if (io) isn't such an entry.
+ */
+int __PHYSFS_zipPreload(PHYSFS_Io *io);
+
+/*
+ * Built with an external inflate library (see PHYSFS_ZIP_INFLATE in
+ *  CMakeLists.txt)? Then the zip archiver decodes whole entries with this:
+ *  raw deflate data in (src) must decode to exactly (dstlen) bytes. Returns
+ *  non-zero on success, zero with the error state set otherwise.
+ */
+#if defined(PHYSFS_HAVE_LIBDEFLATE) || defined(PHYSFS_HAVE_ZLIB)
+#define PHYSFS_HAVE_FAST_INFLATE 1
+int __PHYSFS_inflateWhole(const void *src, const size_t srclen,
+                          void *dst, const size_t dstlen);
+#endif
+
+/*
+ * CRC-32 the way .zip files store it, in physfs_crc32.c: start (crc) at 0,
+ *  or pass what the last call returned to continue over more data. This
+ *  uses the CPU's carry-less multiply or CRC instructions if it can;
+ *  __PHYSFS_crc32Init() picks how, and PHYSFS_init() calls it.
+ */
+void __PHYSFS_crc32Init(void);
+PHYSFS_uint32 __PHYSFS_crc32(PHYSFS_uint32 crc, const void *buf, size_t len);
+
+/*
+ * Decoders for the other .zip compression methods, in physfs_zipcodec.c.
+ *  LZMA is always there; Zstandard needs libzstd (see PHYSFS_ZIP_ZSTD in
+ *  CMakeLists.txt). A codec streams one entry of (size) uncompressed bytes:
+ *  Decode() eats what it can of (*srclen) bytes at (*src), advancing both,
+ *  and returns the bytes it wrote to (dst), which is less than (dstlen) only
+ *  if it needs more input or the stream ended; -1 with the error state set
+ *  on corrupt data. Reset() rewinds it to the start of the entry.
+ *  DecodeWhole() is for when all of an entry's data is in memory at once.
+ */
+#define ZIP_COMPMETH_LZMA 14
+#define ZIP_COMPMETH_ZSTD 93
+typedef struct __PHYSFS_ZipCodec __PHYSFS_ZipCodec;
+int __PHYSFS_zipCodecSupported(const PHYSFS_uint16 method);
+__PHYSFS_ZipCodec *__PHYSFS_zipCodecCreate(const PHYSFS_uint16 method,
+                                           const PHYSFS_uint64 size);
+int __PHYSFS_zipCodecReset(__PHYSFS_ZipCodec *codec);
+PHYSFS_sint64 __PHYSFS_zipCodecDecode(__PHYSFS_ZipCodec *codec,
+                                      const PHYSFS_uint8 **src,
+                                      size_t *srclen, PHYSFS_uint8 *dst,
+                                      const size_t dstlen);
+void __PHYSFS_zipCodecDestroy(__PHYSFS_ZipCodec *codec);
+int __PHYSFS_zipCodecDecodeWhole(const PHYSFS_uint16 method,
+                                 const void *src, const size_t srclen,
+                                 void *dst, const size_t dstlen);
+#endif
+
 
 /*
  * Read (len) bytes from (io) into (buf). Returns non-zero on success,
@@ -337,11 +686,51 @@ PHYSFS_Io *__PHYSFS_createMemoryIo(const void *buf, PHYSFS_uint64 len,
 int __PHYSFS_readAll(PHYSFS_Io *io, void *buf, const size_t len);
 
 
+/*
+ * PHYSFS_enumerateWithStat() uses this for the native dir archiver, since
+ *  the platform's directory listing can provide stats cheaply. (opaque)
+ *  came from __PHYSFS_Archiver_DIR's openArchive().
+ */
+PHYSFS_EnumerateCallbackResult __PHYSFS_DIR_enumerateWithStat(void *opaque,
+                              const char *dname,
+                              PHYSFS_EnumerateStatCallback cb,
+                              const char *origdir, void *callbackdata);
+
+/*
+ * Non-zero if (opaque), from __PHYSFS_Archiver_DIR's openArchive(), answers
+ *  everything from a snapshot taken at mount time (see
+ *  PHYSFS_snapshotDirectories()), so it can't change and can be indexed.
+ */
+int __PHYSFS_DIR_isSnapshot(void *opaque);
+
+/*
+ * Bring (opaque)'s snapshot, if it has one, up to date with whatever is on
+ *  disk at (path) now; "" means all of it. PHYSFS_pollWatch() uses this for
+ *  each change the platform reports. Returns 1 if only (path) itself was
+ *  touched, -1 if directories came or went, or anything else might have
+ *  moved around (so an index built from this archive needs rebuilding), or
+ *  0 on error, in which case the snapshot is dropped and everything is
+ *  asked from the disk from then on.
+ */
+int __PHYSFS_DIR_refreshPath(void *opaque, char *path);
+
+/*
+ * Rename (from) to (to) in (opaque)'s directory, replacing (to); the
+ *  write directory uses this to put PHYSFS_openWriteAtomic() files in
+ *  place. Both are archive-relative, in platform-independent notation.
+ */
+int __PHYSFS_DIR_rename(void *opaque, const char *from, const char *to);
+
+
 /* These are shared between some archivers. */
 
 void UNPK_abandonArchive(void *opaque);
 void UNPK_closeArchive(void *opaque);
-void *UNPK_openArchive(PHYSFS_Io *io);
+void *UNPK_openArchive(PHYSFS_Io *io, const PHYSFS_uint64 count);
+int UNPK_loadIndexCache(void *opaque, const char *name, const char *tag,
+                        const void *key, const size_t keylen);
+void UNPK_storeIndexCache(void *opaque, const char *name, const char *tag,
+                          const void *key, const size_t keylen);
 void *UNPK_addEntry(void *opaque, char *name, const int isdir,
                     const PHYSFS_sint64 ctime, const PHYSFS_sint64 mtime,
                     const PHYSFS_uint64 pos, const PHYSFS_uint64 len);
@@ -365,6 +754,8 @@ typedef struct __PHYSFS_DirTreeEntry
     struct __PHYSFS_DirTreeEntry *children;  /* linked list of kids, if dir. */
     struct __PHYSFS_DirTreeEntry *sibling;   /* next item in same dir.       */
     int isdir;
+    PHYSFS_uint32 hash;     /* __PHYSFS_hashString() of name. 0 for root.   */
+    PHYSFS_uint32 namelen;  /* strlen(name). 0 for root.                    */
 } __PHYSFS_DirTreeEntry;
 
 typedef struct __PHYSFS_DirTree
@@ -372,18 +763,63 @@ typedef struct __PHYSFS_DirTree
     __PHYSFS_DirTreeEntry *root;    /* root of directory tree.             */
     __PHYSFS_DirTreeEntry **hash;  /* all entries hashed for fast lookup. */
     size_t hashBuckets;            /* number of buckets in hash.          */
+    size_t entryCount;             /* entries in hash, not counting root. */
     size_t entrylen;    /* size in bytes of entries (including subclass). */
+    int ignorecase;     /* non-zero to hash and compare names case-folded. */
+    void *arena;    /* blocks that entries and their names are carved from. */
+    void *image;    /* non-NULL if loaded from the index cache.           */
+    size_t imagelen;  /* entries inside (image) aren't freed one by one.  */
 } __PHYSFS_DirTree;
 
 
-int __PHYSFS_DirTreeInit(__PHYSFS_DirTree *dt, const size_t entrylen);
+/*
+ * (count) is how many entries the archive expects to add, or zero if it
+ *  can't know up front. It just sizes the hash; the hash grows as needed.
+ *  The tree ignores case if PHYSFS_ignoreCase() was enabled when this was
+ *  called; entries keep the case they were added with either way.
+ */
+int __PHYSFS_DirTreeInit(__PHYSFS_DirTree *dt, const size_t entrylen,
+                         const PHYSFS_uint64 count);
 void *__PHYSFS_DirTreeAdd(__PHYSFS_DirTree *dt, char *name, const int isdir);
 void *__PHYSFS_DirTreeFind(__PHYSFS_DirTree *dt, const char *path);
+
+/*
+ * Non-zero if (entry), which __PHYSFS_DirTreeAdd() returned for (name), was
+ *  already there under a name that only differs in case. The first of
+ *  those wins, so archivers should leave (entry) alone and skip this one.
+ */
+int __PHYSFS_DirTreeOtherCase(const __PHYSFS_DirTree *dt, const void *entry,
+                              const char *name);
 PHYSFS_EnumerateCallbackResult __PHYSFS_DirTreeEnumerate(void *opaque,
                               const char *dname, PHYSFS_EnumerateCallback cb,
                               const char *origdir, void *callbackdata);
 void __PHYSFS_DirTreeDeinit(__PHYSFS_DirTree *dt);
 
+/*
+ * The on-disk index cache (see PHYSFS_setIndexCacheDir()). An archiver that
+ *  keeps its whole directory in a __PHYSFS_DirTree can try loading it from
+ *  the cache right after __PHYSFS_DirTreeInit(), and store it after it
+ *  builds the tree the slow way. (name) is the path the archive was opened
+ *  from; only archives that are real files on disk get cached. (tag) names
+ *  the archiver, and (key) is whatever else must match for the cache to be
+ *  trusted, like where the archive's own directory lives. (extra) is a small
+ *  blob of archiver state that is stored and restored along with the tree.
+ *
+ * The cache holds a raw image of the entries, so entries must not contain
+ *  pointers other than the ones in __PHYSFS_DirTreeEntry itself; store the
+ *  tree before anything has a chance to change that. Load returns non-zero
+ *  if (dt) now holds the cached tree; failing to use the cache isn't an
+ *  error, so just move on without it.
+ */
+int __PHYSFS_DirTreeLoadCache(__PHYSFS_DirTree *dt, const char *name,
+                              const char *tag, const void *key,
+                              const size_t keylen, void *extra,
+                              const size_t extralen);
+void __PHYSFS_DirTreeStoreCache(const __PHYSFS_DirTree *dt, const char *name,
+                                const char *tag, const void *key,
+                                const size_t keylen, const void *extra,
+                                const size_t extralen);
+
 
 
 /*--------------------------------------------------------------------------*/
@@ -492,6 +928,50 @@ void *__PHYSFS_platformOpenAppend(const char *filename);
  */
 PHYSFS_sint64 __PHYSFS_platformRead(void *opaque, void *buf, PHYSFS_uint64 len);
 
+/*
+ * Read up to (len) bytes, starting at byte offset (pos), from a
+ *  platform-specific file handle into (buf), like __PHYSFS_platformRead()
+ *  does from the file pointer. This must be safe to call from several
+ *  threads at once on the same handle. It may leave the file pointer
+ *  anywhere; callers don't mix it with __PHYSFS_platformRead(). Return the
+ *  number of bytes read, 0 at or past the end of the file, or (-1) and call
+ *  PHYSFS_setErrorCode() on total failure.
+ */
+PHYSFS_sint64 __PHYSFS_platformReadAt(void *opaque, PHYSFS_uint64 pos,
+                                      void *buf, PHYSFS_uint64 len);
+
+/* One read in a batch for __PHYSFS_platformReadAtBatch(). */
+typedef struct __PHYSFS_PlatformRead
+{
+    void *opaque;  /* from __PHYSFS_platformOpenRead(). */
+    PHYSFS_uint64 pos;
+    void *buffer;
+    PHYSFS_uint64 len;
+    PHYSFS_sint64 result;  /* bytes read, or (-1) and (error) says why. */
+    PHYSFS_ErrorCode error;
+} __PHYSFS_PlatformRead;
+
+/*
+ * Do (count) reads like __PHYSFS_platformReadAt(), with as many of them in
+ *  flight at once as the platform can manage, so the drive sees a deep queue
+ *  instead of one request at a time. Unlike __PHYSFS_platformReadAt(), each
+ *  read keeps going until it has all (len) bytes or hits the end of the file,
+ *  so a short (result) means EOF. Several reads can share a handle, and they
+ *  can finish in any order. Each read reports its own failure in (error);
+ *  this might change the thread's error code, too. Platforms without a way
+ *  to do this can just call __PHYSFS_finishReadsAt().
+ */
+void __PHYSFS_platformReadAtBatch(__PHYSFS_PlatformRead *reads,
+                                  PHYSFS_uint32 count);
+
+/*
+ * Finish each of (count) batched reads with __PHYSFS_platformReadAt(), one
+ *  at a time, starting (result) bytes in; set (result) to 0 first to do the
+ *  whole read. This is the fallback for __PHYSFS_platformReadAtBatch().
+ */
+void __PHYSFS_finishReadsAt(__PHYSFS_PlatformRead *reads,
+                            PHYSFS_uint32 count);
+
 /*
  * Write more data to a platform-specific file handle. (opaque) should be
  *  cast to whatever data type your platform uses. Write a maximum of (len)
@@ -575,6 +1055,25 @@ int __PHYSFS_platformFlush(void *opaque);
  */
 void __PHYSFS_platformClose(void *opaque);
 
+/*
+ * Map the entire contents of a file into memory, read-only. (opaque) is a
+ *  handle from __PHYSFS_platformOpenRead(). On success, fill in (ptr) with
+ *  the start of the mapping and (len) with its size, and return an opaque
+ *  handle to pass to __PHYSFS_platformUnmapFile() later. The mapping must
+ *  remain valid after (opaque) is closed.
+ *
+ * This is an optimization; platforms that can't (or files that can't, like
+ *  empty files or ones too big for the address space) should set an error
+ *  code and return NULL, and the caller will use normal reads instead.
+ */
+void *__PHYSFS_platformMapFile(void *opaque, const void **ptr,
+                               PHYSFS_uint64 *len);
+
+/*
+ * Release a mapping from __PHYSFS_platformMapFile(). This should never fail.
+ */
+void __PHYSFS_platformUnmapFile(void *mapping);
+
 /*
  * Platform implementation of PHYSFS_getCdRomDirsCallback()...
  *  CD directories are discovered and reported to the callback one at a time.
@@ -626,6 +1125,14 @@ char *__PHYSFS_platformCalcPrefDir(const char *org, const char *app);
 void *__PHYSFS_platformGetThreadID(void);
 
 
+/*
+ * Return a timestamp in nanoseconds, from a clock that only goes forward
+ *  while the program runs, for timing things. Where it starts counting is
+ *  arbitrary, and the actual resolution can be a lot coarser than this.
+ */
+PHYSFS_uint64 __PHYSFS_platformNanoseconds(void);
+
+
 /*
  * Enumerate a directory of files. This follows the rules for the
  *  PHYSFS_Archiver::enumerate() method, except that the (dirName) that is
@@ -638,6 +1145,18 @@ PHYSFS_EnumerateCallbackResult __PHYSFS_platformEnumerate(const char *dirname,
                                PHYSFS_EnumerateCallback callback,
                                const char *origdir, void *callbackdata);
 
+/*
+ * Like __PHYSFS_platformEnumerate(), but (callback) also gets what
+ *  __PHYSFS_platformStat(path, stat, 0) would report for each item. Use
+ *  whatever the directory listing already provides to get it, so this is
+ *  cheaper than stat'ing each item by name. Items that vanish before they
+ *  can be stat'ed should be skipped, not reported as errors.
+ */
+PHYSFS_EnumerateCallbackResult __PHYSFS_platformEnumerateWithStat(
+                               const char *dirname,
+                               PHYSFS_EnumerateStatCallback callback,
+                               const char *origdir, void *callbackdata);
+
 /*
  * Make a directory in the actual filesystem. (path) is specified in
  *  platform-dependent notation. On error, return zero and set the error
@@ -660,6 +1179,17 @@ int __PHYSFS_platformMkDir(const char *path);
 int __PHYSFS_platformDelete(const char *path);
 
 
+/*
+ * Rename file (src) to (dst), replacing (dst) if it exists. Both are in
+ *  platform-dependent notation, on the same filesystem. This should be as
+ *  close to atomic as the platform allows: anyone opening (dst) sees the
+ *  old file or the new one, not a mix or nothing.
+ *
+ * On error, return zero and set the error message. Return non-zero on success.
+ */
+int __PHYSFS_platformRename(const char *src, const char *dst);
+
+
 /*
  * Create a platform-specific mutex. This can be whatever datatype your
  *  platform uses for mutexes, but it is cast to a (void *) for abstractness.
@@ -706,6 +1236,134 @@ int __PHYSFS_platformGrabMutex(void *mutex);
  */
 void __PHYSFS_platformReleaseMutex(void *mutex);
 
+/*
+ * Create a platform-specific reader/writer lock. Any number of threads may
+ *  hold it shared at the same time, but a thread holding it exclusively
+ *  holds it alone. This is cast to a (void *) for abstractness, like mutexes.
+ *
+ * Like mutexes, these must be recursive: a thread that holds the lock in
+ *  either mode can grab it shared again, and a thread that holds it
+ *  exclusively can grab it exclusively again, without deadlocking. For this
+ *  to work, grabbing it shared should only block while another thread
+ *  actually holds it exclusively, not while one is just waiting to.
+ *  Upgrading from shared to exclusive is not supported; it will deadlock.
+ *
+ * Return (NULL) if you couldn't create one. Systems without threads can
+ *  return any arbitrary non-NULL value. Platforms that can't do better may
+ *  use a recursive mutex here, grabbing it for both modes.
+ */
+void *__PHYSFS_platformCreateRWLock(void);
+
+/*
+ * Destroy a platform-specific reader/writer lock, and clean up any resources
+ *  associated with it. (rwlock) is a value previously returned by
+ *  __PHYSFS_platformCreateRWLock(). This can be a no-op on single-threaded
+ *  platforms.
+ */
+void __PHYSFS_platformDestroyRWLock(void *rwlock);
+
+/*
+ * Grab shared possession of a reader/writer lock. This blocks while another
+ *  thread holds it exclusively.
+ *
+ * Return non-zero if the lock was grabbed, zero if there was an
+ *  unrecoverable problem grabbing it. The same rules as
+ *  __PHYSFS_platformGrabMutex() apply: don't time out, and _DO NOT_ call
+ *  PHYSFS_setErrorCode() in here.
+ */
+int __PHYSFS_platformGrabRWLockShared(void *rwlock);
+
+/*
+ * Grab exclusive possession of a reader/writer lock. This blocks until
+ *  no other thread holds it, shared or exclusive.
+ *
+ * Return non-zero if the lock was grabbed, zero if there was an
+ *  unrecoverable problem grabbing it. The same rules as
+ *  __PHYSFS_platformGrabMutex() apply: don't time out, and _DO NOT_ call
+ *  PHYSFS_setErrorCode() in here.
+ */
+int __PHYSFS_platformGrabRWLockExclusive(void *rwlock);
+
+/*
+ * Release one grab of a reader/writer lock, shared or exclusive; this
+ *  should be called once for each successful grab. Once the last shared
+ *  holder releases, or the exclusive holder releases as many times as it
+ *  grabbed, threads waiting on the lock may proceed.
+ *
+ * _DO NOT_ call PHYSFS_setErrorCode() in here!
+ */
+void __PHYSFS_platformReleaseRWLock(void *rwlock);
+
+/*
+ * Start a new thread running (fn)(arg), to spread CPU-bound work (like
+ *  decompressing files) across cores. Returns an opaque handle to pass to
+ *  __PHYSFS_platformJoinThread(), or NULL if a thread couldn't be started.
+ *  Callers must cope with NULL by doing the work themselves, so platforms
+ *  without threads can just always return NULL.
+ *
+ * _DO NOT_ call PHYSFS_setErrorCode() in here!
+ */
+void *__PHYSFS_platformCreateThread(void (*fn)(void *), void *arg);
+
+/*
+ * Wait for a thread started by __PHYSFS_platformCreateThread() to return,
+ *  and clean up any resources associated with it.
+ */
+void __PHYSFS_platformJoinThread(void *thread);
+
+/*
+ * Create a platform-specific counting semaphore, starting at zero, for
+ *  threads started by __PHYSFS_platformCreateThread() to sleep on. Return
+ *  (NULL) if you couldn't create one; platforms that can't start threads
+ *  should just always return NULL.
+ */
+void *__PHYSFS_platformCreateSemaphore(void);
+
+/*
+ * Destroy a semaphore from __PHYSFS_platformCreateSemaphore(). Nothing may
+ *  be waiting on it.
+ */
+void __PHYSFS_platformDestroySemaphore(void *sem);
+
+/*
+ * Block until the semaphore's count is non-zero, then decrement it. Don't
+ *  time out, and _DO NOT_ call PHYSFS_setErrorCode() in here!
+ */
+void __PHYSFS_platformWaitSemaphore(void *sem);
+
+/*
+ * Increment the semaphore's count, waking one waiting thread if there is
+ *  one. _DO NOT_ call PHYSFS_setErrorCode() in here!
+ */
+void __PHYSFS_platformPostSemaphore(void *sem);
+
+/*
+ * Start noticing changes to anything in the native directory (dir), and in
+ *  every directory under it, for PHYSFS_watch(). Returns an opaque handle to
+ *  pass to __PHYSFS_platformPollWatch(), or NULL on error. Platforms that
+ *  can't do this should fail with PHYSFS_ERR_UNSUPPORTED.
+ */
+void *__PHYSFS_platformWatchDir(const char *dir);
+
+/*
+ * Call (cb) with the path of everything that was created, deleted, changed
+ *  or renamed under (watch) since the last call, without waiting for more.
+ *  Paths are UTF-8, relative to the watched directory, and use '/' as a dir
+ *  separator. "" means too much happened to keep track of (the platform's
+ *  queue overflowed, or the watched dir itself moved), and everything in it
+ *  should be assumed to have changed. Reporting a path more than once, or
+ *  reporting paths that didn't really change, is harmless.
+ *  Returns the number of times (cb) was called, or -1 on error.
+ */
+int __PHYSFS_platformPollWatch(void *watch, PHYSFS_StringCallback cb,
+                               void *data);
+
+/*
+ * Stop watching, and free (watch), from __PHYSFS_platformWatchDir().
+ *  Changes that haven't been polled yet are thrown away.
+ */
+void __PHYSFS_platformUnwatchDir(void *watch);
+
 #if PHYSFS_HAVE_PRAGMA_VISIBILITY
 #pragma GCC visibility pop
 #endif
@@ -6,6 +6,11 @@ This code is all public domain, and mostly (if not entirely) written by
 Igor Pavlov. http://www.7-zip.org/sdk.html
 --ryan. */
 
+/* Define PHYSFS_LZMASDK_LZMADEC_ONLY before including this to get just the
+   types and the LZMA decoder (LzmaDec_*), without the 7z container code.
+   The .zip LZMA codec uses that, so it doesn't build a second copy of
+   everything the 7z archiver needs. */
+
 
 
 /* 7zTypes.h -- Basic types
@@ -187,11 +192,13 @@ typedef struct
   SRes (*Seek)(void *p, Int64 *pos, ESzSeek origin);
 } ILookInStream;
 
+#ifndef PHYSFS_LZMASDK_LZMADEC_ONLY
 static SRes LookInStream_SeekTo(ILookInStream *stream, UInt64 offset);
 
 /* reads via ILookInStream::Read */
 static SRes LookInStream_Read2(ILookInStream *stream, void *buf, size_t size, SRes errorType);
 static SRes LookInStream_Read(ILookInStream *stream, void *buf, size_t size);
+#endif
 
 #define LookToRead_BUF_SIZE (1 << 14)
 
@@ -204,8 +211,10 @@ typedef struct
   Byte buf[LookToRead_BUF_SIZE];
 } CLookToRead;
 
+#ifndef PHYSFS_LZMASDK_LZMADEC_ONLY
 static void LookToRead_CreateVTable(CLookToRead *p, int lookahead);
 static void LookToRead_Init(CLookToRead *p);
+#endif
 
 typedef struct
 {
@@ -255,6 +264,8 @@ EXTERN_C_END
 
 #endif
 
+#ifndef PHYSFS_LZMASDK_LZMADEC_ONLY  /* see the top of this file. */
+
 /* 7z.h -- 7z interface
 2015-11-18 : Igor Pavlov : Public domain */
 
@@ -405,39 +416,6 @@ UInt16 *SzArEx_GetFullNameUtf16_Back(const CSzArEx *p, size_t fileIndex, UInt16
 
 
 
-/*
-  SzArEx_Extract extracts file from archive
-
-  *outBuffer must be 0 before first call for each new archive.
-
-  Extracting cache:
-    If you need to decompress more than one file, you can send
-    these values from previous call:
-      *blockIndex,
-      *outBuffer,
-      *outBufferSize
-    You can consider "*outBuffer" as cache of solid block. If your archive is solid,
-    it will increase decompression speed.
-  
-    If you use external function, you can declare these 3 cache variables
-    (blockIndex, outBuffer, outBufferSize) as static in that external function.
-    
-    Free *outBuffer and set *outBuffer to 0, if you want to flush cache.
-*/
-
-static SRes SzArEx_Extract(
-    const CSzArEx *db,
-    ILookInStream *inStream,
-    UInt32 fileIndex,         /* index of file */
-    UInt32 *blockIndex,       /* index of solid block */
-    Byte **outBuffer,         /* pointer to pointer to output buffer (allocated with allocMain) */
-    size_t *outBufferSize,    /* buffer size for output buffer */
-    size_t *offset,           /* offset of stream for required file in *outBuffer */
-    size_t *outSizeProcessed, /* size of file in *outBuffer */
-    ISzAlloc *allocMain,
-    ISzAlloc *allocTemp);
-
-
 /*
 SzArEx_Open Errors:
 SZ_ERROR_NO_ARCHIVE
@@ -479,6 +457,8 @@ EXTERN_C_END
 
 #endif
 
+#endif  /* !PHYSFS_LZMASDK_LZMADEC_ONLY */
+
 /* CpuArch.h -- CPU specific code
 2016-06-09: Igor Pavlov : Public domain */
 
@@ -685,16 +665,20 @@ enum
   CPU_FIRM_VIA
 };
 
+#ifndef PHYSFS_LZMASDK_LZMADEC_ONLY
 static void MyCPUID(UInt32 function, UInt32 *a, UInt32 *b, UInt32 *c, UInt32 *d);
 
 static Bool x86cpuid_CheckAndRead(Cx86cpuid *p);
 static int x86cpuid_GetFirm(const Cx86cpuid *p);
+#endif
 
 #define x86cpuid_GetFamily(ver) (((ver >> 16) & 0xFF0) | ((ver >> 8) & 0xF))
 #define x86cpuid_GetModel(ver)  (((ver >> 12) &  0xF0) | ((ver >> 4) & 0xF))
 #define x86cpuid_GetStepping(ver) (ver & 0xF)
 
+#ifndef PHYSFS_LZMASDK_LZMADEC_ONLY
 static Bool CPU_Is_InOrder();
+#endif
 
 #endif
 
@@ -702,6 +686,8 @@ EXTERN_C_END
 
 #endif
 
+#ifndef PHYSFS_LZMASDK_LZMADEC_ONLY  /* see the top of this file. */
+
 /* 7zBuf.h -- Byte Buffer
 2013-01-18 : Igor Pavlov : Public domain */
 
@@ -905,6 +891,8 @@ EXTERN_C_END
 
 #endif
 
+#endif  /* !PHYSFS_LZMASDK_LZMADEC_ONLY */
+
 /* LzmaDec.h -- LZMA Decoder
 2013-01-18 : Igor Pavlov : Public domain */
 
@@ -1087,6 +1075,8 @@ EXTERN_C_END
 
 #endif
 
+#ifndef PHYSFS_LZMASDK_LZMADEC_ONLY  /* see the top of this file. */
+
 /* Lzma2Dec.h -- LZMA2 Decoder
 2015-05-13 : Igor Pavlov : Public domain */
 
@@ -3341,83 +3331,6 @@ static SRes SzArEx_Open(CSzArEx *p, ILookInStream *inStream,
 }
 
 
-static SRes SzArEx_Extract(
-    const CSzArEx *p,
-    ILookInStream *inStream,
-    UInt32 fileIndex,
-    UInt32 *blockIndex,
-    Byte **tempBuf,
-    size_t *outBufferSize,
-    size_t *offset,
-    size_t *outSizeProcessed,
-    ISzAlloc *allocMain,
-    ISzAlloc *allocTemp)
-{
-  UInt32 folderIndex = p->FileToFolder[fileIndex];
-  SRes res = SZ_OK;
-  
-  *offset = 0;
-  *outSizeProcessed = 0;
-  
-  if (folderIndex == (UInt32)-1)
-  {
-    IAlloc_Free(allocMain, *tempBuf);
-    *blockIndex = folderIndex;
-    *tempBuf = NULL;
-    *outBufferSize = 0;
-    return SZ_OK;
-  }
-
-  if (*tempBuf == NULL || *blockIndex != folderIndex)
-  {
-    UInt64 unpackSizeSpec = SzAr_GetFolderUnpackSize(&p->db, folderIndex);
-    /*
-    UInt64 unpackSizeSpec =
-        p->UnpackPositions[p->FolderToFile[folderIndex + 1]] -
-        p->UnpackPositions[p->FolderToFile[folderIndex]];
-    */
-    size_t unpackSize = (size_t)unpackSizeSpec;
-
-    if (unpackSize != unpackSizeSpec)
-      return SZ_ERROR_MEM;
-    *blockIndex = folderIndex;
-    IAlloc_Free(allocMain, *tempBuf);
-    *tempBuf = NULL;
-    
-    if (res == SZ_OK)
-    {
-      *outBufferSize = unpackSize;
-      if (unpackSize != 0)
-      {
-        *tempBuf = (Byte *)IAlloc_Alloc(allocMain, unpackSize);
-        if (*tempBuf == NULL)
-          res = SZ_ERROR_MEM;
-      }
-  
-      if (res == SZ_OK)
-      {
-        res = SzAr_DecodeFolder(&p->db, folderIndex,
-            inStream, p->dataPos, *tempBuf, unpackSize, allocTemp);
-      }
-    }
-  }
-
-  if (res == SZ_OK)
-  {
-    UInt64 unpackPos = p->UnpackPositions[fileIndex];
-    *offset = (size_t)(unpackPos - p->UnpackPositions[p->FolderToFile[folderIndex]]);
-    *outSizeProcessed = (size_t)(p->UnpackPositions[fileIndex + 1] - unpackPos);
-    if (*offset + *outSizeProcessed > *outBufferSize)
-      return SZ_ERROR_FAIL;
-    if (SzBitWithVals_Check(&p->CRCs, fileIndex))
-      if (CrcCalc(*tempBuf + *offset, *outSizeProcessed) != p->CRCs.Vals[fileIndex])
-        res = SZ_ERROR_CRC;
-  }
-
-  return res;
-}
-
-
 static size_t SzArEx_GetFileNameUtf16(const CSzArEx *p, size_t fileIndex, UInt16 *dest)
 {
   size_t offs = p->FileNameOffsets[fileIndex];
@@ -4715,6 +4628,8 @@ static void Delta_Decode(Byte *state, unsigned delta, Byte *data, SizeT size)
   MyMemCpy(state + delta - j, buf, j);
 }
 
+#endif  /* !PHYSFS_LZMASDK_LZMADEC_ONLY */
+
 /* LzmaDec.c -- LZMA Decoder
 2016-05-16 : Igor Pavlov : Public domain */
 
@@ -5709,6 +5624,8 @@ static SRes LzmaDec_AllocateProbs(CLzmaDec *p, const Byte *props, unsigned props
   return SZ_OK;
 }
 
+#ifndef PHYSFS_LZMASDK_LZMADEC_ONLY  /* see the top of this file. */
+
 /* Lzma2Dec.c -- LZMA2 Decoder
 2015-11-09 : Igor Pavlov : Public domain */
 
@@ -6022,6 +5939,220 @@ static SRes Lzma2Dec_DecodeToDic(CLzma2Dec *p, SizeT dicLimit,
   return SZ_OK;
 }
 
+
+/* 7zFolderStream.c -- incremental decoding of a 7z folder.
+This isn't part of the LZMA SDK; it was added for PhysicsFS, so files in big
+solid blocks can be read a piece at a time instead of decoding the whole
+block into memory first. It only handles folders with a single Copy, LZMA or
+LZMA2 coder (what 7-Zip makes unless it applies a filter, like BCJ for
+executables). Everything else has to go through SzAr_DecodeFolder(). */
+
+static UInt32 MY_FAST_CALL CrcUpdate(UInt32 v, const void *data, size_t size)
+{
+  return g_CrcUpdate(v, data, size, g_CrcTable);
+}
+
+typedef struct
+{
+  UInt32 MethodID;
+  CLzma2Dec lzma2;    /* plain LZMA only uses lzma2.decoder */
+  Byte *dic;          /* circular dictionary, (dicBufSize) bytes */
+  SizeT dicBufSize;
+  UInt64 packStart;   /* absolute position of the packed stream */
+  UInt64 packSize;
+  UInt64 packRemain;
+  UInt64 unpackSize;
+  UInt64 unpackPos;   /* how much of the folder we've decoded so far */
+  Bool needSeek;
+} CSzFolderStream;
+
+static void SzFolderStream_Construct(CSzFolderStream *p)
+{
+  memset(p, 0, sizeof(*p));
+  Lzma2Dec_Construct(&p->lzma2);
+}
+
+static void SzFolderStream_Free(CSzFolderStream *p, ISzAlloc *alloc)
+{
+  LzmaDec_FreeProbs(&p->lzma2.decoder, alloc);
+  IAlloc_Free(alloc, p->dic);
+  p->dic = NULL;
+}
+
+/* start over from the beginning of the folder. */
+static void SzFolderStream_Rewind(CSzFolderStream *p)
+{
+  p->packRemain = p->packSize;
+  p->unpackPos = 0;
+  p->needSeek = True;
+  if (p->MethodID != k_Copy)
+  {
+    p->lzma2.decoder.dic = p->dic;
+    p->lzma2.decoder.dicBufSize = p->dicBufSize;
+    if (p->MethodID == k_LZMA2)
+      Lzma2Dec_Init(&p->lzma2);
+    else
+      LzmaDec_Init(&p->lzma2.decoder);
+  }
+}
+
+/*
+SzFolderStream_Open Errors:
+SZ_ERROR_UNSUPPORTED - folder needs more than one coder; use SzAr_DecodeFolder().
+SZ_ERROR_MEM
+SZ_ERROR_DATA
+SZ_ERROR_FAIL
+On error, you still have to call SzFolderStream_Free().
+*/
+static SRes SzFolderStream_Open(CSzFolderStream *p, const CSzArEx *db,
+    UInt32 folderIndex, ISzAlloc *alloc)
+{
+  const CSzAr *ar = &db->db;
+  const Byte *data = ar->CodersData + ar->FoCodersOffsets[folderIndex];
+  const UInt64 *packPositions = ar->PackPositions + ar->FoStartPackStreamIndex[folderIndex];
+  const CSzCoderInfo *coder;
+  CSzFolder folder;
+  CSzData sd;
+
+  sd.Data = data;
+  sd.Size = ar->FoCodersOffsets[folderIndex + 1] - ar->FoCodersOffsets[folderIndex];
+  RINOK(SzGetNextFolderItem(&folder, &sd));
+  if (sd.Size != 0 || folder.UnpackStream != ar->FoToMainUnpackSizeIndex[folderIndex])
+    return SZ_ERROR_FAIL;
+
+  if (folder.NumCoders != 1 || folder.NumPackStreams != 1
+      || folder.PackStreams[0] != 0 || folder.NumBonds != 0)
+    return SZ_ERROR_UNSUPPORTED;
+
+  coder = &folder.Coders[0];
+  if (coder->NumStreams != 1)
+    return SZ_ERROR_UNSUPPORTED;
+
+  p->MethodID = (UInt32)coder->MethodID;
+  p->packStart = db->dataPos + packPositions[0];
+  p->packSize = packPositions[1] - packPositions[0];
+  p->unpackSize = SzAr_GetFolderUnpackSize(ar, folderIndex);
+
+  if (p->MethodID == k_Copy)
+  {
+    if (p->packSize != p->unpackSize)
+      return SZ_ERROR_DATA;
+  }
+  else if (p->MethodID == k_LZMA)
+  {
+    RINOK(LzmaDec_AllocateProbs(&p->lzma2.decoder, data + coder->PropsOffset, coder->PropsSize, alloc));
+  }
+  #ifndef _7Z_NO_METHOD_LZMA2
+  else if (p->MethodID == k_LZMA2)
+  {
+    if (coder->PropsSize != 1)
+      return SZ_ERROR_DATA;
+    RINOK(Lzma2Dec_AllocateProbs(&p->lzma2, data[coder->PropsOffset], alloc));
+  }
+  #endif
+  else
+    return SZ_ERROR_UNSUPPORTED;
+
+  if (p->MethodID != k_Copy)
+  {
+    /* the dictionary never needs to be bigger than the folder itself. */
+    UInt64 dicSize = p->lzma2.decoder.prop.dicSize;
+    if (dicSize < LZMA_DIC_MIN)
+      dicSize = LZMA_DIC_MIN;
+    if (dicSize > p->unpackSize)
+      dicSize = p->unpackSize;
+    if (dicSize == 0)
+      dicSize = 1;
+    p->dicBufSize = (SizeT)dicSize;
+    if (p->dicBufSize != dicSize)
+      return SZ_ERROR_MEM;
+    p->dic = (Byte *)IAlloc_Alloc(alloc, p->dicBufSize);
+    if (!p->dic)
+      return SZ_ERROR_MEM;
+  }
+
+  SzFolderStream_Rewind(p);
+  return SZ_OK;
+}
+
+/* Decode the next (*size) bytes of the folder into (dest); stops early only at
+   the end of the folder. (inStream) must not be moved by anyone else between
+   calls. */
+static SRes SzFolderStream_Read(CSzFolderStream *p, ILookInStream *inStream,
+    Byte *dest, size_t *size)
+{
+  size_t outSize = *size;
+  *size = 0;
+
+  if (outSize > p->unpackSize - p->unpackPos)
+    outSize = (size_t)(p->unpackSize - p->unpackPos);
+
+  if (p->needSeek)
+  {
+    RINOK(LookInStream_SeekTo(inStream, p->packStart + (p->packSize - p->packRemain)));
+    p->needSeek = False;
+  }
+
+  while (outSize > 0)
+  {
+    const void *inBuf = NULL;
+    size_t lookahead = (1 << 18);
+    SizeT inProcessed;
+    SizeT outProcessed;
+
+    if (lookahead > p->packRemain)
+      lookahead = (size_t)p->packRemain;
+    RINOK(inStream->Look(inStream, &inBuf, &lookahead));
+
+    if (p->MethodID == k_Copy)
+    {
+      if (lookahead == 0)
+        return SZ_ERROR_INPUT_EOF;
+      if (lookahead > outSize)
+        lookahead = outSize;
+      memcpy(dest, inBuf, lookahead);
+      inProcessed = outProcessed = lookahead;
+    }
+    else
+    {
+      CLzmaDec *dec = &p->lzma2.decoder;
+      SizeT dicPos, dicLimit;
+      ELzmaStatus status;
+
+      if (dec->dicPos == p->dicBufSize)
+        dec->dicPos = 0;  /* wrap around, like LzmaDec_DecodeToBuf does. */
+      dicPos = dec->dicPos;
+      dicLimit = (p->dicBufSize - dicPos > outSize) ? dicPos + outSize : p->dicBufSize;
+
+      inProcessed = (SizeT)lookahead;
+      if (p->MethodID == k_LZMA)
+      {
+        RINOK(LzmaDec_DecodeToDic(dec, dicLimit, (const Byte *)inBuf, &inProcessed, LZMA_FINISH_ANY, &status));
+      }
+      else
+      {
+        RINOK(Lzma2Dec_DecodeToDic(&p->lzma2, dicLimit, (const Byte *)inBuf, &inProcessed, LZMA_FINISH_ANY, &status));
+      }
+
+      outProcessed = dec->dicPos - dicPos;
+      if (inProcessed == 0 && outProcessed == 0)
+        return SZ_ERROR_DATA;
+      memcpy(dest, dec->dic + dicPos, outProcessed);
+    }
+
+    RINOK(inStream->Skip((void *)inStream, inProcessed));
+    p->packRemain -= inProcessed;
+    p->unpackPos += outProcessed;
+    dest += outProcessed;
+    outSize -= outProcessed;
+    *size += outProcessed;
+  }
+
+  return SZ_OK;
+}
+
+#endif  /* !PHYSFS_LZMASDK_LZMADEC_ONLY */
+
 #endif  /* _INCLUDE_PHYSFS_LZMASDK_H_ */
 
 /* end of physfs_lzmasdk.h ... */
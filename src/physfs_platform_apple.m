@@ -13,6 +13,11 @@
 
 #include <Foundation/Foundation.h>
 
+#if !TARGET_OS_IPHONE
+#include <CoreServices/CoreServices.h>
+#include <limits.h>
+#endif
+
 #include "physfs_internal.h"
 
 int __PHYSFS_platformInit(void)
@@ -182,6 +187,235 @@ void __PHYSFS_platformDetectAvailableCDs(PHYSFS_StringCallback cb, void *data)
 #endif /* !defined(PHYSFS_NO_CDROM_SUPPORT) */
 } /* __PHYSFS_platformDetectAvailableCDs */
 
+
+
+#if TARGET_OS_IPHONE
+
+void *__PHYSFS_platformWatchDir(const char *dir)
+{
+    BAIL(PHYSFS_ERR_UNSUPPORTED, NULL);  /* no FSEvents here. */
+} /* __PHYSFS_platformWatchDir */
+
+
+int __PHYSFS_platformPollWatch(void *watch, PHYSFS_StringCallback cb,
+                               void *data)
+{
+    return 0;  /* never gets a watch to poll. */
+} /* __PHYSFS_platformPollWatch */
+
+
+void __PHYSFS_platformUnwatchDir(void *watch)
+{
+    /* never handed one out. */
+} /* __PHYSFS_platformUnwatchDir */
+
+#else
+
+/*
+ * FSEvents calls us on a dispatch queue of our own, whenever it likes, so
+ *  changes pile up in a list until __PHYSFS_platformPollWatch() takes them.
+ */
+
+typedef struct AppleWatchChange
+{
+    struct AppleWatchChange *next;
+    char path[1];  /* allocated to fit. */
+} AppleWatchChange;
+
+typedef struct
+{
+    FSEventStreamRef stream;
+    dispatch_queue_t queue;
+    int started;  /* non-zero if FSEventStreamStart() worked. */
+    void *lock;  /* protects everything below. */
+    char *base;  /* the watched dir's real path, ending with a '/'. */
+    size_t baselen;
+    int lost;  /* non-zero if changes were dropped since the last poll. */
+    AppleWatchChange *changes;  /* oldest first. */
+    AppleWatchChange **tail;  /* where the next change goes. */
+} AppleWatch;
+
+static const FSEventStreamEventFlags appleWatchLostFlags =
+    kFSEventStreamEventFlagMustScanSubDirs |
+    kFSEventStreamEventFlagUserDropped |
+    kFSEventStreamEventFlagKernelDropped |
+    kFSEventStreamEventFlagRootChanged;
+
+
+static void appleWatchCallback(ConstFSEventStreamRef stream, void *info,
+                               size_t count, void *_paths,
+                               const FSEventStreamEventFlags *flags,
+                               const FSEventStreamEventId *ids)
+{
+    AppleWatch *w = (AppleWatch *) info;
+    const char **paths = (const char **) _paths;
+    size_t i;
+
+    __PHYSFS_platformGrabMutex(w->lock);
+    for (i = 0; i < count; i++)
+    {
+        const char *path = paths[i];
+        AppleWatchChange *change;
+        size_t len;
+
+        if (flags[i] & appleWatchLostFlags)
+        {
+            w->lost = 1;  /* it can't say exactly what changed. */
+            continue;
+        } /* if */
+        else if (strncmp(path, w->base, w->baselen) != 0)
+            continue;  /* the watched dir itself; its parent isn't watched. */
+
+        path += w->baselen;
+        len = strlen(path);
+        change = (AppleWatchChange *) allocator.Malloc(sizeof (*change) + len);
+        if (change == NULL)
+        {
+            w->lost = 1;
+            continue;
+        } /* if */
+
+        memcpy(change->path, path, len + 1);
+        change->next = NULL;
+        *w->tail = change;
+        w->tail = &change->next;
+    } /* for */
+    __PHYSFS_platformReleaseMutex(w->lock);
+} /* appleWatchCallback */
+
+
+void *__PHYSFS_platformWatchDir(const char *dir)
+{
+    const FSEventStreamCreateFlags streamflags =
+        kFSEventStreamCreateFlagFileEvents | kFSEventStreamCreateFlagNoDefer |
+        kFSEventStreamCreateFlagWatchRoot;
+    FSEventStreamContext ctx;
+    CFStringRef cfpath;
+    CFArrayRef cfpaths;
+    char real[PATH_MAX];
+    AppleWatch *w;
+
+    /* FSEvents reports paths with symlinks resolved. */
+    BAIL_IF(!realpath(dir, real), PHYSFS_ERR_NOT_FOUND, NULL);
+
+    w = (AppleWatch *) allocator.Malloc(sizeof (AppleWatch));
+    BAIL_IF(!w, PHYSFS_ERR_OUT_OF_MEMORY, NULL);
+    memset(w, '\0', sizeof (*w));
+    w->tail = &w->changes;
+
+    w->lock = __PHYSFS_platformCreateMutex();
+    GOTO_IF(!w->lock, PHYSFS_ERR_OUT_OF_MEMORY, watchDir_failed);
+
+    w->baselen = strlen(real);
+    w->base = (char *) allocator.Malloc(w->baselen + 2);
+    GOTO_IF(!w->base, PHYSFS_ERR_OUT_OF_MEMORY, watchDir_failed);
+    strcpy(w->base, real);
+    if ((w->baselen == 0) || (real[w->baselen - 1] != '/'))
+        w->base[w->baselen++] = '/';
+    w->base[w->baselen] = '\0';
+
+    memset(&ctx, '\0', sizeof (ctx));
+    ctx.info = w;
+    cfpath = CFStringCreateWithCString(NULL, real, kCFStringEncodingUTF8);
+    GOTO_IF(!cfpath, PHYSFS_ERR_OUT_OF_MEMORY, watchDir_failed);
+    cfpaths = CFArrayCreate(NULL, (const void **) &cfpath, 1,
+                            &kCFTypeArrayCallBacks);
+    CFRelease(cfpath);
+    GOTO_IF(!cfpaths, PHYSFS_ERR_OUT_OF_MEMORY, watchDir_failed);
+    w->stream = FSEventStreamCreate(NULL, appleWatchCallback, &ctx, cfpaths,
+                                    kFSEventStreamEventIdSinceNow, 0.05,
+                                    streamflags);
+    CFRelease(cfpaths);
+    GOTO_IF(!w->stream, PHYSFS_ERR_OS_ERROR, watchDir_failed);
+
+    w->queue = dispatch_queue_create("org.icculus.physfs.watch", NULL);
+    GOTO_IF(!w->queue, PHYSFS_ERR_OS_ERROR, watchDir_failed);
+    FSEventStreamSetDispatchQueue(w->stream, w->queue);
+    GOTO_IF(!FSEventStreamStart(w->stream), PHYSFS_ERR_OS_ERROR,
+            watchDir_failed);
+    w->started = 1;
+    return w;
+
+watchDir_failed:
+    __PHYSFS_platformUnwatchDir(w);
+    return NULL;
+} /* __PHYSFS_platformWatchDir */
+
+
+int __PHYSFS_platformPollWatch(void *watch, PHYSFS_StringCallback cb,
+                               void *data)
+{
+    AppleWatch *w = (AppleWatch *) watch;
+    AppleWatchChange *changes;
+    int retval = 0;
+    int lost;
+
+    __PHYSFS_platformGrabMutex(w->lock);
+    changes = w->changes;
+    lost = w->lost;
+    w->changes = NULL;
+    w->tail = &w->changes;
+    w->lost = 0;
+    __PHYSFS_platformReleaseMutex(w->lock);
+
+    if (lost)
+    {
+        cb(data, "");
+        retval++;
+    } /* if */
+
+    while (changes != NULL)
+    {
+        AppleWatchChange *next = changes->next;
+        if (!lost)  /* "" already covered it. */
+        {
+            cb(data, changes->path);
+            retval++;
+        } /* if */
+        allocator.Free(changes);
+        changes = next;
+    } /* while */
+
+    return retval;
+} /* __PHYSFS_platformPollWatch */
+
+
+void __PHYSFS_platformUnwatchDir(void *watch)
+{
+    AppleWatch *w = (AppleWatch *) watch;
+    AppleWatchChange *i;
+
+    if (w->stream)
+    {
+        if (w->started)
+            FSEventStreamStop(w->stream);
+        if (w->queue)  /* only scheduled if we got this far. */
+            FSEventStreamInvalidate(w->stream);
+        FSEventStreamRelease(w->stream);
+    } /* if */
+
+    if (w->queue)
+    {
+        dispatch_sync(w->queue, ^{});  /* wait out a callback in progress. */
+        dispatch_release(w->queue);
+    } /* if */
+
+    for (i = w->changes; i != NULL; )
+    {
+        AppleWatchChange *next = i->next;
+        allocator.Free(i);
+        i = next;
+    } /* for */
+
+    if (w->lock)
+        __PHYSFS_platformDestroyMutex(w->lock);
+    if (w->base)
+        allocator.Free(w->base);
+    allocator.Free(w);
+} /* __PHYSFS_platformUnwatchDir */
+
+#endif /* TARGET_OS_IPHONE */
+
 #endif /* PHYSFS_PLATFORM_APPLE */
 
 /* end of physfs_platform_apple.m ... */
@@ -180,6 +180,26 @@ char *__PHYSFS_platformCalcPrefDir(const char *org, const char *app)
     return retval;
 } /* __PHYSFS_platformCalcPrefDir */
 
+
+/* !!! FIXME: BNode::WatchNode() could do this. */
+void *__PHYSFS_platformWatchDir(const char *dir)
+{
+    BAIL(PHYSFS_ERR_UNSUPPORTED, NULL);
+} /* __PHYSFS_platformWatchDir */
+
+
+int __PHYSFS_platformPollWatch(void *watch, PHYSFS_StringCallback cb,
+                               void *data)
+{
+    return 0;  /* never gets a watch to poll. */
+} /* __PHYSFS_platformPollWatch */
+
+
+void __PHYSFS_platformUnwatchDir(void *watch)
+{
+    /* never handed one out. */
+} /* __PHYSFS_platformUnwatchDir */
+
 #endif  /* PHYSFS_PLATFORM_HAIKU */
 
 /* end of physfs_platform_haiku.cpp ... */
@@ -36,6 +36,7 @@ static int (_System *pUniCreateUconvObject)(UniChar *, UconvObject *) = NULL;
 static int (_System *pUniFreeUconvObject)(UconvObject *) = NULL;
 static int (_System *pUniUconvToUcs)(UconvObject,void **,size_t *, UniChar**, size_t *, size_t *) = NULL;
 static int (_System *pUniUconvFromUcs)(UconvObject,UniChar **,size_t *,void **,size_t *,size_t *) = NULL;
+static void *readAtLock = NULL;  /* see __PHYSFS_platformReadAt(). */
 
 static PHYSFS_ErrorCode errcodeFromAPIRET(const APIRET rc)
 {
@@ -294,6 +295,8 @@ static void prepUnicodeSupport(void)
 
 int __PHYSFS_platformInit(void)
 {
+    readAtLock = __PHYSFS_platformCreateMutex();
+    BAIL_IF_ERRPASS(!readAtLock, 0);
     prepUnicodeSupport();
     return 1;  /* ready to go! */
 } /* __PHYSFS_platformInit */
@@ -301,6 +304,12 @@ int __PHYSFS_platformInit(void)
 
 void __PHYSFS_platformDeinit(void)
 {
+    if (readAtLock)
+    {
+        __PHYSFS_platformDestroyMutex(readAtLock);
+        readAtLock = NULL;
+    } /* if */
+
     if (uconvdll)
     {
         pUniFreeUconvObject(uconv);
@@ -479,6 +488,48 @@ PHYSFS_EnumerateCallbackResult __PHYSFS_platformEnumerate(const char *dirname,
 } /* __PHYSFS_platformEnumerate */
 
 
+typedef struct
+{
+    const char *dirname;
+    PHYSFS_EnumerateStatCallback callback;
+    void *callbackdata;
+} OS2StatEnumData;
+
+static PHYSFS_EnumerateCallbackResult statEnumCallback(void *_data,
+                                    const char *origdir, const char *fname)
+{
+    /* !!! FIXME: FILEFINDBUF3 has most of this already, but not all of it. */
+    OS2StatEnumData *data = (OS2StatEnumData *) _data;
+    const size_t len = strlen(data->dirname) + strlen(fname) + 2;
+    char *path = (char *) __PHYSFS_smallAlloc(len);
+    PHYSFS_Stat st;
+    int rc;
+
+    BAIL_IF(!path, PHYSFS_ERR_OUT_OF_MEMORY, PHYSFS_ENUM_ERROR);
+    snprintf(path, len, "%s\\%s", data->dirname, fname);
+    rc = __PHYSFS_platformStat(path, &st, 0);
+    __PHYSFS_smallFree(path);
+    if (!rc)
+        return PHYSFS_ENUM_OK;  /* probably deleted in the meantime; skip. */
+
+    return data->callback(data->callbackdata, origdir, fname, &st);
+} /* statEnumCallback */
+
+
+PHYSFS_EnumerateCallbackResult __PHYSFS_platformEnumerateWithStat(
+                               const char *dirname,
+                               PHYSFS_EnumerateStatCallback callback,
+                               const char *origdir, void *callbackdata)
+{
+    OS2StatEnumData data;
+    data.dirname = dirname;
+    data.callback = callback;
+    data.callbackdata = callbackdata;
+    return __PHYSFS_platformEnumerate(dirname, statEnumCallback,
+                                      origdir, &data);
+} /* __PHYSFS_platformEnumerateWithStat */
+
+
 char *__PHYSFS_platformCurrentDir(void)
 {
     char *retval;
@@ -621,6 +672,30 @@ PHYSFS_sint64 __PHYSFS_platformRead(void *opaque, void *buf, PHYSFS_uint64 len)
 } /* __PHYSFS_platformRead */
 
 
+/* OS/2 has no positional read, so we seek and read under readAtLock. */
+PHYSFS_sint64 __PHYSFS_platformReadAt(void *opaque, PHYSFS_uint64 pos,
+                                      void *buf, PHYSFS_uint64 len)
+{
+    PHYSFS_sint64 retval = -1;
+    __PHYSFS_platformGrabMutex(readAtLock);
+    if (__PHYSFS_platformSeek(opaque, pos))
+        retval = __PHYSFS_platformRead(opaque, buf, len);
+    __PHYSFS_platformReleaseMutex(readAtLock);
+    return retval;
+} /* __PHYSFS_platformReadAt */
+
+
+void __PHYSFS_platformReadAtBatch(__PHYSFS_PlatformRead *reads,
+                                  PHYSFS_uint32 count)
+{
+    /* !!! FIXME: DosRead() is all we have; could thread this, maybe. */
+    PHYSFS_uint32 i;
+    for (i = 0; i < count; i++)
+        reads[i].result = 0;
+    __PHYSFS_finishReadsAt(reads, count);
+} /* __PHYSFS_platformReadAtBatch */
+
+
 PHYSFS_sint64 __PHYSFS_platformWrite(void *opaque, const void *buf,
                                      PHYSFS_uint64 len)
 {
@@ -682,6 +757,20 @@ void __PHYSFS_platformClose(void *opaque)
 } /* __PHYSFS_platformClose */
 
 
+void *__PHYSFS_platformMapFile(void *opaque, const void **ptr,
+                               PHYSFS_uint64 *len)
+{
+    /* !!! FIXME: OS/2 has no file mapping; callers fall back to reading. */
+    BAIL(PHYSFS_ERR_UNSUPPORTED, NULL);
+} /* __PHYSFS_platformMapFile */
+
+
+void __PHYSFS_platformUnmapFile(void *mapping)
+{
+    /* never hands out mappings, so this is never called. */
+} /* __PHYSFS_platformUnmapFile */
+
+
 int __PHYSFS_platformDelete(const char *path)
 {
     char *cppath = cvtUtf8ToCodepage(path);
@@ -702,6 +791,30 @@ done:
 } /* __PHYSFS_platformDelete */
 
 
+int __PHYSFS_platformRename(const char *src, const char *dst)
+{
+    char *cpsrc = cvtUtf8ToCodepage(src);
+    char *cpdst = NULL;
+    APIRET rc;
+    int retval = 0;
+
+    BAIL_IF_ERRPASS(!cpsrc, 0);
+    cpdst = cvtUtf8ToCodepage(dst);
+    GOTO_IF_ERRPASS(!cpdst, done);
+
+    /* DosMove won't replace anything, so this is as atomic as it gets. */
+    DosDelete(cpdst);
+    rc = DosMove(cpsrc, cpdst);
+    GOTO_IF(rc != NO_ERROR, errcodeFromAPIRET(rc), done);
+    retval = 1;  /* success */
+
+done:
+    allocator.Free(cpdst);
+    allocator.Free(cpsrc);
+    return retval;
+} /* __PHYSFS_platformRename */
+
+
 /* Convert to a format PhysicsFS can grok... */
 PHYSFS_sint64 os2TimeToUnixTime(const FDATE *date, const FTIME *time)
 {
@@ -780,6 +893,14 @@ void *__PHYSFS_platformGetThreadID(void)
 } /* __PHYSFS_platformGetThreadID */
 
 
+PHYSFS_uint64 __PHYSFS_platformNanoseconds(void)
+{
+    ULONG ms = 0;  /* milliseconds since boot; wraps after 49 days. */
+    DosQuerySysInfo(QSV_MS_COUNT, QSV_MS_COUNT, &ms, sizeof (ms));
+    return ((PHYSFS_uint64) ms) * 1000000;
+} /* __PHYSFS_platformNanoseconds */
+
+
 void *__PHYSFS_platformCreateMutex(void)
 {
     HMTX hmtx = NULLHANDLE;
@@ -807,6 +928,94 @@ void __PHYSFS_platformReleaseMutex(void *mutex)
     DosReleaseMutexSem((HMTX) mutex);
 } /* __PHYSFS_platformReleaseMutex */
 
+
+/* !!! FIXME: a real reader/writer lock; for now, everyone takes turns. */
+void *__PHYSFS_platformCreateRWLock(void)
+{
+    return __PHYSFS_platformCreateMutex();
+} /* __PHYSFS_platformCreateRWLock */
+
+
+void __PHYSFS_platformDestroyRWLock(void *rwlock)
+{
+    __PHYSFS_platformDestroyMutex(rwlock);
+} /* __PHYSFS_platformDestroyRWLock */
+
+
+int __PHYSFS_platformGrabRWLockShared(void *rwlock)
+{
+    return __PHYSFS_platformGrabMutex(rwlock);
+} /* __PHYSFS_platformGrabRWLockShared */
+
+
+int __PHYSFS_platformGrabRWLockExclusive(void *rwlock)
+{
+    return __PHYSFS_platformGrabMutex(rwlock);
+} /* __PHYSFS_platformGrabRWLockExclusive */
+
+
+void __PHYSFS_platformReleaseRWLock(void *rwlock)
+{
+    __PHYSFS_platformReleaseMutex(rwlock);
+} /* __PHYSFS_platformReleaseRWLock */
+
+
+/* !!! FIXME: DosCreateThread() could do this; for now, callers do the work. */
+void *__PHYSFS_platformCreateThread(void (*fn)(void *), void *arg)
+{
+    return NULL;
+} /* __PHYSFS_platformCreateThread */
+
+
+void __PHYSFS_platformJoinThread(void *thread)
+{
+    /* never gets a thread to join. */
+} /* __PHYSFS_platformJoinThread */
+
+
+void *__PHYSFS_platformCreateSemaphore(void)
+{
+    return NULL;  /* no threads to wait for. */
+} /* __PHYSFS_platformCreateSemaphore */
+
+
+void __PHYSFS_platformDestroySemaphore(void *sem)
+{
+    /* never handed one out. */
+} /* __PHYSFS_platformDestroySemaphore */
+
+
+void __PHYSFS_platformWaitSemaphore(void *sem)
+{
+    /* never handed one out. */
+} /* __PHYSFS_platformWaitSemaphore */
+
+
+void __PHYSFS_platformPostSemaphore(void *sem)
+{
+    /* never handed one out. */
+} /* __PHYSFS_platformPostSemaphore */
+
+
+/* !!! FIXME: DosFindNotifyFirst() could do this. */
+void *__PHYSFS_platformWatchDir(const char *dir)
+{
+    BAIL(PHYSFS_ERR_UNSUPPORTED, NULL);
+} /* __PHYSFS_platformWatchDir */
+
+
+int __PHYSFS_platformPollWatch(void *watch, PHYSFS_StringCallback cb,
+                               void *data)
+{
+    return 0;  /* never gets a watch to poll. */
+} /* __PHYSFS_platformPollWatch */
+
+
+void __PHYSFS_platformUnwatchDir(void *watch)
+{
+    /* never handed one out. */
+} /* __PHYSFS_platformUnwatchDir */
+
 #endif  /* PHYSFS_PLATFORM_OS2 */
 
 /* end of physfs_platform_os2.c ... */
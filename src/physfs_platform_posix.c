@@ -22,6 +22,14 @@
 #include <errno.h>
 #include <fcntl.h>
 #include <pthread.h>
+#include <sys/mman.h>
+#include <sys/time.h>
+#include <time.h>
+
+#if PHYSFS_HAVE_IO_URING
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+#endif
 
 #include "physfs_internal.h"
 
@@ -118,8 +126,42 @@ char *__PHYSFS_platformCalcUserDir(void)
 } /* __PHYSFS_platformCalcUserDir */
 
 
-PHYSFS_EnumerateCallbackResult __PHYSFS_platformEnumerate(const char *dirname,
+static void statFromStatBuf(const struct stat *statbuf, PHYSFS_Stat *st)
+{
+    if (S_ISREG(statbuf->st_mode))
+    {
+        st->filetype = PHYSFS_FILETYPE_REGULAR;
+        st->filesize = statbuf->st_size;
+    } /* if */
+
+    else if(S_ISDIR(statbuf->st_mode))
+    {
+        st->filetype = PHYSFS_FILETYPE_DIRECTORY;
+        st->filesize = 0;
+    } /* else if */
+
+    else if(S_ISLNK(statbuf->st_mode))
+    {
+        st->filetype = PHYSFS_FILETYPE_SYMLINK;
+        st->filesize = 0;
+    } /* else if */
+
+    else
+    {
+        st->filetype = PHYSFS_FILETYPE_OTHER;
+        st->filesize = statbuf->st_size;
+    } /* else */
+
+    st->modtime = statbuf->st_mtime;
+    st->createtime = statbuf->st_ctime;
+    st->accesstime = statbuf->st_atime;
+} /* statFromStatBuf */
+
+
+/* (statcallback) is NULL unless the caller wants to know about each item. */
+static PHYSFS_EnumerateCallbackResult doEnumerate(const char *dirname,
                                PHYSFS_EnumerateCallback callback,
+                               PHYSFS_EnumerateStatCallback statcallback,
                                const char *origdir, void *callbackdata)
 {
     DIR *dir;
@@ -138,7 +180,44 @@ PHYSFS_EnumerateCallbackResult __PHYSFS_platformEnumerate(const char *dirname,
                 continue;
         } /* if */
 
-        retval = callback(callbackdata, origdir, name);
+        if (statcallback == NULL)
+            retval = callback(callbackdata, origdir, name);
+        else
+        {
+            struct stat statbuf;
+            PHYSFS_Stat st;
+            int rc;
+
+            /* stat relative to the open dir, so the path isn't walked again. */
+            #ifdef AT_SYMLINK_NOFOLLOW
+            const int fd = dirfd(dir);
+            rc = fstatat(fd, name, &statbuf, AT_SYMLINK_NOFOLLOW);
+            if (rc != -1)
+                st.readonly = (faccessat(fd, name, W_OK, 0) == -1);
+            #else
+            const size_t len = strlen(dirname) + strlen(name) + 2;
+            char *path = (char *) __PHYSFS_smallAlloc(len);
+            BAIL_IF(!path, PHYSFS_ERR_OUT_OF_MEMORY, PHYSFS_ENUM_ERROR);
+            snprintf(path, len, "%s/%s", dirname, name);
+            rc = lstat(path, &statbuf);
+            if (rc != -1)
+                st.readonly = (access(path, W_OK) == -1);
+            __PHYSFS_smallFree(path);
+            #endif
+
+            if (rc == -1)
+            {
+                if (errno == ENOENT)
+                    continue;  /* deleted since readdir() saw it. */
+                PHYSFS_setErrorCode(errcodeFromErrno());
+                retval = PHYSFS_ENUM_ERROR;
+                break;
+            } /* if */
+
+            statFromStatBuf(&statbuf, &st);
+            retval = statcallback(callbackdata, origdir, name, &st);
+        } /* else */
+
         if (retval == PHYSFS_ENUM_ERROR)
             PHYSFS_setErrorCode(PHYSFS_ERR_APP_CALLBACK);
     } /* while */
@@ -146,9 +225,26 @@ PHYSFS_EnumerateCallbackResult __PHYSFS_platformEnumerate(const char *dirname,
     closedir(dir);
 
     return retval;
+} /* doEnumerate */
+
+
+PHYSFS_EnumerateCallbackResult __PHYSFS_platformEnumerate(const char *dirname,
+                               PHYSFS_EnumerateCallback callback,
+                               const char *origdir, void *callbackdata)
+{
+    return doEnumerate(dirname, callback, NULL, origdir, callbackdata);
 } /* __PHYSFS_platformEnumerate */
 
 
+PHYSFS_EnumerateCallbackResult __PHYSFS_platformEnumerateWithStat(
+                               const char *dirname,
+                               PHYSFS_EnumerateStatCallback callback,
+                               const char *origdir, void *callbackdata)
+{
+    return doEnumerate(dirname, NULL, callback, origdir, callbackdata);
+} /* __PHYSFS_platformEnumerateWithStat */
+
+
 int __PHYSFS_platformMkDir(const char *path)
 {
     const int rc = mkdir(path, S_IRWXU);
@@ -227,6 +323,298 @@ PHYSFS_sint64 __PHYSFS_platformRead(void *opaque, void *buffer,
 } /* __PHYSFS_platformRead */
 
 
+PHYSFS_sint64 __PHYSFS_platformReadAt(void *opaque, PHYSFS_uint64 pos,
+                                      void *buffer, PHYSFS_uint64 len)
+{
+    const int fd = *((int *) opaque);
+    ssize_t rc = 0;
+
+    if (!__PHYSFS_ui64FitsAddressSpace(len))
+        BAIL(PHYSFS_ERR_INVALID_ARGUMENT, -1);
+    BAIL_IF(((PHYSFS_uint64) ((off_t) pos)) != pos, PHYSFS_ERR_PAST_EOF, -1);
+
+    rc = pread(fd, buffer, (size_t) len, (off_t) pos);
+    BAIL_IF(rc == -1, errcodeFromErrno(), -1);
+    assert(rc >= 0);
+    assert(rc <= len);
+    return (PHYSFS_sint64) rc;
+} /* __PHYSFS_platformReadAt */
+
+
+#if PHYSFS_HAVE_IO_URING
+/*
+ * Batched reads through io_uring, with raw syscalls so we don't need
+ *  liburing. A ring is cheap enough to set up that each batch gets its own,
+ *  which saves us from sharing one between threads.
+ */
+
+#define URING_MAX_ENTRIES 128
+#define URING_MAX_READ 0x7FFFF000  /* what read() will do in one go, too. */
+
+typedef struct
+{
+    int fd;
+    unsigned entries;
+    void *sqring;
+    size_t sqringlen;
+    void *cqring;  /* might be the same mapping as (sqring). */
+    size_t cqringlen;
+    struct io_uring_sqe *sqes;
+    size_t sqeslen;
+    unsigned *sqtail;
+    unsigned sqmask;
+    unsigned *sqarray;
+    unsigned *cqhead;
+    unsigned *cqtail;
+    unsigned cqmask;
+    struct io_uring_cqe *cqes;
+} Uring;
+
+/* set once the kernel (or a seccomp filter) refuses us; it won't change. */
+static volatile int uringUnavailable = 0;
+
+static void uringClose(Uring *ring)
+{
+    if (ring->sqes != MAP_FAILED)
+        munmap(ring->sqes, ring->sqeslen);
+    if ((ring->cqring != MAP_FAILED) && (ring->cqring != ring->sqring))
+        munmap(ring->cqring, ring->cqringlen);
+    if (ring->sqring != MAP_FAILED)
+        munmap(ring->sqring, ring->sqringlen);
+    close(ring->fd);
+} /* uringClose */
+
+
+static int uringOpen(Uring *ring, const unsigned entries)
+{
+    const int prot = PROT_READ | PROT_WRITE;
+    const int flags = MAP_SHARED | MAP_POPULATE;
+    struct io_uring_params p;
+    PHYSFS_uint8 *sq;
+    PHYSFS_uint8 *cq;
+
+    memset(&p, '\0', sizeof (p));
+    ring->sqring = ring->cqring = MAP_FAILED;
+    ring->sqes = (struct io_uring_sqe *) MAP_FAILED;
+    ring->fd = (int) syscall(__NR_io_uring_setup, entries, &p);
+    if (ring->fd < 0)
+        return 0;
+
+    ring->entries = p.sq_entries;
+    ring->sqringlen = p.sq_off.array + (p.sq_entries * sizeof (unsigned));
+    ring->cqringlen = p.cq_off.cqes +
+                      (p.cq_entries * sizeof (struct io_uring_cqe));
+    if (p.features & IORING_FEAT_SINGLE_MMAP)
+    {
+        if (ring->cqringlen > ring->sqringlen)
+            ring->sqringlen = ring->cqringlen;
+        ring->cqringlen = ring->sqringlen;
+    } /* if */
+
+    ring->sqring = mmap(NULL, ring->sqringlen, prot, flags, ring->fd,
+                        IORING_OFF_SQ_RING);
+    if (ring->sqring == MAP_FAILED)
+        goto uringOpen_failed;
+
+    if (p.features & IORING_FEAT_SINGLE_MMAP)
+        ring->cqring = ring->sqring;
+    else
+    {
+        ring->cqring = mmap(NULL, ring->cqringlen, prot, flags, ring->fd,
+                            IORING_OFF_CQ_RING);
+        if (ring->cqring == MAP_FAILED)
+            goto uringOpen_failed;
+    } /* else */
+
+    ring->sqeslen = p.sq_entries * sizeof (struct io_uring_sqe);
+    ring->sqes = (struct io_uring_sqe *) mmap(NULL, ring->sqeslen, prot,
+                                          flags, ring->fd, IORING_OFF_SQES);
+    if (ring->sqes == MAP_FAILED)
+        goto uringOpen_failed;
+
+    sq = (PHYSFS_uint8 *) ring->sqring;
+    cq = (PHYSFS_uint8 *) ring->cqring;
+    ring->sqtail = (unsigned *) (sq + p.sq_off.tail);
+    ring->sqmask = *((unsigned *) (sq + p.sq_off.ring_mask));
+    ring->sqarray = (unsigned *) (sq + p.sq_off.array);
+    ring->cqhead = (unsigned *) (cq + p.cq_off.head);
+    ring->cqtail = (unsigned *) (cq + p.cq_off.tail);
+    ring->cqmask = *((unsigned *) (cq + p.cq_off.ring_mask));
+    ring->cqes = (struct io_uring_cqe *) (cq + p.cq_off.cqes);
+    return 1;
+
+uringOpen_failed:
+    uringClose(ring);
+    return 0;
+} /* uringOpen */
+
+
+static void uringQueueRead(Uring *ring, const __PHYSFS_PlatformRead *r,
+                           const PHYSFS_uint32 index)
+{
+    const unsigned tail = *ring->sqtail;  /* we're the only writer. */
+    const unsigned slot = tail & ring->sqmask;
+    const PHYSFS_uint64 len = r->len - (PHYSFS_uint64) r->result;
+    struct io_uring_sqe *sqe = &ring->sqes[slot];
+
+    memset(sqe, '\0', sizeof (*sqe));
+    sqe->opcode = IORING_OP_READ;
+    sqe->fd = *((int *) r->opaque);
+    sqe->off = r->pos + (PHYSFS_uint64) r->result;
+    sqe->addr = (PHYSFS_uint64) (size_t) (((PHYSFS_uint8 *) r->buffer) +
+                                          r->result);
+    sqe->len = (len > URING_MAX_READ) ? URING_MAX_READ : (unsigned) len;
+    sqe->user_data = index;
+    ring->sqarray[slot] = slot;
+    __atomic_store_n(ring->sqtail, tail + 1, __ATOMIC_RELEASE);
+} /* uringQueueRead */
+
+
+/*
+ * Returns zero if the ring itself broke, in which case nothing it did can be
+ *  trusted. Reads the ring couldn't do are left with (error) set to
+ *  PHYSFS_ERR_IO, for the caller to finish by hand.
+ */
+static int uringReadBatch(Uring *ring, __PHYSFS_PlatformRead *reads,
+                          const PHYSFS_uint32 count)
+{
+    PHYSFS_uint32 *retry = NULL;  /* ring buffer of reads to queue again. */
+    PHYSFS_uint32 retryhead = 0;
+    PHYSFS_uint32 retrycount = 0;
+    PHYSFS_uint32 next = 0;
+    unsigned inflight = 0;  /* queued, whether the kernel has them or not. */
+    unsigned unsubmitted = 0;
+    int broken = 0;
+
+    retry = (PHYSFS_uint32 *) allocator.Malloc(sizeof (PHYSFS_uint32) * count);
+    if (!retry)
+        return 0;
+
+    while (1)
+    {
+        unsigned head;
+        long rc;
+
+        /* short reads go back in first, then whatever's left. */
+        while ((!broken) && (retrycount > 0) && (inflight < ring->entries))
+        {
+            uringQueueRead(ring, &reads[retry[retryhead]], retry[retryhead]);
+            retryhead = (retryhead + 1) % count;
+            retrycount--;
+            inflight++;
+            unsubmitted++;
+        } /* while */
+
+        while ((!broken) && (next < count) && (inflight < ring->entries))
+        {
+            __PHYSFS_PlatformRead *r = &reads[next];
+            r->result = 0;
+            r->error = PHYSFS_ERR_OK;
+            if (r->len == 0)
+                ;  /* nothing to do. */
+            else if (((PHYSFS_uint64) ((off_t) r->pos)) != r->pos)
+                r->error = PHYSFS_ERR_IO;  /* let pread() complain. */
+            else
+            {
+                uringQueueRead(ring, r, next);
+                inflight++;
+                unsubmitted++;
+            } /* else */
+            next++;
+        } /* while */
+
+        /* once broken, we only wait for the kernel to let go of buffers. */
+        if (broken ? (inflight == unsubmitted) : (inflight == 0))
+        {
+            if ((broken) || ((next == count) && (retrycount == 0)))
+                break;
+            continue;  /* none of these needed the ring; try some more. */
+        } /* if */
+
+        rc = syscall(__NR_io_uring_enter, ring->fd,
+                     broken ? 0 : unsubmitted, 1, IORING_ENTER_GETEVENTS,
+                     NULL, 0);
+        if (rc < 0)
+        {
+            if ((errno == EINTR) || (errno == EAGAIN) || (errno == EBUSY))
+                continue;
+            else if (broken)
+                break;  /* nothing more we can do. */
+            broken = 1;
+            continue;
+        } /* if */
+        unsubmitted -= (unsigned) rc;
+
+        head = *ring->cqhead;
+        while (head != __atomic_load_n(ring->cqtail, __ATOMIC_ACQUIRE))
+        {
+            const struct io_uring_cqe *cqe = &ring->cqes[head & ring->cqmask];
+            const PHYSFS_uint32 index = (PHYSFS_uint32) cqe->user_data;
+            __PHYSFS_PlatformRead *r = &reads[index];
+
+            if (cqe->res < 0)
+                r->error = PHYSFS_ERR_IO;  /* pread() will say what, later. */
+            else if (cqe->res > 0)
+            {
+                r->result += cqe->res;
+                if (((PHYSFS_uint64) r->result) < r->len)
+                {
+                    /* maybe EOF, maybe not; ask again to find out. */
+                    retry[(retryhead + retrycount) % count] = index;
+                    retrycount++;
+                } /* if */
+            } /* else if */
+
+            head++;
+            inflight--;
+        } /* while */
+        __atomic_store_n(ring->cqhead, head, __ATOMIC_RELEASE);
+    } /* while */
+
+    allocator.Free(retry);
+    return !broken;
+} /* uringReadBatch */
+#endif
+
+
+void __PHYSFS_platformReadAtBatch(__PHYSFS_PlatformRead *reads,
+                                  PHYSFS_uint32 count)
+{
+    PHYSFS_uint32 i;
+
+    #if PHYSFS_HAVE_IO_URING
+    if ((count > 1) && (!uringUnavailable))
+    {
+        const unsigned entries = (count < URING_MAX_ENTRIES) ?
+                                    (unsigned) count : URING_MAX_ENTRIES;
+        Uring ring;
+        if (!uringOpen(&ring, entries))
+            uringUnavailable = 1;
+        else
+        {
+            const int rc = uringReadBatch(&ring, reads, count);
+            uringClose(&ring);
+
+            if (rc)
+            {
+                /* mop up whatever the ring couldn't do by itself. */
+                for (i = 0; i < count; i++)
+                {
+                    if (reads[i].error != PHYSFS_ERR_OK)
+                        __PHYSFS_finishReadsAt(&reads[i], 1);
+                } /* for */
+                return;
+            } /* if */
+        } /* else */
+    } /* if */
+    #endif
+
+    for (i = 0; i < count; i++)
+        reads[i].result = 0;
+    __PHYSFS_finishReadsAt(reads, count);
+} /* __PHYSFS_platformReadAtBatch */
+
+
 PHYSFS_sint64 __PHYSFS_platformWrite(void *opaque, const void *buffer,
                                      PHYSFS_uint64 len)
 {
@@ -289,6 +677,52 @@ void __PHYSFS_platformClose(void *opaque)
 } /* __PHYSFS_platformClose */
 
 
+typedef struct
+{
+    void *ptr;
+    size_t len;
+} PosixMapping;
+
+void *__PHYSFS_platformMapFile(void *opaque, const void **ptr,
+                               PHYSFS_uint64 *len)
+{
+    const int fd = *((int *) opaque);
+    PosixMapping *retval = NULL;
+    struct stat statbuf;
+    void *rc;
+
+    BAIL_IF(fstat(fd, &statbuf) == -1, errcodeFromErrno(), NULL);
+    BAIL_IF(!S_ISREG(statbuf.st_mode), PHYSFS_ERR_UNSUPPORTED, NULL);
+    BAIL_IF(statbuf.st_size <= 0, PHYSFS_ERR_UNSUPPORTED, NULL);
+    BAIL_IF(!__PHYSFS_ui64FitsAddressSpace((PHYSFS_uint64) statbuf.st_size),
+            PHYSFS_ERR_UNSUPPORTED, NULL);
+
+    retval = (PosixMapping *) allocator.Malloc(sizeof (PosixMapping));
+    BAIL_IF(!retval, PHYSFS_ERR_OUT_OF_MEMORY, NULL);
+
+    retval->len = (size_t) statbuf.st_size;
+    rc = mmap(NULL, retval->len, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (rc == MAP_FAILED)
+    {
+        allocator.Free(retval);
+        BAIL(errcodeFromErrno(), NULL);
+    } /* if */
+
+    retval->ptr = rc;
+    *ptr = rc;
+    *len = (PHYSFS_uint64) retval->len;
+    return retval;
+} /* __PHYSFS_platformMapFile */
+
+
+void __PHYSFS_platformUnmapFile(void *mapping)
+{
+    PosixMapping *m = (PosixMapping *) mapping;
+    (void) munmap(m->ptr, m->len);
+    allocator.Free(m);
+} /* __PHYSFS_platformUnmapFile */
+
+
 int __PHYSFS_platformDelete(const char *path)
 {
     BAIL_IF(remove(path) == -1, errcodeFromErrno(), 0);
@@ -296,40 +730,20 @@ int __PHYSFS_platformDelete(const char *path)
 } /* __PHYSFS_platformDelete */
 
 
+int __PHYSFS_platformRename(const char *src, const char *dst)
+{
+    BAIL_IF(rename(src, dst) == -1, errcodeFromErrno(), 0);
+    return 1;
+} /* __PHYSFS_platformRename */
+
+
 int __PHYSFS_platformStat(const char *fname, PHYSFS_Stat *st, const int follow)
 {
     struct stat statbuf;
     const int rc = follow ? stat(fname, &statbuf) : lstat(fname, &statbuf);
     BAIL_IF(rc == -1, errcodeFromErrno(), 0);
 
-    if (S_ISREG(statbuf.st_mode))
-    {
-        st->filetype = PHYSFS_FILETYPE_REGULAR;
-        st->filesize = statbuf.st_size;
-    } /* if */
-
-    else if(S_ISDIR(statbuf.st_mode))
-    {
-        st->filetype = PHYSFS_FILETYPE_DIRECTORY;
-        st->filesize = 0;
-    } /* else if */
-
-    else if(S_ISLNK(statbuf.st_mode))
-    {
-        st->filetype = PHYSFS_FILETYPE_SYMLINK;
-        st->filesize = 0;
-    } /* else if */
-
-    else
-    {
-        st->filetype = PHYSFS_FILETYPE_OTHER;
-        st->filesize = statbuf.st_size;
-    } /* else */
-
-    st->modtime = statbuf.st_mtime;
-    st->createtime = statbuf.st_ctime;
-    st->accesstime = statbuf.st_atime;
-
+    statFromStatBuf(&statbuf, st);
     st->readonly = (access(fname, W_OK) == -1);
     return 1;
 } /* __PHYSFS_platformStat */
@@ -349,6 +763,26 @@ void *__PHYSFS_platformGetThreadID(void)
 } /* __PHYSFS_platformGetThreadID */
 
 
+PHYSFS_uint64 __PHYSFS_platformNanoseconds(void)
+{
+#if defined(CLOCK_MONOTONIC)
+    struct timespec ts;
+    if (clock_gettime(CLOCK_MONOTONIC, &ts) == 0)
+    {
+        return (((PHYSFS_uint64) ts.tv_sec) * __PHYSFS_UI64(1000000000)) +
+               ((PHYSFS_uint64) ts.tv_nsec);
+    } /* if */
+#endif
+
+    {  /* no monotonic clock? Wall time will have to do. */
+        struct timeval tv;
+        gettimeofday(&tv, NULL);
+        return (((PHYSFS_uint64) tv.tv_sec) * __PHYSFS_UI64(1000000000)) +
+               (((PHYSFS_uint64) tv.tv_usec) * 1000);
+    }
+} /* __PHYSFS_platformNanoseconds */
+
+
 void *__PHYSFS_platformCreateMutex(void)
 {
     int rc;
@@ -411,6 +845,239 @@ void __PHYSFS_platformReleaseMutex(void *mutex)
     } /* if */
 } /* __PHYSFS_platformReleaseMutex */
 
+
+typedef struct
+{
+    pthread_mutex_t mutex;  /* protects everything but (count). */
+    pthread_cond_t cond;    /* signalled when readers or writer leave. */
+    pthread_t owner;        /* thread holding it exclusively. */
+    PHYSFS_uint32 count;    /* exclusive recursion count; owner only. */
+    PHYSFS_uint32 readers;  /* outstanding shared grabs. */
+    int writing;            /* non-zero if held exclusively. */
+} PthreadRWLock;
+
+
+void *__PHYSFS_platformCreateRWLock(void)
+{
+    PthreadRWLock *l = (PthreadRWLock *) allocator.Malloc(sizeof (*l));
+    BAIL_IF(!l, PHYSFS_ERR_OUT_OF_MEMORY, NULL);
+
+    if (pthread_mutex_init(&l->mutex, NULL) != 0)
+    {
+        allocator.Free(l);
+        BAIL(PHYSFS_ERR_OS_ERROR, NULL);
+    } /* if */
+
+    if (pthread_cond_init(&l->cond, NULL) != 0)
+    {
+        pthread_mutex_destroy(&l->mutex);
+        allocator.Free(l);
+        BAIL(PHYSFS_ERR_OS_ERROR, NULL);
+    } /* if */
+
+    l->owner = (pthread_t) 0xDEADBEEF;
+    l->count = 0;
+    l->readers = 0;
+    l->writing = 0;
+    return ((void *) l);
+} /* __PHYSFS_platformCreateRWLock */
+
+
+void __PHYSFS_platformDestroyRWLock(void *rwlock)
+{
+    PthreadRWLock *l = (PthreadRWLock *) rwlock;
+    pthread_cond_destroy(&l->cond);
+    pthread_mutex_destroy(&l->mutex);
+    allocator.Free(l);
+} /* __PHYSFS_platformDestroyRWLock */
+
+
+int __PHYSFS_platformGrabRWLockShared(void *rwlock)
+{
+    PthreadRWLock *l = (PthreadRWLock *) rwlock;
+
+    if (l->owner == pthread_self())  /* we hold it exclusively already. */
+    {
+        l->count++;
+        return 1;
+    } /* if */
+
+    if (pthread_mutex_lock(&l->mutex) != 0)
+        return 0;
+
+    /* only wait on an active writer, so recursive shared grabs can't stall. */
+    if (l->writing)
+    {
+        const PHYSFS_uint64 start = __PHYSFS_STAT_NOW();
+        while (l->writing)
+            pthread_cond_wait(&l->cond, &l->mutex);
+        __PHYSFS_STAT_LOCK_WAITED(start);
+    } /* if */
+
+    l->readers++;
+    pthread_mutex_unlock(&l->mutex);
+    return 1;
+} /* __PHYSFS_platformGrabRWLockShared */
+
+
+int __PHYSFS_platformGrabRWLockExclusive(void *rwlock)
+{
+    PthreadRWLock *l = (PthreadRWLock *) rwlock;
+    pthread_t tid = pthread_self();
+
+    if (l->owner != tid)
+    {
+        if (pthread_mutex_lock(&l->mutex) != 0)
+            return 0;
+
+        if ((l->writing) || (l->readers > 0))
+        {
+            const PHYSFS_uint64 start = __PHYSFS_STAT_NOW();
+            while ((l->writing) || (l->readers > 0))
+                pthread_cond_wait(&l->cond, &l->mutex);
+            __PHYSFS_STAT_LOCK_WAITED(start);
+        } /* if */
+
+        l->writing = 1;
+        l->owner = tid;
+        pthread_mutex_unlock(&l->mutex);
+    } /* if */
+
+    l->count++;
+    return 1;
+} /* __PHYSFS_platformGrabRWLockExclusive */
+
+
+void __PHYSFS_platformReleaseRWLock(void *rwlock)
+{
+    PthreadRWLock *l = (PthreadRWLock *) rwlock;
+
+    if (l->owner == pthread_self())
+    {
+        assert(l->count > 0);  /* catch programming errors. */
+        if (--l->count == 0)
+        {
+            pthread_mutex_lock(&l->mutex);
+            l->owner = (pthread_t) 0xDEADBEEF;
+            l->writing = 0;
+            pthread_cond_broadcast(&l->cond);
+            pthread_mutex_unlock(&l->mutex);
+        } /* if */
+    } /* if */
+
+    else
+    {
+        pthread_mutex_lock(&l->mutex);
+        assert(l->readers > 0);  /* catch programming errors. */
+        if (--l->readers == 0)
+            pthread_cond_broadcast(&l->cond);
+        pthread_mutex_unlock(&l->mutex);
+    } /* else */
+} /* __PHYSFS_platformReleaseRWLock */
+
+
+typedef struct
+{
+    pthread_t thread;
+    void (*fn)(void *);
+    void *arg;
+} PthreadThread;
+
+static void *pthreadThreadEntry(void *_t)
+{
+    PthreadThread *t = (PthreadThread *) _t;
+    t->fn(t->arg);
+    return NULL;
+} /* pthreadThreadEntry */
+
+
+void *__PHYSFS_platformCreateThread(void (*fn)(void *), void *arg)
+{
+    PthreadThread *t = (PthreadThread *) allocator.Malloc(sizeof (*t));
+    if (t == NULL)
+        return NULL;
+
+    t->fn = fn;
+    t->arg = arg;
+    if (pthread_create(&t->thread, NULL, pthreadThreadEntry, t) != 0)
+    {
+        allocator.Free(t);
+        return NULL;
+    } /* if */
+
+    return t;
+} /* __PHYSFS_platformCreateThread */
+
+
+void __PHYSFS_platformJoinThread(void *thread)
+{
+    PthreadThread *t = (PthreadThread *) thread;
+    pthread_join(t->thread, NULL);
+    allocator.Free(t);
+} /* __PHYSFS_platformJoinThread */
+
+
+/* sem_init() isn't on every Unix (hi, macOS!), so build one ourselves. */
+typedef struct
+{
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+    unsigned int count;
+} PthreadSemaphore;
+
+void *__PHYSFS_platformCreateSemaphore(void)
+{
+    PthreadSemaphore *s = (PthreadSemaphore *) allocator.Malloc(sizeof (*s));
+    if (s == NULL)
+        return NULL;
+
+    if (pthread_mutex_init(&s->mutex, NULL) != 0)
+    {
+        allocator.Free(s);
+        return NULL;
+    } /* if */
+
+    if (pthread_cond_init(&s->cond, NULL) != 0)
+    {
+        pthread_mutex_destroy(&s->mutex);
+        allocator.Free(s);
+        return NULL;
+    } /* if */
+
+    s->count = 0;
+    return s;
+} /* __PHYSFS_platformCreateSemaphore */
+
+
+void __PHYSFS_platformDestroySemaphore(void *sem)
+{
+    PthreadSemaphore *s = (PthreadSemaphore *) sem;
+    pthread_cond_destroy(&s->cond);
+    pthread_mutex_destroy(&s->mutex);
+    allocator.Free(s);
+} /* __PHYSFS_platformDestroySemaphore */
+
+
+void __PHYSFS_platformWaitSemaphore(void *sem)
+{
+    PthreadSemaphore *s = (PthreadSemaphore *) sem;
+    pthread_mutex_lock(&s->mutex);
+    while (s->count == 0)
+        pthread_cond_wait(&s->cond, &s->mutex);
+    s->count--;
+    pthread_mutex_unlock(&s->mutex);
+} /* __PHYSFS_platformWaitSemaphore */
+
+
+void __PHYSFS_platformPostSemaphore(void *sem)
+{
+    PthreadSemaphore *s = (PthreadSemaphore *) sem;
+    pthread_mutex_lock(&s->mutex);
+    s->count++;
+    pthread_cond_signal(&s->cond);
+    pthread_mutex_unlock(&s->mutex);
+} /* __PHYSFS_platformPostSemaphore */
+
 #endif  /* PHYSFS_PLATFORM_POSIX */
 
 /* end of physfs_platform_posix.c ... */
@@ -163,6 +163,25 @@ void __PHYSFS_platformDetectAvailableCDs(PHYSFS_StringCallback cb, void *data)
 #endif
 } /* __PHYSFS_platformDetectAvailableCDs */
 
+
+void *__PHYSFS_platformWatchDir(const char *dir)
+{
+    BAIL(PHYSFS_ERR_UNSUPPORTED, NULL);
+} /* __PHYSFS_platformWatchDir */
+
+
+int __PHYSFS_platformPollWatch(void *watch, PHYSFS_StringCallback cb,
+                               void *data)
+{
+    return 0;  /* never gets a watch to poll. */
+} /* __PHYSFS_platformPollWatch */
+
+
+void __PHYSFS_platformUnwatchDir(void *watch)
+{
+    /* never handed one out. */
+} /* __PHYSFS_platformUnwatchDir */
+
 #endif /* PHYSFS_PLATFORM_QNX */
 
 /* end of physfs_platform_qnx.c ... */
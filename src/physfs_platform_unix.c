@@ -57,6 +57,11 @@
 #include <sys/sysctl.h>
 #endif
 
+#ifdef PHYSFS_PLATFORM_LINUX
+#include <fcntl.h>
+#include <sys/inotify.h>
+#endif
+
 
 #include "physfs_internal.h"
 
@@ -361,6 +366,400 @@ char *__PHYSFS_platformCalcPrefDir(const char *org, const char *app)
     return retval;
 } /* __PHYSFS_platformCalcPrefDir */
 
+
+#ifdef PHYSFS_PLATFORM_LINUX
+
+/*
+ * inotify only watches one directory at a time, so every directory under
+ *  the watched one gets a watch of its own, and new ones are added as they
+ *  show up.
+ */
+
+#define INOTIFY_MASK (IN_CREATE | IN_DELETE | IN_MODIFY | IN_ATTRIB | \
+                      IN_CLOSE_WRITE | IN_MOVED_FROM | IN_MOVED_TO | \
+                      IN_DELETE_SELF | IN_MOVE_SELF | IN_ONLYDIR)
+
+typedef struct
+{
+    int wd;  /* from inotify_add_watch(). */
+    char *path;  /* relative to the watched dir, "" for the dir itself. */
+} InotifyDir;
+
+typedef struct
+{
+    int fd;  /* from inotify_init1(). */
+    char *base;  /* the watched dir, ending with a '/'. */
+    InotifyDir *dirs;  /* sorted by (wd). */
+    size_t count;
+    size_t allocated;
+} InotifyWatch;
+
+typedef struct
+{
+    InotifyWatch *watch;
+    const char *prefix;  /* path of the dir being listed, "" for the base. */
+    PHYSFS_ErrorCode errcode;
+} InotifyTreeData;
+
+
+static PHYSFS_ErrorCode errcodeFromInotify(const int err)
+{
+    switch (err)
+    {
+        case ENOENT: return PHYSFS_ERR_NOT_FOUND;
+        case ENOTDIR: return PHYSFS_ERR_NOT_FOUND;
+        case EACCES: return PHYSFS_ERR_PERMISSION;
+        case ENOMEM: return PHYSFS_ERR_OUT_OF_MEMORY;
+        default: return PHYSFS_ERR_OS_ERROR;  /* out of watches, etc. */
+    } /* switch */
+} /* errcodeFromInotify */
+
+
+/* Binary search for (wd). (*pos) is where it is, or where it would go. */
+static InotifyDir *findInotifyDir(InotifyWatch *w, const int wd, size_t *pos)
+{
+    size_t lo = 0;
+    size_t hi = w->count;
+
+    while (lo < hi)
+    {
+        const size_t middle = lo + ((hi - lo) / 2);
+        const int thiswd = w->dirs[middle].wd;
+        if (thiswd == wd)
+        {
+            *pos = middle;
+            return &w->dirs[middle];
+        } /* if */
+        else if (thiswd < wd)
+            lo = middle + 1;
+        else
+            hi = middle;
+    } /* while */
+
+    *pos = lo;
+    return NULL;
+} /* findInotifyDir */
+
+
+/* Start watching (path), but not the dirs in it. */
+static int addInotifyDir(InotifyWatch *w, const char *path)
+{
+    const size_t len = strlen(w->base) + strlen(path) + 1;
+    char *fullpath = (char *) __PHYSFS_smallAlloc(len);
+    char *dup = (char *) allocator.Malloc(strlen(path) + 1);
+    InotifyDir *dir;
+    size_t pos;
+    int wd;
+
+    if ((!fullpath) || (!dup))
+    {
+        __PHYSFS_smallFree(fullpath);
+        if (dup)
+            allocator.Free(dup);
+        BAIL(PHYSFS_ERR_OUT_OF_MEMORY, 0);
+    } /* if */
+
+    strcpy(dup, path);
+    snprintf(fullpath, len, "%s%s", w->base, path);
+    /* the watched dir itself can be a symlink; anything under it, not. */
+    wd = inotify_add_watch(w->fd, fullpath,
+                           INOTIFY_MASK | (*path ? IN_DONT_FOLLOW : 0));
+    __PHYSFS_smallFree(fullpath);
+    if (wd == -1)
+    {
+        const int err = errno;
+        allocator.Free(dup);
+        BAIL(errcodeFromInotify(err), 0);
+    } /* if */
+
+    dir = findInotifyDir(w, wd, &pos);
+    if (dir != NULL)  /* already watching it; it might have been renamed. */
+    {
+        allocator.Free(dir->path);
+        dir->path = dup;
+        return 1;
+    } /* if */
+
+    if (w->count >= w->allocated)
+    {
+        const size_t newalloc = w->allocated ? w->allocated * 2 : 16;
+        void *ptr = allocator.Realloc(w->dirs, newalloc * sizeof (InotifyDir));
+        if (!ptr)
+        {
+            inotify_rm_watch(w->fd, wd);
+            allocator.Free(dup);
+            BAIL(PHYSFS_ERR_OUT_OF_MEMORY, 0);
+        } /* if */
+        w->dirs = (InotifyDir *) ptr;
+        w->allocated = newalloc;
+    } /* if */
+
+    memmove(&w->dirs[pos + 1], &w->dirs[pos],
+            (w->count - pos) * sizeof (InotifyDir));
+    w->dirs[pos].wd = wd;
+    w->dirs[pos].path = dup;
+    w->count++;
+    return 1;
+} /* addInotifyDir */
+
+
+static int addInotifyTree(InotifyWatch *w, const char *path);
+
+static PHYSFS_EnumerateCallbackResult addInotifyTreeCallback(void *_data,
+                                     const char *origdir, const char *fname,
+                                     const PHYSFS_Stat *stat)
+{
+    InotifyTreeData *data = (InotifyTreeData *) _data;
+    const size_t prefixlen = strlen(data->prefix);
+    const size_t len = prefixlen + strlen(fname) + 2;
+    char *path;
+    int rc;
+
+    if (stat->filetype != PHYSFS_FILETYPE_DIRECTORY)
+        return PHYSFS_ENUM_OK;
+
+    path = (char *) __PHYSFS_smallAlloc(len);
+    if (!path)
+    {
+        data->errcode = PHYSFS_ERR_OUT_OF_MEMORY;
+        return PHYSFS_ENUM_ERROR;
+    } /* if */
+
+    snprintf(path, len, "%s%s%s", data->prefix, prefixlen ? "/" : "", fname);
+    rc = addInotifyTree(data->watch, path);
+    __PHYSFS_smallFree(path);
+
+    if (!rc)
+    {
+        data->errcode = PHYSFS_getLastErrorCode();
+        return PHYSFS_ENUM_ERROR;
+    } /* if */
+
+    return PHYSFS_ENUM_OK;
+} /* addInotifyTreeCallback */
+
+
+/* Start watching (path), and every dir under it. */
+static int addInotifyTree(InotifyWatch *w, const char *path)
+{
+    const size_t len = strlen(w->base) + strlen(path) + 1;
+    PHYSFS_EnumerateCallbackResult rc;
+    InotifyTreeData data;
+    char *fullpath;
+
+    BAIL_IF_ERRPASS(!addInotifyDir(w, path), 0);
+
+    fullpath = (char *) __PHYSFS_smallAlloc(len);
+    BAIL_IF(!fullpath, PHYSFS_ERR_OUT_OF_MEMORY, 0);
+    snprintf(fullpath, len, "%s%s", w->base, path);
+    data.watch = w;
+    data.prefix = path;
+    data.errcode = PHYSFS_ERR_OK;
+    rc = __PHYSFS_platformEnumerateWithStat(fullpath, addInotifyTreeCallback,
+                                            "", &data);
+    __PHYSFS_smallFree(fullpath);
+
+    if (rc == PHYSFS_ENUM_ERROR)
+    {
+        BAIL_IF(data.errcode != PHYSFS_ERR_OK, data.errcode, 0);
+        BAIL_ERRPASS(0);
+    } /* if */
+
+    return 1;
+} /* addInotifyTree */
+
+
+/* (path) went away, or moved; stop watching it and everything under it. */
+static void removeInotifyTree(InotifyWatch *w, const char *path)
+{
+    const size_t len = strlen(path);
+    size_t i = 0;
+
+    while (i < w->count)
+    {
+        const char *dirpath = w->dirs[i].path;
+        if ((strncmp(dirpath, path, len) == 0) &&
+            ((dirpath[len] == '\0') || (dirpath[len] == '/')))
+        {
+            inotify_rm_watch(w->fd, w->dirs[i].wd);  /* might be gone. */
+            allocator.Free(w->dirs[i].path);
+            w->count--;
+            memmove(&w->dirs[i], &w->dirs[i + 1],
+                    (w->count - i) * sizeof (InotifyDir));
+        } /* if */
+        else
+        {
+            i++;
+        } /* else */
+    } /* while */
+} /* removeInotifyTree */
+
+
+/* Returns the number of times (cb) was called. */
+static int handleInotifyEvent(InotifyWatch *w, const struct inotify_event *e,
+                              PHYSFS_StringCallback cb, void *data)
+{
+    const InotifyDir *dir;
+    size_t len;
+    size_t pos;
+    char *path;
+
+    if (e->mask & IN_Q_OVERFLOW)
+    {
+        /* lost track; find any new dirs we missed, and give up on details. */
+        addInotifyTree(w, "");
+        cb(data, "");
+        return 1;
+    } /* if */
+
+    dir = findInotifyDir(w, e->wd, &pos);
+    if (dir == NULL)
+        return 0;  /* already stopped watching it. */
+
+    else if (e->mask & IN_IGNORED)  /* the kernel stopped watching it. */
+    {
+        allocator.Free(w->dirs[pos].path);
+        w->count--;
+        memmove(&w->dirs[pos], &w->dirs[pos + 1],
+                (w->count - pos) * sizeof (InotifyDir));
+        return 0;
+    } /* else if */
+
+    else if (e->mask & (IN_DELETE_SELF | IN_MOVE_SELF))
+    {
+        if (*dir->path != '\0')
+            return 0;  /* its parent reports this. */
+        cb(data, "");  /* the watched dir itself went away. */
+        return 1;
+    } /* else if */
+
+    else if (e->len == 0)
+        return 0;  /* something about a dir itself; its parent reports it. */
+
+    len = strlen(dir->path) + strlen(e->name) + 2;
+    path = (char *) __PHYSFS_smallAlloc(len);
+    BAIL_IF(!path, PHYSFS_ERR_OUT_OF_MEMORY, 0);
+    snprintf(path, len, "%s%s%s", dir->path, *dir->path ? "/" : "", e->name);
+
+    /* (dir) isn't safe to use after this. Failing to add just loses detail. */
+    if (e->mask & IN_ISDIR)
+    {
+        if (e->mask & (IN_DELETE | IN_MOVED_FROM))
+            removeInotifyTree(w, path);
+        else if (e->mask & (IN_CREATE | IN_MOVED_TO))
+            addInotifyTree(w, path);
+    } /* if */
+
+    cb(data, path);
+    __PHYSFS_smallFree(path);
+    return 1;
+} /* handleInotifyEvent */
+
+
+void *__PHYSFS_platformWatchDir(const char *dir)
+{
+    const size_t len = strlen(dir);
+    InotifyWatch *w;
+
+    w = (InotifyWatch *) allocator.Malloc(sizeof (InotifyWatch));
+    BAIL_IF(!w, PHYSFS_ERR_OUT_OF_MEMORY, NULL);
+    memset(w, '\0', sizeof (*w));
+    w->fd = -1;
+
+    w->base = (char *) allocator.Malloc(len + 2);
+    GOTO_IF(!w->base, PHYSFS_ERR_OUT_OF_MEMORY, watchDir_failed);
+    strcpy(w->base, dir);
+    if ((len == 0) || (dir[len - 1] != '/'))
+        strcat(w->base, "/");
+
+    w->fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    GOTO_IF(w->fd == -1, errcodeFromInotify(errno), watchDir_failed);
+    GOTO_IF_ERRPASS(!addInotifyTree(w, ""), watchDir_failed);
+    return w;
+
+watchDir_failed:
+    __PHYSFS_platformUnwatchDir(w);
+    return NULL;
+} /* __PHYSFS_platformWatchDir */
+
+
+int __PHYSFS_platformPollWatch(void *watch, PHYSFS_StringCallback cb,
+                               void *data)
+{
+    InotifyWatch *w = (InotifyWatch *) watch;
+    union
+    {
+        struct inotify_event event;  /* just to align (buf). */
+        char buf[4096];
+    } events;
+    int retval = 0;
+
+    while (1)
+    {
+        const ssize_t br = read(w->fd, events.buf, sizeof (events.buf));
+        ssize_t i;
+
+        if (br == -1)
+        {
+            if (errno == EINTR)
+                continue;
+            else if ((errno == EAGAIN) || (errno == EWOULDBLOCK))
+                break;  /* nothing else waiting. */
+            BAIL(errcodeFromInotify(errno), -1);
+        } /* if */
+
+        for (i = 0; i < br; )
+        {
+            const struct inotify_event *e;
+            e = (const struct inotify_event *) (events.buf + i);
+            i += sizeof (struct inotify_event) + e->len;
+            retval += handleInotifyEvent(w, e, cb, data);
+        } /* for */
+    } /* while */
+
+    return retval;
+} /* __PHYSFS_platformPollWatch */
+
+
+void __PHYSFS_platformUnwatchDir(void *watch)
+{
+    InotifyWatch *w = (InotifyWatch *) watch;
+    size_t i;
+
+    if (w->fd != -1)
+        close(w->fd);  /* drops all the watches, too. */
+    for (i = 0; i < w->count; i++)
+        allocator.Free(w->dirs[i].path);
+    if (w->dirs)
+        allocator.Free(w->dirs);
+    if (w->base)
+        allocator.Free(w->base);
+    allocator.Free(w);
+} /* __PHYSFS_platformUnwatchDir */
+
+#else
+
+/* !!! FIXME: kqueue could do this on the BSDs. */
+void *__PHYSFS_platformWatchDir(const char *dir)
+{
+    BAIL(PHYSFS_ERR_UNSUPPORTED, NULL);
+} /* __PHYSFS_platformWatchDir */
+
+
+int __PHYSFS_platformPollWatch(void *watch, PHYSFS_StringCallback cb,
+                               void *data)
+{
+    return 0;  /* never gets a watch to poll. */
+} /* __PHYSFS_platformPollWatch */
+
+
+void __PHYSFS_platformUnwatchDir(void *watch)
+{
+    /* never handed one out. */
+} /* __PHYSFS_platformUnwatchDir */
+
+#endif  /* PHYSFS_PLATFORM_LINUX */
+
 #endif /* PHYSFS_PLATFORM_UNIX */
 
 /* end of physfs_platform_unix.c ... */
@@ -623,8 +623,29 @@ void *__PHYSFS_platformGetThreadID(void)
 } /* __PHYSFS_platformGetThreadID */
 
 
-PHYSFS_EnumerateCallbackResult __PHYSFS_platformEnumerate(const char *dirname,
+PHYSFS_uint64 __PHYSFS_platformNanoseconds(void)
+{
+    LARGE_INTEGER freq, now;
+    PHYSFS_uint64 secs;
+
+    /* these can't fail on XP and later, but just in case... */
+    if (!QueryPerformanceFrequency(&freq) || !QueryPerformanceCounter(&now))
+        return 0;
+
+    /* split it up, so big counts don't overflow on the multiply. */
+    secs = (PHYSFS_uint64) (now.QuadPart / freq.QuadPart);
+    return (secs * __PHYSFS_UI64(1000000000)) +
+           ((((PHYSFS_uint64) (now.QuadPart % freq.QuadPart)) *
+             __PHYSFS_UI64(1000000000)) / ((PHYSFS_uint64) freq.QuadPart));
+} /* __PHYSFS_platformNanoseconds */
+
+
+static void statFromFindData(const WIN32_FIND_DATAW *entw, PHYSFS_Stat *st);
+
+/* (statcallback) is NULL unless the caller wants to know about each item. */
+static PHYSFS_EnumerateCallbackResult doEnumerate(const char *dirname,
                                PHYSFS_EnumerateCallback callback,
+                               PHYSFS_EnumerateStatCallback statcallback,
                                const char *origdir, void *callbackdata)
 {
     PHYSFS_EnumerateCallbackResult retval = PHYSFS_ENUM_OK;
@@ -675,7 +696,15 @@ PHYSFS_EnumerateCallbackResult __PHYSFS_platformEnumerate(const char *dirname,
             retval = -1;
         else
         {
-            retval = callback(callbackdata, origdir, utf8);
+            if (statcallback == NULL)
+                retval = callback(callbackdata, origdir, utf8);
+            else
+            {
+                /* the find data already has everything; no need to ask. */
+                PHYSFS_Stat st;
+                statFromFindData(&entw, &st);
+                retval = statcallback(callbackdata, origdir, utf8, &st);
+            } /* else */
             allocator.Free(utf8);
             if (retval == PHYSFS_ENUM_ERROR)
                 PHYSFS_setErrorCode(PHYSFS_ERR_APP_CALLBACK);
@@ -685,9 +714,26 @@ PHYSFS_EnumerateCallbackResult __PHYSFS_platformEnumerate(const char *dirname,
     FindClose(dir);
 
     return retval;
+} /* doEnumerate */
+
+
+PHYSFS_EnumerateCallbackResult __PHYSFS_platformEnumerate(const char *dirname,
+                               PHYSFS_EnumerateCallback callback,
+                               const char *origdir, void *callbackdata)
+{
+    return doEnumerate(dirname, callback, NULL, origdir, callbackdata);
 } /* __PHYSFS_platformEnumerate */
 
 
+PHYSFS_EnumerateCallbackResult __PHYSFS_platformEnumerateWithStat(
+                               const char *dirname,
+                               PHYSFS_EnumerateStatCallback callback,
+                               const char *origdir, void *callbackdata)
+{
+    return doEnumerate(dirname, NULL, callback, origdir, callbackdata);
+} /* __PHYSFS_platformEnumerateWithStat */
+
+
 int __PHYSFS_platformMkDir(const char *path)
 {
     WCHAR *wpath;
@@ -772,6 +818,205 @@ PHYSFS_sint64 __PHYSFS_platformRead(void *opaque, void *buf, PHYSFS_uint64 len)
 } /* __PHYSFS_platformRead */
 
 
+PHYSFS_sint64 __PHYSFS_platformReadAt(void *opaque, PHYSFS_uint64 pos,
+                                      void *buf, PHYSFS_uint64 len)
+{
+    HANDLE h = (HANDLE) opaque;
+    PHYSFS_uint8 *ptr = (PHYSFS_uint8 *) buf;
+    PHYSFS_sint64 totalRead = 0;
+
+    if (!__PHYSFS_ui64FitsAddressSpace(len))
+        BAIL(PHYSFS_ERR_INVALID_ARGUMENT, -1);
+
+    /* an OVERLAPPED offset makes this positional, even on a sync handle. */
+    while (len > 0)
+    {
+        const DWORD thislen = (len > 0xFFFFFFFF) ? 0xFFFFFFFF : (DWORD) len;
+        DWORD numRead = 0;
+        OVERLAPPED ov;
+
+        memset(&ov, '\0', sizeof (ov));
+        ov.Offset = (DWORD) (pos & 0xFFFFFFFF);
+        ov.OffsetHigh = (DWORD) (pos >> 32);
+        if (!ReadFile(h, ptr, thislen, &numRead, &ov))
+        {
+            const DWORD err = GetLastError();
+            if (err == ERROR_HANDLE_EOF)
+                break;
+            BAIL(errcodeFromWinApiError(err), (totalRead > 0) ? totalRead : -1);
+        } /* if */
+
+        len -= (PHYSFS_uint64) numRead;
+        pos += (PHYSFS_uint64) numRead;
+        ptr += numRead;
+        totalRead += (PHYSFS_sint64) numRead;
+        if (numRead != thislen)
+            break;
+    } /* while */
+
+    return totalRead;
+} /* __PHYSFS_platformReadAt */
+
+
+#ifdef PHYSFS_PLATFORM_WINRT
+void __PHYSFS_platformReadAtBatch(__PHYSFS_PlatformRead *reads,
+                                  PHYSFS_uint32 count)
+{
+    /* !!! FIXME: CreateFile2() can do FILE_FLAG_OVERLAPPED, too. */
+    PHYSFS_uint32 i;
+    for (i = 0; i < count; i++)
+        reads[i].result = 0;
+    __PHYSFS_finishReadsAt(reads, count);
+} /* __PHYSFS_platformReadAtBatch */
+
+#else
+
+/*
+ * Our handles aren't opened for overlapped i/o, since everything else wants
+ *  them synchronous, so a batch reopens each one with FILE_FLAG_OVERLAPPED
+ *  (ReOpenFile() showed up in Vista) and keeps up to this many reads going
+ *  at once, each with its own event.
+ */
+#define WIN_BATCH_INFLIGHT 64
+
+typedef HANDLE (WINAPI *fnReOpenFile)(HANDLE, DWORD, DWORD, DWORD);
+
+typedef struct
+{
+    HANDLE file;  /* overlapped handle, or INVALID_HANDLE_VALUE. */
+    int ownsFile;  /* zero if borrowed from the read before this one. */
+    int started;
+    DWORD asked;
+    OVERLAPPED ov;
+} WinBatchRead;
+
+/* Reads this couldn't do get (error) set to PHYSFS_ERR_IO; see below. */
+static void winReadBatchChunk(fnReOpenFile reopen, WinBatchRead *w,
+                              __PHYSFS_PlatformRead *reads,
+                              const PHYSFS_uint32 count)
+{
+    const DWORD share = FILE_SHARE_READ | FILE_SHARE_WRITE;
+    PHYSFS_uint32 i;
+
+    for (i = 0; i < count; i++)
+    {
+        __PHYSFS_PlatformRead *r = &reads[i];
+        w[i].file = INVALID_HANDLE_VALUE;
+        w[i].ownsFile = 0;
+        w[i].started = 0;
+        r->result = 0;
+        r->error = PHYSFS_ERR_OK;
+
+        if (r->len == 0)
+            continue;
+        else if ((i > 0) && (reads[i-1].opaque == r->opaque))
+            w[i].file = w[i-1].file;  /* might be invalid; that's fine. */
+        else
+        {
+            w[i].file = reopen((HANDLE) r->opaque, GENERIC_READ, share,
+                               FILE_FLAG_OVERLAPPED);
+            w[i].ownsFile = 1;
+        } /* else */
+
+        if (w[i].file == INVALID_HANDLE_VALUE)
+        {
+            r->error = PHYSFS_ERR_IO;
+            continue;
+        } /* if */
+
+        memset(&w[i].ov, '\0', sizeof (OVERLAPPED));
+        w[i].ov.Offset = (DWORD) (r->pos & 0xFFFFFFFF);
+        w[i].ov.OffsetHigh = (DWORD) (r->pos >> 32);
+        w[i].ov.hEvent = CreateEventW(NULL, TRUE, FALSE, NULL);
+        if (w[i].ov.hEvent == NULL)
+        {
+            r->error = PHYSFS_ERR_IO;
+            continue;
+        } /* if */
+
+        w[i].asked = (r->len > 0xFFFFFFFF) ? 0xFFFFFFFF : (DWORD) r->len;
+        if (ReadFile(w[i].file, r->buffer, w[i].asked, NULL, &w[i].ov))
+            w[i].started = 1;  /* done already, but collect it below. */
+        else
+        {
+            const DWORD err = GetLastError();
+            if (err == ERROR_IO_PENDING)
+                w[i].started = 1;
+            else
+            {
+                if (err != ERROR_HANDLE_EOF)
+                    r->error = PHYSFS_ERR_IO;
+                CloseHandle(w[i].ov.hEvent);
+            } /* else */
+        } /* else */
+    } /* for */
+
+    for (i = 0; i < count; i++)
+    {
+        __PHYSFS_PlatformRead *r = &reads[i];
+        if (w[i].started)
+        {
+            DWORD got = 0;
+            if (GetOverlappedResult(w[i].file, &w[i].ov, &got, TRUE))
+            {
+                r->result = (PHYSFS_sint64) got;
+                /* a short read is EOF; a full one might need more. */
+                if ((got == w[i].asked) && (((PHYSFS_uint64) got) < r->len))
+                    r->error = PHYSFS_ERR_IO;
+            } /* if */
+            else if (GetLastError() != ERROR_HANDLE_EOF)
+            {
+                r->error = PHYSFS_ERR_IO;
+            } /* else if */
+            CloseHandle(w[i].ov.hEvent);
+        } /* if */
+    } /* for */
+
+    for (i = 0; i < count; i++)
+    {
+        if ((w[i].ownsFile) && (w[i].file != INVALID_HANDLE_VALUE))
+            CloseHandle(w[i].file);
+    } /* for */
+} /* winReadBatchChunk */
+
+
+void __PHYSFS_platformReadAtBatch(__PHYSFS_PlatformRead *reads,
+                                  PHYSFS_uint32 count)
+{
+    HMODULE lib = GetModuleHandleA("kernel32.dll");
+    fnReOpenFile reopen = NULL;
+    WinBatchRead w[WIN_BATCH_INFLIGHT];
+    PHYSFS_uint32 i;
+
+    if ((lib) && (count > 1))
+        reopen = (fnReOpenFile) GetProcAddress(lib, "ReOpenFile");
+
+    if (!reopen)  /* Windows XP or a single read: just do it directly. */
+    {
+        for (i = 0; i < count; i++)
+            reads[i].result = 0;
+        __PHYSFS_finishReadsAt(reads, count);
+        return;
+    } /* if */
+
+    for (i = 0; i < count; i += WIN_BATCH_INFLIGHT)
+    {
+        const PHYSFS_uint32 total = count - i;
+        const PHYSFS_uint32 num = (total < WIN_BATCH_INFLIGHT) ?
+                                    total : WIN_BATCH_INFLIGHT;
+        winReadBatchChunk(reopen, w, &reads[i], num);
+    } /* for */
+
+    /* mop up whatever overlapped i/o couldn't do by itself. */
+    for (i = 0; i < count; i++)
+    {
+        if (reads[i].error != PHYSFS_ERR_OK)
+            __PHYSFS_finishReadsAt(&reads[i], 1);
+    } /* for */
+} /* __PHYSFS_platformReadAtBatch */
+#endif
+
+
 PHYSFS_sint64 __PHYSFS_platformWrite(void *opaque, const void *buffer,
                                      PHYSFS_uint64 len)
 {
@@ -839,6 +1084,48 @@ void __PHYSFS_platformClose(void *opaque)
 } /* __PHYSFS_platformClose */
 
 
+void *__PHYSFS_platformMapFile(void *opaque, const void **ptr,
+                               PHYSFS_uint64 *len)
+{
+    HANDLE h = (HANDLE) opaque;
+    const PHYSFS_sint64 filelen = winGetFileSize(h);
+    HANDLE mapping;
+    void *retval;
+
+    BAIL_IF(filelen < 0, errcodeFromWinApi(), NULL);
+    BAIL_IF(filelen == 0, PHYSFS_ERR_UNSUPPORTED, NULL);
+    BAIL_IF(!__PHYSFS_ui64FitsAddressSpace((PHYSFS_uint64) filelen),
+            PHYSFS_ERR_UNSUPPORTED, NULL);
+
+    #ifdef PHYSFS_PLATFORM_WINRT
+    mapping = CreateFileMappingFromApp(h, NULL, PAGE_READONLY, 0, NULL);
+    #else
+    mapping = CreateFileMappingW(h, NULL, PAGE_READONLY, 0, 0, NULL);
+    #endif
+    BAIL_IF(mapping == NULL, errcodeFromWinApi(), NULL);
+
+    #ifdef PHYSFS_PLATFORM_WINRT
+    retval = MapViewOfFileFromApp(mapping, FILE_MAP_READ, 0, 0);
+    #else
+    retval = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    #endif
+
+    /* the view keeps the mapping (and the file) alive without this. */
+    CloseHandle(mapping);
+    BAIL_IF(retval == NULL, errcodeFromWinApi(), NULL);
+
+    *ptr = retval;
+    *len = (PHYSFS_uint64) filelen;
+    return retval;
+} /* __PHYSFS_platformMapFile */
+
+
+void __PHYSFS_platformUnmapFile(void *mapping)
+{
+    (void) UnmapViewOfFile(mapping);
+} /* __PHYSFS_platformUnmapFile */
+
+
 static int doPlatformDelete(LPWSTR wpath)
 {
     WIN32_FILE_ATTRIBUTE_DATA info;
@@ -866,6 +1153,29 @@ int __PHYSFS_platformDelete(const char *path)
 } /* __PHYSFS_platformDelete */
 
 
+int __PHYSFS_platformRename(const char *src, const char *dst)
+{
+    int retval = 0;
+    LPWSTR wsrc = NULL;
+    LPWSTR wdst = NULL;
+    UTF8_TO_UNICODE_STACK(wsrc, src);
+    BAIL_IF(!wsrc, PHYSFS_ERR_OUT_OF_MEMORY, 0);
+    UTF8_TO_UNICODE_STACK(wdst, dst);
+    GOTO_IF(!wdst, PHYSFS_ERR_OUT_OF_MEMORY, done);
+
+    /* WRITE_THROUGH: don't come back until the rename itself is on disk. */
+    if (!MoveFileExW(wsrc, wdst, MOVEFILE_REPLACE_EXISTING |
+                                 MOVEFILE_WRITE_THROUGH))
+        GOTO(errcodeFromWinApi(), done);
+    retval = 1;
+
+done:
+    __PHYSFS_smallFree(wdst);
+    __PHYSFS_smallFree(wsrc);
+    return retval;
+} /* __PHYSFS_platformRename */
+
+
 void *__PHYSFS_platformCreateMutex(void)
 {
     LPCRITICAL_SECTION lpcs;
@@ -902,6 +1212,426 @@ void __PHYSFS_platformReleaseMutex(void *mutex)
 } /* __PHYSFS_platformReleaseMutex */
 
 
+/*
+ * Readers share a semaphore that writers take alone: the first reader in
+ *  takes it on behalf of all of them, and the last one out gives it back.
+ *  New readers only wait when a writer actually has it, so a thread that
+ *  already holds the lock shared can grab it again without deadlocking.
+ */
+typedef struct
+{
+    CRITICAL_SECTION readerLock;  /* protects (readers). */
+    HANDLE writerSem;             /* held by a writer, or by all readers. */
+    PHYSFS_uint32 readers;        /* outstanding shared grabs. */
+    DWORD owner;                  /* thread holding it exclusively. */
+    PHYSFS_uint32 count;          /* exclusive recursion count. */
+} WinRWLock;
+
+void *__PHYSFS_platformCreateRWLock(void)
+{
+    WinRWLock *l = (WinRWLock *) allocator.Malloc(sizeof (WinRWLock));
+    BAIL_IF(!l, PHYSFS_ERR_OUT_OF_MEMORY, NULL);
+
+    if (!winInitializeCriticalSection(&l->readerLock))
+    {
+        allocator.Free(l);
+        BAIL(errcodeFromWinApi(), NULL);
+    } /* if */
+
+    #ifdef PHYSFS_PLATFORM_WINRT
+    l->writerSem = CreateSemaphoreExW(NULL, 1, 1, NULL, 0,
+                                      SEMAPHORE_ALL_ACCESS);
+    #else
+    l->writerSem = CreateSemaphoreW(NULL, 1, 1, NULL);
+    #endif
+
+    if (l->writerSem == NULL)
+    {
+        const PHYSFS_ErrorCode err = errcodeFromWinApi();
+        DeleteCriticalSection(&l->readerLock);
+        allocator.Free(l);
+        BAIL(err, NULL);
+    } /* if */
+
+    l->readers = 0;
+    l->owner = 0;  /* zero is never a valid thread id. */
+    l->count = 0;
+    return l;
+} /* __PHYSFS_platformCreateRWLock */
+
+
+void __PHYSFS_platformDestroyRWLock(void *rwlock)
+{
+    WinRWLock *l = (WinRWLock *) rwlock;
+    CloseHandle(l->writerSem);
+    DeleteCriticalSection(&l->readerLock);
+    allocator.Free(l);
+} /* __PHYSFS_platformDestroyRWLock */
+
+
+int __PHYSFS_platformGrabRWLockShared(void *rwlock)
+{
+    WinRWLock *l = (WinRWLock *) rwlock;
+    int retval = 1;
+
+    if (l->owner == GetCurrentThreadId())  /* we hold it exclusively. */
+    {
+        l->count++;
+        return 1;
+    } /* if */
+
+    EnterCriticalSection(&l->readerLock);
+    if (++l->readers == 1)  /* first reader in takes it for everyone. */
+    {
+        DWORD rc = WaitForSingleObjectEx(l->writerSem, 0, FALSE);
+        if (rc == WAIT_TIMEOUT)  /* a writer has it; note how long we wait. */
+        {
+            const PHYSFS_uint64 start = __PHYSFS_STAT_NOW();
+            rc = WaitForSingleObjectEx(l->writerSem, INFINITE, FALSE);
+            __PHYSFS_STAT_LOCK_WAITED(start);
+        } /* if */
+
+        if (rc != WAIT_OBJECT_0)
+        {
+            l->readers--;
+            retval = 0;
+        } /* if */
+    } /* if */
+    LeaveCriticalSection(&l->readerLock);
+
+    return retval;
+} /* __PHYSFS_platformGrabRWLockShared */
+
+
+int __PHYSFS_platformGrabRWLockExclusive(void *rwlock)
+{
+    WinRWLock *l = (WinRWLock *) rwlock;
+    const DWORD tid = GetCurrentThreadId();
+
+    if (l->owner != tid)
+    {
+        DWORD rc = WaitForSingleObjectEx(l->writerSem, 0, FALSE);
+        if (rc == WAIT_TIMEOUT)  /* someone has it; note how long we wait. */
+        {
+            const PHYSFS_uint64 start = __PHYSFS_STAT_NOW();
+            rc = WaitForSingleObjectEx(l->writerSem, INFINITE, FALSE);
+            __PHYSFS_STAT_LOCK_WAITED(start);
+        } /* if */
+
+        if (rc != WAIT_OBJECT_0)
+            return 0;
+        l->owner = tid;
+    } /* if */
+
+    l->count++;
+    return 1;
+} /* __PHYSFS_platformGrabRWLockExclusive */
+
+
+void __PHYSFS_platformReleaseRWLock(void *rwlock)
+{
+    WinRWLock *l = (WinRWLock *) rwlock;
+
+    if (l->owner == GetCurrentThreadId())
+    {
+        assert(l->count > 0);  /* catch programming errors. */
+        if (--l->count == 0)
+        {
+            l->owner = 0;
+            ReleaseSemaphore(l->writerSem, 1, NULL);
+        } /* if */
+    } /* if */
+
+    else
+    {
+        EnterCriticalSection(&l->readerLock);
+        assert(l->readers > 0);  /* catch programming errors. */
+        if (--l->readers == 0)
+            ReleaseSemaphore(l->writerSem, 1, NULL);
+        LeaveCriticalSection(&l->readerLock);
+    } /* else */
+} /* __PHYSFS_platformReleaseRWLock */
+
+
+typedef struct
+{
+    HANDLE thread;
+    void (*fn)(void *);
+    void *arg;
+} WinThread;
+
+static DWORD WINAPI winThreadEntry(LPVOID _t)
+{
+    WinThread *t = (WinThread *) _t;
+    t->fn(t->arg);
+    return 0;
+} /* winThreadEntry */
+
+
+void *__PHYSFS_platformCreateThread(void (*fn)(void *), void *arg)
+{
+    #ifdef PHYSFS_PLATFORM_WINRT
+    return NULL;  /* !!! FIXME: use the thread pool APIs here. */
+    #else
+    WinThread *t = (WinThread *) allocator.Malloc(sizeof (*t));
+    if (t == NULL)
+        return NULL;
+
+    t->fn = fn;
+    t->arg = arg;
+    t->thread = CreateThread(NULL, 0, winThreadEntry, t, 0, NULL);
+    if (t->thread == NULL)
+    {
+        allocator.Free(t);
+        return NULL;
+    } /* if */
+
+    return t;
+    #endif
+} /* __PHYSFS_platformCreateThread */
+
+
+void __PHYSFS_platformJoinThread(void *thread)
+{
+    WinThread *t = (WinThread *) thread;
+    WaitForSingleObjectEx(t->thread, INFINITE, FALSE);
+    CloseHandle(t->thread);
+    allocator.Free(t);
+} /* __PHYSFS_platformJoinThread */
+
+
+void *__PHYSFS_platformCreateSemaphore(void)
+{
+    #ifdef PHYSFS_PLATFORM_WINRT
+    return (void *) CreateSemaphoreExW(NULL, 0, 0x7FFFFFFF, NULL, 0,
+                                       SEMAPHORE_ALL_ACCESS);
+    #else
+    return (void *) CreateSemaphoreW(NULL, 0, 0x7FFFFFFF, NULL);
+    #endif
+} /* __PHYSFS_platformCreateSemaphore */
+
+
+void __PHYSFS_platformDestroySemaphore(void *sem)
+{
+    CloseHandle((HANDLE) sem);
+} /* __PHYSFS_platformDestroySemaphore */
+
+
+void __PHYSFS_platformWaitSemaphore(void *sem)
+{
+    WaitForSingleObjectEx((HANDLE) sem, INFINITE, FALSE);
+} /* __PHYSFS_platformWaitSemaphore */
+
+
+void __PHYSFS_platformPostSemaphore(void *sem)
+{
+    ReleaseSemaphore((HANDLE) sem, 1, NULL);
+} /* __PHYSFS_platformPostSemaphore */
+
+
+#ifdef PHYSFS_PLATFORM_WINRT
+
+/* !!! FIXME: Windows.Storage.Search can do this, from C++. */
+void *__PHYSFS_platformWatchDir(const char *dir)
+{
+    BAIL(PHYSFS_ERR_UNSUPPORTED, NULL);
+} /* __PHYSFS_platformWatchDir */
+
+
+int __PHYSFS_platformPollWatch(void *watch, PHYSFS_StringCallback cb,
+                               void *data)
+{
+    return 0;  /* never gets a watch to poll. */
+} /* __PHYSFS_platformPollWatch */
+
+
+void __PHYSFS_platformUnwatchDir(void *watch)
+{
+    /* never handed one out. */
+} /* __PHYSFS_platformUnwatchDir */
+
+#else
+
+#ifndef ERROR_NOTIFY_ENUM_DIR
+#define ERROR_NOTIFY_ENUM_DIR 1022
+#endif
+
+#define WINWATCH_FILTER (FILE_NOTIFY_CHANGE_FILE_NAME | \
+                         FILE_NOTIFY_CHANGE_DIR_NAME | \
+                         FILE_NOTIFY_CHANGE_ATTRIBUTES | \
+                         FILE_NOTIFY_CHANGE_SIZE | \
+                         FILE_NOTIFY_CHANGE_LAST_WRITE | \
+                         FILE_NOTIFY_CHANGE_CREATION)
+
+/*
+ * One ReadDirectoryChangesW() is always in flight, and polling just asks if
+ *  it finished. Between calls, the OS keeps a buffer of its own, so nothing
+ *  is lost unless that overflows.
+ */
+typedef struct
+{
+    HANDLE dir;  /* opened with FILE_FLAG_OVERLAPPED. */
+    HANDLE event;  /* signaled when (overlapped) finishes. */
+    OVERLAPPED overlapped;
+    int pending;  /* non-zero while a ReadDirectoryChangesW() is running. */
+    DWORD buf[16 * 1024];  /* FILE_NOTIFY_INFORMATION wants DWORD alignment. */
+} WinWatch;
+
+
+static int startWinWatch(WinWatch *w)
+{
+    memset(&w->overlapped, '\0', sizeof (w->overlapped));
+    w->overlapped.hEvent = w->event;
+    BAIL_IF(!ReadDirectoryChangesW(w->dir, w->buf, sizeof (w->buf), TRUE,
+                                   WINWATCH_FILTER, NULL, &w->overlapped,
+                                   NULL), errcodeFromWinApi(), 0);
+    w->pending = 1;
+    return 1;
+} /* startWinWatch */
+
+
+/* (wname) isn't null-terminated. */
+static int reportWinWatchName(const WCHAR *wname, const DWORD wlen,
+                              PHYSFS_StringCallback cb, void *data)
+{
+    const size_t wbytes = (wlen + 1) * sizeof (WCHAR);
+    const size_t len = (wlen * 3) + 1;
+    WCHAR *wstr = (WCHAR *) __PHYSFS_smallAlloc(wbytes);
+    char *str = (char *) __PHYSFS_smallAlloc(len);
+    char *ptr;
+
+    if ((!wstr) || (!str))
+    {
+        __PHYSFS_smallFree(wstr);
+        __PHYSFS_smallFree(str);
+        BAIL(PHYSFS_ERR_OUT_OF_MEMORY, 0);
+    } /* if */
+
+    memcpy(wstr, wname, wlen * sizeof (WCHAR));
+    wstr[wlen] = 0;
+    PHYSFS_utf8FromUtf16((const PHYSFS_uint16 *) wstr, str, len);
+    for (ptr = strchr(str, '\\'); ptr != NULL; ptr = strchr(ptr + 1, '\\'))
+        *ptr = '/';
+
+    cb(data, str);
+    __PHYSFS_smallFree(str);
+    __PHYSFS_smallFree(wstr);
+    return 1;
+} /* reportWinWatchName */
+
+
+void *__PHYSFS_platformWatchDir(const char *dir)
+{
+    const DWORD share = FILE_SHARE_READ|FILE_SHARE_WRITE|FILE_SHARE_DELETE;
+    WCHAR *wstr = NULL;
+    WinWatch *w;
+    DWORD err;
+
+    w = (WinWatch *) allocator.Malloc(sizeof (WinWatch));
+    BAIL_IF(!w, PHYSFS_ERR_OUT_OF_MEMORY, NULL);
+    memset(w, '\0', sizeof (*w));
+
+    UTF8_TO_UNICODE_STACK(wstr, dir);
+    if (!wstr)
+    {
+        allocator.Free(w);
+        BAIL(PHYSFS_ERR_OUT_OF_MEMORY, NULL);
+    } /* if */
+
+    w->dir = CreateFileW(wstr, FILE_LIST_DIRECTORY, share, NULL,
+                         OPEN_EXISTING,
+                         FILE_FLAG_BACKUP_SEMANTICS | FILE_FLAG_OVERLAPPED,
+                         NULL);
+    err = GetLastError();
+    __PHYSFS_smallFree(wstr);
+    if (w->dir == INVALID_HANDLE_VALUE)
+    {
+        allocator.Free(w);
+        BAIL(errcodeFromWinApiError(err), NULL);
+    } /* if */
+
+    w->event = CreateEventW(NULL, TRUE, FALSE, NULL);
+    GOTO_IF(!w->event, errcodeFromWinApi(), watchDir_failed);
+    GOTO_IF_ERRPASS(!startWinWatch(w), watchDir_failed);
+    return w;
+
+watchDir_failed:
+    __PHYSFS_platformUnwatchDir(w);
+    return NULL;
+} /* __PHYSFS_platformWatchDir */
+
+
+int __PHYSFS_platformPollWatch(void *watch, PHYSFS_StringCallback cb,
+                               void *data)
+{
+    WinWatch *w = (WinWatch *) watch;
+    int retval = 0;
+    DWORD br = 0;
+
+    while (1)
+    {
+        if (!w->pending)
+            BAIL_IF_ERRPASS(!startWinWatch(w), -1);
+
+        if (!GetOverlappedResult(w->dir, &w->overlapped, &br, FALSE))
+        {
+            const DWORD err = GetLastError();
+            if (err == ERROR_IO_INCOMPLETE)
+                break;  /* nothing new yet. */
+
+            w->pending = 0;
+            BAIL_IF(err != ERROR_NOTIFY_ENUM_DIR,
+                    errcodeFromWinApiError(err), -1);
+            br = 0;  /* too much happened; fall through to report that. */
+        } /* if */
+
+        w->pending = 0;
+        if (br == 0)  /* the OS's buffer overflowed, so it gave up. */
+        {
+            cb(data, "");
+            retval++;
+        } /* if */
+        else
+        {
+            const PHYSFS_uint8 *ptr = (const PHYSFS_uint8 *) w->buf;
+            while (1)
+            {
+                const FILE_NOTIFY_INFORMATION *info;
+                info = (const FILE_NOTIFY_INFORMATION *) ptr;
+                retval += reportWinWatchName(info->FileName,
+                                   info->FileNameLength / sizeof (WCHAR),
+                                   cb, data);
+                if (info->NextEntryOffset == 0)
+                    break;
+                ptr += info->NextEntryOffset;
+            } /* while */
+        } /* else */
+    } /* while */
+
+    return retval;
+} /* __PHYSFS_platformPollWatch */
+
+
+void __PHYSFS_platformUnwatchDir(void *watch)
+{
+    WinWatch *w = (WinWatch *) watch;
+    DWORD br;
+
+    if (w->pending)  /* can't free (buf) until the OS is done with it. */
+    {
+        CancelIo(w->dir);
+        GetOverlappedResult(w->dir, &w->overlapped, &br, TRUE);
+    } /* if */
+
+    if (w->event)
+        CloseHandle(w->event);
+    CloseHandle(w->dir);
+    allocator.Free(w);
+} /* __PHYSFS_platformUnwatchDir */
+
+#endif  /* PHYSFS_PLATFORM_WINRT */
+
+
 static PHYSFS_sint64 FileTimeToPhysfsTime(const FILETIME *ft)
 {
     SYSTEMTIME st_utc;
@@ -960,6 +1690,45 @@ static int isSymlink(const WCHAR *wpath, const DWORD attr)
 } /* isSymlink */
 
 
+/* Same as __PHYSFS_platformStat(path, st, 0) would say, from find data. */
+static void statFromFindData(const WIN32_FIND_DATAW *entw, PHYSFS_Stat *st)
+{
+    const DWORD attr = entw->dwFileAttributes;
+
+    st->modtime = FileTimeToPhysfsTime(&entw->ftLastWriteTime);
+    st->accesstime = FileTimeToPhysfsTime(&entw->ftLastAccessTime);
+    st->createtime = FileTimeToPhysfsTime(&entw->ftCreationTime);
+
+    /* for reparse points, dwReserved0 is the tag, like isSymlink() checks. */
+    if ( (attr & PHYSFS_FILE_ATTRIBUTE_REPARSE_POINT) &&
+         (entw->dwReserved0 == PHYSFS_IO_REPARSE_TAG_SYMLINK) )
+    {
+        st->filetype = PHYSFS_FILETYPE_SYMLINK;
+        st->filesize = 0;
+    } /* if */
+
+    else if (attr & FILE_ATTRIBUTE_DIRECTORY)
+    {
+        st->filetype = PHYSFS_FILETYPE_DIRECTORY;
+        st->filesize = 0;
+    } /* else if */
+
+    else if (attr & (FILE_ATTRIBUTE_OFFLINE | FILE_ATTRIBUTE_DEVICE))
+    {
+        st->filetype = PHYSFS_FILETYPE_OTHER;
+        st->filesize = (((PHYSFS_uint64) entw->nFileSizeHigh) << 32) | entw->nFileSizeLow;
+    } /* else if */
+
+    else
+    {
+        st->filetype = PHYSFS_FILETYPE_REGULAR;
+        st->filesize = (((PHYSFS_uint64) entw->nFileSizeHigh) << 32) | entw->nFileSizeLow;
+    } /* else */
+
+    st->readonly = ((attr & FILE_ATTRIBUTE_READONLY) != 0);
+} /* statFromFindData */
+
+
 int __PHYSFS_platformStat(const char *filename, PHYSFS_Stat *st, const int follow)
 {
     WIN32_FILE_ATTRIBUTE_DATA winstat;
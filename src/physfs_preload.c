@@ -0,0 +1,367 @@
+/**
+ * PhysicsFS; a portable, flexible file i/o abstraction.
+ *
+ * Documentation is in physfs.h. It's verbose, honest.  :)
+ *
+ * Please see the file LICENSE.txt in the source's root directory.
+ *
+ *  This file written by Ryan C. Gordon.
+ */
+
+/*
+ * Files loaded into memory by PHYSFS_preload(). Each one is a whole file's
+ *  contents in a memory Io, keyed by the path the search path found it at,
+ *  along with the archive it came from. Opening one just hands out another
+ *  reference to its Io, so, like the block cache, evicting a file doesn't
+ *  pull it out from under anyone still reading it.
+ *
+ * Files live in a small hash table for lookups and on one list in order of
+ *  use, most recent first. Pinned files don't count against the budget and
+ *  are never evicted; when the rest go over it, unpinned files come off the
+ *  end of that list until they don't.
+ *
+ * Everything here happens with the stateLock held, and mounting and
+ *  unmounting, which change what a path opens, need it exclusively, so a
+ *  hit is always what the search path would have found.
+ */
+
+#define __PHYSICSFS_INTERNAL__
+#include "physfs_internal.h"
+
+#ifndef PHYSFS_PRELOAD_BUDGET
+#define PHYSFS_PRELOAD_BUDGET (256 * 1024 * 1024)
+#endif
+
+#define PRELOAD_BUCKETS 1024  /* must be a power of two. */
+
+typedef struct PreloadedFile
+{
+    char *path;
+    PHYSFS_uint32 hash;
+    const void *archive;
+    PHYSFS_Io *io;
+    PHYSFS_uint64 len;
+    int pinned;
+    struct PreloadedFile *hashnext;
+    struct PreloadedFile *prev;  /* more recently used. */
+    struct PreloadedFile *next;  /* less recently used. */
+} PreloadedFile;
+
+static void *preloadLock = NULL;
+static PHYSFS_uint64 preloadBudget = PHYSFS_PRELOAD_BUDGET;
+static PreloadedFile *buckets[PRELOAD_BUCKETS];
+static PreloadedFile *mostRecent = NULL;
+static PreloadedFile *leastRecent = NULL;
+static PHYSFS_PreloadStats preloadStats;
+
+
+static PHYSFS_uint32 hashPath(const char *path)
+{
+    return __PHYSFS_hashString(path, strlen(path));
+} /* hashPath */
+
+
+/* MAKE SURE you hold (preloadLock) when calling this! */
+static PreloadedFile *findFile(const char *path, const PHYSFS_uint32 hash)
+{
+    PreloadedFile *file = buckets[hash & (PRELOAD_BUCKETS - 1)];
+    for (; file != NULL; file = file->hashnext)
+    {
+        if ((file->hash == hash) && (strcmp(file->path, path) == 0))
+            break;
+    } /* for */
+    return file;
+} /* findFile */
+
+
+/* MAKE SURE you hold (preloadLock) when calling this! */
+static void unlinkFile(PreloadedFile *file)
+{
+    if (file->prev)
+        file->prev->next = file->next;
+    else
+        mostRecent = file->next;
+
+    if (file->next)
+        file->next->prev = file->prev;
+    else
+        leastRecent = file->prev;
+
+    file->prev = file->next = NULL;
+} /* unlinkFile */
+
+
+/* MAKE SURE you hold (preloadLock) when calling this! */
+static void linkFile(PreloadedFile *file)
+{
+    file->prev = NULL;
+    file->next = mostRecent;
+    if (mostRecent)
+        mostRecent->prev = file;
+    else
+        leastRecent = file;
+    mostRecent = file;
+} /* linkFile */
+
+
+/* MAKE SURE you hold (preloadLock) when calling this! */
+static void dropFile(PreloadedFile *file)
+{
+    PreloadedFile **p = &buckets[file->hash & (PRELOAD_BUCKETS - 1)];
+    while (*p != file)
+        p = &(*p)->hashnext;
+    *p = file->hashnext;
+
+    unlinkFile(file);
+    preloadStats.files--;
+    preloadStats.bytes -= file->len;
+    if (file->pinned)
+        preloadStats.pinnedBytes -= file->len;
+    file->io->destroy(file->io);
+    allocator.Free(file->path);
+    allocator.Free(file);
+} /* dropFile */
+
+
+/* MAKE SURE you hold (preloadLock) when calling this! */
+static void trimPreloads(const PHYSFS_uint64 budget)
+{
+    PreloadedFile *file = leastRecent;
+    while ((file != NULL) &&
+           (preloadStats.bytes - preloadStats.pinnedBytes > budget))
+    {
+        PreloadedFile *prev = file->prev;
+        if (!file->pinned)
+        {
+            preloadStats.evictions++;
+            dropFile(file);
+        } /* if */
+        file = prev;
+    } /* while */
+} /* trimPreloads */
+
+
+static void freePreloadBuffer(void *buf)
+{
+    allocator.Free(buf);
+} /* freePreloadBuffer */
+
+
+int __PHYSFS_preloadInit(void)
+{
+    preloadLock = __PHYSFS_platformCreateMutex();
+    BAIL_IF_ERRPASS(!preloadLock, 0);
+    memset(buckets, '\0', sizeof (buckets));
+    memset(&preloadStats, '\0', sizeof (preloadStats));
+    mostRecent = leastRecent = NULL;
+    return 1;
+} /* __PHYSFS_preloadInit */
+
+
+void __PHYSFS_preloadDeinit(void)
+{
+    if (preloadLock == NULL)
+        return;
+
+    __PHYSFS_platformGrabMutex(preloadLock);
+    while (mostRecent != NULL)
+        dropFile(mostRecent);
+    __PHYSFS_platformReleaseMutex(preloadLock);
+
+    __PHYSFS_platformDestroyMutex(preloadLock);
+    preloadLock = NULL;
+    preloadBudget = PHYSFS_PRELOAD_BUDGET;
+} /* __PHYSFS_preloadDeinit */
+
+
+PHYSFS_Io *__PHYSFS_preloadGet(const char *path, const void **archive)
+{
+    PHYSFS_Io *retval = NULL;
+    PHYSFS_uint32 hash;
+    PreloadedFile *file;
+
+    /* adds only happen under the stateLock, which our caller holds. */
+    if ((preloadLock == NULL) || (preloadStats.files == 0))
+        return NULL;
+
+    hash = hashPath(path);
+    __PHYSFS_platformGrabMutex(preloadLock);
+    file = findFile(path, hash);
+    if (file != NULL)
+    {
+        retval = file->io->duplicate(file->io);
+        if (retval != NULL)  /* failure just looks like a miss. */
+        {
+            *archive = file->archive;
+            preloadStats.hits++;
+            unlinkFile(file);
+            linkFile(file);
+        } /* if */
+    } /* if */
+    __PHYSFS_platformReleaseMutex(preloadLock);
+
+    return retval;
+} /* __PHYSFS_preloadGet */
+
+
+int __PHYSFS_preloadHas(const char *path, const int pin)
+{
+    PreloadedFile *file;
+
+    if (preloadLock == NULL)
+        return 0;
+
+    __PHYSFS_platformGrabMutex(preloadLock);
+    file = findFile(path, hashPath(path));
+    if ((file != NULL) && (pin) && (!file->pinned))
+    {
+        file->pinned = 1;
+        preloadStats.pinnedBytes += file->len;
+    } /* if */
+    __PHYSFS_platformReleaseMutex(preloadLock);
+
+    return (file != NULL);
+} /* __PHYSFS_preloadHas */
+
+
+int __PHYSFS_preloadPut(const char *path, const void *archive, void *buf,
+                        const PHYSFS_uint64 len, const int pin)
+{
+    const PHYSFS_uint32 hash = hashPath(path);
+    PreloadedFile *file = NULL;
+    PreloadedFile *old;
+
+    file = (PreloadedFile *) allocator.Malloc(sizeof (PreloadedFile));
+    GOTO_IF(!file, PHYSFS_ERR_OUT_OF_MEMORY, preloadPut_failed);
+    memset(file, '\0', sizeof (*file));
+    file->path = (char *) allocator.Malloc(strlen(path) + 1);
+    GOTO_IF(!file->path, PHYSFS_ERR_OUT_OF_MEMORY, preloadPut_failed);
+    file->io = __PHYSFS_createMemoryIo(buf, len, freePreloadBuffer);
+    GOTO_IF_ERRPASS(!file->io, preloadPut_failed);
+
+    strcpy(file->path, path);
+    file->hash = hash;
+    file->archive = archive;
+    file->len = len;
+    file->pinned = pin;
+
+    __PHYSFS_platformGrabMutex(preloadLock);
+    old = findFile(path, hash);
+    if (old != NULL)
+        dropFile(old);
+
+    file->hashnext = buckets[hash & (PRELOAD_BUCKETS - 1)];
+    buckets[hash & (PRELOAD_BUCKETS - 1)] = file;
+    linkFile(file);
+    preloadStats.files++;
+    preloadStats.bytes += len;
+    if (pin)
+        preloadStats.pinnedBytes += len;
+    trimPreloads(preloadBudget);
+    __PHYSFS_platformReleaseMutex(preloadLock);
+    return 1;
+
+preloadPut_failed:
+    if (file != NULL)
+    {
+        if (file->path != NULL)
+            allocator.Free(file->path);
+        allocator.Free(file);
+    } /* if */
+    allocator.Free(buf);
+    return 0;
+} /* __PHYSFS_preloadPut */
+
+
+/* is (path) (prefix), or something inside it? "" is the parent of all. */
+static int pathIsUnder(const char *path, const char *prefix)
+{
+    const size_t len = strlen(prefix);
+    if (len == 0)
+        return 1;
+    else if (strncmp(path, prefix, len) != 0)
+        return 0;
+    return ((path[len] == '\0') || (path[len] == '/'));
+} /* pathIsUnder */
+
+
+void __PHYSFS_preloadForget(const char *path, const int changed)
+{
+    PreloadedFile *file;
+    PreloadedFile *next;
+
+    if ((preloadLock == NULL) || (preloadStats.files == 0))
+        return;
+
+    __PHYSFS_platformGrabMutex(preloadLock);
+    for (file = mostRecent; file != NULL; file = next)
+    {
+        next = file->next;
+        if (pathIsUnder(file->path, path))
+        {
+            if (changed)
+                preloadStats.invalidations++;
+            dropFile(file);
+        } /* if */
+    } /* for */
+    __PHYSFS_platformReleaseMutex(preloadLock);
+} /* __PHYSFS_preloadForget */
+
+
+void __PHYSFS_preloadForgetIf(int (*stale)(void *data, const char *path,
+                                           const void *archive),
+                              void *data)
+{
+    PreloadedFile *file;
+    PreloadedFile *next;
+
+    if ((preloadLock == NULL) || (preloadStats.files == 0))
+        return;
+
+    __PHYSFS_platformGrabMutex(preloadLock);
+    for (file = mostRecent; file != NULL; file = next)
+    {
+        next = file->next;
+        if (stale(data, file->path, file->archive))
+        {
+            preloadStats.invalidations++;
+            dropFile(file);
+        } /* if */
+    } /* for */
+    __PHYSFS_platformReleaseMutex(preloadLock);
+} /* __PHYSFS_preloadForgetIf */
+
+
+void PHYSFS_setPreloadBudget(PHYSFS_uint64 budget)
+{
+    preloadBudget = budget;
+    if (preloadLock != NULL)
+    {
+        __PHYSFS_platformGrabMutex(preloadLock);
+        trimPreloads(budget);
+        __PHYSFS_platformReleaseMutex(preloadLock);
+    } /* if */
+} /* PHYSFS_setPreloadBudget */
+
+
+PHYSFS_uint64 PHYSFS_getPreloadBudget(void)
+{
+    return preloadBudget;
+} /* PHYSFS_getPreloadBudget */
+
+
+void PHYSFS_getPreloadStats(PHYSFS_PreloadStats *stats)
+{
+    if (stats == NULL)
+        return;
+    else if (preloadLock == NULL)
+        memset(stats, '\0', sizeof (*stats));
+    else
+    {
+        __PHYSFS_platformGrabMutex(preloadLock);
+        memcpy(stats, &preloadStats, sizeof (*stats));
+        __PHYSFS_platformReleaseMutex(preloadLock);
+    } /* else */
+} /* PHYSFS_getPreloadStats */
+
+/* end of physfs_preload.c ... */
@@ -0,0 +1,374 @@
+/**
+ * PhysicsFS; a portable, flexible file i/o abstraction.
+ *
+ * Documentation is in physfs.h. It's verbose, honest.  :)
+ *
+ * Please see the file LICENSE.txt in the source's root directory.
+ *
+ *  This file written by Ryan C. Gordon.
+ */
+
+/*
+ * Performance counters, the trace hook and the access log. The counters are
+ *  bumped in place all over the library (see __PHYSFS_STAT_ADD() in
+ *  physfs_internal.h), so all this has to do is hand them out; the
+ *  per-archive ones live with their DirHandle, in physfs.c. The access log
+ *  is just another trace callback, chained in front of the app's.
+ */
+
+#define __PHYSICSFS_INTERNAL__
+#include "physfs_internal.h"
+
+#if PHYSFS_SUPPORTS_STATS
+
+PHYSFS_Stats __PHYSFS_stats;
+PHYSFS_TraceCallback __PHYSFS_traceCallback = NULL;
+static PHYSFS_TraceCallback appTraceCallback = NULL;
+static void *traceData = NULL;
+
+/*
+ * Read handles opened while the access log is recording. Reads that carry
+ *  on from where the last one stopped just grow (start, end), so streaming
+ *  a file is one line in the log, written once the streak breaks.
+ */
+typedef struct AccessLogFile
+{
+    PHYSFS_File *file;
+    PHYSFS_uint32 id;
+    PHYSFS_uint64 start;
+    PHYSFS_uint64 end;
+    struct AccessLogFile *next;
+} AccessLogFile;
+
+static void *accessLogLock = NULL;  /* non-NULL while recording. */
+static AccessLogFile *accessLogFiles = NULL;
+static PHYSFS_uint32 accessLogOpens = 0;
+static char *accessLog = NULL;
+static size_t accessLogLen = 0;
+static size_t accessLogAlloc = 0;
+static int accessLogOutOfMemory = 0;
+
+
+void __PHYSFS_trace(PHYSFS_TraceEvent *event, const PHYSFS_uint64 start)
+{
+    const PHYSFS_TraceCallback cb = __PHYSFS_traceCallback;
+    if (cb != NULL)
+    {
+        event->timestamp = start;
+        event->duration = __PHYSFS_platformNanoseconds() - start;
+        cb(traceData, event);
+    } /* if */
+} /* __PHYSFS_trace */
+
+
+int PHYSFS_getStats(PHYSFS_Stats *stats)
+{
+    BAIL_IF(!stats, PHYSFS_ERR_INVALID_ARGUMENT, 0);
+    if (!PHYSFS_isInit())
+    {
+        memset(stats, '\0', sizeof (*stats));
+        BAIL(PHYSFS_ERR_NOT_INITIALIZED, 0);
+    } /* if */
+    memcpy(stats, &__PHYSFS_stats, sizeof (*stats));
+    return 1;
+} /* PHYSFS_getStats */
+
+
+void PHYSFS_resetStats(void)
+{
+    memset(&__PHYSFS_stats, '\0', sizeof (__PHYSFS_stats));
+} /* PHYSFS_resetStats */
+
+
+static void accessLogTrace(void *data, const PHYSFS_TraceEvent *event);
+
+int PHYSFS_setTraceCallback(PHYSFS_TraceCallback cb, void *data)
+{
+    __PHYSFS_traceCallback = NULL;  /* so nobody sees the wrong (data). */
+    traceData = data;
+    appTraceCallback = cb;
+    __PHYSFS_traceCallback = (accessLogLock != NULL) ? accessLogTrace : cb;
+    return 1;
+} /* PHYSFS_setTraceCallback */
+
+
+static void accessLogAppend(const char *str, size_t len)
+{
+    if (accessLogLen + len > accessLogAlloc)
+    {
+        size_t newalloc = accessLogAlloc ? accessLogAlloc * 2 : 16 * 1024;
+        char *ptr;
+
+        while (newalloc < accessLogLen + len)
+            newalloc *= 2;
+
+        ptr = (char *) allocator.Realloc(accessLog, newalloc);
+        if (ptr == NULL)
+        {
+            accessLogOutOfMemory = 1;
+            return;
+        } /* if */
+
+        accessLog = ptr;
+        accessLogAlloc = newalloc;
+    } /* if */
+
+    memcpy(accessLog + accessLogLen, str, len);
+    accessLogLen += len;
+} /* accessLogAppend */
+
+
+static void accessLogAppendNumber(PHYSFS_uint64 num)
+{
+    char buf[24];
+    char *ptr = buf + sizeof (buf);
+
+    accessLogAppend("\t", 1);
+    do
+    {
+        *(--ptr) = (char) ('0' + (num % 10));
+        num /= 10;
+    } while (num > 0);
+
+    accessLogAppend(ptr, (size_t) ((buf + sizeof (buf)) - ptr));
+} /* accessLogAppendNumber */
+
+
+/* tabs and newlines would break up the line, so skip those names. */
+static int accessLogNameOkay(const char *str)
+{
+    return ((str != NULL) && (strpbrk(str, "\t\r\n") == NULL));
+} /* accessLogNameOkay */
+
+
+static void accessLogFlushRead(AccessLogFile *alf)
+{
+    if (alf->end > alf->start)
+    {
+        accessLogAppend("read", 4);
+        accessLogAppendNumber(alf->id);
+        accessLogAppendNumber(alf->start);
+        accessLogAppendNumber(alf->end - alf->start);
+        accessLogAppend("\n", 1);
+    } /* if */
+    alf->start = alf->end = 0;
+} /* accessLogFlushRead */
+
+
+static AccessLogFile *accessLogFind(const PHYSFS_File *file,
+                                    AccessLogFile **_prev)
+{
+    AccessLogFile *prev = NULL;
+    AccessLogFile *i;
+
+    for (i = accessLogFiles; i != NULL; i = i->next)
+    {
+        if (i->file == file)
+            break;
+        prev = i;
+    } /* for */
+
+    if (_prev != NULL)
+        *_prev = prev;
+    return i;
+} /* accessLogFind */
+
+
+static void accessLogOpen(const PHYSFS_TraceEvent *event)
+{
+    AccessLogFile *alf;
+
+    if ((event->file == NULL) || (!__PHYSFS_fileForReading(event->file)))
+        return;  /* failed, or a write handle. */
+    else if (!accessLogNameOkay(event->filename))
+        return;
+    else if (!accessLogNameOkay(event->archive))
+        return;
+
+    alf = (AccessLogFile *) allocator.Malloc(sizeof (AccessLogFile));
+    if (alf == NULL)
+    {
+        accessLogOutOfMemory = 1;
+        return;
+    } /* if */
+
+    alf->file = event->file;
+    alf->id = ++accessLogOpens;
+    alf->start = alf->end = 0;
+    alf->next = accessLogFiles;
+    accessLogFiles = alf;
+
+    accessLogAppend("open", 4);
+    accessLogAppendNumber(alf->id);
+    accessLogAppend("\t", 1);
+    accessLogAppend(event->filename, strlen(event->filename));
+    accessLogAppend("\t", 1);
+    accessLogAppend(event->archive, strlen(event->archive));
+    accessLogAppend("\n", 1);
+} /* accessLogOpen */
+
+
+static void accessLogRead(const PHYSFS_TraceEvent *event)
+{
+    AccessLogFile *alf;
+
+    if (event->result <= 0)
+        return;
+    else if ((alf = accessLogFind(event->file, NULL)) == NULL)
+        return;  /* opened before we started, or not loggable. */
+
+    if ((alf->end == 0) || (alf->end != event->offset))
+    {
+        accessLogFlushRead(alf);
+        alf->start = alf->end = event->offset;
+    } /* if */
+
+    alf->end += (PHYSFS_uint64) event->result;
+} /* accessLogRead */
+
+
+static void accessLogClose(const PHYSFS_TraceEvent *event)
+{
+    AccessLogFile *prev;
+    AccessLogFile *alf = accessLogFind(event->file, &prev);
+    if (alf != NULL)
+    {
+        accessLogFlushRead(alf);
+        if (prev == NULL)
+            accessLogFiles = alf->next;
+        else
+            prev->next = alf->next;
+        allocator.Free(alf);
+    } /* if */
+} /* accessLogClose */
+
+
+/* this is __PHYSFS_traceCallback while recording; (data) is the app's. */
+static void accessLogTrace(void *data, const PHYSFS_TraceEvent *event)
+{
+    const PHYSFS_TraceCallback cb = appTraceCallback;
+
+    __PHYSFS_platformGrabMutex(accessLogLock);
+    if (event->type == PHYSFS_TRACE_OPEN)
+        accessLogOpen(event);
+    else if (event->type == PHYSFS_TRACE_READ)
+        accessLogRead(event);
+    else if (event->type == PHYSFS_TRACE_CLOSE)
+        accessLogClose(event);
+    __PHYSFS_platformReleaseMutex(accessLogLock);
+
+    if (cb != NULL)
+        cb(data, event);
+} /* accessLogTrace */
+
+
+static void accessLogFree(void)
+{
+    while (accessLogFiles != NULL)
+    {
+        AccessLogFile *next = accessLogFiles->next;
+        allocator.Free(accessLogFiles);
+        accessLogFiles = next;
+    } /* while */
+
+    if (accessLog != NULL)
+        allocator.Free(accessLog);
+
+    accessLog = NULL;
+    accessLogLen = accessLogAlloc = 0;
+    accessLogOpens = 0;
+    accessLogOutOfMemory = 0;
+} /* accessLogFree */
+
+
+int PHYSFS_startAccessLog(void)
+{
+    static const char header[] = "# PhysicsFS access log 1\n";
+
+    BAIL_IF(!PHYSFS_isInit(), PHYSFS_ERR_NOT_INITIALIZED, 0);
+    BAIL_IF(accessLogLock != NULL, PHYSFS_ERR_IS_INITIALIZED, 0);
+    accessLogLock = __PHYSFS_platformCreateMutex();
+    BAIL_IF_ERRPASS(!accessLogLock, 0);
+
+    accessLogAppend(header, sizeof (header) - 1);
+    if (accessLogOutOfMemory)
+    {
+        accessLogFree();
+        __PHYSFS_platformDestroyMutex(accessLogLock);
+        accessLogLock = NULL;
+        BAIL(PHYSFS_ERR_OUT_OF_MEMORY, 0);
+    } /* if */
+
+    __PHYSFS_traceCallback = accessLogTrace;
+    return 1;
+} /* PHYSFS_startAccessLog */
+
+
+int PHYSFS_stopAccessLog(PHYSFS_File *out)
+{
+    AccessLogFile *i;
+    int retval = 1;
+
+    BAIL_IF(accessLogLock == NULL, PHYSFS_ERR_NOT_INITIALIZED, 0);
+
+    /* stop listening before we write, so (out) doesn't end up in here. */
+    __PHYSFS_traceCallback = appTraceCallback;
+    __PHYSFS_platformDestroyMutex(accessLogLock);
+    accessLogLock = NULL;
+
+    for (i = accessLogFiles; i != NULL; i = i->next)
+        accessLogFlushRead(i);  /* files still open: keep what they read. */
+
+    if (accessLogOutOfMemory)
+    {
+        PHYSFS_setErrorCode(PHYSFS_ERR_OUT_OF_MEMORY);
+        retval = 0;
+    } /* if */
+    else if (out != NULL)
+    {
+        const PHYSFS_sint64 len = (PHYSFS_sint64) accessLogLen;
+        if (PHYSFS_writeBytes(out, accessLog, accessLogLen) != len)
+            retval = 0;
+    } /* else if */
+
+    accessLogFree();
+    return retval;
+} /* PHYSFS_stopAccessLog */
+
+#else
+
+int PHYSFS_getStats(PHYSFS_Stats *stats)
+{
+    if (stats != NULL)
+        memset(stats, '\0', sizeof (*stats));
+    BAIL(PHYSFS_ERR_UNSUPPORTED, 0);
+} /* PHYSFS_getStats */
+
+
+void PHYSFS_resetStats(void)
+{
+} /* PHYSFS_resetStats */
+
+
+int PHYSFS_setTraceCallback(PHYSFS_TraceCallback cb, void *data)
+{
+    if (cb == NULL)
+        return 1;  /* already not tracing. */
+    BAIL(PHYSFS_ERR_UNSUPPORTED, 0);
+} /* PHYSFS_setTraceCallback */
+
+
+int PHYSFS_startAccessLog(void)
+{
+    BAIL(PHYSFS_ERR_UNSUPPORTED, 0);
+} /* PHYSFS_startAccessLog */
+
+
+int PHYSFS_stopAccessLog(PHYSFS_File *out)
+{
+    BAIL(PHYSFS_ERR_NOT_INITIALIZED, 0);  /* never started. */
+} /* PHYSFS_stopAccessLog */
+
+#endif  /* PHYSFS_SUPPORTS_STATS */
+
+/* end of physfs_stats.c ... */
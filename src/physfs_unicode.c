@@ -233,9 +233,55 @@ static PHYSFS_uint32 utf32codepoint(const PHYSFS_uint32 **_str)
 } /* utf32codepoint */
 
 
+/*
+ * Almost every path we see is plain ASCII, so the converters below first
+ *  find how much of the string is free of high bytes and copy that part
+ *  straight across, leaving utf8codepoint() for whatever follows. The
+ *  check goes a machine word at a time: strlen() tells us how far it is
+ *  safe to read, and memcpy() keeps unaligned loads legal (compilers make
+ *  it a single load).
+ */
+static size_t utf8asciiprefix(const char *str, size_t max)
+{
+    const size_t highbits = (((size_t) -1) / 0xFF) * 0x80;
+    size_t avail = strlen(str);
+    size_t i = 0;
+
+    if (avail > max)
+        avail = max;
+
+    while ((avail - i) >= sizeof (size_t))
+    {
+        size_t word;
+        memcpy(&word, str + i, sizeof (word));
+        if (word & highbits)
+            break;  /* let the byte loop find exactly where. */
+        i += sizeof (word);
+    } /* while */
+
+    while ((i < avail) && (((PHYSFS_uint8) str[i]) < 128))
+        i++;
+
+    return i;
+} /* utf8asciiprefix */
+
+/* widens the ASCII run at the start of src, adjusting src/dst/len. */
+#define UTF8TOTYPE_ASCII(typ, src, dst, len) { \
+    const PHYSFS_uint64 room = len / sizeof (typ); \
+    const size_t max = (room > (size_t) -1) ? ((size_t) -1) : (size_t) room; \
+    const size_t ascii = utf8asciiprefix(src, max); \
+    size_t i; \
+    for (i = 0; i < ascii; i++) \
+        dst[i] = (typ) ((PHYSFS_uint8) src[i]); \
+    src += ascii; \
+    dst += ascii; \
+    len -= ascii * sizeof (typ); \
+}
+
 void PHYSFS_utf8ToUcs4(const char *src, PHYSFS_uint32 *dst, PHYSFS_uint64 len)
 {
     len -= sizeof (PHYSFS_uint32);   /* save room for null char. */
+    UTF8TOTYPE_ASCII(PHYSFS_uint32, src, dst, len);
     while (len >= sizeof (PHYSFS_uint32))
     {
         PHYSFS_uint32 cp = utf8codepoint(&src);
@@ -254,6 +300,7 @@ void PHYSFS_utf8ToUcs4(const char *src, PHYSFS_uint32 *dst, PHYSFS_uint64 len)
 void PHYSFS_utf8ToUcs2(const char *src, PHYSFS_uint16 *dst, PHYSFS_uint64 len)
 {
     len -= sizeof (PHYSFS_uint16);   /* save room for null char. */
+    UTF8TOTYPE_ASCII(PHYSFS_uint16, src, dst, len);
     while (len >= sizeof (PHYSFS_uint16))
     {
         PHYSFS_uint32 cp = utf8codepoint(&src);
@@ -276,6 +323,7 @@ void PHYSFS_utf8ToUcs2(const char *src, PHYSFS_uint16 *dst, PHYSFS_uint64 len)
 void PHYSFS_utf8ToUtf16(const char *src, PHYSFS_uint16 *dst, PHYSFS_uint64 len)
 {
     len -= sizeof (PHYSFS_uint16);   /* save room for null char. */
+    UTF8TOTYPE_ASCII(PHYSFS_uint16, src, dst, len);
     while (len >= sizeof (PHYSFS_uint16))
     {
         PHYSFS_uint32 cp = utf8codepoint(&src);
@@ -304,6 +352,8 @@ void PHYSFS_utf8ToUtf16(const char *src, PHYSFS_uint16 *dst, PHYSFS_uint64 len)
     *dst = 0;
 } /* PHYSFS_utf8ToUtf16 */
 
+#undef UTF8TOTYPE_ASCII
+
 static void utf8fromcodepoint(PHYSFS_uint32 cp, char **_dst, PHYSFS_uint64 *_len)
 {
     char *dst = *_dst;
@@ -517,6 +567,43 @@ int PHYSFS_caseFold(const PHYSFS_uint32 from, PHYSFS_uint32 *to)
 } /* PHYSFS_caseFold */
 
 
+size_t __PHYSFS_utf8CaseFold(const char *src, char *dst)
+{
+    char *start = dst;
+    PHYSFS_uint64 len = (PHYSFS_uint64) -1;  /* caller promised room. */
+
+    /* most paths are plain ASCII, so skip the decoding as long as we can. */
+    const size_t ascii = utf8asciiprefix(src, (size_t) -1);
+    size_t i;
+
+    for (i = 0; i < ascii; i++)
+    {
+        const char ch = src[i];
+        dst[i] = ((ch >= 'A') && (ch <= 'Z')) ? (ch - ('A' - 'a')) : ch;
+    } /* for */
+
+    src += ascii;
+    dst += ascii;
+
+    while (1)
+    {
+        PHYSFS_uint32 folded[3];
+        const PHYSFS_uint32 cp = utf8codepoint(&src);
+        const int count = PHYSFS_caseFold(cp, folded);
+        int i;
+
+        if (cp == 0)
+            break;
+
+        for (i = 0; i < count; i++)
+            utf8fromcodepoint(folded[i], &dst, &len);
+    } /* while */
+
+    *dst = '\0';
+    return (size_t) (dst - start);
+} /* __PHYSFS_utf8CaseFold */
+
+
 #define UTFSTRICMP(bits) \
     PHYSFS_uint32 folded1[3], folded2[3]; \
     int head1 = 0, tail1 = 0, head2 = 0, tail2 = 0; \
@@ -548,7 +635,32 @@ int PHYSFS_caseFold(const PHYSFS_uint32 from, PHYSFS_uint32 *to)
 
 int PHYSFS_utf8stricmp(const char *str1, const char *str2)
 {
-    UTFSTRICMP(8);
+    /*
+     * ASCII folds one byte to one byte, so compare directly until either
+     *  string has a high byte, then let the full casefolder take over from
+     *  that (codepoint-aligned) spot with nothing queued.
+     */
+    while (1)
+    {
+        PHYSFS_uint8 ch1 = (PHYSFS_uint8) *str1;
+        PHYSFS_uint8 ch2 = (PHYSFS_uint8) *str2;
+        if ((ch1 >= 128) || (ch2 >= 128))
+            break;
+        if ((ch1 >= 'A') && (ch1 <= 'Z'))
+            ch1 += 'a' - 'A';
+        if ((ch2 >= 'A') && (ch2 <= 'Z'))
+            ch2 += 'a' - 'A';
+        if (ch1 != ch2)
+            return (ch1 < ch2) ? -1 : 1;
+        else if (ch1 == 0)
+            return 0;  /* complete match. */
+        str1++;
+        str2++;
+    } /* while */
+
+    {
+        UTFSTRICMP(8);
+    }
 } /* PHYSFS_utf8stricmp */
 
 int PHYSFS_utf16stricmp(const PHYSFS_uint16 *str1, const PHYSFS_uint16 *str2)
@@ -0,0 +1,478 @@
+/**
+ * PhysicsFS; a portable, flexible file i/o abstraction.
+ *
+ * Documentation is in physfs.h. It's verbose, honest.  :)
+ *
+ * Please see the file LICENSE.txt in the source's root directory.
+ *
+ *  This file written by Ryan C. Gordon.
+ */
+
+/*
+ * Write-behind for files opened for writing; see PHYSFS_setWriteBehind().
+ *  Every handle gets two buffers. The app fills one while a single flusher
+ *  thread writes the other out, so the app only waits when it gets a whole
+ *  buffer ahead of the disk. Handles with a buffer to write sit in
+ *  (pending); the flusher writes one buffer and sends the handle to the
+ *  back, so one big save doesn't starve the rest.
+ *
+ * Closing never waits. The handle goes to the flusher with whatever is
+ *  left, and once that's written the flusher syncs it, destroys the Io and
+ *  runs the handle's commit callback, which is where atomic writes get
+ *  renamed into place. Failures from then on have nobody to report to, so
+ *  the first one is kept for PHYSFS_waitWriteBehind().
+ *
+ * Like physfs_async.c, there's no condition variable in the platform layer,
+ *  so sleepers count themselves and wait on a semaphore.
+ */
+
+#define __PHYSICSFS_INTERNAL__
+#include "physfs_internal.h"
+
+struct __PHYSFS_WriteBehind
+{
+    PHYSFS_Io *io;
+    PHYSFS_uint8 *buffers[2];
+    size_t used[2];          /* bytes waiting in each buffer. */
+    size_t bufsize;
+    int current;             /* the buffer the app is filling... */
+    int head;                /* ...and the next one the flusher writes. */
+    int queued;              /* buffers handed to the flusher, 0 to 2. */
+    int busy;                /* flusher is writing (head) right now. */
+    int inQueue;             /* in (pending). */
+    int closing;             /* finish up once (queued) hits zero. */
+    PHYSFS_uint64 position;  /* file position, as far as the app knows. */
+    PHYSFS_ErrorCode error;  /* first failed write; sticks. */
+    __PHYSFS_WriteBehindCommit commit;
+    void *commitData;
+    struct __PHYSFS_WriteBehind *next;  /* in (pending). */
+};
+
+static PHYSFS_uint64 writeBehindSize = 0;
+static void *wbLock = NULL;  /* protects everything below, and all handles. */
+static void *workSem = NULL;
+static void *doneSem = NULL;
+static void *flusher = NULL;
+static int triedFlusher = 0;
+static int shuttingDown = 0;
+static int workSleepers = 0;
+static int doneSleepers = 0;
+static int closingCount = 0;  /* closed handles the flusher still owns. */
+static PHYSFS_ErrorCode closedError = PHYSFS_ERR_OK;
+static __PHYSFS_WriteBehind *pending = NULL;
+static __PHYSFS_WriteBehind *pendingTail = NULL;
+
+
+/* Must hold wbLock. */
+static void wakeSleepers(void *sem, int *sleepers, const int all)
+{
+    while (*sleepers > 0)
+    {
+        __PHYSFS_platformPostSemaphore(sem);
+        (*sleepers)--;
+        if (!all)
+            break;
+    } /* while */
+} /* wakeSleepers */
+
+
+/* Must hold wbLock; it's released while we sleep. */
+static void sleepOn(void *sem, int *sleepers)
+{
+    (*sleepers)++;
+    __PHYSFS_platformReleaseMutex(wbLock);
+    __PHYSFS_platformWaitSemaphore(sem);
+    __PHYSFS_platformGrabMutex(wbLock);
+} /* sleepOn */
+
+
+static PHYSFS_ErrorCode lastError(void)
+{
+    const PHYSFS_ErrorCode err = PHYSFS_getLastErrorCode();
+    return (err == PHYSFS_ERR_OK) ? PHYSFS_ERR_OTHER_ERROR : err;
+} /* lastError */
+
+
+/* Must hold wbLock. If the flusher has (wb) already, it'll come back. */
+static void queueHandle(__PHYSFS_WriteBehind *wb)
+{
+    if ((wb->inQueue) || (wb->busy))
+        return;
+
+    wb->inQueue = 1;
+    wb->next = NULL;
+    if (pendingTail != NULL)
+        pendingTail->next = wb;
+    else
+        pending = wb;
+    pendingTail = wb;
+    wakeSleepers(workSem, &workSleepers, 0);
+} /* queueHandle */
+
+
+/* Must hold wbLock, and (wb->queued) must be less than 2. */
+static void handOff(__PHYSFS_WriteBehind *wb)
+{
+    if (wb->queued == 0)
+        wb->head = wb->current;
+    wb->queued++;
+    wb->current = !wb->current;
+    queueHandle(wb);
+} /* handOff */
+
+
+/* Call without wbLock held. */
+static PHYSFS_ErrorCode writeBuffer(PHYSFS_Io *io, const PHYSFS_uint8 *buf,
+                                    size_t len)
+{
+    while (len > 0)
+    {
+        const PHYSFS_sint64 rc = io->write(io, buf, (PHYSFS_uint64) len);
+        if (rc <= 0)
+            return lastError();
+        buf += (size_t) rc;
+        len -= (size_t) rc;
+    } /* while */
+
+    return PHYSFS_ERR_OK;
+} /* writeBuffer */
+
+
+/* Call without wbLock held. (wb) belongs to us alone by now. */
+static void finishClose(__PHYSFS_WriteBehind *wb)
+{
+    PHYSFS_Io *io = wb->io;
+    PHYSFS_ErrorCode err = wb->error;
+
+    if ((err == PHYSFS_ERR_OK) && (io->flush != NULL) && (!io->flush(io)))
+        err = lastError();
+    io->destroy(io);
+
+    if (wb->commit != NULL)
+    {
+        const int ok = (err == PHYSFS_ERR_OK);
+        if ((!wb->commit(wb->commitData, ok)) && (ok))
+            err = lastError();
+    } /* if */
+
+    __PHYSFS_platformGrabMutex(wbLock);
+    if ((err != PHYSFS_ERR_OK) && (closedError == PHYSFS_ERR_OK))
+        closedError = err;
+    closingCount--;
+    wakeSleepers(doneSem, &doneSleepers, 1);
+    __PHYSFS_platformReleaseMutex(wbLock);
+
+    allocator.Free(wb);
+} /* finishClose */
+
+
+static void flusherThread(void *unused)
+{
+    __PHYSFS_platformGrabMutex(wbLock);
+    while (1)
+    {
+        __PHYSFS_WriteBehind *wb = pending;
+        if (wb == NULL)
+        {
+            if (shuttingDown)
+                break;
+            sleepOn(workSem, &workSleepers);
+            continue;
+        } /* if */
+
+        pending = wb->next;
+        if (pending == NULL)
+            pendingTail = NULL;
+        wb->next = NULL;
+        wb->inQueue = 0;
+
+        if (wb->queued > 0)
+        {
+            const int idx = wb->head;
+            PHYSFS_ErrorCode err = wb->error;
+            wb->busy = 1;
+            __PHYSFS_platformReleaseMutex(wbLock);
+
+            /* once a write fails, the rest are just thrown away. */
+            if (err == PHYSFS_ERR_OK)
+                err = writeBuffer(wb->io, wb->buffers[idx], wb->used[idx]);
+
+            __PHYSFS_platformGrabMutex(wbLock);
+            wb->busy = 0;
+            if (wb->error == PHYSFS_ERR_OK)
+                wb->error = err;
+            wb->used[idx] = 0;
+            wb->head = !idx;
+            wb->queued--;
+            wakeSleepers(doneSem, &doneSleepers, 1);
+        } /* if */
+
+        if (wb->queued > 0)
+            queueHandle(wb);
+        else if (wb->closing)
+        {
+            __PHYSFS_platformReleaseMutex(wbLock);
+            finishClose(wb);
+            __PHYSFS_platformGrabMutex(wbLock);
+        } /* else if */
+    } /* while */
+    __PHYSFS_platformReleaseMutex(wbLock);
+} /* flusherThread */
+
+
+/* Must hold wbLock. Failing to start is fine; handles just buffer instead. */
+static void startFlusher(void)
+{
+    triedFlusher = 1;
+
+    workSem = __PHYSFS_platformCreateSemaphore();
+    doneSem = __PHYSFS_platformCreateSemaphore();
+    if ((workSem == NULL) || (doneSem == NULL))
+        return;
+
+    flusher = __PHYSFS_platformCreateThread(flusherThread, NULL);
+} /* startFlusher */
+
+
+int __PHYSFS_writeBehindInit(void)
+{
+    wbLock = __PHYSFS_platformCreateMutex();
+    BAIL_IF(!wbLock, PHYSFS_ERR_OUT_OF_MEMORY, 0);
+    return 1;
+} /* __PHYSFS_writeBehindInit */
+
+
+void __PHYSFS_writeBehindDeinit(void)
+{
+    if (wbLock == NULL)
+        return;
+
+    __PHYSFS_writeBehindWaitAll();
+
+    __PHYSFS_platformGrabMutex(wbLock);
+    shuttingDown = 1;
+    wakeSleepers(workSem, &workSleepers, 1);
+    __PHYSFS_platformReleaseMutex(wbLock);
+
+    if (flusher != NULL)
+        __PHYSFS_platformJoinThread(flusher);
+
+    assert(pending == NULL);
+
+    if (workSem != NULL)
+        __PHYSFS_platformDestroySemaphore(workSem);
+    if (doneSem != NULL)
+        __PHYSFS_platformDestroySemaphore(doneSem);
+    __PHYSFS_platformDestroyMutex(wbLock);
+
+    wbLock = workSem = doneSem = flusher = NULL;
+    pending = pendingTail = NULL;
+    triedFlusher = shuttingDown = 0;
+    workSleepers = doneSleepers = closingCount = 0;
+    closedError = PHYSFS_ERR_OK;
+    writeBehindSize = 0;
+} /* __PHYSFS_writeBehindDeinit */
+
+
+__PHYSFS_WriteBehind *__PHYSFS_writeBehindCreate(PHYSFS_Io *io)
+{
+    __PHYSFS_WriteBehind *wb;
+    const size_t bufsize = (size_t) writeBehindSize;
+    PHYSFS_sint64 pos;
+    int haveFlusher;
+
+    if ((wbLock == NULL) || (bufsize == 0))
+        return NULL;
+
+    __PHYSFS_platformGrabMutex(wbLock);
+    if (!triedFlusher)
+        startFlusher();
+    haveFlusher = (flusher != NULL);
+    __PHYSFS_platformReleaseMutex(wbLock);
+
+    if (!haveFlusher)
+        return NULL;
+
+    /* both buffers come from the same block, right after the struct. */
+    wb = (__PHYSFS_WriteBehind *) allocator.Malloc(sizeof (*wb) + bufsize * 2);
+    if (!wb)
+        return NULL;
+
+    memset(wb, '\0', sizeof (*wb));
+    wb->io = io;
+    wb->buffers[0] = ((PHYSFS_uint8 *) wb) + sizeof (*wb);
+    wb->buffers[1] = wb->buffers[0] + bufsize;
+    wb->bufsize = bufsize;
+    wb->error = PHYSFS_ERR_OK;
+    pos = io->tell(io);  /* not zero if we're appending. */
+    wb->position = (pos > 0) ? (PHYSFS_uint64) pos : 0;
+    return wb;
+} /* __PHYSFS_writeBehindCreate */
+
+
+PHYSFS_sint64 __PHYSFS_writeBehindWrite(__PHYSFS_WriteBehind *wb,
+                                        const void *_buffer, size_t len)
+{
+    const PHYSFS_uint8 *buffer = (const PHYSFS_uint8 *) _buffer;
+    PHYSFS_ErrorCode err;
+    size_t total = 0;
+
+    __PHYSFS_platformGrabMutex(wbLock);
+    while ((len > 0) && (wb->error == PHYSFS_ERR_OK))
+    {
+        const int cur = wb->current;
+        size_t avail;
+
+        if (wb->queued == 2)
+        {
+            sleepOn(doneSem, &doneSleepers);  /* a whole buffer ahead. */
+            continue;
+        } /* if */
+
+        avail = wb->bufsize - wb->used[cur];
+        if (avail > len)
+            avail = len;
+
+        /* the flusher never touches (current), so copy without the lock. */
+        __PHYSFS_platformReleaseMutex(wbLock);
+        memcpy(wb->buffers[cur] + wb->used[cur], buffer, avail);
+        __PHYSFS_platformGrabMutex(wbLock);
+
+        wb->used[cur] += avail;
+        buffer += avail;
+        len -= avail;
+        total += avail;
+
+        if (wb->used[cur] == wb->bufsize)
+            handOff(wb);
+    } /* while */
+
+    wb->position += total;
+    err = wb->error;
+    __PHYSFS_platformReleaseMutex(wbLock);
+
+    BAIL_IF((total == 0) && (err != PHYSFS_ERR_OK), err, -1);
+    return (PHYSFS_sint64) total;
+} /* __PHYSFS_writeBehindWrite */
+
+
+PHYSFS_sint64 __PHYSFS_writeBehindTell(__PHYSFS_WriteBehind *wb)
+{
+    PHYSFS_uint64 retval;
+    __PHYSFS_platformGrabMutex(wbLock);
+    retval = wb->position;
+    __PHYSFS_platformReleaseMutex(wbLock);
+    return (PHYSFS_sint64) retval;
+} /* __PHYSFS_writeBehindTell */
+
+
+int __PHYSFS_writeBehindBarrier(__PHYSFS_WriteBehind *wb)
+{
+    PHYSFS_ErrorCode err;
+
+    __PHYSFS_platformGrabMutex(wbLock);
+    while (wb->queued == 2)
+        sleepOn(doneSem, &doneSleepers);
+    if (wb->used[wb->current] > 0)
+        handOff(wb);
+    while (wb->queued > 0)
+        sleepOn(doneSem, &doneSleepers);
+    err = wb->error;
+    __PHYSFS_platformReleaseMutex(wbLock);
+
+    BAIL_IF(err != PHYSFS_ERR_OK, err, 0);
+    return 1;
+} /* __PHYSFS_writeBehindBarrier */
+
+
+int __PHYSFS_writeBehindSeek(__PHYSFS_WriteBehind *wb, PHYSFS_uint64 pos)
+{
+    PHYSFS_Io *io = wb->io;
+    BAIL_IF_ERRPASS(!__PHYSFS_writeBehindBarrier(wb), 0);
+    BAIL_IF_ERRPASS(!io->seek(io, pos), 0);
+    __PHYSFS_platformGrabMutex(wbLock);
+    wb->position = pos;
+    __PHYSFS_platformReleaseMutex(wbLock);
+    return 1;
+} /* __PHYSFS_writeBehindSeek */
+
+
+PHYSFS_sint64 __PHYSFS_writeBehindLength(__PHYSFS_WriteBehind *wb)
+{
+    PHYSFS_Io *io = wb->io;
+    BAIL_IF_ERRPASS(!__PHYSFS_writeBehindBarrier(wb), -1);
+    return io->length(io);
+} /* __PHYSFS_writeBehindLength */
+
+
+int __PHYSFS_writeBehindStop(__PHYSFS_WriteBehind *wb)
+{
+    /* once (queued) is zero, the flusher is done with (wb) for good. */
+    const int retval = __PHYSFS_writeBehindBarrier(wb);
+    allocator.Free(wb);
+    return retval;
+} /* __PHYSFS_writeBehindStop */
+
+
+void __PHYSFS_writeBehindClose(__PHYSFS_WriteBehind *wb,
+                               __PHYSFS_WriteBehindCommit commit, void *data)
+{
+    __PHYSFS_platformGrabMutex(wbLock);
+    wb->commit = commit;
+    wb->commitData = data;
+    wb->closing = 1;
+    closingCount++;
+    /* with both buffers queued, the app has nothing of its own left. */
+    if ((wb->queued < 2) && (wb->used[wb->current] > 0))
+        handOff(wb);
+    queueHandle(wb);
+    __PHYSFS_platformReleaseMutex(wbLock);
+} /* __PHYSFS_writeBehindClose */
+
+
+void __PHYSFS_writeBehindWaitAll(void)
+{
+    if (wbLock == NULL)
+        return;
+
+    __PHYSFS_platformGrabMutex(wbLock);
+    while (closingCount > 0)
+        sleepOn(doneSem, &doneSleepers);
+    __PHYSFS_platformReleaseMutex(wbLock);
+} /* __PHYSFS_writeBehindWaitAll */
+
+
+int PHYSFS_setWriteBehind(PHYSFS_uint64 bufsize)
+{
+    /* each handle gets two of these. */
+    BAIL_IF((!__PHYSFS_ui64FitsAddressSpace(bufsize)) ||
+            (!__PHYSFS_ui64FitsAddressSpace(bufsize * 2)),
+            PHYSFS_ERR_INVALID_ARGUMENT, 0);
+    writeBehindSize = bufsize;
+    return 1;
+} /* PHYSFS_setWriteBehind */
+
+
+PHYSFS_uint64 PHYSFS_getWriteBehind(void)
+{
+    return writeBehindSize;
+} /* PHYSFS_getWriteBehind */
+
+
+int PHYSFS_waitWriteBehind(void)
+{
+    PHYSFS_ErrorCode err;
+
+    BAIL_IF(!wbLock, PHYSFS_ERR_NOT_INITIALIZED, 0);
+
+    __PHYSFS_writeBehindWaitAll();
+    __PHYSFS_platformGrabMutex(wbLock);
+    err = closedError;
+    closedError = PHYSFS_ERR_OK;
+    __PHYSFS_platformReleaseMutex(wbLock);
+
+    BAIL_IF(err != PHYSFS_ERR_OK, err, 0);
+    return 1;
+} /* PHYSFS_waitWriteBehind */
+
+/* end of physfs_writebehind.c ... */
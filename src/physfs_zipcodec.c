@@ -0,0 +1,329 @@
+/**
+ * PhysicsFS; a portable, flexible file i/o abstraction.
+ *
+ * Documentation is in physfs.h. It's verbose, honest.  :)
+ *
+ * Please see the file LICENSE.txt in the source's root directory.
+ *
+ *  This file written by Ryan C. Gordon.
+ */
+
+/*
+ * Decoders for the .zip compression methods besides stored and deflate:
+ *  LZMA (method 14) through the bundled LZMA SDK, and Zstandard (method 93)
+ *  through libzstd, if we were built with it. The zip archiver streams
+ *  compressed input through these exactly like it does through inflate, so
+ *  checkpoints aside, seeking, the block cache and preloading all just work.
+ *  This lives on its own, like physfs_inflate.c, so the LZMA SDK and zstd.h
+ *  don't have to share a translation unit with miniz.
+ */
+
+#define __PHYSICSFS_INTERNAL__
+#include "physfs_internal.h"
+
+#if PHYSFS_SUPPORTS_ZIP
+
+#define PHYSFS_LZMASDK_LZMADEC_ONLY 1
+#include "physfs_lzmasdk.h"
+
+#if PHYSFS_HAVE_ZSTD
+#include <zstd.h>
+#endif
+
+#define ZIPCODEC_LZMA_HEADERLEN (4 + LZMA_PROPS_SIZE)
+
+struct __PHYSFS_ZipCodec
+{
+    PHYSFS_uint16 method;
+    PHYSFS_uint64 size;  /* uncompressed size of the entry. */
+
+    /* LZMA: in .zip, the raw stream follows a version and its properties. */
+    PHYSFS_uint8 header[ZIPCODEC_LZMA_HEADERLEN];
+    size_t headerlen;  /* bytes of (header) we have so far. */
+    int allocated;  /* non-zero once (lzma) has probabilities and a dict. */
+    CLzmaDec lzma;
+    SizeT dicBufSize;
+
+    #if PHYSFS_HAVE_ZSTD
+    ZSTD_DStream *zstd;
+    #endif
+};
+
+
+static void *zipCodecLzmaAlloc(void *p, size_t size)
+{
+    return allocator.Malloc(size ? size : 1);
+} /* zipCodecLzmaAlloc */
+
+static void zipCodecLzmaFree(void *p, void *address)
+{
+    if (address)
+        allocator.Free(address);
+} /* zipCodecLzmaFree */
+
+static ISzAlloc zipCodecSzAlloc = {
+    zipCodecLzmaAlloc, zipCodecLzmaFree
+};
+
+
+int __PHYSFS_zipCodecSupported(const PHYSFS_uint16 method)
+{
+    switch (method)
+    {
+        case ZIP_COMPMETH_LZMA: return 1;
+        #if PHYSFS_HAVE_ZSTD
+        case ZIP_COMPMETH_ZSTD: return 1;
+        #endif
+        default: break;
+    } /* switch */
+
+    return 0;
+} /* __PHYSFS_zipCodecSupported */
+
+
+__PHYSFS_ZipCodec *__PHYSFS_zipCodecCreate(const PHYSFS_uint16 method,
+                                           const PHYSFS_uint64 size)
+{
+    __PHYSFS_ZipCodec *codec;
+
+    BAIL_IF(!__PHYSFS_zipCodecSupported(method), PHYSFS_ERR_UNSUPPORTED, NULL);
+
+    codec = (__PHYSFS_ZipCodec *) allocator.Malloc(sizeof (*codec));
+    BAIL_IF(!codec, PHYSFS_ERR_OUT_OF_MEMORY, NULL);
+    memset(codec, '\0', sizeof (*codec));
+    codec->method = method;
+    codec->size = size;
+    LzmaDec_Construct(&codec->lzma);
+
+    #if PHYSFS_HAVE_ZSTD
+    if (method == ZIP_COMPMETH_ZSTD)
+    {
+        /* libzstd's custom allocators are in its unstable API; use malloc. */
+        codec->zstd = ZSTD_createDStream();
+        if ( (codec->zstd == NULL) ||
+             (ZSTD_isError(ZSTD_initDStream(codec->zstd))) )
+        {
+            __PHYSFS_zipCodecDestroy(codec);
+            BAIL(PHYSFS_ERR_OUT_OF_MEMORY, NULL);
+        } /* if */
+    } /* if */
+    #endif
+
+    return codec;
+} /* __PHYSFS_zipCodecCreate */
+
+
+void __PHYSFS_zipCodecDestroy(__PHYSFS_ZipCodec *codec)
+{
+    if (codec->allocated)
+    {
+        LzmaDec_FreeProbs(&codec->lzma, &zipCodecSzAlloc);
+        allocator.Free(codec->lzma.dic);
+    } /* if */
+
+    #if PHYSFS_HAVE_ZSTD
+    if (codec->zstd != NULL)
+        ZSTD_freeDStream(codec->zstd);
+    #endif
+
+    allocator.Free(codec);
+} /* __PHYSFS_zipCodecDestroy */
+
+
+int __PHYSFS_zipCodecReset(__PHYSFS_ZipCodec *codec)
+{
+    codec->headerlen = 0;  /* LZMA starts over at its header. */
+
+    #if PHYSFS_HAVE_ZSTD
+    if (codec->zstd != NULL)
+    {
+        BAIL_IF(ZSTD_isError(ZSTD_initDStream(codec->zstd)),
+                PHYSFS_ERR_OTHER_ERROR, 0);
+    } /* if */
+    #endif
+
+    return 1;
+} /* __PHYSFS_zipCodecReset */
+
+
+/* the header's all here; get the decoder going with what it says. */
+static int zipCodecLzmaStart(__PHYSFS_ZipCodec *codec)
+{
+    const PHYSFS_uint8 *hdr = codec->header;
+    const PHYSFS_uint16 propslen = (PHYSFS_uint16) (hdr[2] | (hdr[3] << 8));
+    PHYSFS_uint64 dicSize;
+
+    /* hdr[0] and hdr[1] are the LZMA SDK version that wrote this. */
+    BAIL_IF(propslen != LZMA_PROPS_SIZE, PHYSFS_ERR_CORRUPT, 0);
+
+    if (!codec->allocated)
+    {
+        BAIL_IF(LzmaDec_AllocateProbs(&codec->lzma, hdr + 4, LZMA_PROPS_SIZE,
+                                      &zipCodecSzAlloc) != SZ_OK,
+                PHYSFS_ERR_OUT_OF_MEMORY, 0);
+
+        /* the dictionary never needs to be bigger than the entry itself. */
+        dicSize = codec->lzma.prop.dicSize;
+        if (dicSize > codec->size)
+            dicSize = codec->size;
+        if (dicSize == 0)
+            dicSize = 1;
+        codec->dicBufSize = (SizeT) dicSize;
+        codec->lzma.dic = (Byte *) allocator.Malloc((size_t) dicSize);
+        if (!codec->lzma.dic)
+        {
+            LzmaDec_FreeProbs(&codec->lzma, &zipCodecSzAlloc);
+            BAIL(PHYSFS_ERR_OUT_OF_MEMORY, 0);
+        } /* if */
+        codec->lzma.dicBufSize = codec->dicBufSize;
+        codec->allocated = 1;
+    } /* if */
+
+    LzmaDec_Init(&codec->lzma);
+    return 1;
+} /* zipCodecLzmaStart */
+
+
+static PHYSFS_sint64 zipCodecLzmaDecode(__PHYSFS_ZipCodec *codec,
+                                        const PHYSFS_uint8 **src,
+                                        size_t *srclen, PHYSFS_uint8 *dst,
+                                        size_t dstlen)
+{
+    CLzmaDec *dec = &codec->lzma;
+    PHYSFS_sint64 retval = 0;
+
+    if (codec->headerlen < ZIPCODEC_LZMA_HEADERLEN)
+    {
+        size_t cpy = ZIPCODEC_LZMA_HEADERLEN - codec->headerlen;
+        if (cpy > *srclen)
+            cpy = *srclen;
+        memcpy(codec->header + codec->headerlen, *src, cpy);
+        codec->headerlen += cpy;
+        *src += cpy;
+        *srclen -= cpy;
+        if (codec->headerlen < ZIPCODEC_LZMA_HEADERLEN)
+            return 0;  /* need more input. */
+        BAIL_IF_ERRPASS(!zipCodecLzmaStart(codec), -1);
+    } /* if */
+
+    while (dstlen > 0)
+    {
+        SizeT dicPos, dicLimit, inProcessed, outProcessed;
+        ELzmaStatus status;
+        SRes rc;
+
+        if (dec->dicPos == codec->dicBufSize)
+            dec->dicPos = 0;  /* wrap around, like LzmaDec_DecodeToBuf does. */
+        dicPos = dec->dicPos;
+        dicLimit = (codec->dicBufSize - dicPos > dstlen) ?
+                        dicPos + dstlen : codec->dicBufSize;
+
+        inProcessed = (SizeT) *srclen;
+        rc = LzmaDec_DecodeToDic(dec, dicLimit, *src, &inProcessed,
+                                 LZMA_FINISH_ANY, &status);
+        BAIL_IF(rc != SZ_OK, PHYSFS_ERR_CORRUPT, -1);
+
+        outProcessed = dec->dicPos - dicPos;
+        memcpy(dst, dec->dic + dicPos, outProcessed);
+        *src += inProcessed;
+        *srclen -= inProcessed;
+        dst += outProcessed;
+        dstlen -= outProcessed;
+        retval += (PHYSFS_sint64) outProcessed;
+
+        if ((inProcessed == 0) && (outProcessed == 0))
+            break;  /* needs more input. */
+        else if (status == LZMA_STATUS_FINISHED_WITH_MARK)
+            break;  /* that's the end of it. */
+    } /* while */
+
+    return retval;
+} /* zipCodecLzmaDecode */
+
+
+#if PHYSFS_HAVE_ZSTD
+static PHYSFS_ErrorCode zipCodecZstdError(const size_t rc)
+{
+    if (ZSTD_getErrorCode(rc) == ZSTD_error_memory_allocation)
+        return PHYSFS_ERR_OUT_OF_MEMORY;
+    return PHYSFS_ERR_CORRUPT;
+} /* zipCodecZstdError */
+
+
+static PHYSFS_sint64 zipCodecZstdDecode(__PHYSFS_ZipCodec *codec,
+                                        const PHYSFS_uint8 **src,
+                                        size_t *srclen, PHYSFS_uint8 *dst,
+                                        size_t dstlen)
+{
+    ZSTD_inBuffer in;
+    ZSTD_outBuffer out;
+
+    in.src = *src;
+    in.size = *srclen;
+    in.pos = 0;
+    out.dst = dst;
+    out.size = dstlen;
+    out.pos = 0;
+
+    while (out.pos < out.size)
+    {
+        const size_t inpos = in.pos;
+        const size_t outpos = out.pos;
+        const size_t rc = ZSTD_decompressStream(codec->zstd, &out, &in);
+        BAIL_IF(ZSTD_isError(rc), zipCodecZstdError(rc), -1);
+        if ((in.pos == inpos) && (out.pos == outpos))
+            break;  /* needs more input. */
+    } /* while */
+
+    *src += in.pos;
+    *srclen -= in.pos;
+    return (PHYSFS_sint64) out.pos;
+} /* zipCodecZstdDecode */
+#endif
+
+
+PHYSFS_sint64 __PHYSFS_zipCodecDecode(__PHYSFS_ZipCodec *codec,
+                                      const PHYSFS_uint8 **src,
+                                      size_t *srclen, PHYSFS_uint8 *dst,
+                                      const size_t dstlen)
+{
+    #if PHYSFS_HAVE_ZSTD
+    if (codec->method == ZIP_COMPMETH_ZSTD)
+        return zipCodecZstdDecode(codec, src, srclen, dst, dstlen);
+    #endif
+    return zipCodecLzmaDecode(codec, src, srclen, dst, dstlen);
+} /* __PHYSFS_zipCodecDecode */
+
+
+int __PHYSFS_zipCodecDecodeWhole(const PHYSFS_uint16 method,
+                                 const void *src, const size_t srclen,
+                                 void *dst, const size_t dstlen)
+{
+    const PHYSFS_uint8 *in = (const PHYSFS_uint8 *) src;
+    size_t inlen = srclen;
+    __PHYSFS_ZipCodec *codec;
+    PHYSFS_sint64 rc;
+
+    #if PHYSFS_HAVE_ZSTD
+    if (method == ZIP_COMPMETH_ZSTD)  /* no need for a whole stream. */
+    {
+        const size_t br = ZSTD_decompress(dst, dstlen, src, srclen);
+        BAIL_IF(ZSTD_isError(br), zipCodecZstdError(br), 0);
+        BAIL_IF(br != dstlen, PHYSFS_ERR_CORRUPT, 0);
+        return 1;
+    } /* if */
+    #endif
+
+    codec = __PHYSFS_zipCodecCreate(method, dstlen);
+    BAIL_IF_ERRPASS(!codec, 0);
+    rc = __PHYSFS_zipCodecDecode(codec, &in, &inlen, (PHYSFS_uint8 *) dst,
+                                 dstlen);
+    __PHYSFS_zipCodecDestroy(codec);
+    BAIL_IF_ERRPASS(rc < 0, 0);
+    BAIL_IF(rc != (PHYSFS_sint64) dstlen, PHYSFS_ERR_CORRUPT, 0);
+    return 1;
+} /* __PHYSFS_zipCodecDecodeWhole */
+
+#endif  /* PHYSFS_SUPPORTS_ZIP */
+
+/* end of physfs_zipcodec.c ... */
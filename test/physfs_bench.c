@@ -0,0 +1,1443 @@
+/**
+ * Benchmarks for PhysicsFS's core paths.
+ *
+ * This builds a set of synthetic archives (byte-for-byte the same every run,
+ *  for a given scale), then times mounting, lookups, enumeration and reads
+ *  against each of them, single- and multi-threaded. Every result is printed
+ *  as one JSON object per line on stdout, so runs can be diffed or fed to
+ *  whatever tracks regressions; progress and errors go to stderr.
+ *
+ * The archives are written through PhysicsFS's own write support, with a
+ *  tiny zip writer (and fixed-Huffman deflater) and 7z writer in here, so
+ *  this needs nothing but the library to run.
+ *
+ * Please see the file LICENSE.txt in the source's root directory.
+ *
+ *  This file written by Ryan C. Gordon.
+ */
+
+#define _CRT_SECURE_NO_WARNINGS 1
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <pthread.h>
+#include <sys/time.h>
+#include <time.h>
+#endif
+
+#include "physfs.h"
+
+#define BENCH_VERSION_MAJOR  3
+#define BENCH_VERSION_MINOR  1
+#define BENCH_VERSION_PATCH  0
+
+#define MANY_FILES 20000     /* entries in many.zip, times the scale. */
+#define MANY_DIRS 200
+#define DEEP_CHAINS 64       /* deep.zip: this many chains of... */
+#define DEEP_LEVELS 24       /*  ...this many nested directories. */
+#define BIG_SIZE (16 * 1024 * 1024)  /* big files, times the scale. */
+#define SOLID_FILES 64       /* files in solid.7z's one block. */
+#define SOLID_SIZE (256 * 1024)
+#define LOOSE_FILES 1000     /* small files in the native directory. */
+#define MAX_THREADS 64
+
+static const char *dataDir = NULL;
+static const char *filter = NULL;
+static int scale = 1;
+static int reps = 3;
+static int numThreads = 4;
+
+
+/* Helpers... */
+
+static void fail(const char *what)
+{
+    fprintf(stderr, "physfs_bench: %s: %s\n", what,
+            PHYSFS_getErrorByCode(PHYSFS_getLastErrorCode()));
+    exit(1);
+} /* fail */
+
+
+static PHYSFS_uint64 nowNS(void)
+{
+#ifdef _WIN32
+    LARGE_INTEGER freq, now;
+    QueryPerformanceFrequency(&freq);
+    QueryPerformanceCounter(&now);
+    return (PHYSFS_uint64) ((((double) now.QuadPart) * 1000000000.0) /
+                            ((double) freq.QuadPart));
+#elif defined(CLOCK_MONOTONIC)
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (((PHYSFS_uint64) ts.tv_sec) * 1000000000) + ts.tv_nsec;
+#else
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return (((PHYSFS_uint64) tv.tv_sec) * 1000000000) + (tv.tv_usec * 1000);
+#endif
+} /* nowNS */
+
+
+/* xorshift; plenty random for picking names, and the same everywhere. */
+static PHYSFS_uint32 rng(PHYSFS_uint32 *state)
+{
+    PHYSFS_uint32 x = *state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    *state = x;
+    return x;
+} /* rng */
+
+
+static PHYSFS_uint32 crcTable[256];
+
+static void initCrc32(void)
+{
+    PHYSFS_uint32 i, j;
+    for (i = 0; i < 256; i++)
+    {
+        PHYSFS_uint32 c = i;
+        for (j = 0; j < 8; j++)
+            c = (c & 1) ? (0xEDB88320 ^ (c >> 1)) : (c >> 1);
+        crcTable[i] = c;
+    } /* for */
+} /* initCrc32 */
+
+
+static PHYSFS_uint32 crc32(const PHYSFS_uint8 *buf, size_t len)
+{
+    PHYSFS_uint32 crc = 0xFFFFFFFF;
+    while (len--)
+        crc = crcTable[(crc ^ *(buf++)) & 0xFF] ^ (crc >> 8);
+    return crc ^ 0xFFFFFFFF;
+} /* crc32 */
+
+
+static void *xmalloc(size_t len)
+{
+    void *retval = malloc(len ? len : 1);
+    if (retval == NULL)
+    {
+        fprintf(stderr, "physfs_bench: out of memory\n");
+        exit(1);
+    } /* if */
+    return retval;
+} /* xmalloc */
+
+
+static char *xstrdup(const char *str)
+{
+    char *retval = (char *) xmalloc(strlen(str) + 1);
+    strcpy(retval, str);
+    return retval;
+} /* xstrdup */
+
+
+typedef struct
+{
+    PHYSFS_uint8 *data;
+    size_t len;
+    size_t alloc;
+} Buffer;
+
+static void bufReserve(Buffer *buf, size_t len)
+{
+    if (buf->len + len > buf->alloc)
+    {
+        size_t newalloc = buf->alloc ? buf->alloc : 4096;
+        void *ptr;
+        while (newalloc < buf->len + len)
+            newalloc *= 2;
+        ptr = realloc(buf->data, newalloc);
+        if (ptr == NULL)
+        {
+            fprintf(stderr, "physfs_bench: out of memory\n");
+            exit(1);
+        } /* if */
+        buf->data = (PHYSFS_uint8 *) ptr;
+        buf->alloc = newalloc;
+    } /* if */
+} /* bufReserve */
+
+static void bufAppend(Buffer *buf, const void *data, size_t len)
+{
+    bufReserve(buf, len);
+    memcpy(buf->data + buf->len, data, len);
+    buf->len += len;
+} /* bufAppend */
+
+static void bufByte(Buffer *buf, PHYSFS_uint8 val)
+{
+    bufAppend(buf, &val, 1);
+} /* bufByte */
+
+static void bufLE16(Buffer *buf, PHYSFS_uint32 val)
+{
+    bufByte(buf, (PHYSFS_uint8) (val & 0xFF));
+    bufByte(buf, (PHYSFS_uint8) ((val >> 8) & 0xFF));
+} /* bufLE16 */
+
+static void bufLE32(Buffer *buf, PHYSFS_uint32 val)
+{
+    bufLE16(buf, val & 0xFFFF);
+    bufLE16(buf, val >> 16);
+} /* bufLE32 */
+
+static void bufLE64(Buffer *buf, PHYSFS_uint64 val)
+{
+    bufLE32(buf, (PHYSFS_uint32) (val & 0xFFFFFFFF));
+    bufLE32(buf, (PHYSFS_uint32) (val >> 32));
+} /* bufLE64 */
+
+
+/*
+ * Text-ish filler: words from a small made-up vocabulary, so it deflates
+ *  about as well as real data files do instead of all or nothing.
+ */
+static void fillContent(PHYSFS_uint8 *buf, size_t len, PHYSFS_uint32 seed)
+{
+    static const char *syllables[] = {
+        "ka", "zu", "ren", "to", "mi", "dar", "el", "qo", "vin", "sha",
+        "lo", "pe", "gri", "nax", "u", "bo", "tes", "ja", "fy", "ol"
+    };
+    PHYSFS_uint32 state = seed ? seed : 1;
+    size_t i = 0;
+
+    while (i < len)
+    {
+        const PHYSFS_uint32 r = rng(&state);
+        const int nsyl = 1 + (int) (r % 3);
+        int j;
+        for (j = 0; (j < nsyl) && (i < len); j++)
+        {
+            /* skew it, so some words are much more common than others. */
+            const char *s = syllables[((r >> (8 + j * 4)) & 0xF) % 20];
+            while ((*s) && (i < len))
+                buf[i++] = (PHYSFS_uint8) *(s++);
+        } /* for */
+        if (i < len)
+            buf[i++] = ((r >> 28) == 0) ? '\n' : ' ';
+    } /* while */
+} /* fillContent */
+
+
+/* Deflate... fixed Huffman codes and greedy matching; small, not clever. */
+
+typedef struct
+{
+    Buffer *out;
+    PHYSFS_uint32 bits;
+    int nbits;
+} BitWriter;
+
+static void putBits(BitWriter *bw, PHYSFS_uint32 val, int n)
+{
+    bw->bits |= val << bw->nbits;
+    bw->nbits += n;
+    while (bw->nbits >= 8)
+    {
+        bufByte(bw->out, (PHYSFS_uint8) (bw->bits & 0xFF));
+        bw->bits >>= 8;
+        bw->nbits -= 8;
+    } /* while */
+} /* putBits */
+
+static void putCode(BitWriter *bw, PHYSFS_uint32 code, int n)
+{
+    PHYSFS_uint32 reversed = 0;  /* Huffman codes go in MSB first. */
+    int i;
+    for (i = 0; i < n; i++)
+        reversed |= ((code >> i) & 1) << (n - 1 - i);
+    putBits(bw, reversed, n);
+} /* putCode */
+
+static void putLiteral(BitWriter *bw, int sym)
+{
+    if (sym <= 143)
+        putCode(bw, 0x30 + sym, 8);
+    else if (sym <= 255)
+        putCode(bw, 0x190 + (sym - 144), 9);
+    else if (sym <= 279)
+        putCode(bw, sym - 256, 7);
+    else
+        putCode(bw, 0xC0 + (sym - 280), 8);
+} /* putLiteral */
+
+static void putMatch(BitWriter *bw, int len, int dist)
+{
+    static const int lenBase[29] = {
+        3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51,
+        59, 67, 83, 99, 115, 131, 163, 195, 227, 258
+    };
+    static const int lenExtra[29] = {
+        0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4,
+        4, 5, 5, 5, 5, 0
+    };
+    static const int distBase[30] = {
+        1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385,
+        513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385,
+        24577
+    };
+    static const int distExtra[30] = {
+        0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10,
+        10, 11, 11, 12, 12, 13, 13
+    };
+    int i;
+
+    for (i = 28; lenBase[i] > len; i--) { /* spin. */ }
+    putLiteral(bw, 257 + i);
+    putBits(bw, (PHYSFS_uint32) (len - lenBase[i]), lenExtra[i]);
+
+    for (i = 29; distBase[i] > dist; i--) { /* spin. */ }
+    putCode(bw, (PHYSFS_uint32) i, 5);
+    putBits(bw, (PHYSFS_uint32) (dist - distBase[i]), distExtra[i]);
+} /* putMatch */
+
+#define DEFLATE_HASH_BITS 15
+#define DEFLATE_WINDOW 32768
+
+static void deflateData(const PHYSFS_uint8 *src, size_t len, Buffer *out)
+{
+    static PHYSFS_sint32 head[1 << DEFLATE_HASH_BITS];
+    BitWriter bw;
+    size_t pos = 0;
+
+    bw.out = out;
+    bw.bits = 0;
+    bw.nbits = 0;
+    memset(head, 0xFF, sizeof (head));
+
+    putBits(&bw, 1, 1);  /* final block... */
+    putBits(&bw, 1, 2);  /* ...with fixed Huffman codes. */
+
+    while (pos < len)
+    {
+        int matchlen = 0;
+        size_t dist = 0;
+
+        if (pos + 3 <= len)
+        {
+            const PHYSFS_uint32 h = ((src[pos] << 10) ^ (src[pos+1] << 5) ^
+                                     src[pos+2]) & ((1 << DEFLATE_HASH_BITS) - 1);
+            const PHYSFS_sint32 cand = head[h];
+            head[h] = (PHYSFS_sint32) pos;
+            if ((cand >= 0) && ((pos - cand) <= DEFLATE_WINDOW))
+            {
+                const size_t maxlen = ((len - pos) < 258) ? (len - pos) : 258;
+                size_t l = 0;
+                while ((l < maxlen) && (src[cand + l] == src[pos + l]))
+                    l++;
+                if (l >= 3)
+                {
+                    matchlen = (int) l;
+                    dist = pos - cand;
+                } /* if */
+            } /* if */
+        } /* if */
+
+        if (matchlen == 0)
+            putLiteral(&bw, src[pos++]);
+        else
+        {
+            putMatch(&bw, matchlen, (int) dist);
+            pos += matchlen;
+        } /* else */
+    } /* while */
+
+    putLiteral(&bw, 256);  /* end of block. */
+    putBits(&bw, 0, (8 - bw.nbits) & 7);
+} /* deflateData */
+
+
+/* Archive writers... */
+
+static void writeFile(const char *fname, const void *data, size_t len)
+{
+    PHYSFS_File *f = PHYSFS_openWrite(fname);
+    if (!f)
+        fail(fname);
+    else if (PHYSFS_writeBytes(f, data, len) != (PHYSFS_sint64) len)
+        fail(fname);
+    else if (!PHYSFS_close(f))
+        fail(fname);
+} /* writeFile */
+
+
+typedef struct
+{
+    Buffer data;
+    Buffer central;
+    PHYSFS_uint32 count;
+} ZipWriter;
+
+static void zipAdd(ZipWriter *zip, const char *name, const PHYSFS_uint8 *buf,
+                   size_t len, int compress)
+{
+    const size_t namelen = strlen(name);
+    const int isdir = (namelen > 0) && (name[namelen - 1] == '/');
+    const PHYSFS_uint32 offset = (PHYSFS_uint32) zip->data.len;
+    const PHYSFS_uint32 crc = crc32(buf, len);
+    const PHYSFS_uint32 dostime = 0x5A8C6000;  /* 2025-04-12, 12:00:00. */
+    Buffer packed;
+    const PHYSFS_uint8 *payload = buf;
+    size_t payloadlen = len;
+    int method = 0;
+
+    memset(&packed, '\0', sizeof (packed));
+    if ((compress) && (len > 0))
+    {
+        deflateData(buf, len, &packed);
+        if (packed.len < len)
+        {
+            payload = packed.data;
+            payloadlen = packed.len;
+            method = 8;
+        } /* if */
+    } /* if */
+
+    bufLE32(&zip->data, 0x04034B50);
+    bufLE16(&zip->data, 20);        /* version needed. */
+    bufLE16(&zip->data, 0);         /* flags. */
+    bufLE16(&zip->data, method);
+    bufLE32(&zip->data, dostime);
+    bufLE32(&zip->data, crc);
+    bufLE32(&zip->data, (PHYSFS_uint32) payloadlen);
+    bufLE32(&zip->data, (PHYSFS_uint32) len);
+    bufLE16(&zip->data, (PHYSFS_uint32) namelen);
+    bufLE16(&zip->data, 0);         /* extra field length. */
+    bufAppend(&zip->data, name, namelen);
+    bufAppend(&zip->data, payload, payloadlen);
+
+    bufLE32(&zip->central, 0x02014B50);
+    bufLE16(&zip->central, 20);     /* version made by. */
+    bufLE16(&zip->central, 20);     /* version needed. */
+    bufLE16(&zip->central, 0);      /* flags. */
+    bufLE16(&zip->central, method);
+    bufLE32(&zip->central, dostime);
+    bufLE32(&zip->central, crc);
+    bufLE32(&zip->central, (PHYSFS_uint32) payloadlen);
+    bufLE32(&zip->central, (PHYSFS_uint32) len);
+    bufLE16(&zip->central, (PHYSFS_uint32) namelen);
+    bufLE16(&zip->central, 0);      /* extra field length. */
+    bufLE16(&zip->central, 0);      /* comment length. */
+    bufLE16(&zip->central, 0);      /* disk number. */
+    bufLE16(&zip->central, 0);      /* internal attributes. */
+    bufLE32(&zip->central, isdir ? 0x10 : 0);  /* external attributes. */
+    bufLE32(&zip->central, offset);
+    bufAppend(&zip->central, name, namelen);
+    zip->count++;
+
+    free(packed.data);
+} /* zipAdd */
+
+static void zipFinish(ZipWriter *zip, const char *fname)
+{
+    const PHYSFS_uint32 cdofs = (PHYSFS_uint32) zip->data.len;
+    const PHYSFS_uint32 cdlen = (PHYSFS_uint32) zip->central.len;
+    bufAppend(&zip->data, zip->central.data, zip->central.len);
+    bufLE32(&zip->data, 0x06054B50);
+    bufLE16(&zip->data, 0);         /* this disk. */
+    bufLE16(&zip->data, 0);         /* disk with the central dir. */
+    bufLE16(&zip->data, zip->count);
+    bufLE16(&zip->data, zip->count);
+    bufLE32(&zip->data, cdlen);
+    bufLE32(&zip->data, cdofs);
+    bufLE16(&zip->data, 0);         /* comment length. */
+    writeFile(fname, zip->data.data, zip->data.len);
+    free(zip->data.data);
+    free(zip->central.data);
+    memset(zip, '\0', sizeof (*zip));
+} /* zipFinish */
+
+
+/* 7z's variable-length numbers. */
+static void bufNum7z(Buffer *buf, PHYSFS_uint64 val)
+{
+    int i;
+    for (i = 0; i < 8; i++)
+    {
+        if (val < (((PHYSFS_uint64) 1) << (7 * (i + 1))))
+        {
+            const PHYSFS_uint8 high = (PHYSFS_uint8) (val >> (8 * i));
+            int j;
+            bufByte(buf, (PHYSFS_uint8) (((0xFF << (8 - i)) & 0xFF) | high));
+            for (j = 0; j < i; j++)
+                bufByte(buf, (PHYSFS_uint8) ((val >> (8 * j)) & 0xFF));
+            return;
+        } /* if */
+    } /* for */
+
+    bufByte(buf, 0xFF);
+    bufLE64(buf, val);
+} /* bufNum7z */
+
+/*
+ * One solid block of (count) files, stored with the Copy coder: the solid
+ *  block plumbing and the block cache get exercised without needing an
+ *  LZMA encoder in here.
+ */
+static void write7z(const char *fname, char **names, PHYSFS_uint8 **bufs,
+                    const size_t *lens, int count)
+{
+    Buffer out, hdr, start;
+    size_t total = 0;
+    size_t nameslen = 0;
+    PHYSFS_uint8 sig[12] = { '7', 'z', 0xBC, 0xAF, 0x27, 0x1C, 0, 4 };
+    PHYSFS_uint32 crc;
+    int i;
+
+    memset(&out, '\0', sizeof (out));
+    memset(&hdr, '\0', sizeof (hdr));
+    memset(&start, '\0', sizeof (start));
+
+    for (i = 0; i < count; i++)
+    {
+        total += lens[i];
+        nameslen += (strlen(names[i]) + 1) * 2;
+    } /* for */
+
+    bufByte(&hdr, 0x01);  /* header */
+    bufByte(&hdr, 0x04);  /* main streams info */
+    bufByte(&hdr, 0x06);  /* pack info */
+    bufNum7z(&hdr, 0);
+    bufNum7z(&hdr, 1);
+    bufByte(&hdr, 0x09);  /* sizes */
+    bufNum7z(&hdr, total);
+    bufByte(&hdr, 0x00);
+    bufByte(&hdr, 0x07);  /* unpack info */
+    bufByte(&hdr, 0x0B);  /* folders */
+    bufNum7z(&hdr, 1);
+    bufByte(&hdr, 0x00);  /* not external */
+    bufNum7z(&hdr, 1);    /* one coder... */
+    bufByte(&hdr, 0x01);  /* ...with a one-byte id... */
+    bufByte(&hdr, 0x00);  /* ...which is Copy. */
+    bufByte(&hdr, 0x0C);  /* unpack sizes */
+    bufNum7z(&hdr, total);
+    bufByte(&hdr, 0x00);
+    bufByte(&hdr, 0x08);  /* substreams info */
+    bufByte(&hdr, 0x0D);  /* files per folder */
+    bufNum7z(&hdr, count);
+    bufByte(&hdr, 0x09);  /* sizes, but the last */
+    for (i = 0; i < count - 1; i++)
+        bufNum7z(&hdr, lens[i]);
+    bufByte(&hdr, 0x0A);  /* CRCs */
+    bufByte(&hdr, 0x01);  /* all defined */
+    for (i = 0; i < count; i++)
+        bufLE32(&hdr, crc32(bufs[i], lens[i]));
+    bufByte(&hdr, 0x00);
+    bufByte(&hdr, 0x00);
+    bufByte(&hdr, 0x05);  /* files info */
+    bufNum7z(&hdr, count);
+    bufByte(&hdr, 0x11);  /* names */
+    bufNum7z(&hdr, nameslen + 1);
+    bufByte(&hdr, 0x00);  /* not external */
+    for (i = 0; i < count; i++)
+    {
+        const char *ptr;
+        for (ptr = names[i]; *ptr; ptr++)
+            bufLE16(&hdr, (PHYSFS_uint8) *ptr);
+        bufLE16(&hdr, 0);
+    } /* for */
+    bufByte(&hdr, 0x00);
+    bufByte(&hdr, 0x00);
+
+    bufLE64(&start, total);    /* next header offset */
+    bufLE64(&start, hdr.len);  /* next header size */
+    bufLE32(&start, crc32(hdr.data, hdr.len));
+    crc = crc32(start.data, start.len);
+    sig[8] = (PHYSFS_uint8) (crc & 0xFF);
+    sig[9] = (PHYSFS_uint8) ((crc >> 8) & 0xFF);
+    sig[10] = (PHYSFS_uint8) ((crc >> 16) & 0xFF);
+    sig[11] = (PHYSFS_uint8) ((crc >> 24) & 0xFF);
+
+    bufAppend(&out, sig, sizeof (sig));
+    bufAppend(&out, start.data, start.len);
+    for (i = 0; i < count; i++)
+        bufAppend(&out, bufs[i], lens[i]);
+    bufAppend(&out, hdr.data, hdr.len);
+    writeFile(fname, out.data, out.len);
+
+    free(out.data);
+    free(hdr.data);
+    free(start.data);
+} /* write7z */
+
+
+/* The data set... */
+
+typedef struct
+{
+    const char *name;   /* archive, relative to dataDir. */
+    const char *label;  /* what to call it in the results. */
+    int snapshot;       /* non-zero to mount with PHYSFS_snapshotDirectories. */
+    char **files;       /* every file in it, for lookups and reads. */
+    int numFiles;
+    const char *big;    /* a big file in it to read, or NULL. */
+    PHYSFS_uint32 bigCrc;
+    const char *big2;   /* another, or NULL. */
+    PHYSFS_uint32 big2Crc;
+} Archive;
+
+enum { ARC_MANY, ARC_DEEP, ARC_BIG, ARC_SOLID, ARC_DIR, ARC_SNAPSHOT,
+       ARC_TOTAL };
+static Archive archives[ARC_TOTAL];
+
+static char *archivePath(const Archive *arc)
+{
+    const char *sep = PHYSFS_getDirSeparator();
+    char *retval = (char *) xmalloc(strlen(dataDir) + strlen(sep) +
+                                    strlen(arc->name) + 1);
+    strcpy(retval, dataDir);
+    if ((*retval) && (strcmp(retval + strlen(retval) - strlen(sep), sep) != 0))
+        strcat(retval, sep);
+    strcat(retval, arc->name);
+    return retval;
+} /* archivePath */
+
+
+static void makeMany(Archive *arc)
+{
+    const int count = MANY_FILES * scale;
+    PHYSFS_uint8 buf[4096];
+    PHYSFS_uint32 state = 0x1234;
+    ZipWriter zip;
+    char name[64];
+    int i;
+
+    memset(&zip, '\0', sizeof (zip));
+    arc->name = "many.zip";
+    arc->files = (char **) xmalloc(sizeof (char *) * count);
+    arc->numFiles = count;
+
+    for (i = 0; i < count; i++)
+    {
+        const size_t len = 100 + (rng(&state) % (sizeof (buf) - 100));
+        snprintf(name, sizeof (name), "d%03d/file%06d.txt", i % MANY_DIRS, i);
+        fillContent(buf, len, (PHYSFS_uint32) i + 1);
+        zipAdd(&zip, name, buf, len, 1);
+        arc->files[i] = xstrdup(name);
+    } /* for */
+
+    zipFinish(&zip, arc->name);
+} /* makeMany */
+
+
+static void makeDeep(Archive *arc)
+{
+    const int count = DEEP_CHAINS * (DEEP_LEVELS + 4);
+    PHYSFS_uint8 buf[256];
+    ZipWriter zip;
+    char name[512];
+    int chain, level, i;
+    int n = 0;
+
+    memset(&zip, '\0', sizeof (zip));
+    arc->name = "deep.zip";
+    arc->files = (char **) xmalloc(sizeof (char *) * count);
+    arc->numFiles = count;
+
+    for (chain = 0; chain < DEEP_CHAINS; chain++)
+    {
+        size_t pos = (size_t) snprintf(name, sizeof (name), "c%02d", chain);
+        for (level = 0; level < DEEP_LEVELS; level++)
+        {
+            const int files = (level == DEEP_LEVELS - 1) ? 5 : 1;
+            pos += (size_t) snprintf(name + pos, sizeof (name) - pos,
+                                     "/level%02d", level);
+            for (i = 0; i < files; i++)
+            {
+                snprintf(name + pos, sizeof (name) - pos, "/f%d.dat", i);
+                fillContent(buf, sizeof (buf), (PHYSFS_uint32) n + 7);
+                zipAdd(&zip, name, buf, sizeof (buf), 0);
+                arc->files[n++] = xstrdup(name);
+            } /* for */
+            name[pos] = '\0';
+        } /* for */
+    } /* for */
+
+    arc->numFiles = n;
+    zipFinish(&zip, arc->name);
+} /* makeDeep */
+
+
+static void makeBig(Archive *arc)
+{
+    const size_t len = (size_t) BIG_SIZE * scale;
+    PHYSFS_uint8 *buf = (PHYSFS_uint8 *) xmalloc(len);
+    ZipWriter zip;
+
+    memset(&zip, '\0', sizeof (zip));
+    arc->name = "big.zip";
+    arc->files = (char **) xmalloc(sizeof (char *) * 2);
+    arc->files[0] = xstrdup("stored.bin");
+    arc->files[1] = xstrdup("deflated.bin");
+    arc->numFiles = 2;
+
+    fillContent(buf, len, 0xB16);
+    zipAdd(&zip, "stored.bin", buf, len, 0);
+    arc->big = "stored.bin";
+    arc->bigCrc = crc32(buf, len);
+
+    fillContent(buf, len, 0xB17);
+    zipAdd(&zip, "deflated.bin", buf, len, 1);
+    arc->big2 = "deflated.bin";
+    arc->big2Crc = crc32(buf, len);
+
+    zipFinish(&zip, arc->name);
+    free(buf);
+} /* makeBig */
+
+
+static void makeSolid(Archive *arc)
+{
+    const size_t len = (size_t) SOLID_SIZE * scale;
+    PHYSFS_uint8 *bufs[SOLID_FILES];
+    size_t lens[SOLID_FILES];
+    char name[64];
+    int i;
+
+    arc->name = "solid.7z";
+    arc->files = (char **) xmalloc(sizeof (char *) * SOLID_FILES);
+    arc->numFiles = SOLID_FILES;
+
+    for (i = 0; i < SOLID_FILES; i++)
+    {
+        snprintf(name, sizeof (name), "s/file%02d.bin", i);
+        arc->files[i] = xstrdup(name);
+        bufs[i] = (PHYSFS_uint8 *) xmalloc(len);
+        lens[i] = len;
+        fillContent(bufs[i], len, (PHYSFS_uint32) i + 0x50);
+    } /* for */
+
+    arc->big = arc->files[SOLID_FILES / 2];
+    arc->bigCrc = crc32(bufs[SOLID_FILES / 2], len);
+
+    write7z(arc->name, arc->files, bufs, lens, SOLID_FILES);
+    for (i = 0; i < SOLID_FILES; i++)
+        free(bufs[i]);
+} /* makeSolid */
+
+
+static void makeDir(Archive *arc)
+{
+    const size_t biglen = (size_t) BIG_SIZE * scale;
+    PHYSFS_uint8 *buf = (PHYSFS_uint8 *) xmalloc(biglen);
+    char name[64];
+    int i;
+
+    arc->name = "loose";
+    arc->files = (char **) xmalloc(sizeof (char *) * LOOSE_FILES);
+    arc->numFiles = LOOSE_FILES;
+
+    for (i = 0; i < 20; i++)
+    {
+        snprintf(name, sizeof (name), "loose/d%02d", i);
+        if (!PHYSFS_mkdir(name))
+            fail(name);
+    } /* for */
+
+    for (i = 0; i < LOOSE_FILES; i++)
+    {
+        const size_t len = 100 + (((PHYSFS_uint32) i * 2654435761u) % 4000);
+        snprintf(name, sizeof (name), "loose/d%02d/file%04d.txt", i % 20, i);
+        fillContent(buf, len, (PHYSFS_uint32) i + 0xD1);
+        writeFile(name, buf, len);
+        arc->files[i] = xstrdup(name + 6);  /* drop "loose/". */
+    } /* for */
+
+    fillContent(buf, biglen, 0xB18);
+    writeFile("loose/big.bin", buf, biglen);
+    arc->big = "big.bin";
+    arc->bigCrc = crc32(buf, biglen);
+    free(buf);
+} /* makeDir */
+
+
+static void makeDataSet(void)
+{
+    const PHYSFS_uint64 start = nowNS();
+    if (!PHYSFS_setWriteDir(dataDir))
+        fail(dataDir);
+
+    fprintf(stderr, "physfs_bench: writing test data to %s ...\n", dataDir);
+    makeMany(&archives[ARC_MANY]);
+    makeDeep(&archives[ARC_DEEP]);
+    makeBig(&archives[ARC_BIG]);
+    makeSolid(&archives[ARC_SOLID]);
+    makeDir(&archives[ARC_DIR]);
+    archives[ARC_SNAPSHOT] = archives[ARC_DIR];  /* same files, mounted... */
+    archives[ARC_SNAPSHOT].label = "loose_snapshot";  /* ...differently. */
+    archives[ARC_SNAPSHOT].snapshot = 1;
+    fprintf(stderr, "physfs_bench: ...done in %.2f seconds.\n",
+            ((double) (nowNS() - start)) / 1000000000.0);
+
+    if (!PHYSFS_setWriteDir(NULL))
+        fail("PHYSFS_setWriteDir(NULL)");
+} /* makeDataSet */
+
+
+/* Results... */
+
+typedef struct
+{
+    PHYSFS_uint64 ops;
+    PHYSFS_uint64 bytes;
+    int ok;
+} Result;
+
+static void report(const char *bench, const Archive *arc, int threads,
+                   const Result *res, PHYSFS_uint64 ns)
+{
+    const double secs = ((double) ns) / 1000000000.0;
+    printf("{\"bench\":\"%s\",\"archive\":\"%s\",\"threads\":%d,"
+           "\"ops\":%llu,\"bytes\":%llu,\"seconds\":%.6f,"
+           "\"ns_per_op\":%.1f,\"mb_per_s\":%.2f,\"ok\":%s}\n",
+           bench, arc->label ? arc->label : arc->name, threads,
+           (unsigned long long) res->ops, (unsigned long long) res->bytes,
+           secs, res->ops ? ((double) ns) / ((double) res->ops) : 0.0,
+           (secs > 0.0) ? (((double) res->bytes) / (1024.0 * 1024.0)) / secs
+                        : 0.0,
+           res->ok ? "true" : "false");
+    fflush(stdout);
+} /* report */
+
+static void mountArchive(const Archive *arc)
+{
+    char *path = archivePath(arc);
+    if (!PHYSFS_mount(path, NULL, 1))
+        fail(path);
+    free(path);
+} /* mountArchive */
+
+static void unmountArchive(const Archive *arc)
+{
+    char *path = archivePath(arc);
+    if (!PHYSFS_unmount(path))
+        fail(path);
+    free(path);
+} /* unmountArchive */
+
+
+/* Single-threaded benchmarks. Each does one timed run. */
+
+typedef void (*BenchFn)(const Archive *arc, Result *res);
+
+static void benchMount(const Archive *arc, Result *res)
+{
+    const int iterations = (arc->numFiles > 1000) ? 5 : 50;
+    char *path = archivePath(arc);
+    int i;
+
+    for (i = 0; i < iterations; i++)
+    {
+        if (!PHYSFS_mount(path, NULL, 1))
+            fail(path);
+        if (!PHYSFS_unmount(path))
+            fail(path);
+    } /* for */
+
+    free(path);
+    res->ops = iterations;
+} /* benchMount */
+
+static void benchLookupHit(const Archive *arc, Result *res)
+{
+    PHYSFS_uint32 state = 0xBEEF;
+    int i;
+    for (i = 0; i < 200000; i++)
+    {
+        if (!PHYSFS_exists(arc->files[rng(&state) % arc->numFiles]))
+            res->ok = 0;
+    } /* for */
+    res->ops = 200000;
+} /* benchLookupHit */
+
+static void benchLookupMiss(const Archive *arc, Result *res)
+{
+    PHYSFS_uint32 state = 0xF00D;
+    char name[512];
+    int i;
+    for (i = 0; i < 200000; i++)
+    {
+        snprintf(name, sizeof (name), "%s.missing",
+                 arc->files[rng(&state) % arc->numFiles]);
+        if (PHYSFS_exists(name))
+            res->ok = 0;
+    } /* for */
+    res->ops = 200000;
+} /* benchLookupMiss */
+
+static void benchStat(const Archive *arc, Result *res)
+{
+    PHYSFS_uint32 state = 0x5747;
+    PHYSFS_Stat st;
+    int i;
+    for (i = 0; i < 100000; i++)
+    {
+        if (!PHYSFS_stat(arc->files[rng(&state) % arc->numFiles], &st))
+            res->ok = 0;
+        else if (st.filetype != PHYSFS_FILETYPE_REGULAR)
+            res->ok = 0;
+    } /* for */
+    res->ops = 100000;
+} /* benchStat */
+
+
+typedef struct
+{
+    char **dirs;
+    int numDirs;
+    int allocDirs;
+    PHYSFS_uint64 entries;
+} EnumState;
+
+static PHYSFS_EnumerateCallbackResult enumCallback(void *data,
+                                    const char *origdir, const char *fname,
+                                    const PHYSFS_Stat *stat)
+{
+    EnumState *es = (EnumState *) data;
+    es->entries++;
+    if (stat->filetype == PHYSFS_FILETYPE_DIRECTORY)
+    {
+        const size_t len = strlen(origdir) + strlen(fname) + 2;
+        char *path = (char *) xmalloc(len);
+        snprintf(path, len, "%s%s%s", origdir, *origdir ? "/" : "", fname);
+        if (es->numDirs == es->allocDirs)
+        {
+            es->allocDirs = es->allocDirs ? es->allocDirs * 2 : 64;
+            es->dirs = (char **) realloc(es->dirs,
+                                         sizeof (char *) * es->allocDirs);
+            if (es->dirs == NULL)
+            {
+                fprintf(stderr, "physfs_bench: out of memory\n");
+                exit(1);
+            } /* if */
+        } /* if */
+        es->dirs[es->numDirs++] = path;
+    } /* if */
+    return PHYSFS_ENUM_OK;
+} /* enumCallback */
+
+static void benchEnumerate(const Archive *arc, Result *res)
+{
+    EnumState es;
+    int i;
+
+    memset(&es, '\0', sizeof (es));
+    if (!PHYSFS_enumerateWithStat("", enumCallback, &es))
+        res->ok = 0;
+
+    /* breadth-first, so the callback never has to recurse into us. */
+    for (i = 0; i < es.numDirs; i++)
+    {
+        if (!PHYSFS_enumerateWithStat(es.dirs[i], enumCallback, &es))
+            res->ok = 0;
+    } /* for */
+
+    for (i = 0; i < es.numDirs; i++)
+        free(es.dirs[i]);
+    free(es.dirs);
+
+    /* every file, plus the directories above them. */
+    if (es.entries < (PHYSFS_uint64) arc->numFiles)
+        res->ok = 0;
+    res->ops = es.entries;
+} /* benchEnumerate */
+
+static void benchOpenSmall(const Archive *arc, Result *res)
+{
+    PHYSFS_uint32 state = 0x0FE4;
+    PHYSFS_uint8 buf[64];
+    int i;
+    for (i = 0; i < 20000; i++)
+    {
+        PHYSFS_File *f = PHYSFS_openRead(arc->files[rng(&state) % arc->numFiles]);
+        if (!f)
+            res->ok = 0;
+        else
+        {
+            const PHYSFS_sint64 br = PHYSFS_readBytes(f, buf, sizeof (buf));
+            if (br <= 0)
+                res->ok = 0;
+            else
+                res->bytes += (PHYSFS_uint64) br;
+            PHYSFS_close(f);
+        } /* else */
+    } /* for */
+    res->ops = 20000;
+} /* benchOpenSmall */
+
+/* read (fname) start to finish in (chunk)-sized reads; returns its CRC. */
+static PHYSFS_uint32 readWhole(const char *fname, size_t chunk, Result *res)
+{
+    PHYSFS_File *f = PHYSFS_openRead(fname);
+    PHYSFS_uint8 *buf;
+    PHYSFS_sint64 len;
+    PHYSFS_uint64 pos = 0;
+    PHYSFS_uint32 retval;
+
+    if (!f)
+    {
+        res->ok = 0;
+        return 0;
+    } /* if */
+
+    len = PHYSFS_fileLength(f);
+    buf = (PHYSFS_uint8 *) xmalloc((size_t) len);
+    while (pos < (PHYSFS_uint64) len)
+    {
+        const PHYSFS_uint64 want = ((len - pos) < chunk) ? (len - pos) : chunk;
+        const PHYSFS_sint64 br = PHYSFS_readBytes(f, buf + pos, want);
+        res->ops++;
+        if (br <= 0)
+        {
+            res->ok = 0;
+            break;
+        } /* if */
+        pos += (PHYSFS_uint64) br;
+    } /* while */
+    PHYSFS_close(f);
+
+    res->bytes += pos;
+    retval = crc32(buf, (size_t) pos);
+    free(buf);
+    return retval;
+} /* readWhole */
+
+static void benchReadSeq(const Archive *arc, Result *res)
+{
+    if (readWhole(arc->big, 64 * 1024, res) != arc->bigCrc)
+        res->ok = 0;
+    if ((arc->big2) && (readWhole(arc->big2, 64 * 1024, res) != arc->big2Crc))
+        res->ok = 0;
+} /* benchReadSeq */
+
+static void benchReadWhole(const Archive *arc, Result *res)
+{
+    if (readWhole(arc->big, 1024 * 1024 * 1024, res) != arc->bigCrc)
+        res->ok = 0;
+    if ((arc->big2) &&
+        (readWhole(arc->big2, 1024 * 1024 * 1024, res) != arc->big2Crc))
+        res->ok = 0;
+} /* benchReadWhole */
+
+static void readRandom(const char *fname, PHYSFS_uint32 seed, Result *res)
+{
+    PHYSFS_File *f = PHYSFS_openRead(fname);
+    PHYSFS_uint8 buf[4096];
+    PHYSFS_uint32 state = seed;
+    PHYSFS_sint64 len;
+    int i;
+
+    if (!f)
+    {
+        res->ok = 0;
+        return;
+    } /* if */
+
+    len = PHYSFS_fileLength(f);
+    for (i = 0; i < 500; i++)
+    {
+        const PHYSFS_uint64 pos = ((((PHYSFS_uint64) rng(&state)) << 16) ^
+                                   rng(&state)) % (len - sizeof (buf));
+        if (!PHYSFS_seek(f, pos))
+            res->ok = 0;
+        else if (PHYSFS_readBytes(f, buf, sizeof (buf)) != sizeof (buf))
+            res->ok = 0;
+        res->ops++;
+        res->bytes += sizeof (buf);
+    } /* for */
+    PHYSFS_close(f);
+} /* readRandom */
+
+static void benchReadRandom(const Archive *arc, Result *res)
+{
+    readRandom(arc->big, 0xAB1, res);
+    if (arc->big2)
+        readRandom(arc->big2, 0xAB2, res);
+} /* benchReadRandom */
+
+static void benchReadAllSmall(const Archive *arc, Result *res)
+{
+    PHYSFS_uint8 buf[8192];
+    int i;
+    for (i = 0; i < arc->numFiles; i++)
+    {
+        PHYSFS_File *f = PHYSFS_openRead(arc->files[i]);
+        PHYSFS_sint64 len, br;
+        if (!f)
+        {
+            res->ok = 0;
+            continue;
+        } /* if */
+        len = PHYSFS_fileLength(f);
+        br = (len <= (PHYSFS_sint64) sizeof (buf)) ?
+                PHYSFS_readBytes(f, buf, (PHYSFS_uint64) len) : -1;
+        if (br != len)
+            res->ok = 0;
+        else
+            res->bytes += (PHYSFS_uint64) br;
+        PHYSFS_close(f);
+    } /* for */
+    res->ops = arc->numFiles;
+} /* benchReadAllSmall */
+
+static void benchReadBatch(const Archive *arc, Result *res)
+{
+    /* a level's worth at a time, reusing the buffers, like a game would.
+       Bigger files just get their first 8k; the batch allows that. */
+    PHYSFS_ReadRequest reqs[256];
+    PHYSFS_uint8 *bufs = (PHYSFS_uint8 *) xmalloc(8192 * 256);
+    int i, j;
+
+    for (i = 0; i < arc->numFiles; i += 256)
+    {
+        const int num = (arc->numFiles - i < 256) ? arc->numFiles - i : 256;
+        for (j = 0; j < num; j++)
+        {
+            reqs[j].filename = arc->files[i + j];
+            reqs[j].buffer = bufs + (8192 * j);
+            reqs[j].len = 8192;
+        } /* for */
+
+        if (!PHYSFS_readFilesBatch(reqs, (PHYSFS_uint32) num,
+                                   (PHYSFS_uint32) numThreads))
+            res->ok = 0;
+
+        for (j = 0; j < num; j++)
+        {
+            if (reqs[j].result > 0)
+                res->bytes += (PHYSFS_uint64) reqs[j].result;
+        } /* for */
+    } /* for */
+    res->ops = arc->numFiles;
+    free(bufs);
+} /* benchReadBatch */
+
+static void benchPreload(const Archive *arc, Result *res)
+{
+    PHYSFS_PreloadStats stats;
+
+    /* pinned, so a big -scale doesn't just measure the budget check. */
+    PHYSFS_unpreload("");
+    if (!PHYSFS_preload("", PHYSFS_PRELOAD_PIN))
+        res->ok = 0;
+    PHYSFS_getPreloadStats(&stats);
+    res->bytes = stats.bytes;
+    res->ops = stats.files;
+} /* benchPreload */
+
+
+/* Multi-threaded benchmarks. Every thread runs (fn) at once. */
+
+typedef struct
+{
+    const Archive *arc;
+    void (*fn)(const Archive *arc, PHYSFS_uint32 seed, Result *res);
+    PHYSFS_uint32 seed;
+    Result res;
+} ThreadJob;
+
+static void mtLookup(const Archive *arc, PHYSFS_uint32 seed, Result *res)
+{
+    PHYSFS_uint32 state = seed;
+    int i;
+    for (i = 0; i < 100000; i++)
+    {
+        if (!PHYSFS_exists(arc->files[rng(&state) % arc->numFiles]))
+            res->ok = 0;
+    } /* for */
+    res->ops += 100000;
+} /* mtLookup */
+
+static void mtReadSmall(const Archive *arc, PHYSFS_uint32 seed, Result *res)
+{
+    PHYSFS_uint32 state = seed;
+    PHYSFS_uint8 buf[8192];
+    int i;
+    for (i = 0; i < 5000; i++)
+    {
+        PHYSFS_File *f = PHYSFS_openRead(arc->files[rng(&state) % arc->numFiles]);
+        PHYSFS_sint64 br;
+        if (!f)
+        {
+            res->ok = 0;
+            continue;
+        } /* if */
+        br = PHYSFS_readBytes(f, buf, sizeof (buf));
+        if (br <= 0)
+            res->ok = 0;
+        else
+            res->bytes += (PHYSFS_uint64) br;
+        PHYSFS_close(f);
+        res->ops++;
+    } /* for */
+} /* mtReadSmall */
+
+static void mtReadBig(const Archive *arc, PHYSFS_uint32 seed, Result *res)
+{
+    const int second = (arc->big2 != NULL) && (seed & 1);
+    const char *fname = second ? arc->big2 : arc->big;
+    const PHYSFS_uint32 crc = second ? arc->big2Crc : arc->bigCrc;
+    if (readWhole(fname, 64 * 1024, res) != crc)
+        res->ok = 0;
+} /* mtReadBig */
+
+#ifdef _WIN32
+static DWORD WINAPI threadEntry(LPVOID arg)
+#else
+static void *threadEntry(void *arg)
+#endif
+{
+    ThreadJob *job = (ThreadJob *) arg;
+    job->fn(job->arc, job->seed, &job->res);
+    return 0;
+} /* threadEntry */
+
+static PHYSFS_uint64 runThreads(const Archive *arc, ThreadJob *jobs,
+                                void (*fn)(const Archive *, PHYSFS_uint32,
+                                           Result *))
+{
+#ifdef _WIN32
+    HANDLE threads[MAX_THREADS];
+#else
+    pthread_t threads[MAX_THREADS];
+#endif
+    PHYSFS_uint64 start;
+    int i;
+
+    for (i = 0; i < numThreads; i++)
+    {
+        jobs[i].arc = arc;
+        jobs[i].fn = fn;
+        jobs[i].seed = 0x7A3 + (PHYSFS_uint32) i * 7919;
+        memset(&jobs[i].res, '\0', sizeof (jobs[i].res));
+        jobs[i].res.ok = 1;
+    } /* for */
+
+    start = nowNS();
+    for (i = 0; i < numThreads; i++)
+    {
+#ifdef _WIN32
+        threads[i] = CreateThread(NULL, 0, threadEntry, &jobs[i], 0, NULL);
+        if (threads[i] == NULL)
+#else
+        if (pthread_create(&threads[i], NULL, threadEntry, &jobs[i]) != 0)
+#endif
+        {
+            fprintf(stderr, "physfs_bench: couldn't start a thread\n");
+            exit(1);
+        } /* if */
+    } /* for */
+
+    for (i = 0; i < numThreads; i++)
+    {
+#ifdef _WIN32
+        WaitForSingleObject(threads[i], INFINITE);
+        CloseHandle(threads[i]);
+#else
+        pthread_join(threads[i], NULL);
+#endif
+    } /* for */
+
+    return nowNS() - start;
+} /* runThreads */
+
+
+/* The harness... */
+
+static int wanted(const char *bench, const Archive *arc)
+{
+    char name[128];
+    if (filter == NULL)
+        return 1;
+    snprintf(name, sizeof (name), "%s/%s", bench,
+             arc->label ? arc->label : arc->name);
+    return (strstr(name, filter) != NULL);
+} /* wanted */
+
+/* run (fn) (reps) times and report the fastest. */
+static void runBench(const char *bench, const Archive *arc, BenchFn fn)
+{
+    PHYSFS_uint64 best = 0;
+    Result bestres;
+    int i;
+
+    if (!wanted(bench, arc))
+        return;
+
+    memset(&bestres, '\0', sizeof (bestres));
+    for (i = 0; i < reps; i++)
+    {
+        Result res;
+        PHYSFS_uint64 start, ns;
+        memset(&res, '\0', sizeof (res));
+        res.ok = 1;
+        start = nowNS();
+        fn(arc, &res);
+        ns = nowNS() - start;
+        if ((i == 0) || (ns < best))
+        {
+            best = ns;
+            bestres = res;
+        } /* if */
+        if (!res.ok)
+            bestres.ok = 0;
+    } /* for */
+
+    report(bench, arc, 1, &bestres, best);
+} /* runBench */
+
+static void runThreadedBench(const char *bench, const Archive *arc,
+                   void (*fn)(const Archive *, PHYSFS_uint32, Result *))
+{
+    ThreadJob jobs[MAX_THREADS];
+    PHYSFS_uint64 best = 0;
+    Result bestres;
+    int i, j;
+
+    if (!wanted(bench, arc))
+        return;
+
+    memset(&bestres, '\0', sizeof (bestres));
+    for (i = 0; i < reps; i++)
+    {
+        const PHYSFS_uint64 ns = runThreads(arc, jobs, fn);
+        Result res;
+        memset(&res, '\0', sizeof (res));
+        res.ok = 1;
+        for (j = 0; j < numThreads; j++)
+        {
+            res.ops += jobs[j].res.ops;
+            res.bytes += jobs[j].res.bytes;
+            res.ok &= jobs[j].res.ok;
+        } /* for */
+        if ((i == 0) || (ns < best))
+        {
+            best = ns;
+            bestres = res;
+        } /* if */
+        if (!res.ok)
+            bestres.ok = 0;
+    } /* for */
+
+    report(bench, arc, numThreads, &bestres, best);
+} /* runThreadedBench */
+
+
+static void runArchive(const Archive *arc)
+{
+    if (!PHYSFS_snapshotDirectories(arc->snapshot))
+        fail("PHYSFS_snapshotDirectories");
+
+    runBench("mount", arc, benchMount);
+
+    mountArchive(arc);
+    runBench("lookup_hit", arc, benchLookupHit);
+    runBench("lookup_miss", arc, benchLookupMiss);
+    if (PHYSFS_setMissCacheSize(64 * 1024 * scale))
+    {
+        runBench("lookup_miss_cached", arc, benchLookupMiss);
+        PHYSFS_setMissCacheSize(0);
+    } /* if */
+    runBench("stat", arc, benchStat);
+    runBench("enumerate", arc, benchEnumerate);
+    runBench("read_batch", arc, benchReadBatch);
+    if (arc->big == NULL)
+    {
+        runBench("open_read_close", arc, benchOpenSmall);
+        runBench("read_all_small", arc, benchReadAllSmall);
+        runBench("preload", arc, benchPreload);
+        if (PHYSFS_preload("", PHYSFS_PRELOAD_PIN))
+        {
+            runBench("open_read_close_preloaded", arc, benchOpenSmall);
+            runBench("read_all_small_preloaded", arc, benchReadAllSmall);
+        } /* if */
+        PHYSFS_unpreload("");
+        runThreadedBench("mt_lookup", arc, mtLookup);
+        runThreadedBench("mt_read_small", arc, mtReadSmall);
+    } /* if */
+    else
+    {
+        runBench("read_seq_64k", arc, benchReadSeq);
+        runBench("read_whole", arc, benchReadWhole);
+        runBench("read_random_4k", arc, benchReadRandom);
+        runThreadedBench("mt_read_big", arc, mtReadBig);
+    } /* else */
+    unmountArchive(arc);
+} /* runArchive */
+
+
+static void usage(const char *argv0)
+{
+    fprintf(stderr,
+        "USAGE: %s [options]\n"
+        "  -d DIR      where to write the test data (must exist; default is\n"
+        "              the directory this program is in)\n"
+        "  -s SCALE    multiply the data set's size (default 1)\n"
+        "  -r REPS     runs of each benchmark; the fastest counts (default 3)\n"
+        "  -t THREADS  threads for the mt_* benchmarks (default 4)\n"
+        "  -f FILTER   only run benchmarks whose \"bench/archive\" name\n"
+        "              contains FILTER\n", argv0);
+    exit(2);
+} /* usage */
+
+
+int main(int argc, char **argv)
+{
+    PHYSFS_Version linked;
+    int i;
+
+    for (i = 1; i < argc; i++)
+    {
+        const char *arg = argv[i];
+        if ((arg[0] != '-') || (arg[1] == '\0') || (arg[2] != '\0'))
+            usage(argv[0]);
+        else if (i + 1 >= argc)
+            usage(argv[0]);
+
+        switch (arg[1])
+        {
+            case 'd': dataDir = argv[++i]; break;
+            case 's': scale = atoi(argv[++i]); break;
+            case 'r': reps = atoi(argv[++i]); break;
+            case 't': numThreads = atoi(argv[++i]); break;
+            case 'f': filter = argv[++i]; break;
+            default: usage(argv[0]);
+        } /* switch */
+    } /* for */
+
+    if ((scale < 1) || (reps < 1) || (numThreads < 1) ||
+        (numThreads > MAX_THREADS))
+        usage(argv[0]);
+
+    if (!PHYSFS_init(argv[0]))
+        fail("PHYSFS_init");
+
+    if (dataDir == NULL)
+        dataDir = PHYSFS_getBaseDir();
+
+    initCrc32();
+    makeDataSet();
+
+    PHYSFS_getLinkedVersion(&linked);
+    fprintf(stderr, "physfs_bench %d.%d.%d, PhysicsFS %d.%d.%d, "
+            "scale %d, %d reps, %d threads\n",
+            BENCH_VERSION_MAJOR, BENCH_VERSION_MINOR, BENCH_VERSION_PATCH,
+            (int) linked.major, (int) linked.minor, (int) linked.patch,
+            scale, reps, numThreads);
+
+    for (i = 0; i < ARC_TOTAL; i++)
+        runArchive(&archives[i]);
+
+    PHYSFS_deinit();
+    return 0;
+} /* main */
+
+/* end of physfs_bench.c ... */
@@ -1097,6 +1097,30 @@ static int cmd_filelength(char *args)
     return 1;
 } /* cmd_filelength */
 
+
+static int cmd_mapfile(char *args)
+{
+    const void *ptr = NULL;
+    PHYSFS_uint64 len = 0;
+
+    if (*args == '\"')
+    {
+        args++;
+        args[strlen(args) - 1] = '\0';
+    } /* if */
+
+    if (!PHYSFS_mapFile(args, &ptr, &len))
+        printf("failed to map. Reason: [%s].\n", PHYSFS_getLastError());
+    else
+    {
+        printf("Mapped (cast to int) %d bytes at %p.\n", (int) len, ptr);
+        if (!PHYSFS_unmapFile(ptr))
+            printf("failed to unmap. Reason: [%s].\n", PHYSFS_getLastError());
+    } /* else */
+
+    return 1;
+} /* cmd_mapfile */
+
 #define WRITESTR "The cat sat on the mat.\n\n"
 
 static int cmd_append(char *args)
@@ -1332,6 +1356,7 @@ static const command_info commands[] =
     { "cat",            cmd_cat,            1, "<fileToCat>"                },
     { "cat2",           cmd_cat2,           2, "<fileToCat1> <fileToCat2>"  },
     { "filelength",     cmd_filelength,     1, "<fileToCheck>"              },
+    { "mapfile",        cmd_mapfile,        1, "<fileToMap>"                },
     { "stat",           cmd_stat,           1, "<fileToStat>"               },
     { "append",         cmd_append,         1, "<fileToAppend>"             },
     { "write",          cmd_write,          1, "<fileToCreateOrTrash>"      },
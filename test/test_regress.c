@@ -0,0 +1,810 @@
+/**
+ * Regression tests for PhysicsFS.
+ *
+ * Each test builds the (tiny) archives it needs in a scratch directory,
+ *  through PhysicsFS's own write support, then checks one behaviour that
+ *  broke once. Run it with the scratch directory as its only argument (the
+ *  build's ctest does); it prints one line per test and exits non-zero if
+ *  any failed.
+ *
+ * Please see the file LICENSE.txt in the source's root directory.
+ *
+ *  This file written by Ryan C. Gordon.
+ */
+
+#define _CRT_SECURE_NO_WARNINGS 1
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "physfs.h"
+
+static const char *dataDir = NULL;
+
+
+/* Helpers... */
+
+#define CHECK(x) do { \
+    if (!(x)) { \
+        fprintf(stderr, "test_regress: %s:%d: %s failed (%s)\n", \
+                __FILE__, __LINE__, #x, \
+                PHYSFS_getErrorByCode(PHYSFS_getLastErrorCode())); \
+        return 0; \
+    } \
+} while (0)
+
+static void *xmalloc(size_t len)
+{
+    void *retval = malloc(len ? len : 1);
+    if (retval == NULL)
+    {
+        fprintf(stderr, "test_regress: out of memory\n");
+        exit(1);
+    } /* if */
+    return retval;
+} /* xmalloc */
+
+
+static char *dataPath(const char *fname)
+{
+    const char *sep = PHYSFS_getDirSeparator();
+    char *retval = (char *) xmalloc(strlen(dataDir) + strlen(sep) +
+                                    strlen(fname) + 1);
+    strcpy(retval, dataDir);
+    if ((*retval) && (strcmp(retval + strlen(retval) - strlen(sep), sep) != 0))
+        strcat(retval, sep);
+    strcat(retval, fname);
+    return retval;
+} /* dataPath */
+
+
+/* known content: byte (i) of every test file is this. */
+static PHYSFS_uint8 contentByte(PHYSFS_uint64 i)
+{
+    PHYSFS_uint32 x = (PHYSFS_uint32) ((i / 7) * 2654435761u);
+    return (PHYSFS_uint8) (((x >> 24) & 0x3F) + ' ');
+} /* contentByte */
+
+
+static PHYSFS_uint32 crc32(const PHYSFS_uint8 *buf, size_t len)
+{
+    PHYSFS_uint32 crc = 0xFFFFFFFF;
+    while (len--)
+    {
+        int i;
+        crc ^= *(buf++);
+        for (i = 0; i < 8; i++)
+            crc = (crc & 1) ? (0xEDB88320 ^ (crc >> 1)) : (crc >> 1);
+    } /* while */
+    return crc ^ 0xFFFFFFFF;
+} /* crc32 */
+
+
+typedef struct
+{
+    PHYSFS_uint8 *data;
+    size_t len;
+    size_t alloc;
+} Buffer;
+
+static void bufAppend(Buffer *buf, const void *data, size_t len)
+{
+    if (len == 0)
+        return;
+    else if (buf->len + len > buf->alloc)
+    {
+        size_t newalloc = buf->alloc ? buf->alloc : 4096;
+        void *ptr;
+        while (newalloc < buf->len + len)
+            newalloc *= 2;
+        ptr = realloc(buf->data, newalloc);
+        if (ptr == NULL)
+        {
+            fprintf(stderr, "test_regress: out of memory\n");
+            exit(1);
+        } /* if */
+        buf->data = (PHYSFS_uint8 *) ptr;
+        buf->alloc = newalloc;
+    } /* if */
+    memcpy(buf->data + buf->len, data, len);
+    buf->len += len;
+} /* bufAppend */
+
+static void bufByte(Buffer *buf, PHYSFS_uint8 val)
+{
+    bufAppend(buf, &val, 1);
+} /* bufByte */
+
+static void bufLE16(Buffer *buf, PHYSFS_uint32 val)
+{
+    bufByte(buf, (PHYSFS_uint8) (val & 0xFF));
+    bufByte(buf, (PHYSFS_uint8) ((val >> 8) & 0xFF));
+} /* bufLE16 */
+
+static void bufLE32(Buffer *buf, PHYSFS_uint32 val)
+{
+    bufLE16(buf, val & 0xFFFF);
+    bufLE16(buf, val >> 16);
+} /* bufLE32 */
+
+
+static PHYSFS_uint32 getLE32(const PHYSFS_uint8 *ptr)
+{
+    return ((PHYSFS_uint32) ptr[0]) | (((PHYSFS_uint32) ptr[1]) << 8) |
+           (((PHYSFS_uint32) ptr[2]) << 16) | (((PHYSFS_uint32) ptr[3]) << 24);
+} /* getLE32 */
+
+static void putLE32(PHYSFS_uint8 *ptr, PHYSFS_uint32 val)
+{
+    ptr[0] = (PHYSFS_uint8) (val & 0xFF);
+    ptr[1] = (PHYSFS_uint8) ((val >> 8) & 0xFF);
+    ptr[2] = (PHYSFS_uint8) ((val >> 16) & 0xFF);
+    ptr[3] = (PHYSFS_uint8) ((val >> 24) & 0xFF);
+} /* putLE32 */
+
+
+/* Deflate, with fixed Huffman codes and nothing but literals. */
+
+typedef struct
+{
+    Buffer *out;
+    PHYSFS_uint32 bits;
+    int nbits;
+} BitWriter;
+
+static void putBits(BitWriter *bw, PHYSFS_uint32 val, int n)
+{
+    bw->bits |= val << bw->nbits;
+    bw->nbits += n;
+    while (bw->nbits >= 8)
+    {
+        bufByte(bw->out, (PHYSFS_uint8) (bw->bits & 0xFF));
+        bw->bits >>= 8;
+        bw->nbits -= 8;
+    } /* while */
+} /* putBits */
+
+static void putCode(BitWriter *bw, PHYSFS_uint32 code, int n)
+{
+    PHYSFS_uint32 reversed = 0;  /* Huffman codes go in MSB first. */
+    int i;
+    for (i = 0; i < n; i++)
+        reversed |= ((code >> i) & 1) << (n - 1 - i);
+    putBits(bw, reversed, n);
+} /* putCode */
+
+static void deflateData(const PHYSFS_uint8 *src, size_t len, Buffer *out)
+{
+    BitWriter bw;
+    size_t i;
+
+    bw.out = out;
+    bw.bits = 0;
+    bw.nbits = 0;
+
+    putBits(&bw, 1, 1);  /* final block... */
+    putBits(&bw, 1, 2);  /* ...with fixed Huffman codes. */
+    for (i = 0; i < len; i++)
+    {
+        if (src[i] <= 143)
+            putCode(&bw, 0x30 + src[i], 8);
+        else
+            putCode(&bw, 0x190 + (src[i] - 144), 9);
+    } /* for */
+    putCode(&bw, 0, 7);  /* end of block. */
+    putBits(&bw, 0, (8 - bw.nbits) & 7);
+} /* deflateData */
+
+
+static int writeFile(const char *fname, const void *data, size_t len)
+{
+    PHYSFS_File *f = PHYSFS_openWrite(fname);
+    CHECK(f != NULL);
+    CHECK(PHYSFS_writeBytes(f, data, len) == (PHYSFS_sint64) len);
+    CHECK(PHYSFS_close(f));
+    return 1;
+} /* writeFile */
+
+
+static int readFile(const char *fname, Buffer *buf)
+{
+    PHYSFS_File *f = PHYSFS_openRead(fname);
+    PHYSFS_sint64 len;
+    CHECK(f != NULL);
+    len = PHYSFS_fileLength(f);
+    buf->len = 0;
+    if (len > 0)
+    {
+        PHYSFS_uint8 *ptr = (PHYSFS_uint8 *) xmalloc((size_t) len);
+        const PHYSFS_sint64 br = PHYSFS_readBytes(f, ptr, (size_t) len);
+        if (br == len)
+            bufAppend(buf, ptr, (size_t) len);
+        free(ptr);
+        CHECK(br == len);
+    } /* if */
+    CHECK(PHYSFS_close(f));
+    return 1;
+} /* readFile */
+
+
+typedef struct
+{
+    Buffer data;
+    Buffer central;
+    PHYSFS_uint32 count;
+} ZipWriter;
+
+/* add (len) bytes of known content, stored or deflated, named (name). */
+static void zipAdd(ZipWriter *zip, const char *name, size_t len, int compress)
+{
+    const PHYSFS_uint32 namelen = (PHYSFS_uint32) strlen(name);
+    const PHYSFS_uint32 offset = (PHYSFS_uint32) zip->data.len;
+    const PHYSFS_uint32 dostime = 0x5A8C6000;  /* 2025-04-12, 12:00:00. */
+    PHYSFS_uint8 *buf = (PHYSFS_uint8 *) xmalloc(len);
+    const PHYSFS_uint32 method = compress ? 8 : 0;
+    Buffer packed;
+    PHYSFS_uint32 crc;
+    size_t i;
+    int pass;
+
+    for (i = 0; i < len; i++)
+        buf[i] = contentByte(i);
+    crc = crc32(buf, len);
+
+    memset(&packed, '\0', sizeof (packed));
+    if (compress)
+        deflateData(buf, len, &packed);
+    else
+        bufAppend(&packed, buf, len);
+
+    /* the local header, then the same again for the central directory. */
+    for (pass = 0; pass < 2; pass++)
+    {
+        Buffer *out = pass ? &zip->central : &zip->data;
+        bufLE32(out, pass ? 0x02014B50 : 0x04034B50);
+        if (pass)
+            bufLE16(out, 20);     /* version made by. */
+        bufLE16(out, 20);         /* version needed. */
+        bufLE16(out, 0);          /* flags. */
+        bufLE16(out, method);
+        bufLE32(out, dostime);
+        bufLE32(out, crc);
+        bufLE32(out, (PHYSFS_uint32) packed.len);
+        bufLE32(out, (PHYSFS_uint32) len);
+        bufLE16(out, namelen);
+        bufLE16(out, 0);          /* extra field length. */
+        if (pass)
+        {
+            bufLE16(out, 0);      /* comment length. */
+            bufLE16(out, 0);      /* disk number. */
+            bufLE16(out, 0);      /* internal attributes. */
+            bufLE32(out, 0);      /* external attributes. */
+            bufLE32(out, offset);
+        } /* if */
+        bufAppend(out, name, namelen);
+    } /* for */
+    bufAppend(&zip->data, packed.data, packed.len);
+    zip->count++;
+
+    free(packed.data);
+    free(buf);
+} /* zipAdd */
+
+static int zipFinish(ZipWriter *zip, const char *fname)
+{
+    const PHYSFS_uint32 cdofs = (PHYSFS_uint32) zip->data.len;
+    const PHYSFS_uint32 cdlen = (PHYSFS_uint32) zip->central.len;
+    int retval;
+    bufAppend(&zip->data, zip->central.data, zip->central.len);
+    bufLE32(&zip->data, 0x06054B50);
+    bufLE16(&zip->data, 0);         /* this disk. */
+    bufLE16(&zip->data, 0);         /* disk with the central dir. */
+    bufLE16(&zip->data, zip->count);
+    bufLE16(&zip->data, zip->count);
+    bufLE32(&zip->data, cdlen);
+    bufLE32(&zip->data, cdofs);
+    bufLE16(&zip->data, 0);         /* comment length. */
+    retval = writeFile(fname, zip->data.data, zip->data.len);
+    free(zip->data.data);
+    free(zip->central.data);
+    memset(zip, '\0', sizeof (*zip));
+    return retval;
+} /* zipFinish */
+
+
+static int mountData(const char *fname, const char *mntpoint)
+{
+    char *path = dataPath(fname);
+    const int retval = PHYSFS_mount(path, mntpoint, 1);
+    free(path);
+    return retval;
+} /* mountData */
+
+static int unmountData(const char *fname)
+{
+    char *path = dataPath(fname);
+    const int retval = PHYSFS_unmount(path);
+    free(path);
+    return retval;
+} /* unmountData */
+
+
+/* read (len) bytes at (pos) of (f) and check they're the known content. */
+static int checkContent(PHYSFS_File *f, PHYSFS_uint64 pos, size_t len)
+{
+    PHYSFS_uint8 buf[512];
+    size_t i;
+    CHECK(len <= sizeof (buf));
+    CHECK(PHYSFS_seek(f, pos));
+    CHECK(PHYSFS_readBytes(f, buf, len) == (PHYSFS_sint64) len);
+    for (i = 0; i < len; i++)
+        CHECK(buf[i] == contentByte(pos + i));
+    return 1;
+} /* checkContent */
+
+
+/* The tests... */
+
+/*
+ * Saved seek checkpoints are untrusted input: a file that lies about the
+ *  decoder's state has to be turned away before any of it is used, not
+ *  crash (or misread) the next seek.
+ */
+
+#define CKPT_SIZE (256 * 1024)
+#define CKPT_INTERVAL (16 * 1024)
+#define CKPT_HEADER 32          /* sig, version, crc, sizes, count. */
+#define CKPT_STATE 20           /* first point's state, after its offsets. */
+
+static int loadCheckpointData(const Buffer *dat)
+{
+    PHYSFS_File *f;
+    PHYSFS_File *in;
+    int rc;
+
+    CHECK(writeFile("ckpt_try.dat", dat->data, dat->len));
+    CHECK((f = PHYSFS_openRead("/zip/big.bin")) != NULL);
+    CHECK((in = PHYSFS_openRead("/data/ckpt_try.dat")) != NULL);
+    rc = PHYSFS_loadSeekCheckpoints(f, in);
+    CHECK(PHYSFS_close(in));
+    if (!rc)
+    {
+        const PHYSFS_ErrorCode err = PHYSFS_getLastErrorCode();
+        PHYSFS_close(f);
+        PHYSFS_setErrorCode(err);
+        return 0;
+    } /* if */
+
+    CHECK(checkContent(f, CKPT_SIZE - 100, 100));
+    CHECK(checkContent(f, CKPT_INTERVAL * 3 + 17, 300));
+    CHECK(checkContent(f, 5, 50));
+    CHECK(checkContent(f, CKPT_SIZE / 2, 512));
+    CHECK(PHYSFS_close(f));
+    return 1;
+} /* loadCheckpointData */
+
+static int testCheckpointsCrafted(void)
+{
+    /* offsets into the first point's saved decoder state. */
+    static const struct { const char *what; size_t offset; PHYSFS_uint32 val; }
+    cases[] = {
+        { "dict offset", CKPT_STATE + 44, 0x7FFFFF00 },
+        { "dict available", CKPT_STATE + 48, 0x8000 },
+        { "decoder state", CKPT_STATE + 0, 36 },
+        { "decoder state", CKPT_STATE + 0, 1000 },
+        { "bit count", CKPT_STATE + 4, 64 },
+        { "table size", CKPT_STATE + 28, 289 },
+        { "last status", CKPT_STATE + 56, 0xFFFFFFFF },
+        { "table size", CKPT_STATE + 32, 33 },
+        { "code length", CKPT_STATE + 88, 0x10101010 }
+    };
+    ZipWriter zip;
+    Buffer good, bad;
+    PHYSFS_File *f;
+    PHYSFS_File *out;
+    PHYSFS_uint8 *buf;
+    PHYSFS_uint32 state;
+    size_t i;
+
+    memset(&zip, '\0', sizeof (zip));
+    zipAdd(&zip, "big.bin", CKPT_SIZE, 1);
+    CHECK(zipFinish(&zip, "ckpt.zip"));
+    CHECK(mountData("ckpt.zip", "/zip"));
+
+    /* record some real checkpoints, and save them. */
+    PHYSFS_setSeekCheckpointInterval(CKPT_INTERVAL);
+    CHECK((f = PHYSFS_openRead("/zip/big.bin")) != NULL);
+    buf = (PHYSFS_uint8 *) xmalloc(4096);  /* small reads: whole-file */
+    for (i = 0; i < CKPT_SIZE; i += 4096)  /*  reads skip checkpoints. */
+    {
+        if (PHYSFS_readBytes(f, buf, 4096) != 4096)
+            break;
+    } /* for */
+    free(buf);
+    CHECK(i == CKPT_SIZE);
+    CHECK((out = PHYSFS_openWrite("ckpt.dat")) != NULL);
+    CHECK(PHYSFS_saveSeekCheckpoints(f, out));
+    CHECK(PHYSFS_close(out));
+    CHECK(PHYSFS_close(f));
+    PHYSFS_setSeekCheckpointInterval(0);
+
+    memset(&good, '\0', sizeof (good));
+    memset(&bad, '\0', sizeof (bad));
+    CHECK(readFile("/data/ckpt.dat", &good));
+    CHECK(good.len > CKPT_HEADER + CKPT_STATE + 1413);
+    CHECK(getLE32(good.data + CKPT_HEADER - 4) > 0);  /* count. */
+
+    /* start over with no checkpoints, then try each broken file. */
+    CHECK(unmountData("ckpt.zip"));
+    CHECK(mountData("ckpt.zip", "/zip"));
+
+    for (i = 0; i < sizeof (cases) / sizeof (cases[0]); i++)
+    {
+        bad.len = 0;
+        bufAppend(&bad, good.data, good.len);
+        putLE32(bad.data + CKPT_HEADER + cases[i].offset, cases[i].val);
+        if (loadCheckpointData(&bad))
+        {
+            fprintf(stderr, "test_regress: bad %s was loaded\n", cases[i].what);
+            return 0;
+        } /* if */
+        CHECK(PHYSFS_getLastErrorCode() == PHYSFS_ERR_CORRUPT);
+    } /* for */
+
+    /* code lengths that can't make a Huffman code, if they're in use. */
+    state = getLE32(good.data + CKPT_HEADER + CKPT_STATE);
+    if (((state >= 23) && (state <= 27)) || (state == 53))
+    {
+        bad.len = 0;
+        bufAppend(&bad, good.data, good.len);
+        memset(bad.data + CKPT_HEADER + CKPT_STATE + 88, 1, 288);
+        CHECK(!loadCheckpointData(&bad));
+        CHECK(PHYSFS_getLastErrorCode() == PHYSFS_ERR_CORRUPT);
+    } /* if */
+
+    /* cut short. */
+    bad.len = CKPT_HEADER + CKPT_STATE + 100;
+    CHECK(!loadCheckpointData(&bad));
+
+    /* nothing was loaded from any of those, and the real ones still work. */
+    CHECK(loadCheckpointData(&good));
+
+    free(good.data);
+    free(bad.data);
+    CHECK(unmountData("ckpt.zip"));
+    return 1;
+} /* testCheckpointsCrafted */
+
+
+/*
+ * With PHYSFS_ignoreCase(), an archive's entries that only differ in case
+ *  are the same file, and the first one wins: it used to fail the mount of
+ *  a .zip, and give the last one in other archives.
+ */
+
+static int checkFirstCaseWins(const char *dir)
+{
+    char path[64];
+    char **list;
+    PHYSFS_sint64 len;
+    PHYSFS_File *f;
+    int i;
+
+    sprintf(path, "%s/ReadMe", dir);
+    CHECK((f = PHYSFS_openRead(path)) != NULL);
+    len = PHYSFS_fileLength(f);
+    CHECK(PHYSFS_close(f));
+    CHECK(len == 100);
+
+    CHECK((list = PHYSFS_enumerateFiles(dir)) != NULL);
+    for (i = 0; list[i] != NULL; i++) { /* spin. */ }
+    if ((i != 2) || (strcmp(list[0], "README") != 0) ||
+        (strcmp(list[1], "other") != 0))
+    {
+        fprintf(stderr, "test_regress: %s lists the wrong files\n", dir);
+        PHYSFS_freeList(list);
+        return 0;
+    } /* if */
+    PHYSFS_freeList(list);
+    return 1;
+} /* checkFirstCaseWins */
+
+static int testIgnoreCaseDupes(void)
+{
+    /* README, then readme (twice as long), then other. */
+    static const struct { const char *name; size_t len; } files[] = {
+        { "README", 100 }, { "readme", 200 }, { "other", 10 }
+    };
+    ZipWriter zip;
+    Buffer pak;
+    PHYSFS_uint32 pos;
+    size_t i;
+
+    CHECK(PHYSFS_ignoreCase(1));
+
+    memset(&zip, '\0', sizeof (zip));
+    for (i = 0; i < 3; i++)
+        zipAdd(&zip, files[i].name, files[i].len, 0);
+    CHECK(zipFinish(&zip, "case.zip"));
+
+    /* a Quake .pak; it goes through the same code as the other simple
+       formats (and ISO9660): header, everyone's data, then the directory. */
+    memset(&pak, '\0', sizeof (pak));
+    bufAppend(&pak, "PACK", 4);
+    bufLE32(&pak, 12 + 100 + 200 + 10);
+    bufLE32(&pak, 3 * 64);
+    for (i = 0; i < 3; i++)
+    {
+        size_t j;
+        for (j = 0; j < files[i].len; j++)
+            bufByte(&pak, contentByte(j));
+    } /* for */
+    for (i = 0, pos = 12; i < 3; pos += (PHYSFS_uint32) files[i++].len)
+    {
+        char name[56];
+        memset(name, '\0', sizeof (name));
+        strcpy(name, files[i].name);
+        bufAppend(&pak, name, sizeof (name));
+        bufLE32(&pak, pos);
+        bufLE32(&pak, (PHYSFS_uint32) files[i].len);
+    } /* for */
+    i = (size_t) writeFile("case.pak", pak.data, pak.len);
+    free(pak.data);
+    CHECK(i);
+
+    CHECK(mountData("case.zip", "/zip"));
+    CHECK(mountData("case.pak", "/pak"));
+    CHECK(checkFirstCaseWins("/zip"));
+    CHECK(checkFirstCaseWins("/pak"));
+    CHECK(unmountData("case.zip"));
+    CHECK(unmountData("case.pak"));
+    return 1;
+} /* testIgnoreCaseDupes */
+
+
+/*
+ * The index cache's checksum catches accidents, not lies: a cache file with
+ *  a good checksum but pointers to the middle of entries, or lists that
+ *  loop, has to be ignored (the archive is read the slow way instead), not
+ *  crash or hang later lookups. This knows the cache's layout, so it only
+ *  runs where pointers are 64 bits.
+ */
+
+#define IDX_HEADER 88  /* sizeof (DirTreeCacheHeader) in physfs.c. */
+#define IDX_ALIGN(x) (((x) + 7) & ~((size_t) 7))
+
+/* __PHYSFS_hashString(), which the cache's checksum uses. */
+static PHYSFS_uint32 hashString(const PHYSFS_uint8 *str, size_t len)
+{
+    const PHYSFS_uint64 p1 = (((PHYSFS_uint64) 0x9E3779B1) << 32) | 0x85EBCA87;
+    const PHYSFS_uint64 p2 = (((PHYSFS_uint64) 0xC2B2AE3D) << 32) | 0x27D4EB4F;
+    const PHYSFS_uint64 p3 = (((PHYSFS_uint64) 0x165667B1) << 32) | 0x9E3779F9;
+    const PHYSFS_uint64 p4 = (((PHYSFS_uint64) 0x85EBCA77) << 32) | 0xC2B2AE63;
+    PHYSFS_uint64 hash = p3 + (PHYSFS_uint64) len;
+    PHYSFS_uint64 word;
+
+    #define ROTL64(x, r) (((x) << (r)) | ((x) >> (64 - (r))))
+    while (len >= sizeof (word))
+    {
+        memcpy(&word, str, sizeof (word));
+        word *= p2;
+        word = ROTL64(word, 31);
+        word *= p1;
+        hash ^= word;
+        hash = (ROTL64(hash, 27) * p1) + p4;
+        str += sizeof (word);
+        len -= sizeof (word);
+    } /* while */
+
+    if (len > 0)
+    {
+        word = 0;
+        memcpy(&word, str, len);
+        word *= p1;
+        hash ^= ROTL64(word, 23) * p2;
+        hash = (ROTL64(hash, 11) * p1) + p3;
+    } /* if */
+    #undef ROTL64
+
+    hash ^= hash >> 33;
+    hash *= p2;
+    hash ^= hash >> 29;
+    hash *= p3;
+    hash ^= hash >> 32;
+    return (PHYSFS_uint32) hash;
+} /* hashString */
+
+
+static int checkCachedZip(void)
+{
+    char **list;
+    PHYSFS_File *f;
+    int i;
+
+    CHECK(mountData("cached.zip", "/zip"));
+    CHECK((f = PHYSFS_openRead("/zip/a/two")) != NULL);
+    CHECK(PHYSFS_fileLength(f) == 20);
+    CHECK(PHYSFS_close(f));
+    CHECK((f = PHYSFS_openRead("/zip/c")) != NULL);
+    CHECK(PHYSFS_fileLength(f) == 40);
+    CHECK(PHYSFS_close(f));
+    CHECK(!PHYSFS_exists("/zip/d"));
+
+    CHECK((list = PHYSFS_enumerateFiles("/zip")) != NULL);
+    for (i = 0; list[i] != NULL; i++) { /* spin. */ }
+    PHYSFS_freeList(list);
+    CHECK(i == 3);
+    CHECK((list = PHYSFS_enumerateFiles("/zip/a")) != NULL);
+    for (i = 0; list[i] != NULL; i++) { /* spin. */ }
+    PHYSFS_freeList(list);
+    CHECK(i == 2);
+
+    CHECK(unmountData("cached.zip"));
+    return 1;
+} /* checkCachedZip */
+
+static int testIndexCacheCrafted(void)
+{
+    ZipWriter zip;
+    Buffer good, bad;
+    char idxname[64];
+    char path[72];
+    char **list;
+    char *idxdir;
+    size_t block, stride, first, hashofs;
+    PHYSFS_uint32 entrylen, ptrsize, metalen;
+    PHYSFS_uint32 lens[4];
+    PHYSFS_uint64 blocklen;
+    int i;
+
+    memset(&zip, '\0', sizeof (zip));
+    zipAdd(&zip, "a/one", 10, 0);
+    zipAdd(&zip, "a/two", 20, 0);
+    zipAdd(&zip, "b", 30, 0);
+    zipAdd(&zip, "c", 40, 0);
+    CHECK(zipFinish(&zip, "cached.zip"));
+
+    CHECK(PHYSFS_mkdir("idx"));
+    CHECK((list = PHYSFS_enumerateFiles("/data/idx")) != NULL);
+    for (i = 0; list[i] != NULL; i++)  /* from an earlier run. */
+    {
+        sprintf(path, "idx/%.60s", list[i]);
+        PHYSFS_delete(path);
+    } /* for */
+    PHYSFS_freeList(list);
+
+    idxdir = dataPath("idx");
+    i = PHYSFS_setIndexCacheDir(idxdir);
+    free(idxdir);
+    CHECK(i);
+
+    /* the first mount writes the cache, the second uses it. */
+    CHECK(checkCachedZip());
+    CHECK(checkCachedZip());
+
+    CHECK((list = PHYSFS_enumerateFiles("/data/idx")) != NULL);
+    idxname[0] = '\0';
+    for (i = 0; list[i] != NULL; i++)
+    {
+        if (strlen(list[i]) < sizeof (idxname) - 4)
+            sprintf(idxname, "idx/%s", list[i]);
+    } /* for */
+    PHYSFS_freeList(list);
+    CHECK(i == 1);
+
+    memset(&good, '\0', sizeof (good));
+    memset(&bad, '\0', sizeof (bad));
+    sprintf(path, "/data/%s", idxname);
+    CHECK(readFile(path, &good));
+    CHECK(good.len > IDX_HEADER);
+
+    memcpy(&ptrsize, good.data + 16, 4);
+    if (ptrsize != 8)
+    {
+        free(good.data);
+        return 1;  /* we only know where things are with 64-bit pointers. */
+    } /* if */
+
+    memcpy(&entrylen, good.data + 20, 4);
+    memcpy(&blocklen, good.data + 72, 8);
+    memcpy(lens, good.data + 56, sizeof (lens));  /* name, tag, key, extra. */
+    metalen = IDX_HEADER + IDX_ALIGN(lens[0] + lens[1] + lens[2] + lens[3]);
+    stride = IDX_ALIGN(entrylen);
+    block = metalen;
+    first = stride;  /* the first entry after the root. */
+    hashofs = block + (size_t) blocklen;
+    CHECK(hashofs < good.len);
+
+    for (i = 0; i < 6; i++)
+    {
+        /* an entry's pointers are right after its name pointer. */
+        PHYSFS_uint32 sum;
+        PHYSFS_uint64 val;
+        size_t ofs;
+        switch (i)
+        {
+            case 0:  /* root's children: into the middle of the root. */
+                ofs = block + 16; val = 8 + 1; break;
+            case 1:  /* first entry's sibling: itself. */
+                ofs = block + first + 24; val = first + 1; break;
+            case 2:  /* first entry's children: the root. */
+                ofs = block + first + 16; val = 0 + 1; break;
+            case 3:  /* first entry's hash chain: itself. */
+                ofs = block + first + 8; val = first + 1; break;
+            case 4:  /* a hash bucket: the first entry's name. */
+                ofs = hashofs; val = first + stride + 1; break;
+            default:  /* root's children: past the end. */
+                ofs = block + 16; val = blocklen + 1; break;
+        } /* switch */
+
+        bad.len = 0;
+        bufAppend(&bad, good.data, good.len);
+        memcpy(bad.data + ofs, &val, 8);
+        sum = hashString(bad.data + IDX_HEADER, bad.len - IDX_HEADER);
+        memcpy(bad.data + 80, &sum, 4);
+        CHECK(writeFile(idxname, bad.data, bad.len));
+        if (!checkCachedZip())
+        {
+            fprintf(stderr, "test_regress: bad index cache #%d was used\n", i);
+            return 0;
+        } /* if */
+    } /* for */
+
+    free(good.data);
+    free(bad.data);
+    return 1;
+} /* testIndexCacheCrafted */
+
+
+typedef struct
+{
+    const char *name;
+    int (*fn)(void);
+} Test;
+
+static const Test tests[] = {
+    { "checkpoints_crafted", testCheckpointsCrafted },
+    { "ignorecase_dupes", testIgnoreCaseDupes },
+    { "index_cache_crafted", testIndexCacheCrafted }
+};
+
+
+int main(int argc, char **argv)
+{
+    int failures = 0;
+    size_t i;
+
+    if (argc != 2)
+    {
+        fprintf(stderr, "USAGE: %s <scratch dir>\n", argv[0]);
+        return 2;
+    } /* if */
+
+    dataDir = argv[1];
+
+    for (i = 0; i < sizeof (tests) / sizeof (tests[0]); i++)
+    {
+        int rc = 0;
+        if (!PHYSFS_init(argv[0]))
+            fprintf(stderr, "test_regress: PHYSFS_init: %s\n",
+                    PHYSFS_getErrorByCode(PHYSFS_getLastErrorCode()));
+        else if (!PHYSFS_setWriteDir(dataDir))
+            fprintf(stderr, "test_regress: %s: %s\n", dataDir,
+                    PHYSFS_getErrorByCode(PHYSFS_getLastErrorCode()));
+        else if (!PHYSFS_mount(dataDir, "/data", 1))
+            fprintf(stderr, "test_regress: %s: %s\n", dataDir,
+                    PHYSFS_getErrorByCode(PHYSFS_getLastErrorCode()));
+        else
+            rc = tests[i].fn();
+        PHYSFS_deinit();
+
+        printf("%s: %s\n", rc ? "PASS" : "FAIL", tests[i].name);
+        if (!rc)
+            failures++;
+    } /* for */
+
+    return failures ? 1 : 0;
+} /* main */
+
+/* end of test_regress.c ... */